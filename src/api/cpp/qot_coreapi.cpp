@@ -44,127 +44,56 @@ extern "C"
     #include <sys/un.h>
     #include <sys/shm.h>    // Shared Memory
     #include <sys/mman.h>   // Memory Management
+    #include <sys/stat.h>   // Segment size
     #include <errno.h>      // Error
 
     #include <linux/ptp_clock.h>
 }
 
 #include <iostream>
+#include <algorithm>
 
 /* This file includes */
 #include "qot_coreapi.hpp"
 
+/* Past clock parameters, shared with the live ones */
+extern "C"
+{
+    #include "../../qot_param_history.h"
+}
+
 #ifdef QOT_TIMELINE_SERVICE
 // To serialize timeline service messages to JSON
 #include "../../micro-services/timeline-service/qot_tlmsg_serialize.hpp"
 
-// To de-serialize timeline clock parameters from JSON
-#ifdef NATS_SERVICE
-#include "../../micro-services/sync-service/qot_clkparams_serialize.hpp"
-#endif
-
 #endif
 
 using namespace qot_coreapi;
 
 #define DEBUG 0
 
-/* Private Functions */
-
 #ifdef QOT_TIMELINE_SERVICE
-#ifdef NATS_SERVICE
-/* NATS Subscription handler*/
-void timeline_param_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
-{
-    CircularBuffer *param_buffer = (CircularBuffer*) closure;
-
-    if (DEBUG)
-    {
-        printf("Received msg: %s - %.*s\n",
-               natsMsg_GetSubject(msg),
-               natsMsg_GetDataLength(msg),
-               natsMsg_GetData(msg));
-    }
-
-    /* De-serialize data */
-    tl_translation_t rcv_clk_params;
-    nlohmann::json data = nlohmann::json::parse(std::string(natsMsg_GetData(msg)));
-    deserialize_clkparams(data, rcv_clk_params);
-
-    if (DEBUG)
-        printf("Deserialized params are mult = %lld last = %lld\n", (long long)rcv_clk_params.mult, (long long)rcv_clk_params.last);
-
-    if (param_buffer)
-        param_buffer->AddElement(rcv_clk_params);
-
-    // Need to destroy the message!
-    natsMsg_Destroy(msg);
-
-}
-
-/* Subscribe to a NATS topic (subject) */
-int TimelineBinding::natsSubscribe(std::string &topic)
-{
-    if (DEBUG)
-        printf("Subscribing to NATS subject %s\n", topic.c_str());
-
-    // Creates a connection to the default NATS URL
-    s = natsConnection_ConnectTo(&conn, "nats://nats.default.svc.cluster.local:4222");
-    if (s == NATS_OK)
-    {
-        nats_status_flag = 1; // Indicates the connection went through
-        if (DEBUG)
-            printf("Connected to NATS server\n");
-
-        // Create Circular Buffer
-        param_buffer = new CircularBuffer(CIRBUFF_DEFSIZE);
-
-        // Creates an asynchronous subscription on subject "foo".
-        // When a message is sent on subject "foo", the callback
-        // onMsg() will be invoked by the client library.
-        // You can pass a closure as the last argument.
-        s = natsConnection_Subscribe(&sub, conn, topic.c_str(), timeline_param_handler, (void*) param_buffer);
-    }
+// Longest uninterrupted sleep of a timeline wait (bounds the reaction to overlay updates)
+#define QOT_WAIT_CHUNK_NS    10000000LL
 
-    // If there was an error, print a stack trace and exit
-    if (s != NATS_OK)
-    {
-        nats_PrintLastErrorStack(stderr);
-        return (int)s;
-    }
-    else
-    {
-        if (DEBUG)
-            printf("Succesfully subscribed to timeline clock parameter topic\n");
-    }
+// Bounds and initial value of the busy-wait window that absorbs the wakeup latency
+#define QOT_WAIT_SPIN_MIN_NS 5000LL
+#define QOT_WAIT_SPIN_MAX_NS 500000LL
+#define QOT_WAIT_SPIN_DEF_NS 50000LL
+#endif
 
-    return NATS_OK;
-}
+/* Private Functions */
 
-/* Un-subscribe to a NATS topic (subject) */
-int TimelineBinding::natsUnSubscribe()
+#ifdef QOT_TIMELINE_SERVICE
+/* Map a clock segment read-only (live parameters and their history) */
+static void* map_clk_segment(int clk_fd)
 {
-    // Anything that is created need to be destroyed
-    if (s == NATS_OK)
-    {
-        natsSubscription_Destroy(sub);
-        natsConnection_Destroy(conn);
-        delete param_buffer;
-    }
-    else if (s != NATS_OK && nats_status_flag == 1)
-    {
-        // Connection went through subscription failed
-        natsConnection_Destroy(conn);
-        delete param_buffer;
-    }
-    param_buffer = NULL;
-    conn = NULL;
-    sub  = NULL;
-    done  = false;
-    return 0;
+    struct stat st;
+    size_t size = sizeof(tl_translation_t);
+    if (fstat(clk_fd, &st) == 0 && size_t(st.st_size) > size)
+        size = st.st_size;
+    return mmap(0, size, PROT_READ, MAP_SHARED, clk_fd, 0);
 }
-
-#endif
 #endif
 
 /* Is the given timeline a valid one */
@@ -179,14 +108,27 @@ qot_return_t TimelineBinding::timeline_check_fd()
 /* Send a message to the socket */
 qot_return_t TimelineBinding::send_message(qot_timeline_msg_t &msg)
 {
-    /* Add dummy aux_data for now, this is a hack */
-    msg.aux_data = std::string("NULL");
+    /* Requests carry no auxiliary data, drop any left from an earlier reply */
+    msg.aux_data.clear();
+
+    /* Binary wire format negotiated with the service */
+    if (wire_format == QOT_TLMSG_BIN_VERSION)
+        return send_message_binary(msg);
+
     /* Serialize Message */
     nlohmann::json data = serialize_tlmsg(msg);
+    bool has_reply = (msg.msgtype != TIMELINE_SHM_CLOCK && msg.msgtype != TIMELINE_OV_SHM_CLOCK);
+
+    // Offer the binary wire format on the first request of the connection, older services ignore the key
+    if (has_reply && !wire_offered)
+    {
+        data["wire"] = QOT_TLMSG_BIN_VERSION;
+        wire_offered = true;
+    }
     std::string msg_string = data.dump();
 
     int bytesSent = send(sock, msg_string.c_str() , msg_string.length(), 0); 
-    if ((msg.msgtype != TIMELINE_SHM_CLOCK && msg.msgtype != TIMELINE_OV_SHM_CLOCK) && bytesSent > 0)
+    if (has_reply && bytesSent > 0)
     {
         const unsigned int MAX_BUF_LENGTH = 4096;
         std::vector<char> buffer(MAX_BUF_LENGTH);
@@ -198,16 +140,24 @@ qot_return_t TimelineBinding::send_message(qot_timeline_msg_t &msg)
             // Append string from buffer.
             if (bytesReceived == -1 && recv_flag == 0) { 
                 return QOT_RETURN_TYPE_ERR;
-            } else {
+            } else if (bytesReceived > 0) {
                 if (DEBUG)
                     printf("Received %d bytes from service\n", bytesReceived);
-                rcv.append( buffer.cbegin(), buffer.cend() );
+                rcv.append( buffer.cbegin(), buffer.cbegin() + bytesReceived );
                 recv_flag = 1;
             }
         } while ( bytesReceived == MAX_BUF_LENGTH );
         /* De-serialize data */
         data = nlohmann::json::parse(rcv);
         deserialize_tlmsg(data, msg);
+
+        // The service accepts the offered format by echoing the version it speaks
+        if (wire_format == 0 && data.count("wire") && data["wire"].get<int>() >= QOT_TLMSG_BIN_VERSION)
+        {
+            wire_format = QOT_TLMSG_BIN_VERSION;
+            if (DEBUG)
+                printf("Timeline service wire format is binary\n");
+        }
         return msg.retval;
     }
     else
@@ -219,80 +169,229 @@ qot_return_t TimelineBinding::send_message(qot_timeline_msg_t &msg)
     return QOT_RETURN_TYPE_ERR;
 }
 
-/* Convert from core time to timeline time */
-qot_return_t TimelineBinding::qot_loc2rem(utimepoint_t &est, int period, int instant_flag)
-{    
-    int64_t val;
+/* Send a message to the socket using the length-prefixed binary wire format */
+qot_return_t TimelineBinding::send_message_binary(qot_timeline_msg_t &msg)
+{
+    std::vector<char> frame(QOT_TLMSG_BIN_SIZE);
+    size_t frame_len = QOT_TLMSG_BIN_SIZE;
+    size_t bytes = 0;
+    bool header_read = false;
+    long length;
+    int bytesReceived;
+
+    if (serialize_tlmsg_binary(msg, &frame[0], frame.size()) < 0)
+        return QOT_RETURN_TYPE_ERR;
+
+    if (send(sock, &frame[0], QOT_TLMSG_BIN_SIZE, 0) != QOT_TLMSG_BIN_SIZE)
+        return QOT_RETURN_TYPE_ERR;
 
-    // Search the circular-buffer cache for the appropriate parameters(if instant_flag not set)
-    #ifdef NATS_SERVICE
-    if (instant_flag == 0)
+    // The service replies with a file descriptor instead of a message
+    if (msg.msgtype == TIMELINE_SHM_CLOCK || msg.msgtype == TIMELINE_OV_SHM_CLOCK)
     {
-        tl_translation_t params;
-        if(param_buffer->FindParams(est.estimate, params) == 0)
-        {
-            // Params found
-            val = TP_TO_nSEC(est.estimate);
+        msg.retval = QOT_RETURN_TYPE_OK;
+        return QOT_RETURN_TYPE_OK;
+    }
 
-            /* Calculate sync uncertainty */
-            int64_t u_bound = (params.u_mult*(val - params.last))/1000000000L + params.u_nsec;
-            int64_t l_bound = (params.l_mult*(val - params.last))/1000000000L + params.l_nsec;
+    // Read exactly one frame, its length comes from the prefix (later versions may send longer frames)
+    while (bytes < frame_len)
+    {
+        bytesReceived = recv(sock, &frame[bytes], frame_len - bytes, 0);
+        if (bytesReceived <= 0)
+            return QOT_RETURN_TYPE_ERR;
+        bytes += bytesReceived;
+        if (header_read || bytes < 8)
+            continue;
+        header_read = true;
+
+        // Replies which do not fit a frame fall back to JSON
+        if (!is_tlmsg_binary(&frame[0], bytes))
+            return recv_message_json(msg, std::string(&frame[0], bytes));
+        length = tlmsg_binary_frame_length(&frame[0], bytes);
+        if (length < 0)
+            return QOT_RETURN_TYPE_ERR;
+        frame_len = length;
+        frame.resize(frame_len);
+    }
 
-            /* Write the uncertainty */
-            TL_FROM_nSEC(est.interval.above, (unsigned long long)u_bound);
-            TL_FROM_nSEC(est.interval.below, (unsigned long long)l_bound);
+    if (deserialize_tlmsg_binary(&frame[0], bytes, msg) < 0)
+        return QOT_RETURN_TYPE_ERR;
 
-            // Check if this is correct -> makes the assumption that val is mostly greater than 1s (1 billion ns) (consider using floating point ops)
-            if (period)
-                val += (params.mult*val)/1000000000L;
-            else
-            {
-                val -= params.last;
-                val  = params.nsec + val + ((params.mult*val)/1000000000L);
-            }
-            TP_FROM_nSEC(est.estimate, val); 
-            return QOT_RETURN_TYPE_OK;
-        }
-        else
-        {
+    return msg.retval;
+}
+
+/* Receive the remainder of a JSON reply whose first bytes were already read */
+qot_return_t TimelineBinding::recv_message_json(qot_timeline_msg_t &msg, std::string rcv)
+{
+    const unsigned int MAX_BUF_LENGTH = 4096;
+    std::vector<char> buffer(MAX_BUF_LENGTH);
+    int bytesReceived;
+
+    // Read until the document is complete (a JSON reply is a single object)
+    while (!nlohmann::json::accept(rcv))
+    {
+        bytesReceived = recv(sock, &buffer[0], buffer.size(), 0);
+        if (bytesReceived <= 0)
             return QOT_RETURN_TYPE_ERR;
-        }
+        rcv.append(buffer.cbegin(), buffer.cbegin() + bytesReceived);
     }
-    #endif
 
-    // If instantaneous flag (get time instantaneously) {if NATS service doe not exist this is the default behaviour}
-    if (!tl_clk_params)
-        return QOT_RETURN_TYPE_ERR;
+    nlohmann::json data = nlohmann::json::parse(rcv);
+    deserialize_tlmsg(data, msg);
+    return msg.retval;
+}
 
-    val = TP_TO_nSEC(est.estimate);
+/* Per-timestamp projections shared by the single and batch conversions (ov is NULL without an overlay).
+   The parameters are prepared once per snapshot, so these take multiplications only */
+static inline int64_t qot_loc2rem_ns(int64_t val, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    val = tl_project(&clk_proj, val);
+    if (ov_proj)
+        val = tl_project(ov_proj, val);
+    return val;
+}
 
-    // Check if this is correct -> makes the assumption that val is mostly greater than 1s (1 billion ns) (consider using floating point ops)
-    if (period)
-        val += (tl_clk_params->mult*val)/1000000000L;
-    else
+static inline int64_t qot_rem2loc_ns(int64_t val, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    if (ov_proj)
+        val = tl_unproject(ov_proj, val);
+    return tl_unproject(&clk_proj, val);
+}
+
+static inline void qot_bounds_ns(int64_t coretime, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj, int64_t &u_bound, int64_t &l_bound)
+{
+    tl_project_bounds(&clk_proj, coretime, &u_bound, &l_bound);
+    if (ov_proj)
     {
-        val -= tl_clk_params->last;
-        val  = tl_clk_params->nsec + val + ((tl_clk_params->mult*val)/1000000000L);
+        // This formula may be incorrect
+        u_bound = u_bound + qot_ns_scale(coretime + u_bound - ov_proj->last, ov_proj->u_rate) + ov_proj->u_nsec;
+        l_bound = l_bound + qot_ns_scale(coretime - l_bound - ov_proj->last, ov_proj->l_rate) + ov_proj->l_nsec;
     }
+}
 
-    // Check if an overlay map exists (indicates local timeline) -> Apply projections
-    if (tl_ov_clk_params)
+/* Projection of a period (a length, no offset) */
+static inline int64_t qot_loc2rem_period_ns(int64_t val, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    val = tl_project_length(&clk_proj, val);
+    if (ov_proj)
+        val = tl_project_length(ov_proj, val);
+    return val;
+}
+
+static inline int64_t qot_rem2loc_period_ns(int64_t val, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    if (ov_proj)
+        val = tl_unproject_length(ov_proj, val);
+    return tl_unproject_length(&clk_proj, val);
+}
+
+/* Prepare a parameter snapshot for projections, returns the overlay projection (NULL without one) */
+static inline const tl_projection_t *qot_prepare_params(const tl_translation_t &clk_params, const tl_translation_t *ov_clk_params,
+                                                        tl_projection_t &clk_proj, tl_projection_t &ov_proj)
+{
+    tl_projection_prepare(&clk_proj, &clk_params);
+    if (!ov_clk_params)
+        return NULL;
+    tl_projection_prepare(&ov_proj, ov_clk_params);
+    return &ov_proj;
+}
+
+/* Prepare the parameters valid at a core time from the histories of the clock and overlay segments,
+   they stay valid for the core times in (from, until]. An overlay that was never published keeps its
+   initial parameters. Returns -1 if the time is older than a history or the clock was never published */
+static int qot_history_params(const tl_translation_t *clk_seg, const tl_translation_t *ov_seg, int64_t core_ns,
+                              tl_projection_t &clk_proj, tl_projection_t &ov_proj, const tl_projection_t *&ov,
+                              int64_t &from, int64_t &until)
+{
+    tl_translation_t params, ov_params;
+    int64_t ov_until = INT64_MAX;
+
+    if (tl_history_find_until(clk_seg, core_ns, &params, &until) < 0)
+        return -1;
+    from = params.last;
+
+    if (ov_seg)
     {
-        if (period)
+        tl_history_t *ov_history = tl_history_get(ov_seg);
+        if (ov_history && __atomic_load_n(&ov_history->head, __ATOMIC_ACQUIRE) > 0)
         {
-            val += tl_ov_clk_params->mult*(val/1000000000L); // different formula for overlay clock
-            //val += int64_t(tl_ov_clk_params->slope*val);
+            if (tl_history_find_until(ov_seg, core_ns, &ov_params, &ov_until) < 0)
+                return -1;
+            from = std::max(from, ov_params.last);
+            until = std::min(until, ov_until);
         }
         else
         {
-            val -= tl_ov_clk_params->last;
-            val  = tl_ov_clk_params->nsec + val + tl_ov_clk_params->mult*(val/1000000000L); // different formula for overlay clock
-            //val += tl_ov_clk_params->nsec + int64_t(tl_ov_clk_params->slope*val);
+            tl_translation_read(ov_seg, &ov_params);
         }
     }
 
+    ov = qot_prepare_params(params, ov_seg ? &ov_params : NULL, clk_proj, ov_proj);
+    return 0;
+}
+
+/* Take a consistent snapshot of the main and overlay clock parameters */
+qot_return_t TimelineBinding::qot_read_params(tl_translation_t &clk_params, tl_translation_t &ov_clk_params)
+{
+    if (!tl_clk_params)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Lock-free seqlock reads, retries if the sync service is mid-update
+    tl_translation_read(tl_clk_params, &clk_params);
+    if (tl_ov_clk_params)
+        tl_translation_read(tl_ov_clk_params, &ov_clk_params);
+
+    return QOT_RETURN_TYPE_OK;
+}
+
+/* Project core time to timeline time using a prepared parameter snapshot */
+void TimelineBinding::qot_project_loc2rem(utimepoint_t &est, int period, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    int64_t val = TP_TO_nSEC(est.estimate);
+
+    // The overlay projection exists on local timelines only
+    if (period)
+        val = qot_loc2rem_period_ns(val, clk_proj, ov_proj);
+    else
+        val = qot_loc2rem_ns(val, clk_proj, ov_proj);
+
     // Convert to timepoint
     TP_FROM_nSEC(est.estimate, val); 
+}
+
+/* Convert from core time to timeline time */
+qot_return_t TimelineBinding::qot_loc2rem(utimepoint_t &est, int period, int instant_flag)
+{    
+    int64_t val;
+    tl_projection_t clk_proj, ov_proj;
+
+    // Search the parameter histories for the parameters valid at the core time (if instant_flag not set)
+    if (instant_flag == 0 && tl_history_get(tl_clk_params))
+    {
+        const tl_projection_t *ov;
+        int64_t from, until;
+        val = TP_TO_nSEC(est.estimate);
+        if (qot_history_params(tl_clk_params, tl_ov_clk_params, val, clk_proj, ov_proj, ov, from, until) < 0)
+            return QOT_RETURN_TYPE_ERR;
+
+        /* Calculate sync uncertainty */
+        int64_t u_bound, l_bound;
+        qot_bounds_ns(val, clk_proj, ov, u_bound, l_bound);
+
+        /* Write the uncertainty */
+        TL_FROM_nSEC(est.interval.above, (unsigned long long)u_bound);
+        TL_FROM_nSEC(est.interval.below, (unsigned long long)l_bound);
+
+        qot_project_loc2rem(est, period, clk_proj, ov);
+        return QOT_RETURN_TYPE_OK;
+    }
+
+    // If instantaneous flag (get time instantaneously) {if the segment has no history this is the default behaviour}
+    tl_translation_t clk_params, ov_clk_params;
+    if (qot_read_params(clk_params, ov_clk_params) != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+
+    const tl_projection_t *ov = qot_prepare_params(clk_params, tl_ov_clk_params ? &ov_clk_params : NULL, clk_proj, ov_proj);
+    qot_project_loc2rem(est, period, clk_proj, ov);
     
     return QOT_RETURN_TYPE_OK;
 }
@@ -301,42 +400,20 @@ qot_return_t TimelineBinding::qot_loc2rem(utimepoint_t &est, int period, int ins
 qot_return_t TimelineBinding::qot_rem2loc(utimepoint_t &est, int period)
 {
     int64_t val;
-    int64_t rem;
+    tl_translation_t clk_params, ov_clk_params;
+    tl_projection_t clk_proj, ov_proj;
 
-    if(!tl_clk_params)
+    if (qot_read_params(clk_params, ov_clk_params) != QOT_RETURN_TYPE_OK)
         return QOT_RETURN_TYPE_ERR;
+    const tl_projection_t *ov = qot_prepare_params(clk_params, tl_ov_clk_params ? &ov_clk_params : NULL, clk_proj, ov_proj);
 
     val = TP_TO_nSEC(est.estimate);
 
-    // Check if an overlay map exists (indicates local timeline) -> Apply projections
-    if (tl_ov_clk_params)
-    {
-        if (period)
-        {
-            val = (int64_t)floor(((double)val/(double)(tl_ov_clk_params->mult + 1000000000LL))*1000000000LL);
-            //val = (int64_t)floor((double)val/(double)(tl_ov_clk_params->slope + 1));
-        }
-        else
-        {
-            int64_t diff = (val - tl_ov_clk_params->nsec);
-            int64_t quot = (int64_t)floor(((double)diff/(double)(tl_ov_clk_params->mult + 1000000000LL))*1000000000LL);
-            val = tl_ov_clk_params->last + quot; 
-            //val = (int64_t)floor((double)diff/(double)(tl_ov_clk_params->slope + 1));
-        }
-        // printf("Overlay Clock Parameters %lld %lld %lld\n", (long long)tl_ov_clk_params->mult, (long long)tl_ov_clk_params->last, (long long)tl_ov_clk_params->nsec);
-        // printf("Main Clock Parameters    %lld %lld %lld\n", (long long)tl_clk_params->mult, (long long)tl_clk_params->last, (long long)tl_clk_params->nsec);
-    }
-
+    // The overlay projection exists on local timelines only
     if (period)
-    {
-        val = (int64_t)floor(((double)val/(double)(tl_clk_params->mult + 1000000000LL))*1000000000LL);
-    }
+        val = qot_rem2loc_period_ns(val, clk_proj, ov);
     else
-    {
-        int64_t diff = (val - tl_clk_params->nsec);
-        int64_t quot = (int64_t)floor(((double)diff/(double)(tl_clk_params->mult + 1000000000LL))*1000000000LL);
-        val = tl_clk_params->last + quot; 
-    }
+        val = qot_rem2loc_ns(val, clk_proj, ov);
 
     // Convert to timepoint
     TP_FROM_nSEC(est.estimate, val); 
@@ -345,30 +422,21 @@ qot_return_t TimelineBinding::qot_rem2loc(utimepoint_t &est, int period)
 }
 
 /* Private implementation function to compute the timestamp uncertainty */
-qot_return_t TimelineBinding::timeline_computeqot(utimepoint_t &est)
+qot_return_t TimelineBinding::timeline_computeqot(utimepoint_t &est, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
 {
-    long long coretime;
-    long long u_bound;
-    long long l_bound;
+    int64_t coretime;
+    int64_t u_bound;
+    int64_t l_bound;
 
     coretime = TP_TO_nSEC(est.estimate);
-    /* Calculate sync uncertainty */
-    u_bound = (tl_clk_params->u_mult*(coretime - tl_clk_params->last))/1000000000L + tl_clk_params->u_nsec;
-    l_bound = (tl_clk_params->l_mult*(coretime - tl_clk_params->last))/1000000000L + tl_clk_params->l_nsec;
-
-    // Check if an overlay map exists (indicates local timeline) -> Apply projections
-    if (tl_ov_clk_params)
-    {
-        // This formula may be incorrect
-        u_bound = u_bound + (tl_ov_clk_params->u_mult*(coretime + u_bound - tl_ov_clk_params->last))/1000000000L + tl_ov_clk_params->u_nsec;
-        l_bound = l_bound + (tl_ov_clk_params->l_mult*(coretime - l_bound - tl_ov_clk_params->last))/1000000000L + tl_ov_clk_params->l_nsec;
-    }
+    /* Calculate sync uncertainty (overlay included if it exists) */
+    qot_bounds_ns(coretime, clk_proj, ov_proj, u_bound, l_bound);
 
     if (DEBUG)
     {
         printf("Uncertainty Values\n");
-        printf("Upper Bound %lld %lld\n", (long long)u_bound, (long long)tl_clk_params->u_nsec);
-        printf("Lower Bound %lld %lld\n", (long long)l_bound, (long long)tl_clk_params->l_nsec);
+        printf("Upper Bound %lld %lld\n", (long long)u_bound, (long long)clk_proj.u_nsec);
+        printf("Lower Bound %lld %lld\n", (long long)l_bound, (long long)clk_proj.l_nsec);
     }
 
     /* Write the uncertainty */
@@ -381,20 +449,190 @@ qot_return_t TimelineBinding::timeline_computeqot(utimepoint_t &est)
 /* Private implementation function to compute the current timeline time */
 qot_return_t TimelineBinding::timeline_getvtime(utimepoint_t &est)
 {
-    // This function should be populated (use timeline->timeline_clock to translate from core time): URGENT
-    qot_return_t retval;
-    timeline_getcoretime(est);
+    // Uncertainty and projection are computed from the same parameter snapshot,
+    // re-read if the parameters are republished around the core clock read
+    tl_translation_t clk_params, ov_clk_params;
+    tl_projection_t clk_proj, ov_proj;
+    do {
+        if (qot_read_params(clk_params, ov_clk_params) != QOT_RETURN_TYPE_OK)
+            return QOT_RETURN_TYPE_ERR;
+        timeline_getcoretime(est);
+    } while (tl_translation_changed(tl_clk_params, &clk_params) ||
+             (tl_ov_clk_params && tl_translation_changed(tl_ov_clk_params, &ov_clk_params)));
     if (DEBUG)
     {
         printf("Reading time using shared memory\n");
         printf("Timeline Parameters are mult:%lld last:%lld\n", 
-            (long long)tl_clk_params->mult, 
-            (long long)tl_clk_params->last);
+            (long long)clk_params.mult, 
+            (long long)clk_params.last);
     }
-    retval = timeline_computeqot(est);
-    retval = qot_loc2rem(est, 0, 1);
+    const tl_projection_t *ov = qot_prepare_params(clk_params, tl_ov_clk_params ? &ov_clk_params : NULL, clk_proj, ov_proj);
+    timeline_computeqot(est, clk_proj, ov);
+    qot_project_loc2rem(est, 0, clk_proj, ov);
+    return QOT_RETURN_TYPE_OK;
+}
+
+/* Read the core clock in nanoseconds */
+static int64_t qot_core_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/* Block until a timeline time: sleep on the parameter futex in bounded chunks, re-projecting
+   the deadline on every update, then spin for the last few microseconds. On success utp is
+   the timeline time reached, on failure it is left untouched */
+qot_return_t TimelineBinding::timeline_wait_deadline(utimepoint_t &utp)
+{
+    int64_t target = TP_TO_nSEC(utp.estimate);
+    int64_t core_deadline, sleep_until, now, spin_ns;
+    uint64_t version;
+    u32 *wait_word, wait_seq;
+    struct timespec request;
+    bool resleep;
+
+    if (!tl_clk_params)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Updates of the main and the overlay parameters both move the wait word
+    wait_word = tl_translation_wait_word(tl_clk_params);
+
+    do
+    {
+        while (true)
+        {
+            // Wait word, then version, so an update racing with the projection is not missed
+            wait_seq = __atomic_load_n(wait_word, __ATOMIC_ACQUIRE);
+            version = qot_params_version();
+            if (qot_timer_project(target, core_deadline) != QOT_RETURN_TYPE_OK)
+                return QOT_RETURN_TYPE_ERR;
+
+            now = qot_core_now();
+            sleep_until = core_deadline - wait_spin_ns.load(std::memory_order_relaxed);
+            if (sleep_until <= now)
+                break;
+            if (sleep_until > now + QOT_WAIT_CHUNK_NS)
+                sleep_until = now + QOT_WAIT_CHUNK_NS;
+            request.tv_sec = sleep_until / 1000000000LL;
+            request.tv_nsec = sleep_until % 1000000000LL;
+
+            // Returns early if the sync service publishes new parameters (writers only wake registered waiters).
+            // The segment is mapped read-only, without a wait slot we cannot register and sleep the chunk instead
+            if (wait_word == &tl_clk_params->seq)
+            {
+                clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &request, NULL);
+            }
+            else
+            {
+                tl_translation_wait_enter(tl_clk_params);
+                syscall(SYS_futex, wait_word, FUTEX_WAIT_BITSET | FUTEX_CLOCK_REALTIME,
+                        wait_seq, &request, NULL, FUTEX_BITSET_MATCH_ANY);
+                tl_translation_wait_exit(tl_clk_params);
+            }
+
+            // Timed out -> calibrate the spin window to twice the average oversleep (waits may run concurrently)
+            now = qot_core_now();
+            if (now >= sleep_until && qot_params_version() == version)
+            {
+                int64_t updated;
+                spin_ns = wait_spin_ns.load(std::memory_order_relaxed);
+                do {
+                    updated = (7*spin_ns + 2*(now - sleep_until))/8;
+                    if (updated < QOT_WAIT_SPIN_MIN_NS)
+                        updated = QOT_WAIT_SPIN_MIN_NS;
+                    else if (updated > QOT_WAIT_SPIN_MAX_NS)
+                        updated = QOT_WAIT_SPIN_MAX_NS;
+                } while (!wait_spin_ns.compare_exchange_weak(spin_ns, updated, std::memory_order_relaxed));
+            }
+        }
+
+        // Spin through the final microseconds, still following parameter updates
+        resleep = false;
+        while (!resleep && qot_core_now() < core_deadline)
+        {
+            if (qot_params_version() != version)
+            {
+                version = qot_params_version();
+                if (qot_timer_project(target, core_deadline) != QOT_RETURN_TYPE_OK)
+                    return QOT_RETURN_TYPE_ERR;
+                // Deadline moved out of the spin window -> go back to sleeping
+                resleep = (core_deadline - qot_core_now() > wait_spin_ns.load(std::memory_order_relaxed));
+            }
+        }
+    } while (resleep);
+
+    // Report the timeline time actually reached (estimate - target is the wakeup error)
+    utimepoint_t reached = utp;
+    qot_return_t retval = timeline_getvtime(reached);
+    if (retval == QOT_RETURN_TYPE_OK)
+        utp = reached;
     return retval;
 }
+
+/* Project a timeline deadline to core time */
+qot_return_t TimelineBinding::qot_timer_project(int64_t tl_ns, int64_t &core_ns)
+{
+    utimepoint_t utp;
+    TP_FROM_nSEC(utp.estimate, tl_ns);
+    if (qot_rem2loc(utp, 0) != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+    core_ns = TP_TO_nSEC(utp.estimate);
+    return QOT_RETURN_TYPE_OK;
+}
+
+/* Version of the clock parameters, changes on every seqlock update */
+uint64_t TimelineBinding::qot_params_version()
+{
+    uint64_t version = 0;
+    if (tl_clk_params)
+        version = (uint64_t)__atomic_load_n(&tl_clk_params->seq, __ATOMIC_ACQUIRE) << 32;
+    if (tl_ov_clk_params)
+        version |= __atomic_load_n(&tl_ov_clk_params->seq, __ATOMIC_ACQUIRE);
+    return version;
+}
+
+/* Create the timer wheel on first use, caller holds timer_lock */
+qot_return_t TimelineBinding::timer_wheel_start()
+{
+    if (timer_wheel)
+        return QOT_RETURN_TYPE_OK;
+
+    // Timers and asynchronous waits share one wheel, serviced by the dispatch thread of the process
+    timer_wheel = new TimelineTimerWheel(
+        std::bind(&TimelineBinding::qot_timer_project, this, std::placeholders::_1, std::placeholders::_2),
+        std::bind(&TimelineBinding::qot_params_version, this), tl_clk_params);
+    if (timer_wheel->query_status_flag() != 0)
+    {
+        delete timer_wheel;
+        timer_wheel = NULL;
+        return QOT_RETURN_TYPE_ERR;
+    }
+    return QOT_RETURN_TYPE_OK;
+}
+
+/* Stop the timer wheel (must not be called from a timer handler), pending waits complete with an error */
+void TimelineBinding::timer_wheel_stop()
+{
+    TimelineTimerWheel *wheel;
+    std::set<async_wait*> waits;
+
+    timer_lock.lock();
+    wheel = timer_wheel;
+    timer_wheel = NULL;
+    waits.swap(async_waits);
+    timer_lock.unlock();
+
+    // Waits for the handlers of the wheel that are running, they find their wait gone
+    if (wheel)
+        delete wheel;
+
+    for (std::set<async_wait*>::iterator it = waits.begin(); it != waits.end(); ++it)
+    {
+        (*it)->handler(QOT_RETURN_TYPE_ERR, (*it)->utp);
+        delete *it;
+    }
+}
 #endif
 
 /* Public Functions */
@@ -406,7 +644,6 @@ TimelineBinding::TimelineBinding()
     #ifdef QOT_TIMELINE_SERVICE
     // Initialize the socket connection
     struct sockaddr_un server;
-    char buf[1024];
 
     sock = socket(AF_UNIX, SOCK_STREAM, 0);
     if (sock < 0) {
@@ -421,13 +658,14 @@ TimelineBinding::TimelineBinding()
         sleep(2);
     }
 
+    // The binary wire format is offered with the first request
+    wire_format = 0;
+    wire_offered = false;
+
     tl_clk_params = NULL;
     tl_ov_clk_params = NULL;
-
-    #ifdef NATS_SERVICE
-    param_buffer = NULL;
-    nats_status_flag = 0;
-    #endif
+    timer_wheel = NULL;
+    wait_spin_ns = QOT_WAIT_SPIN_DEF_NS;
 
     #endif
 }
@@ -439,7 +677,6 @@ TimelineBinding::TimelineBinding(int timeout_seconds)
     #ifdef QOT_TIMELINE_SERVICE
     // Initialize the socket connection
     struct sockaddr_un server;
-    char buf[1024];
 
     sock = socket(AF_UNIX, SOCK_STREAM, 0);
     if (sock < 0) {
@@ -460,13 +697,14 @@ TimelineBinding::TimelineBinding(int timeout_seconds)
         }
     }
 
+    // The binary wire format is offered with the first request
+    wire_format = 0;
+    wire_offered = false;
+
     tl_clk_params = NULL;
     tl_ov_clk_params = NULL;
-
-    #ifdef NATS_SERVICE
-    param_buffer = NULL;
-    nats_status_flag = 0;
-    #endif
+    timer_wheel = NULL;
+    wait_spin_ns = QOT_WAIT_SPIN_DEF_NS;
 
     #endif
 }
@@ -475,6 +713,7 @@ TimelineBinding::TimelineBinding(int timeout_seconds)
 TimelineBinding::~TimelineBinding()
 {
     #ifdef QOT_TIMELINE_SERVICE
+    timer_wheel_stop();
     if (status_flag == 0)
         close(sock);
     #endif
@@ -631,7 +870,8 @@ qot_return_t TimelineBinding::timeline_bind(const std::string uuid, const std::s
         printf("Received timeline clock shm descriptor = %d\n", clk_fd);
 
     // Map the shared memory region into the memory space
-    clk_shm_base = mmap(0, sizeof(tl_translation_t), PROT_READ, MAP_SHARED, clk_fd, 0);
+    clk_shm_base = map_clk_segment(clk_fd);
+    close(clk_fd);  // The mapping outlives the descriptor
     if (clk_shm_base == MAP_FAILED) {
         printf("Shared memory mmap failed: \n");
         clk_shm_base = NULL;
@@ -701,7 +941,8 @@ qot_return_t TimelineBinding::timeline_bind(const std::string uuid, const std::s
             printf("Received timeline overlay clock shm descriptor = %d\n", clk_fd);
 
         // Map the shared memory region into the memory space
-        clk_shm_base = mmap(0, sizeof(tl_translation_t), PROT_READ, MAP_SHARED, clk_fd, 0);
+        clk_shm_base = map_clk_segment(clk_fd);
+        close(clk_fd);
         if (clk_shm_base == MAP_FAILED) {
             printf("Shared memory mmap failed: \n");
             clk_shm_base = NULL;
@@ -772,24 +1013,6 @@ qot_return_t TimelineBinding::timeline_bind(const std::string uuid, const std::s
         timeline.binding = tl_msg.binding;
     }
 
-    #ifdef NATS_SERVICE
-    // Open the connection to the NATS server
-    conn = NULL;
-    sub  = NULL;
-    done  = false;
-
-    // Construct the topic name
-    std::string nats_subject = "qot.timeline.";
-    nats_subject.append(uuid);
-    nats_subject.append(std::string(".params"));
-
-    if (natsSubscribe(nats_subject) != NATS_OK)
-    {
-        perror("unable to connect to NATS server");
-    }
-
-    #endif
-
     #else
     // Bind to the timeline
     if(ioctl(timeline.fd, TIMELINE_BIND_JOIN, &timeline.binding) < 0)
@@ -834,12 +1057,15 @@ qot_return_t TimelineBinding::timeline_unbind()
 
     // Try to destroy the timeline if possible (will destroy if no other bindings exist)
     #ifdef QOT_TIMELINE_SERVICE
+    // Stop the timers and waits before the parameters they project with go away
+    timer_wheel_stop();
+
     // Unmap the shared memory locations
-    munmap((void*)tl_clk_params, sizeof(tl_translation_t));
+    munmap((void*)tl_clk_params, tl_clock_segment_size(tl_clk_params));
     tl_clk_params = NULL;
     if (timeline.info.type == QOT_TIMELINE_LOCAL)
     {
-        munmap((void*)tl_ov_clk_params, sizeof(tl_translation_t));
+        munmap((void*)tl_ov_clk_params, tl_clock_segment_size(tl_ov_clk_params));
         tl_ov_clk_params = NULL;
     }
 
@@ -858,11 +1084,6 @@ qot_return_t TimelineBinding::timeline_unbind()
         return QOT_RETURN_TYPE_ERR;
     }
 
-    #ifdef NATS_SERVICE
-    // Close the connection to the NATS server
-    natsUnSubscribe();
-    #endif
-
     #else
     if(ioctl(timeline.qotusr_fd, QOTUSR_DESTROY_TIMELINE, &timeline.info) == 0)
     {
@@ -1063,19 +1284,10 @@ qot_return_t TimelineBinding::timeline_waituntil(utimepoint_t& utp)
     
     // Blocking wait on remote timeline time
     #ifdef QOT_TIMELINE_SERVICE
-    struct timespec request;
-    struct timespec remain;
-    
-    // Translate and wait on CLOCK_REALTIME -> The translation may change later .. 
-    if (qot_rem2loc(utp, 0) == QOT_RETURN_TYPE_ERR)
-        return QOT_RETURN_TYPE_ERR;
-
-    timespec_from_timepoint(&request, &utp.estimate);
-
-    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &request, &remain);
-
-    // Add some time estimation logic on wakeup -> TBD
-
+    // Wait on CLOCK_REALTIME, re-projecting if the translation changes
+    qot_return_t retval = timeline_wait_deadline(sleeper.wait_until_time);
+    if (retval != QOT_RETURN_TYPE_OK)
+        return retval;
     #else 
     if(ioctl(timeline.qotusr_fd, QOTUSR_WAIT_UNTIL, &sleeper) < 0)
     {
@@ -1086,14 +1298,40 @@ qot_return_t TimelineBinding::timeline_waituntil(utimepoint_t& utp)
     return QOT_RETURN_TYPE_OK;
 }
 
-qot_return_t TimelineBinding::timeline_waituntil_nextperiod(utimepoint_t& utp) 
+/* Next wakeup of the periodic scheduling parameters at or after a timeline time */
+void TimelineBinding::timeline_next_wakeup(utimepoint_t &utp)
 {
-    qot_sleeper_t sleeper;
     timelength_t elapsed_time;
     timepoint_t wakeup_time;
     u64 elapsed_ns = 0;
     u64 period_ns = 0;
     u64 num_periods = 0;
+
+    // Check Start Offset
+    if(timepoint_cmp(&timeline.binding.start_offset, &utp.estimate) < 0)
+    {
+        utp.estimate = timeline.binding.start_offset;
+    }
+    else 
+    {
+        // Calculate Next Wakeup Time
+        timepoint_diff(&elapsed_time, &utp.estimate, &timeline.binding.start_offset);
+        elapsed_ns = TL_TO_nSEC(elapsed_time);
+        period_ns = TL_TO_nSEC(timeline.binding.period);
+        num_periods = (elapsed_ns/period_ns);
+        if(elapsed_ns % period_ns != 0)
+            num_periods++;
+        elapsed_ns = period_ns*num_periods;
+        TL_FROM_nSEC(elapsed_time, elapsed_ns);
+        wakeup_time = timeline.binding.start_offset;
+        timepoint_add(&wakeup_time, &elapsed_time);
+        utp.estimate = wakeup_time;
+    }
+}
+
+qot_return_t TimelineBinding::timeline_waituntil_nextperiod(utimepoint_t& utp) 
+{
+    qot_sleeper_t sleeper;
     
     #ifndef QOT_TIMELINE_SERVICE
     if (fcntl(timeline.fd, F_GETFD)==-1)
@@ -1114,41 +1352,15 @@ qot_return_t TimelineBinding::timeline_waituntil_nextperiod(utimepoint_t& utp)
         return QOT_RETURN_TYPE_ERR;
     }
     #endif
-    // Check Start Offset
-    if(timepoint_cmp(&timeline.binding.start_offset, &sleeper.wait_until_time.estimate) < 0)
-    {
-        sleeper.wait_until_time.estimate = timeline.binding.start_offset;
-    }
-    else 
-    {
-        // Calculate Next Wakeup Time
-        timepoint_diff(&elapsed_time, &sleeper.wait_until_time.estimate, &timeline.binding.start_offset);
-        elapsed_ns = TL_TO_nSEC(elapsed_time);
-        period_ns = TL_TO_nSEC(timeline.binding.period);
-        num_periods = (elapsed_ns/period_ns);
-        if(elapsed_ns % period_ns != 0)
-            num_periods++;
-        elapsed_ns = period_ns*num_periods;
-        TL_FROM_nSEC(elapsed_time, elapsed_ns);
-        wakeup_time = timeline.binding.start_offset;
-        timepoint_add(&wakeup_time, &elapsed_time);
-        sleeper.wait_until_time.estimate = wakeup_time;
-     }
+    // Next wakeup after the current time
+    timeline_next_wakeup(sleeper.wait_until_time);
 
     // Blocking wait on remote timeline time
     #ifdef QOT_TIMELINE_SERVICE
-    struct timespec request;
-    struct timespec remain;
-    // Translate and wait on CLOCK_REALTIME -> The translation may change later .. 
-    if (qot_rem2loc(sleeper.wait_until_time, 0) == QOT_RETURN_TYPE_ERR)
-        return QOT_RETURN_TYPE_ERR;
-
-    timespec_from_timepoint(&request, &sleeper.wait_until_time.estimate);
-
-    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &request, &remain);
-
-    // Add some time estimation logic on wakeup -> TBD
-
+    // Wait on CLOCK_REALTIME, re-projecting if the translation changes
+    qot_return_t retval = timeline_wait_deadline(sleeper.wait_until_time);
+    if (retval != QOT_RETURN_TYPE_OK)
+        return retval;
     #else 
     if(ioctl(timeline.qotusr_fd, QOTUSR_WAIT_UNTIL, &sleeper) < 0)
     {
@@ -1186,18 +1398,10 @@ qot_return_t TimelineBinding::timeline_sleep(utimelength_t& utl)
     
     // Blocking wait on remote timeline time
     #ifdef QOT_TIMELINE_SERVICE
-    struct timespec request;
-    struct timespec remain;
-    // Translate and wait on CLOCK_REALTIME -> The translation may change later .. 
-    if (qot_rem2loc(sleeper.wait_until_time, 1) == QOT_RETURN_TYPE_ERR)
-        return QOT_RETURN_TYPE_ERR;
-
-    timespec_from_timepoint(&request, &sleeper.wait_until_time.estimate);
-
-    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &request, &remain);
-
-    // Add some time estimation logic on wakeup -> TBD
-
+    // Wait on CLOCK_REALTIME, re-projecting if the translation changes
+    qot_return_t retval = timeline_wait_deadline(sleeper.wait_until_time);
+    if (retval != QOT_RETURN_TYPE_OK)
+        return retval;
     #else 
     if(ioctl(timeline.qotusr_fd, QOTUSR_WAIT_UNTIL, &sleeper) < 0)
     {
@@ -1208,6 +1412,66 @@ qot_return_t TimelineBinding::timeline_sleep(utimelength_t& utl)
     return QOT_RETURN_TYPE_OK;
 }
 
+#ifdef QOT_TIMELINE_SERVICE
+qot_return_t TimelineBinding::timeline_waituntil_async(const utimepoint_t& utp, qot_wait_handler_t handler)
+{
+    std::lock_guard<std::mutex> lock(timer_lock);
+    if (!tl_clk_params || !handler)
+        return QOT_RETURN_TYPE_ERR;
+    if (timer_wheel_start() != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Each wait is a one-shot timer keyed by its own record, so many waits share the wheel
+    int64_t deadline_ns = TP_TO_nSEC(utp.estimate);
+    async_wait *wait = new async_wait;
+    wait->utp = utp;
+    wait->handler = handler;
+    qot_return_t retval = timer_wheel->add_timer(wait, deadline_ns, 0, 1,
+        [this, wait]() {
+            timer_lock.lock();
+            size_t pending = async_waits.erase(wait);
+            timer_lock.unlock();
+            // Already failed by an unbind
+            if (!pending)
+                return;
+            // Report the timeline time actually reached (estimate - target is the wakeup error)
+            utimepoint_t reached = wait->utp;
+            qot_return_t retval = timeline_getvtime(reached);
+            wait->handler(retval, reached);
+            delete wait;
+        });
+    if (retval != QOT_RETURN_TYPE_OK)
+    {
+        delete wait;
+        return retval;
+    }
+    async_waits.insert(wait);
+    return QOT_RETURN_TYPE_OK;
+}
+
+qot_return_t TimelineBinding::timeline_waituntil_nextperiod_async(qot_wait_handler_t handler)
+{
+    utimepoint_t utp;
+    if (timeline_getvtime(utp) == QOT_RETURN_TYPE_ERR)
+        return QOT_RETURN_TYPE_ERR;
+    timeline_next_wakeup(utp);
+    return timeline_waituntil_async(utp, handler);
+}
+
+qot_return_t TimelineBinding::timeline_sleep_async(const utimelength_t& utl, qot_wait_handler_t handler)
+{
+    utimepoint_t utp;
+    if (timeline_getvtime(utp) == QOT_RETURN_TYPE_ERR)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Convert timelength to a timepoint
+    timelength_t length = utl.estimate;
+    utp.interval = utl.interval;
+    timepoint_add(&utp.estimate, &length);
+    return timeline_waituntil_async(utp, handler);
+}
+#endif
+
 qot_return_t TimelineBinding::timeline_timer_create(qot_timer_t& timer, qot_timer_callback_t callback) 
 {
     struct sigaction act;
@@ -1219,8 +1483,27 @@ qot_return_t TimelineBinding::timeline_timer_create(qot_timer_t& timer, qot_time
 
     // Create a timer
     #ifdef QOT_TIMELINE_SERVICE
-    // TBD ...
-    return QOT_RETURN_TYPE_ERR;
+    if (!tl_clk_params || !callback)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Timers share one wheel, callbacks run on the dispatch thread of the process
+    std::lock_guard<std::mutex> lock(timer_lock);
+    if (timer_wheel_start() != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+
+    // Callback gets the same arguments as a SIGALRM delivery, with the timer in si_value
+    qot_timer_t *timer_ptr = &timer;
+    int64_t start_ns = TP_TO_nSEC(timer.start_offset);
+    int64_t period_ns = TL_TO_nSEC(timer.period);
+    return timer_wheel->add_timer(timer_ptr, start_ns, period_ns, timer.count,
+        [callback, timer_ptr]() {
+            siginfo_t si;
+            memset(&si, 0, sizeof(si));
+            si.si_signo = SIGALRM;
+            si.si_code = SI_TIMER;
+            si.si_value.sival_ptr = timer_ptr;
+            callback(SIGALRM, &si, NULL);
+        });
     #else 
     if(ioctl(timeline.fd, TIMELINE_CREATE_TIMER, &timer) < 0)
     {
@@ -1252,10 +1535,12 @@ qot_return_t TimelineBinding::timeline_timer_cancel(qot_timer_t& timer)
         return QOT_RETURN_TYPE_ERR;
     #endif
 
-    // Create a timer
+    // Cancel a timer
     #ifdef QOT_TIMELINE_SERVICE
-    // TBD ...
-    return QOT_RETURN_TYPE_ERR;
+    std::lock_guard<std::mutex> lock(timer_lock);
+    if (!timer_wheel)
+        return QOT_RETURN_TYPE_ERR;
+    return timer_wheel->cancel_timer(&timer);
     #else 
     if(ioctl(timeline.fd, TIMELINE_DESTROY_TIMER, &timer) < 0)
     {
@@ -1279,6 +1564,8 @@ qot_return_t TimelineBinding::timeline_core2rem(timepoint_t& est)
     utimepoint_t utp;
     utp.estimate = est;
     retval = qot_loc2rem(utp, 0, 0);
+    if (retval != QOT_RETURN_TYPE_OK)
+        return retval;
     est = utp.estimate; 
     #else 
     if(ioctl(timeline.fd, TIMELINE_CORE_TO_REMOTE, &est) < 0)
@@ -1303,6 +1590,8 @@ qot_return_t TimelineBinding::timeline_rem2core(timepoint_t& est)
     utimepoint_t utp;
     utp.estimate = est;
     retval = qot_rem2loc(utp, 0);
+    if (retval != QOT_RETURN_TYPE_OK)
+        return retval;
     est = utp.estimate; 
     #else 
     if(ioctl(timeline.fd, TIMELINE_REMOTE_TO_CORE, &est) < 0)
@@ -1312,4 +1601,153 @@ qot_return_t TimelineBinding::timeline_rem2core(timepoint_t& est)
     #endif
     
     return QOT_RETURN_TYPE_OK;
-}
\ No newline at end of file
+}
+
+/* Batch kernels: the per-timestamp helpers in tight loops (bit-exact with the single conversions),
+   also compiled for AVX2 where the compiler supports function multi-versioning */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define QOT_BATCH_KERNEL __attribute__((target_clones("avx2","default")))
+#else
+#define QOT_BATCH_KERNEL
+#endif
+
+#ifdef QOT_TIMELINE_SERVICE
+QOT_BATCH_KERNEL
+static void qot_batch_bounds(const int64_t *core_ns, int64_t *u_bound, int64_t *l_bound, size_t count,
+                             const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    for (size_t i = 0; i < count; i++)
+        qot_bounds_ns(core_ns[i], clk_proj, ov_proj, u_bound[i], l_bound[i]);
+}
+
+QOT_BATCH_KERNEL
+static void qot_batch_loc2rem(const int64_t *core_ns, int64_t *tl_ns, size_t count,
+                              const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    for (size_t i = 0; i < count; i++)
+        tl_ns[i] = qot_loc2rem_ns(core_ns[i], clk_proj, ov_proj);
+}
+
+QOT_BATCH_KERNEL
+static void qot_batch_rem2loc(const int64_t *tl_ns, int64_t *core_ns, size_t count,
+                              const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    for (size_t i = 0; i < count; i++)
+        core_ns[i] = qot_rem2loc_ns(tl_ns[i], clk_proj, ov_proj);
+}
+#endif
+
+/* Uncertainty bounds of a batch of core times, either output may be NULL */
+#ifdef QOT_TIMELINE_SERVICE
+static void qot_batch_bounds_opt(const int64_t *core_ns, int64_t *u_bound, int64_t *l_bound, size_t count,
+                                 const tl_projection_t &clk_proj, const tl_projection_t *ov_proj)
+{
+    int64_t ub, lb;
+    if (u_bound && l_bound)
+    {
+        qot_batch_bounds(core_ns, u_bound, l_bound, count, clk_proj, ov_proj);
+        return;
+    }
+    if (!u_bound && !l_bound)
+        return;
+    for (size_t i = 0; i < count; i++)
+    {
+        qot_bounds_ns(core_ns[i], clk_proj, ov_proj, ub, lb);
+        if (u_bound)
+            u_bound[i] = ub;
+        else
+            l_bound[i] = lb;
+    }
+}
+#endif
+
+qot_return_t TimelineBinding::timeline_core2rem_batch(const int64_t *core_ns, int64_t *tl_ns, int64_t *u_bound, int64_t *l_bound, size_t count)
+{
+    if (!core_ns || !tl_ns)
+        return QOT_RETURN_TYPE_ERR;
+
+    #ifdef QOT_TIMELINE_SERVICE
+    tl_translation_t clk_params, ov_clk_params;
+    tl_projection_t clk_proj, ov_proj;
+    const tl_projection_t *ov;
+
+    // Like timeline_core2rem, the core times are converted with the parameters valid at them:
+    // runs of core times covered by the same history entries are projected together
+    if (tl_clk_params && tl_history_get(tl_clk_params))
+    {
+        size_t i = 0, j;
+        int64_t from, until;
+        while (i < count)
+        {
+            if (qot_history_params(tl_clk_params, tl_ov_clk_params, core_ns[i], clk_proj, ov_proj, ov, from, until) < 0)
+                return QOT_RETURN_TYPE_ERR;
+            for (j = i + 1; j < count && core_ns[j] > from && core_ns[j] <= until; j++)
+                ;
+
+            // Bounds are computed before the projection as the output may overwrite the input
+            qot_batch_bounds_opt(core_ns + i, u_bound ? u_bound + i : NULL, l_bound ? l_bound + i : NULL, j - i, clk_proj, ov);
+            qot_batch_loc2rem(core_ns + i, tl_ns + i, j - i, clk_proj, ov);
+            i = j;
+        }
+        return QOT_RETURN_TYPE_OK;
+    }
+
+    if (qot_read_params(clk_params, ov_clk_params) != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+    ov = qot_prepare_params(clk_params, tl_ov_clk_params ? &ov_clk_params : NULL, clk_proj, ov_proj);
+
+    // Bounds are computed before the projection as the output may overwrite the input
+    qot_batch_bounds_opt(core_ns, u_bound, l_bound, count, clk_proj, ov);
+    qot_batch_loc2rem(core_ns, tl_ns, count, clk_proj, ov);
+    #else
+    // The conversion ioctl returns no uncertainty, so bounds cannot be provided in kernel mode
+    if (u_bound || l_bound)
+        return QOT_RETURN_TYPE_ERR;
+
+    // No shared parameters in kernel mode -> one ioctl per timestamp
+    timepoint_t tp;
+    for (size_t i = 0; i < count; i++)
+    {
+        TP_FROM_nSEC(tp, core_ns[i]);
+        if (timeline_core2rem(tp) != QOT_RETURN_TYPE_OK)
+            return QOT_RETURN_TYPE_ERR;
+        tl_ns[i] = TP_TO_nSEC(tp);
+    }
+    #endif
+
+    return QOT_RETURN_TYPE_OK;
+}
+
+qot_return_t TimelineBinding::timeline_rem2core_batch(const int64_t *tl_ns, int64_t *core_ns, int64_t *u_bound, int64_t *l_bound, size_t count)
+{
+    if (!tl_ns || !core_ns)
+        return QOT_RETURN_TYPE_ERR;
+
+    #ifdef QOT_TIMELINE_SERVICE
+    tl_translation_t clk_params, ov_clk_params;
+    tl_projection_t clk_proj, ov_proj;
+    if (qot_read_params(clk_params, ov_clk_params) != QOT_RETURN_TYPE_OK)
+        return QOT_RETURN_TYPE_ERR;
+    const tl_projection_t *ov = qot_prepare_params(clk_params, tl_ov_clk_params ? &ov_clk_params : NULL, clk_proj, ov_proj);
+
+    // Bounds of the timeline estimate at the converted core times (computed after, tl_ns may alias core_ns)
+    qot_batch_rem2loc(tl_ns, core_ns, count, clk_proj, ov);
+    qot_batch_bounds_opt(core_ns, u_bound, l_bound, count, clk_proj, ov);
+    #else
+    // The conversion ioctl returns no uncertainty, so bounds cannot be provided in kernel mode
+    if (u_bound || l_bound)
+        return QOT_RETURN_TYPE_ERR;
+
+    // No shared parameters in kernel mode -> one ioctl per timestamp
+    timepoint_t tp;
+    for (size_t i = 0; i < count; i++)
+    {
+        TP_FROM_nSEC(tp, tl_ns[i]);
+        if (timeline_rem2core(tp) != QOT_RETURN_TYPE_OK)
+            return QOT_RETURN_TYPE_ERR;
+        core_ns[i] = TP_TO_nSEC(tp);
+    }
+    #endif
+
+    return QOT_RETURN_TYPE_OK;
+}
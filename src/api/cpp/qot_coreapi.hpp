@@ -31,25 +31,27 @@
 #define QOT_STACK_CORE_API_CPP_QOT_H
 
 #include <string>
+#include <set>
+#include <mutex>
+#include <atomic>
+
+#include <signal.h>
 
 /* Include basic types, time math and ioctl interface */
 extern "C"
 {
 	#include "../../qot_types.h"
+
+	/* 128-bit time arithmetic and the prepared parameter projections */
+	#include "../../qot_time128.h"
 }
 
 // If the Userspace QoT Timeline Service is used
 #ifdef QOT_TIMELINE_SERVICE
 #include "../../micro-services/timeline-service/qot_timeline_service.hpp"
 
-#ifdef NATS_SERVICE
-// NATS client header
-#include <nats/nats.h>
-
-// Include circular buffer implementation
-#include "clkparams_circbuffer.hpp"
-
-#endif 
+// Userspace timeline timers
+#include "qot_timer_wheel.hpp"
 
 #endif
 
@@ -66,6 +68,11 @@ namespace qot_coreapi
 	/* Timer Callback */
 	typedef void (*qot_timer_callback_t)(int sig, siginfo_t *si, void *ucontext);
 
+	#ifdef QOT_TIMELINE_SERVICE
+	/* Asynchronous wait completion: status and the timeline time reached */
+	typedef std::function<void(qot_return_t, utimepoint_t)> qot_wait_handler_t;
+	#endif
+
 	// Binding Class
 	class TimelineBinding
 	{
@@ -179,6 +186,31 @@ namespace qot_coreapi
 		 **/
 		public: qot_return_t timeline_sleep(utimelength_t& utl);
 
+		#ifdef QOT_TIMELINE_SERVICE
+		/**
+		 * @brief Non-blocking wait until a specified uncertain point, serviced by the timer dispatch thread
+		 * @param utp The time point at which to resume
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_waituntil_async(const utimepoint_t& utp, qot_wait_handler_t handler);
+
+		/**
+		 * @brief Non-blocking wait until the next period, serviced by the timer dispatch thread
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_waituntil_nextperiod_async(qot_wait_handler_t handler);
+
+		/**
+		 * @brief Non-blocking wait for a specified length of uncertain time, serviced by the timer dispatch thread
+		 * @param utl The period for waiting
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_sleep_async(const utimelength_t& utl, qot_wait_handler_t handler);
+		#endif
+
 		/**
 		 * @brief Non-blocking call to create a timer
 		 * @param timer A pointer to a timer object
@@ -208,13 +240,50 @@ namespace qot_coreapi
 		 **/
 		public: qot_return_t timeline_rem2core(timepoint_t& est); 
 
+		/**
+		 * @brief Converts an array of core times to remote timeline time using one parameter snapshot
+		 * @param core_ns core times (ns) to be converted
+		 * @param tl_ns converted timeline times (ns), may be the same array as core_ns
+		 * @param u_bound upper uncertainty bound of each timestamp (ns), NULL if not needed
+		 * @param l_bound lower uncertainty bound of each timestamp (ns), NULL if not needed
+		 * @param count number of timestamps
+		 * @return A status code indicating success (0) or other (bounds are unavailable in kernel mode)
+		 **/
+		public: qot_return_t timeline_core2rem_batch(const int64_t *core_ns, int64_t *tl_ns, int64_t *u_bound, int64_t *l_bound, size_t count);
+
+		/**
+		 * @brief Converts an array of remote timeline times to core time using one parameter snapshot
+		 * @param tl_ns timeline times (ns) to be converted
+		 * @param core_ns converted core times (ns), may be the same array as tl_ns
+		 * @param u_bound upper uncertainty bound at each converted core time (ns), NULL if not needed
+		 * @param l_bound lower uncertainty bound at each converted core time (ns), NULL if not needed
+		 * @param count number of timestamps
+		 * @return A status code indicating success (0) or other (bounds are unavailable in kernel mode)
+		 **/
+		public: qot_return_t timeline_rem2core_batch(const int64_t *tl_ns, int64_t *core_ns, int64_t *u_bound, int64_t *l_bound, size_t count);
+
 		// Private Function
 		private: qot_return_t timeline_check_fd();
 
+		/* Advance a timeline time to the next wakeup of the periodic scheduling parameters */
+		private: void timeline_next_wakeup(utimepoint_t &utp);
+
 		#ifdef QOT_TIMELINE_SERVICE
 		/* Send a message to the socket */
 		private: qot_return_t send_message(qot_timeline_msg_t &msg);
 
+		/* Send a message to the socket using the binary wire format */
+		private: qot_return_t send_message_binary(qot_timeline_msg_t &msg);
+
+		/* Receive the remainder of a JSON reply */
+		private: qot_return_t recv_message_json(qot_timeline_msg_t &msg, std::string rcv);
+
+		/* Take a consistent (seqlock) snapshot of the shared clock parameters */
+		private: qot_return_t qot_read_params(tl_translation_t &clk_params, tl_translation_t &ov_clk_params);
+
+		/* Project core time to timeline time using a prepared parameter snapshot (ov_proj NULL without an overlay) */
+		private: void qot_project_loc2rem(utimepoint_t &est, int period, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj);
+
 		/* Convert from core time to timeline time */
 		private: qot_return_t qot_loc2rem(utimepoint_t &est, int period, int instant_flag);
 
@@ -225,16 +294,28 @@ namespace qot_coreapi
 		private: qot_return_t timeline_getvtime(utimepoint_t &est);
 
 		/* Private implementation function to compute the timestamp uncertainty */
-		private: qot_return_t timeline_computeqot(utimepoint_t &est);
+		private: qot_return_t timeline_computeqot(utimepoint_t &est, const tl_projection_t &clk_proj, const tl_projection_t *ov_proj);
 
-		#ifdef NATS_SERVICE
-		/* Subscribe to a NATS topic (subject) */
-		private: int natsSubscribe(std::string &topic);
+		/* Private function to block until a timeline time, following parameter updates (returns the wakeup time) */
+		private: qot_return_t timeline_wait_deadline(utimepoint_t &utp);
 
-		/* Un-subscribe from a NATS topic (subject) */
-		private: int natsUnSubscribe();
-		
-		#endif
+		/* Private function to project a timeline deadline (ns) to core time */
+		private: qot_return_t qot_timer_project(int64_t tl_ns, int64_t &core_ns);
+
+		/* Private function returning the version of the current clock parameters */
+		private: uint64_t qot_params_version();
+
+		/* Private function creating the timer wheel on first use (timer_lock held) */
+		private: qot_return_t timer_wheel_start();
+
+		/* Private function stopping the timers and failing the pending asynchronous waits */
+		private: void timer_wheel_stop();
+
+		// An asynchronous wait pending in the timer wheel
+		private: struct async_wait {
+			utimepoint_t utp;
+			qot_wait_handler_t handler;
+		};
 
 		#endif
 
@@ -245,21 +326,14 @@ namespace qot_coreapi
 		// UNIX-domain socket stuff
 		#ifdef QOT_TIMELINE_SERVICE
 		private: int sock;
+		private: int wire_format;                       // Binary wire format version (0 -> JSON)
+		private: bool wire_offered;                     // Binary format offered on this connection
 		private: tl_translation_t *tl_clk_params;		// Main Clock Params
 		private: tl_translation_t *tl_ov_clk_params;	// Overlay Clock Params
-
-		// NATS Connection Stuff
-		#ifdef NATS_SERVICE
-		private: natsConnection      *conn;
-	    private: natsSubscription    *sub;
-	    private: natsStatus          s;
-	    private: volatile bool       done;
-		private: int nats_status_flag;    // Indicates connection went through
-
-	    // Circular Buffer
-		private: CircularBuffer *param_buffer;
-
-		#endif
+		private: TimelineTimerWheel *timer_wheel;       // Timers (created on first use)
+		private: std::atomic<int64_t> wait_spin_ns;     // Calibrated busy-wait window before a deadline
+		private: std::set<async_wait*> async_waits;     // Asynchronous waits not completed yet
+		private: std::mutex timer_lock;                 // Guards the timer wheel pointer and the pending waits
 
 		#endif
 	};
@@ -0,0 +1,261 @@
+/*
+ * @file qot_coreapi_async.cpp
+ * @brief Asynchronous timeline binding: futures for binding control, awaitable waits
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <memory>
+
+#include "qot_coreapi_async.hpp"
+
+using namespace qot_coreapi;
+
+/* Event loop shared by the asynchronous bindings */
+TimelineAsyncLoop::TimelineAsyncLoop()
+ : stopping(false)
+{
+	worker_thread = std::thread(&TimelineAsyncLoop::worker, this);
+}
+
+TimelineAsyncLoop::~TimelineAsyncLoop()
+{
+	request_lock.lock();
+	stopping = true;
+	request_lock.unlock();
+	request_cv.notify_one();
+
+	if (worker_thread.joinable())
+		worker_thread.join();
+}
+
+// Process-wide loop, kept alive by the bindings using it
+std::shared_ptr<TimelineAsyncLoop> TimelineAsyncLoop::shared()
+{
+	static std::mutex shared_lock;
+	static std::weak_ptr<TimelineAsyncLoop> shared_loop;
+
+	std::lock_guard<std::mutex> lock(shared_lock);
+	std::shared_ptr<TimelineAsyncLoop> loop = shared_loop.lock();
+	if (!loop)
+	{
+		loop = std::make_shared<TimelineAsyncLoop>();
+		shared_loop = loop;
+	}
+	return loop;
+}
+
+void TimelineAsyncLoop::post(std::function<void(void)> request)
+{
+	request_lock.lock();
+	requests.push_back(request);
+	request_lock.unlock();
+	request_cv.notify_one();
+}
+
+/* Worker thread: run the requests of all bindings in order */
+void TimelineAsyncLoop::worker()
+{
+	std::unique_lock<std::mutex> lock(request_lock);
+	while (true)
+	{
+		request_cv.wait(lock, [this]() { return stopping || !requests.empty(); });
+		if (requests.empty())
+			break;
+
+		std::function<void(void)> request = requests.front();
+		requests.pop_front();
+		lock.unlock();
+		request();
+		lock.lock();
+	}
+}
+
+// Constructor (the binding keeps trying to connect, as TimelineBinding() does)
+TimelineAsyncBinding::TimelineAsyncBinding()
+ : loop(TimelineAsyncLoop::shared()), tl_binding(NULL), bound(false), connected(false)
+{
+	connect(-1);
+}
+
+// Constructor with a connection timeout
+TimelineAsyncBinding::TimelineAsyncBinding(int timeout_seconds)
+ : loop(TimelineAsyncLoop::shared()), tl_binding(NULL), bound(false), connected(false)
+{
+	connect(timeout_seconds);
+}
+
+// Constructors registering with a given loop
+TimelineAsyncBinding::TimelineAsyncBinding(std::shared_ptr<TimelineAsyncLoop> loop)
+ : loop(loop), tl_binding(NULL), bound(false), connected(false)
+{
+	connect(-1);
+}
+
+TimelineAsyncBinding::TimelineAsyncBinding(std::shared_ptr<TimelineAsyncLoop> loop, int timeout_seconds)
+ : loop(loop), tl_binding(NULL), bound(false), connected(false)
+{
+	connect(timeout_seconds);
+}
+
+// Destructor: queued requests run first, then the binding (and its pending waits) goes away
+TimelineAsyncBinding::~TimelineAsyncBinding()
+{
+	// The held back requests are on the loop once the connection is up
+	if (connect_thread.joinable())
+		connect_thread.join();
+
+	std::promise<void> done;
+	std::future<void> deleted = done.get_future();
+	loop->post([this, &done]() {
+		// Stop accepting waits before the binding goes away
+		state_lock.lock();
+		bound = false;
+		state_lock.unlock();
+		delete tl_binding.exchange(NULL);
+		done.set_value();
+	});
+	deleted.wait();
+}
+
+/* Underlying binding */
+TimelineBinding *TimelineAsyncBinding::binding()
+{
+	return tl_binding.load();
+}
+
+/* Control requests */
+std::future<qot_return_t> TimelineAsyncBinding::timeline_bind(const std::string uuid, const std::string name, timelength_t res, timeinterval_t acc)
+{
+	return post([this, uuid, name, res, acc](TimelineBinding *binding) {
+		qot_return_t retval = binding->timeline_bind(uuid, name, res, acc);
+		if (retval == QOT_RETURN_TYPE_OK)
+		{
+			std::lock_guard<std::mutex> lock(state_lock);
+			bound = true;
+		}
+		return retval;
+	});
+}
+
+std::future<qot_return_t> TimelineAsyncBinding::timeline_unbind()
+{
+	return post([this](TimelineBinding *binding) {
+		// No new waits from here on, the unbind fails the pending ones
+		state_lock.lock();
+		bound = false;
+		state_lock.unlock();
+		return binding->timeline_unbind();
+	});
+}
+
+std::future<qot_return_t> TimelineAsyncBinding::timeline_set_accuracy(timeinterval_t acc)
+{
+	return post([acc](TimelineBinding *binding) {
+		timeinterval_t value = acc;
+		return binding->timeline_set_accuracy(value);
+	});
+}
+
+std::future<qot_return_t> TimelineAsyncBinding::timeline_set_resolution(timelength_t res)
+{
+	return post([res](TimelineBinding *binding) {
+		timelength_t value = res;
+		return binding->timeline_set_resolution(value);
+	});
+}
+
+std::future<qot_return_t> TimelineAsyncBinding::timeline_set_schedparams(timelength_t period, timepoint_t start_offset)
+{
+	return post([period, start_offset](TimelineBinding *binding) {
+		timelength_t period_value = period;
+		timepoint_t start_value = start_offset;
+		return binding->timeline_set_schedparams(period_value, start_value);
+	});
+}
+
+/* Waits, queued directly on the binding's timer wheel */
+qot_return_t TimelineAsyncBinding::timeline_waituntil(const utimepoint_t& utp, qot_wait_handler_t handler)
+{
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (!bound)
+		return QOT_RETURN_TYPE_ERR;
+	return tl_binding.load()->timeline_waituntil_async(utp, handler);
+}
+
+qot_return_t TimelineAsyncBinding::timeline_waituntil_nextperiod(qot_wait_handler_t handler)
+{
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (!bound)
+		return QOT_RETURN_TYPE_ERR;
+	return tl_binding.load()->timeline_waituntil_nextperiod_async(handler);
+}
+
+qot_return_t TimelineAsyncBinding::timeline_sleep(const utimelength_t& utl, qot_wait_handler_t handler)
+{
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (!bound)
+		return QOT_RETURN_TYPE_ERR;
+	return tl_binding.load()->timeline_sleep_async(utl, handler);
+}
+
+/* Queue a control request, its result is delivered through the future */
+std::future<qot_return_t> TimelineAsyncBinding::post(std::function<qot_return_t(TimelineBinding*)> request)
+{
+	std::shared_ptr<std::promise<qot_return_t> > promise(new std::promise<qot_return_t>());
+	std::future<qot_return_t> result = promise->get_future();
+	std::function<void(void)> run = [this, request, promise]() {
+		promise->set_value(request(tl_binding.load()));
+	};
+
+	// Posting under the state lock keeps the order with the requests held back while connecting
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (connected)
+		loop->post(run);
+	else
+		deferred.push_back(run);
+	return result;
+}
+
+/* Connect to the timeline service off the loop, then hand the held back requests to it */
+void TimelineAsyncBinding::connect(int timeout_seconds)
+{
+	connect_thread = std::thread([this, timeout_seconds]() {
+		TimelineBinding *binding;
+		if (timeout_seconds < 0)
+			binding = new TimelineBinding();
+		else
+			binding = new TimelineBinding(timeout_seconds);
+
+		std::lock_guard<std::mutex> lock(state_lock);
+		tl_binding = binding;
+		connected = true;
+		while (!deferred.empty())
+		{
+			loop->post(deferred.front());
+			deferred.pop_front();
+		}
+	});
+}
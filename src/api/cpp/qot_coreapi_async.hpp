@@ -0,0 +1,274 @@
+/*
+ * @file qot_coreapi_async.hpp
+ * @brief Asynchronous timeline binding: futures for binding control, awaitable waits
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_CORE_API_ASYNC_QOT_H
+#define QOT_STACK_CORE_API_ASYNC_QOT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "qot_coreapi.hpp"
+
+// Awaitable waits when the application is compiled with C++20 coroutines
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define QOT_ASYNC_COROUTINES 1
+#endif
+
+namespace qot_coreapi
+{
+	/* Result of an asynchronous wait */
+	typedef struct qot_wait_result {
+		qot_return_t retval;                  /* Status of the wait                       */
+		utimepoint_t utp;                     /* Timeline time reached                    */
+	} qot_wait_result_t;
+
+	#ifdef QOT_ASYNC_COROUTINES
+	/* Awaitable wait, the coroutine resumes on the timer dispatch thread */
+	class TimelineWaitAwaitable
+	{
+		// Queues the wait with a completion handler
+		public: typedef std::function<qot_return_t(qot_wait_handler_t)> submit_t;
+
+		public: explicit TimelineWaitAwaitable(submit_t submit) : submit_fn(submit)
+		{
+			result.retval = QOT_RETURN_TYPE_ERR;
+		}
+
+		public: bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		// The coroutine may resume (and destroy this object) before the submit call returns
+		public: bool await_suspend(std::coroutine_handle<> handle)
+		{
+			submit_t submit = std::move(submit_fn);
+			qot_wait_result_t *res = &result;
+			qot_return_t retval = submit([res, handle](qot_return_t status, utimepoint_t utp) {
+				res->retval = status;
+				res->utp = utp;
+				handle.resume();
+			});
+			if (retval == QOT_RETURN_TYPE_OK)
+				return true;
+
+			// Not queued -> resume right away with the error
+			result.retval = retval;
+			return false;
+		}
+
+		public: qot_wait_result_t await_resume() const noexcept
+		{
+			return result;
+		}
+
+		private: submit_t submit_fn;
+		private: qot_wait_result_t result;
+	};
+	#endif
+
+	/* Event loop running the control requests of the asynchronous bindings registered with it
+	   on a single worker thread, in the order they were posted. Bindings created without a
+	   loop share a process-wide one, which stops once its last binding is gone */
+	class TimelineAsyncLoop
+	{
+		// Constructor & Destructor (requests already posted run before the worker stops)
+		public: TimelineAsyncLoop();
+		public: ~TimelineAsyncLoop();
+
+		/**
+		 * @brief Process-wide loop, created on first use
+		 * @return The loop
+		 **/
+		public: static std::shared_ptr<TimelineAsyncLoop> shared();
+
+		/**
+		 * @brief Queue a request on the worker
+		 * @param request The request
+		 **/
+		public: void post(std::function<void(void)> request);
+
+		// Worker thread body
+		private: void worker();
+
+		private: bool stopping;
+		private: std::deque<std::function<void(void)> > requests;
+		private: std::mutex request_lock;
+		private: std::condition_variable request_cv;
+		private: std::thread worker_thread;
+	};
+
+	/* Binding with asynchronous calls: control requests (bind, unbind, requirement updates)
+	   run in order on the worker of a TimelineAsyncLoop and return futures, waits are one-shot
+	   timers on the binding's timer wheel. The wheels of all bindings are serviced by one
+	   dispatch thread in deadline order, each wheel projects its deadlines with the clock
+	   parameters of its own timeline. The connection to the timeline service is made on a
+	   thread of the binding, requests made until it is up are held back and then posted in
+	   order, so a binding waiting for the service does not hold up the others on the loop.
+	   Waits failed by an unbind complete on the worker, and a wait handler must not block on
+	   the future of a control request posted to the same loop */
+	class TimelineAsyncBinding
+	{
+		// Constructor & Destructor (the binding connects to the timeline service in the background)
+		public: TimelineAsyncBinding();
+		public: TimelineAsyncBinding(int timeout_seconds); // Timeout in seconds till when to try connecting to the timeline service
+		public: TimelineAsyncBinding(std::shared_ptr<TimelineAsyncLoop> loop);
+		public: TimelineAsyncBinding(std::shared_ptr<TimelineAsyncLoop> loop, int timeout_seconds);
+		public: ~TimelineAsyncBinding();
+
+		/**
+		 * @brief Bind to a timeline with a given resolution and accuracy
+		 * @param uuid Name of the timeline
+		 * @param name Name of this binding
+		 * @param res Maximum tolerable unit of time
+		 * @param acc Maximum tolerable deviation from true time
+		 * @return A future with a status code indicating success (0) or other
+		 **/
+		public: std::future<qot_return_t> timeline_bind(const std::string uuid, const std::string name, timelength_t res, timeinterval_t acc);
+
+		/**
+		 * @brief Unbind from a timeline, pending waits complete with an error
+		 * @return A future with a status code indicating success (0) or other
+		 **/
+		public: std::future<qot_return_t> timeline_unbind();
+
+		/**
+		 * @brief Set the accuracy requirement associated with this binding
+		 * @param acc Maximum tolerable deviation from true time
+		 * @return A future with a status code indicating success (0) or other
+		 **/
+		public: std::future<qot_return_t> timeline_set_accuracy(timeinterval_t acc);
+
+		/**
+		 * @brief Set the resolution requirement associated with this binding
+		 * @param res Maximum tolerable unit of time
+		 * @return A future with a status code indicating success (0) or other
+		 **/
+		public: std::future<qot_return_t> timeline_set_resolution(timelength_t res);
+
+		/**
+		 * @brief Set the periodic scheduling parameters associated with this binding
+		 * @param period wakeup period
+		 * @param start_offset First wakeup time
+		 * @return A future with a status code indicating success (0) or other
+		 **/
+		public: std::future<qot_return_t> timeline_set_schedparams(timelength_t period, timepoint_t start_offset);
+
+		/**
+		 * @brief Wait until a specified uncertain point
+		 * @param utp The time point at which to resume
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_waituntil(const utimepoint_t& utp, qot_wait_handler_t handler);
+
+		/**
+		 * @brief Wait until the next period
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_waituntil_nextperiod(qot_wait_handler_t handler);
+
+		/**
+		 * @brief Wait for a specified length of uncertain time
+		 * @param utl The period for waiting
+		 * @param handler Called on the dispatch thread with the status and the time of resume
+		 * @return A status code indicating whether the wait was queued (0) or other
+		 **/
+		public: qot_return_t timeline_sleep(const utimelength_t& utl, qot_wait_handler_t handler);
+
+		#ifdef QOT_ASYNC_COROUTINES
+		/**
+		 * @brief co_await until a specified uncertain point
+		 * @param utp The time point at which to resume
+		 * @return An awaitable yielding the status and the time of resume
+		 **/
+		public: TimelineWaitAwaitable timeline_waituntil(const utimepoint_t& utp)
+		{
+			return TimelineWaitAwaitable([this, utp](qot_wait_handler_t handler) {
+				return timeline_waituntil(utp, handler);
+			});
+		}
+
+		/**
+		 * @brief co_await until the next period
+		 * @return An awaitable yielding the status and the time of resume
+		 **/
+		public: TimelineWaitAwaitable timeline_waituntil_nextperiod()
+		{
+			return TimelineWaitAwaitable([this](qot_wait_handler_t handler) {
+				return timeline_waituntil_nextperiod(handler);
+			});
+		}
+
+		/**
+		 * @brief co_await for a specified length of uncertain time
+		 * @param utl The period for waiting
+		 * @return An awaitable yielding the status and the time of resume
+		 **/
+		public: TimelineWaitAwaitable timeline_sleep(const utimelength_t& utl)
+		{
+			return TimelineWaitAwaitable([this, utl](qot_wait_handler_t handler) {
+				return timeline_sleep(utl, handler);
+			});
+		}
+		#endif
+
+		/**
+		 * @brief Underlying binding for the non-blocking queries (time, conversions), NULL before
+		 *        the worker has connected. Control calls on it must go through this class
+		 * @return The binding
+		 **/
+		public: TimelineBinding *binding();
+
+		// Queue a control request on the worker
+		private: std::future<qot_return_t> post(std::function<qot_return_t(TimelineBinding*)> request);
+
+		// Connect to the timeline service on the connection thread
+		private: void connect(int timeout_seconds);
+
+		private: std::shared_ptr<TimelineAsyncLoop> loop;
+		private: std::atomic<TimelineBinding*> tl_binding;
+		private: bool bound;                                    // Waits are accepted (guarded by state_lock)
+		private: bool connected;                                // Requests go to the loop (guarded by state_lock)
+		private: std::deque<std::function<void(void)> > deferred; // Requests made while connecting
+		private: std::mutex state_lock;                         // Orders waits against unbind, requests against the connection
+		private: std::thread connect_thread;
+	};
+}
+
+#endif
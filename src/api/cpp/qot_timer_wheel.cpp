@@ -0,0 +1,557 @@
+/*
+ * @file qot_timer_wheel.cpp
+ * @brief Userspace timeline timers (hierarchical timer wheel on a timerfd)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* System includes */
+extern "C"
+{
+	#include <errno.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <linux/futex.h>
+	#include <sys/prctl.h>
+	#include <sys/syscall.h>
+	#include <sys/timerfd.h>
+}
+
+#include <algorithm>
+
+#include "qot_timer_wheel.hpp"
+
+using namespace qot_coreapi;
+
+#define QOT_TIMER_WHEEL_MASK (QOT_TIMER_WHEEL_SLOTS - 1)
+
+// Wait slots the dispatch thread blocks on at most, wheels beyond are polled
+#define QOT_TIMER_WATCH_MAX 8
+
+// Step detection timer, expires long after the next loop of the dispatch thread re-arms it
+#define QOT_TIMER_STEP_CHECK_SEC 86400
+
+// futex_waitv (Linux 5.16) lets the dispatch thread block on the kick word and the wait slots at once
+#if defined(SYS_futex_waitv) && defined(FUTEX_32)
+#define QOT_HAVE_FUTEX_WAITV 1
+#else
+#define QOT_HAVE_FUTEX_WAITV 0
+#endif
+
+/* Read the core clock in nanoseconds */
+static int64_t timer_core_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/* Dispatcher shared by the timer wheels */
+TimelineTimerDispatcher::TimelineTimerDispatcher()
+ : status_flag(0), timer_fd(-1), kick_seq(0), have_waitv(QOT_HAVE_FUTEX_WAITV), stopping(false), running(NULL)
+{
+	// Absolute timerfd on the core clock, never expires but is cancelled if the clock is stepped
+	timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd < 0)
+	{
+		perror("timerfd_create");
+		status_flag = 1;
+		return;
+	}
+	check_clock_step();
+
+	dispatch_thread = std::thread(&TimelineTimerDispatcher::dispatch, this);
+}
+
+TimelineTimerDispatcher::~TimelineTimerDispatcher()
+{
+	dispatch_lock.lock();
+	stopping = true;
+	dispatch_lock.unlock();
+
+	if (dispatch_thread.joinable())
+	{
+		kick();
+		dispatch_thread.join();
+	}
+
+	if (timer_fd >= 0)
+		close(timer_fd);
+}
+
+// Process-wide dispatcher, kept alive by the wheels using it
+std::shared_ptr<TimelineTimerDispatcher> TimelineTimerDispatcher::shared()
+{
+	static std::mutex shared_lock;
+	static std::weak_ptr<TimelineTimerDispatcher> shared_dispatcher;
+
+	std::lock_guard<std::mutex> lock(shared_lock);
+	std::shared_ptr<TimelineTimerDispatcher> dispatcher = shared_dispatcher.lock();
+	if (!dispatcher)
+	{
+		dispatcher = std::make_shared<TimelineTimerDispatcher>();
+		shared_dispatcher = dispatcher;
+	}
+	return dispatcher;
+}
+
+int TimelineTimerDispatcher::query_status_flag()
+{
+	return status_flag;
+}
+
+void TimelineTimerDispatcher::attach(TimelineTimerWheel *wheel)
+{
+	dispatch_lock.lock();
+	wheels.insert(wheel);
+	dispatch_lock.unlock();
+
+	// The dispatch thread starts watching the slot of the wheel
+	kick();
+}
+
+void TimelineTimerDispatcher::detach(TimelineTimerWheel *wheel)
+{
+	std::unique_lock<std::mutex> lock(dispatch_lock);
+	wheels.erase(wheel);
+	handlers_done.wait(lock, [this, wheel]() { return running != wheel; });
+}
+
+/* Wake the dispatch thread, the bump makes a kick racing with the wait fail its value check */
+void TimelineTimerDispatcher::kick()
+{
+	__atomic_add_fetch(&kick_seq, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &kick_seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* Re-project every wheel if the core clock was stepped, then re-arm the step detection */
+void TimelineTimerDispatcher::check_clock_step()
+{
+	struct itimerspec its;
+	uint64_t value;
+
+	// Clock was stepped -> all core deadlines are stale
+	if (read(timer_fd, &value, sizeof(value)) < 0 && errno == ECANCELED)
+	{
+		for (std::set<TimelineTimerWheel*>::iterator it = wheels.begin(); it != wheels.end(); ++it)
+			(*it)->invalidate();
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = timer_core_now() / 1000000000LL + QOT_TIMER_STEP_CHECK_SEC;
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL) < 0)
+		perror("timerfd_settime");
+}
+
+/* Block on the watched wait slots and the kick word until the deadline */
+void TimelineTimerDispatcher::wait(int64_t deadline, const std::vector<tl_wait_slot_t*> &watched, const std::vector<u32> &values, u32 kick_value)
+{
+	struct timespec request;
+	if (deadline >= 0)
+	{
+		request.tv_sec = deadline / 1000000000LL;
+		request.tv_nsec = deadline % 1000000000LL;
+	}
+
+#if QOT_HAVE_FUTEX_WAITV
+	if (have_waitv)
+	{
+		struct futex_waitv waiters[QOT_TIMER_WATCH_MAX + 1];
+		size_t n = 0;
+
+		memset(waiters, 0, sizeof(waiters));
+		waiters[n].uaddr = (uintptr_t) &kick_seq;
+		waiters[n].val = kick_value;
+		waiters[n].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+		n++;
+		for (size_t i = 0; i < watched.size(); i++, n++)
+		{
+			waiters[n].uaddr = (uintptr_t) &watched[i]->seq;
+			waiters[n].val = values[i];
+			waiters[n].flags = FUTEX_32;
+		}
+
+		// Writers only wake the slots that have waiters registered
+		for (size_t i = 0; i < watched.size(); i++)
+			__atomic_add_fetch(&watched[i]->waiters, 1, __ATOMIC_SEQ_CST);
+		long retval = syscall(SYS_futex_waitv, waiters, n, 0, deadline >= 0 ? &request : NULL, CLOCK_REALTIME);
+		for (size_t i = 0; i < watched.size(); i++)
+			__atomic_sub_fetch(&watched[i]->waiters, 1, __ATOMIC_RELEASE);
+
+		if (retval >= 0 || errno != ENOSYS)
+			return;
+		have_waitv = false;
+	}
+#endif
+
+	// Without futex_waitv only the kick word is watched, the caller bounds the deadline
+	syscall(SYS_futex, &kick_seq, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, kick_value,
+	        deadline >= 0 ? &request : NULL, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+/* Dispatch thread: service every wheel, and run each wheel's handlers outside the lock */
+void TimelineTimerDispatcher::dispatch()
+{
+	std::vector<TimelineTimerWheel*> serviced;
+	std::vector<qot_timer_handler_t> due;
+	std::vector<tl_wait_slot_t*> watched;
+	std::vector<u32> values;
+
+	// Expire timers as close to the deadline as the kernel allows
+	prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+	std::unique_lock<std::mutex> lock(dispatch_lock);
+	while (!stopping)
+	{
+		int64_t next = -1;
+		bool poll_params = false;
+
+		// Words first, a kick or an update after they are read makes the wait return at once
+		u32 kick_value = __atomic_load_n(&kick_seq, __ATOMIC_SEQ_CST);
+		watched.clear();
+		values.clear();
+		for (std::set<TimelineTimerWheel*>::iterator it = wheels.begin(); it != wheels.end(); ++it)
+		{
+			tl_wait_slot_t *slot = (*it)->update_slot();
+			if (slot && std::find(watched.begin(), watched.end(), slot) != watched.end())
+				continue;
+			if (!slot || watched.size() == QOT_TIMER_WATCH_MAX)
+			{
+				poll_params = true;
+				continue;
+			}
+			watched.push_back(slot);
+			values.push_back(__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST));
+		}
+		check_clock_step();
+
+		// Handlers may add timers to or detach any wheel, so each one is looked up again
+		serviced.assign(wheels.begin(), wheels.end());
+		for (size_t i = 0; i < serviced.size(); i++)
+		{
+			if (wheels.find(serviced[i]) == wheels.end())
+				continue;
+
+			due.clear();
+			int64_t expiry = serviced[i]->service(timer_core_now(), due);
+			if (expiry >= 0 && (next < 0 || expiry < next))
+				next = expiry;
+			if (due.empty())
+				continue;
+
+			running = serviced[i];
+			lock.unlock();
+			for (size_t j = 0; j < due.size(); j++)
+				due[j]();
+			lock.lock();
+			running = NULL;
+			handlers_done.notify_all();
+		}
+
+		// Poll for new clock parameters that do not wake us
+		if (next >= 0 && (poll_params || !have_waitv))
+		{
+			int64_t now = timer_core_now();
+			if (next > now + QOT_TIMER_REPROJECT_NS)
+				next = now + QOT_TIMER_REPROJECT_NS;
+		}
+		lock.unlock();
+
+		wait(next, watched, values, kick_value);
+		lock.lock();
+	}
+}
+
+// Constructor
+TimelineTimerWheel::TimelineTimerWheel(qot_timer_project_t project, qot_timer_version_t version, const tl_translation_t *params)
+ : status_flag(0), params_dirty(true), params_version(0),
+   project_fn(project), version_fn(version), armed_deadline(-1), next_id(1)
+{
+	memset(occupied, 0, sizeof(occupied));
+	now_tick = timer_core_now() >> QOT_TIMER_WHEEL_TICK_SHIFT;
+
+	// Writers bump the slot on every update, the segment itself may go away before the wheel
+	wait_slot = params ? tl_wait_slot(params) : NULL;
+
+	dispatcher = TimelineTimerDispatcher::shared();
+	if (dispatcher->query_status_flag() != 0)
+	{
+		status_flag = 1;
+		return;
+	}
+	dispatcher->attach(this);
+}
+
+// Destructor (must not be called from a timer handler)
+TimelineTimerWheel::~TimelineTimerWheel()
+{
+	if (status_flag == 0)
+		dispatcher->detach(this);
+}
+
+// Query the status flag to know the construction status
+int TimelineTimerWheel::query_status_flag()
+{
+	return status_flag;
+}
+
+/* Add a timer */
+qot_return_t TimelineTimerWheel::add_timer(const void *key, int64_t start, int64_t period, int count, qot_timer_handler_t handler)
+{
+	wheel_timer timer;
+	uint64_t id;
+
+	if (status_flag != 0 || period < 0)
+		return QOT_RETURN_TYPE_ERR;
+
+	timer.key = key;
+	timer.handler = handler;
+	timer.tl_deadline = start;
+	timer.tl_period = period;
+	timer.remaining = (period > 0) ? count : 1;
+
+	if (project_fn(start, timer.core_deadline) != QOT_RETURN_TYPE_OK)
+		return QOT_RETURN_TYPE_ERR;
+
+	wheel_lock.lock();
+	if (timer_keys.find(key) != timer_keys.end())
+	{
+		// Timer is already running
+		wheel_lock.unlock();
+		return QOT_RETURN_TYPE_ERR;
+	}
+	id = next_id++;
+	timer_keys[key] = id;
+	insert_locked(id, timers[id] = timer);
+
+	// Only a timer expiring before the armed deadline needs the dispatch thread to re-arm
+	bool earlier = (armed_deadline < 0 || timer.core_deadline < armed_deadline);
+	if (earlier)
+		armed_deadline = timer.core_deadline;
+	wheel_lock.unlock();
+
+	if (earlier)
+		dispatcher->kick();
+	return QOT_RETURN_TYPE_OK;
+}
+
+/* Cancel a timer */
+qot_return_t TimelineTimerWheel::cancel_timer(const void *key)
+{
+	std::lock_guard<std::mutex> guard(wheel_lock);
+
+	std::map<const void*, uint64_t>::iterator it = timer_keys.find(key);
+	if (it == timer_keys.end())
+		return QOT_RETURN_TYPE_ERR;
+
+	// The id left behind in its slot is skipped when the slot is next visited
+	timers.erase(it->second);
+	timer_keys.erase(it);
+	return QOT_RETURN_TYPE_OK;
+}
+
+/* Place a timer at the lowest level whose 64 slots ahead of the current tick cover it */
+void TimelineTimerWheel::insert_locked(uint64_t id, wheel_timer &timer)
+{
+	int64_t tick = timer.core_deadline >> QOT_TIMER_WHEEL_TICK_SHIFT;
+	int64_t bucket = 0;
+	int level;
+
+	if (tick < now_tick)
+		tick = now_tick;
+
+	for (level = 0; level < QOT_TIMER_WHEEL_LEVELS; level++)
+	{
+		int shift = level*QOT_TIMER_WHEEL_SLOT_BITS;
+		bucket = tick >> shift;
+		if (bucket - (now_tick >> shift) < QOT_TIMER_WHEEL_SLOTS)
+			break;
+	}
+
+	// Beyond the wheel range -> park in the last top-level slot and cascade from there
+	if (level == QOT_TIMER_WHEEL_LEVELS)
+	{
+		level = QOT_TIMER_WHEEL_LEVELS - 1;
+		bucket = (now_tick >> (level*QOT_TIMER_WHEEL_SLOT_BITS)) + QOT_TIMER_WHEEL_SLOTS - 1;
+	}
+
+	int slot = bucket & QOT_TIMER_WHEEL_MASK;
+	slots[level][slot].push_back(id);
+	occupied[level] |= (1ULL << slot);
+}
+
+/* Collect every slot passed between the current tick and now (timers not yet due get re-inserted by the caller) */
+void TimelineTimerWheel::advance_locked(int64_t now, std::vector<uint64_t> &pending)
+{
+	int64_t to = now >> QOT_TIMER_WHEEL_TICK_SHIFT;
+	if (to < now_tick)
+		to = now_tick;
+
+	for (int level = 0; level < QOT_TIMER_WHEEL_LEVELS; level++)
+	{
+		int shift = level*QOT_TIMER_WHEEL_SLOT_BITS;
+		int64_t from = now_tick >> shift;
+		int64_t n = (to >> shift) - from + 1;
+		if (n > QOT_TIMER_WHEEL_SLOTS)
+			n = QOT_TIMER_WHEEL_SLOTS;
+
+		for (int64_t k = 0; k < n; k++)
+		{
+			int slot = (from + k) & QOT_TIMER_WHEEL_MASK;
+			if (!(occupied[level] & (1ULL << slot)))
+				continue;
+			pending.insert(pending.end(), slots[level][slot].begin(), slots[level][slot].end());
+			slots[level][slot].clear();
+			occupied[level] &= ~(1ULL << slot);
+		}
+	}
+	now_tick = to;
+}
+
+/* Re-project all timers and rebuild the wheel */
+void TimelineTimerWheel::reproject_locked(int64_t now)
+{
+	// Read the version first, a concurrent update triggers another pass
+	params_version = version_fn();
+	params_dirty = false;
+
+	for (int level = 0; level < QOT_TIMER_WHEEL_LEVELS; level++)
+	{
+		for (int slot = 0; slot < QOT_TIMER_WHEEL_SLOTS; slot++)
+			slots[level][slot].clear();
+		occupied[level] = 0;
+	}
+	now_tick = now >> QOT_TIMER_WHEEL_TICK_SHIFT;
+
+	for (std::map<uint64_t, wheel_timer>::iterator it = timers.begin(); it != timers.end(); ++it)
+	{
+		project_fn(it->second.tl_deadline, it->second.core_deadline);
+		insert_locked(it->first, it->second);
+	}
+}
+
+/* Earliest core time at which a timer may expire, exact on level 0 and the slot start above */
+int64_t TimelineTimerWheel::next_expiry_locked()
+{
+	int64_t best = -1;
+
+	for (int level = 0; level < QOT_TIMER_WHEEL_LEVELS; level++)
+	{
+		if (!occupied[level])
+			continue;
+
+		// First occupied slot at or after the current one
+		int shift = level*QOT_TIMER_WHEEL_SLOT_BITS;
+		int64_t base = now_tick >> shift;
+		int rot = base & QOT_TIMER_WHEEL_MASK;
+		uint64_t bits = rot ? ((occupied[level] >> rot) | (occupied[level] << (64 - rot))) : occupied[level];
+		int64_t bucket = base + __builtin_ctzll(bits);
+		int64_t candidate = (bucket << shift) << QOT_TIMER_WHEEL_TICK_SHIFT;
+
+		if (level == 0)
+		{
+			int64_t exact = -1;
+			std::vector<uint64_t> &ids = slots[0][bucket & QOT_TIMER_WHEEL_MASK];
+			for (size_t i = 0; i < ids.size(); i++)
+			{
+				std::map<uint64_t, wheel_timer>::iterator it = timers.find(ids[i]);
+				if (it != timers.end() && (exact < 0 || it->second.core_deadline < exact))
+					exact = it->second.core_deadline;
+			}
+			if (exact >= 0)
+				candidate = exact;
+		}
+
+		if (best < 0 || candidate < best)
+			best = candidate;
+	}
+
+	return best;
+}
+
+/* Expire the timers due at core time now */
+int64_t TimelineTimerWheel::service(int64_t now, std::vector<qot_timer_handler_t> &due)
+{
+	std::vector<uint64_t> pending;
+	std::lock_guard<std::mutex> guard(wheel_lock);
+
+	// Deadlines are kept on the timeline, move them if the projection changed
+	if (params_dirty || version_fn() != params_version)
+		reproject_locked(now);
+
+	advance_locked(now, pending);
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		std::map<uint64_t, wheel_timer>::iterator it = timers.find(pending[i]);
+		if (it == timers.end())
+			continue;
+
+		wheel_timer &timer = it->second;
+		if (timer.core_deadline > now)
+		{
+			insert_locked(it->first, timer);
+			continue;
+		}
+
+		due.push_back(timer.handler);
+		if (timer.tl_period > 0 && timer.remaining != 1)
+		{
+			if (timer.remaining > 0)
+				timer.remaining--;
+
+			// Next expiry on the timeline, skipping periods that were missed entirely
+			qot_return_t retval;
+			do {
+				timer.tl_deadline += timer.tl_period;
+				retval = project_fn(timer.tl_deadline, timer.core_deadline);
+			} while (retval == QOT_RETURN_TYPE_OK && timer.core_deadline <= now);
+
+			if (retval == QOT_RETURN_TYPE_OK)
+			{
+				insert_locked(it->first, timer);
+				continue;
+			}
+		}
+		timer_keys.erase(timer.key);
+		timers.erase(it);
+	}
+
+	armed_deadline = next_expiry_locked();
+	return armed_deadline;
+}
+
+/* Re-project on the next service */
+void TimelineTimerWheel::invalidate()
+{
+	std::lock_guard<std::mutex> guard(wheel_lock);
+	params_dirty = true;
+}
+
+/* Wait slot bumped by updates of the projection */
+tl_wait_slot_t *TimelineTimerWheel::update_slot()
+{
+	return wait_slot;
+}
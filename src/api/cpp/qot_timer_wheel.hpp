@@ -0,0 +1,193 @@
+/*
+ * @file qot_timer_wheel.hpp
+ * @brief Userspace timeline timers (hierarchical timer wheels on a shared timerfd)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_TIMER_WHEEL_QOT_H
+#define QOT_STACK_TIMER_WHEEL_QOT_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+/* Include basic types, time math and ioctl interface */
+extern "C"
+{
+	#include "../../qot_types.h"
+}
+
+// Wheel geometry: 2^10 ns ticks, 64 slots per level, 6 levels (~19 hours)
+#define QOT_TIMER_WHEEL_TICK_SHIFT 10
+#define QOT_TIMER_WHEEL_SLOT_BITS  6
+#define QOT_TIMER_WHEEL_SLOTS      (1 << QOT_TIMER_WHEEL_SLOT_BITS)
+#define QOT_TIMER_WHEEL_LEVELS     6
+
+// Maximum time the dispatch thread sleeps before checking for new clock parameters, when it
+// cannot block on their wait slot (segment without one, or a kernel without futex_waitv)
+#define QOT_TIMER_REPROJECT_NS     10000000LL
+
+namespace qot_coreapi
+{
+	// Projects a timeline time (ns) to core time (CLOCK_REALTIME ns)
+	typedef std::function<qot_return_t(int64_t, int64_t&)> qot_timer_project_t;
+
+	// Returns a value that changes whenever the projection parameters change
+	typedef std::function<uint64_t(void)> qot_timer_version_t;
+
+	// Timer expiry handler (invoked on the dispatch thread)
+	typedef std::function<void(void)> qot_timer_handler_t;
+
+	class TimelineTimerWheel;
+
+	/* Dispatch thread shared by the timer wheels of a process: it blocks on the wait slots of
+	   their clock parameters until the earliest expiry of all wheels, so new parameters wake
+	   it right away, and runs their handlers, one wheel after the other */
+	class TimelineTimerDispatcher
+	{
+		// Constructor & Destructor (starts and stops the dispatch thread)
+		public: TimelineTimerDispatcher();
+		public: ~TimelineTimerDispatcher();
+
+		/**
+		 * @brief Process-wide dispatcher, created on first use and kept alive by its wheels
+		 * @return The dispatcher
+		 **/
+		public: static std::shared_ptr<TimelineTimerDispatcher> shared();
+
+		// Query the status flag to know the construction status
+		public: int query_status_flag();
+
+		// Start servicing a wheel
+		public: void attach(TimelineTimerWheel *wheel);
+
+		// Stop servicing a wheel, waits for its handlers (must not be called from a timer handler)
+		public: void detach(TimelineTimerWheel *wheel);
+
+		// Wake the dispatch thread so it recomputes the next expiry
+		public: void kick();
+
+		// Block until the deadline (core ns, -1 for none), a kick or an update of a watched slot
+		private: void wait(int64_t deadline, const std::vector<tl_wait_slot_t*> &watched, const std::vector<u32> &values, u32 kick_value);
+
+		// Re-project every wheel if the core clock was stepped since the last check
+		private: void check_clock_step();
+
+		// Dispatch thread body
+		private: void dispatch();
+
+		private: int status_flag;
+		private: int timer_fd;                              // Detects steps of the core clock
+		private: u32 kick_seq;                              // Private futex word bumped by kick()
+		private: bool have_waitv;                           // Kernel supports futex_waitv
+		private: bool stopping;
+		private: std::set<TimelineTimerWheel*> wheels;
+		private: TimelineTimerWheel *running;               // Wheel whose handlers run right now
+		private: std::mutex dispatch_lock;
+		private: std::condition_variable handlers_done;
+		private: std::thread dispatch_thread;
+	};
+
+	class TimelineTimerWheel
+	{
+		// Constructor & Destructor (registers with the shared dispatcher, params may be NULL
+		// if no segment signals updates of the projection)
+		public: TimelineTimerWheel(qot_timer_project_t project, qot_timer_version_t version, const tl_translation_t *params);
+		public: ~TimelineTimerWheel();
+
+		// Query the status flag to know the construction status
+		public: int query_status_flag();
+
+		/* Add a timer keyed by key, first expiry at start (timeline ns), period 0 for one-shot,
+		   count <= 0 for a periodic timer that runs until cancelled */
+		public: qot_return_t add_timer(const void *key, int64_t start, int64_t period, int count, qot_timer_handler_t handler);
+
+		/* Cancel a timer (a handler already being invoked runs to completion) */
+		public: qot_return_t cancel_timer(const void *key);
+
+		/* Called by the dispatcher: expire the timers due at core time now into due, returns
+		   the earliest core time at which a timer may expire next (-1 if the wheel is empty) */
+		public: int64_t service(int64_t now, std::vector<qot_timer_handler_t> &due);
+
+		/* Called by the dispatcher when the core clock was stepped */
+		public: void invalidate();
+
+		/* Wait slot bumped by updates of the projection (NULL if updates must be polled) */
+		public: tl_wait_slot_t *update_slot();
+
+		// A timer and its deadlines on the timeline and on the core clock
+		private: struct wheel_timer {
+			const void *key;
+			qot_timer_handler_t handler;
+			int64_t tl_deadline;
+			int64_t tl_period;
+			int remaining;
+			int64_t core_deadline;
+		};
+
+		// Place a timer in the wheel relative to the current tick
+		private: void insert_locked(uint64_t id, wheel_timer &timer);
+
+		// Move the wheel to core time now, collecting the timers of all passed slots
+		private: void advance_locked(int64_t now, std::vector<uint64_t> &pending);
+
+		// Re-project every timer with the current clock parameters and rebuild the wheel
+		private: void reproject_locked(int64_t now);
+
+		// Earliest core time at which a timer may expire (-1 if the wheel is empty)
+		private: int64_t next_expiry_locked();
+
+		private: int status_flag;
+		private: bool params_dirty;
+		private: uint64_t params_version;
+		private: qot_timer_project_t project_fn;
+		private: qot_timer_version_t version_fn;
+		private: int64_t armed_deadline;	// Next expiry the dispatcher knows of (-1 if none)
+		private: tl_wait_slot_t *wait_slot;	// In the wait table, which is never unmapped
+
+		// Wheel state: current tick, per-level occupancy bitmaps and slots of timer ids
+		private: int64_t now_tick;
+		private: uint64_t occupied[QOT_TIMER_WHEEL_LEVELS];
+		private: std::vector<uint64_t> slots[QOT_TIMER_WHEEL_LEVELS][QOT_TIMER_WHEEL_SLOTS];
+
+		// Live timers by id and by key
+		private: uint64_t next_id;
+		private: std::map<uint64_t, wheel_timer> timers;
+		private: std::map<const void*, uint64_t> timer_keys;
+
+		private: std::mutex wheel_lock;
+		private: std::shared_ptr<TimelineTimerDispatcher> dispatcher;
+	};
+}
+
+#endif
@@ -0,0 +1,537 @@
+/*
+ * @file qot_native.cpp
+ * @brief Native CPython binding to the QoT C++ API (shared-memory timeline clock)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Python C API (must come first)
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+#include <new>
+#include <string>
+
+// C++ API
+#include "../cpp/qot_coreapi.hpp"
+
+using namespace qot_coreapi;
+
+/* Binding object. Waits and batch conversions run without the GIL, so
+   other Python threads keep running; bind and unbind are refused while
+   such calls are in flight because they remap the clock parameters. Bind
+   and unbind also run without the GIL, every other call is refused until
+   they are done */
+typedef struct {
+	PyObject_HEAD
+	TimelineBinding *binding;
+	int bound;
+	int active;				// Calls running without the GIL (only changed with the GIL held)
+	int busy;				// A bind or unbind runs without the GIL (only changed with the GIL held)
+} qot_native_binding_t;
+
+static int64_t utp_estimate_ns(const utimepoint_t &utp)
+{
+	int64_t ns = TP_TO_nSEC(utp.estimate);
+	return ns;
+}
+
+static int64_t tl_ns(const timelength_t &tl)
+{
+	int64_t ns = TL_TO_nSEC(tl);
+	return ns;
+}
+
+// (estimate_ns, above_ns, below_ns)
+static PyObject *utp_to_tuple(const utimepoint_t &utp)
+{
+	return Py_BuildValue("(LLL)", (long long) utp_estimate_ns(utp),
+		(long long) tl_ns(utp.interval.above), (long long) tl_ns(utp.interval.below));
+}
+
+static PyObject *status_to_tuple(qot_return_t retval, const utimepoint_t &utp)
+{
+	if (retval != QOT_RETURN_TYPE_OK)
+		return Py_BuildValue("(iO)", (int) retval, Py_None);
+	PyObject *time = utp_to_tuple(utp);
+	if (!time)
+		return NULL;
+	return Py_BuildValue("(iN)", (int) retval, time);
+}
+
+static int check_busy(qot_native_binding_t *self)
+{
+	if (self->busy)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "a bind or unbind is in progress on this binding");
+		return -1;
+	}
+	return 0;
+}
+
+static int check_bound(qot_native_binding_t *self)
+{
+	if (check_busy(self) < 0)
+		return -1;
+	if (!self->bound)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "not bound to a timeline");
+		return -1;
+	}
+	return 0;
+}
+
+/* Get a contiguous buffer of 64-bit integers */
+static int get_int64_buffer(PyObject *obj, Py_buffer *view, int writable, const char *name)
+{
+	if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0)) < 0)
+		return -1;
+	const char *format = view->format ? view->format : "B";
+	if (format[0] == '@' || format[0] == '=' || format[0] == '<')
+		format++;
+	if (view->itemsize != sizeof(int64_t) || (strcmp(format, "q") != 0 && strcmp(format, "l") != 0))
+	{
+		PyErr_Format(PyExc_TypeError, "%s must be a buffer of int64 (format 'q')", name);
+		PyBuffer_Release(view);
+		return -1;
+	}
+	return 0;
+}
+
+/* Object lifetime */
+
+static PyObject *binding_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	qot_native_binding_t *self = (qot_native_binding_t*) type->tp_alloc(type, 0);
+	if (!self)
+		return NULL;
+	self->binding = NULL;
+	self->bound = 0;
+	self->active = 0;
+	self->busy = 0;
+	return (PyObject*) self;
+}
+
+static void binding_dealloc(qot_native_binding_t *self)
+{
+	if (self->binding)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		if (self->bound)
+			self->binding->timeline_unbind();
+		delete self->binding;
+		Py_END_ALLOW_THREADS
+	}
+	// Instances hold a reference to their heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*) self);
+	Py_DECREF(type);
+}
+
+/* Binding */
+
+static PyObject *binding_bind(qot_native_binding_t *self, PyObject *args)
+{
+	const char *uuid, *name;
+	long long res_ns, acc_ns;
+	int timeout_s = 0;
+	if (!PyArg_ParseTuple(args, "ssLL|i", &uuid, &name, &res_ns, &acc_ns, &timeout_s) || check_busy(self) < 0)
+		return NULL;
+	if (self->bound || self->active)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "already bound to a timeline");
+		return NULL;
+	}
+
+	timelength_t res;
+	timeinterval_t acc;
+	TL_FROM_nSEC(res, res_ns);
+	TL_FROM_nSEC(acc.above, acc_ns);
+	TL_FROM_nSEC(acc.below, acc_ns);
+	std::string uuid_str(uuid), name_str(name);
+
+	// Connecting to the timeline service may block, the binding is created without the GIL
+	qot_return_t retval = QOT_RETURN_TYPE_ERR;
+	TimelineBinding *binding = self->binding;
+	self->busy = 1;
+	Py_BEGIN_ALLOW_THREADS
+	if (!binding)
+		binding = (timeout_s > 0) ? new (std::nothrow) TimelineBinding(timeout_s) : new (std::nothrow) TimelineBinding();
+	if (binding)
+		retval = binding->timeline_bind(uuid_str, name_str, res, acc);
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+
+	self->binding = binding;
+	if (!binding)
+		return PyErr_NoMemory();
+	self->bound = (retval == QOT_RETURN_TYPE_OK);
+	return PyLong_FromLong(retval);
+}
+
+static PyObject *binding_unbind(qot_native_binding_t *self, PyObject *unused)
+{
+	if (check_bound(self) < 0)
+		return NULL;
+	if (self->active)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "waits or conversions are still running on this binding");
+		return NULL;
+	}
+	// The clock parameters are unmapped without the GIL, no call may start on them meanwhile
+	qot_return_t retval;
+	self->bound = 0;
+	self->busy = 1;
+	Py_BEGIN_ALLOW_THREADS
+	retval = self->binding->timeline_unbind();
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+	return PyLong_FromLong(retval);
+}
+
+static PyObject *binding_set_accuracy(qot_native_binding_t *self, PyObject *args)
+{
+	long long acc_ns;
+	if (!PyArg_ParseTuple(args, "L", &acc_ns) || check_bound(self) < 0)
+		return NULL;
+	timeinterval_t acc;
+	TL_FROM_nSEC(acc.above, acc_ns);
+	TL_FROM_nSEC(acc.below, acc_ns);
+	return PyLong_FromLong(self->binding->timeline_set_accuracy(acc));
+}
+
+static PyObject *binding_set_resolution(qot_native_binding_t *self, PyObject *args)
+{
+	long long res_ns;
+	if (!PyArg_ParseTuple(args, "L", &res_ns) || check_bound(self) < 0)
+		return NULL;
+	timelength_t res;
+	TL_FROM_nSEC(res, res_ns);
+	return PyLong_FromLong(self->binding->timeline_set_resolution(res));
+}
+
+static PyObject *binding_set_schedparams(qot_native_binding_t *self, PyObject *args)
+{
+	long long period_ns, offset_ns;
+	if (!PyArg_ParseTuple(args, "LL", &period_ns, &offset_ns) || check_bound(self) < 0)
+		return NULL;
+	timelength_t period;
+	timepoint_t offset;
+	TL_FROM_nSEC(period, period_ns);
+	TP_FROM_nSEC(offset, offset_ns);
+	return PyLong_FromLong(self->binding->timeline_set_schedparams(period, offset));
+}
+
+/* Time reads and conversions (lock-free reads of the mapped clock parameters) */
+
+static PyObject *binding_gettime(qot_native_binding_t *self, PyObject *unused)
+{
+	if (check_bound(self) < 0)
+		return NULL;
+	utimepoint_t utp;
+	if (self->binding->timeline_gettime(utp) != QOT_RETURN_TYPE_OK)
+		Py_RETURN_NONE;
+	return utp_to_tuple(utp);
+}
+
+static PyObject *binding_getcoretime(qot_native_binding_t *self, PyObject *unused)
+{
+	if (check_bound(self) < 0)
+		return NULL;
+	utimepoint_t utp;
+	if (self->binding->timeline_getcoretime(utp) != QOT_RETURN_TYPE_OK)
+		Py_RETURN_NONE;
+	return PyLong_FromLongLong(utp_estimate_ns(utp));
+}
+
+static PyObject *binding_core2rem(qot_native_binding_t *self, PyObject *args)
+{
+	long long core_ns;
+	if (!PyArg_ParseTuple(args, "L", &core_ns) || check_bound(self) < 0)
+		return NULL;
+	int64_t core = core_ns, tl, above, below;
+	if (self->binding->timeline_core2rem_batch(&core, &tl, &above, &below, 1) != QOT_RETURN_TYPE_OK)
+		Py_RETURN_NONE;
+	return Py_BuildValue("(LLL)", (long long) tl, (long long) above, (long long) below);
+}
+
+static PyObject *binding_rem2core(qot_native_binding_t *self, PyObject *args)
+{
+	long long tl_ns;
+	if (!PyArg_ParseTuple(args, "L", &tl_ns) || check_bound(self) < 0)
+		return NULL;
+	int64_t tl = tl_ns, core;
+	if (self->binding->timeline_rem2core_batch(&tl, &core, NULL, NULL, 1) != QOT_RETURN_TYPE_OK)
+		Py_RETURN_NONE;
+	return PyLong_FromLongLong(core);
+}
+
+static PyObject *binding_core2rem_batch(qot_native_binding_t *self, PyObject *args)
+{
+	PyObject *core_obj, *tl_obj, *above_obj = Py_None, *below_obj = Py_None;
+	if (!PyArg_ParseTuple(args, "OO|OO", &core_obj, &tl_obj, &above_obj, &below_obj) || check_bound(self) < 0)
+		return NULL;
+
+	// The converted times may overwrite the core times
+	Py_buffer core, tl, above, below;
+	int have_above = (above_obj != Py_None), have_below = (below_obj != Py_None);
+	if (get_int64_buffer(core_obj, &core, 0, "core") < 0)
+		return NULL;
+	if (get_int64_buffer(tl_obj, &tl, 1, "out") < 0)
+	{
+		PyBuffer_Release(&core);
+		return NULL;
+	}
+	int ok = 1;
+	if (have_above && get_int64_buffer(above_obj, &above, 1, "upper") < 0)
+		ok = have_above = 0;
+	if (ok && have_below && get_int64_buffer(below_obj, &below, 1, "lower") < 0)
+		ok = have_below = 0;
+	Py_ssize_t count = core.len/sizeof(int64_t);
+	if (ok && (tl.len < core.len || (have_above && above.len < core.len) || (have_below && below.len < core.len)))
+	{
+		PyErr_SetString(PyExc_ValueError, "output buffers are shorter than the input");
+		ok = 0;
+	}
+
+	qot_return_t retval = QOT_RETURN_TYPE_ERR;
+	if (ok)
+	{
+		self->active++;
+		Py_BEGIN_ALLOW_THREADS
+		retval = self->binding->timeline_core2rem_batch((const int64_t*) core.buf, (int64_t*) tl.buf,
+			have_above ? (int64_t*) above.buf : NULL, have_below ? (int64_t*) below.buf : NULL, count);
+		Py_END_ALLOW_THREADS
+		self->active--;
+	}
+
+	PyBuffer_Release(&core);
+	PyBuffer_Release(&tl);
+	if (have_above)
+		PyBuffer_Release(&above);
+	if (have_below)
+		PyBuffer_Release(&below);
+	if (!ok)
+		return NULL;
+	return PyLong_FromLong(retval);
+}
+
+static PyObject *binding_rem2core_batch(qot_native_binding_t *self, PyObject *args)
+{
+	PyObject *tl_obj, *core_obj, *above_obj = Py_None, *below_obj = Py_None;
+	if (!PyArg_ParseTuple(args, "OO|OO", &tl_obj, &core_obj, &above_obj, &below_obj) || check_bound(self) < 0)
+		return NULL;
+
+	// The converted times may overwrite the timeline times
+	Py_buffer tl, core, above, below;
+	int have_above = (above_obj != Py_None), have_below = (below_obj != Py_None);
+	if (get_int64_buffer(tl_obj, &tl, 0, "timeline") < 0)
+		return NULL;
+	if (get_int64_buffer(core_obj, &core, 1, "out") < 0)
+	{
+		PyBuffer_Release(&tl);
+		return NULL;
+	}
+	int ok = 1;
+	if (have_above && get_int64_buffer(above_obj, &above, 1, "upper") < 0)
+		ok = have_above = 0;
+	if (ok && have_below && get_int64_buffer(below_obj, &below, 1, "lower") < 0)
+		ok = have_below = 0;
+	Py_ssize_t count = tl.len/sizeof(int64_t);
+	if (ok && (core.len < tl.len || (have_above && above.len < tl.len) || (have_below && below.len < tl.len)))
+	{
+		PyErr_SetString(PyExc_ValueError, "output buffers are shorter than the input");
+		ok = 0;
+	}
+
+	qot_return_t retval = QOT_RETURN_TYPE_ERR;
+	if (ok)
+	{
+		self->active++;
+		Py_BEGIN_ALLOW_THREADS
+		retval = self->binding->timeline_rem2core_batch((const int64_t*) tl.buf, (int64_t*) core.buf,
+			have_above ? (int64_t*) above.buf : NULL, have_below ? (int64_t*) below.buf : NULL, count);
+		Py_END_ALLOW_THREADS
+		self->active--;
+	}
+
+	PyBuffer_Release(&tl);
+	PyBuffer_Release(&core);
+	if (have_above)
+		PyBuffer_Release(&above);
+	if (have_below)
+		PyBuffer_Release(&below);
+	if (!ok)
+		return NULL;
+	return PyLong_FromLong(retval);
+}
+
+/* Blocking waits, without the GIL */
+
+static PyObject *binding_waituntil(qot_native_binding_t *self, PyObject *args)
+{
+	long long tl_ns;
+	if (!PyArg_ParseTuple(args, "L", &tl_ns) || check_bound(self) < 0)
+		return NULL;
+	utimepoint_t utp;
+	memset(&utp, 0, sizeof(utp));
+	TP_FROM_nSEC(utp.estimate, tl_ns);
+
+	qot_return_t retval;
+	self->active++;
+	Py_BEGIN_ALLOW_THREADS
+	retval = self->binding->timeline_waituntil(utp);
+	Py_END_ALLOW_THREADS
+	self->active--;
+	return status_to_tuple(retval, utp);
+}
+
+static PyObject *binding_waituntil_nextperiod(qot_native_binding_t *self, PyObject *unused)
+{
+	if (check_bound(self) < 0)
+		return NULL;
+	utimepoint_t utp;
+	memset(&utp, 0, sizeof(utp));
+
+	qot_return_t retval;
+	self->active++;
+	Py_BEGIN_ALLOW_THREADS
+	retval = self->binding->timeline_waituntil_nextperiod(utp);
+	Py_END_ALLOW_THREADS
+	self->active--;
+	return status_to_tuple(retval, utp);
+}
+
+static PyObject *binding_sleep(qot_native_binding_t *self, PyObject *args)
+{
+	long long duration_ns;
+	if (!PyArg_ParseTuple(args, "L", &duration_ns) || check_bound(self) < 0)
+		return NULL;
+	utimelength_t utl;
+	memset(&utl, 0, sizeof(utl));
+	TL_FROM_nSEC(utl.estimate, duration_ns);
+
+	qot_return_t retval;
+	self->active++;
+	Py_BEGIN_ALLOW_THREADS
+	retval = self->binding->timeline_sleep(utl);
+	Py_END_ALLOW_THREADS
+	self->active--;
+
+	// The time at which the program resumes
+	utimepoint_t utp;
+	if (retval == QOT_RETURN_TYPE_OK)
+		retval = self->binding->timeline_gettime(utp);
+	return status_to_tuple(retval, utp);
+}
+
+static PyMethodDef binding_methods[] = {
+	{"timeline_bind", (PyCFunction) binding_bind, METH_VARARGS,
+	 "timeline_bind(uuid, name, res_ns, acc_ns[, timeout_s]) -> status\n\nBind to a timeline and map its clock parameters"},
+	{"timeline_unbind", (PyCFunction) binding_unbind, METH_NOARGS,
+	 "timeline_unbind() -> status"},
+	{"timeline_set_accuracy", (PyCFunction) binding_set_accuracy, METH_VARARGS,
+	 "timeline_set_accuracy(acc_ns) -> status"},
+	{"timeline_set_resolution", (PyCFunction) binding_set_resolution, METH_VARARGS,
+	 "timeline_set_resolution(res_ns) -> status"},
+	{"timeline_set_schedparams", (PyCFunction) binding_set_schedparams, METH_VARARGS,
+	 "timeline_set_schedparams(period_ns, offset_ns) -> status"},
+	{"timeline_gettime", (PyCFunction) binding_gettime, METH_NOARGS,
+	 "timeline_gettime() -> (estimate_ns, above_ns, below_ns) or None"},
+	{"timeline_getcoretime", (PyCFunction) binding_getcoretime, METH_NOARGS,
+	 "timeline_getcoretime() -> core time in ns or None"},
+	{"timeline_core2rem", (PyCFunction) binding_core2rem, METH_VARARGS,
+	 "timeline_core2rem(core_ns) -> (estimate_ns, above_ns, below_ns) or None"},
+	{"timeline_rem2core", (PyCFunction) binding_rem2core, METH_VARARGS,
+	 "timeline_rem2core(tl_ns) -> core time in ns or None"},
+	{"timeline_core2rem_batch", (PyCFunction) binding_core2rem_batch, METH_VARARGS,
+	 "timeline_core2rem_batch(core, out[, upper, lower]) -> status\n\n"
+	 "Convert int64 core times (numpy int64 arrays, array('q'), ...) in place into the\n"
+	 "given buffers with one parameter snapshot. out may be core itself"},
+	{"timeline_rem2core_batch", (PyCFunction) binding_rem2core_batch, METH_VARARGS,
+	 "timeline_rem2core_batch(timeline, out[, upper, lower]) -> status\n\n"
+	 "Convert int64 timeline times in place into core times, with the uncertainty\n"
+	 "bounds at each converted core time. out may be timeline itself"},
+	{"timeline_waituntil", (PyCFunction) binding_waituntil, METH_VARARGS,
+	 "timeline_waituntil(tl_ns) -> (status, (estimate_ns, above_ns, below_ns))\n\nBlocks without holding the GIL"},
+	{"timeline_waituntil_nextperiod", (PyCFunction) binding_waituntil_nextperiod, METH_NOARGS,
+	 "timeline_waituntil_nextperiod() -> (status, (estimate_ns, above_ns, below_ns))\n\nBlocks without holding the GIL"},
+	{"timeline_sleep", (PyCFunction) binding_sleep, METH_VARARGS,
+	 "timeline_sleep(duration_ns) -> (status, (estimate_ns, above_ns, below_ns))\n\nBlocks without holding the GIL"},
+	{NULL, NULL, 0, NULL}
+};
+
+// Built from a spec, as the layout of PyTypeObject differs between Python versions
+static PyType_Slot binding_slots[] = {
+	{Py_tp_dealloc, (void*) binding_dealloc},
+	{Py_tp_doc, (void*) "TimelineBinding() binds to a timeline and reads it from the mapped clock parameters"},
+	{Py_tp_methods, (void*) binding_methods},
+	{Py_tp_new, (void*) binding_new},
+	{0, NULL}
+};
+
+static PyType_Spec binding_spec = {
+	"qot_native.TimelineBinding",		/* name */
+	sizeof(qot_native_binding_t),		/* basicsize */
+	0,					/* itemsize */
+	Py_TPFLAGS_DEFAULT,			/* flags */
+	binding_slots				/* slots */
+};
+
+static struct PyModuleDef qot_native_module = {
+	PyModuleDef_HEAD_INIT,
+	"qot_native",				/* m_name */
+	"Native binding to the QoT timeline clock. Times are integer nanoseconds",
+	-1,					/* m_size */
+	NULL,					/* m_methods */
+	NULL,					/* m_slots */
+	NULL,					/* m_traverse */
+	NULL,					/* m_clear */
+	NULL					/* m_free */
+};
+
+PyMODINIT_FUNC PyInit_qot_native(void)
+{
+	PyObject *binding_type = PyType_FromSpec(&binding_spec);
+	if (!binding_type)
+		return NULL;
+
+	PyObject *module = PyModule_Create(&qot_native_module);
+	if (!module)
+	{
+		Py_DECREF(binding_type);
+		return NULL;
+	}
+	if (PyModule_AddObject(module, "TimelineBinding", binding_type) < 0)
+	{
+		Py_DECREF(binding_type);
+		Py_DECREF(module);
+		return NULL;
+	}
+	PyModule_AddIntConstant(module, "QOT_RETURN_TYPE_OK", QOT_RETURN_TYPE_OK);
+	PyModule_AddIntConstant(module, "QOT_RETURN_TYPE_ERR", QOT_RETURN_TYPE_ERR);
+	return module;
+}
@@ -28,9 +28,6 @@
 # Define keyword prefix for defining a global timeline
 GLOBAL_TL_STRING = "gl_"
 
-# Default Maximum Number of Timelines Supported 
-MAX_TIMELINES = 5
-
 # For ease of conversion 
 ASEC_PER_NSEC = 1000000000
 ASEC_PER_USEC = 1000000000000
@@ -0,0 +1,86 @@
+# @file helloworld_native.py
+# @brief Python QoT app timestamping samples at a kHz rate through the native module
+# @author Anon D'Anon
+#
+# Copyright (c) Anon, 2018.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#  1. Redistributions of source code must retain the above copyright notice,
+#     this list of conditions and the following disclaimer.
+#  2. Redistributions in binary form must reproduce the above copyright notice,
+#     this list of conditions and the following disclaimer in the documentation
+#     and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import sys 
+import os
+import argparse
+import array
+
+sys.path.append(os.path.abspath("/usr/local/lib"))
+import qot_native
+
+import signal
+
+# Global Variable used to terminate program on SIGINT
+running = 1
+
+# SIGINT signal handler
+def signal_handler(signal, frame):
+	print('Program Exiting')
+	global running
+	running = 0
+
+def main_func(timeline_uuid: str, app_name: str, rate_hz: int):
+
+	# Register signal handler
+	signal.signal(signal.SIGINT, signal_handler)
+
+	# Bind to the timeline (times are integer nanoseconds)
+	binding = qot_native.TimelineBinding()
+	retval = binding.timeline_bind(timeline_uuid, app_name, 1000, 1000)
+	if retval != qot_native.QOT_RETURN_TYPE_OK:
+		print ('Unable to bind to timeline, terminating ....')
+		exit (1)
+
+	# Sample period
+	binding.timeline_set_schedparams(1000000000 // rate_hz, 0)
+
+	# Core timestamps of one second of samples, converted to timeline time in place
+	stamps = array.array('q', bytes(8*rate_hz))
+	upper = array.array('q', bytes(8*rate_hz))
+	lower = array.array('q', bytes(8*rate_hz))
+
+	while running:
+		for i in range(rate_hz):
+			# Wait for the next sample (the GIL is released while waiting)
+			binding.timeline_waituntil_nextperiod()
+			stamps[i] = binding.timeline_getcoretime()
+		binding.timeline_core2rem_batch(stamps, stamps, upper, lower)
+		print('Last of %d samples at timeline time %d ns (+%d/-%d ns)' % (rate_hz, stamps[-1], upper[-1], lower[-1]))
+
+	# Unbind from the timeline
+	print("Unbinding from timeline")
+	binding.timeline_unbind()
+
+
+if __name__ == '__main__':
+	parser = argparse.ArgumentParser(description='Python QoT App sampling through the native module')
+	parser.add_argument('--timeline', '-t', default='gl_my_test_timeline', type=str, help='name of timeline to bind to')
+	parser.add_argument('--app', '-a', default='qot_native_app', type=str, help='name of app component')
+	parser.add_argument('--rate', '-r', default=1000, type=int, help='sample rate in Hz')
+	args = parser.parse_args()
+	main_func(args.timeline, args.app, args.rate)
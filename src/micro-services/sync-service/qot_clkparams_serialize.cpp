@@ -1,6 +1,6 @@
 /*
  * @file qot_clkparams_serialize.cpp
- * @brief Library to serialize the timeline clock parameters to json
+ * @brief Library to serialize the timeline clock parameters to json or a compact binary format
  * @author Anon D'Anon
  *
  * Copyright (c) Anon, 2018.
@@ -30,10 +30,112 @@
 /* Only build if the timeline service is being built */
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
 
 // Header 
 #include "qot_clkparams_serialize.hpp"
 
+// Subject wildcard matching
+#include "qot_pubsub.hpp"
+
+// Binary message types (second byte of a binary message)
+#define QOT_PARAMS_TYPE_CLKPARAMS    1
+#define QOT_PARAMS_TYPE_PEER_PARAMS  2
+#define QOT_PARAMS_TYPE_PEER_OFFSETS 3
+
+// Binary record layouts: 8-byte header (version, type, reserved, count) followed by fixed fields
+#define QOT_PARAMS_HDR_LEN          8
+#define QOT_CLKPARAMS_BIN_LEN       (QOT_PARAMS_HDR_LEN + 10*8 + 2*QOT_MAX_NAMELEN)
+#define QOT_PEER_PARAMS_BIN_LEN     (QOT_PARAMS_HDR_LEN + 3*8 + 2*QOT_MAX_NAMELEN)
+#define QOT_PEER_OFFSET_BIN_LEN     (2*8 + QOT_MAX_NAMELEN)
+
+namespace
+{
+	// Per-subject encoding selection
+	std::mutex encoding_lock;
+	std::vector<std::pair<std::string, qot_params_encoding_t> > encoding_table;
+
+	// Little-endian field writers (fixed layout regardless of the host)
+	void put_u64(std::string &out, uint64_t value)
+	{
+		for (int i = 0; i < 8; i++)
+			out.push_back((char)((value >> (8*i)) & 0xff));
+	}
+
+	void put_i64(std::string &out, int64_t value)
+	{
+		put_u64(out, (uint64_t)value);
+	}
+
+	void put_f64(std::string &out, double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		put_u64(out, bits);
+	}
+
+	void put_name(std::string &out, const std::string &name)
+	{
+		out.append(name);
+		out.append(QOT_MAX_NAMELEN - name.size(), '\0');
+	}
+
+	void put_header(std::string &out, int type, uint32_t count)
+	{
+		out.push_back((char)QOT_PARAMS_WIRE_VERSION);
+		out.push_back((char)type);
+		out.append(2, '\0');
+		for (int i = 0; i < 4; i++)
+			out.push_back((char)((count >> (8*i)) & 0xff));
+	}
+
+	// Little-endian field readers (bounds are checked against the record length by the caller)
+	uint64_t get_u64(const char *in)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < 8; i++)
+			value |= ((uint64_t)(unsigned char)in[i]) << (8*i);
+		return value;
+	}
+
+	double get_f64(const char *in)
+	{
+		uint64_t bits = get_u64(in);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	std::string get_name(const char *in)
+	{
+		return std::string(in, strnlen(in, QOT_MAX_NAMELEN));
+	}
+
+	uint32_t get_count(const char *in)
+	{
+		uint32_t count = 0;
+		for (int i = 0; i < 4; i++)
+			count |= ((uint32_t)(unsigned char)in[4 + i]) << (8*i);
+		return count;
+	}
+
+	// Names must leave room for the terminating NUL of the fixed-size field
+	bool fits_name(const std::string &name)
+	{
+		return name.size() < QOT_MAX_NAMELEN;
+	}
+
+	// Check the version and type of a binary message (returns false for JSON and foreign messages)
+	bool is_binary(const std::string &data, int type)
+	{
+		return data.size() >= QOT_PARAMS_HDR_LEN
+		    && data[0] == (char)QOT_PARAMS_WIRE_VERSION
+		    && data[1] == (char)type;
+	}
+}
+
 // Serialize Timeline Clock Parameters
 json serialize_clkparams(tl_translation_t &clk_params)
 {
@@ -66,5 +168,232 @@ void deserialize_clkparams(json &data, tl_translation_t &clk_params)
 	return;
 }
 
+// Select the encoding of messages published on subjects matching a pattern (later calls take precedence)
+void set_params_encoding(const std::string &pattern, qot_params_encoding_t encoding)
+{
+	std::lock_guard<std::mutex> lock(encoding_lock);
+	encoding_table.push_back(std::make_pair(pattern, encoding));
+}
+
+// Encoding to use for a subject (falls back to QOT_PARAMS_ENCODING, then JSON)
+qot_params_encoding_t get_params_encoding(const std::string &subject)
+{
+	{
+		std::lock_guard<std::mutex> lock(encoding_lock);
+		for (size_t i = encoding_table.size(); i > 0; i--)
+		{
+			if (qot::pubsub_subject_match(encoding_table[i-1].first, subject))
+				return encoding_table[i-1].second;
+		}
+	}
+
+	const char *env = getenv(QOT_PARAMS_ENCODING_ENV);
+	if (env != NULL && strcmp(env, "binary") == 0)
+		return QOT_PARAMS_ENC_BINARY;
+	return QOT_PARAMS_ENC_JSON;
+}
 
+// Encode a timeline clock parameter update
+std::string encode_clkparams_msg(const clkparams_msg &msg, qot_params_encoding_t encoding)
+{
+	// Names which do not fit the fixed-size fields are sent as JSON
+	if (encoding == QOT_PARAMS_ENC_BINARY && fits_name(msg.timeline_uuid) && fits_name(msg.node_uuid))
+	{
+		std::string out;
+		out.reserve(QOT_CLKPARAMS_BIN_LEN);
+		put_header(out, QOT_PARAMS_TYPE_CLKPARAMS, 1);
+		put_u64(out, msg.seq);
+		put_i64(out, msg.params.last);
+		put_i64(out, msg.params.mult);
+		put_i64(out, msg.params.nsec);
+		put_i64(out, msg.params.u_nsec);
+		put_i64(out, msg.params.l_nsec);
+		put_i64(out, msg.params.u_mult);
+		put_i64(out, msg.params.l_mult);
+		put_u64(out, msg.desired_accuracy);
+		put_u64(out, 0);                      // Reserved
+		put_name(out, msg.timeline_uuid);
+		put_name(out, msg.node_uuid);
+		return out;
+	}
 
+	tl_translation_t params = msg.params;
+	json j = serialize_clkparams(params);
+	j["seq"] = msg.seq;
+	j["timeline_uuid"] = msg.timeline_uuid;
+	j["node_uuid"] = msg.node_uuid;
+	j["desired_accuracy"] = msg.desired_accuracy;
+	return j.dump();
+}
+
+// Decode a timeline clock parameter update
+int decode_clkparams_msg(const std::string &data, clkparams_msg &msg)
+{
+	if (is_binary(data, QOT_PARAMS_TYPE_CLKPARAMS))
+	{
+		if (data.size() < QOT_CLKPARAMS_BIN_LEN)
+			return -1;
+		const char *in = data.data() + QOT_PARAMS_HDR_LEN;
+		msg.seq = get_u64(in);
+		msg.params.last = (int64_t)get_u64(in + 8);
+		msg.params.mult = (int64_t)get_u64(in + 16);
+		msg.params.nsec = (int64_t)get_u64(in + 24);
+		msg.params.u_nsec = (int64_t)get_u64(in + 32);
+		msg.params.l_nsec = (int64_t)get_u64(in + 40);
+		msg.params.u_mult = (int64_t)get_u64(in + 48);
+		msg.params.l_mult = (int64_t)get_u64(in + 56);
+		msg.desired_accuracy = get_u64(in + 64);
+		msg.timeline_uuid = get_name(in + 80);
+		msg.node_uuid = get_name(in + 80 + QOT_MAX_NAMELEN);
+		return 0;
+	}
+
+	if (data.empty() || data[0] != '{')
+		return -1;
+	try
+	{
+		json j = json::parse(data);
+		deserialize_clkparams(j, msg.params);
+		msg.seq = j.count("seq") ? j["seq"].get<uint64_t>() : 0;
+		msg.desired_accuracy = j.count("desired_accuracy") ? j["desired_accuracy"].get<uint64_t>() : 0;
+		msg.timeline_uuid = j.count("timeline_uuid") ? j["timeline_uuid"].get<std::string>() : std::string();
+		msg.node_uuid = j.count("node_uuid") ? j["node_uuid"].get<std::string>() : std::string();
+	}
+	catch (std::exception &e)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+// Encode pair-wise peer parameters
+std::string encode_peer_params(const peer_params_msg &msg, qot_params_encoding_t encoding)
+{
+	if (encoding == QOT_PARAMS_ENC_BINARY && fits_name(msg.client) && fits_name(msg.server))
+	{
+		std::string out;
+		out.reserve(QOT_PEER_PARAMS_BIN_LEN);
+		put_header(out, QOT_PARAMS_TYPE_PEER_PARAMS, 1);
+		put_f64(out, msg.offset);
+		put_f64(out, msg.drift);
+		put_f64(out, msg.start_time);
+		put_name(out, msg.client);
+		put_name(out, msg.server);
+		return out;
+	}
+
+	json j;
+	j["client"] = msg.client;
+	j["server"] = msg.server;
+	j["offset"] = msg.offset;
+	j["drift"] = msg.drift;
+	j["start_time"] = msg.start_time;
+	return j.dump();
+}
+
+// Decode pair-wise peer parameters
+int decode_peer_params(const std::string &data, peer_params_msg &msg)
+{
+	if (is_binary(data, QOT_PARAMS_TYPE_PEER_PARAMS))
+	{
+		if (data.size() < QOT_PEER_PARAMS_BIN_LEN)
+			return -1;
+		const char *in = data.data() + QOT_PARAMS_HDR_LEN;
+		msg.offset = get_f64(in);
+		msg.drift = get_f64(in + 8);
+		msg.start_time = get_f64(in + 16);
+		msg.client = get_name(in + 24);
+		msg.server = get_name(in + 24 + QOT_MAX_NAMELEN);
+		return 0;
+	}
+
+	if (data.empty() || data[0] != '{')
+		return -1;
+	try
+	{
+		json j = json::parse(data);
+		msg.client = j["client"].get<std::string>();
+		msg.server = j["server"].get<std::string>();
+		msg.offset = j["offset"].get<double>();
+		msg.drift = j["drift"].get<double>();
+		msg.start_time = j["start_time"].get<double>();
+	}
+	catch (std::exception &e)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+// Encode the per-node offsets of the network effect
+std::string encode_peer_offsets(const std::vector<peer_offset_msg> &offsets, qot_params_encoding_t encoding)
+{
+	bool binary = (encoding == QOT_PARAMS_ENC_BINARY);
+	for (size_t i = 0; binary && i < offsets.size(); i++)
+		binary = fits_name(offsets[i].node);
+
+	if (binary)
+	{
+		std::string out;
+		out.reserve(QOT_PARAMS_HDR_LEN + offsets.size()*QOT_PEER_OFFSET_BIN_LEN);
+		put_header(out, QOT_PARAMS_TYPE_PEER_OFFSETS, (uint32_t)offsets.size());
+		for (size_t i = 0; i < offsets.size(); i++)
+		{
+			put_f64(out, offsets[i].offset);
+			put_f64(out, offsets[i].final_time);
+			put_name(out, offsets[i].node);
+		}
+		return out;
+	}
+
+	// An empty set is still an object ("{}" rather than "null")
+	json j = json::object();
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		j[offsets[i].node]["offset"] = offsets[i].offset;
+		j[offsets[i].node]["final time"] = offsets[i].final_time;
+	}
+	return j.dump();
+}
+
+// Decode the per-node offsets of the network effect
+int decode_peer_offsets(const std::string &data, std::vector<peer_offset_msg> &offsets)
+{
+	offsets.clear();
+	if (is_binary(data, QOT_PARAMS_TYPE_PEER_OFFSETS))
+	{
+		uint32_t count = get_count(data.data());
+		if (count > (data.size() - QOT_PARAMS_HDR_LEN)/QOT_PEER_OFFSET_BIN_LEN)
+			return -1;
+		const char *in = data.data() + QOT_PARAMS_HDR_LEN;
+		offsets.resize(count);
+		for (uint32_t i = 0; i < count; i++, in += QOT_PEER_OFFSET_BIN_LEN)
+		{
+			offsets[i].offset = get_f64(in);
+			offsets[i].final_time = get_f64(in + 8);
+			offsets[i].node = get_name(in + 16);
+		}
+		return 0;
+	}
+
+	if (data.empty() || data[0] != '{')
+		return -1;
+	try
+	{
+		json j = json::parse(data);
+		for (json::iterator it = j.begin(); it != j.end(); ++it)
+		{
+			peer_offset_msg entry;
+			entry.node = it.key();
+			entry.offset = it.value()["offset"].get<double>();
+			entry.final_time = it.value()["final time"].get<double>();
+			offsets.push_back(entry);
+		}
+	}
+	catch (std::exception &e)
+	{
+		offsets.clear();
+		return -1;
+	}
+	return 0;
+}
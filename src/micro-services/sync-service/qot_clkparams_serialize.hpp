@@ -1,6 +1,6 @@
 /*
  * @file qot_clkparams_serialize.hpp
- * @brief Library Header to serialize the timeline clock parameters to json
+ * @brief Library Header to serialize the timeline clock parameters to json or a compact binary format
  * @author Anon D'Anon
  *
  * Copyright (c) Anon, 2018.
@@ -36,16 +36,75 @@ extern "C"
 	#include "../../qot_types.h"
 }
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 // Add header to Modern JSON C++ Library
 #include "../../../thirdparty/json-modern-cpp/json.hpp"
 
 using json = nlohmann::json;
 
+// Version byte leading every binary message (a JSON message starts with '{')
+#define QOT_PARAMS_WIRE_VERSION 1
+
+// Environment variable selecting the default encoding ("json" or "binary")
+#define QOT_PARAMS_ENCODING_ENV "QOT_PARAMS_ENCODING"
+
+// Encodings of the parameter messages on the pub-sub path
+typedef enum {
+	QOT_PARAMS_ENC_JSON   = 0,       /* Self-describing JSON (default)    */
+	QOT_PARAMS_ENC_BINARY = 1,       /* Fixed-size little-endian records  */
+} qot_params_encoding_t;
+
+// Timeline clock parameter update (qot.timeline.<uuid>.params and sync master topics)
+struct clkparams_msg {
+	tl_translation_t params;         /* Timeline translation parameters   */
+	uint64_t seq;                    /* Publisher sequence number         */
+	uint64_t desired_accuracy;       /* Publishing node desired accuracy  */
+	std::string timeline_uuid;       /* Timeline name                     */
+	std::string node_uuid;           /* Publishing node name              */
+};
+
+// Pair-wise peer parameters (qot.peer.params)
+struct peer_params_msg {
+	std::string client;              /* Probing node                      */
+	std::string server;              /* Probed node                       */
+	double offset;                   /* Estimated offset                  */
+	double drift;                    /* Estimated drift                   */
+	double start_time;               /* Start of the estimation window    */
+};
+
+// Per-node offset computed by the network effect (qot.peer.offsets)
+struct peer_offset_msg {
+	std::string node;                /* Node name                         */
+	double offset;                   /* Offset of the node                */
+	double final_time;               /* Time at which the offset holds    */
+};
+
 // Serialize Timeline Clock Parameters
 json serialize_clkparams(tl_translation_t &clk_params);
 
 // Deserialize Timeline Clock Parameters
 void deserialize_clkparams(json &data, tl_translation_t &clk_param);
 
+// Select the encoding of messages published on subjects matching a pattern (later calls take precedence)
+void set_params_encoding(const std::string &pattern, qot_params_encoding_t encoding);
+
+// Encoding to use for a subject (falls back to QOT_PARAMS_ENCODING, then JSON)
+qot_params_encoding_t get_params_encoding(const std::string &subject);
+
+// Encode/decode a timeline clock parameter update (decoding detects the encoding, returns 0 on success)
+std::string encode_clkparams_msg(const clkparams_msg &msg, qot_params_encoding_t encoding);
+int decode_clkparams_msg(const std::string &data, clkparams_msg &msg);
+
+// Encode/decode pair-wise peer parameters
+std::string encode_peer_params(const peer_params_msg &msg, qot_params_encoding_t encoding);
+int decode_peer_params(const std::string &data, peer_params_msg &msg);
+
+// Encode/decode the per-node offsets of the network effect
+std::string encode_peer_offsets(const std::vector<peer_offset_msg> &offsets, qot_params_encoding_t encoding);
+int decode_peer_offsets(const std::string &data, std::vector<peer_offset_msg> &offsets);
+
 #endif
 
@@ -0,0 +1,509 @@
+/*
+ * @file qot_fault.cpp
+ * @brief Fault injection scripts and their control socket
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C"
+{
+	#include <errno.h>
+	#include <math.h>
+	#include <poll.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <sys/un.h>
+}
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include "qot_fault.hpp"
+
+// Time a client has to send its command, and the control thread's check for shutdown
+#define QOT_FAULT_REQUEST_MS 200
+#define QOT_FAULT_POLL_MS    200
+
+using namespace qot;
+
+static const char *fault_names[QOT_FAULT_NUM_TYPES] = {
+	"step", "freq", "noise", "delay", "loss", "asymmetry"
+};
+
+// Arguments after the class name: required, optional
+static const int fault_args[QOT_FAULT_NUM_TYPES][2] = {
+	{1, 0}, {1, 1}, {2, 0}, {3, 0}, {2, 0}, {2, 0}
+};
+
+/* A fault of the armed script with its generator */
+struct fault_state {
+	qot_fault_t fault;
+	uint64_t rng;
+	bool applied;			// Step taken
+};
+
+// Armed script, the hooks only take the lock while a script is armed
+static std::mutex fault_mutex;
+static std::atomic<bool> fault_on(false);
+static std::vector<fault_state> fault_script;
+static int64_t fault_origin = 0;
+static std::atomic<uint64_t> fault_injected[QOT_FAULT_NUM_TYPES];
+
+static int64_t fault_monotonic()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+/* splitmix64 spreads the script seed over the faults, xorshift64 draws */
+static uint64_t fault_seed(uint64_t seed, size_t index)
+{
+	uint64_t z = seed + (index + 1)*0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+static double fault_uniform(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return (state >> 11)*(1.0/9007199254740992.0);
+}
+
+static double fault_gaussian(uint64_t &state)
+{
+	double u = fault_uniform(state);
+	double v = fault_uniform(state);
+	return sqrt(-2.0*log(u > 0 ? u : 1e-300))*cos(2*M_PI*v);
+}
+
+static bool fault_active(const qot_fault_t &fault, int64_t elapsed)
+{
+	return elapsed >= fault.start_ns && (fault.duration_ns == 0 || elapsed < fault.start_ns + fault.duration_ns);
+}
+
+const char *qot::fault_type_name(int type)
+{
+	if (type < 0 || type >= QOT_FAULT_NUM_TYPES)
+		return NULL;
+	return fault_names[type];
+}
+
+int qot::fault_parse(const std::string &script, uint64_t &seed, std::vector<qot_fault_t> &faults, std::string &error)
+{
+	std::istringstream lines(script);
+	std::string line;
+	int number = 0;
+
+	seed = 1;
+	faults.clear();
+	while (std::getline(lines, line))
+	{
+		number++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream tokens(line);
+		std::vector<std::string> words;
+		std::string word;
+		while (tokens >> word)
+			words.push_back(word);
+		if (words.empty())
+			continue;
+
+		std::ostringstream where;
+		where << "line " << number << ": ";
+		if (words[0] == "seed")
+		{
+			char *end = NULL;
+			if (words.size() != 2 || (seed = strtoull(words[1].c_str(), &end, 0), *end != '\0'))
+			{
+				error = where.str() + "expected \"seed <n>\"";
+				return -1;
+			}
+			continue;
+		}
+
+		// Start time and class
+		qot_fault_t fault;
+		memset(&fault, 0, sizeof(fault));
+		fault.type = -1;
+		for (int i = 0; words.size() > 1 && i < QOT_FAULT_NUM_TYPES; i++)
+		{
+			if (words[1] == fault_names[i])
+				fault.type = i;
+		}
+		char *end = NULL;
+		double start_s = strtod(words[0].c_str(), &end);
+		if (*end != '\0' || start_s < 0 || fault.type < 0)
+		{
+			error = where.str() + "expected \"<start_s> <class> <arguments>\"";
+			return -1;
+		}
+		size_t nargs = words.size() - 2;
+		if (nargs < (size_t) fault_args[fault.type][0] || nargs > (size_t) (fault_args[fault.type][0] + fault_args[fault.type][1]))
+		{
+			error = where.str() + "wrong number of arguments for " + words[1];
+			return -1;
+		}
+
+		std::vector<double> args;
+		for (size_t i = 2; i < words.size(); i++)
+		{
+			args.push_back(strtod(words[i].c_str(), &end));
+			if (*end != '\0')
+			{
+				error = where.str() + "bad number " + words[i];
+				return -1;
+			}
+		}
+
+		// Value first, then the probability (spikes and loss), the duration last
+		fault.start_ns = llround(start_s*1e9);
+		if (fault.type == QOT_FAULT_LOSS)
+			fault.probability = args[0];
+		else
+			fault.value = llround(args[0]);
+		if (fault.type == QOT_FAULT_DELAY)
+			fault.probability = args[1];
+		if (fault.type != QOT_FAULT_STEP && args.size() > 1)
+			fault.duration_ns = llround(args.back()*1e9);
+
+		if (fault.probability < 0 || fault.probability > 1 || fault.duration_ns < 0 ||
+			((fault.type == QOT_FAULT_NOISE || fault.type == QOT_FAULT_DELAY) && fault.value < 0))
+		{
+			error = where.str() + "argument out of range";
+			return -1;
+		}
+		faults.push_back(fault);
+	}
+	return 0;
+}
+
+int qot::fault_arm(const std::string &script, std::string &error, int64_t origin_ns)
+{
+	#ifdef QOT_FAULT_INJECTION
+	uint64_t seed;
+	std::vector<qot_fault_t> faults;
+	if (fault_parse(script, seed, faults, error) < 0)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	fault_script.clear();
+	for (size_t i = 0; i < faults.size(); i++)
+	{
+		fault_state state;
+		state.fault = faults[i];
+		state.rng = fault_seed(seed, i);
+		state.applied = false;
+		fault_script.push_back(state);
+	}
+	for (int i = 0; i < QOT_FAULT_NUM_TYPES; i++)
+		fault_injected[i] = 0;
+	fault_origin = (origin_ns < 0) ? fault_monotonic() : origin_ns;
+	fault_on = true;
+	return 0;
+	#else
+	error = "built without fault injection";
+	return -1;
+	#endif
+}
+
+int qot::fault_arm_file(const std::string &path, std::string &error)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		error = "cannot open " + path;
+		return -1;
+	}
+	std::stringstream script;
+	script << file.rdbuf();
+	return fault_arm(script.str(), error);
+}
+
+void qot::fault_disarm()
+{
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	fault_on = false;
+	fault_script.clear();
+}
+
+bool qot::fault_armed()
+{
+	return fault_on;
+}
+
+void qot::fault_counts(uint64_t counts[QOT_FAULT_NUM_TYPES])
+{
+	for (int i = 0; i < QOT_FAULT_NUM_TYPES; i++)
+		counts[i] = fault_injected[i];
+}
+
+#ifdef QOT_FAULT_INJECTION
+/* Hooks */
+
+extern "C" int64_t qot_fault_clock_step(void)
+{
+	if (!fault_on.load(std::memory_order_relaxed))
+		return 0;
+
+	int64_t step = 0;
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	int64_t elapsed = fault_monotonic() - fault_origin;
+	for (size_t i = 0; i < fault_script.size(); i++)
+	{
+		fault_state &state = fault_script[i];
+		if (state.fault.type != QOT_FAULT_STEP || state.applied || elapsed < state.fault.start_ns)
+			continue;
+		state.applied = true;
+		step += state.fault.value;
+		fault_injected[QOT_FAULT_STEP]++;
+	}
+	return step;
+}
+
+extern "C" int64_t qot_fault_clock_freq(void)
+{
+	if (!fault_on.load(std::memory_order_relaxed))
+		return 0;
+
+	int64_t ppb = 0;
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	int64_t elapsed = fault_monotonic() - fault_origin;
+	for (size_t i = 0; i < fault_script.size(); i++)
+	{
+		const qot_fault_t &fault = fault_script[i].fault;
+		if (fault.type != QOT_FAULT_FREQ || !fault_active(fault, elapsed))
+			continue;
+		ppb += fault.value;
+		fault_injected[QOT_FAULT_FREQ]++;
+	}
+	return ppb;
+}
+
+/* Error of one packet: noise on every timestamp, spikes and asymmetry on the inbound path */
+static int fault_packet_locked(int inbound, double &shift, double noise_scale, double path_scale)
+{
+	int drop = 0;
+	int64_t elapsed = fault_monotonic() - fault_origin;
+	for (size_t i = 0; i < fault_script.size(); i++)
+	{
+		fault_state &state = fault_script[i];
+		const qot_fault_t &fault = state.fault;
+		if (!fault_active(fault, elapsed))
+			continue;
+		switch (fault.type)
+		{
+			case QOT_FAULT_NOISE:
+				shift += noise_scale*fault.value*fault_gaussian(state.rng);
+				fault_injected[QOT_FAULT_NOISE]++;
+				break;
+			case QOT_FAULT_DELAY:
+				if (inbound && fault_uniform(state.rng) < fault.probability)
+				{
+					shift += path_scale*fault.value;
+					fault_injected[QOT_FAULT_DELAY]++;
+				}
+				break;
+			case QOT_FAULT_LOSS:
+				if (fault_uniform(state.rng) < fault.probability)
+				{
+					drop = 1;
+					fault_injected[QOT_FAULT_LOSS]++;
+				}
+				break;
+			case QOT_FAULT_ASYMMETRY:
+				if (inbound)
+				{
+					shift += path_scale*fault.value;
+					fault_injected[QOT_FAULT_ASYMMETRY]++;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return drop;
+}
+
+extern "C" int qot_fault_packet(int inbound, int64_t *shift_ns)
+{
+	if (!fault_on.load(std::memory_order_relaxed))
+		return 0;
+
+	double shift = 0;
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	int drop = fault_packet_locked(inbound, shift, 1.0, 1.0);
+	*shift_ns += llround(shift);
+	return drop;
+}
+
+extern "C" int qot_fault_sample(int64_t *offset_ns)
+{
+	if (!fault_on.load(std::memory_order_relaxed))
+		return 0;
+
+	// Half of an inbound path error shows in the offset, the noise of the four timestamps averages to one sigma
+	double shift = 0;
+	std::lock_guard<std::mutex> lock(fault_mutex);
+	int drop = fault_packet_locked(1, shift, 1.0, 0.5);
+	*offset_ns += llround(shift);
+	return drop;
+}
+#endif
+
+/* Control socket */
+
+FaultController::FaultController(const std::string &service)
+  : socket_path(std::string(QOT_FAULT_SOCKET_DIR) + "/" + service + ".sock"), listen_fd(-1), running(false)
+{
+}
+
+FaultController::~FaultController()
+{
+	Stop();
+}
+
+std::string FaultController::GetSocketPath()
+{
+	return socket_path;
+}
+
+int FaultController::Start()
+{
+	if (running)
+		return 0;
+
+	// A stale socket of a previous run is replaced
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	mkdir(QOT_FAULT_SOCKET_DIR, 0777);
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path.c_str());
+	unlink(address.sun_path);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(listen_fd, 4) < 0)
+	{
+		std::cout << "qot_fault: socket " << socket_path << " failed: " << strerror(errno) << "\n";
+		if (listen_fd >= 0)
+			close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+
+	running = true;
+	serve_thread = std::thread(&FaultController::ServeLoop, this);
+	return 0;
+}
+
+void FaultController::Stop()
+{
+	if (!running)
+		return;
+	running = false;
+	serve_thread.join();
+	close(listen_fd);
+	listen_fd = -1;
+	unlink(socket_path.c_str());
+}
+
+std::string FaultController::Command(const std::string &command)
+{
+	std::istringstream tokens(command);
+	std::string verb, argument, error;
+	tokens >> verb;
+	std::getline(tokens >> std::ws, argument);
+
+	if (verb == "arm" && !argument.empty())
+	{
+		if (fault_arm_file(argument, error) < 0)
+			return "error " + error + "\n";
+		return "ok\n";
+	}
+	if (verb == "disarm")
+	{
+		fault_disarm();
+		return "ok\n";
+	}
+	if (verb == "status")
+	{
+		uint64_t counts[QOT_FAULT_NUM_TYPES];
+		fault_counts(counts);
+		std::ostringstream reply;
+		reply << "armed " << (fault_armed() ? 1 : 0);
+		for (int i = 0; i < QOT_FAULT_NUM_TYPES; i++)
+			reply << " " << fault_names[i] << " " << counts[i];
+		reply << "\n";
+		return reply.str();
+	}
+	return "error expected \"arm <script file>\", \"disarm\" or \"status\"\n";
+}
+
+void FaultController::Serve(int fd)
+{
+	char request[512];
+	ssize_t len = 0;
+	struct pollfd pfd = {fd, POLLIN, 0};
+	if (poll(&pfd, 1, QOT_FAULT_REQUEST_MS) > 0)
+		len = recv(fd, request, sizeof(request) - 1, 0);
+	if (len > 0)
+	{
+		request[len] = '\0';
+		std::string command(request);
+		size_t eol = command.find_first_of("\r\n");
+		if (eol != std::string::npos)
+			command.erase(eol);
+		std::string reply = Command(command);
+		send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+	}
+	close(fd);
+}
+
+void FaultController::ServeLoop()
+{
+	while (running)
+	{
+		struct pollfd pfd = {listen_fd, POLLIN, 0};
+		if (poll(&pfd, 1, QOT_FAULT_POLL_MS) > 0)
+		{
+			int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (fd >= 0)
+				Serve(fd);
+		}
+	}
+}
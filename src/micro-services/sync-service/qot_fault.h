@@ -0,0 +1,97 @@
+/*
+ * @file qot_fault.h
+ * @brief Fault injection hooks between the sync stack and its clock and network sources
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_FAULT_H
+#define QOT_STACK_FAULT_H
+
+#include <stdint.h>
+
+/* Faults follow a script armed at runtime through the control socket
+   QOT_FAULT_SOCKET_DIR/<service>.sock. The hooks are compiled in only with
+   QOT_FAULT_INJECTION (BUILD_FAULT_INJECTION), otherwise they do nothing */
+#define QOT_FAULT_SOCKET_DIR "/tmp/qot-fault"
+
+/**
+ * @brief Fault classes, and the meaning of their script arguments
+ */
+typedef enum {
+    QOT_FAULT_STEP      = (0),          /* step_ns: phase step of the disciplined clock (one-shot)   */
+    QOT_FAULT_FREQ      = (1),          /* ppb [duration]: frequency error of the disciplined clock  */
+    QOT_FAULT_NOISE     = (2),          /* sigma_ns duration: Gaussian noise on every timestamp      */
+    QOT_FAULT_DELAY     = (3),          /* spike_ns probability duration: inbound delay spikes       */
+    QOT_FAULT_LOSS      = (4),          /* probability duration: packet and sample loss              */
+    QOT_FAULT_ASYMMETRY = (5),          /* ns duration: inbound minus outbound path delay            */
+    QOT_FAULT_NUM_TYPES = (6),
+} qot_fault_type_t;
+
+/**
+ * @brief One fault of a script
+ */
+typedef struct qot_fault {
+    int      type;                      /* qot_fault_type_t                                          */
+    int64_t  start_ns;                  /* Start relative to the arming time (CLOCK_MONOTONIC)       */
+    int64_t  duration_ns;               /* Active time, 0 until disarmed (ignored for steps)         */
+    int64_t  value;                     /* step_ns, ppb, sigma_ns, spike_ns or asymmetry_ns          */
+    double   probability;               /* Share of the packets hit by a spike or lost               */
+} qot_fault_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef QOT_FAULT_INJECTION
+
+/* Clock adjustment path: phase step (ns) due since the last call, applied once */
+int64_t qot_fault_clock_step(void);
+
+/* Clock adjustment path: frequency error (ppb) added to the frequency set by the servo */
+int64_t qot_fault_clock_freq(void);
+
+/* Packet timestamps: adds the injected error of a packet (ns) to *shift_ns, returns 1
+   if the packet is to be dropped. Inbound packets get spikes and the asymmetry */
+int qot_fault_packet(int inbound, int64_t *shift_ns);
+
+/* Offset samples (two-way exchanges): adds the injected offset error (ns) to
+   *offset_ns, returns 1 if the sample is to be dropped */
+int qot_fault_sample(int64_t *offset_ns);
+
+#else
+
+static inline int64_t qot_fault_clock_step(void) { return 0; }
+static inline int64_t qot_fault_clock_freq(void) { return 0; }
+static inline int qot_fault_packet(int inbound, int64_t *shift_ns) { (void) inbound; (void) shift_ns; return 0; }
+static inline int qot_fault_sample(int64_t *offset_ns) { (void) offset_ns; return 0; }
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * @file qot_fault.hpp
+ * @brief Fault injection scripts and their control socket
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_FAULT_HPP
+#define QOT_STACK_FAULT_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "qot_fault.h"
+
+/* A script has one fault per line, "<start_s> <class> <arguments>", and an
+   optional "seed <n>" line. Each fault draws from its own generator seeded
+   from the script seed, so a script replays the same faults on the same
+   sequence of samples. '#' starts a comment:
+
+   seed 7
+   10   step      250000            # 250 us phase step
+   20   freq      20000   30        # +20 ppm for 30 s
+   60   noise     500     10        # 500 ns rms timestamp noise for 10 s
+   80   delay     2000000 0.05 10   # 2 ms spikes on 5% of the inbound packets
+   100  loss      0.3     10        # 30% loss
+   120  asymmetry 50000   10        # inbound path 50 us longer              */
+
+namespace qot
+{
+	// Parse a script, returns 0 on success or -1 with the offending line in error
+	int fault_parse(const std::string &script, uint64_t &seed, std::vector<qot_fault_t> &faults, std::string &error);
+
+	// Arm a script (replacing the armed one), fault times count from origin_ns
+	// on CLOCK_MONOTONIC, or from now if negative. Fails in builds without fault injection
+	int fault_arm(const std::string &script, std::string &error, int64_t origin_ns = -1);
+
+	// Arm a script file
+	int fault_arm_file(const std::string &path, std::string &error);
+
+	// Stop injecting faults
+	void fault_disarm();
+
+	// Check if a script is armed
+	bool fault_armed();
+
+	// Faults injected since the script was armed, by class
+	void fault_counts(uint64_t counts[QOT_FAULT_NUM_TYPES]);
+
+	// Name of a fault class (NULL if out of range)
+	const char *fault_type_name(int type);
+
+	/* Control socket of a service, one command per connection:
+	   "arm <script file>", "disarm" or "status" */
+	class FaultController
+	{
+		// Constructor and Destructor
+		public: FaultController(const std::string &service);
+		public: ~FaultController();
+
+		// Create the socket and start the control thread, returns 0 on success
+		public: int Start();
+
+		// Stop the thread and remove the socket
+		public: void Stop();
+
+		// Path of the control socket
+		public: std::string GetSocketPath();
+
+		// Execute a command, returns the reply
+		public: std::string Command(const std::string &command);
+
+		/* Private Functions */
+		private: void ServeLoop();
+		private: void Serve(int fd);
+
+		/* Private Variables */
+		private: std::string socket_path;
+		private: int listen_fd;
+		private: std::atomic<bool> running;
+		private: std::thread serve_thread;
+	};
+}
+
+#endif
@@ -0,0 +1,588 @@
+/*
+ * @file qot_metrics.cpp
+ * @brief Lock-free runtime metrics of the QoT services
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C"
+{
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <sys/un.h>
+}
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "qot_metrics.hpp"
+
+// Time a scraper has to send its (optional) HTTP request line
+#define QOT_METRICS_REQUEST_MS 50
+
+// Attempts to copy a consistent snapshot segment
+#define QOT_METRICS_READ_RETRIES 1000
+
+using namespace qot;
+
+/* Registered metric */
+struct metrics_desc {
+	qot_metric_type_t type;
+	std::string name;
+	std::string labels;
+	std::string help;
+};
+
+/* Histogram buckets of one thread */
+struct metrics_hist {
+	std::atomic<uint64_t> buckets[QOT_METRICS_BUCKETS];
+};
+
+/* Values written by one thread only, summed by the readers. A shard is
+   recycled by the next thread once its owner exits, so the values stay cumulative */
+struct metrics_shard {
+	std::atomic<bool> active;
+	std::atomic<uint64_t> counts[QOT_METRICS_MAX];		// Counter values and histogram sample counts
+	std::atomic<uint64_t> sums[QOT_METRICS_MAX];		// Histogram sample sums
+	std::atomic<metrics_hist*> hists[QOT_METRICS_MAX];	// Allocated by the owner on first use
+	char pad[64];										// Keep the next shard off our cache lines
+};
+
+/* shm parameter segment watched for publishes */
+struct metrics_watch {
+	tl_translation_t *params;
+	uint32_t last_seq;
+	int metric_id;
+};
+
+// Registry: descriptors are immutable once num_metrics covers them
+static std::mutex registry_mutex;
+static metrics_desc registry[QOT_METRICS_MAX];
+static std::atomic<int> num_metrics(0);
+static std::vector<metrics_shard*> shards;
+
+// Watched parameter segments
+static std::mutex watch_mutex;
+static std::vector<metrics_watch> watches;
+
+/* Releases the shard of a thread when it exits */
+struct metrics_thread_slot {
+	metrics_shard *shard;
+	~metrics_thread_slot()
+	{
+		if (shard)
+			shard->active.store(false, std::memory_order_release);
+	}
+};
+static thread_local metrics_thread_slot thread_slot = {NULL};
+
+static metrics_shard *local_shard()
+{
+	metrics_shard *shard = thread_slot.shard;
+	if (shard)
+		return shard;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		bool idle = false;
+		if (shards[i]->active.compare_exchange_strong(idle, true, std::memory_order_acquire))
+		{
+			thread_slot.shard = shards[i];
+			return shards[i];
+		}
+	}
+	shard = new metrics_shard();
+	shard->active.store(true, std::memory_order_relaxed);
+	for (int i = 0; i < QOT_METRICS_MAX; i++)
+	{
+		shard->counts[i].store(0, std::memory_order_relaxed);
+		shard->sums[i].store(0, std::memory_order_relaxed);
+		shard->hists[i].store(NULL, std::memory_order_relaxed);
+	}
+	shards.push_back(shard);
+	thread_slot.shard = shard;
+	return shard;
+}
+
+// Single writer: a plain load and store is enough, readers only need untorn values
+static inline void shard_add(std::atomic<uint64_t> &value, uint64_t n)
+{
+	value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int qot::metrics_register(qot_metric_type_t type, const std::string &name, const std::string &labels, const std::string &help)
+{
+	if (name.empty() || name.size() >= QOT_METRICS_NAME_LEN || labels.size() >= QOT_METRICS_LABEL_LEN)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	int count = num_metrics.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; i++)
+	{
+		if (registry[i].name == name && registry[i].labels == labels)
+			return registry[i].type == type ? i : -1;
+	}
+	if (count == QOT_METRICS_MAX)
+	{
+		std::cout << "qot_metrics: table full, dropping " << name << "{" << labels << "}\n";
+		return -1;
+	}
+	registry[count].type = type;
+	registry[count].name = name;
+	registry[count].labels = labels;
+	registry[count].help = help;
+	num_metrics.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void qot::metrics_add(int id, uint64_t n)
+{
+	if (id < 0 || id >= QOT_METRICS_MAX)
+		return;
+	shard_add(local_shard()->counts[id], n);
+}
+
+void qot::metrics_record(int id, uint64_t value_ns)
+{
+	if (id < 0 || id >= QOT_METRICS_MAX)
+		return;
+	metrics_shard *shard = local_shard();
+	metrics_hist *hist = shard->hists[id].load(std::memory_order_relaxed);
+	if (!hist)
+	{
+		hist = new metrics_hist();
+		for (int i = 0; i < QOT_METRICS_BUCKETS; i++)
+			hist->buckets[i].store(0, std::memory_order_relaxed);
+		shard->hists[id].store(hist, std::memory_order_release);
+	}
+	shard_add(hist->buckets[metrics_bucket(value_ns)], 1);
+	shard_add(shard->sums[id], value_ns);
+	shard_add(shard->counts[id], 1);
+}
+
+uint64_t qot::metrics_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec)*1000000000ULL + ts.tv_nsec;
+}
+
+int qot::metrics_bucket(uint64_t value)
+{
+	if (value < (1ULL << QOT_METRICS_SUB_BITS))
+		return int(value);
+	int exp = 63 - __builtin_clzll(value);
+	if (exp > QOT_METRICS_MAX_EXP)
+		return QOT_METRICS_BUCKETS - 1;
+	return ((exp - QOT_METRICS_SUB_BITS + 1) << QOT_METRICS_SUB_BITS)
+	     + int((value >> (exp - QOT_METRICS_SUB_BITS)) & ((1ULL << QOT_METRICS_SUB_BITS) - 1));
+}
+
+uint64_t qot::metrics_bucket_limit(int bucket)
+{
+	if (bucket < (1 << QOT_METRICS_SUB_BITS))
+		return uint64_t(bucket);
+	if (bucket >= QOT_METRICS_BUCKETS - 1)
+		return UINT64_MAX;
+	int exp = (bucket >> QOT_METRICS_SUB_BITS) + QOT_METRICS_SUB_BITS - 1;
+	uint64_t sub = uint64_t(bucket & ((1 << QOT_METRICS_SUB_BITS) - 1));
+	uint64_t width = 1ULL << (exp - QOT_METRICS_SUB_BITS);
+	return (1ULL << exp) + sub*width + width - 1;
+}
+
+void qot::metrics_watch_params(const std::string &clock, tl_translation_t *params)
+{
+	if (!params)
+		return;
+	metrics_watch watch;
+	watch.params = params;
+	watch.last_seq = __atomic_load_n(&params->seq, __ATOMIC_ACQUIRE);
+	watch.metric_id = metrics_register(QOT_METRIC_COUNTER, "qot_shm_publish_total", "clock=\"" + clock + "\"",
+	                                   "Parameter updates published to a timeline clock segment");
+	std::lock_guard<std::mutex> lock(watch_mutex);
+	watches.push_back(watch);
+}
+
+void qot::metrics_unwatch_params(tl_translation_t *params)
+{
+	std::lock_guard<std::mutex> lock(watch_mutex);
+	for (size_t i = 0; i < watches.size(); i++)
+	{
+		if (watches[i].params == params)
+		{
+			watches.erase(watches.begin() + i);
+			return;
+		}
+	}
+}
+
+// Every completed publish advances the sequence number by two
+static void scan_watches()
+{
+	std::lock_guard<std::mutex> lock(watch_mutex);
+	for (size_t i = 0; i < watches.size(); i++)
+	{
+		uint32_t seq = __atomic_load_n(&watches[i].params->seq, __ATOMIC_ACQUIRE);
+		uint32_t published = (seq >> 1) - (watches[i].last_seq >> 1);
+		if (published > 0)
+			metrics_add(watches[i].metric_id, published);
+		watches[i].last_seq = seq;
+	}
+}
+
+void qot::metrics_collect(std::vector<qot_metric_snapshot_t> &snapshot)
+{
+	scan_watches();
+
+	int count = num_metrics.load(std::memory_order_acquire);
+	snapshot.assign(count, qot_metric_snapshot_t());
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	for (int id = 0; id < count; id++)
+	{
+		qot_metric_snapshot_t &metric = snapshot[id];
+		memset(&metric, 0, sizeof(metric));
+		strncpy(metric.name, registry[id].name.c_str(), QOT_METRICS_NAME_LEN - 1);
+		strncpy(metric.labels, registry[id].labels.c_str(), QOT_METRICS_LABEL_LEN - 1);
+		metric.type = registry[id].type;
+		for (size_t s = 0; s < shards.size(); s++)
+		{
+			metric.sum += shards[s]->sums[id].load(std::memory_order_relaxed);
+			metrics_hist *hist = shards[s]->hists[id].load(std::memory_order_acquire);
+			if (registry[id].type == QOT_METRIC_COUNTER)
+			{
+				metric.count += shards[s]->counts[id].load(std::memory_order_relaxed);
+			}
+			else if (hist)
+			{
+				for (int b = 0; b < QOT_METRICS_BUCKETS; b++)
+					metric.buckets[b] += hist->buckets[b].load(std::memory_order_relaxed);
+			}
+		}
+
+		// Histogram counts follow the buckets, so +Inf always matches _count
+		if (registry[id].type == QOT_METRIC_HISTOGRAM)
+		{
+			for (int b = 0; b < QOT_METRICS_BUCKETS; b++)
+				metric.count += metric.buckets[b];
+		}
+	}
+}
+
+static std::string format_seconds(uint64_t ns)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.9g", double(ns)/1e9);
+	return std::string(buf);
+}
+
+std::string qot::metrics_prometheus()
+{
+	std::vector<qot_metric_snapshot_t> snapshot;
+	metrics_collect(snapshot);
+
+	// Help strings, read under the lock as metrics_collect does
+	std::vector<std::string> help(snapshot.size());
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		for (size_t id = 0; id < snapshot.size(); id++)
+			help[id] = registry[id].help;
+	}
+
+	// Series of a metric name are emitted together after a single HELP/TYPE header
+	std::ostringstream text;
+	std::vector<bool> done(snapshot.size(), false);
+	for (size_t first = 0; first < snapshot.size(); first++)
+	{
+		if (done[first])
+			continue;
+		std::string name = snapshot[first].name;
+		bool histogram = snapshot[first].type == QOT_METRIC_HISTOGRAM;
+		text << "# HELP " << name << " " << help[first] << "\n";
+		text << "# TYPE " << name << (histogram ? " histogram\n" : " counter\n");
+
+		for (size_t id = first; id < snapshot.size(); id++)
+		{
+			if (done[id] || name != snapshot[id].name)
+				continue;
+			done[id] = true;
+			const qot_metric_snapshot_t &metric = snapshot[id];
+			std::string labels = metric.labels;
+			if (!histogram)
+			{
+				text << name << (labels.empty() ? "" : "{" + labels + "}") << " " << metric.count << "\n";
+				continue;
+			}
+
+			// Buckets up to the highest one in use, the set only grows over time
+			std::string prefix = labels.empty() ? "" : labels + ",";
+			int highest = -1;
+			for (int b = 0; b < QOT_METRICS_BUCKETS - 1; b++)
+			{
+				if (metric.buckets[b] > 0)
+					highest = b;
+			}
+			uint64_t cumulative = 0;
+			for (int b = 0; b <= highest; b++)
+			{
+				cumulative += metric.buckets[b];
+				text << name << "_bucket{" << prefix << "le=\"" << format_seconds(metrics_bucket_limit(b)) << "\"} " << cumulative << "\n";
+			}
+			text << name << "_bucket{" << prefix << "le=\"+Inf\"} " << metric.count << "\n";
+			text << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << format_seconds(metric.sum) << "\n";
+			text << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << metric.count << "\n";
+		}
+	}
+	return text.str();
+}
+
+int qot::metrics_read_shm(const std::string &service, std::vector<qot_metric_snapshot_t> &snapshot)
+{
+	std::string name = QOT_METRICS_SHM_PREFIX + service;
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return -1;
+	void *base = mmap(NULL, sizeof(qot_metrics_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return -1;
+
+	const qot_metrics_shm_t *shm = (const qot_metrics_shm_t*) base;
+	int retval = -1;
+	if (shm->magic == QOT_METRICS_MAGIC && shm->version == QOT_METRICS_VERSION)
+	{
+		for (int i = 0; i < QOT_METRICS_READ_RETRIES && retval != 0; i++)
+		{
+			uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+			if (seq & 1)
+			{
+				sched_yield();
+				continue;
+			}
+			uint32_t count = shm->num_metrics;
+			if (count > QOT_METRICS_MAX)
+				break;
+			snapshot.assign(shm->metrics, shm->metrics + count);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+				retval = 0;
+		}
+	}
+	munmap(base, sizeof(qot_metrics_shm_t));
+	return retval;
+}
+
+/* Event stream */
+
+MetricsStream::MetricsStream(const std::string &name, const std::string &labels, const std::string &help)
+  : last_ns(0)
+{
+	count_metric = metrics_register(QOT_METRIC_COUNTER, name + "_total", labels, "Number of " + help);
+	interval_metric = metrics_register(QOT_METRIC_HISTOGRAM, name + "_interval_seconds", labels, "Interval between " + help);
+}
+
+void MetricsStream::Tick()
+{
+	uint64_t now = metrics_clock();
+	uint64_t last = last_ns.exchange(now, std::memory_order_relaxed);
+	metrics_add(count_metric);
+	if (last != 0 && now > last)
+		metrics_record(interval_metric, now - last);
+}
+
+/* Exporter */
+
+MetricsExporter::MetricsExporter(const std::string &service)
+  : service_name(service), shm_name(QOT_METRICS_SHM_PREFIX + service),
+    socket_path(std::string(QOT_METRICS_SOCKET_DIR) + "/" + service + ".sock"),
+    period(QOT_METRICS_PERIOD_MS), listen_fd(-1), shm(NULL), running(false)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	Stop();
+}
+
+std::string MetricsExporter::GetSocketPath()
+{
+	return socket_path;
+}
+
+int MetricsExporter::Start(int period_ms)
+{
+	if (running)
+		return 0;
+	period = period_ms;
+
+	// Snapshot segment, writable by this process only
+	int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		std::cout << "qot_metrics: segment creation failed: " << strerror(errno) << "\n";
+		return -1;
+	}
+	if (ftruncate(fd, sizeof(qot_metrics_shm_t)) < 0)
+	{
+		close(fd);
+		shm_unlink(shm_name.c_str());
+		return -1;
+	}
+	void *base = mmap(NULL, sizeof(qot_metrics_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		shm_unlink(shm_name.c_str());
+		return -1;
+	}
+	shm = (qot_metrics_shm_t*) base;
+	shm->magic = QOT_METRICS_MAGIC;
+	shm->version = QOT_METRICS_VERSION;
+	shm->num_buckets = QOT_METRICS_BUCKETS;
+	shm->sub_bits = QOT_METRICS_SUB_BITS;
+
+	// Prometheus socket (a stale socket of a previous run is replaced)
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	mkdir(QOT_METRICS_SOCKET_DIR, 0777);
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path.c_str());
+	unlink(address.sun_path);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(listen_fd, 8) < 0)
+	{
+		std::cout << "qot_metrics: socket " << socket_path << " failed: " << strerror(errno) << "\n";
+		if (listen_fd >= 0)
+			close(listen_fd);
+		listen_fd = -1;
+		munmap(shm, sizeof(qot_metrics_shm_t));
+		shm = NULL;
+		shm_unlink(shm_name.c_str());
+		return -1;
+	}
+
+	PublishSnapshot();
+	running = true;
+	export_thread = std::thread(&MetricsExporter::ExportLoop, this);
+	return 0;
+}
+
+void MetricsExporter::Stop()
+{
+	if (!running)
+		return;
+	running = false;
+	export_thread.join();
+	close(listen_fd);
+	listen_fd = -1;
+	unlink(socket_path.c_str());
+	munmap(shm, sizeof(qot_metrics_shm_t));
+	shm = NULL;
+	shm_unlink(shm_name.c_str());
+}
+
+void MetricsExporter::PublishSnapshot()
+{
+	std::vector<qot_metric_snapshot_t> snapshot;
+	metrics_collect(snapshot);
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	shm->num_metrics = snapshot.size();
+	shm->timestamp = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+	if (!snapshot.empty())
+		memcpy(shm->metrics, &snapshot[0], snapshot.size()*sizeof(qot_metric_snapshot_t));
+	__atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void MetricsExporter::Serve(int fd)
+{
+	// Plain clients just read, HTTP scrapers (through a socket proxy) get a response header
+	char request[256];
+	ssize_t len = 0;
+	struct pollfd pfd = {fd, POLLIN, 0};
+	if (poll(&pfd, 1, QOT_METRICS_REQUEST_MS) > 0)
+		len = recv(fd, request, sizeof(request) - 1, MSG_DONTWAIT);
+
+	std::string body = metrics_prometheus();
+	std::string reply;
+	if (len >= 4 && strncmp(request, "GET ", 4) == 0)
+	{
+		std::ostringstream header;
+		header << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.size() << "\r\n\r\n";
+		reply = header.str();
+	}
+	reply += body;
+
+	size_t sent = 0;
+	while (sent < reply.size())
+	{
+		ssize_t n = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		sent += n;
+	}
+	close(fd);
+}
+
+void MetricsExporter::ExportLoop()
+{
+	uint64_t next = metrics_clock() + uint64_t(period)*1000000ULL;
+	while (running)
+	{
+		uint64_t now = metrics_clock();
+		if (now >= next)
+		{
+			PublishSnapshot();
+			next = now + uint64_t(period)*1000000ULL;
+			continue;
+		}
+
+		// Wait for a scraper until the next snapshot is due
+		struct pollfd pfd = {listen_fd, POLLIN, 0};
+		int timeout = int((next - now)/1000000ULL) + 1;
+		if (poll(&pfd, 1, timeout) > 0)
+		{
+			int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (fd >= 0)
+				Serve(fd);
+		}
+	}
+}
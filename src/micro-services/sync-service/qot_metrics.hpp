@@ -0,0 +1,191 @@
+/*
+ * @file qot_metrics.hpp
+ * @brief Lock-free runtime metrics of the QoT services
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_METRICS_HPP
+#define QOT_STACK_METRICS_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Include the QoT Data Types
+extern "C"
+{
+	#include "../../qot_types.h"
+}
+
+// Read-only snapshot segment of a service, QOT_METRICS_SHM_PREFIX<service>
+#define QOT_METRICS_SHM_PREFIX "/qot_metrics_"
+
+// Prometheus text endpoints, QOT_METRICS_SOCKET_DIR/<service>.sock
+#define QOT_METRICS_SOCKET_DIR "/tmp/qot-metrics"
+
+// Period at which the exporter refreshes the snapshot segment
+#define QOT_METRICS_PERIOD_MS 1000
+
+// Largest number of metrics per process
+#define QOT_METRICS_MAX 128
+
+// Lengths of the metric name and label fields (including the terminator)
+#define QOT_METRICS_NAME_LEN  64
+#define QOT_METRICS_LABEL_LEN 64
+
+// Log-linear histograms: 2^SUB_BITS linear buckets per power of two up to 2^(MAX_EXP+1) ns,
+// larger values land in the last bucket which has no upper limit
+#define QOT_METRICS_SUB_BITS 3
+#define QOT_METRICS_MAX_EXP  39
+#define QOT_METRICS_BUCKETS  ((QOT_METRICS_MAX_EXP - QOT_METRICS_SUB_BITS + 2) << QOT_METRICS_SUB_BITS)
+
+// Snapshot segment identification
+#define QOT_METRICS_MAGIC   0x514f544d
+#define QOT_METRICS_VERSION 1
+
+namespace qot
+{
+	/* Metric kinds, histograms record nanoseconds */
+	typedef enum {
+		QOT_METRIC_COUNTER   = (0),
+		QOT_METRIC_HISTOGRAM = (1),
+	} qot_metric_type_t;
+
+	/* Aggregated value of one metric */
+	typedef struct qot_metric_snapshot {
+		char name[QOT_METRICS_NAME_LEN];		// Prometheus metric name
+		char labels[QOT_METRICS_LABEL_LEN];		// Prometheus labels without braces (may be empty)
+		uint32_t type;							// qot_metric_type_t
+		uint32_t pad;
+		uint64_t count;							// Counter value or number of samples
+		uint64_t sum;							// Sum of the samples (ns)
+		uint64_t buckets[QOT_METRICS_BUCKETS];	// Samples per bucket (histograms only)
+	} qot_metric_snapshot_t;
+
+	/* Layout of the snapshot segment. The exporter brackets its writes with an
+	   odd sequence number, readers retry until they copy under the same even one */
+	typedef struct qot_metrics_shm {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t seq;
+		uint32_t num_metrics;
+		int64_t timestamp;						// CLOCK_REALTIME of the snapshot (ns)
+		uint32_t num_buckets;
+		uint32_t sub_bits;
+		qot_metric_snapshot_t metrics[QOT_METRICS_MAX];
+	} qot_metrics_shm_t;
+
+	// Register a metric (the same name and labels return the same id), returns the id or -1 if the table is full
+	int metrics_register(qot_metric_type_t type, const std::string &name, const std::string &labels, const std::string &help);
+
+	// Add to a counter, lock-free and never shared with other threads (ids < 0 are ignored)
+	void metrics_add(int id, uint64_t n = 1);
+
+	// Record a sample in a histogram, lock-free and never shared with other threads (ids < 0 are ignored)
+	void metrics_record(int id, uint64_t value_ns);
+
+	// Monotonic time stamp for latency measurements (ns)
+	uint64_t metrics_clock();
+
+	// Histogram bucket of a value and the largest value of a bucket
+	int metrics_bucket(uint64_t value);
+	uint64_t metrics_bucket_limit(int bucket);
+
+	// Sum the per-thread shards of all metrics
+	void metrics_collect(std::vector<qot_metric_snapshot_t> &snapshot);
+
+	// Prometheus text exposition of all metrics
+	std::string metrics_prometheus();
+
+	// Count the publishes of a shm parameter segment (sampled from its sequence number by the exporter)
+	void metrics_watch_params(const std::string &clock, tl_translation_t *params);
+	void metrics_unwatch_params(tl_translation_t *params);
+
+	// Copy the snapshot segment of a service, returns 0 on success
+	int metrics_read_shm(const std::string &service, std::vector<qot_metric_snapshot_t> &snapshot);
+
+	/* Scoped latency measurement, records the elapsed time on destruction */
+	class MetricsTimer
+	{
+		public: MetricsTimer(int id) : metric_id(id), start_ns(metrics_clock()) {}
+		public: ~MetricsTimer() { metrics_record(metric_id, metrics_clock() - start_ns); }
+
+		private: int metric_id;
+		private: uint64_t start_ns;
+	};
+
+	/* Event stream: counts the events (<name>_total) and records the interval
+	   between consecutive ones (<name>_interval_seconds) */
+	class MetricsStream
+	{
+		public: MetricsStream(const std::string &name, const std::string &labels, const std::string &help);
+
+		// Account for one event
+		public: void Tick();
+
+		private: int count_metric;
+		private: int interval_metric;
+		private: std::atomic<uint64_t> last_ns;
+	};
+
+	/* Publishes the metrics of a service as a read-only shm segment and as
+	   Prometheus text on a unix socket (one scrape per connection) */
+	class MetricsExporter
+	{
+		// Constructor and Destructor
+		public: MetricsExporter(const std::string &service);
+		public: ~MetricsExporter();
+
+		// Create the segment and the socket and start the exporter thread, returns 0 on success
+		public: int Start(int period_ms = QOT_METRICS_PERIOD_MS);
+
+		// Stop the thread and remove the segment and the socket
+		public: void Stop();
+
+		// Path of the Prometheus socket
+		public: std::string GetSocketPath();
+
+		/* Private Functions */
+		private: void ExportLoop();
+		private: void PublishSnapshot();
+		private: void Serve(int fd);
+
+		/* Private Variables */
+		private: std::string service_name;
+		private: std::string shm_name;
+		private: std::string socket_path;
+		private: int period;
+		private: int listen_fd;
+		private: qot_metrics_shm_t *shm;
+		private: std::atomic<bool> running;
+		private: std::thread export_thread;
+	};
+}
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * @file qot_peer_compute_service.cpp
+ * @brief Peer Network-Effect Compute Service main file
+ * @author Anon D'Anon
+ * 
+ * Copyright (c) Anon, 2018. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *      1. Redistributions of source code must retain the above copyright notice, 
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice, 
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+// Boost includes
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+
+// C++ Standard Library Headers
+#include <fstream>
+#include <iostream>
+#include <string>
+
+extern "C"
+{
+	#include <signal.h>
+	#include <unistd.h>
+}
+
+// Peer network-effect solver
+#include "sync/huygens/PeerCompute.hpp"
+
+// Add header to Modern JSON C++ Library
+#include "../../../thirdparty/json-modern-cpp/json.hpp"
+
+using namespace qot;
+
+// Default NATS Server
+#define NATS_SERVER "nats://localhost:4222"
+
+// Running Flag
+int peer_compute_running = 1;
+
+// Exit Handler to terminate the program on Ctrl+C
+static void exit_handler(int s)
+{
+    std::cout << "Exit requested " << std::endl;
+    peer_compute_running = 0;
+}
+
+/* Peer Compute Service Main Function */
+int main(int argc , char *argv[])  
+{  
+	// Parse command line options
+	boost::program_options::options_description desc("Allowed options");
+	desc.add_options()
+		("help,h",         "produce help message")
+		("verbose,v",      "print verbose debug messages")
+		("nats_server,n",  boost::program_options::value<std::string>()->default_value(NATS_SERVER), "url of the pub-sub server to connect to (nats://, inproc:// or local://)")
+		("master_clock,m", boost::program_options::value<std::string>()->default_value("192.168.1.115"), "hostname of the master clock")
+		("period,p",       boost::program_options::value<double>()->default_value(2.0), "the period over which data is processed (seconds)")
+		("config,c",       boost::program_options::value<std::string>()->default_value("/opt/qot-stack/doc/topology_example.json"), "topology configuration file")
+	;
+	boost::program_options::variables_map vm;
+	boost::program_options::store(
+		boost::program_options::parse_command_line(argc, argv, desc), vm);
+	boost::program_options::notify(vm);    
+
+	// Set logging level
+	if (vm.count("verbose") > 0)
+	{
+		boost::log::core::get()->set_filter
+	    (
+	        boost::log::trivial::severity >= boost::log::trivial::info
+	    );
+	}
+	else
+	{
+		boost::log::core::get()->set_filter
+	    (
+	        boost::log::trivial::severity >= boost::log::trivial::warning
+	    );
+	}
+
+	// Print some help with arguments
+	if (vm.count("help") > 0)
+	{
+		std::cout << desc << "\n";
+		return 0;
+	}
+
+	// Setup the network-effect solver
+	uint64_t period_ns = (uint64_t)(vm["period"].as<double>()*1000000000ULL);
+	PeerCompute peer_compute(vm["master_clock"].as<std::string>(), period_ns, vm["nats_server"].as<std::string>());
+
+	// Read the topology configuration, edges may also join or leave at run time
+	std::ifstream config_file(vm["config"].as<std::string>());
+	if (config_file.is_open())
+	{
+		try
+		{
+			nlohmann::json config_data;
+			config_file >> config_data;
+			for (auto &node : config_data["nodes"])
+				peer_compute.AddNode(node.get<std::string>());
+			for (auto &edge : config_data["edges"])
+				peer_compute.AddEdge(edge[0].get<std::string>(), edge[1].get<std::string>());
+		}
+		catch (std::exception &e)
+		{
+			BOOST_LOG_TRIVIAL(error) << "Could not parse topology configuration " << vm["config"].as<std::string>();
+			return -1;
+		}
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(warning) << "No topology configuration, waiting for edges on qot.peer.topology";
+	}
+
+	// Start Peer Processor
+	if (peer_compute.Start() != 0)
+	{
+		BOOST_LOG_TRIVIAL(error) << "Could not start the peer compute service";
+		return -1;
+	}
+
+    // Install SIGINT Signal Handler for exit
+    signal(SIGINT, exit_handler);
+
+    // Main Loop 
+    while(peer_compute_running)  
+    {
+    	sleep(1);
+    }
+
+	// Stop Peer Processor
+	peer_compute.Stop();
+
+	return 0;
+}
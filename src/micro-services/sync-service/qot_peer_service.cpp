@@ -45,6 +45,15 @@
 #include "sync/huygens/PeerTSclient.hpp"
 #include "sync/huygens/PeerTSreceiver.hpp"
 
+// Runtime metrics
+#include "qot_metrics.hpp"
+
+// Binary sync trace
+#include "qot_trace.hpp"
+
+// Fault injection
+#include "qot_fault.hpp"
+
 using namespace qot;
 
 // Maximum Clients
@@ -107,11 +116,17 @@ int main(int argc , char *argv[])
 		("timelineid,d", boost::program_options::value<int>()->default_value(0), "timeline id")
         ("addr,a",  boost::program_options::value<std::string>()->default_value("0"), "peer IP address")
         ("tx_period_ns,t",  boost::program_options::value<uint64_t>()->default_value(1000000000ULL), "peer IP")
-        ("natsserver,m",  boost::program_options::value<std::string>()->default_value(NATS_SERVER), "NATS server(s) which to connect to for Peer Sync")
+        ("natsserver,m",  boost::program_options::value<std::string>()->default_value(NATS_SERVER), "Pub-sub server(s) which to connect to for Peer Sync (nats://, inproc:// or local://)")
         ("discipline,d",  boost::program_options::value<bool>()->default_value(false), "Flag indicating if the PHC corresponding to the interface should be disciplined")
         ("mode,o",  boost::program_options::value<int>()->default_value(0), "Flag indicating which mode to launch in: 0-normal, 1-client only, 2-server only")
 		("timestamping,x",  boost::program_options::value<int>()->default_value(2), "Flag indicating which timestamps to use: 0-SWTS, 2-HWTS")
+        ("tracedir,l",  boost::program_options::value<std::string>()->default_value(QOT_TRACE_DIR), "Directory of the binary sync traces (\"none\" disables tracing)")
 	;
+#ifdef QOT_FAULT_INJECTION
+	desc.add_options()
+        ("faultscript,f",  boost::program_options::value<std::string>()->default_value(""), "Fault script armed at startup (more are armed through the fault control socket)")
+	;
+#endif
 	boost::program_options::variables_map vm;
 	boost::program_options::store(
 		boost::program_options::parse_command_line(argc, argv, desc), vm);
@@ -154,6 +169,28 @@ int main(int argc , char *argv[])
 	BOOST_LOG_TRIVIAL(info) << "Performing synchronization over interface " << vm["iface"].as<std::string>();
 	BOOST_LOG_TRIVIAL(info)	<< "Peer IP address is " << vm["addr"].as<std::string>();
 
+	// Binary sync trace (one ring per thread)
+	std::string trace_dir = vm["tracedir"].as<std::string>();
+	if (!trace_dir.empty() && trace_dir != "none")
+	{
+		if (qot::trace_open("peer", trace_dir) < 0)
+			std::cout << "Peer service: sync traces are not recorded\n";
+	}
+
+#ifdef QOT_FAULT_INJECTION
+	// Fault control socket, and the script given at startup
+	qot::FaultController fault_controller("peer");
+	if (fault_controller.Start() < 0)
+		std::cout << "Peer service: faults can only be armed at startup\n";
+	std::string fault_script = vm["faultscript"].as<std::string>();
+	if (!fault_script.empty())
+	{
+		std::string fault_error;
+		if (qot::fault_arm_file(fault_script, fault_error) < 0)
+			std::cout << "Peer service: fault script not armed: " << fault_error << "\n";
+	}
+#endif
+
 	// Exclusion Set and Multicast Map for Peer Service
 	std::set<std::string> exclusion_set;
 	std::map<std::string, std::string> multicast_map;
@@ -195,6 +232,11 @@ int main(int argc , char *argv[])
     // Catch Signal Handler SIGPIPE 
     signal(SIGPIPE, sigpipe_handler);
 
+    // Runtime metrics (shm snapshot and Prometheus socket)
+    MetricsExporter metrics_exporter("peer");
+    if (metrics_exporter.Start() < 0)
+        std::cout << "Peer service: metrics are not exported\n";
+
     // Main Loop 
     while(peer_service_running)  
     {
@@ -0,0 +1,596 @@
+/*
+ * @file qot_pubsub.cpp
+ * @brief Pluggable publish/subscribe transports (NATS, in-process and host-local)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C"
+{
+	#include <errno.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <dirent.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <sys/un.h>
+}
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#ifdef NATS_SERVICE
+// NATS client header
+#include <nats/nats.h>
+#endif
+
+#include "qot_pubsub.hpp"
+
+// Receive timeout of the host-local bus thread (bounds the shutdown latency)
+#define QOT_PUBSUB_LOCAL_POLL_MS 200
+
+// A bus directory modified this recently is rescanned on every publish (mtime is coarse)
+#define QOT_PUBSUB_LOCAL_SETTLE_NS 1000000000LL
+
+using namespace qot;
+
+// Check if a subject matches a subscription pattern
+bool qot::pubsub_subject_match(const std::string &pattern, const std::string &subject)
+{
+	size_t p = 0, s = 0;
+	while (true)
+	{
+		// The subject ran out of tokens before the pattern
+		if (s > subject.size())
+			return false;
+
+		size_t p_end = pattern.find('.', p);
+		size_t s_end = subject.find('.', s);
+		if (p_end == std::string::npos)
+			p_end = pattern.size();
+		if (s_end == std::string::npos)
+			s_end = subject.size();
+
+		// '>' matches all the remaining tokens (at least one)
+		if (pattern.compare(p, p_end - p, ">") == 0)
+			return true;
+		if (pattern.compare(p, p_end - p, "*") != 0 &&
+			pattern.compare(p, p_end - p, subject, s, s_end - s) != 0)
+			return false;
+
+		p = p_end + 1;
+		s = s_end + 1;
+		if (p > pattern.size())
+			return s > subject.size();
+	}
+}
+
+namespace
+{
+	// A subscription, delivery is serialized against its removal
+	struct pubsub_entry
+	{
+		std::string pattern;
+		pubsub_handler_t handler;
+		std::recursive_mutex call_lock;   // Held while the handler runs (recursive so a handler can unsubscribe)
+		bool active;
+
+		// Run the handler unless the subscription was removed
+		void Deliver(const std::string &subject, const std::string &data)
+		{
+			std::lock_guard<std::recursive_mutex> guard(call_lock);
+			if (!active)
+				return;
+			try
+			{
+				handler(subject, data);
+			}
+			catch (std::exception &e)
+			{
+				std::cout << "PubSub: handler for " << subject << " failed: " << e.what() << "\n";
+			}
+		}
+
+		// Wait for a running handler and prevent further deliveries
+		void Deactivate()
+		{
+			std::lock_guard<std::recursive_mutex> guard(call_lock);
+			active = false;
+		}
+	};
+
+	// Subscriptions served by the local dispatch of the in-process and host-local buses
+	class SubscriptionTable
+	{
+		public: SubscriptionTable() : next_id(0) {}
+
+		// Add a subscription and return its id
+		public: int Add(const std::string &pattern, pubsub_handler_t handler)
+		{
+			std::shared_ptr<pubsub_entry> entry(new pubsub_entry());
+			entry->pattern = pattern;
+			entry->handler = handler;
+			entry->active = true;
+			std::lock_guard<std::mutex> guard(table_lock);
+			entries[next_id] = entry;
+			return next_id++;
+		}
+
+		// Remove a subscription, returns -1 if it does not exist
+		public: int Remove(int id)
+		{
+			std::shared_ptr<pubsub_entry> entry;
+			{
+				std::lock_guard<std::mutex> guard(table_lock);
+				std::map<int, std::shared_ptr<pubsub_entry> >::iterator it = entries.find(id);
+				if (it == entries.end())
+					return -1;
+				entry = it->second;
+				entries.erase(it);
+			}
+			entry->Deactivate();
+			return 0;
+		}
+
+		// Deliver a message to every matching subscription (handlers run without the table lock)
+		public: void Dispatch(const std::string &subject, const std::string &data)
+		{
+			std::vector<std::shared_ptr<pubsub_entry> > matches;
+			{
+				std::lock_guard<std::mutex> guard(table_lock);
+				for (std::map<int, std::shared_ptr<pubsub_entry> >::iterator it = entries.begin(); it != entries.end(); ++it)
+				{
+					if (pubsub_subject_match(it->second->pattern, subject))
+						matches.push_back(it->second);
+				}
+			}
+			for (size_t i = 0; i < matches.size(); i++)
+				matches[i]->Deliver(subject, data);
+		}
+
+		private: std::mutex table_lock;
+		private: std::map<int, std::shared_ptr<pubsub_entry> > entries;
+		private: int next_id;
+	};
+
+	/* In-process bus: delivery is a synchronous call on the publishing thread */
+	std::mutex inproc_registry_lock;
+	std::map<std::string, std::weak_ptr<SubscriptionTable> > inproc_registry;
+
+	class InProcTransport : public PubSubTransport
+	{
+		public: InProcTransport(const std::string &name)
+		{
+			std::lock_guard<std::mutex> guard(inproc_registry_lock);
+			bus = inproc_registry[name].lock();
+			if (!bus)
+			{
+				bus = std::make_shared<SubscriptionTable>();
+				inproc_registry[name] = bus;
+			}
+		}
+
+		public: ~InProcTransport()
+		{
+			for (std::set<int>::iterator it = sub_ids.begin(); it != sub_ids.end(); ++it)
+				bus->Remove(*it);
+		}
+
+		public: int Publish(const std::string &subject, const std::string &data)
+		{
+			bus->Dispatch(subject, data);
+			return 0;
+		}
+
+		public: int Subscribe(const std::string &subject, pubsub_handler_t handler)
+		{
+			int id = bus->Add(subject, handler);
+			std::lock_guard<std::mutex> guard(ids_lock);
+			sub_ids.insert(id);
+			return id;
+		}
+
+		public: int Unsubscribe(int sub_id)
+		{
+			{
+				std::lock_guard<std::mutex> guard(ids_lock);
+				if (sub_ids.erase(sub_id) == 0)
+					return -1;
+			}
+			return bus->Remove(sub_id);
+		}
+
+		private: std::shared_ptr<SubscriptionTable> bus;
+		private: std::mutex ids_lock;
+		private: std::set<int> sub_ids;   // Subscriptions made through this transport
+	};
+
+	/* Host-local bus: every subscribing transport binds a datagram socket in the
+	   bus directory and publishers send each message straight to all of them */
+	std::atomic<int> local_instance(0);
+
+	class LocalTransport : public PubSubTransport
+	{
+		public: LocalTransport(const std::string &bus_dir)
+		  : dir(bus_dir), send_fd(-1), recv_fd(-1), running(false), scanned(false)
+		{
+			dir_mtime.tv_sec = 0;
+			dir_mtime.tv_nsec = 0;
+		}
+
+		public: ~LocalTransport()
+		{
+			running = false;
+			if (receiver.joinable())
+				receiver.join();
+			if (recv_fd >= 0)
+			{
+				close(recv_fd);
+				unlink(recv_path.c_str());
+			}
+			if (send_fd >= 0)
+				close(send_fd);
+		}
+
+		// Create the bus directory and the sending socket
+		public: int Open()
+		{
+			// Anyone who can write to the directory can inject messages, it is private to the user
+			if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+			{
+				perror("PubSub: ERROR creating the local bus directory");
+				return -1;
+			}
+			if (check_dir() < 0)
+				return -1;
+			send_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+			if (send_fd < 0)
+			{
+				perror("PubSub: ERROR opening local bus socket");
+				return -1;
+			}
+			return 0;
+		}
+
+		public: int Publish(const std::string &subject, const std::string &data)
+		{
+			if (subject.size() + 1 + data.size() > QOT_PUBSUB_MAX_MSG)
+				return -1;
+
+			// Datagram layout: subject, NUL, data
+			std::string packet(subject);
+			packet.push_back('\0');
+			packet.append(data);
+
+			std::lock_guard<std::mutex> guard(send_lock);
+			refresh_peers();
+			int failures = 0;
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			for (std::vector<std::string>::iterator it = peers.begin(); it != peers.end(); )
+			{
+				strncpy(addr.sun_path, it->c_str(), sizeof(addr.sun_path) - 1);
+				if (sendto(send_fd, packet.data(), packet.size(), MSG_DONTWAIT, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+				{
+					if (errno == ECONNREFUSED)
+					{
+						// The subscriber exited without removing its socket
+						unlink(it->c_str());
+						it = peers.erase(it);
+						continue;
+					}
+					if (errno != ENOENT)
+						failures++;   // Receive queue of the subscriber is full
+				}
+				++it;
+			}
+			return (failures > 0) ? -1 : 0;
+		}
+
+		public: int Subscribe(const std::string &subject, pubsub_handler_t handler)
+		{
+			std::lock_guard<std::mutex> guard(bind_lock);
+			if (recv_fd < 0 && bind_receiver() < 0)
+				return -1;
+			return table.Add(subject, handler);
+		}
+
+		public: int Unsubscribe(int sub_id)
+		{
+			return table.Remove(sub_id);
+		}
+
+		/* The bus directory must be a real directory owned by the user or by root, which
+		   others cannot write to (a bus shared across users uses a dedicated group) */
+		private: int check_dir()
+		{
+			struct stat st;
+			if (lstat(dir.c_str(), &st) < 0)
+			{
+				perror("PubSub: ERROR checking the local bus directory");
+				return -1;
+			}
+			if (!S_ISDIR(st.st_mode))
+			{
+				std::cout << "PubSub: local bus path " << dir << " is not a directory\n";
+				return -1;
+			}
+			if (st.st_uid != geteuid() && st.st_uid != 0)
+			{
+				std::cout << "PubSub: local bus directory " << dir << " is owned by another user\n";
+				return -1;
+			}
+			if (st.st_mode & S_IWOTH)
+			{
+				std::cout << "PubSub: local bus directory " << dir << " is writable by other users\n";
+				return -1;
+			}
+			return 0;
+		}
+
+		// Bind the receive socket and start the receiver thread (first subscription only)
+		private: int bind_receiver()
+		{
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			recv_path = dir + "/" + std::to_string(getpid()) + "." + std::to_string(local_instance++) + ".sock";
+			if (recv_path.size() >= sizeof(addr.sun_path))
+			{
+				std::cout << "PubSub: local bus path " << recv_path << " is too long\n";
+				return -1;
+			}
+			strncpy(addr.sun_path, recv_path.c_str(), sizeof(addr.sun_path) - 1);
+
+			int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+			{
+				perror("PubSub: ERROR opening local bus socket");
+				return -1;
+			}
+			unlink(recv_path.c_str());
+			if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+			{
+				perror("PubSub: ERROR binding local bus socket");
+				close(fd);
+				return -1;
+			}
+
+			struct timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = QOT_PUBSUB_LOCAL_POLL_MS*1000;
+			if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+				perror("PubSub: ERROR in setting socket options to SO_RCVTIMEO");
+
+			recv_fd = fd;
+			running = true;
+			receiver = std::thread(&LocalTransport::receive_loop, this);
+			return 0;
+		}
+
+		// Receive datagrams and hand them to the matching subscriptions
+		private: void receive_loop()
+		{
+			std::vector<char> buf(QOT_PUBSUB_MAX_MSG + 1);
+			while (running)
+			{
+				ssize_t len = recv(recv_fd, &buf[0], buf.size(), 0);
+				if (len < 0)
+				{
+					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+						continue;
+					perror("PubSub: ERROR receiving on local bus");
+					break;
+				}
+				const char *start = &buf[0];
+				const char *sep = (const char*) memchr(start, '\0', len);
+				if (sep == NULL)
+					continue;
+				std::string subject(start, sep);
+				std::string data(sep + 1, start + len);
+				table.Dispatch(subject, data);
+			}
+		}
+
+		// Rescan the bus directory for subscriber sockets if it changed (hold send_lock)
+		private: void refresh_peers()
+		{
+			struct stat st;
+			if (stat(dir.c_str(), &st) < 0)
+			{
+				peers.clear();
+				return;
+			}
+			struct timespec now;
+			clock_gettime(CLOCK_REALTIME, &now);
+			int64_t age_ns = (int64_t)(now.tv_sec - st.st_mtim.tv_sec)*1000000000LL + (now.tv_nsec - st.st_mtim.tv_nsec);
+			if (scanned && st.st_mtim.tv_sec == dir_mtime.tv_sec && st.st_mtim.tv_nsec == dir_mtime.tv_nsec
+				&& age_ns > QOT_PUBSUB_LOCAL_SETTLE_NS)
+				return;
+
+			DIR *dirp = opendir(dir.c_str());
+			if (dirp == NULL)
+				return;
+			peers.clear();
+			struct dirent *entry;
+			while ((entry = readdir(dirp)) != NULL)
+			{
+				std::string name(entry->d_name);
+				if (name.size() > 5 && name.compare(name.size() - 5, 5, ".sock") == 0)
+					peers.push_back(dir + "/" + name);
+			}
+			closedir(dirp);
+			dir_mtime = st.st_mtim;
+			scanned = true;
+		}
+
+		private: std::string dir;                 // Bus directory
+		private: int send_fd;                     // Unbound socket used to publish
+		private: int recv_fd;                     // Socket bound in the bus directory (subscribers only)
+		private: std::string recv_path;
+		private: std::thread receiver;
+		private: std::atomic<bool> running;
+		private: std::mutex bind_lock;
+		private: SubscriptionTable table;
+
+		// Publisher view of the bus directory
+		private: std::mutex send_lock;
+		private: std::vector<std::string> peers;
+		private: struct timespec dir_mtime;
+		private: bool scanned;
+	};
+
+	#ifdef NATS_SERVICE
+	/* NATS message handler, the closure is the subscription entry */
+	void nats_msg_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+	{
+		pubsub_entry *entry = (pubsub_entry*) closure;
+		entry->Deliver(std::string(natsMsg_GetSubject(msg)), std::string(natsMsg_GetData(msg), natsMsg_GetDataLength(msg)));
+		natsMsg_Destroy(msg);
+	}
+
+	/* NATS server connection */
+	class NatsTransport : public PubSubTransport
+	{
+		public: NatsTransport() : conn(NULL), next_id(0) {}
+
+		public: ~NatsTransport()
+		{
+			for (std::map<int, natsSubscription*>::iterator it = subs.begin(); it != subs.end(); ++it)
+				natsSubscription_Destroy(it->second);
+			if (conn)
+				natsConnection_Destroy(conn);
+		}
+
+		// Connect to the NATS server(s)
+		public: int Connect(const std::string &url)
+		{
+			natsStatus s = natsConnection_ConnectTo(&conn, url.c_str());
+			if (s != NATS_OK)
+			{
+				std::cout << "PubSub: Error connecting to NATS service " << url << "\n";
+				nats_PrintLastErrorStack(stderr);
+				conn = NULL;
+				return -1;
+			}
+			std::cout << "PubSub: Connected to NATS service " << url << "\n";
+			return 0;
+		}
+
+		public: int Publish(const std::string &subject, const std::string &data)
+		{
+			if (natsConnection_Publish(conn, subject.c_str(), data.data(), (int)data.size()) != NATS_OK)
+				return -1;
+			return 0;
+		}
+
+		public: int Subscribe(const std::string &subject, pubsub_handler_t handler)
+		{
+			std::shared_ptr<pubsub_entry> entry(new pubsub_entry());
+			entry->pattern = subject;
+			entry->handler = handler;
+			entry->active = true;
+
+			natsSubscription *sub = NULL;
+			if (natsConnection_Subscribe(&sub, conn, subject.c_str(), nats_msg_handler, (void*) entry.get()) != NATS_OK)
+			{
+				nats_PrintLastErrorStack(stderr);
+				return -1;
+			}
+			std::lock_guard<std::mutex> guard(subs_lock);
+			subs[next_id] = sub;
+			entries[next_id] = entry;
+			return next_id++;
+		}
+
+		public: int Unsubscribe(int sub_id)
+		{
+			std::lock_guard<std::mutex> guard(subs_lock);
+			std::map<int, natsSubscription*>::iterator it = subs.find(sub_id);
+			if (it == subs.end())
+				return -1;
+			natsSubscription_Unsubscribe(it->second);
+			natsSubscription_Destroy(it->second);
+			subs.erase(it);
+			// The entry outlives the subscription as the NATS thread may still hold the closure
+			entries[sub_id]->Deactivate();
+			return 0;
+		}
+
+		private: natsConnection *conn;
+		private: std::mutex subs_lock;
+		private: std::map<int, natsSubscription*> subs;
+		private: std::map<int, std::shared_ptr<pubsub_entry> > entries;
+		private: int next_id;
+	};
+	#endif
+}
+
+// Create a transport for a URL
+PubSubTransport *qot::pubsub_connect(const std::string &url)
+{
+	const std::string inproc_scheme(QOT_PUBSUB_INPROC_SCHEME);
+	const std::string local_scheme(QOT_PUBSUB_LOCAL_SCHEME);
+
+	if (url.compare(0, inproc_scheme.size(), inproc_scheme) == 0)
+		return new InProcTransport(url.substr(inproc_scheme.size()));
+
+	if (url.compare(0, local_scheme.size(), local_scheme) == 0)
+	{
+		std::string dir = url.substr(local_scheme.size());
+		if (dir.empty())
+			dir = QOT_PUBSUB_LOCAL_DIR;
+		LocalTransport *transport = new LocalTransport(dir);
+		if (transport->Open() < 0)
+		{
+			delete transport;
+			return NULL;
+		}
+		return transport;
+	}
+
+	#ifdef NATS_SERVICE
+	NatsTransport *transport = new NatsTransport();
+	if (transport->Connect(url) < 0)
+	{
+		delete transport;
+		return NULL;
+	}
+	return transport;
+	#else
+	std::cout << "PubSub: built without NATS support, cannot connect to " << url << "\n";
+	return NULL;
+	#endif
+}
@@ -0,0 +1,75 @@
+/*
+ * @file qot_pubsub.hpp
+ * @brief Pluggable publish/subscribe transports (NATS, in-process and host-local)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_PUBSUB_HPP
+#define QOT_STACK_PUBSUB_HPP
+
+#include <string>
+#include <functional>
+
+// URL schemes understood by pubsub_connect (a URL without a scheme is a NATS server)
+#define QOT_PUBSUB_NATS_SCHEME   "nats://"    // NATS server(s), needs the NATS client library
+#define QOT_PUBSUB_INPROC_SCHEME "inproc://"  // Bus shared by all transports of one process
+#define QOT_PUBSUB_LOCAL_SCHEME  "local://"   // Host-local datagram bus, local:///<directory>
+
+// Default rendezvous directory of the host-local bus, created private (0700) to the user
+#define QOT_PUBSUB_LOCAL_DIR "/tmp/qot-pubsub"
+
+// Largest message (subject and data) carried by the host-local bus
+#define QOT_PUBSUB_MAX_MSG 65000
+
+namespace qot
+{
+	// Handler invoked with the subject and data of every matching message
+	typedef std::function<void(const std::string &subject, const std::string &data)> pubsub_handler_t;
+
+	/* Publish/subscribe transport. Subjects follow the NATS conventions: tokens
+	   separated by '.', '*' matches one token and a trailing '>' the remaining ones */
+	class PubSubTransport
+	{
+		public: virtual ~PubSubTransport() {}
+
+		// Publish a message, returns 0 on success
+		public: virtual int Publish(const std::string &subject, const std::string &data) = 0;
+
+		// Subscribe to a subject, returns a subscription id (>= 0) or a negative error
+		public: virtual int Subscribe(const std::string &subject, pubsub_handler_t handler) = 0;
+
+		// Remove a subscription, its handler is not running and never runs again once this returns
+		public: virtual int Unsubscribe(int sub_id) = 0;
+	};
+
+	// Create a transport for a URL, returns NULL if the scheme is unsupported or the connection failed
+	PubSubTransport *pubsub_connect(const std::string &url);
+
+	// Check if a subject matches a subscription pattern
+	bool pubsub_subject_match(const std::string &pattern, const std::string &subject);
+}
+
+#endif
@@ -41,6 +41,7 @@
 #include <fstream>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <thread>
 
 // Header to the sync class
@@ -90,6 +91,15 @@ extern "C"
 // Timeline Server type
 #include "../timeline-service/qot_tl_types.hpp"
 
+// Runtime metrics
+#include "qot_metrics.hpp"
+
+// Binary sync trace
+#include "qot_trace.hpp"
+
+// Fault injection
+#include "qot_fault.hpp"
+
 // JSON C++ namespace
 using json = nlohmann::json;
 
@@ -123,7 +133,7 @@ boost::shared_ptr<Sync> GlobalSync = NULL;
 boost::shared_ptr<Sync> LocalSync = NULL;
 
 // Data Structure maintaining the peer receivers (timeline uuid -> reciever map)
-std::map<std::string, PeerTSreceiver*> peer_receivermap;
+std::unordered_map<std::string, PeerTSreceiver*> peer_receivermap;
 
 // Exit Handler to terminate the program on Ctrl+C
 static void exit_handler(int s)
@@ -296,6 +306,27 @@ int deferred_message_handler(qot_sync_msg_t tl_msg)
 }
 
 
+// Request type labels of the dispatch latency histograms (indexed by csmsg_type_t)
+static const char *csmsg_type_names[] = {
+    "TL_CREATE_UPDATE", "TL_DESTROY", "PEER_START", "PEER_STOP", "GLOB_SYNC_UPDATE", "SET_NODE_UUID", "TL_UNDEFINED"
+};
+
+/* Dispatch latency histogram of a request type (-1 for unknown types) */
+static int request_metric(int msgtype)
+{
+    static std::vector<int> metric_ids = []() {
+        std::vector<int> ids;
+        for (size_t i = 0; i < sizeof(csmsg_type_names)/sizeof(csmsg_type_names[0]); i++)
+            ids.push_back(metrics_register(QOT_METRIC_HISTOGRAM, "qot_sync_request_seconds",
+                                           std::string("type=\"") + csmsg_type_names[i] + "\"",
+                                           "Time to service a clock sync request, including the reply"));
+        return ids;
+    }();
+    if (msgtype < 0 || msgtype >= (int) metric_ids.size())
+        return -1;
+    return metric_ids[msgtype];
+}
+
 /* Sync Service Main Function */
 int main(int argc , char *argv[])  
 {  
@@ -321,11 +352,17 @@ int main(int argc , char *argv[])
 		("name,n",       boost::program_options::value<std::string>()->default_value(RandomString(32)), "name of this node")
 		("addr,a",       boost::program_options::value<std::string>()->default_value("192.168.2.33"), "ip address for this node")
         ("peerserver,p",  boost::program_options::value<int>()->default_value(0), "port on which the peer to peer rtt measurement server listens")
-        ("natsserver,m",  boost::program_options::value<std::string>()->default_value(NATS_SERVER), "NATS server(s) which to connect to for Peer Sync")
+        ("natsserver,m",  boost::program_options::value<std::string>()->default_value(NATS_SERVER), "Pub-sub server(s) which to connect to for Peer Sync (nats://, inproc:// or local://)")
         ("discipline,d",  boost::program_options::value<bool>()->default_value(false), "Flag indicating if the PHC corresponding to the interface should be disciplined")
         ("ntpconfig,c",  boost::program_options::value<std::string>()->default_value("/etc/chrony.conf"), "NTP Chrony Configuration file")
         ("logsyncrate,r",  boost::program_options::value<int>()->default_value(0), "default synchronization rate")
+        ("tracedir,l",  boost::program_options::value<std::string>()->default_value(QOT_TRACE_DIR), "Directory of the binary sync traces (\"none\" disables tracing)")
     ;
+#ifdef QOT_FAULT_INJECTION
+	desc.add_options()
+        ("faultscript,f",  boost::program_options::value<std::string>()->default_value(""), "Fault script armed at startup (more are armed through the fault control socket)")
+	;
+#endif
 	boost::program_options::variables_map vm;
 	boost::program_options::store(
 		boost::program_options::parse_command_line(argc, argv, desc), vm);
@@ -359,6 +396,28 @@ int main(int argc , char *argv[])
 	BOOST_LOG_TRIVIAL(info) << "Performing synchronization over interface " << vm["iface"].as<std::string>();
 	BOOST_LOG_TRIVIAL(info)	<< "IP address is " << vm["addr"].as<std::string>();
 
+    // Binary sync trace (one ring per thread)
+    std::string trace_dir = vm["tracedir"].as<std::string>();
+    if (!trace_dir.empty() && trace_dir != "none")
+    {
+        if (qot::trace_open("sync", trace_dir) < 0)
+            std::cout << "Clock Sync service: sync traces are not recorded\n";
+    }
+
+#ifdef QOT_FAULT_INJECTION
+    // Fault control socket, and the script given at startup
+    qot::FaultController fault_controller("sync");
+    if (fault_controller.Start() < 0)
+        std::cout << "Clock Sync service: faults can only be armed at startup\n";
+    std::string fault_script = vm["faultscript"].as<std::string>();
+    if (!fault_script.empty())
+    {
+        std::string fault_error;
+        if (qot::fault_arm_file(fault_script, fault_error) < 0)
+            std::cout << "Clock Sync service: fault script not armed: " << fault_error << "\n";
+    }
+#endif
+
     // Spawn thread for the peer-delay server & and receiver
     PeerTSserver *peerserver = NULL;
     PeerTSreceiver *peerreceiver = NULL;
@@ -397,9 +456,9 @@ int main(int argc , char *argv[])
     // Timeval for select timeout
     struct timeval timeout = {TIMEOUT,0};
 
-    // Data Structure maintaining timelines for which the sync service exists
-    std::map<std::string, tl_sync_t> timeline_syncmap;
-    std::map<std::string, tl_sync_t>::iterator it;
+    // Data Structure maintaining timelines for which the sync service exists (timeline uuid -> sync)
+    std::unordered_map<std::string, tl_sync_t> timeline_syncmap;
+    std::unordered_map<std::string, tl_sync_t>::iterator it;
 
     // Data Structure maintaining the peer clients
     std::map<std::string, PeerTSclient*> peer_clientmap;
@@ -410,8 +469,8 @@ int main(int argc , char *argv[])
     std::map<std::string, int> peer_threadflag;
 
     // Data Structure maintaining the peer receivers (timeline uuid -> reciever map)
-    // std::map<std::string, PeerTSreceiver*> peer_receivermap;
-    std::map<std::string, PeerTSreceiver*>::iterator peer_receiverit;
+    // std::unordered_map<std::string, PeerTSreceiver*> peer_receivermap;
+    std::unordered_map<std::string, PeerTSreceiver*>::iterator peer_receiverit;
 
     // Create the boost asio required for clock sync services
     boost::asio::io_service io;
@@ -489,6 +548,11 @@ int main(int argc , char *argv[])
     // Catch Signal Handler SIGPIPE 
     signal(SIGPIPE, sigpipe_handler);
 
+    // Runtime metrics (shm snapshot and Prometheus socket)
+    MetricsExporter metrics_exporter("sync");
+    if (metrics_exporter.Start() < 0)
+        std::cout << "Clock Sync service: metrics are not exported\n";
+
     // Main Loop listening for commands
     while(sync_service_running)  
     {  
@@ -610,6 +674,9 @@ int main(int argc , char *argv[])
                     std::cout << "Guest TL ID    : " << tl_msg.info.index << "\n";
                     std::cout << "Guest TL Name  : " << tl_msg.info.name << "\n";
 
+                    // Dispatch latency of this request type (until the reply is sent)
+                    MetricsTimer request_timer(request_metric(tl_msg.msgtype));
+
                     // Take action based on the message type
                     switch(tl_msg.msgtype)
                     {
@@ -0,0 +1,336 @@
+/*
+ * @file qot_trace.cpp
+ * @brief Binary sync trace facility
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C"
+{
+	#include <dirent.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <pthread.h>
+	#include <signal.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/syscall.h>
+	#include <sys/types.h>
+}
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include "qot_trace.hpp"
+
+using namespace qot;
+
+// Process-wide trace configuration, a new generation makes the threads map new rings
+static std::mutex trace_mutex;
+static std::atomic<bool> trace_on(false);
+static std::atomic<uint32_t> trace_generation(0);
+static std::string trace_dir;
+static std::string trace_service;
+static size_t trace_ring_bytes = QOT_TRACE_RING_BYTES;
+
+/* Ring of one thread, unmapped when the thread exits */
+struct trace_ring {
+	uint32_t generation;			// Configuration the ring was created for (0 = none)
+	qot_trace_header_t *header;		// NULL if the ring could not be created
+	qot_trace_record_t *records;
+	size_t map_size;
+
+	~trace_ring()
+	{
+		if (header)
+			munmap(header, map_size);
+	}
+};
+static thread_local trace_ring thread_ring = {0, NULL, NULL, 0};
+
+static int64_t realtime_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// Check if a process is still running
+static bool process_alive(pid_t pid)
+{
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* Create the ring of the calling thread for the current configuration */
+static void trace_attach(trace_ring &ring, uint32_t generation)
+{
+	if (ring.header)
+		munmap(ring.header, ring.map_size);
+	ring.header = NULL;
+	ring.records = NULL;
+	ring.generation = generation;
+
+	std::string dir, service;
+	size_t ring_bytes;
+	{
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		dir = trace_dir;
+		service = trace_service;
+		ring_bytes = trace_ring_bytes;
+	}
+
+	uint32_t capacity = (ring_bytes - sizeof(qot_trace_header_t))/sizeof(qot_trace_record_t);
+	if (capacity == 0)
+		return;
+	size_t map_size = sizeof(qot_trace_header_t) + size_t(capacity)*sizeof(qot_trace_record_t);
+	pid_t tid = syscall(SYS_gettid);
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s-%d-%d%s", dir.c_str(), service.c_str(), (int) getpid(), (int) tid, QOT_TRACE_SUFFIX);
+
+	int fd = open(path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	if (ftruncate(fd, map_size) < 0)
+	{
+		close(fd);
+		unlink(path);
+		return;
+	}
+	// Populate now, so emitting never faults the pages in
+	void *base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		unlink(path);
+		return;
+	}
+
+	qot_trace_header_t *header = (qot_trace_header_t*) base;
+	memset(header, 0, sizeof(*header));
+	header->magic = QOT_TRACE_MAGIC;
+	header->version = QOT_TRACE_VERSION;
+	header->record_size = sizeof(qot_trace_record_t);
+	header->capacity = capacity;
+	header->pid = getpid();
+	header->tid = tid;
+	header->created = realtime_ns();
+	strncpy(header->service, service.c_str(), sizeof(header->service) - 1);
+	pthread_getname_np(pthread_self(), header->thread, sizeof(header->thread));
+
+	ring.header = header;
+	ring.records = (qot_trace_record_t*) (header + 1);
+	ring.map_size = map_size;
+}
+
+extern "C" void qot_trace_emit(int type, int flags, int source, int64_t v0, int64_t v1, int64_t v2, int64_t v3, int64_t v4, int64_t v5)
+{
+	if (!trace_on.load(std::memory_order_relaxed))
+		return;
+
+	trace_ring &ring = thread_ring;
+	uint32_t generation = trace_generation.load(std::memory_order_acquire);
+	if (ring.generation != generation)
+		trace_attach(ring, generation);
+	if (!ring.header)
+		return;
+
+	// Only this thread writes the ring: invalidate the slot, fill it, then publish it
+	uint64_t index = ring.header->head;
+	qot_trace_record_t *record = &ring.records[index % ring.header->capacity];
+	__atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	record->type = type;
+	record->flags = flags;
+	record->source = source;
+	record->timestamp = realtime_ns();
+	record->value[0] = v0;
+	record->value[1] = v1;
+	record->value[2] = v2;
+	record->value[3] = v3;
+	record->value[4] = v4;
+	record->value[5] = v5;
+	__atomic_store_n(&record->seq, uint32_t(index + 1), __ATOMIC_RELEASE);
+	__atomic_store_n(&ring.header->head, index + 1, __ATOMIC_RELEASE);
+}
+
+/* Remove the rings of earlier runs of a service, except those of the most recent one */
+static void trace_cleanup(const std::string &dir, const std::string &service)
+{
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return;
+
+	std::map<int, std::vector<std::string>> runs;	// Dead pid -> ring files
+	std::map<int, time_t> run_mtime;
+	std::string prefix = service + "-";
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		std::string name = entry->d_name;
+		int pid, tid;
+		if (name.compare(0, prefix.size(), prefix) != 0 || name.size() <= strlen(QOT_TRACE_SUFFIX)
+		    || name.compare(name.size() - strlen(QOT_TRACE_SUFFIX), std::string::npos, QOT_TRACE_SUFFIX) != 0)
+			continue;
+		if (sscanf(name.c_str() + prefix.size(), "%d-%d", &pid, &tid) != 2 || pid == getpid() || process_alive(pid))
+			continue;
+		std::string path = dir + "/" + name;
+		struct stat st;
+		if (stat(path.c_str(), &st) < 0)
+			continue;
+		runs[pid].push_back(path);
+		if (run_mtime.count(pid) == 0 || st.st_mtime > run_mtime[pid])
+			run_mtime[pid] = st.st_mtime;
+	}
+	closedir(d);
+
+	int newest = -1;
+	for (std::map<int, time_t>::iterator it = run_mtime.begin(); it != run_mtime.end(); ++it)
+	{
+		if (newest < 0 || it->second > run_mtime[newest])
+			newest = it->first;
+	}
+	for (std::map<int, std::vector<std::string>>::iterator it = runs.begin(); it != runs.end(); ++it)
+	{
+		if (it->first == newest)
+			continue;
+		for (size_t i = 0; i < it->second.size(); i++)
+			unlink(it->second[i].c_str());
+	}
+}
+
+int qot::trace_open(const std::string &service, const std::string &dir, size_t ring_bytes)
+{
+	if (service.empty() || service.size() >= sizeof(((qot_trace_header_t*) 0)->service) || dir.empty())
+		return -1;
+	if (ring_bytes < sizeof(qot_trace_header_t) + sizeof(qot_trace_record_t))
+		return -1;
+	if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST)
+	{
+		std::cout << "qot_trace: cannot create " << dir << ": " << strerror(errno) << "\n";
+		return -1;
+	}
+	trace_cleanup(dir, service);
+
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_dir = dir;
+	trace_service = service;
+	trace_ring_bytes = ring_bytes;
+	trace_generation.fetch_add(1, std::memory_order_release);
+	trace_on.store(true, std::memory_order_release);
+	return 0;
+}
+
+void qot::trace_close()
+{
+	trace_on.store(false, std::memory_order_release);
+}
+
+bool qot::trace_enabled()
+{
+	return trace_on.load(std::memory_order_relaxed);
+}
+
+int qot::trace_read(const std::string &path, qot_trace_header_t &header, std::vector<qot_trace_record_t> &records)
+{
+	records.clear();
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(qot_trace_header_t))
+	{
+		close(fd);
+		return -1;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return -1;
+
+	int retval = -1;
+	header = *(const qot_trace_header_t*) base;
+	if (header.magic == QOT_TRACE_MAGIC && header.version == QOT_TRACE_VERSION && header.record_size == sizeof(qot_trace_record_t)
+	    && sizeof(qot_trace_header_t) + size_t(header.capacity)*sizeof(qot_trace_record_t) <= size_t(st.st_size))
+	{
+		const qot_trace_record_t *ring = (const qot_trace_record_t*) ((const qot_trace_header_t*) base + 1);
+		uint64_t head = __atomic_load_n(&((const qot_trace_header_t*) base)->head, __ATOMIC_ACQUIRE);
+		uint64_t first = head > header.capacity ? head - header.capacity : 0;
+		records.reserve(head - first);
+		for (uint64_t index = first; index < head; index++)
+		{
+			const qot_trace_record_t *record = &ring[index % header.capacity];
+			uint32_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+			qot_trace_record_t copy = *record;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			// Skip records being rewritten by a live writer
+			if (seq != uint32_t(index + 1) || __atomic_load_n(&record->seq, __ATOMIC_RELAXED) != seq)
+				continue;
+			records.push_back(copy);
+		}
+		retval = 0;
+	}
+	munmap(base, st.st_size);
+	return retval;
+}
+
+const char *qot::trace_type_name(int type)
+{
+	switch (type)
+	{
+		case QOT_TRACE_SYNC_SAMPLE:
+			return "sync_sample";
+		case QOT_TRACE_SERVO_DECISION:
+			return "servo_decision";
+		case QOT_TRACE_BOUND_UPDATE:
+			return "bound_update";
+		case QOT_TRACE_PROBE_PAIR:
+			return "probe_pair";
+		case QOT_TRACE_STEP:
+			return "step";
+		default:
+			return "unknown";
+	}
+}
+
+std::vector<std::string> qot::trace_value_names(int type)
+{
+	static const char *names[][6] = {
+		{"", "", "", "", "", ""},
+		{"offset_ns", "drift_ppb", "data_id", "algorithm", "", ""},
+		{"old_log_interval", "new_log_interval", "nodes_behind", "exactness_ppm", "", ""},
+		{"u_nsec", "l_nsec", "u_mult", "l_mult", "offset_ns", "drift_ppb"},
+		{"tx0", "rx0", "rx_remote0", "tx_remote0", "tx1", "rx_remote1"},
+		{"step_ns", "freq_ppb", "algorithm", "", "", ""},
+	};
+	if (type < QOT_TRACE_SYNC_SAMPLE || type > QOT_TRACE_STEP)
+		type = 0;
+	return std::vector<std::string>(names[type], names[type] + 6);
+}
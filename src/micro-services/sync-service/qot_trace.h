@@ -0,0 +1,112 @@
+/*
+ * @file qot_trace.h
+ * @brief Binary sync trace records (C interface)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_TRACE_H
+#define QOT_STACK_TRACE_H
+
+#include <stdint.h>
+
+/* Trace files are per-thread rings <dir>/<service>-<pid>-<tid>.qtr, mapped
+   into the emitting process. A ring wraps when it is full, so every file is
+   bounded by its size and the oldest records are overwritten */
+#define QOT_TRACE_DIR        "/tmp/qot-trace"
+#define QOT_TRACE_SUFFIX     ".qtr"
+#define QOT_TRACE_RING_BYTES (4 << 20)
+
+#define QOT_TRACE_MAGIC   0x43525451    /* "QTRC" */
+#define QOT_TRACE_VERSION 1
+
+/**
+ * @brief Record types, and the meaning of their values
+ */
+typedef enum {
+    QOT_TRACE_SYNC_SAMPLE    = (1),     /* offset_ns, drift_ppb, data_id, algorithm                    */
+    QOT_TRACE_SERVO_DECISION = (2),     /* old_log_interval, new_log_interval, nodes_behind, exact_ppm */
+    QOT_TRACE_BOUND_UPDATE   = (3),     /* u_nsec, l_nsec, u_mult, l_mult, offset_ns, drift_ppb        */
+    QOT_TRACE_PROBE_PAIR     = (4),     /* tx0, rx0, rx_remote0, tx_remote0, tx1, rx_remote1           */
+    QOT_TRACE_STEP           = (5),     /* step_ns, freq_ppb, algorithm                                */
+} qot_trace_type_t;
+
+/**
+ * @brief Synchronization algorithms named in the records
+ */
+typedef enum {
+    QOT_TRACE_ALG_PTP       = (0),
+    QOT_TRACE_ALG_NTP       = (1),
+    QOT_TRACE_ALG_NTP_LOCAL = (2),      /* CLOCK_REALTIME to PHC tracking of the NTP service          */
+    QOT_TRACE_ALG_HUYGENS   = (3),
+} qot_trace_alg_t;
+
+// Flags of a probe pair
+#define QOT_TRACE_FLAG_VALID 0x1
+
+/**
+ * @brief Fixed-size record (64 bytes)
+ */
+typedef struct qot_trace_record {
+    uint8_t  type;                      /* qot_trace_type_t                                           */
+    uint8_t  flags;                     /* Type specific flags                                        */
+    uint16_t source;                    /* Timeline index (0 for the peer services)                  */
+    uint32_t seq;                       /* Low bits of the record index + 1, written last (0 = empty) */
+    int64_t  timestamp;                 /* CLOCK_REALTIME at emission (ns)                            */
+    int64_t  value[6];                  /* Type specific values                                       */
+} qot_trace_record_t;
+
+/**
+ * @brief Ring header (128 bytes), followed by the records
+ */
+typedef struct qot_trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;                  /* Records in the ring                                        */
+    uint32_t pid;
+    uint32_t tid;
+    uint32_t pad;
+    int64_t  created;                   /* CLOCK_REALTIME when the ring was created (ns)              */
+    uint64_t head;                      /* Records emitted so far                                     */
+    char     service[32];
+    char     thread[16];                /* Thread name                                                */
+    uint8_t  reserved[40];
+} qot_trace_header_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Append a record to the ring of the calling thread. Wait-free once the
+   thread's ring exists (it is created by the first record), no-op while
+   tracing is disabled */
+void qot_trace_emit(int type, int flags, int source, int64_t v0, int64_t v1, int64_t v2, int64_t v3, int64_t v4, int64_t v5);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * @file qot_trace.hpp
+ * @brief Binary sync trace facility
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_TRACE_HPP
+#define QOT_STACK_TRACE_HPP
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "qot_trace.h"
+
+namespace qot
+{
+	// Enable tracing for this process, returns 0 on success. Rings of earlier
+	// runs of the service are removed, except those of the most recent one
+	int trace_open(const std::string &service, const std::string &dir = QOT_TRACE_DIR, size_t ring_bytes = QOT_TRACE_RING_BYTES);
+
+	// Disable tracing, rings stay mapped until their threads exit
+	void trace_close();
+
+	// Check if tracing is enabled
+	bool trace_enabled();
+
+	// Read a ring file, records are returned oldest first (torn or overwritten ones are skipped)
+	int trace_read(const std::string &path, qot_trace_header_t &header, std::vector<qot_trace_record_t> &records);
+
+	// Name of a record type ("unknown" for other values)
+	const char *trace_type_name(int type);
+
+	// Names of the values of a record type (empty for unused values)
+	std::vector<std::string> trace_value_names(int type);
+
+	/* Typed emitters */
+	inline void trace_sync_sample(int source, int64_t offset_ns, int64_t drift_ppb, int64_t data_id, qot_trace_alg_t alg)
+	{
+		qot_trace_emit(QOT_TRACE_SYNC_SAMPLE, 0, source, offset_ns, drift_ppb, data_id, alg, 0, 0);
+	}
+
+	inline void trace_servo_decision(int source, int old_interval, int new_interval, int nodes_behind, double exactness)
+	{
+		qot_trace_emit(QOT_TRACE_SERVO_DECISION, 0, source, old_interval, new_interval, nodes_behind, int64_t(exactness*1000000), 0, 0);
+	}
+
+	inline void trace_bound_update(int source, int64_t u_nsec, int64_t l_nsec, int64_t u_mult, int64_t l_mult, int64_t offset_ns, int64_t drift_ppb)
+	{
+		qot_trace_emit(QOT_TRACE_BOUND_UPDATE, 0, source, u_nsec, l_nsec, u_mult, l_mult, offset_ns, drift_ppb);
+	}
+
+	inline void trace_probe_pair(int source, bool valid, int64_t tx0, int64_t rx0, int64_t rx_remote0, int64_t tx_remote0, int64_t tx1, int64_t rx_remote1)
+	{
+		qot_trace_emit(QOT_TRACE_PROBE_PAIR, valid ? QOT_TRACE_FLAG_VALID : 0, source, tx0, rx0, rx_remote0, tx_remote0, tx1, rx_remote1);
+	}
+
+	inline void trace_step(int source, int64_t step_ns, int64_t freq_ppb, qot_trace_alg_t alg)
+	{
+		qot_trace_emit(QOT_TRACE_STEP, 0, source, step_ns, freq_ppb, alg, 0, 0, 0);
+	}
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * @file qot_trace_decode.cpp
+ * @brief Offline decoder of the binary sync traces to CSV
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+extern "C"
+{
+	#include <dirent.h>
+	#include <string.h>
+	#include <sys/stat.h>
+}
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "qot_trace.hpp"
+
+using namespace qot;
+
+/* Record with the ring it came from */
+struct decoded_record {
+	qot_trace_record_t record;
+	size_t ring;
+};
+
+static bool earlier(const decoded_record &a, const decoded_record &b)
+{
+	return a.record.timestamp < b.record.timestamp;
+}
+
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [-t sync_sample|servo_decision|bound_update|probe_pair|step] <ring file or directory>...\n"
+	          << "Writes the records of all rings as CSV to stdout, ordered by time. With -t only records\n"
+	          << "of that type are written, with named value columns\n";
+}
+
+// Expand directories to the ring files they contain
+static void collect_paths(const std::string &path, std::vector<std::string> &paths)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+	{
+		DIR *d = opendir(path.c_str());
+		if (!d)
+			return;
+		struct dirent *entry;
+		size_t suffix = strlen(QOT_TRACE_SUFFIX);
+		while ((entry = readdir(d)) != NULL)
+		{
+			std::string name = entry->d_name;
+			if (name.size() > suffix && name.compare(name.size() - suffix, suffix, QOT_TRACE_SUFFIX) == 0)
+				paths.push_back(path + "/" + name);
+		}
+		closedir(d);
+		std::sort(paths.begin(), paths.end());
+		return;
+	}
+	paths.push_back(path);
+}
+
+int main(int argc, char *argv[])
+{
+	int type_filter = 0;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help")
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		if (arg == "-t" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			for (int type = QOT_TRACE_SYNC_SAMPLE; type <= QOT_TRACE_STEP; type++)
+			{
+				if (name == trace_type_name(type))
+					type_filter = type;
+			}
+			if (type_filter == 0)
+			{
+				std::cerr << "Unknown record type " << name << "\n";
+				return 1;
+			}
+			continue;
+		}
+		collect_paths(arg, paths);
+	}
+	if (paths.empty())
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<qot_trace_header_t> headers;
+	std::vector<decoded_record> decoded;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		qot_trace_header_t header;
+		std::vector<qot_trace_record_t> records;
+		if (trace_read(paths[i], header, records) < 0)
+		{
+			std::cerr << "Skipping " << paths[i] << ": not a trace ring\n";
+			continue;
+		}
+		if (header.head > header.capacity)
+			std::cerr << paths[i] << ": " << header.head - header.capacity << " oldest records were overwritten\n";
+		for (size_t r = 0; r < records.size(); r++)
+		{
+			if (type_filter != 0 && records[r].type != type_filter)
+				continue;
+			decoded_record entry = {records[r], headers.size()};
+			decoded.push_back(entry);
+		}
+		headers.push_back(header);
+	}
+	std::stable_sort(decoded.begin(), decoded.end(), earlier);
+
+	// Header row
+	std::cout << "timestamp_ns,service,pid,tid,thread,type,source,flags";
+	std::vector<std::string> names = trace_value_names(type_filter);
+	for (int v = 0; v < 6; v++)
+	{
+		if (type_filter == 0)
+			std::cout << ",value" << v;
+		else if (!names[v].empty())
+			std::cout << "," << names[v];
+	}
+	std::cout << "\n";
+
+	for (size_t i = 0; i < decoded.size(); i++)
+	{
+		const qot_trace_record_t &record = decoded[i].record;
+		const qot_trace_header_t &header = headers[decoded[i].ring];
+		std::cout << record.timestamp << "," << std::string(header.service, strnlen(header.service, sizeof(header.service)))
+		          << "," << header.pid << "," << header.tid << "," << std::string(header.thread, strnlen(header.thread, sizeof(header.thread)))
+		          << "," << trace_type_name(record.type) << "," << record.source << "," << int(record.flags);
+		for (int v = 0; v < 6; v++)
+		{
+			if (type_filter == 0 || !names[v].empty())
+				std::cout << "," << record.value[v];
+		}
+		std::cout << "\n";
+	}
+	return 0;
+}
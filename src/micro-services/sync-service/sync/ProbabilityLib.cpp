@@ -89,3 +89,22 @@ double get_inverse_error_func(double probability)
 
   return boost::math::erf_inv(probability);
 }
+
+double chi_squared_variance_factor(unsigned N, double pds)
+{
+  // Same limit as upper_confidence_limit_on_std_deviation, without the sample deviation
+  using boost::math::chi_squared;
+  using boost::math::quantile;
+
+  chi_squared dist(N - 1);
+  return (N - 1) / quantile(dist, 1 - pds);
+}
+
+double gaussian_quantile(double probability)
+{
+  using boost::math::normal;
+  using boost::math::quantile;
+
+  normal normdist(0, 1);
+  return quantile(normdist, probability);
+}
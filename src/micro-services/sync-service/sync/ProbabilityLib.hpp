@@ -39,4 +39,10 @@ double upper_confidence_limit_gaussian(double Sd, double pdv);
 // Calculate the inverse gaussian error function for a given probability
 double get_inverse_error_func(double probability);
 
+// Factor k such that the chi squared upper confidence limit on the variance is k*Sd^2 (depends only on N and pds)
+double chi_squared_variance_factor(unsigned N, double pds);
+
+// Quantile of the standard normal distribution (upper_confidence_limit_gaussian(Sd, p) = Sd*quantile)
+double gaussian_quantile(double probability);
+
 #endif
\ No newline at end of file
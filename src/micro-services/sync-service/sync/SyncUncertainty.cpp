@@ -32,9 +32,17 @@
 
 #include "ProbabilityLib.hpp"
 
-#ifdef NATS_SERVICE
+// Runtime metrics
+#include "../qot_metrics.hpp"
+
+// Binary sync trace
+#include "../qot_trace.hpp"
+
+#ifdef PUBSUB_SERVICE
 // Header to clkparam serialization library
 #include "../qot_clkparams_serialize.hpp"
+
+#include <functional>
 #endif
 
 /* So that we might expose a meaningful name through PTP interface */
@@ -46,58 +54,67 @@
 
 using namespace qot;
 
-#ifdef NATS_SERVICE
-int SyncUncertainty::getNatsStatus()
+#ifdef PUBSUB_SERVICE
+int SyncUncertainty::getPubSubStatus()
 {
-	return (int)s;
+	return (transport != NULL) ? 0 : -1;
 }
 
-int SyncUncertainty::natsConnect(const char* nats_url)
+int SyncUncertainty::pubsubConnect(const char* pubsub_url)
 {
-	s = natsConnection_ConnectTo(&conn, nats_url);
-	if (s == NATS_OK)
+	pubsubUnSubscribe();
+	delete transport;
+	transport = pubsub_connect(std::string(pubsub_url));
+	if (transport != NULL)
 	{
-		std::cout << "Connected to NATS service\n";
+		std::cout << "Connected to pub-sub service " << pubsub_url << "\n";
 	}
 	else
 	{
-		std::cout << "Error Connecting to NATS service\n";
+		std::cout << "Error Connecting to pub-sub service " << pubsub_url << "\n";
 	}
-	return (int)s;
+	return getPubSubStatus();
 }
 #endif
 
 // Constructor 
 SyncUncertainty::SyncUncertainty(struct uncertainty_params uncertainty_config)
-: drift_popvar(0), drift_samvar(0), offset_popvar(0), drift_bound(0), 
-  offset_bound(0), drift_pointer(0), offset_pointer(0), master_sync_topic_flag(0), 
-  config{50,50,0.999999,0.999999,0.999999,0.999999}
+: config{50,50,0.999999,0.999999,0.999999,0.999999},
+  drift_popvar(0), drift_samvar(0), offset_popvar(0), drift_bound(0),
+  offset_bound(0), trace_source(0)
 {
 	// Configure the parameters
 	Configure(uncertainty_config);
 
-	#ifdef NATS_SERVICE
-	// Initialize NATS Parameters
-	conn = NULL;
-    msg  = NULL;
-    s = NATS_ERR;
-    node_uuid = std::string("default");
+	#ifdef PUBSUB_SERVICE
+	// Initialize Pub-Sub Parameters
+	transport = NULL;
+	sub_id = -1;
+	node_uuid = std::string("default");
+	desired_accuracy = 0;
+	pub_seq = 0;
+	master_sync_topic_flag = false;
 
 	#endif
 }
 
 // Constructor 2
 SyncUncertainty::SyncUncertainty()
-: drift_popvar(0), drift_samvar(0), offset_popvar(0), drift_bound(0), 
-  offset_bound(0), drift_pointer(0), offset_pointer(0), master_sync_topic_flag(0),
-  config{50,50,0.999999,0.999999,0.999999,0.999999}
+: config{50,50,0.999999,0.999999,0.999999,0.999999},
+  drift_popvar(0), drift_samvar(0), offset_popvar(0), drift_bound(0),
+  offset_bound(0), trace_source(0)
 {
-	#ifdef NATS_SERVICE
-	// Initialize NATS Parameters
-	conn = NULL;
-    msg  = NULL;
-    s = NATS_ERR;
-    node_uuid = std::string("default");
+	// Size the windows and precompute the quantiles for the default parameters
+	Configure(config);
+
+	#ifdef PUBSUB_SERVICE
+	// Initialize Pub-Sub Parameters
+	transport = NULL;
+	sub_id = -1;
+	node_uuid = std::string("default");
+	desired_accuracy = 0;
+	pub_seq = 0;
+	master_sync_topic_flag = false;
 
 	#endif
 	return;
@@ -106,20 +123,18 @@ SyncUncertainty::SyncUncertainty()
 // Destructor
 SyncUncertainty::~SyncUncertainty() 
 {
-	#ifdef NATS_SERVICE
-	// Destroy the NATS connection
-	if (s == NATS_OK)
-	{
-    	natsConnection_Destroy(conn);
-    }
+	#ifdef PUBSUB_SERVICE
+	// Destroy the pub-sub connection
+	pubsubUnSubscribe();
+	delete transport;
 	#endif
 }
 
-#ifdef NATS_SERVICE
+#ifdef PUBSUB_SERVICE
 // Set the master sync topic to share uncertainty info with synchronization master (for local timelines)
 bool SyncUncertainty::StartMasterSyncPublish(std::string topic)
 {
-	master_nats_topic = topic;
+	master_sync_topic = topic;
 	master_sync_topic_flag = true;
 	return true;
 }
@@ -131,86 +146,87 @@ bool SyncUncertainty::StopMasterSyncPublish()
 	return true;
 }
 
-/* NATS Subscription handler*/
-void subscription_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+/* Subscription handler*/
+static void subscription_handler(const std::string &subject, const std::string &msg, subscription_callback_t callback)
 {
-    // CircularBuffer *param_buffer = (CircularBuffer*) closure;
-    subscription_callback_t callback = (subscription_callback_t) closure;
-
-    // printf("Received msg: %s - %.*s\n",
-    //            natsMsg_GetSubject(msg),
-    //            natsMsg_GetDataLength(msg),
-    //            natsMsg_GetData(msg));
-
-    /* De-serialize data */
-    tl_translation_t rcv_clk_params;
-    json data = nlohmann::json::parse(std::string(natsMsg_GetData(msg)));
-    deserialize_clkparams(data, rcv_clk_params);
+    // printf("Received msg: %s - %s\n", subject.c_str(), msg.c_str());
 
-    // Get the node uuid
-    std::string node_uuid = data["node_uuid"].get<std::string>();
+    /* De-serialize data (JSON or binary) */
+    clkparams_msg rcv_msg;
+    if (decode_clkparams_msg(msg, rcv_msg) < 0)
+    {
+        std::cout << "Malformed parameter message on " << subject << "\n";
+        return;
+    }
 
     // Get the timeline uuid
     std::string topic_prefix = "qot.timeline.";
-    std::string timeline_uuid = std::string(natsMsg_GetSubject(msg));
+    std::string timeline_uuid = subject;
     int pos_start = topic_prefix.length();
     int pos_end = timeline_uuid.find(".syncmaster"); // can cause issues if the timeline is named syncmaster
     timeline_uuid = timeline_uuid.substr(pos_start, pos_end - pos_start);
 
-    // Get the desired accuracy
-    uint64_t desired_accuracy = data["desired_accuracy"].get<uint64_t>();
-
     // Call the callback function
-    callback(rcv_clk_params, timeline_uuid, node_uuid, desired_accuracy);
-    //printf("Received delivered Qot msg from node %s on timeline %s\n", node_uuid.c_str(), timeline_uuid.c_str());
-    //printf("Received delivered Qot msg from node %s on timeline %llu\n", node_uuid.c_str(), desired_accuracy);
-
-    // Need to destroy the message!
-    natsMsg_Destroy(msg);
-
+    callback(rcv_msg.params, timeline_uuid, rcv_msg.node_uuid, rcv_msg.desired_accuracy);
+    //printf("Received delivered Qot msg from node %s on timeline %s\n", rcv_msg.node_uuid.c_str(), timeline_uuid.c_str());
 }
 
-/* Subscribe to a NATS topic (subject) */
-int SyncUncertainty::natsSubscribe(std::string &topic, subscription_callback_t callback)
+/* Subscribe to a topic (subject) */
+int SyncUncertainty::pubsubSubscribe(std::string &topic, subscription_callback_t callback)
 {
-    printf("Subscribing to NATS subject %s\n", topic.c_str());
-	// Need to connect to NATS before    
-    if (s == NATS_OK)
-    {
-        nats_status_flag = 1; // Indicates the connection went through
-
-        // Creates an asynchronous subscription on subject "foo".
-        // When a message is sent on subject "foo", the callback
-        // onMsg() will be invoked by the client library.
-        // You can pass a closure as the last argument.
-        s = natsConnection_Subscribe(&sub, conn, topic.c_str(), subscription_handler, (void*) callback);
-    }
-
-    // If there was an error, print a stack trace and exit
-    if (s != NATS_OK)
+    printf("Subscribing to subject %s\n", topic.c_str());
+	// Need to connect before
+    if (transport == NULL)
+        return -1;
+
+    pubsubUnSubscribe();
+    sub_id = transport->Subscribe(topic, std::bind(subscription_handler, std::placeholders::_1, std::placeholders::_2, callback));
+    if (sub_id < 0)
     {
-        nats_PrintLastErrorStack(stderr);
-        return (int)s;
-    }
-    else
-    {
-        printf("Succesfully subscribed to timeline clock parameter topic\n");
+        printf("Failed to subscribe to subject %s\n", topic.c_str());
+        return -1;
     }
+    printf("Succesfully subscribed to timeline clock parameter topic\n");
+    return 0;
+}
 
-    return NATS_OK;
+/* Un-subscribe from the topic (subject) */
+int SyncUncertainty::pubsubUnSubscribe()
+{
+    if (transport != NULL && sub_id >= 0)
+        transport->Unsubscribe(sub_id);
+    sub_id = -1;
+    return 0;
 }
 
-/* Un-subscribe to a NATS topic (subject) */
-int SyncUncertainty::natsUnSubscribe()
+// Publish the timeline parameters (and optionally forward them to the sync master)
+void SyncUncertainty::PublishParams(tl_translation_t *tl_clk_params, const std::string &timeline_uuid, bool to_master)
 {
-    // Anything that is created need to be destroyed
-    if (s == NATS_OK)
+    if (transport == NULL || tl_clk_params == NULL)
+        return;
+
+    // Construct the topic name
+    std::string pubsub_subject = "qot.timeline.";
+    pubsub_subject.append(timeline_uuid);
+    pubsub_subject.append(std::string(".params"));
+
+    // Snapshot the params and serialize them in the encoding selected for the topic
+    clkparams_msg msg;
+    tl_translation_read(tl_clk_params, &msg.params);
+    msg.seq = pub_seq++;
+    msg.desired_accuracy = desired_accuracy;
+    msg.timeline_uuid = timeline_uuid;
+    msg.node_uuid = node_uuid;
+
+    std::string data = encode_clkparams_msg(msg, get_params_encoding(pubsub_subject));
+    transport->Publish(pubsub_subject, data);
+
+    // Send the uncertainty information to the sync master
+    if (to_master && master_sync_topic_flag)
     {
-        natsSubscription_Destroy(sub);
+        qot_params_encoding_t encoding = get_params_encoding(master_sync_topic);
+        transport->Publish(master_sync_topic, encode_clkparams_msg(msg, encoding));
     }
-    sub  = NULL;
-    done  = false;
-    return 0;
 }
 
 // Set the node name
@@ -232,36 +248,24 @@ bool SyncUncertainty::SetNodeAccuracy(uint64_t accuracy)
 // Set Bounds Directly (not required if CalculateBounds is called)
 bool SyncUncertainty::SetBounds(tl_translation_t* tl_clk_params, qot_bounds_t bounds, int timelinefd, const std::string &timeline_uuid)
 {
+	// The destinations used depend on the build (timeline service, pub-sub)
+	(void)tl_clk_params; (void)timelinefd; (void)timeline_uuid;
+
 	#ifdef QOT_TIMELINE_SERVICE
 	// Write to shared memory
 	if (tl_clk_params != NULL)
 	{
+		tl_translation_write_begin(tl_clk_params);
 		tl_clk_params->u_nsec = bounds.u_nsec;
 		tl_clk_params->l_nsec = -bounds.l_nsec;  // Take care of negative sign here only -> Kernel Space implementation does it in the kernel
 		tl_clk_params->u_mult = bounds.u_drift;
 		tl_clk_params->l_mult = -bounds.l_drift; // Take care of negative sign here only -> Kernel Space implementation does it in the kernel
+		tl_translation_write_end(tl_clk_params);
 	}
 
-	#ifdef NATS_SERVICE
-    // Publish the message to NATS
-    if (s == NATS_OK && tl_clk_params != NULL)
-    {
-	    msg = NULL;
-	    // Convert the params to json
-	    json params = serialize_clkparams(*tl_clk_params);
-	    std::string data = params.dump();
-
-	    // Construct the topic name
-	    std::string nats_subject = "qot.timeline.";
-	    nats_subject.append(timeline_uuid);
-	    nats_subject.append(std::string(".params"));
-
-	    s = natsMsg_Create(&msg, nats_subject.c_str(), NULL, data.c_str(), data.length());
-	    if (s == NATS_OK)
-			natsConnection_PublishMsg(conn, msg);
-		natsMsg_Destroy(msg);
-		std::cout << "Published Message to NATS on topic " << nats_subject << "\n";
-	}
+	#ifdef PUBSUB_SERVICE
+    // Publish the message
+    PublishParams(tl_clk_params, timeline_uuid, false);
 	#endif
 
 	#else
@@ -278,35 +282,22 @@ bool SyncUncertainty::SetBounds(tl_translation_t* tl_clk_params, qot_bounds_t bo
 bool SyncUncertainty::CalculateBounds(int64_t offset, double drift, int timelinefd, tl_translation_t* tl_clk_params, const std::string &timeline_uuid)
 {
 	qot_bounds_t bounds; // Calculated bound values
+	(void)tl_clk_params; (void)timelinefd; (void)timeline_uuid;
+
+	// Cost of the update, including the publish
+	static int update_metric = metrics_register(QOT_METRIC_HISTOGRAM, "qot_uncertainty_update_seconds", "",
+	                                            "Time to add a sample and publish the uncertainty bounds");
+	MetricsTimer update_timer(update_metric);
 
 	// Add Newest Sample
 	AddSample(offset, drift);
 
-	if(drift_samples.size() < config.M && offset_samples.size() < config.N)
+	if(drift_samples.Count() < config.M && offset_samples.Count() < config.N)
 	{
 		// Insufficient samples for calculating uncertainty
-		#ifdef NATS_SERVICE
-	    // Publish the message to NATS
-	    if (s == NATS_OK && tl_clk_params != NULL)
-	    {
-		    msg = NULL;
-		    // Convert the params to json
-		    json params = serialize_clkparams(*tl_clk_params);
-		    std::string data = params.dump();
-
-		    // Construct the topic name
-		    std::string nats_subject = "qot.timeline.";
-		    nats_subject.append(timeline_uuid);
-		    nats_subject.append(std::string(".params"));
-
-		    s = natsMsg_Create(&msg, nats_subject.c_str(), NULL, data.c_str(), data.length());
-		    if (s == NATS_OK)
-		    {
-				natsConnection_PublishMsg(conn, msg);
-				std::cout << "Published Message to NATS on topic " << nats_subject << "\n";
-		    }
-			natsMsg_Destroy(msg);
-		}
+		#ifdef PUBSUB_SERVICE
+	    // Publish the message
+	    PublishParams(tl_clk_params, timeline_uuid, false);
 		#endif
 		return false;
 	}
@@ -316,67 +307,35 @@ bool SyncUncertainty::CalculateBounds(int64_t offset, double drift, int timeline
 
 	// Predictor Function Coefficients (Needs to be multiplied with (t-t0)^(3/2))
 	//right_predictor = 2*inv_error_pdv*sqrt(diffusion_coef)/3; // Like the paper we assume that the sync algorithm corrects the offset and drift
-	right_predictor = 2*upper_confidence_limit_gaussian(sqrt(drift_bound),config.pdv)/3;
+	right_predictor = 2*gaussian_pdv*sqrt(drift_bound)/3; // = upper_confidence_limit_gaussian(sqrt(drift_bound),config.pdv)
 	left_predictor = -right_predictor;
 
 	// Margin Functions
 	right_margin = sqrt(2)*inv_error_pov*sqrt(offset_bound);
 	left_margin = -right_margin;
 
-	std::cout << "Timeline " << timeline_uuid << " Right Predictor = " << right_predictor
-	          << " Right Margin = " << right_margin << "\n";
-
 	// Poulate the bounds
 	bounds.u_drift = (s64)ceil(right_predictor*1000000000LL); // Upper bound (Right Predictor) function for drift
 	bounds.l_drift = (s64)ceil(left_predictor*1000000000LL);  // Lower bound (Left Predictor) function for drift
 	bounds.u_nsec  = (s64)ceil(right_margin);                 // Upper bound (Right Margin) function for offset
 	bounds.l_nsec  = (s64)ceil(left_margin);                  // Lower bound (Left Margin) function for offset
+	trace_bound_update(trace_source, bounds.u_nsec, bounds.l_nsec, bounds.u_drift, bounds.l_drift, offset, (int64_t) llround(drift*1000000000LL));
 
 	#ifdef QOT_TIMELINE_SERVICE
 	// Write to shared memory
 	if (tl_clk_params != NULL)
 	{
+		tl_translation_write_begin(tl_clk_params);
 		tl_clk_params->u_nsec = bounds.u_nsec;
 		tl_clk_params->l_nsec = -bounds.l_nsec;  // Take care of negative sign here only -> Kernel Space implementation does it in the kernel
 		tl_clk_params->u_mult = bounds.u_drift;
 		tl_clk_params->l_mult = -bounds.l_drift; // Take care of negative sign here only -> Kernel Space implementation does it in the kernel
+		tl_translation_write_end(tl_clk_params);
 	}
 
-	#ifdef NATS_SERVICE
-    // Publish the message to NATS
-    if (s == NATS_OK && tl_clk_params != NULL)
-    {
-	    msg = NULL;
-	    // Convert the params to json
-	    json params = serialize_clkparams(*tl_clk_params);
-	    // Add node name
-	    params["node_uuid"] = node_uuid;
-	    // Add node desired accuracy
-	    params["desired_accuracy"] = desired_accuracy;
-	    std::string data = params.dump();
-
-	    // Construct the topic name
-	    std::string nats_subject = "qot.timeline.";
-	    nats_subject.append(timeline_uuid);
-	    nats_subject.append(std::string(".params"));
-
-	    s = natsMsg_Create(&msg, nats_subject.c_str(), NULL, data.c_str(), data.length());
-	    if (s == NATS_OK)
-			natsConnection_PublishMsg(conn, msg);
-		natsMsg_Destroy(msg);
-		std::cout << "Published Message to NATS on topic " << nats_subject << "\n";
-
-		// Send the uncertainty information to the sync master
-		if (master_sync_topic_flag)
-	    {
-		    msg = NULL;
-		    s = natsMsg_Create(&msg, master_nats_topic.c_str(), NULL, data.c_str(), data.length());
-		    if (s == NATS_OK)
-				natsConnection_PublishMsg(conn, msg);
-			natsMsg_Destroy(msg);
-			std::cout << "Published Message on NATS to sync master on topic " << master_nats_topic << "\n";
-		}
-	}
+	#ifdef PUBSUB_SERVICE
+    // Publish the message (also to the sync master for local timelines)
+    PublishParams(tl_clk_params, timeline_uuid, true);
 
 	#endif
 
@@ -390,130 +349,129 @@ bool SyncUncertainty::CalculateBounds(int64_t offset, double drift, int timeline
 	return true;
 }
 
+// Set the source (timeline index) of the traced bound updates
+void SyncUncertainty::SetTraceSource(int source)
+{
+	trace_source = source;
+}
+
 // Configure the Parameters of the Synchronization Uncertainty Calculation Algorithm
 void SyncUncertainty::Configure(struct uncertainty_params configuration)
 {
 	config = configuration;
 	inv_error_pov = get_inverse_error_func(config.pov);
+
+	// The quantiles only depend on the window sizes and probabilities
+	drift_var_factor  = chi_squared_variance_factor(config.M, config.pds);
+	offset_var_factor = chi_squared_variance_factor(config.N, config.pos);
+	gaussian_pdv      = gaussian_quantile(config.pdv);
+
+	// Windows are allocated once here, never per sample
+	drift_samples.Resize(config.M);
+	offset_samples.Resize(config.N);
 	return;
 }
 
-// Add a new sample to the vector queues
+// Add a new sample to the sliding windows
 void SyncUncertainty::AddSample(int64_t offset, double drift)
 {
-	// Add new drift sample
-	if (drift_samples.size() < config.M)
-	{
-		drift_samples.push_back(drift);
-	}
-	else
-	{
-		drift_samples[drift_pointer] = drift;
-	}
-	drift_pointer = (drift_pointer + 1) % config.M;
-
-	// Add new offset sample
-	if (offset_samples.size() < config.N)
-	{
-		offset_samples.push_back(offset);
-	}
-	else
-	{
-		offset_samples[offset_pointer] = offset;
-	}
-	offset_pointer = (offset_pointer + 1) % config.N;
-
+	drift_samples.Add(drift);
+	offset_samples.Add((double)offset);
 	return;
 }
 
-// Calculate population variance
-double SyncUncertainty::GetPopulationVarianceDouble(std::vector<double> samples)
+// Calculate variance bounds
+void SyncUncertainty::CalcVarBounds()
 {
-	double var = 0;
-	double mean = 0;
-	int numPoints = samples.size();
-	int n;
-
-	// Calculate Mean
-	for(n = 0; n < numPoints; n++)
-	{
-		mean = mean + samples[n];
-	}
-	mean = mean/numPoints;
+	// Calculate Variances
+	drift_popvar  = drift_samples.PopulationVariance();   // Drift population variance
+	drift_samvar  = drift_samples.SampleVariance();       // Drift Sample Variance
+	offset_popvar = offset_samples.PopulationVariance();  // Offset Population Variance
+
+	// Upper bounds on the variances using the chi squared distribution
+	// (same as upper_confidence_limit_on_std_deviation(sqrt(var), M or N, p))
+	drift_bound  = drift_popvar*drift_var_factor;
+	offset_bound = offset_popvar*offset_var_factor;
+}
 
-	// Calculate Variance
-	for(n = 0; n < numPoints; n++)
-	{
-	   var += (samples[n] - mean)*(samples[n] - mean);
-	}
-	var = var/numPoints;
+// Sliding window statistics
+SlidingWindowStats::SlidingWindowStats()
+: head(0), count(0), updates(0), mean(0), m2(0)
+{
+}
 
-	return var;
+// Set the window size and clear the window
+void SlidingWindowStats::Resize(int size)
+{
+	window.assign(size > 1 ? size : 2, 0.0);
+	head = 0;
+	count = 0;
+	updates = 0;
+	mean = 0;
+	m2 = 0;
 }
 
-// Calculate population variance
-double SyncUncertainty::GetPopulationVariance(std::vector<int64_t> samples)
+// Add a sample (Welford update, sliding once the window is full)
+void SlidingWindowStats::Add(double sample)
 {
-	double var = 0;
-	double mean = 0;
-	int numPoints = samples.size();
-	int n;
+	int size = window.size();
+	double delta, old_sample, old_mean;
 
-	// Calculate Mean
-	for(n = 0; n < numPoints; n++)
+	if (count < size)
 	{
-		mean = mean + (double)samples[n];
+		window[head] = sample;
+		count++;
+		delta = sample - mean;
+		mean += delta/count;
+		m2 += delta*(sample - mean);
 	}
-	mean = mean/numPoints;
-
-	// Calculate Variance
-	for(n = 0; n < numPoints; n++)
+	else
 	{
-	   var += ((double)samples[n] - mean)*((double)samples[n] - mean);
+		old_sample = window[head];
+		window[head] = sample;
+		old_mean = mean;
+		mean += (sample - old_sample)/count;
+		m2 += (sample - old_sample)*(sample - mean + old_sample - old_mean);
+
+		// Amortized O(1): one exact pass every window-length updates bounds the rounding drift
+		if (++updates >= size)
+			Recompute();
 	}
-	var = var/numPoints;
-
-	return var;
+	if (m2 < 0)
+		m2 = 0;
+	head = (head + 1) % size;
 }
 
-// Calculate sample variance
-double SyncUncertainty::GetSampleVarianceDouble(std::vector<double> samples)
+// Number of samples in the window
+int SlidingWindowStats::Count() const
 {
-	double var = 0;
-	double mean = 0;
-	int numPoints = samples.size();
-	int n;
-
-	// Calculate Mean
-	for(n = 0; n < numPoints; n++)
-	{
-		mean = mean + samples[n];
-	}
-	mean = mean/numPoints;
+	return count;
+}
 
-	// Calculate Variance
-	for(n = 0; n < numPoints; n++)
-	{
-	   var += (samples[n] - mean)*(samples[n] - mean);
-	}
-	var = var/(numPoints-1);
+// Population variance
+double SlidingWindowStats::PopulationVariance() const
+{
+	return (count > 0) ? m2/count : 0;
+}
 
-	return var;
+// Sample variance
+double SlidingWindowStats::SampleVariance() const
+{
+	return (count > 1) ? m2/(count - 1) : 0;
 }
 
-// Calculate variance bounds
-void SyncUncertainty::CalcVarBounds()
+// Two-pass recomputation over the window
+void SlidingWindowStats::Recompute()
 {
-	// Calculate Variances
-	drift_popvar  = GetPopulationVarianceDouble(drift_samples);   // Drift population variance
-    drift_samvar  = GetSampleVarianceDouble(drift_samples);       // Drift Sample Variance
-    offset_popvar = GetPopulationVariance(offset_samples);  // Offset Population Variance
-
-    std::cout << "Drift Variance = " << drift_popvar << "\n";
-    // Get the upper bound on the drift variance using the chi squared distribution
-    drift_bound = upper_confidence_limit_on_std_deviation(sqrt(drift_popvar), config.M, config.pds);
-
-    std::cout << "Offset Variance = " << offset_popvar << "\n";
-    // Get the upper bound on the offset variance using the chi squared distribution
-    offset_bound = upper_confidence_limit_on_std_deviation(sqrt(offset_popvar), config.N, config.pos);;
-}
\ No newline at end of file
+	double sum = 0;
+	int n;
+
+	for (n = 0; n < count; n++)
+		sum += window[n];
+	mean = sum/count;
+
+	m2 = 0;
+	for (n = 0; n < count; n++)
+		m2 += (window[n] - mean)*(window[n] - mean);
+	updates = 0;
+}
@@ -48,11 +48,11 @@ extern "C"
 	#include "../../../qot_types.h"
 }
 
-#ifdef NATS_SERVICE
-// NATS client header
-#include <nats/nats.h>
+#ifdef PUBSUB_SERVICE
+// Publish/subscribe transport
+#include "../qot_pubsub.hpp"
 
-// NATS Callback function
+// Subscription Callback function
 typedef void (*subscription_callback_t)(tl_translation_t params, std::string timeline_uuid, std::string node_name, uint64_t desired_accuracy);
 
 #endif 
@@ -69,6 +69,35 @@ namespace qot
 		double pov;     // Probability of computing a safe bound on offset variance -> Set to 0.999999 (as per paper)
 	};
 
+	// Mean and variance over a sliding window, updated in O(1) per sample (Welford)
+	class SlidingWindowStats {
+		// Constructor
+		public: SlidingWindowStats();
+
+		// Set the window size and clear the window (the only allocation)
+		public: void Resize(int size);
+
+		// Add a sample, replacing the oldest one once the window is full
+		public: void Add(double sample);
+
+		// Number of samples in the window
+		public: int Count() const;
+
+		// Variances of the samples in the window
+		public: double PopulationVariance() const;
+		public: double SampleVariance() const;
+
+		// Recompute the accumulators from the window to cancel rounding drift
+		private: void Recompute();
+
+		private: std::vector<double> window;
+		private: int head;       // Next slot to write
+		private: int count;      // Samples in the window
+		private: int updates;    // Sliding updates since the last recompute
+		private: double mean;    // Running mean
+		private: double m2;      // Running sum of squared deviations from the mean
+	};
+
 	// Base functionality
 	class SyncUncertainty {
 		// Constructor and destructor
@@ -85,18 +114,21 @@ namespace qot
 		// Configure the Parameters of the Synchronization Uncertainty Calculation Algorithm
 		public: void Configure(struct uncertainty_params configuration);
 
-		#ifdef NATS_SERVICE
+		// Set the source (timeline index) of the traced bound updates
+		public: void SetTraceSource(int source);
+
+		#ifdef PUBSUB_SERVICE
 		// Set the master sync topic to share uncertainty info with synchronization master (for local timelines)
 		public: bool StartMasterSyncPublish(std::string topic);
 
 		// Stop sending data to the master sync (for local timelines)
 		public: bool StopMasterSyncPublish();
 
-		/* Subscribe to a NATS topic (subject) */
-		public: int natsSubscribe(std::string &topic, subscription_callback_t callback);
+		/* Subscribe to a topic (subject) */
+		public: int pubsubSubscribe(std::string &topic, subscription_callback_t callback);
 
-		/* Un-subscribe from a NATS topic (subject) */
-		public: int natsUnSubscribe();
+		/* Un-subscribe from a topic (subject) */
+		public: int pubsubUnSubscribe();
 
 		// Set the node name
 		public: bool SetNodeUUID(std::string node_name);
@@ -112,21 +144,12 @@ namespace qot
 		// Calculate variance bounds
 	    private: void CalcVarBounds();
 
-	    // Helper functions for variance calculation
-	    private: double GetPopulationVarianceDouble(std::vector<double> samples);
-	    private: double GetPopulationVariance(std::vector<int64_t> samples);
-	    private: double GetSampleVarianceDouble(std::vector<double> samples);
-
 		// Uncertainty Calculation Parameters
 		private: struct uncertainty_params config; 
 
-		// Vector (Circular Buffer) of samples of uncertainty estimation
-		private: std::vector<int64_t> offset_samples;  // Nanosecond offset
-		private: std::vector<double> drift_samples;      // ppb/1Billion drift  
-
-		// Pointers to maintain vector circular buffers (point to lates added elements)
-		private: int offset_pointer; // Pointer to last element in the offset_samples buffer
-		private: int drift_pointer;  // Pointer to last element in the drift_samples buffer
+		// Sliding windows of samples of uncertainty estimation
+		private: SlidingWindowStats offset_samples;  // Nanosecond offset
+		private: SlidingWindowStats drift_samples;   // ppb/1Billion drift  
 
 		// Estimated Variances
 		private: double drift_popvar;   // Drift population variance
@@ -137,6 +160,11 @@ namespace qot
 		private: double drift_bound;    // Drift Variance Safe Upper Bound
 		private: double offset_bound;   // Offset Variance Safe Upper Bound
 
+		// Distribution quantiles, fixed for a configuration (computed in Configure)
+		private: double drift_var_factor;   // Chi squared factor for M samples and pds
+		private: double offset_var_factor;  // Chi squared factor for N samples and pos
+		private: double gaussian_pdv;       // Standard normal quantile for pdv
+
 		// Sync Uncertainty Calculation Constants
 		private: double inv_error_pdv;
 		private: double inv_error_pov;
@@ -145,24 +173,21 @@ namespace qot
 		private: double right_margin;
 		private: double left_margin; 
 
-		#ifdef NATS_SERVICE
-		// Connect to the NATS Server
-		public: int natsConnect(const char* nats_url);
-		// Return if the nats connection succeeded or not
-		public: int getNatsStatus();
+		// Source of the traced bound updates
+		private: int trace_source;
 
-		// NATS messaging variables
-		private: natsConnection      *conn;
-	    private: natsMsg             *msg;
-	    private: natsStatus          s;
+		#ifdef PUBSUB_SERVICE
+		// Connect to the publish/subscribe server (nats://, inproc:// or local:// URL)
+		public: int pubsubConnect(const char* pubsub_url);
+		// Return if the connection succeeded (0) or not
+		public: int getPubSubStatus();
 
-	    // NATS Subscription
-	    private: natsSubscription    *sub;
-	    private: volatile bool       done;
-		private: int nats_status_flag;    // Indicates connection went through
+		// Publish/subscribe transport
+		private: PubSubTransport     *transport;
+	    private: int                 sub_id;      // Subscription id (-1 when not subscribed)
 
-	    // Internal Sync NATS topic to share uncertainty info with SyncMaster
-		private: std::string master_nats_topic;
+	    // Internal Sync topic to share uncertainty info with SyncMaster
+		private: std::string master_sync_topic;
 		private: bool master_sync_topic_flag; // Flag indicating topic is set
 
 		// Node Name
@@ -171,6 +196,12 @@ namespace qot
 		// Node desired accuracy
 		private: uint64_t desired_accuracy;
 
+		// Sequence number of the published parameter updates
+		private: uint64_t pub_seq;
+
+		// Publish the timeline parameters (and optionally forward them to the sync master)
+		private: void PublishParams(tl_translation_t *tl_clk_params, const std::string &timeline_uuid, bool to_master);
+
 		#endif
 	};
 }
@@ -84,10 +84,12 @@ int CircBuffer::AddElement(peer_clk_params_t params)
 	    // Add the parameters to the local timeline data structure
 	    if (clk_params != NULL)
 	    {
+	    	tl_translation_write_begin(clk_params);
 	    	clk_params->last = 0;                            
 	    	clk_params->mult = int64_t((-slope)*1000000000LL);   
 	    	clk_params->nsec = -intercept; 
 	    	clk_params->slope = -slope;
+	    	tl_translation_write_end(clk_params);
 	    	std::cout << "Overlay Parameters updated mult = " << clk_params->mult << ", nsec = " << clk_params->nsec << "\n";          
 	  	}
 	}
@@ -0,0 +1,675 @@
+/**
+ * @file PeerCompute.cpp
+ * @brief Network-effect solver which computes the peer node offsets from pair-wise estimates
+ * @author Anon D'Anon
+ * 
+ * Copyright (c) Anon, 2018. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *      1. Redistributions of source code must retain the above copyright notice, 
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice, 
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <iostream>
+
+#include "PeerCompute.hpp"
+
+// Parameter message serialization (JSON or binary)
+#include "../../qot_clkparams_serialize.hpp"
+
+using namespace qot;
+
+#define DEBUG_FLAG 0
+
+// Constructor
+PeerCompute::PeerCompute(const std::string &master, uint64_t period_ns, const std::string &pub_server)
+  : master_name(master), proc_period_ns(period_ns), nats_server(pub_server), fresh_edges(0), basis_dirty(true),
+    master_time(0), master_time_set(false), data_ready(false), running(false)
+{
+    if (proc_period_ns < PEER_COMPUTE_MIN_PERIOD_NS)
+        proc_period_ns = PEER_COMPUTE_MIN_PERIOD_NS;
+
+    // The master is always the first node (root of the loop basis)
+    AddNode(master_name);
+
+    #ifdef PUBSUB_SERVICE
+    // Initialize Pub-Sub Parameters
+    transport = NULL;
+    params_sub = -1;
+    topology_sub = -1;
+    #endif
+}
+
+// Destructor
+PeerCompute::~PeerCompute()
+{
+    Stop();
+}
+
+/* Add a node to the topology */
+int PeerCompute::AddNode(const std::string &node)
+{
+    std::lock_guard<std::mutex> lock(data_lock);
+    std::map<std::string, int>::iterator it = node_map.find(node);
+    if (it != node_map.end())
+        return it->second;
+
+    node_map[node] = (int) node_list.size();
+    node_list.push_back(node);
+    adjacency.push_back(std::vector<int>());
+    return (int) node_list.size() - 1;
+}
+
+/* Add an undirected edge to the topology */
+int PeerCompute::AddEdge(const std::string &node_a, const std::string &node_b)
+{
+    if (node_a == node_b)
+        return -1;
+
+    int a = AddNode(node_a);
+    int b = AddNode(node_b);
+
+    std::lock_guard<std::mutex> lock(data_lock);
+    if (edge_map.find(std::make_pair(a, b)) != edge_map.end())
+        return 0;
+
+    peer_edge edge;
+    edge.node_a = a;
+    edge.node_b = b;
+    edge.alpha[0] = edge.alpha[1] = 0;
+    edge.beta[0] = edge.beta[1] = 0;
+    edge.fresh = false;
+
+    int k = (int) edge_list.size();
+    edge_list.push_back(edge);
+    edge_map[std::make_pair(a, b)] = 2*k;
+    edge_map[std::make_pair(b, a)] = 2*k + 1;
+    adjacency[a].push_back(b);
+    adjacency[b].push_back(a);
+    basis_dirty = true;
+
+    std::cout << "PeerCompute: Edge " << node_a << " <-> " << node_b << " joined\n";
+    return 0;
+}
+
+/* Remove an undirected edge from the topology */
+int PeerCompute::RemoveEdge(const std::string &node_a, const std::string &node_b)
+{
+    std::lock_guard<std::mutex> lock(data_lock);
+    std::map<std::string, int>::iterator it_a = node_map.find(node_a);
+    std::map<std::string, int>::iterator it_b = node_map.find(node_b);
+    if (it_a == node_map.end() || it_b == node_map.end())
+        return -1;
+
+    int a = it_a->second;
+    int b = it_b->second;
+    std::map<std::pair<int,int>, int>::iterator it = edge_map.find(std::make_pair(a, b));
+    if (it == edge_map.end())
+        return -1;
+
+    // Remove the edge keeping the insertion order of the remaining ones
+    int k = it->second/2;
+    if (edge_list[k].fresh)
+        fresh_edges--;
+    edge_list.erase(edge_list.begin() + k);
+    edge_map.clear();
+    for (size_t i = 0; i < edge_list.size(); i++)
+    {
+        edge_map[std::make_pair(edge_list[i].node_a, edge_list[i].node_b)] = 2*i;
+        edge_map[std::make_pair(edge_list[i].node_b, edge_list[i].node_a)] = 2*i + 1;
+    }
+    adjacency[a].erase(std::find(adjacency[a].begin(), adjacency[a].end(), b));
+    adjacency[b].erase(std::find(adjacency[b].begin(), adjacency[b].end(), a));
+    basis_dirty = true;
+
+    std::cout << "PeerCompute: Edge " << node_a << " <-> " << node_b << " left\n";
+
+    // The remaining edges may now all be fresh
+    if (!edge_list.empty() && fresh_edges == edge_list.size())
+    {
+        data_ready = true;
+        data_cv.notify_one();
+    }
+    return 0;
+}
+
+/* Add a pair-wise estimate published by a client about a server */
+int PeerCompute::SetEdgeParams(const std::string &server, const std::string &client, double start_time, double offset, double drift)
+{
+    std::lock_guard<std::mutex> lock(data_lock);
+    std::map<std::string, int>::iterator it_s = node_map.find(server);
+    std::map<std::string, int>::iterator it_c = node_map.find(client);
+    if (it_s == node_map.end() || it_c == node_map.end())
+        return -1;
+
+    std::map<std::pair<int,int>, int>::iterator it = edge_map.find(std::make_pair(it_c->second, it_s->second));
+    if (it == edge_map.end())
+        return -1;
+
+    // Client -> server direction and its inverse
+    peer_edge &edge = edge_list[it->second/2];
+    int dir = it->second & 1;
+    edge.beta[dir] = offset - drift*start_time;
+    edge.alpha[dir] = drift;
+    edge.beta[dir^1] = -edge.beta[dir]/(1 + drift);
+    edge.alpha[dir^1] = -drift/(1 + drift);
+
+    // Calculate the time at the master (midpoint of the interval)
+    if (client == master_name)
+    {
+        master_time = start_time + (double) proc_period_ns/2;
+        master_time_set = true;
+    }
+
+    if (!edge.fresh)
+    {
+        edge.fresh = true;
+        fresh_edges++;
+    }
+
+    if (fresh_edges == edge_list.size())
+    {
+        data_ready = true;
+        data_cv.notify_one();
+        return 1;
+    }
+    return 0;
+}
+
+/* Rebuild the loop basis in O(N+E), follows networkx.cycle_basis rooted at the master
+   so that the loop matrix matches the one of the former Python compute server */
+void PeerCompute::build_loop_basis()
+{
+    int num_nodes = (int) node_list.size();
+
+    // Graph nodes in the order in which they first appear in the edge list
+    std::vector<int> graph_nodes;
+    std::vector<char> in_graph(num_nodes, 0);
+    for (size_t i = 0; i < edge_list.size(); i++)
+    {
+        int ends[2] = {edge_list[i].node_a, edge_list[i].node_b};
+        for (int j = 0; j < 2; j++)
+        {
+            if (!in_graph[ends[j]])
+            {
+                in_graph[ends[j]] = 1;
+                graph_nodes.push_back(ends[j]);
+            }
+        }
+    }
+
+    std::vector<int> pred(num_nodes, -1);
+    std::vector<std::set<int> > used(num_nodes);
+    std::vector<char> visited(num_nodes, 0);
+    std::vector<int> stack;
+    std::vector<int> cycle;
+
+    loop_ptr.assign(1, 0);
+    loop_col.clear();
+    loop_sign.clear();
+
+    int root = in_graph.empty() ? -1 : (in_graph[0] ? 0 : -1);
+    while (true)
+    {
+        // Next component is rooted at the most recently added unvisited node
+        while (root < 0 && !graph_nodes.empty())
+        {
+            if (!visited[graph_nodes.back()])
+                root = graph_nodes.back();
+            graph_nodes.pop_back();
+        }
+        if (root < 0)
+            break;
+
+        pred[root] = root;
+        visited[root] = 1;
+        stack.assign(1, root);
+        while (!stack.empty())
+        {
+            int z = stack.back();
+            stack.pop_back();
+            for (size_t i = 0; i < adjacency[z].size(); i++)
+            {
+                int nbr = adjacency[z][i];
+                if (!visited[nbr])
+                {
+                    pred[nbr] = z;
+                    visited[nbr] = 1;
+                    used[nbr].insert(z);
+                    stack.push_back(nbr);
+                }
+                else if (used[z].find(nbr) == used[z].end())
+                {
+                    // Close the loop through the common ancestor
+                    std::set<int> &pn = used[nbr];
+                    cycle.clear();
+                    cycle.push_back(nbr);
+                    cycle.push_back(z);
+                    int p = pred[z];
+                    while (pn.find(p) == pn.end())
+                    {
+                        cycle.push_back(p);
+                        p = pred[p];
+                    }
+                    cycle.push_back(p);
+                    used[nbr].insert(z);
+
+                    // Traverse in order, the closing edge enters with a negative sign
+                    size_t n = cycle.size();
+                    for (size_t j = 0; j < n; j++)
+                    {
+                        if (j == n - 1)
+                        {
+                            loop_col.push_back(edge_map[std::make_pair(cycle[0], cycle[j])]);
+                            loop_sign.push_back(-1);
+                        }
+                        else
+                        {
+                            loop_col.push_back(edge_map[std::make_pair(cycle[j], cycle[j+1])]);
+                            loop_sign.push_back(1);
+                        }
+                    }
+                    loop_ptr.push_back((int) loop_col.size());
+                }
+            }
+        }
+        root = -1;
+    }
+
+    // The previous solution is meaningless for a new basis
+    loop_z.assign(loop_ptr.size() - 1, 0.0);
+    basis_dirty = false;
+
+    if (DEBUG_FLAG)
+        std::cout << "PeerCompute: " << loop_ptr.size() - 1 << " independent loops with " << loop_col.size() << " entries\n";
+}
+
+/* Breadth-first walk from the master over edges in insertion order */
+int PeerCompute::build_walk_order()
+{
+    int master = node_map[master_name];
+    std::vector<char> reached(node_list.size(), 0);
+    std::deque<int> queue;
+
+    walk_order.clear();
+    reached[master] = 1;
+    queue.push_back(master);
+    while (!queue.empty())
+    {
+        int u = queue.front();
+        queue.pop_front();
+        for (size_t i = 0; i < adjacency[u].size(); i++)
+        {
+            int v = adjacency[u][i];
+            if (reached[v])
+                continue;
+            reached[v] = 1;
+            walk_order.push_back(std::make_pair(v, edge_map[std::make_pair(u, v)]));
+            queue.push_back(v);
+        }
+    }
+    return (int) walk_order.size();
+}
+
+/* Compute (L * L^T) * v without forming the matrix -> O(nnz(L)) */
+void PeerCompute::apply_loop_gram(const std::vector<double> &v, std::vector<double> &out)
+{
+    size_t num_loops = loop_ptr.size() - 1;
+    std::fill(scratch_cols.begin(), scratch_cols.end(), 0.0);
+    for (size_t r = 0; r < num_loops; r++)
+        for (int j = loop_ptr[r]; j < loop_ptr[r+1]; j++)
+            scratch_cols[loop_col[j]] += loop_sign[j]*v[r];
+    for (size_t r = 0; r < num_loops; r++)
+    {
+        double sum = 0;
+        for (int j = loop_ptr[r]; j < loop_ptr[r+1]; j++)
+            sum += loop_sign[j]*scratch_cols[loop_col[j]];
+        out[r] = sum;
+    }
+}
+
+/* Project the offsets onto the null space of the loop matrix,
+   x - L^T (L L^T)^-1 L x, solving the loop system with Jacobi preconditioned
+   conjugate gradients warm-started from the previous period */
+void PeerCompute::project_offsets(std::vector<double> &offsets)
+{
+    size_t num_loops = loop_ptr.size() - 1;
+    if (num_loops == 0)
+        return;
+
+    scratch_cols.assign(offsets.size(), 0.0);
+
+    // b = L x and the diagonal preconditioner (loop lengths)
+    std::vector<double> b(num_loops), r(num_loops), p(num_loops), q(num_loops), w(num_loops), diag(num_loops);
+    double b_norm = 0;
+    for (size_t i = 0; i < num_loops; i++)
+    {
+        double sum = 0;
+        for (int j = loop_ptr[i]; j < loop_ptr[i+1]; j++)
+            sum += loop_sign[j]*offsets[loop_col[j]];
+        b[i] = sum;
+        b_norm += sum*sum;
+        diag[i] = 1.0/(double)(loop_ptr[i+1] - loop_ptr[i]);
+    }
+    b_norm = std::sqrt(b_norm);
+    std::vector<double> &z = loop_z;
+    if (b_norm == 0)
+    {
+        std::fill(z.begin(), z.end(), 0.0);
+        return;
+    }
+
+    // r = b - A z
+    apply_loop_gram(z, q);
+    double rw = 0;
+    for (size_t i = 0; i < num_loops; i++)
+    {
+        r[i] = b[i] - q[i];
+        w[i] = diag[i]*r[i];
+        p[i] = w[i];
+        rw += r[i]*w[i];
+    }
+
+    size_t max_iter = 2*num_loops + 10;
+    for (size_t iter = 0; iter < max_iter; iter++)
+    {
+        double r_norm = 0;
+        for (size_t i = 0; i < num_loops; i++)
+            r_norm += r[i]*r[i];
+        if (std::sqrt(r_norm) <= PEER_COMPUTE_CG_TOL*b_norm)
+            break;
+
+        apply_loop_gram(p, q);
+        double pq = 0;
+        for (size_t i = 0; i < num_loops; i++)
+            pq += p[i]*q[i];
+        if (pq <= 0)
+            break;
+
+        double step = rw/pq;
+        double rw_new = 0;
+        for (size_t i = 0; i < num_loops; i++)
+        {
+            z[i] += step*p[i];
+            r[i] -= step*q[i];
+            w[i] = diag[i]*r[i];
+            rw_new += r[i]*w[i];
+        }
+        for (size_t i = 0; i < num_loops; i++)
+            p[i] = w[i] + (rw_new/rw)*p[i];
+        rw = rw_new;
+    }
+
+    // x = x - L^T z
+    for (size_t i = 0; i < num_loops; i++)
+        for (int j = loop_ptr[i]; j < loop_ptr[i+1]; j++)
+            offsets[loop_col[j]] -= loop_sign[j]*z[i];
+}
+
+/* Project per-edge offsets onto the loop constraints of the current topology */
+int PeerCompute::ProjectOffsets(std::vector<double> &offsets)
+{
+    std::lock_guard<std::mutex> lock(data_lock);
+    if (offsets.size() != 2*edge_list.size())
+        return -1;
+    if (basis_dirty)
+        build_loop_basis();
+    project_offsets(offsets);
+    return (int) loop_ptr.size() - 1;
+}
+
+/* Apply the network effect to the latest estimates */
+int PeerCompute::Compute(std::map<std::string, peer_node_estimate> &estimates)
+{
+    std::lock_guard<std::mutex> lock(data_lock);
+    data_ready = false;
+    if (!master_time_set || edge_list.empty())
+        return -1;
+
+    if (basis_dirty)
+        build_loop_basis();
+    build_walk_order();
+
+    int master = node_map[master_name];
+    size_t num_nodes = node_list.size();
+    prelim_time.assign(num_nodes, 0.0);
+    final_time.assign(num_nodes, 0.0);
+    edge_offsets.assign(2*edge_list.size(), 0.0);
+
+    // Preliminary time at the nodes
+    prelim_time[master] = master_time;
+    for (size_t i = 0; i < walk_order.size(); i++)
+    {
+        int col = walk_order[i].second;
+        const peer_edge &edge = edge_list[col/2];
+        int u = (col & 1) ? edge.node_b : edge.node_a;
+        prelim_time[walk_order[i].first] = prelim_time[u]*(1 + edge.alpha[col & 1]) + edge.beta[col & 1];
+    }
+
+    // Preliminary per-edge offsets
+    for (size_t k = 0; k < edge_list.size(); k++)
+    {
+        const peer_edge &edge = edge_list[k];
+        edge_offsets[2*k] = edge.alpha[0]*prelim_time[edge.node_b] + edge.beta[0];
+        edge_offsets[2*k+1] = edge.alpha[1]*prelim_time[edge.node_a] + edge.beta[1];
+    }
+
+    // Final per-edge offsets
+    project_offsets(edge_offsets);
+
+    // Final time at the nodes
+    final_time[master] = prelim_time[master];
+    for (size_t i = 0; i < walk_order.size(); i++)
+    {
+        int col = walk_order[i].second;
+        const peer_edge &edge = edge_list[col/2];
+        int u = (col & 1) ? edge.node_b : edge.node_a;
+        final_time[walk_order[i].first] = final_time[u] + edge_offsets[col];
+    }
+
+    estimates.clear();
+    estimates[master_name].offset = 0;
+    estimates[master_name].final_time = final_time[master]/1000000000;
+    for (size_t i = 0; i < walk_order.size(); i++)
+    {
+        int v = walk_order[i].first;
+        estimates[node_list[v]].offset = (final_time[v] - prelim_time[master])/1000000000;
+        estimates[node_list[v]].final_time = final_time[v]/1000000000;
+    }
+
+    // Reset the fresh data flags for the next cycle
+    for (size_t k = 0; k < edge_list.size(); k++)
+        edge_list[k].fresh = false;
+    fresh_edges = 0;
+    master_time_set = false;
+
+    return 0;
+}
+
+/* Processing and publishing thread -> computes once all edges have data, publishes every period */
+void PeerCompute::processor()
+{
+    std::map<std::string, peer_node_estimate> estimates;
+    std::chrono::steady_clock::time_point next_publish = std::chrono::steady_clock::now() + std::chrono::nanoseconds(proc_period_ns);
+
+    while (running)
+    {
+        bool compute = false;
+        {
+            std::unique_lock<std::mutex> lock(data_lock);
+            data_cv.wait_until(lock, next_publish, [this] { return data_ready || !running; });
+            compute = data_ready;
+        }
+        if (!running)
+            break;
+
+        if (compute && Compute(estimates) == 0)
+        {
+            std::vector<peer_offset_msg> offsets;
+            for (std::map<std::string, peer_node_estimate>::iterator it = estimates.begin(); it != estimates.end(); ++it)
+            {
+                peer_offset_msg entry;
+                entry.node = it->first;
+                entry.offset = it->second.offset;
+                entry.final_time = it->second.final_time;
+                offsets.push_back(entry);
+                if (DEBUG_FLAG)
+                    std::cout << "PeerCompute: Node " << entry.node << " offset " << entry.offset << " final time " << entry.final_time << "\n";
+            }
+            offset_data = encode_peer_offsets(offsets, get_params_encoding("qot.peer.offsets"));
+        }
+
+        if (std::chrono::steady_clock::now() < next_publish)
+            continue;
+        next_publish += std::chrono::nanoseconds(proc_period_ns);
+
+        #ifdef PUBSUB_SERVICE
+        // Serialize and publish offsets
+        if (transport != NULL && !offset_data.empty())
+            transport->Publish("qot.peer.offsets", offset_data);
+        #endif
+    }
+}
+
+#ifdef PUBSUB_SERVICE
+
+/* Subscription handler for the pair-wise parameters */
+void PeerCompute::params_handler(const std::string &subject, const std::string &msg)
+{
+    if (DEBUG_FLAG)
+        printf("Received msg: %s - %s\n", subject.c_str(), msg.c_str());
+
+    /* De-serialize data (JSON or binary) */
+    peer_params_msg params;
+    if (decode_peer_params(msg, params) < 0)
+    {
+        std::cout << "PeerCompute: Malformed parameter message\n";
+        return;
+    }
+    SetEdgeParams(params.server, params.client, params.start_time, params.offset, params.drift);
+}
+
+/* Subscription handler for edges joining or leaving */
+void PeerCompute::topology_handler(const std::string &subject, const std::string &msg)
+{
+    /* De-serialize data */
+    try
+    {
+        nlohmann::json data = nlohmann::json::parse(msg);
+        std::string op = data["op"].get<std::string>();
+        if (op == "join")
+            AddEdge(data["server"].get<std::string>(), data["client"].get<std::string>());
+        else if (op == "leave")
+            RemoveEdge(data["server"].get<std::string>(), data["client"].get<std::string>());
+    }
+    catch (std::exception &e)
+    {
+        std::cout << "PeerCompute: Malformed topology message\n";
+    }
+}
+
+/* Connect and subscribe to the parameter and topology topics */
+int PeerCompute::pubsubSubscribe()
+{
+    using namespace std::placeholders;
+
+    transport = pubsub_connect(nats_server);
+    if (transport == NULL)
+    {
+        std::cout << "Error Connecting to pub-sub service\n";
+        return -1;
+    }
+    std::cout << "Connected to pub-sub service\n";
+
+    params_sub = transport->Subscribe("qot.peer.params", std::bind(&PeerCompute::params_handler, this, _1, _2));
+    if (params_sub >= 0)
+        topology_sub = transport->Subscribe("qot.peer.topology", std::bind(&PeerCompute::topology_handler, this, _1, _2));
+    if (params_sub < 0 || topology_sub < 0)
+    {
+        std::cout << "PeerCompute: Failed to subscribe to the peer topics\n";
+        return -1;
+    }
+    return 0;
+}
+
+/* Un-subscribe from the topics and disconnect */
+int PeerCompute::pubsubUnSubscribe()
+{
+    // Anything that is created need to be destroyed
+    if (transport != NULL)
+    {
+        if (params_sub >= 0)
+            transport->Unsubscribe(params_sub);
+        if (topology_sub >= 0)
+            transport->Unsubscribe(topology_sub);
+        delete transport;
+    }
+    transport = NULL;
+    params_sub = -1;
+    topology_sub = -1;
+    return 0;
+}
+#endif
+
+/* Start the peer compute service */
+int PeerCompute::Start()
+{
+    if (running)
+        return 0;
+
+    std::cout << "PeerCompute: Starting, master is " << master_name << ", period is " << proc_period_ns << " ns\n";
+
+    #ifdef PUBSUB_SERVICE
+    if (pubsubSubscribe() != 0)
+    {
+        pubsubUnSubscribe();
+        return -1;
+    }
+    #endif
+
+    running = true;
+    processor_thread = boost::thread(&PeerCompute::processor, this);
+    return 0;
+}
+
+/* Stop the peer compute service */
+int PeerCompute::Stop()
+{
+    if (!running)
+        return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(data_lock);
+        running = false;
+    }
+    data_cv.notify_one();
+    processor_thread.join();
+
+    #ifdef PUBSUB_SERVICE
+    pubsubUnSubscribe();
+    #endif
+
+    std::cout << "PeerCompute: Exited cleanly\n";
+    return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file PeerCompute.hpp
+ * @brief Network-effect solver which computes the peer node offsets from pair-wise estimates
+ * @author Anon D'Anon
+ * 
+ * Copyright (c) Anon, 2018. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *      1. Redistributions of source code must retain the above copyright notice, 
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice, 
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+#ifndef QOT_PEER_COMPUTE_HPP
+#define QOT_PEER_COMPUTE_HPP
+
+#include <boost/thread.hpp> 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef PUBSUB_SERVICE
+// Publish/subscribe transport
+#include "../../qot_pubsub.hpp"
+#endif 
+
+// Default period over which data is processed and published (ns)
+#define PEER_COMPUTE_DEF_PERIOD_NS 2000000000ULL
+
+// Smallest supported processing period (ns)
+#define PEER_COMPUTE_MIN_PERIOD_NS 10000000ULL
+
+// Relative residual at which the loop projection solve terminates
+#define PEER_COMPUTE_CG_TOL 1e-12
+
+// Final estimate for a single node
+struct peer_node_estimate {
+	double offset;          // Offset from the master's preliminary time (s)
+	double final_time;      // Corrected time at the node (s)
+};
+
+namespace qot
+{
+	class PeerCompute
+	{
+		/* Constructor and Destructor 
+		Params: master      The name of the synchronization master
+                period_ns   Period over which data is processed and published
+                pub_server  Server to which to subscribe and publish data */
+		public: PeerCompute(const std::string &master, uint64_t period_ns, const std::string &pub_server);
+		public: ~PeerCompute();
+
+		// Control functions
+		public: int Start();
+		public: int Stop();
+
+		/* Topology functions, edges are undirected and may join or leave at any time */
+		public: int AddNode(const std::string &node);
+		public: int AddEdge(const std::string &node_a, const std::string &node_b);
+		public: int RemoveEdge(const std::string &node_a, const std::string &node_b);
+
+		/* Add a pair-wise estimate published by a client about a server
+		   Returns 1 once every edge has fresh data, 0 otherwise and -1 on an unknown edge */
+		public: int SetEdgeParams(const std::string &server, const std::string &client, double start_time, double offset, double drift);
+
+		/* Apply the network effect to the latest estimates and reset the fresh data flags */
+		public: int Compute(std::map<std::string, peer_node_estimate> &estimates);
+
+		/* Project per-edge offsets onto the loop constraints of the current topology. Column 2k is
+		   edge k in its a->b direction and 2k+1 is b->a. Returns the number of independent loops */
+		public: int ProjectOffsets(std::vector<double> &offsets);
+
+		// Rebuild the loop basis from the current topology
+		private: void build_loop_basis();
+
+		// Walk the spanning tree rooted at the master
+		private: int build_walk_order();
+
+		// Project the per-edge offsets onto the null space of the loop matrix
+		private: void project_offsets(std::vector<double> &offsets);
+
+		// Compute (L * L^T) * v without forming the matrix
+		private: void apply_loop_gram(const std::vector<double> &v, std::vector<double> &out);
+
+		// Processing and publishing thread
+		private: void processor();
+
+		// Undirected edge between two nodes -> column 2k is a->b and 2k+1 is b->a
+		private: struct peer_edge {
+			int node_a;
+			int node_b;
+			double alpha[2];    // Per-direction drift
+			double beta[2];     // Per-direction offset at zero
+			bool fresh;         // Data received in this cycle
+		};
+
+		// Private class variables
+		private: std::string master_name;               // Synchronization master
+		private: uint64_t proc_period_ns;               // Processing Period
+		private: std::string nats_server;               // Publishing Server
+
+		// Topology
+		private: std::vector<std::string> node_list;         // Index to node name
+		private: std::map<std::string, int> node_map;        // Node name to index
+		private: std::vector<peer_edge> edge_list;           // Edges in insertion order
+		private: std::map<std::pair<int,int>, int> edge_map; // Directed node pair to column
+		private: std::vector<std::vector<int> > adjacency;   // Neighbours in insertion order
+		private: unsigned fresh_edges;                       // Edges with data in this cycle
+		private: bool basis_dirty;                           // Topology changed since the last basis
+
+		// Sparse loop matrix in compressed row form (entries are +1/-1)
+		private: std::vector<int> loop_ptr;
+		private: std::vector<int> loop_col;
+		private: std::vector<int> loop_sign;
+		private: std::vector<double> loop_z;                 // Last solution used as a warm start
+
+		// Spanning tree walk from the master (node, parent column)
+		private: std::vector<std::pair<int,int> > walk_order;
+
+		// Preliminary time of the master
+		private: double master_time;
+		private: bool master_time_set;
+
+		// Scratch vectors reused across periods
+		private: std::vector<double> prelim_time;
+		private: std::vector<double> final_time;
+		private: std::vector<double> edge_offsets;
+		private: std::vector<double> scratch_cols;
+
+		// Latest serialized estimates
+		private: std::string offset_data;
+
+		// Thread synchronization
+		private: std::mutex data_lock;
+		private: std::condition_variable data_cv;
+		private: bool data_ready;
+		private: volatile bool running;
+		private: boost::thread processor_thread;
+
+		#ifdef PUBSUB_SERVICE
+		// Connect and subscribe to the parameter and topology topics
+		private: int pubsubSubscribe();
+		// Un-subscribe from the topics and disconnect
+		private: int pubsubUnSubscribe();
+
+		// Subscription handlers
+		private: void params_handler(const std::string &subject, const std::string &msg);
+		private: void topology_handler(const std::string &subject, const std::string &msg);
+
+		// Publish/subscribe transport
+		private: PubSubTransport     *transport;
+	    private: int                 params_sub;
+	    private: int                 topology_sub;
+		#endif
+	};
+}
+
+#endif
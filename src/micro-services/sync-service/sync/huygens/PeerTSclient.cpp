@@ -26,21 +26,26 @@
  *
  */
 #include <iostream>
-#include <fstream>
 #include <cmath>
 #include <vector>
+#include <deque>
+#include <cstddef>
 
 #include "PeerTSclient.hpp"
 #include "Timestamping.hpp"
-#include "SVMprocessor.hpp"
-#include "libsvm/svm.h"
 
-// Add header to Modern JSON C++ Library
-#include "../../../../../thirdparty/json-modern-cpp/json.hpp"
+// Parameter message serialization (JSON or binary)
+#include "../../qot_clkparams_serialize.hpp"
 
 // Add header to spoof PTP messages
 #include "ptp_message.hpp"
 
+// Runtime metrics
+#include "../../qot_metrics.hpp"
+
+// Binary sync trace
+#include "../../qot_trace.hpp"
+
 #define BUFSIZE 1024
 
 using namespace qot;
@@ -51,34 +56,32 @@ using namespace qot;
 
 #define PRIMARY_MCAST_IPADDR "224.0.1.129"
 
-#ifdef NATS_SERVICE
-// Get the NATS connection status
-int PeerTSclient::getNatsStatus()
-{
-    return (int)s;
-}
+// Datagrams received per coded probe pair (two echoes and two remote timestamp replies)
+#define PROBE_MSGS 4
+
+// Number of 1 ms waits for TX timestamps which are not yet queued
+#define TX_TIMESTAMP_RETRIES 2
 
-// Connect to the NATS server
-int PeerTSclient::natsConnect(const char* nats_url)
+#ifdef PUBSUB_SERVICE
+// Connect to the publish/subscribe server
+int PeerTSclient::pubsubConnect(const char* pubsub_url)
 {
-    s = natsConnection_ConnectTo(&conn, nats_url);
-    if (s == NATS_OK)
+    delete transport;
+    transport = pubsub_connect(std::string(pubsub_url));
+    if (transport != NULL)
     {
-        std::cout << "Connected to NATS service\n";
+        std::cout << "Connected to pub-sub service\n";
+        return 0;
     }
-    else
-    {
-        std::cout << "Error Connecting to NATS service\n";
-    }
-    return (int)s;
+    std::cout << "Error Connecting to pub-sub service\n";
+    return -1;
 }
 #endif
 
 // Constructor
 PeerTSclient::PeerTSclient(const std::string &hostname, int portno, const std::string &iface, const std::string &pub_server, int ts_flag)
   : portno(portno), iface(iface), ts_flag(ts_flag), hostname(hostname), running(true), tx_period_ns(1000000000), 
-    ts_buffer(NULL), proc_ts_buffer(NULL), ts_duration_ns(2000000000ULL), ts_buf_len(0),
-    data_lock(PTHREAD_MUTEX_INITIALIZER), data_condvar(PTHREAD_COND_INITIALIZER), nats_server(pub_server)
+    probe_ring(NULL), ts_duration_ns(2000000000ULL), ts_buf_len(0), nats_server(pub_server)
 {
     error_flag = 0;
     // If the port is same as PTP, set the flag
@@ -90,11 +93,12 @@ PeerTSclient::PeerTSclient(const std::string &hostname, int portno, const std::s
     else
       ptp_msgflag = 0;
 
-    #ifdef NATS_SERVICE
-    // Initialize NATS Parameters
-    conn = NULL;
-    msg  = NULL;
-    s = NATS_ERR;
+    rtt_metric = metrics_register(QOT_METRIC_HISTOGRAM, "qot_peer_probe_rtt_seconds", "peer=\"" + hostname + "\"",
+                                  "Round-trip time of the peer probes, without the remote turnaround");
+
+    #ifdef PUBSUB_SERVICE
+    // Initialize Pub-Sub Parameters
+    transport = NULL;
 
     #endif
 }
@@ -102,9 +106,9 @@ PeerTSclient::PeerTSclient(const std::string &hostname, int portno, const std::s
 // Destructor
 PeerTSclient::~PeerTSclient()
 {
-    #ifdef NATS_SERVICE
-    // Destroy the NATS connection
-    // natsConnection_Destroy(conn);
+    #ifdef PUBSUB_SERVICE
+    // Destroy the pub-sub connection (if Stop was not called)
+    delete transport;
     #endif
 }
 
@@ -112,11 +116,6 @@ PeerTSclient::~PeerTSclient()
 int PeerTSclient::Reset()
 {
   running = false;
-  // Wake the processor thread from its condition variable
-  pthread_mutex_lock(&data_lock);
-  pthread_cond_signal(&data_condvar);
-  pthread_mutex_unlock(&data_lock);
-
   client_thread.join();
   processor_thread.join();
   
@@ -182,18 +181,19 @@ int PeerTSclient::Start(const std::string &node_name, uint64_t period_ns)
   else   /* Configure software timestamping */
     ts_flag = tstamp_mode_kernel(sockfd);
 
-  /* Initialize the Buffer to hold the timestamps */
-  ts_buffer = new probe_timestamps[ts_duration_ns/period_ns];
-  proc_ts_buffer = new probe_timestamps[ts_duration_ns/period_ns];
+  /* Initialize the ring which hands the timestamps to the processor (two windows of slack) */
   ts_buf_len = ts_duration_ns/period_ns;
+  if (ts_buf_len < 2)
+    ts_buf_len = 2;
+  probe_ring = new SPSCRing<probe_timestamps>(2*ts_buf_len);
 
   std::cout << "PeerTSclient: Tx Period = " << period_ns << " ns"
             << " Processing Duration = " << ts_duration_ns << " ns\n";
 
-  #ifdef NATS_SERVICE
-  // Connect to NATS Service
-  std::cout << "PeerTSclient: Connecting to NATS server on " << nats_server << "\n";
-  natsConnect(nats_server.c_str());
+  #ifdef PUBSUB_SERVICE
+  // Connect to the pub-sub service
+  std::cout << "PeerTSclient: Connecting to pub-sub server on " << nats_server << "\n";
+  pubsubConnect(nats_server.c_str());
   #endif
 
   // Spawn the server thread
@@ -206,24 +206,16 @@ int PeerTSclient::Start(const std::string &node_name, uint64_t period_ns)
 int PeerTSclient::Stop()
 {
   running = false;
-  // Wake the processor thread from its condition variable
-  pthread_mutex_lock(&data_lock);
-  pthread_cond_signal(&data_condvar);
-  pthread_mutex_unlock(&data_lock);
-
   client_thread.join();
   processor_thread.join();
-  delete ts_buffer;
-  delete proc_ts_buffer;
-  ts_buffer = NULL;
+  delete probe_ring;
+  probe_ring = NULL;
   error_flag = 0;
-  #ifdef NATS_SERVICE
-  // Destroy the NATS connection
-  std::cout << "PeerTSclient: destroying nats connection\n";
-  if (s == NATS_OK)
-  {
-    natsConnection_Destroy(conn);
-  }
+  #ifdef PUBSUB_SERVICE
+  // Destroy the pub-sub connection
+  std::cout << "PeerTSclient: destroying pub-sub connection\n";
+  delete transport;
+  transport = NULL;
   #endif
   return 0;
 }
@@ -243,19 +235,49 @@ int PeerTSclient::proc_client_loop()
     int vec_len = 0, vec_ctr = 0, data_ctr = 0;
     double offset, drift;
 
+    // Sliding window over the most recent probes, re-estimated every ts_buf_len new probes
+    std::deque<probe_timestamps> window;
+    std::vector<probe_timestamps> batch(probe_ring->GetCapacity());
+    uint64_t new_probes = 0, overflows = 0;
+
+    // Poll interval when the ring is empty (one probe period, bounded)
+    struct timespec poll_interval;
+    uint64_t poll_ns = tx_period_ns;
+    if (poll_ns < 1000000ULL)
+      poll_ns = 1000000ULL;
+    if (poll_ns > 100000000ULL)
+      poll_ns = 100000000ULL;
+    poll_interval.tv_sec = poll_ns/1000000000ULL;
+    poll_interval.tv_nsec = poll_ns % 1000000000ULL;
+
     while (running) 
     {
-      pthread_mutex_lock(&data_lock);
-
-      // Check if a new batch of data has arrived
-      pthread_cond_wait(&data_condvar, &data_lock);
+      // Drain whatever the timestamping thread has produced
+      size_t count = probe_ring->PopBatch(&batch[0], batch.size());
+      if (count == 0)
+      {
+          nanosleep(&poll_interval, NULL);
+          continue;
+      }
+      for (size_t i = 0; i < count; i++)
+      {
+        window.push_back(batch[i]);
+        if (window.size() > ts_buf_len)
+          window.pop_front();
+      }
+      new_probes += count;
 
-      if (!running)
+      // Report probes dropped because the processor fell behind
+      if (probe_ring->GetOverflows() != overflows)
       {
-          pthread_mutex_unlock(&data_lock);
-          break;
+          std::cout << "PeerTSclient: Probe ring overflowed, " << probe_ring->GetOverflows() - overflows << " probes dropped\n";
+          overflows = probe_ring->GetOverflows();
       }
 
+      if (window.size() < ts_buf_len || new_probes < ts_buf_len)
+          continue;
+      new_probes = 0;
+
       // Process the batch
       if (DEBUG_FLAG)
         std::cout << "PeerTSclient: New batch of data received\n";
@@ -264,10 +286,10 @@ int PeerTSclient::proc_client_loop()
       vec_len = 0;
       vec_ctr = 0;
       data_ctr = 0;
-      int64_t start_time = proc_ts_buffer[0].rx[0];
-      for (int i=0; i < ts_buf_len-1; i++)
+      int64_t start_time = window.front().rx[0];
+      for (size_t i=0; i < window.size(); i++)
       {
-        struct probe_timestamps timestamps = proc_ts_buffer[i];
+        struct probe_timestamps &timestamps = window[i];
 
         // Check coded probes
         if (timestamps.validity_flag == 1)
@@ -291,44 +313,44 @@ int PeerTSclient::proc_client_loop()
             }
         }
       }
-      pthread_mutex_unlock(&data_lock);
       if (DEBUG_FLAG)
         std::cout << "PeerTSclient: Valid data received is " << data_ctr << "\n";
       if (vec_len > 0)
       {
           if (DEBUG_FLAG)
             std::cout << "PeerTSclient: Formulating problem with vec_len " << vec_len << "\n";
-          formulate_problem(peer_offset_bounds, instant, vec_len);
+          if (svm_processor.FormulateProblem(peer_offset_bounds, instant, vec_len) < 0)
+          {
+            std::cout << "PeerTSclient: Degenerate batch, no estimate computed\n";
+            continue;
+          }
 
           if (DEBUG_FLAG)
             std::cout << "PeerTSclient: Running SVM\n";
-          run_svm(offset, drift);
+          if (svm_processor.Run(offset, drift) < 0)
+          {
+            std::cout << "PeerTSclient: SVM did not yield a hyperplane\n";
+            continue;
+          }
           // std::cout << "PeerTSclient: SVM completed\n";
-          #ifdef NATS_SERVICE
-          // Publish the message to NATS
-          if (s == NATS_OK)
+          #ifdef PUBSUB_SERVICE
+          // Publish the message
+          if (transport != NULL)
           {
-            msg = NULL;
-            // Convert the params to json
-            nlohmann::json params;
-            params["client"] = node_uuid;
-            params["server"] = hostname;
-            params["offset"] = offset;
-            params["drift"] = drift;
-            params["start_time"] = start_time;
-            std::string data = params.dump();
-
             // Construct the topic name
-            std::string nats_subject = "qot.peer.params";
-            // nats_subject.append(std::string("params"));
-
-            s = natsMsg_Create(&msg, nats_subject.c_str(), NULL, data.c_str(), data.length());
-            if (s == NATS_OK)
-            {
-                natsConnection_PublishMsg(conn, msg);
-                // std::cout << "PeerTSclient: Published Message to NATS on topic " << nats_subject << "\n";
-            }
-            natsMsg_Destroy(msg);
+            std::string pubsub_subject = "qot.peer.params";
+
+            // Serialize the params in the encoding selected for the topic
+            peer_params_msg params;
+            params.client = node_uuid;
+            params.server = hostname;
+            params.offset = offset;
+            params.drift = drift;
+            params.start_time = start_time;
+            std::string data = encode_peer_params(params, get_params_encoding(pubsub_subject));
+
+            transport->Publish(pubsub_subject, data);
+            // std::cout << "PeerTSclient: Published Message on topic " << pubsub_subject << "\n";
           }
           #endif
       }
@@ -348,11 +370,8 @@ int PeerTSclient::ts_client_loop()
 {
     int n;
     int64_t rtt_peerdelay_ns, offset_ns;
-    socklen_t serverlen;
     struct sockaddr_in serveraddr;
     char buf[BUFSIZE];
-    char cmsgbuf[BUFSIZE]; /* ancillary info buf */
-    struct timespec pkt_timestamp; /* packet timestamp */
     struct timespec recv_timeout; /* receive message timeout */
     struct timespec tx_period; /* period */
     struct timeval recv_timeout_tv;
@@ -360,10 +379,9 @@ int PeerTSclient::ts_client_loop()
     uint64_t now_ns, next_wakeup_ns;
     int debug_flag = DEBUG_FLAG;
     struct ptp_message *ptp_msg = msg_allocate();
-    int buflen;
 
     /* 4 Timestamps to calculate offset and round-trip time */
-    struct timespec tx_timestamp, rx_timestamp, rx_timestamp_remote, tx_timestamp_remote;
+    struct timespec rx_timestamp, rx_timestamp_remote, tx_timestamp_remote;
     struct probe_timestamps timestamps;
     int64_t peer_offset_up, peer_offset_low;
 
@@ -402,20 +420,23 @@ int PeerTSclient::ts_client_loop()
     tx_period.tv_sec = tx_period_ns/1000000000ULL;
     tx_period.tv_nsec = tx_period_ns % 1000000000ULL;
 
-    /* Setup message header */
-    struct mmsghdr msg_vec;
-    struct msghdr msg;
-    struct iovec iov[1];
-    iov[0].iov_base=buf;
-    iov[0].iov_len=sizeof(buf);
-
-    msg.msg_name=&serveraddr;
-    msg.msg_namelen=sizeof(serveraddr);
-    msg.msg_iov=iov;
-    msg.msg_iovlen=1;
-    msg.msg_control=(caddr_t)cmsgbuf;
-    msg.msg_controllen=sizeof(cmsgbuf);
-    msg_vec.msg_hdr = msg;
+    /* Setup the probe and reply message headers */
+    char probe_buf[2][BUFSIZE];
+    struct ptp_message *ptp_probe[2] = { NULL, NULL };
+    char rx_buf[PROBE_MSGS][BUFSIZE];
+    char rx_cmsgbuf[PROBE_MSGS][BUFSIZE]; /* ancillary info buf */
+    struct mmsghdr tx_vec[2], rx_vec[PROBE_MSGS];
+    struct iovec tx_iov[2], rx_iov[PROBE_MSGS];
+    struct tx_timestamp tx_entries[2*PROBE_MSGS];
+    if (ptp_msgflag)
+    {
+        ptp_probe[0] = ptp_msg;
+        ptp_probe[1] = msg_allocate();
+    }
+
+    /* TX timestamps are matched to probes with the socket's OPT_ID counter */
+    int opt_id = tstamp_opt_id_enabled(sockfd);
+    uint32_t tx_id = 0; /* counter of the next sent packet */
 
     /* Override debug flag if the period is too small */
     if (tx_period_ns < 500000000)
@@ -423,10 +444,6 @@ int PeerTSclient::ts_client_loop()
     else
         debug_flag = 1;
 
-    /* Output debug file */
-    std::ofstream outfile;
-    outfile.open ("example.txt");
-
     /* 
      * main loop: keep periodically sending messages, the wait for the echo
      */
@@ -434,7 +451,8 @@ int PeerTSclient::ts_client_loop()
     int remote_ok_flag = 1;
     int counter = 0; // counter to identify messages and handle message drops
     int recv_counter = 0;
-    int buffer_counter = 0;
+    int probe_ids[2];
+    int got_echo[2], got_remote[2], got_tx[2];
     while (running) { 
         /* Periodic wakeup to send */
         clock_gettime(CLOCK_REALTIME, &now);
@@ -444,107 +462,175 @@ int PeerTSclient::ts_client_loop()
         next_wakeup.tv_nsec = next_wakeup_ns % 1000000000ULL;
         clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next_wakeup, NULL);
 
-        /* Implement coded probes */
+        /* Implement coded probes -> both probes leave in a single sendmmsg */
         ok_flag = 1;
+        memset(tx_vec, 0, sizeof(tx_vec));
         for (int i=0; i < 2; i ++)
         {
             /* Increment message counter */
             counter = (counter + 1) % 255;
+            probe_ids[i] = counter;
+            got_echo[i] = got_remote[i] = got_tx[i] = 0;
             if (ptp_msgflag)
             {
               serveraddr.sin_addr = mcast_addr;
               serveraddr.sin_port = htons(portno);
-              populate_dummy_ptp_msg(ptp_msg, (uint16_t) counter, iface.c_str());
+              populate_dummy_ptp_msg(ptp_probe[i], (uint16_t) counter, iface.c_str());
+              tx_iov[i].iov_base = ptp_probe[i];
+              tx_iov[i].iov_len = get_dummy_msg_len(ptp_probe[i]);
             }
-
-            /* send the message to the server */
-            sprintf(buf, "%d", counter);
-            serverlen = sizeof(serveraddr);
-            
-            // Send a PTP message if the flag is enabled
-            if (ptp_msgflag)
+            else
             {
-              n = sendto(sockfd, ptp_msg, get_dummy_msg_len(ptp_msg), 0, (struct sockaddr*)&serveraddr, serverlen);
-              buflen  = get_dummy_msg_len(ptp_msg);
+              sprintf(probe_buf[i], "%d", counter);
+              tx_iov[i].iov_base = probe_buf[i];
+              tx_iov[i].iov_len = strlen(probe_buf[i]) + 2;
             }
-            else // Send a normal unicast message
+            tx_vec[i].msg_hdr.msg_name = &serveraddr;
+            tx_vec[i].msg_hdr.msg_namelen = sizeof(serveraddr);
+            tx_vec[i].msg_hdr.msg_iov = &tx_iov[i];
+            tx_vec[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        /* send the messages to the server */
+        uint32_t tx_id_base = tx_id;
+        n = sendmmsg(sockfd, tx_vec, 2, 0);
+        if (n > 0)
+            tx_id += n;
+        if (n < 2) 
+        {
+            perror("PeerTSClient: ERROR in sendmmsg");
+            ok_flag = 0;
+        }
+
+        /* Receive the echoes and the remote timestamps, matched by probe counter */
+        int received = 0;
+        int remote_order = 0;
+        while (ok_flag && received < PROBE_MSGS)
+        {
+            memset(rx_vec, 0, sizeof(rx_vec));
+            for (int j = 0; j < PROBE_MSGS; j++)
             {
-              n = sendto(sockfd, buf, strlen(buf)+2, 0, (struct sockaddr*)&serveraddr, serverlen);
-              buflen = strlen(buf);
+                rx_iov[j].iov_base = rx_buf[j];
+                rx_iov[j].iov_len = BUFSIZE - 1;
+                rx_vec[j].msg_hdr.msg_iov = &rx_iov[j];
+                rx_vec[j].msg_hdr.msg_iovlen = 1;
+                rx_vec[j].msg_hdr.msg_control = (caddr_t)rx_cmsgbuf[j];
+                rx_vec[j].msg_hdr.msg_controllen = sizeof(rx_cmsgbuf[j]);
             }
-            if (n < 0) 
+            n = recvmmsg(sockfd, rx_vec, PROBE_MSGS - received, MSG_WAITFORONE, NULL);
+            if (n < 1)
             {
-              perror("PeerTSClient: ERROR in sendto");
-              ok_flag = 0;
-              break;
+                if (DEBUG_FLAG)
+                    printf("PeerTSClient: ERROR in recvmmsg %d\n", n);
+                ok_flag = 0;
+                break;
             }
 
-            // n = get_tx_timestamp(sockfd, buf, strlen(buf), NULL, MSG_ERRQUEUE, &tx_timestamp, ts_flag, DEBUG_FLAG);
-            n = get_tx_timestamp(sockfd, buf, buflen, NULL, MSG_ERRQUEUE, &tx_timestamp, ts_flag, DEBUG_FLAG);
-            if (n < 0) 
+            for (int j = 0; j < n; j++)
             {
-              if (DEBUG_FLAG)
-                printf("PeerTSClient: ERROR getting tx packet timestamp\n");
-              ok_flag = 0;
-            }
+                char *buf_rx = rx_buf[j];
+                buf_rx[rx_vec[j].msg_len] = '\0';
 
-            /* print the server's reply */
-            bzero(buf, BUFSIZE);
-            bzero(cmsgbuf, BUFSIZE);
-            n = recvmsg(sockfd, &msg_vec.msg_hdr, 0);
-            if (n < 0)
-            {
-              if (DEBUG_FLAG)
-                printf("PeerTSClient: ERROR in recvmsg %d\n", n);
-              ok_flag = 0;
-              break;
-            }
-            else
-            {
-              /* Get Packet Timestamp */
-              n = get_rx_timestamp(&msg_vec.msg_hdr, 0, &rx_timestamp, ts_flag, DEBUG_FLAG);
-              if (n < 0) 
-              {
-                  printf("PeerTSClient: ERROR getting rx packet timestamp\n");
-                  ok_flag = 0;
-              }
-
-              // This needs to be changed, checks need to be added for PTP-like messages
-              if (!ptp_msgflag)
-              {
-                sscanf (buf, "%d", &recv_counter);
-                if (recv_counter != counter)
+                /* Remote timestamps are text, echoes of PTP-like probes are not */
+                int fields = 0;
+                if (!ptp_msgflag || (buf_rx[0] >= '0' && buf_rx[0] <= '9'))
+                    fields = sscanf(buf_rx, "%ld %ld %ld %ld %d %d", &rx_timestamp_remote.tv_sec, &rx_timestamp_remote.tv_nsec, &tx_timestamp_remote.tv_sec, &tx_timestamp_remote.tv_nsec, &remote_ok_flag, &recv_counter);
+
+                int idx = -1;
+                if (fields >= 5)
+                {
+                    /* Servers without the counter reply in probe order */
+                    if (fields == 5)
+                        idx = (remote_order < 2) ? remote_order++ : -1;
+                    else
+                        idx = (recv_counter == probe_ids[0]) ? 0 : ((recv_counter == probe_ids[1]) ? 1 : -1);
+                    if (idx < 0 || got_remote[idx])
+                        continue;
+
+                    got_remote[idx] = 1;
+                    received++;
+                    if (remote_ok_flag == 0)
+                    {
+                        if (DEBUG_FLAG)
+                            printf("PeerTSClient: ERROR in packet timestamping on server side\n");
+                        ok_flag = 0;
+                    }
+                    timestamps.rx_remote[idx] = rx_timestamp_remote.tv_sec*1000000000LL + rx_timestamp_remote.tv_nsec;
+                    timestamps.tx_remote[idx] = tx_timestamp_remote.tv_sec*1000000000LL + tx_timestamp_remote.tv_nsec;
+                }
+                else
                 {
-                  printf("PeerTSClient: Received Incorrect Packet ctr: %d, recv_ctr: %d\n", counter, recv_counter);
+                    /* Echo of a probe */
+                    if (ptp_msgflag)
+                    {
+                        uint16_t sequence_id;
+                        memcpy(&sequence_id, buf_rx + offsetof(struct ptp_header, sequenceId), sizeof(sequence_id));
+                        recv_counter = ntohs(sequence_id);
+                    }
+                    else
+                    {
+                        recv_counter = atoi(buf_rx);
+                    }
+                    idx = (recv_counter == probe_ids[0]) ? 0 : ((recv_counter == probe_ids[1]) ? 1 : -1);
+                    if (idx < 0 || got_echo[idx])
+                    {
+                        printf("PeerTSClient: Received Incorrect Packet ctr: %d, recv_ctr: %d\n", counter, recv_counter);
+                        continue;
+                    }
+
+                    got_echo[idx] = 1;
+                    received++;
+
+                    /* Get Packet Timestamp */
+                    if (get_rx_timestamp(&rx_vec[j].msg_hdr, 0, &rx_timestamp, ts_flag, DEBUG_FLAG) < 0) 
+                    {
+                        printf("PeerTSClient: ERROR getting rx packet timestamp\n");
+                        ok_flag = 0;
+                    }
+                    timestamps.rx[idx] = rx_timestamp.tv_sec*1000000000LL + rx_timestamp.tv_nsec;
                 }
-              }
             }
+        }
 
-            /* Receive remote timestamp data */
-            bzero(buf, BUFSIZE);
-            bzero(cmsgbuf, BUFSIZE);
-            n = recvmsg(sockfd, &msg, 0);
-            if (n < 0)
-            {
-              perror("PeerTSClient: ERROR in receiving remote timestamps");
-              ok_flag = 0;
-              break;
-            }
-            sscanf (buf, "%ld %ld %ld %ld %d", &rx_timestamp_remote.tv_sec, &rx_timestamp_remote.tv_nsec, &tx_timestamp_remote.tv_sec, &tx_timestamp_remote.tv_nsec, &remote_ok_flag);
-            
-            if (remote_ok_flag == 0)
+        /* The TX timestamps are queued by now, drain them in bulk */
+        int pending = (int)(tx_id - tx_id_base);
+        int next_probe = 0;
+        for (int attempt = 0; pending > 0 && attempt <= TX_TIMESTAMP_RETRIES; attempt++)
+        {
+            int cnt = get_tx_timestamps(sockfd, tx_entries, 2*PROBE_MSGS, ts_flag, attempt ? 1 : 0, DEBUG_FLAG);
+            for (int j = 0; j < cnt; j++)
             {
-                if (DEBUG_FLAG)
-                    printf("PeerTSClient: ERROR in packet timestamping on server side\n");
-                ok_flag = remote_ok_flag;
-                break;
+                int idx;
+                if (opt_id)
+                {
+                    uint32_t delta = tx_entries[j].id - tx_id_base;
+                    if (delta >= (uint32_t)(tx_id - tx_id_base))
+                        continue;
+                    idx = (int) delta;
+                }
+                else
+                {
+                    if (next_probe >= (int)(tx_id - tx_id_base))
+                        break;
+                    idx = next_probe++;
+                }
+                if (got_tx[idx])
+                    continue;
+                got_tx[idx] = 1;
+                timestamps.tx[idx] = tx_entries[j].ts.tv_sec*1000000000LL + tx_entries[j].ts.tv_nsec;
+                pending--;
             }
-
-            /* Extract the timestamps */
-            timestamps.rx[i] = rx_timestamp.tv_sec*1000000000LL + rx_timestamp.tv_nsec;
-            timestamps.tx[i] = tx_timestamp.tv_sec*1000000000LL + tx_timestamp.tv_nsec;
-            timestamps.rx_remote[i] = rx_timestamp_remote.tv_sec*1000000000LL + rx_timestamp_remote.tv_nsec;
-            timestamps.tx_remote[i] = tx_timestamp_remote.tv_sec*1000000000LL + tx_timestamp_remote.tv_nsec;
+        }
+        if (pending > 0)
+        {
+            if (DEBUG_FLAG)
+                printf("PeerTSClient: ERROR getting tx packet timestamp\n");
+            ok_flag = 0;
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            if (!got_echo[i] || !got_remote[i] || !got_tx[i])
+                ok_flag = 0;
         }
 
         if (DEBUG_FLAG)
@@ -553,33 +639,19 @@ int PeerTSclient::ts_client_loop()
             printf("PeerTSClient: Local  Timestamps: %lld %lld\n", timestamps.rx[0], timestamps.tx[0]);
         }
 
-        if (DEBUG_FLAG)
-        {
-            outfile << timestamps.rx[0] << "," << timestamps.tx[0] << "," << timestamps.rx_remote[0] << "," << timestamps.tx_remote[0] << "\n";
-            outfile << timestamps.rx[1] << "," << timestamps.tx[1] << "," << timestamps.rx_remote[1] << "," << timestamps.tx_remote[1] << "\n";
-        }
+        trace_probe_pair(0, ok_flag, timestamps.tx[0], timestamps.rx[0], timestamps.rx_remote[0], timestamps.tx_remote[0], timestamps.tx[1], timestamps.rx_remote[1]);
 
         /* Calculate Round-Trip Time and Offset */
         rtt_peerdelay_ns = (timestamps.rx[0] - timestamps.tx[0]) - (timestamps.tx_remote[0] - timestamps.rx_remote[0]);
         offset_ns = ((timestamps.rx_remote[0] - timestamps.tx[0]) + (timestamps.tx_remote[0] - timestamps.rx[0]))/2;
         peer_offset_up = timestamps.rx_remote[0] - timestamps.tx[0];
         peer_offset_low = timestamps.tx_remote[0] - timestamps.rx[0];
+        if (ok_flag && rtt_peerdelay_ns > 0)
+            metrics_record(rtt_metric, uint64_t(rtt_peerdelay_ns));
 
-        /* Enter the value into the buffer */
+        /* Hand the probe to the processor, never blocks (overflows are counted by the ring) */
         timestamps.validity_flag = ok_flag;
-        ts_buffer[buffer_counter] = timestamps;
-        buffer_counter = (buffer_counter + 1) % ts_buf_len;
-
-        /* Copy data from buffer */
-        if (buffer_counter == ts_buf_len - 1)
-        {
-            pthread_mutex_lock(&data_lock);
-            memcpy((void*) proc_ts_buffer, (void*) ts_buffer, ts_buf_len*sizeof(probe_timestamps));
-            
-            // Signal the processing thread that a new batch has been added
-            pthread_cond_signal(&data_condvar);
-            pthread_mutex_unlock(&data_lock);
-        }
+        probe_ring->Push(timestamps);
 
         if (debug_flag)
         {
@@ -588,8 +660,8 @@ int PeerTSclient::ts_client_loop()
         }
     }
 
+    if (ptp_probe[1])
+        msg_put(ptp_probe[1]);
     std::cout << "PeerTSclient: Timestamping loop thread exiting\n";
-
-    outfile.close();
     return 0;
 }
@@ -46,9 +46,12 @@ extern "C"
 #include <boost/thread.hpp> 
 #include <boost/log/trivial.hpp>
 
-#ifdef NATS_SERVICE
-// NATS client header
-#include <nats/nats.h>
+#include "SVMprocessor.hpp"
+#include "SPSCRing.hpp"
+
+#ifdef PUBSUB_SERVICE
+// Publish/subscribe transport
+#include "../../qot_pubsub.hpp"
 #endif 
 
 /* Coded Probes Struct */
@@ -99,25 +102,20 @@ namespace qot
 		private: int sockfd;                              // Socket fd
 		private: struct hostent *server;	              // Server data structure
 	    private: uint64_t tx_period_ns;                   // Transmission Period 
-		private: struct probe_timestamps *ts_buffer;	  // Buffer to hold timestamp
-		private: struct probe_timestamps *proc_ts_buffer; // Swap buffer to hold past timestamps
+		private: SPSCRing<probe_timestamps> *probe_ring;  // Lock-free hand-off of probes to the processor
 		private: uint64_t ts_duration_ns;				  // Duration over which to process timestamps
-		private: uint64_t ts_buf_len;					  // Buffer length
-		private: pthread_mutex_t data_lock;				  // Mutex to protect buffers
-		private: pthread_cond_t data_condvar;             // Condition Variable to indicate new batch
+		private: uint64_t ts_buf_len;					  // Number of probes in the processing window
 		private: bool error_flag;						  // Error flag to restart the sync
 		private: bool ptp_msgflag;						  // Flag indicating messages are PTP-like
+		private: SVMprocessor svm_processor;			  // Offset/drift estimator, warm-started across batches
+		private: int rtt_metric;						  // Probe round-trip time histogram
 
-		#ifdef NATS_SERVICE
-		// Connect to the NATS Server
-		private: int natsConnect(const char* nats_url);
-		// Return if the nats connection succeeded or not
-		private: int getNatsStatus();
+		#ifdef PUBSUB_SERVICE
+		// Connect to the publish/subscribe server
+		private: int pubsubConnect(const char* pubsub_url);
 
-		// NATS messaging variables
-		private: natsConnection      *conn;
-	    private: natsMsg             *msg;
-	    private: natsStatus          s;
+		// Publish/subscribe transport
+		private: PubSubTransport     *transport;
 		#endif
 
 		// Publishing Server
@@ -26,10 +26,10 @@
  *
  */
 #include <iostream>
-#include <fstream>
 #include <cmath>
 #include <vector>
 #include <iomanip>
+#include <functional>
 
 #include "PeerTSreceiver.hpp"
 
@@ -41,20 +41,22 @@ extern "C"
   #include "../ptp/linuxptp-1.8/config.h"
 }
 
-// Add header to Modern JSON C++ Library
-#include "../../../../../thirdparty/json-modern-cpp/json.hpp"
+// Parameter message serialization (JSON or binary)
+#include "../../qot_clkparams_serialize.hpp"
+
+// Runtime metrics
+#include "../../qot_metrics.hpp"
+
+// Binary sync trace
+#include "../../qot_trace.hpp"
 
 using namespace qot;
 
 #define DEBUG_FLAG 0
-#define LOGGING_FLAG 1
 
 // Global Variable for node name
 std::string global_node_name;
 
-// Global Log File
-std::ofstream logfile;
-
 #ifdef PEER_SERVICE
 // Variable defined to make linking against ptp library compatible
 int assume_two_step = 0;
@@ -69,14 +71,11 @@ int set_counter = 0;
 // Global variable indicating if the clock should be disciplined
 bool global_disc_flag = false;
 
-#ifdef NATS_SERVICE
+#ifdef PUBSUB_SERVICE
 
-/* NATS Subscription handler*/
-void offset_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+/* Subscription handler*/
+static void offset_handler(const std::string &subject, const std::string &msg, struct data_ptrs *ptr_data)
 {
-    // Get the data pointer (typecast it)
-    struct data_ptrs *ptr_data = (struct data_ptrs *) closure;
-
     // Get the required pointer for the param buffer
     CircBuffer *param_buffer = ptr_data->param_buffer;//(CircBuffer*) closure;
 
@@ -86,28 +85,34 @@ void offset_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, voi
     // Variable to hold the parameters
     peer_clk_params_t params;
 
+    static MetricsStream sample_metrics("qot_sync_samples", "alg=\"huygens\"", "synchronization samples taken in by the uncertainty service");
+
     if (DEBUG_FLAG)
     {
-        printf("Received msg: %s - %.*s\n",
-               natsMsg_GetSubject(msg),
-               natsMsg_GetDataLength(msg),
-               natsMsg_GetData(msg));
+        printf("Received msg: %s - %s\n", subject.c_str(), msg.c_str());
     }
 
-    /* De-serialize data */
-    nlohmann::json data = nlohmann::json::parse(std::string(natsMsg_GetData(msg)));
+    /* De-serialize data (JSON or binary) */
+    std::vector<peer_offset_msg> offsets;
+    if (decode_peer_offsets(msg, offsets) < 0)
+    {
+        std::cout << "PeerTSreceiver: Malformed offset message\n";
+        return;
+    }
 
-    // Unroll the JSON
-    for (auto it = data.begin(); it != data.end(); ++it)
+    // Find the entry of this node
+    for (size_t i = 0; i < offsets.size(); i++)
     {
-        if (it.key().compare(global_node_name) == 0)
+        if (offsets[i].node.compare(global_node_name) == 0)
         {
-            params.timestamp = uint64_t(data[it.key()]["final time"].get<double>()*1000000000ULL);
-            params.offset_ns = int64_t(data[it.key()]["offset"].get<double>()*1000000000LL);
+            params.timestamp = uint64_t(offsets[i].final_time*1000000000ULL);
+            params.offset_ns = int64_t(offsets[i].offset*1000000000LL);
+            sample_metrics.Tick();
+            trace_sync_sample(0, params.offset_ns, 0, params.timestamp, QOT_TRACE_ALG_HUYGENS);
 
             if (DEBUG_FLAG)
             {
-              std::cout << "Node " << it.key() << "\n";
+              std::cout << "Node " << offsets[i].node << "\n";
               std::cout << "final time is :" << params.timestamp << " ns\n";
               std::cout << "offset is     :" << params.offset_ns << " ns\n";
             }
@@ -115,14 +120,9 @@ void offset_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, voi
             {
               std::cout << "PeerTSreceiver: Stepping the clock\n";
               clockadj_step(global_clkid, -params.offset_ns);
+              trace_step(0, -params.offset_ns, 0, QOT_TRACE_ALG_HUYGENS);
             }
             set_counter = (set_counter + 1) % 10;
-
-            if (LOGGING_FLAG == 1 && ptr_data->clk_params)
-                logfile << params.timestamp << "," << params.offset_ns << "," << ptr_data->clk_params->u_nsec << "," << ptr_data->clk_params->u_mult  << "\n";
-            else if (LOGGING_FLAG == 1)
-                logfile << params.timestamp << "," << params.offset_ns << ",0,0"  << "\n";
-
         }
     }
 
@@ -140,38 +140,13 @@ void offset_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, voi
     // Set the synchronization uncertainty
     if (sync_uncertainty && param_buffer && params.offset_ns != 0)
         sync_uncertainty->CalculateBounds(params.offset_ns, param_buffer->GetLatestDrift(), -1, ptr_data->clk_params, std::string("local"));
-
-    // Need to destroy the message!
-    natsMsg_Destroy(msg);
-
-}
-
-// Get the NATS connection status
-int PeerTSreceiver::getNatsStatus()
-{
-    return (int)s;
-}
-
-// Connect to the NATS server
-natsStatus PeerTSreceiver::natsConnect(const char* nats_url)
-{
-    s = natsConnection_ConnectTo(&conn, nats_url);
-    if (s == NATS_OK)
-    {
-        std::cout << "Connected to NATS service\n";
-    }
-    else
-    {
-        std::cout << "Error Connecting to NATS service\n";
-    }
-    return s;
 }
 
-/* Subscribe to a NATS topic (subject) */
-int PeerTSreceiver::natsSubscribe(std::string &topic)
+/* Subscribe to a topic (subject) */
+int PeerTSreceiver::pubsubSubscribe(std::string &topic)
 {
     if (DEBUG_FLAG)
-        printf("Subscribing to NATS subject %s\n", topic.c_str());
+        printf("Subscribing to subject %s\n", topic.c_str());
 
     // Create a new circular buffer
     try
@@ -187,47 +162,43 @@ int PeerTSreceiver::natsSubscribe(std::string &topic)
     
 
     // Try to subscribe if the connection was succesful
-    s = natsConnect(nats_server.c_str());
-    if (s == NATS_OK)
+    transport = pubsub_connect(nats_server);
+    if (transport == NULL)
     {
-        if (DEBUG_FLAG)
-            printf("Connected to NATS server\n");
-
-        // Creates an asynchronous subscription on subject "foo".
-        // When a message is sent on subject "foo", the callback
-        // onMsg() will be invoked by the client library.
-        // You can pass a closure as the last argument.
-        s = natsConnection_Subscribe(&sub, conn, topic.c_str(), offset_handler, (void*) &data);
+        std::cout << "Error Connecting to pub-sub service\n";
+        return -1;
     }
+    if (DEBUG_FLAG)
+        printf("Connected to pub-sub server\n");
 
-    // If there was an error, print a stack trace and exit
-    if (s != NATS_OK)
+    // The handler runs on a transport thread with the data pointers as its closure
+    sub_id = transport->Subscribe(topic, std::bind(offset_handler, std::placeholders::_1, std::placeholders::_2, &data));
+    if (sub_id < 0)
     {
-        nats_PrintLastErrorStack(stderr);
-        return (int)s;
-    }
-    else
-    {
-        if (DEBUG_FLAG)
-            printf("Succesfully subscribed to timeline clock parameter topic\n");
+        printf("Failed to subscribe to subject %s\n", topic.c_str());
+        return -1;
     }
+    if (DEBUG_FLAG)
+        printf("Succesfully subscribed to timeline clock parameter topic\n");
 
     return 0;
 }
 
-/* Un-subscribe to a NATS topic (subject) */
-int PeerTSreceiver::natsUnSubscribe()
+/* Un-subscribe from the topic (subject) */
+int PeerTSreceiver::pubsubUnSubscribe()
 {
     // Anything that is created need to be destroyed
-    if (s == NATS_OK)
+    if (transport != NULL)
     {
-      natsSubscription_Destroy(sub);
-      natsConnection_Destroy(conn);
-      delete param_buffer;
+      if (sub_id >= 0)
+        transport->Unsubscribe(sub_id);
+      delete transport;
     }
+    delete param_buffer;
+    data.param_buffer = NULL;
     param_buffer = NULL;
-    conn = NULL;
-    sub  = NULL;
+    transport = NULL;
+    sub_id = -1;
     return 0;
 }
 #endif
@@ -284,17 +255,10 @@ PeerTSreceiver::PeerTSreceiver(const std::string &node_name, const std::string &
         sync_uncertainty = NULL;
     }
 
-    if (LOGGING_FLAG == 1)
-    {
-      std::string logfile_name = "/opt/qot-stack/doc/data/peerlog.csv";
-      logfile.open(logfile_name);
-    }
-
-    #ifdef NATS_SERVICE
-    // Initialize NATS Parameters
-    conn = NULL;
-    sub  = NULL;
-    s = NATS_ERR;
+    #ifdef PUBSUB_SERVICE
+    // Initialize Pub-Sub Parameters
+    transport = NULL;
+    sub_id = -1;
 
     #endif
 }
@@ -302,9 +266,6 @@ PeerTSreceiver::PeerTSreceiver(const std::string &node_name, const std::string &
 // Destructor
 PeerTSreceiver::~PeerTSreceiver()
 {
-    if (LOGGING_FLAG == 1)
-      logfile.close();
-
     if (sync_uncertainty)
       delete sync_uncertainty;
 }
@@ -374,10 +335,10 @@ int PeerTSreceiver::Start(uint64_t period_ns)
     }
   // }
 
-  #ifdef NATS_SERVICE
-  // Connect to NATS Service
-  std::cout << "PeerTSreceiver: Connecting to NATS server on " << nats_server << "\n";
-  retval = natsSubscribe(topic);
+  #ifdef PUBSUB_SERVICE
+  // Connect to the pub-sub service
+  std::cout << "PeerTSreceiver: Connecting to pub-sub server on " << nats_server << "\n";
+  retval = pubsubSubscribe(topic);
   #endif
 
   return retval;
@@ -385,10 +346,10 @@ int PeerTSreceiver::Start(uint64_t period_ns)
 
 int PeerTSreceiver::Stop()
 {
-  #ifdef NATS_SERVICE
-  // Destroy the NATS connection
-  std::cout << "PeerTSreceiver: Unsubscribing and destroying nats connection\n";
-  natsUnSubscribe();
+  #ifdef PUBSUB_SERVICE
+  // Destroy the pub-sub connection
+  std::cout << "PeerTSreceiver: Unsubscribing and destroying pub-sub connection\n";
+  pubsubUnSubscribe();
   #endif
   return 0;
 }
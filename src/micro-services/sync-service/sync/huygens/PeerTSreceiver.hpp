@@ -39,9 +39,9 @@ extern "C"
 	#include "../../../../qot_types.h"
 }
 
-#ifdef NATS_SERVICE
-// NATS client header
-#include <nats/nats.h>
+#ifdef PUBSUB_SERVICE
+// Publish/subscribe transport
+#include "../../qot_pubsub.hpp"
 #endif 
 
 #include "CircBuffer.hpp"
@@ -82,21 +82,15 @@ namespace qot
 		private: std::string iface;						  // Name of the interface
 		private: bool disc_flag;						  // Flag indicating if the PHC should be disciplined
 
-		#ifdef NATS_SERVICE
-		// Connect to the NATS Server
-		private: natsStatus natsConnect(const char* nats_url);
-		// Return if the nats connection succeeded or not
-		private: int getNatsStatus();
-		// Subscribe to a NATS topic (subject)
-		private: int natsSubscribe(std::string &topic);
-		// Un-subscribe from a NATS topic (subject) 
-		private: int natsUnSubscribe();
+		#ifdef PUBSUB_SERVICE
+		// Subscribe to a topic (subject)
+		private: int pubsubSubscribe(std::string &topic);
+		// Un-subscribe from the topic (subject) 
+		private: int pubsubUnSubscribe();
 	
-		// NATS messaging variables
-		private: natsConnection      *conn;
-	    private: natsSubscription    *sub;
-	    private: natsStatus          s;
-	    private: volatile bool       done;
+		// Publish/subscribe transport
+		private: PubSubTransport     *transport;
+	    private: int                 sub_id;
 		#endif
 
 		// Sync Uncertainty Calculator 
@@ -49,6 +49,9 @@ extern "C"
   #include <poll.h>
 }
 
+#include <iostream>
+#include <vector>
+
 #include "PeerTSserver.hpp"
 #include "Timestamping.hpp"
 
@@ -57,6 +60,9 @@ extern "C"
 
 #define BUFSIZE 1024
 
+// Number of 1 ms waits for TX timestamps missing from a batch
+#define TX_TIMESTAMP_RETRIES 2
+
 using namespace qot;
 
 #define DEBUG_FLAG 0
@@ -199,27 +205,27 @@ bool PeerTSserver::GetErrorStatus()
   return error_flag;
 }
 
+/* State of a probe within a batch */
+struct probe_slot {
+  char buf[BUFSIZE];              /* probe payload, echoed back */
+  char reply[BUFSIZE];            /* timestamp reply */
+  char cmsgbuf[BUFSIZE];          /* ancillary info buf */
+  struct ptp_message *ptp_msg;    /* PTP-like message buffer */
+  struct sockaddr_in clientaddr;  /* client addr */
+  struct timespec rx_timestamp;
+  struct timespec tx_timestamp;
+  int probe_id;                   /* probe counter set by the client */
+  int ok_flag;
+  int tx_found;
+};
+
 // Function to start a server which recevies packets from other clients
 int PeerTSserver::ts_server_loop()
 {
-  socklen_t clientlen; /* byte size of client's address */
   struct sockaddr_in serveraddr; /* server's addr */
-  struct sockaddr_in clientaddr; /* client addr */
-  struct sockaddr_in clientaddr_ucast; /* client addr */
-
-  struct hostent *hostp; /* client host info */
-  char buf[BUFSIZE]; /* message buf */
-  char clientname[100];
-  struct ptp_message *ptp_msg = msg_allocate(); /* PTP-like message buffer */
   struct in_addr mcast_addr; /* Multi-cast Address */
-
-  char *hostaddrp; /* dotted decimal host addr string */
-  int n; /* message byte size */
-  char cmsgbuf[BUFSIZE]; /* ancillary info buf */
-  struct ip_mreq mreq; /* multicast recv request */
-  struct timespec pkt_timestamp; /* packet timestamp */
-  struct timespec tx_timestamp, rx_timestamp;
-  int ok_flag = 1;
+  char clientname[100];
+  int n, sent, replied; /* message counts */
 
   /*
    * build the server's Internet address
@@ -240,145 +246,197 @@ int PeerTSserver::ts_server_loop()
 		return -1;
 	}
   }
- 
-  /* Setup message header */
-  clientlen = sizeof(clientaddr);
-  struct msghdr msg;
-  struct iovec iov[1];
-  if (ptp_msgflag)
-  {
-	iov[0].iov_base=ptp_msg;
-	iov[0].iov_len=sizeof(ptp_msg->data);
-	// This is the multicast address to which we send -> initially
-	if (!inet_aton(node_uuid.c_str(), &mcast_addr))
-	  return -1;
-  }
-  else
+
+  // This is the multicast address to which we send
+  if (ptp_msgflag && !inet_aton(node_uuid.c_str(), &mcast_addr))
+	return -1;
+
+  /* Setup the batch of message headers, one thread serves all the peers */
+  std::vector<probe_slot> slots(TS_BATCH_SIZE);
+  struct mmsghdr rx_vec[TS_BATCH_SIZE], tx_vec[TS_BATCH_SIZE];
+  struct iovec rx_iov[TS_BATCH_SIZE], tx_iov[TS_BATCH_SIZE];
+  struct tx_timestamp tx_entries[2*TS_BATCH_SIZE];
+  for (int i = 0; i < TS_BATCH_SIZE; i++)
   {
-	iov[0].iov_base=buf;
-	iov[0].iov_len=sizeof(buf);
+	slots[i].ptp_msg = ptp_msgflag ? msg_allocate() : NULL;
+	if (ptp_msgflag)
+	{
+	  rx_iov[i].iov_base = slots[i].ptp_msg;
+	  rx_iov[i].iov_len = sizeof(slots[i].ptp_msg->data);
+	}
+	else
+	{
+	  rx_iov[i].iov_base = slots[i].buf;
+	  rx_iov[i].iov_len = BUFSIZE - 2;
+	}
   }
 
-  msg.msg_name=&clientaddr;
-  msg.msg_namelen=sizeof(clientaddr);
-  msg.msg_iov=iov;
-  msg.msg_iovlen=1;
-  msg.msg_control=(caddr_t)cmsgbuf;
-  msg.msg_controllen=sizeof(cmsgbuf);
+  /* TX timestamps are matched to packets with the socket's OPT_ID counter */
+  int opt_id = tstamp_opt_id_enabled(sockfd);
+  uint32_t tx_id = 0; /* counter of the next sent packet */
+
   /* 
-   * main loop: wait for a datagram, then echo it
+   * main loop: wait for a batch of datagrams, then echo them
    */
   while (running) {
-	/*
-	 * recvfrom: receive a UDP datagram from a client
-	 */
-	ok_flag = 1;
-	bzero(buf, BUFSIZE);
-	bzero(cmsgbuf, BUFSIZE);
-	if (ptp_msgflag)
+	memset(rx_vec, 0, sizeof(rx_vec));
+	for (int i = 0; i < TS_BATCH_SIZE; i++)
 	{
-	  memset(ptp_msg, 0, sizeof(ptp_msg->data));
-	  clientaddr.sin_addr = mcast_addr;
-	  clientaddr.sin_port = htons((unsigned short)portno);
+	  rx_vec[i].msg_hdr.msg_name = &slots[i].clientaddr;
+	  rx_vec[i].msg_hdr.msg_namelen = sizeof(slots[i].clientaddr);
+	  rx_vec[i].msg_hdr.msg_iov = &rx_iov[i];
+	  rx_vec[i].msg_hdr.msg_iovlen = 1;
+	  rx_vec[i].msg_hdr.msg_control = (caddr_t)slots[i].cmsgbuf;
+	  rx_vec[i].msg_hdr.msg_controllen = sizeof(slots[i].cmsgbuf);
 	}
 
-	n = recvmsg(sockfd, &msg, 0);
-	if (n < 0)
+	/*
+	 * recvmmsg: block for the first datagram, then take whatever else is queued
+	 */
+	n = recvmmsg(sockfd, rx_vec, TS_BATCH_SIZE, MSG_WAITFORONE, NULL);
+	if (n < 1)
 	{
 	  if (DEBUG_FLAG)
-		  printf("PeerTSserver: ERROR in recvmsg %d\n", n);
+		  printf("PeerTSserver: ERROR in recvmmsg %d\n", n);
 	  continue;
 	}
-	if (DEBUG_FLAG)
-	   printf("PeerTSserver: Received message from client %s\n", inet_ntop(AF_INET, &clientaddr.sin_addr, clientname, sizeof(clientname)));
-	// Implement packet filtering
-	// if (ptp_msgflag)
-	// {
-	// 	// Check if the sent IP address exists in the exclusion set
-	// 	if (exclusion_set.find(std::string(inet_ntop(AF_INET, &clientaddr.sin_addr, clientname, sizeof(clientname)))) != exclusion_set.end())
-	// 		continue;
-	// }
-
-	 /* 
-	  * gethostbyaddr: determine who sent the datagram
-	  */
-	if (DEBUG_FLAG)
-	   printf("PeerTSserver: server received %d/%d bytes: %s\n", strlen(buf), n, buf);
-	
-	/* Get Packet Timestamp */
-	n = get_rx_timestamp(&msg, offset, &rx_timestamp, ts_flag, DEBUG_FLAG);
-	if (n < 0) 
+
+	/* Get the packet timestamps and prepare the echoes */
+	memset(tx_vec, 0, n*sizeof(struct mmsghdr));
+	for (int i = 0; i < n; i++)
 	{
+	  probe_slot &slot = slots[i];
+	  slot.ok_flag = 1;
+	  slot.tx_found = 0;
 	  if (DEBUG_FLAG)
+		printf("PeerTSserver: Received message from client %s\n", inet_ntop(AF_INET, &slot.clientaddr.sin_addr, clientname, sizeof(clientname)));
+
+	  if (get_rx_timestamp(&rx_vec[i].msg_hdr, offset, &slot.rx_timestamp, ts_flag, DEBUG_FLAG) < 0)
+	  {
+		if (DEBUG_FLAG)
 		  error("PeerTSserver: ERROR in getting rx timestamp");
-	  ok_flag = 0;
+		slot.ok_flag = 0;
+	  }
+
+	  if (ptp_msgflag)
+	  {
+		slot.probe_id = ntohs(slot.ptp_msg->header.sequenceId);
+		slot.clientaddr.sin_addr = mcast_addr;
+		slot.clientaddr.sin_port = htons((unsigned short)portno);
+		tx_iov[i].iov_base = slot.ptp_msg;
+		tx_iov[i].iov_len = sizeof(slot.ptp_msg->data);
+	  }
+	  else
+	  {
+		slot.buf[rx_vec[i].msg_len] = '\0';
+		slot.buf[rx_vec[i].msg_len + 1] = '\0';
+		slot.probe_id = atoi(slot.buf);
+		tx_iov[i].iov_base = slot.buf;
+		tx_iov[i].iov_len = strlen(slot.buf) + 2;
+		if (DEBUG_FLAG)
+		  printf("PeerTSserver: server received %d/%d bytes: %s\n", (int)strlen(slot.buf), rx_vec[i].msg_len, slot.buf);
+	  }
+	  tx_vec[i].msg_hdr.msg_name = &slot.clientaddr;
+	  tx_vec[i].msg_hdr.msg_namelen = sizeof(slot.clientaddr);
+	  tx_vec[i].msg_hdr.msg_iov = &tx_iov[i];
+	  tx_vec[i].msg_hdr.msg_iovlen = 1;
 	}
-	
+
 	/* 
-	 * sendto: echo the input back to the client 
+	 * sendmmsg: echo the batch back to the clients 
 	 */
-	if (ptp_msgflag)
+	sent = sendmmsg(sockfd, tx_vec, n, 0);
+	if (sent < 0)
 	{
-	  clientaddr_ucast = clientaddr;
-	  clientaddr.sin_addr = mcast_addr;
-	  clientaddr.sin_port = htons((unsigned short)portno);
-	  n = sendto(sockfd, ptp_msg, sizeof(ptp_msg->data), 0, 
-		 (struct sockaddr *) &clientaddr, clientlen);
-	  if (n < 0) 
-		  error("PeerTSserver: ERROR in sendto 1");
+	  error("PeerTSserver: ERROR in sendmmsg 1");
+	  sent = 0;
 	}
-	else
+
+	/* Drain the TX timestamps of the echoes in bulk, waiting only if some are missing */
+	int pending = sent;
+	int next_slot = 0;
+	for (int attempt = 0; pending > 0 && attempt <= TX_TIMESTAMP_RETRIES; attempt++)
 	{
-		n = sendto(sockfd, buf, strlen(buf)+2, 0, 
-			 (struct sockaddr *) &clientaddr, clientlen);
-		if (n < 0) 
-		  error("PeerTSserver: ERROR in sendto 1");
+	  int cnt = get_tx_timestamps(sockfd, tx_entries, 2*TS_BATCH_SIZE, ts_flag, attempt ? 1 : 0, DEBUG_FLAG);
+	  for (int j = 0; j < cnt; j++)
+	  {
+		int idx;
+		if (opt_id)
+		{
+		  // Stale timestamps (e.g. of the previous replies) fall outside the batch
+		  uint32_t delta = tx_entries[j].id - tx_id;
+		  if (delta >= (uint32_t) sent)
+			continue;
+		  idx = (int) delta;
+		}
+		else
+		{
+		  if (next_slot >= sent)
+			break;
+		  idx = next_slot++;
+		}
+		if (slots[idx].tx_found)
+		  continue;
+		slots[idx].tx_timestamp = tx_entries[j].ts;
+		slots[idx].tx_found = 1;
+		pending--;
+	  }
 	}
+	tx_id += sent;
 
-	n = get_tx_timestamp(sockfd, buf, strlen(buf), NULL, MSG_ERRQUEUE, &tx_timestamp, ts_flag, DEBUG_FLAG);
-	if (n < 0) 
+	/*
+	 * send the timestamps to the clients, tagged with the probe counter
+	 */
+	for (int i = 0; i < sent; i++)
 	{
-	  if (DEBUG_FLAG)
+	  probe_slot &slot = slots[i];
+	  if (!slot.tx_found)
+	  {
+		if (DEBUG_FLAG)
 		  error("PeerTSserver: ERROR in getting tx timestamp 1");
-	  ok_flag = 0;
-	  error_count++;
+		slot.ok_flag = 0;
+		memset(&slot.tx_timestamp, 0, sizeof(slot.tx_timestamp));
+		error_count++;
+	  }
+	  else if (error_count > 0)
+	  {
+		error_count--;
+	  }
+	  sprintf(slot.reply, "%ld %ld %ld %ld %d %d\n", (long)slot.rx_timestamp.tv_sec, (long)slot.rx_timestamp.tv_nsec, (long)slot.tx_timestamp.tv_sec, (long)slot.tx_timestamp.tv_nsec, slot.ok_flag, slot.probe_id);
+	  tx_iov[i].iov_base = slot.reply;
+	  tx_iov[i].iov_len = strlen(slot.reply);
 	}
-	else
+
+	replied = (sent > 0) ? sendmmsg(sockfd, tx_vec, sent, 0) : 0;
+	if (replied < 0)
 	{
-	  if (error_count > 0)
-		 error_count--;
+	  error("PeerTSserver: ERROR in sendmmsg 2");
+	  replied = 0;
 	}
+	tx_id += replied;
 
-	/*
-	 * send the timestamps to the client 
-	 */
-	bzero(buf, BUFSIZE);
-	sprintf(buf, "%ld %ld %ld %ld %d\n", (long)rx_timestamp.tv_sec, (long)rx_timestamp.tv_nsec, (long)tx_timestamp.tv_sec, (long)tx_timestamp.tv_nsec, ok_flag);
-	// if (ptp_msgflag)
-	// {
-	// 	clientaddr = clientaddr_ucast;
-	// 	clientaddr.sin_port = htons((unsigned short)portno);
-	// }
-	n = sendto(sockfd, buf, strlen(buf), 0, 
-	(struct sockaddr *) &clientaddr, clientlen);
-	if (n < 0) 
-		error("PeerTSserver: ERROR in sendto 2");
-
-	// if (!ptp_msgflag)
-	// {
-	  n = get_tx_timestamp(sockfd, buf, strlen(buf), NULL, MSG_ERRQUEUE, &pkt_timestamp, ts_flag, DEBUG_FLAG);
-	  //if (n < 0) 
-	  //{
-	  //  error("PeerTSServer: ERROR in getting tx timestamp 2");
-	  //  printf("%s\n", buf);
-	  //}
-	// }
+	/* Without packet counters the reply timestamps must be consumed in order */
+	if (!opt_id && replied > 0)
+	  get_tx_timestamps(sockfd, tx_entries, replied, ts_flag, 1, DEBUG_FLAG);
+
+	/* Clear the PTP-like buffers which were used */
+	if (ptp_msgflag)
+	{
+	  for (int i = 0; i < n; i++)
+		memset(slots[i].ptp_msg, 0, sizeof(slots[i].ptp_msg->data));
+	}
 
 	// Check error count and set error flag
 	if (error_count > 5)
 	  error_flag = 1;
 
   }
+
+  for (int i = 0; i < TS_BATCH_SIZE; i++)
+  {
+	if (slots[i].ptp_msg)
+	  msg_put(slots[i].ptp_msg);
+  }
   printf("PeerTSserver: Timestamping thread exiting\n");
   return 0;
 }
@@ -0,0 +1,140 @@
+/*
+ * @file SPSCRing.hpp
+ * @brief Bounded lock-free single-producer/single-consumer ring
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_SPSC_RING_HPP
+#define QOT_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Cache line size used to keep the producer and consumer indices apart
+#define QOT_CACHELINE_SIZE 64
+
+namespace qot
+{
+	/* Bounded ring between exactly one producer thread and one consumer thread.
+	   The producer never blocks, records which do not fit are counted and dropped */
+	template <typename T>
+	class SPSCRing
+	{
+		// Constructor (the capacity is rounded up to a power of two)
+		public: SPSCRing(size_t min_capacity)
+		  : head(0), tail_cache(0), overflows(0), tail(0), head_cache(0)
+		{
+			capacity = 1;
+			while (capacity < min_capacity)
+				capacity <<= 1;
+			mask = capacity - 1;
+			slots.resize(capacity);
+		}
+
+		// Keep the indices on their own cache lines when allocated on the heap
+		public: static void *operator new(size_t size)
+		{
+			void *ptr = NULL;
+			if (posix_memalign(&ptr, QOT_CACHELINE_SIZE, size) != 0)
+				throw std::bad_alloc();
+			return ptr;
+		}
+		public: static void operator delete(void *ptr)
+		{
+			free(ptr);
+		}
+
+		/* Producer: append a record, returns false (and counts an overflow) if the ring is full */
+		public: bool Push(const T &record)
+		{
+			size_t pos = head.load(std::memory_order_relaxed);
+			if (pos - tail_cache >= capacity)
+			{
+				tail_cache = tail.load(std::memory_order_acquire);
+				if (pos - tail_cache >= capacity)
+				{
+					overflows.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+			}
+			slots[pos & mask] = record;
+			head.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* Consumer: remove up to max_records in FIFO order, returns the number removed */
+		public: size_t PopBatch(T *records, size_t max_records)
+		{
+			size_t pos = tail.load(std::memory_order_relaxed);
+			if (head_cache - pos < max_records)
+				head_cache = head.load(std::memory_order_acquire);
+			size_t count = head_cache - pos;
+			if (count > max_records)
+				count = max_records;
+			for (size_t i = 0; i < count; i++)
+				records[i] = slots[(pos + i) & mask];
+			tail.store(pos + count, std::memory_order_release);
+			return count;
+		}
+
+		/* Number of records waiting (approximate while the other side is active) */
+		public: size_t Size() const
+		{
+			return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+		}
+
+		/* Number of records dropped because the ring was full */
+		public: uint64_t GetOverflows() const
+		{
+			return overflows.load(std::memory_order_relaxed);
+		}
+
+		public: size_t GetCapacity() const
+		{
+			return capacity;
+		}
+
+		// Producer cache line
+		private: alignas(QOT_CACHELINE_SIZE) std::atomic<size_t> head;
+		private: size_t tail_cache;                   // Last tail seen by the producer
+		private: std::atomic<uint64_t> overflows;
+
+		// Consumer cache line
+		private: alignas(QOT_CACHELINE_SIZE) std::atomic<size_t> tail;
+		private: size_t head_cache;                   // Last head seen by the consumer
+
+		// Read-only after construction
+		private: alignas(QOT_CACHELINE_SIZE) size_t capacity;
+		private: size_t mask;
+		private: std::vector<T> slots;
+	};
+}
+
+#endif
@@ -26,120 +26,26 @@
  *
  */
 #include <vector>
-#include <fstream>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 #include <iostream>
 #include "SVMprocessor.hpp"
 
 extern "C" 
 {
 	#include <stdio.h>
-	#include <stdlib.h>
-	#include <string.h>
-	#include <ctype.h>
-	#include <errno.h>
-	#include "libsvm/svm.h"
 }
-#define DEBUG_FLAG 0
-#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
-
-void print_null(const char *s) {}
-
-
-// Global Variables
-struct svm_parameter param;		// set by parse_command_line
-struct svm_problem prob;		// set by read_problem
-struct svm_model *model;
-
-// Data scaling parameters
-int64_t peer_offset_bounds_mean, instant_mean;
-double peer_offset_bounds_sd, instant_sd;
-
-// Private function to compute the primal (hyperplane equation)
-int compute_primal(struct svm_model *model, std::vector<double> &primal, double &b)
-{
-	const double * const *sv_coef = model->sv_coef;	// Suppoet vector coefficients
-	const svm_node * const *SV = model->SV;			// Support vectors
-	int nr_class = model->nr_class; 				// number of classes
-	int l = model->l; 								// number of support vectors
-
-	// Primal Initialization
-	for (int j = 0; j < primal.size(); j++)
-	{
-		primal[j] = 0;
-	}
-		
-	for (int j = 0; j < primal.size(); j++)
-	{
-		for(int i = 0; i<l; i++)
-		{
-			primal[j] += SV[i][j].value*sv_coef[0][i];
-		}
-	}
-	b = -model->rho[0];
-
-	return 0;	
-}
-
-// Function which runs the SVM on the data -> the problem should be formulated before this step
-int run_svm(double &offset, double &drift)
-{
-	const char *error_msg;
-
-	std::vector<double> primal(2); // w hyperplane parmeters
-	double b; // hyperplane constant wx -b = 0
-
-	// Parameters -> Need to be checked
-	param.svm_type = C_SVC;
-	param.kernel_type = LINEAR;//RBF;//LINEAR;
-	param.degree = 3;
-	param.gamma = 0;	// 1/num_features
-	param.coef0 = 0;
-	param.nu = 0.5;
-	param.cache_size = 100;
-	param.C = 0.1;
-	param.eps = 1e-3;
-	param.p = 0.1;
-	param.shrinking = 1;
-	param.probability = 0;
-	param.nr_weight = 0;
-	param.weight_label = NULL;
-	param.weight = NULL;
-
-	error_msg = svm_check_parameter(&prob,&param);
-
-	if(error_msg)
-	{
-		fprintf(stderr,"ERROR: %s\n",error_msg);
-		return -1;
-	}
-
-	model = svm_train(&prob,&param);
-
-	compute_primal(model, primal, b);
-	if (DEBUG_FLAG)
-		printf("w = %f %f, b = %f\n", primal[0], primal[1], b);
-
-	// Compute the offset and drift
-	drift = -(primal[0]*peer_offset_bounds_sd)/(primal[1]*instant_sd);
-	offset = peer_offset_bounds_mean + (peer_offset_bounds_sd*(instant_mean*primal[0] + 2*instant_sd*b))/(instant_sd*primal[1]);
-	if (DEBUG_FLAG)
-		printf("drift = %f, offset = %f\n", drift, offset);
 
+#define DEBUG_FLAG 0
 
-	svm_destroy_param(&param);
+// Floor on the curvature of a two-variable step
+#define TAU 1e-12
 
-	// Free memory
-	free(prob.y);
-	for (int i = 0; i < prob.l; i++)
-		free(prob.x[i]);
-	free(prob.x);
-
-	return 0;
-}
+using namespace qot;
 
 // Private function to calculate the mean and standard deviation
-double calculateSD(std::vector<int64_t> &data, int64_t &mean, int vec_size)
+static double calculateSD(const std::vector<int64_t> &data, int64_t &mean, int vec_size)
 {
     int64_t sum = 0;
     double standardDeviation = 0.0;
@@ -159,77 +65,316 @@ double calculateSD(std::vector<int64_t> &data, int64_t &mean, int vec_size)
     return sqrt(standardDeviation/vec_size);
 }
 
-// read in a problem (in svmlight format)
-int formulate_problem(std::vector<int64_t> &peer_offset_bounds, std::vector<int64_t> &instant, int vec_len)
+// Constructor
+SVMprocessor::SVMprocessor(int capacity)
+  : inst(NULL), bound(NULL), alpha(NULL), margin(NULL), capacity(0), num_points(0),
+    peer_offset_bounds_mean(0), instant_mean(0), peer_offset_bounds_sd(0), instant_sd(0),
+    b(0), have_plane(false), iterations(0)
 {
-	int max_index, inst_max_index, i;
-	size_t elements, j;
+	w[0] = w[1] = 0;
+	reserve(capacity);
+}
 
-	prob.l = vec_len*2;
+// Grow the buffers to hold a batch of vec_len probe pairs
+void SVMprocessor::reserve(int vec_len)
+{
+	if (vec_len <= capacity)
+		return;
+
+	// One allocation holds the instants and, per point, the bound, multiplier and margin
+	arena.assign(7*vec_len, 0.0);
+	inst = &arena[0];
+	bound = inst + vec_len;
+	alpha = bound + 2*vec_len;
+	margin = alpha + 2*vec_len;
+	order.reserve(vec_len);
+	capacity = vec_len;
+}
+
+// Forget the hyperplane of the previous batch
+void SVMprocessor::Reset()
+{
+	have_plane = false;
+	w[0] = w[1] = 0;
+	b = 0;
+}
+
+// Number of iterations taken by the last solve
+int SVMprocessor::GetIterations()
+{
+	return iterations;
+}
 
-	// std::ofstream myfile;
-	// myfile.open ("svm.txt");
+// Load a batch of offset bounds (alternate upper and lower) and their instants
+int SVMprocessor::FormulateProblem(const std::vector<int64_t> &peer_offset_bounds, const std::vector<int64_t> &instant, int vec_len)
+{
+	if (vec_len <= 0)
+		return -1;
 
-	// Allocate Memory
-	prob.y = Malloc(double,prob.l);
-	prob.x = Malloc(struct svm_node *,prob.l);
-	
-	for (int i = 0; i < prob.l; i++)
-		prob.x[i] = Malloc(struct svm_node, 3);
+	reserve(vec_len);
+	num_points = 2*vec_len;
 
 	// Data Scaling Parameters
 	peer_offset_bounds_sd = calculateSD(peer_offset_bounds, peer_offset_bounds_mean, 2*vec_len);
 	instant_sd = calculateSD(instant, instant_mean, vec_len);
+	if (peer_offset_bounds_sd == 0 || instant_sd == 0)
+	{
+		num_points = 0;
+		return -1;
+	}
+
+	// Populate the problem -> the upper bound is labelled +1 and the lower bound -1
+	for (int i = 0; i < vec_len; i++)
+	{
+		inst[i] = double(instant[i] - instant_mean)/(2*instant_sd);
+		bound[2*i] = double(peer_offset_bounds[2*i] - peer_offset_bounds_mean)/(2*peer_offset_bounds_sd);
+		bound[2*i+1] = double(peer_offset_bounds[2*i+1] - peer_offset_bounds_mean)/(2*peer_offset_bounds_sd);
+	}
+	return 0;
+}
+
+/* Initialize the multipliers from the previous hyperplane: points which violate its margin
+   start at the penalty bound, the mildest violators of the larger class are released to keep
+   sum(alpha*y) = 0 so that the remaining multipliers stay at their bounds */
+void SVMprocessor::warm_start()
+{
+	int count[2] = {0, 0};
+	for (int i = 0; i < num_points; i++)
+	{
+		double y = (i & 1) ? -1.0 : 1.0;
+		margin[i] = y*(w[0]*inst[i/2] + w[1]*bound[i] + b);
+		alpha[i] = (have_plane && margin[i] < 1) ? SVM_PENALTY_C : 0.0;
+		if (alpha[i] > 0)
+			count[i & 1]++;
+	}
 
-	// std::cout << "Bounds  mean = " << peer_offset_bounds_mean << " sd = " << peer_offset_bounds_sd << "\n";
-	// std::cout << "Instant mean = " << instant_mean << " sd = " << instant_sd << "\n";
-	
-	// Populate problem
-	for (int i = 0; i < prob.l; i = i + 2)
+	if (count[0] != count[1])
 	{
-		// Populate the upper bound on the offset
-		prob.y[i] = 1;
-		prob.x[i][0].index = 1;
-		prob.x[i][0].value = double(instant[i/2] - instant_mean)/(2*instant_sd);
-		prob.x[i][1].index = 2;
-		prob.x[i][1].value = double(peer_offset_bounds[i] - peer_offset_bounds_mean)/(2*peer_offset_bounds_sd);
-		prob.x[i][2].index = -1;
-
-		// Populate the lower bound on the offset
-		prob.y[i+1] = -1;
-		prob.x[i+1][0].index = 1;
-		prob.x[i+1][0].value = double(instant[i/2] - instant_mean)/(2*instant_sd);
-		prob.x[i+1][1].index = 2;
-		prob.x[i+1][1].value = double(peer_offset_bounds[i+1] - peer_offset_bounds_mean)/(2*peer_offset_bounds_sd);
-		prob.x[i+1][2].index = -1;
-
-		// myfile << prob.y[i] << "," << prob.x[i][0].value << "," << prob.x[i][1].value << "\n";
-		// myfile << prob.y[i+1] << "," << prob.x[i+1][0].value << "," << prob.x[i+1][1].value << "\n";
-        //myfile << prob.y[i] << " 1:" << prob.x[i][0].value << " 2:" << prob.x[i][1].value << "\n";
-		//myfile << prob.y[i+1] << " 1:" << prob.x[i+1][0].value << " 2:" << prob.x[i+1][1].value << "\n";
+		// Violators of the larger class, mildest (largest margin) first
+		int parity = (count[0] > count[1]) ? 0 : 1;
+		int excess = count[parity] - count[parity^1];
+		order.clear();
+		for (int i = parity; i < num_points; i += 2)
+			if (alpha[i] > 0)
+				order.push_back(i);
+		std::nth_element(order.begin(), order.begin() + (excess - 1), order.end(),
+			[this](int l, int r) { return margin[l] > margin[r]; });
+		for (int k = 0; k < excess; k++)
+			alpha[order[k]] = 0;
 	}
 
-	// myfile.close();
+	// Hyperplane normal consistent with the multipliers
+	w[0] = w[1] = 0;
+	for (int i = 0; i < num_points; i++)
+	{
+		double ay = (i & 1) ? -alpha[i] : alpha[i];
+		w[0] += ay*inst[i/2];
+		w[1] += ay*bound[i];
+	}
+}
+
+// Solve the loaded batch -> modifies the offset and the drift params
+int SVMprocessor::Run(double &offset, double &drift)
+{
+	const double C = SVM_PENALTY_C;
+	const double INF = std::numeric_limits<double>::infinity();
 
-	max_index = 0;
+	if (num_points == 0)
+		return -1;
 
-	param.gamma = 1.0/2.0;
+	warm_start();
 
-	if(param.kernel_type == PRECOMPUTED)
+	/* Dual of the soft-margin problem with the maximal violating pair selected using second
+	   order information; the gradient y_t*(w.x_t) - 1 is evaluated from the hyperplane */
+	for (iterations = 0; iterations < SVM_MAX_ITER; iterations++)
 	{
-		for(i=0;i<prob.l;i++)
+		// Select i -> maximal violation among the points that can move up
+		double Gmax = -INF;
+		int i = -1;
+		for (int t = 0; t < num_points; t++)
+		{
+			double wx = w[0]*inst[t/2] + w[1]*bound[t];
+			if (!(t & 1))
+			{
+				if (alpha[t] < C && -(wx - 1) >= Gmax)
+				{
+					Gmax = -(wx - 1);
+					i = t;
+				}
+			}
+			else
+			{
+				if (alpha[t] > 0 && (-wx - 1) >= Gmax)
+				{
+					Gmax = -wx - 1;
+					i = t;
+				}
+			}
+		}
+		if (i < 0)
+			break;
+
+		// Select j -> largest decrease of the objective for the pair (i, j)
+		double yi = (i & 1) ? -1.0 : 1.0;
+		double xi0 = inst[i/2], xi1 = bound[i];
+		double Qii = xi0*xi0 + xi1*xi1;
+		double Gmax2 = -INF, obj_diff_min = INF;
+		int j = -1;
+		for (int t = 0; t < num_points; t++)
 		{
-			if (prob.x[i][0].index != 0)
+			double xt0 = inst[t/2], xt1 = bound[t];
+			double wx = w[0]*xt0 + w[1]*xt1;
+			double Qtt = xt0*xt0 + xt1*xt1;
+			double Kit = xi0*xt0 + xi1*xt1;
+			if (!(t & 1))
 			{
-				fprintf(stderr,"Wrong input format: first column must be 0:sample_serial_number\n");
-				exit(1);
+				if (alpha[t] > 0)
+				{
+					double Gt = wx - 1;
+					double grad_diff = Gmax + Gt;
+					if (Gt >= Gmax2)
+						Gmax2 = Gt;
+					if (grad_diff > 0)
+					{
+						double quad_coef = Qii + Qtt - 2.0*Kit;
+						double obj_diff = -(grad_diff*grad_diff)/((quad_coef > 0) ? quad_coef : TAU);
+						if (obj_diff <= obj_diff_min)
+						{
+							j = t;
+							obj_diff_min = obj_diff;
+						}
+					}
+				}
 			}
-			if ((int)prob.x[i][0].value <= 0 || (int)prob.x[i][0].value > max_index)
+			else
 			{
-				fprintf(stderr,"Wrong input format: sample_serial_number out of range\n");
-				exit(1);
+				if (alpha[t] < C)
+				{
+					double Gt = -wx - 1;
+					double grad_diff = Gmax - Gt;
+					if (-Gt >= Gmax2)
+						Gmax2 = -Gt;
+					if (grad_diff > 0)
+					{
+						double quad_coef = Qii + Qtt - 2.0*Kit;
+						double obj_diff = -(grad_diff*grad_diff)/((quad_coef > 0) ? quad_coef : TAU);
+						if (obj_diff <= obj_diff_min)
+						{
+							j = t;
+							obj_diff_min = obj_diff;
+						}
+					}
+				}
 			}
 		}
+		if (Gmax + Gmax2 < SVM_TOLERANCE || j < 0)
+			break;
+
+		// Two-variable update keeping sum(alpha*y) = 0 and 0 <= alpha <= C
+		double yj = (j & 1) ? -1.0 : 1.0;
+		double xj0 = inst[j/2], xj1 = bound[j];
+		double Qjj = xj0*xj0 + xj1*xj1;
+		double Qij = yi*yj*(xi0*xj0 + xi1*xj1);
+		double Gi = yi*(w[0]*xi0 + w[1]*xi1) - 1;
+		double Gj = yj*(w[0]*xj0 + w[1]*xj1) - 1;
+		double old_alpha_i = alpha[i], old_alpha_j = alpha[j];
+		double &ai = alpha[i], &aj = alpha[j];
+		if (yi != yj)
+		{
+			double quad_coef = Qii + Qjj + 2*Qij;
+			double delta = (-Gi - Gj)/((quad_coef > 0) ? quad_coef : TAU);
+			double diff = ai - aj;
+			ai += delta;
+			aj += delta;
+			if (diff > 0)
+			{
+				if (aj < 0) { aj = 0; ai = diff; }
+			}
+			else
+			{
+				if (ai < 0) { ai = 0; aj = -diff; }
+			}
+			if (diff > 0)
+			{
+				if (ai > C) { ai = C; aj = C - diff; }
+			}
+			else
+			{
+				if (aj > C) { aj = C; ai = C + diff; }
+			}
+		}
+		else
+		{
+			double quad_coef = Qii + Qjj - 2*Qij;
+			double delta = (Gi - Gj)/((quad_coef > 0) ? quad_coef : TAU);
+			double sum = ai + aj;
+			ai -= delta;
+			aj += delta;
+			if (sum > C)
+			{
+				if (ai > C) { ai = C; aj = sum - C; }
+			}
+			else
+			{
+				if (aj < 0) { aj = 0; ai = sum; }
+			}
+			if (sum > C)
+			{
+				if (aj > C) { aj = C; ai = sum - C; }
+			}
+			else
+			{
+				if (ai < 0) { ai = 0; aj = sum; }
+			}
+		}
+
+		// Keep the hyperplane normal in step with the multipliers
+		double dai = (ai - old_alpha_i)*yi, daj = (aj - old_alpha_j)*yj;
+		w[0] += dai*xi0 + daj*xj0;
+		w[1] += dai*xi1 + daj*xj1;
+	}
+
+	// Offset of the hyperplane, averaged over the free multipliers
+	int nr_free = 0;
+	double ub = INF, lb = -INF, sum_free = 0;
+	for (int t = 0; t < num_points; t++)
+	{
+		double y = (t & 1) ? -1.0 : 1.0;
+		double yG = (w[0]*inst[t/2] + w[1]*bound[t]) - y;
+		if (alpha[t] >= C)
+		{
+			if (y < 0)
+				ub = std::min(ub, yG);
+			else
+				lb = std::max(lb, yG);
+		}
+		else if (alpha[t] <= 0)
+		{
+			if (y > 0)
+				ub = std::min(ub, yG);
+			else
+				lb = std::max(lb, yG);
+		}
+		else
+		{
+			nr_free++;
+			sum_free += yG;
+		}
 	}
+	b = -((nr_free > 0) ? sum_free/nr_free : (ub + lb)/2);
+	have_plane = true;
+
+	if (DEBUG_FLAG)
+		printf("w = %f %f, b = %f, iterations = %d\n", w[0], w[1], b, iterations);
+
+	if (w[1] == 0)
+		return -1;
+
+	// Compute the offset and drift
+	drift = -(w[0]*peer_offset_bounds_sd)/(w[1]*instant_sd);
+	offset = peer_offset_bounds_mean + (peer_offset_bounds_sd*(instant_mean*w[0] + 2*instant_sd*b))/(instant_sd*w[1]);
+	if (DEBUG_FLAG)
+		printf("drift = %f, offset = %f\n", drift, offset);
+
 	return 0;
 }
@@ -31,10 +31,64 @@
 #include <vector>
 #include <cstdint>
 
-// the problem should be formulated before this step -> modifies the offset and the drift params
-int run_svm(double &offset, double &drift);
+// Penalty of the soft-margin separator
+#define SVM_PENALTY_C 0.1
 
-// read in a problem (in svmlight format)
-int formulate_problem(std::vector<int64_t> &peer_offset_bounds, std::vector<int64_t> &instant, int vec_len);
+// Stopping tolerance on the maximal KKT violation
+#define SVM_TOLERANCE 1e-3
 
-#endif
\ No newline at end of file
+// Iteration limit per batch
+#define SVM_MAX_ITER 1000000
+
+namespace qot
+{
+	/* Linear soft-margin separator between the upper and lower offset bounds of one peer,
+	   solved in the dual with two-variable (SMO) steps on the explicit hyperplane. Each
+	   instance owns its buffers, so one instance per peer can run concurrently */
+	class SVMprocessor
+	{
+		/* Constructor 
+		Params: capacity  Number of probe pairs per batch for which buffers are preallocated */
+		public: SVMprocessor(int capacity = 0);
+
+		// Load a batch of offset bounds (alternate upper and lower) and their instants
+		public: int FormulateProblem(const std::vector<int64_t> &peer_offset_bounds, const std::vector<int64_t> &instant, int vec_len);
+
+		// Solve the loaded batch -> modifies the offset and the drift params
+		public: int Run(double &offset, double &drift);
+
+		// Forget the hyperplane of the previous batch
+		public: void Reset();
+
+		// Number of iterations taken by the last solve
+		public: int GetIterations();
+
+		// Grow the buffers to hold a batch of vec_len probe pairs
+		private: void reserve(int vec_len);
+
+		// Initialize the multipliers from the previous hyperplane
+		private: void warm_start();
+
+		// Buffers, carved out of a single allocation
+		private: std::vector<double> arena;
+		private: double *inst;      // Scaled instant of each probe pair
+		private: double *bound;     // Scaled offset bound of each point (even -> upper, odd -> lower)
+		private: double *alpha;     // Dual multiplier of each point
+		private: double *margin;    // Margin of each point under the previous hyperplane
+		private: std::vector<int> order;  // Scratch for the warm start
+		private: int capacity;      // Probe pairs which fit in the arena
+		private: int num_points;    // Points in the loaded batch
+
+		// Data scaling parameters
+		private: int64_t peer_offset_bounds_mean, instant_mean;
+		private: double peer_offset_bounds_sd, instant_sd;
+
+		// Hyperplane w.x + b = 0 in scaled coordinates
+		private: double w[2];
+		private: double b;
+		private: bool have_plane;
+		private: int iterations;
+	};
+}
+
+#endif
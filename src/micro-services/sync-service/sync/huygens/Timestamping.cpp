@@ -46,13 +46,46 @@ extern "C"
   #include <sys/ioctl.h> 
   #include <sys/signal.h>
   #include <poll.h>
+  #include <linux/errqueue.h>
 }
 
+#include "Timestamping.hpp"
+
+// Include fault injection hooks
+#include "../../qot_fault.h"
+
 // Define this flag if not defined
 #ifndef SO_SELECT_ERR_QUEUE
 #define SO_SELECT_ERR_QUEUE 45
 #endif
 
+/* Apply the injected error to a packet timestamp, returns 1 if the packet is to be dropped */
+static int tstamp_fault(int inbound, struct timespec *pkt_timestamp)
+{
+  int64_t shift = 0;
+  if (qot_fault_packet(inbound, &shift))
+    return 1;
+  int64_t ns = pkt_timestamp->tv_sec*1000000000LL + pkt_timestamp->tv_nsec + shift;
+  pkt_timestamp->tv_sec = ns / 1000000000LL;
+  pkt_timestamp->tv_nsec = ns % 1000000000LL;
+  return 0;
+}
+
+/* Enable SO_TIMESTAMPING, asking the kernel to tag TX timestamps with a per-packet
+   counter (OPT_ID) without looping the payload back (OPT_TSONLY) when supported */
+static int tstamp_setsockopt(int sock, int f)
+{
+  int opt_flags[3] = { SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY, SOF_TIMESTAMPING_OPT_ID, 0 };
+  int flags;
+
+  for (int i = 0; i < 3; i++) {
+    flags = f | opt_flags[i];
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+      return 0;
+  }
+  return -1;
+}
+
 /**
  * Try to enable kernel timestamping, otherwise fall back to software.
  *
@@ -71,7 +104,7 @@ int tstamp_mode_kernel(int sock) {
   f |= SOF_TIMESTAMPING_RX_SOFTWARE;
   f |= SOF_TIMESTAMPING_SOFTWARE;
   /* Enable Timestamping */
-  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &f, slen) < 0) {
+  if (tstamp_setsockopt(sock, f) < 0) {
     printf("SO_TIMESTAMPING not possible\n");
     return -1;
   }
@@ -152,7 +185,7 @@ int tstamp_mode_hardware(int sock, char *iface) {
   f |= SOF_TIMESTAMPING_RX_SOFTWARE;
   f |= SOF_TIMESTAMPING_RX_HARDWARE;
   f |= SOF_TIMESTAMPING_RAW_HARDWARE;
-  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &f, slen) < 0) {
+  if (tstamp_setsockopt(sock, f) < 0) {
     /* bail to userland timestamps (socket only) */ 
     printf("SO_TIMESTAMPING: error\n");
     return -1;
@@ -247,6 +280,8 @@ int get_tx_timestamp(int fd, void *buf, int buflen, struct sockaddr_in *addr, in
       *pkt_timestamp = ts[1]; // HW Timestamp translated to system time
     else
       *pkt_timestamp = ts[2]; // HW Timestamp
+    if (tstamp_fault(0, pkt_timestamp))
+      return -1;
   }
   else
   {
@@ -311,5 +346,93 @@ int get_rx_timestamp(struct msghdr *msg, int64_t offset, struct timespec *pkt_ti
   else
     *pkt_timestamp = ts[2]; // HW Timestamp (RX)
 
+  if (tstamp_fault(1, pkt_timestamp))
+    return -1;
   return 0;
 }
+
+/* Check if TX timestamps on the socket carry the per-packet counter */
+int tstamp_opt_id_enabled(int sock)
+{
+  int f = 0;
+  socklen_t slen = (socklen_t)sizeof f;
+  if (getsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &f, &slen) < 0)
+    return 0;
+  return (f & SOF_TIMESTAMPING_OPT_ID) ? 1 : 0;
+}
+
+/* Drain the TX timestamps queued on the error queue in bulk */
+int get_tx_timestamps(int fd, struct tx_timestamp *entries, int max_entries, int ts_flag, int timeout_ms, int debug_print)
+{
+  struct mmsghdr msgvec[TS_BATCH_SIZE];
+  struct iovec iov[TS_BATCH_SIZE];
+  char control[TS_BATCH_SIZE][256];
+  unsigned char junk[1600];   /* Looped back payloads are discarded */
+  struct cmsghdr *cm;
+  struct timespec *ts;
+  struct sock_extended_err *serr;
+  int count = 0, batch, n, res;
+
+  /* Only wait if nothing has been queued yet */
+  if (timeout_ms > 0) {
+    struct pollfd pfd = { fd, POLLERR, 0 };
+    res = poll(&pfd, 1, timeout_ms);
+    if (res < 1) {
+      if (debug_print)
+        printf(res ? "poll for tx timestamps failed: %m\n" :
+                     "timed out while polling for tx timestamps\n");
+      return res;
+    }
+  }
+
+  while (count < max_entries) {
+    batch = max_entries - count;
+    if (batch > TS_BATCH_SIZE)
+      batch = TS_BATCH_SIZE;
+
+    memset(msgvec, 0, batch*sizeof(struct mmsghdr));
+    for (int i = 0; i < batch; i++) {
+      iov[i].iov_base = junk;
+      iov[i].iov_len = sizeof(junk);
+      msgvec[i].msg_hdr.msg_iov = &iov[i];
+      msgvec[i].msg_hdr.msg_iovlen = 1;
+      msgvec[i].msg_hdr.msg_control = control[i];
+      msgvec[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    n = recvmmsg(fd, msgvec, batch, MSG_ERRQUEUE | MSG_DONTWAIT, NULL);
+    if (n < 1)
+      break;
+
+    for (int i = 0; i < n; i++) {
+      ts = NULL;
+      serr = NULL;
+      for (cm = CMSG_FIRSTHDR(&msgvec[i].msg_hdr); cm != NULL; cm = CMSG_NXTHDR(&msgvec[i].msg_hdr, cm)) {
+        if (SOL_SOCKET == cm->cmsg_level && SO_TIMESTAMPING == cm->cmsg_type &&
+            cm->cmsg_len >= CMSG_LEN(sizeof(*ts) * 3))
+          ts = (struct timespec *) CMSG_DATA(cm);
+        else if (SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type)
+          serr = (struct sock_extended_err *) CMSG_DATA(cm);
+      }
+
+      /* Software and hardware stamps of one packet arrive separately, keep the requested one */
+      if (ts == NULL || (ts[ts_flag].tv_sec == 0 && ts[ts_flag].tv_nsec == 0))
+        continue;
+      if (serr && serr->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+        continue;
+
+      entries[count].id = serr ? serr->ee_data : 0;
+      entries[count].ts = ts[ts_flag];
+      if (tstamp_fault(0, &entries[count].ts))
+        continue;
+      if (debug_print)
+        printf("TX TIMESTAMP [%u]     %ld.%09ld\n", entries[count].id, (long)entries[count].ts.tv_sec, (long)entries[count].ts.tv_nsec);
+      count++;
+    }
+
+    if (n < batch)
+      break;
+  }
+
+  return count;
+}
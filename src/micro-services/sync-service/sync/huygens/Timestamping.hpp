@@ -31,6 +31,17 @@
  
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Maximum number of packets moved per recvmmsg/sendmmsg call */
+#define TS_BATCH_SIZE 64
+
+/* TX timestamp tagged with the per-packet counter of the socket (SO_TIMESTAMPING OPT_ID) */
+struct tx_timestamp {
+  uint32_t id;
+  struct timespec ts;
+};
 
 /**
  * Try to enable kernel timestamping, otherwise fall back to software.
@@ -60,7 +71,23 @@ int tstamp_mode_hardware(int sock, char *iface);
 /* Fetch the timestamp of a sent packet */
 int get_tx_timestamp(int fd, void *buf, int buflen, struct sockaddr_in *addr, int flags, struct timespec *pkt_timestamp, int ts_flag, int debug_print);
 
-/* Extract the timestamp of a sent packet */
+/* Extract the timestamp of a received packet */
 int get_rx_timestamp(struct msghdr *msg, int64_t offset, struct timespec *pkt_timestamp, int ts_flag, int debug_print);
 
+/* Check if TX timestamps on the socket carry the per-packet counter (OPT_ID) */
+int tstamp_opt_id_enabled(int sock);
+
+/**
+ * Drain the TX timestamps queued on the socket error queue in bulk.
+ *
+ * Entries are returned in queue order and tagged with their OPT_ID counter, so
+ * callers match them to the sent packets by id rather than by order.
+ *
+ * \param[out] entries     Drained timestamps
+ * \param[in]  max_entries Size of entries
+ * \param[in]  timeout_ms  Time to wait for the first timestamp (0 does not wait)
+ * \return                 Number of timestamps drained, negative on error
+ */
+int get_tx_timestamps(int fd, struct tx_timestamp *entries, int max_entries, int ts_flag, int timeout_ms, int debug_print);
+
 #endif
\ No newline at end of file
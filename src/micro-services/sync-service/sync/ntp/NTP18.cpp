@@ -42,6 +42,10 @@ extern "C"
 
 #include "../../qot_sync_service.hpp"
 
+// Runtime metrics
+#include "../../qot_metrics.hpp"
+#include "../../qot_trace.hpp"
+
 #include <map>
 #include <mutex>
 
@@ -455,10 +459,16 @@ void NTP18::Start(
   	last_clocksync_data_point.drift   = 0;
   	last_clocksync_data_point.data_id = 0;
 
-  	// Initialize Global Variable for Clock-Skew Statistics 
-  	ntp_clocksync_data_point[timelineid].offset  = 0;
-  	ntp_clocksync_data_point[timelineid].drift   = 0;
-  	ntp_clocksync_data_point[timelineid].data_id = 0;
+  	// Initialize Global Variable for Clock-Skew Statistics (the slot is allocated on first use)
+  	qot_stat_t *clocksync_data_point = QOT_SLOT(&ntp_clocksync_data_point, qot_stat_t, timelineid);
+  	if (clocksync_data_point == NULL)
+  	{
+  	    BOOST_LOG_TRIVIAL(error) << "No statistics slot for timeline " << timelineid;
+  	    return;
+  	}
+  	clocksync_data_point->offset  = 0;
+  	clocksync_data_point->drift   = 0;
+  	clocksync_data_point->data_id = 0;
 
   	// Spawn the sync and uncertainty threads
     sync_thread = boost::thread(boost::bind(&NTP18::SyncThread, this, timelineid, timelinesfd, timelines_size));
@@ -500,7 +510,7 @@ void NTP18::Stop()
 
   #ifdef QOT_TIMELINE_SERVICE
   // Unmap the shared memory
-  munmap(tl_clk_params, sizeof(tl_translation_t));
+  munmap(tl_clk_params, tl_clock_segment_size(tl_clk_params));
   #endif
 }
 
@@ -553,9 +563,9 @@ int NTP18::ExtControl(void** pointer, ExtCtrlOptions type)
           break;
 
       case SET_PUBSUB_SERVER: // pointer points to a const char* with the nats server
-          // Set the NATS server to be used
+          // Set the pub-sub server (nats://, inproc:// or local:// URL) to be used
           nats_server = std::string(*((const char**)pointer));
-          BOOST_LOG_TRIVIAL(info) << "Got the NATS server URL " << nats_server;
+          BOOST_LOG_TRIVIAL(info) << "Got the pub-sub server URL " << nats_server;
           break;
 
       case MODIFY_SYNC_PARAMS: // pointer points to a char* with the command
@@ -776,6 +786,10 @@ int NTP18::UncertaintyThread(int timelineid, int *timelinesfd, uint16_t timeline
 {
     // struct timespec wait_time;
     int64_t timedwait_period_second = 2;
+
+    // Statistics slot of this timeline (reserved by Start)
+    qot_stat_t *clocksync_data_point = QOT_SLOT(&ntp_clocksync_data_point, qot_stat_t, timelineid);
+    MetricsStream sample_metrics("qot_sync_samples", "alg=\"ntp\"", "synchronization samples taken in by the uncertainty service");
     while (tl_clk_params == NULL)
     {
       sleep(1);
@@ -786,14 +800,15 @@ int NTP18::UncertaintyThread(int timelineid, int *timelinesfd, uint16_t timeline
     }
  
     BOOST_LOG_TRIVIAL(info) << "Sync Uncertainty thread started for timeline " << timelineid;
+    sync_uncertainty.SetTraceSource(timelineid);
 
     int i = 0;
     int retval = 0;
 
     #ifdef QOT_TIMELINE_SERVICE
-    #ifdef NATS_SERVICE
-    // Connect to NATS Service
-    sync_uncertainty.natsConnect(nats_server.c_str());
+    #ifdef PUBSUB_SERVICE
+    // Connect to the pub-sub service
+    sync_uncertainty.pubsubConnect(nats_server.c_str());
     #endif
     #endif
 
@@ -819,9 +834,11 @@ int NTP18::UncertaintyThread(int timelineid, int *timelinesfd, uint16_t timeline
       std::cout << "New uncertainty value found " << i++ <<  "\n";
 
       // Check if a new skew statistic data point has been added -> New statistic received -> Replace old value
-      if(last_clocksync_data_point.data_id < ntp_clocksync_data_point[timelineid].data_id)
+      if(last_clocksync_data_point.data_id < clocksync_data_point->data_id)
       {
-         last_clocksync_data_point = ntp_clocksync_data_point[timelineid];
+         last_clocksync_data_point = *clocksync_data_point;
+         sample_metrics.Tick();
+         trace_sync_sample(timelineid, last_clocksync_data_point.offset, last_clocksync_data_point.drift, last_clocksync_data_point.data_id, QOT_TRACE_ALG_NTP);
       }
       else
       {
@@ -830,9 +847,9 @@ int NTP18::UncertaintyThread(int timelineid, int *timelinesfd, uint16_t timeline
       }
       // else // Now the offset is uncorrected -> Because we are extrapolating from a previous point
       // {
-      //    last_clocksync_data_point.drift = ntp_clocksync_data_point[timelineid].drift;
+      //    last_clocksync_data_point.drift = clocksync_data_point->drift;
       //    // The uncompensated new offset is the drift*ns_time_passed/1Billion as drift is ppb, which is equivalent to drift*second_time_passed
-      //    last_clocksync_data_point.offset = last_clocksync_data_point.offset + ntp_clocksync_data_point[timelineid].drift*timedwait_period_second;
+      //    last_clocksync_data_point.offset = last_clocksync_data_point.offset + clocksync_data_point->drift*timedwait_period_second;
       //    std::cout << "Drift = " << last_clocksync_data_point.drift << ", Offset = " << last_clocksync_data_point.offset << "\n";
       // }
 
@@ -1000,9 +1017,13 @@ int NTP18::LocalUncertaintyThread(int timelineid, int *timelinesfd, uint16_t tim
     last_clkrtphc_data_point.data_id = 0;
 
     // Initialize Global Variable for Clock-Skew Statistics 
-    ntp_clocksync_data_point[fake_local_timelineid].offset  = 0;
-    ntp_clocksync_data_point[fake_local_timelineid].drift   = 0;
-    ntp_clocksync_data_point[fake_local_timelineid].data_id = 0;
+    qot_stat_t *clkrtphc_data_point = QOT_SLOT(&ntp_clocksync_data_point, qot_stat_t, fake_local_timelineid);
+    if (clkrtphc_data_point == NULL)
+        return -1;
+    clkrtphc_data_point->offset  = 0;
+    clkrtphc_data_point->drift   = 0;
+    clkrtphc_data_point->data_id = 0;
+    MetricsStream sample_metrics("qot_sync_samples", "alg=\"ntp_local\"", "synchronization samples taken in by the uncertainty service");
 
     while (local_tl_clk_params == NULL)
     {
@@ -1014,13 +1035,14 @@ int NTP18::LocalUncertaintyThread(int timelineid, int *timelinesfd, uint16_t tim
     }
  
     BOOST_LOG_TRIVIAL(info) << "Local Timeline (CLK_RT->PHC) Sync Uncertainty thread started";
+    loc_sync_uncertainty.SetTraceSource(fake_local_timelineid);
 
     int i = 0;
 
     #ifdef QOT_TIMELINE_SERVICE
-    #ifdef NATS_SERVICE
-    // Connect to NATS Service
-    loc_sync_uncertainty.natsConnect(nats_server.c_str());
+    #ifdef PUBSUB_SERVICE
+    // Connect to the pub-sub service
+    loc_sync_uncertainty.pubsubConnect(nats_server.c_str());
     #endif
     #endif
 
@@ -1044,9 +1066,11 @@ int NTP18::LocalUncertaintyThread(int timelineid, int *timelinesfd, uint16_t tim
       std::cout << "New local timeline uncertainty value for CLKRT->PHC found " << i++ <<  "\n";
 
       // Check if a new skew statistic data point has been added -> New statistic received -> Replace old value
-      if(last_clkrtphc_data_point.data_id < ntp_clocksync_data_point[fake_local_timelineid].data_id)
+      if(last_clkrtphc_data_point.data_id < clkrtphc_data_point->data_id)
       {
-         last_clkrtphc_data_point = ntp_clocksync_data_point[fake_local_timelineid];
+         last_clkrtphc_data_point = *clkrtphc_data_point;
+         sample_metrics.Tick();
+         trace_sync_sample(fake_local_timelineid, last_clkrtphc_data_point.offset, last_clkrtphc_data_point.drift, last_clkrtphc_data_point.data_id, QOT_TRACE_ALG_NTP_LOCAL);
       }
       else
       {
@@ -39,10 +39,11 @@
 /* Added for the QoT Stack */
 #include <pthread.h>
 #include "../global_timeline.h"
+#include "../../../../../qot_slot_table.h"
 
 #ifdef NTP_QOT_STACK
-// Clock Statistics Data Point -> variable defined in chrony-3.2/local.c
-extern qot_stat_t ntp_clocksync_data_point[MAX_TIMELINES];
+// Clock Statistics Data Point (qot_stat_t slots by timeline id) -> variable defined in chrony-3.2/local.c
+extern qot_slot_table_t ntp_clocksync_data_point;
 #define QOT_DEBUG_LOG 1
 #define QOT_DEBUG_FILE "/opt/qot-stack/doc/data/phcclkrtmap.csv"
 FILE* outfile_fd;
@@ -168,13 +169,18 @@ pthread_cond_t loc_uncertainty_condvar = PTHREAD_COND_INITIALIZER;
 
 void HCL_SetUncertainty(int64_t freq_ppb, int64_t offset)
 {
+  qot_stat_t *stat;
+
   fake_local_timelineid = 1; // Defaults to 1
 
   pthread_mutex_lock(&loc_uncertainty_lock);
   // Add Statistic for the QoT Uncertainty Service to process
-  ntp_clocksync_data_point[fake_local_timelineid].offset = offset;//(int64_t)ceil(offset*1.0e9);
-  ntp_clocksync_data_point[fake_local_timelineid].drift = freq_ppb;
-  ntp_clocksync_data_point[fake_local_timelineid].data_id++;
+  stat = QOT_SLOT(&ntp_clocksync_data_point, qot_stat_t, fake_local_timelineid);
+  if (stat) {
+    stat->offset = offset;//(int64_t)ceil(offset*1.0e9);
+    stat->drift = freq_ppb;
+    stat->data_id++;
+  }
 
   // Signal the NTP18 local uncertainty thread that a new data poin has been added
   pthread_cond_signal(&loc_uncertainty_condvar);
@@ -186,8 +192,10 @@ void HCL_SetUncertainty(int64_t freq_ppb, int64_t offset)
 int64_t clockrt_to_phc(tl_translation_t* clk_params, int64_t timestamp)
 {
   int64_t val = timestamp;
-  val -= clk_params->last;
-  val  = clk_params->nsec + val + ((clk_params->mult*val)/1000000000L);
+  tl_translation_t params;
+  tl_translation_read(clk_params, &params);
+  val -= params.last;
+  val  = params.nsec + val + ((params.mult*val)/1000000000L);
   return val;
 }
 #endif
@@ -250,10 +258,12 @@ HCL_AccumulateSample(HCL_Instance clock, struct timespec *hw_ts,
   if (local_clk_params != NULL)
   {
     // old_params = *local_clk_params;
+    UTI_AddDoubleToTimespec(&clock->hw_ref, clock->frequency*clock->offset, &nsec);                         
+    tl_translation_write_begin(local_clk_params);
     local_clk_params->last = clock->local_ref.tv_sec*1000000000ULL + clock->local_ref.tv_nsec;                            
     local_clk_params->mult = (clock->frequency - 1.0)*1000000000;   
-    UTI_AddDoubleToTimespec(&clock->hw_ref, clock->frequency*clock->offset, &nsec);                         
     local_clk_params->nsec = nsec.tv_sec*1000000000ULL + nsec.tv_nsec; 
+    tl_translation_write_end(local_clk_params);
     // proj_offset = clockrt_to_phc(local_clk_params, local_clk_params->last) - clockrt_to_phc(&old_params, local_clk_params->last);
     HCL_SetUncertainty((int64_t)((clock->frequency - 1.0)*1000000000), (int64_t)ceil(clock->offset*1.0e9));
     // HCL_SetUncertainty((int64_t)((clock->frequency - 1.0)*1000000000), proj_offset);
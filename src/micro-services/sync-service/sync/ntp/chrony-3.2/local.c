@@ -43,10 +43,12 @@
 /* Added for the QoT Stack */
 #include <pthread.h>
 #include "../global_timeline.h"
+#include "../../../../../qot_slot_table.h"
+#include "../../../qot_fault.h"
 
 #ifdef NTP_QOT_STACK
-// Clock Statistics Data Point -> variable defined in chrony-3.2/local.c
-extern qot_stat_t ntp_clocksync_data_point[MAX_TIMELINES];
+// Clock Statistics Data Point (qot_stat_t slots by timeline id) -> variable defined in chrony-3.2/local.c
+extern qot_slot_table_t ntp_clocksync_data_point;
 #define LOC_DEBUG_LOG 1
 #define LOC_DEBUG_FILE "/opt/qot-stack/doc/data/uncertainty.csv"
 FILE* loc_outfile_fd;
@@ -593,9 +595,8 @@ LCL_AccumulateDeltaFrequency(double dfreq)
 }
 
 /* ================================================== */
-/* Global Variable for Sharing Computed Clock Statistic from Sync to Uncertainty Calculation */
-qot_stat_t ntp_clocksync_data_point[MAX_TIMELINES];
-qot_stat_t last_clocksync_data_point[MAX_TIMELINES];
+/* Global Variable for Sharing Computed Clock Statistic from Sync to Uncertainty Calculation (indexed by timeline id) */
+qot_slot_table_t ntp_clocksync_data_point = QOT_SLOT_TABLE_INIT(qot_stat_t);
 
 void
 LCL_AccumulateOffset(double offset, double corr_rate)
@@ -849,6 +850,7 @@ void LCL_SetDispUncertaintyParams(struct timespec our_ref_time, double our_root_
       if (!global_clk_params)
         return;
 
+      tl_translation_write_begin(global_clk_params);
       //#ifndef QUARTZ_V1 // New code added
       #ifdef SYNC_PRIVELEGED
         global_clk_params->last = our_ref_time.tv_sec*1000000000LL + (int64_t)our_ref_time.tv_nsec;
@@ -860,6 +862,7 @@ void LCL_SetDispUncertaintyParams(struct timespec our_ref_time, double our_root_
       global_clk_params->l_nsec = global_clk_params->u_nsec;  // Take care of negative sign here only -> Kernel Space implementation does it in the kernel
       global_clk_params->u_mult = (int64_t)((our_skew + fabs(our_residual_freq) + LCL_GetMaxClockError())*1000000000LL);
       global_clk_params->l_mult = global_clk_params->u_mult;
+      tl_translation_write_end(global_clk_params);
 
     /* NTP uses the following formula to calculate root dispersion (uncertainty w.r.t stratum 1)
      our_root_dispersion + fabs(UTI_DiffTimespecsToDouble(ts, &our_ref_time))*(our_skew + fabs(our_residual_freq) + LCL_GetMaxClockError()); */
@@ -880,6 +883,8 @@ void LCL_SetUncertainty(double dfreq, double offset)
   /* Disable the parameter collection if the OoT estimation is using NTP Peer Dispersion */
   #ifndef QOT_PEER_DISP
     double freq_ppm;
+    qot_stat_t *stat;
+    int64_t offset_ns = (int64_t)ceil(offset*1.0e9);
     // freq_ppm = current_freq_ppm + dfreq * (1.0e6 - current_freq_ppm);
     freq_ppm = dfreq * (1.0e6 - current_freq_ppm);
 
@@ -890,16 +895,25 @@ void LCL_SetUncertainty(double dfreq, double offset)
         clock_gettime(CLOCK_REALTIME,&ts);
         if (!global_clk_params)
           return;
+        tl_translation_write_begin(global_clk_params);
         global_clk_params->last = ts.tv_sec*1000000000LL + (int64_t)ts.tv_nsec;
         global_clk_params->nsec = global_clk_params->last;
+        tl_translation_write_end(global_clk_params);
       #endif
     #endif
 
+    // Injected sample error, a lost sample is not handed to the uncertainty service
+    if (qot_fault_sample(&offset_ns))
+      return;
+
     pthread_mutex_lock(&uncertainty_lock);
     // Add Statistic for the QoT Uncertainty Service to process
-    ntp_clocksync_data_point[global_timelineid].offset = (int64_t)ceil(offset*1.0e9);
-    ntp_clocksync_data_point[global_timelineid].drift = (int64_t)ceil(freq_ppm*1.0e3); // Convert PPM to PPB
-    ntp_clocksync_data_point[global_timelineid].data_id++;
+    stat = QOT_SLOT(&ntp_clocksync_data_point, qot_stat_t, global_timelineid);
+    if (stat) {
+      stat->offset = offset_ns;
+      stat->drift = (int64_t)ceil(freq_ppm*1.0e3); // Convert PPM to PPB
+      stat->data_id++;
+    }
 
     // Signal the NTP18 uncertainty thread that a new data poin has been added
     pthread_cond_signal(&uncertainty_condvar);
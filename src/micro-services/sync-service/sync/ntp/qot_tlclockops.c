@@ -51,23 +51,30 @@
 // Include global timeline header
 #include "global_timeline.h"
 
+// Include fault injection hooks
+#include "../../qot_fault.h"
+
 /* Convert from core time to timeline time */
 qot_return_t qot_gl_timeline_loc2rem(utimepoint_t *est, int period)
 {    
     int64_t val;
+    tl_translation_t params;
 
     if (!global_clk_params)
         return QOT_RETURN_TYPE_ERR;
 
+    // Lock-free consistent snapshot of the shared parameters
+    tl_translation_read(global_clk_params, &params);
+
     val = TP_TO_nSEC(est->estimate);
 
     // Check if this is correct -> makes the assumption that val is mostly greater than 1s (1 billion ns) (consider using floating point ops)
     if (period)
-        val += (global_clk_params->mult*val)/1000000000L;
+        val += (params.mult*val)/1000000000L;
     else
     {
-        val -= global_clk_params->last;
-        val  = global_clk_params->nsec + val + ((global_clk_params->mult*val)/1000000000L);
+        val -= params.last;
+        val  = params.nsec + val + ((params.mult*val)/1000000000L);
     }
     TP_FROM_nSEC(est->estimate, val); 
 
@@ -104,10 +111,12 @@ static int qot_timeline_clock_adjfreq(s32 ppb)
     ns = TP_TO_nSEC(utp.estimate);
 
     // Write the new parameters to shared memory
+    tl_translation_write_begin(global_clk_params);
     global_clk_params->nsec += (ns - global_clk_params->last)
         + (global_clk_params->mult * (ns - global_clk_params->last))/1000000000L; // ULL Changed to L -> Anon
     global_clk_params->last  = ns;
-    global_clk_params->mult = (s64) ppb; // typecast added to s64
+    global_clk_params->mult = (s64) ppb + qot_fault_clock_freq(); // typecast added to s64, plus an injected frequency error
+    tl_translation_write_end(global_clk_params);
     return 0;
 }
 
@@ -122,7 +131,9 @@ static int qot_timeline_clock_adjtime(s64 delta)
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
+    tl_translation_write_begin(global_clk_params);
     global_clk_params->nsec += delta; 
+    tl_translation_write_end(global_clk_params);
     
     return 0;
 }
@@ -152,8 +163,10 @@ int qot_gl_timeline_settime(const struct timespec *tp)
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
+    tl_translation_write_begin(global_clk_params);
     global_clk_params->last = ns;
     global_clk_params->nsec = tp->tv_sec*1000000000LL + (s64)tp->tv_nsec;
+    tl_translation_write_end(global_clk_params);
     
     return 0;
 }
@@ -163,6 +176,7 @@ int qot_gl_timeline_gettime(struct timespec *tp)
     utimepoint_t utp;
     s64 ns;
     s64 now;
+    tl_translation_t params;
    
     // Get the core time
     struct timespec ts;
@@ -170,8 +184,9 @@ int qot_gl_timeline_gettime(struct timespec *tp)
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
-    now = global_clk_params->nsec + (ns - global_clk_params->last)
-          + (global_clk_params->mult * (ns - global_clk_params->last))/1000000000L; // Changed from ULL to L
+    tl_translation_read(global_clk_params, &params);
+    now = params.nsec + (ns - params.last)
+          + (params.mult * (ns - params.last))/1000000000L; // Changed from ULL to L
 
     TP_FROM_nSEC(utp.estimate, now);
     timespec_from_timepoint(tp, &utp.estimate);
@@ -184,6 +199,9 @@ long dialed_frequency = 0;
 int qot_gl_timeline_adjtime(struct timex *tx)
 {
     int err = -EOPNOTSUPP;
+    s64 step = qot_fault_clock_step();
+    if (step != 0)
+        qot_timeline_clock_adjtime(step); // Injected phase step
     if (tx->modes & ADJ_SETOFFSET) {
         struct timespec ts;
         s64 delta;
@@ -31,14 +31,15 @@
 #define NTP_UNCERTAINTY_DATA_QOT_H
 
 #include "../../../../qot_types.h"
+#include "../../../../qot_slot_table.h"
 
 extern "C"
 {
 	#include <pthread.h>
 }
 
-// Clock Statistics Data Point -> variable defined in chrony-3.2/local.c
-extern qot_stat_t ntp_clocksync_data_point[MAX_TIMELINES];
+// Clock Statistics Data Point (qot_stat_t slots by timeline id) -> variable defined in chrony-3.2/local.c
+extern qot_slot_table_t ntp_clocksync_data_point;
 
 // Global Timelines Uncertainty Variable Protection + Signaling Locks
 extern pthread_mutex_t uncertainty_lock;
@@ -28,7 +28,6 @@
  *
  */
 
-#include <fstream>
 #include <map>
 
 #include "PTP18.hpp"
@@ -37,19 +36,18 @@
 
 #include "../../qot_sync_service.hpp"
 
+// Runtime metrics
+#include "../../qot_metrics.hpp"
+
+// Binary sync trace
+#include "../../qot_trace.hpp"
+
 using namespace qot;
 
 #define DEBUG true
 #define TEST  true
-#define LOGGING_FLAG true
 #define DECISION_MAKING_PERIOD 10
 
-// Global Log File
-std::ofstream ptp_logfile;
-
-// Global Log file for rate change
-std::ofstream rate_logfile;
-
 // Data structure to hold the desired and delivered QoT
 typedef struct accuracy_vector {
 	uint64_t delivered_accuracy;      /* Delivered Accuracy   */
@@ -68,29 +66,15 @@ PTP18::PTP18(boost::asio::io_service *io, // ASIO handle
 		const std::string &iface,		  // interface
 		struct uncertainty_params config  // uncertainty calculation configuration
 	) : baseiface(iface), sync_uncertainty(config), cfg(NULL), tl_clk_params(NULL), qot_subscriber_flag(false),
-      nats_server("nats://nats.default.svc.cluster.local:4222"), desired_accuracy(0)
+      nats_server("nats://nats.default.svc.cluster.local:4222"), desired_accuracy(0), timeline_index(0)
 {	
 	this->Reset();	
-
-	if (LOGGING_FLAG == 1)
-    {
-      std::string logfile_name = "/opt/qot-stack/doc/data/ptplog.csv";
-      std::string ratefile_name = "/opt/qot-stack/doc/data/ptplog_rate.csv";
-      ptp_logfile.open(logfile_name);
-      rate_logfile.open(ratefile_name);
-    }
 }
 
 PTP18::~PTP18()
 {
 	this->Stop();
 
-	if (LOGGING_FLAG == 1)
-	{
-      ptp_logfile.close();
-      rate_logfile.close();
-	}
-
     qot_subscriber_flag = false;
 }
 
@@ -118,6 +102,8 @@ void PTP18::Start(bool master, int log_sync_interval, uint32_t sync_session,
 
 	// Record timeline name
 	timeline_uuid = tl_name;
+	timeline_index = timelineid;
+	sync_uncertainty.SetTraceSource(timelineid);
 
 	// Set the node name
 	node_uuid = node_name;
@@ -158,10 +144,14 @@ void PTP18::Start(bool master, int log_sync_interval, uint32_t sync_session,
 	last_clocksync_data_point.drift   = 0;
 	last_clocksync_data_point.data_id = 0;
 
-	// Initialize Global Variable for Clock-Skew Statistics 
-	ptp_clocksync_data_point[timelineid].offset  = 0;
-	ptp_clocksync_data_point[timelineid].drift   = 0;
-	ptp_clocksync_data_point[timelineid].data_id = 0;
+	// Initialize Global Variable for Clock-Skew Statistics (the slot is allocated on first use)
+	qot_stat_t *clocksync_data_point = QOT_SLOT(&ptp_clocksync_data_point, qot_stat_t, timelineid);
+	if (clocksync_data_point != NULL)
+	{
+		clocksync_data_point->offset  = 0;
+		clocksync_data_point->drift   = 0;
+		clocksync_data_point->data_id = 0;
+	}
 
 	thread = boost::thread(boost::bind(&PTP18::SyncThread, this, timelineid, timelinesfd, timelines_size));
 }
@@ -204,9 +194,9 @@ int PTP18::ExtControl(void** pointer, ExtCtrlOptions type)
   switch (type)
   {
       case SET_PUBSUB_SERVER: // pointer points to a const char* with the nats server
-          // Set the NATS server to be used
+          // Set the pub-sub server (nats://, inproc:// or local:// URL) to be used
           SetPubSubServer(std::string(*((const char**)pointer)));
-          BOOST_LOG_TRIVIAL(info) << "PTP18: Got the NATS server URL " << nats_server;
+          BOOST_LOG_TRIVIAL(info) << "PTP18: Got the pub-sub server URL " << nats_server;
           break;
 
       case ADD_TL_SYNC_DATA: // pointer to qot_sync_msg_t
@@ -224,7 +214,7 @@ int PTP18::ExtControl(void** pointer, ExtCtrlOptions type)
 }
 
 #ifdef QOT_TIMELINE_SERVICE
-#ifdef NATS_SERVICE
+#ifdef PUBSUB_SERVICE
 // Callback function called by the sync uncertainty calculator if this node is the sync master to set the rate
 void ptp_sync_tuner(tl_translation_t params, std::string timeline_uuid, std::string node_name, uint64_t desired_accuracy)
 {
@@ -312,14 +302,8 @@ int PTP18::ChangeSyncRate()
 		std::cout << "PTP18: Sync rate unchanged" << std::endl;
 	}
 
-	// Log the rate or no change
-	if (LOGGING_FLAG == 1)
-	{
-		struct timespec now;
-		clock_gettime(CLOCK_REALTIME, &now);
-		rate_logfile << now.tv_sec << "," << mod_log_sync_interval  << "\n";
-		rate_logfile.flush();
-	}
+	// Trace the rate or no change
+	trace_servo_decision(timeline_index, current_sync_interval, mod_log_sync_interval, change_sync_flag, exactness_factor);
 	return 0;
 }
 #endif
@@ -335,6 +319,9 @@ int PTP18::SyncThread(int timelineid, int *timelinesfd, uint16_t timelines_size)
 	struct clock *clock = NULL;
 	int required_modes = 0;
 	int counter = 0;
+	qot_stat_t *clocksync_data_point = NULL;   // Per-timeline slots, reserved by clock_create
+	int *master_flag = NULL;
+	MetricsStream sample_metrics("qot_sync_samples", "alg=\"ptp\"", "synchronization samples taken in by the uncertainty service");
 	// int count = 0;
 	// int interval =0;
 
@@ -347,9 +334,9 @@ int PTP18::SyncThread(int timelineid, int *timelinesfd, uint16_t timelines_size)
     #endif
 
   	#ifdef QOT_TIMELINE_SERVICE
-    #ifdef NATS_SERVICE
-    // Connect to NATS Service
-    sync_uncertainty.natsConnect(nats_server.c_str());
+    #ifdef PUBSUB_SERVICE
+    // Connect to the pub-sub service
+    sync_uncertainty.pubsubConnect(nats_server.c_str());
 
     // Enable the uncertainty parameters to be published to the master sync
     std::string topic = "qot.timeline.";
@@ -435,6 +422,16 @@ int PTP18::SyncThread(int timelineid, int *timelinesfd, uint16_t timelines_size)
 	}
 	#endif
 
+	// Slots of this timeline's statistics and master flag
+	clocksync_data_point = QOT_SLOT(&ptp_clocksync_data_point, qot_stat_t, timelineid);
+	master_flag = QOT_SLOT(&timeline_master_flag, int, timelineid);
+	if (clocksync_data_point == NULL || master_flag == NULL)
+	{
+		BOOST_LOG_TRIVIAL(error) << "No statistics slot for timeline " << timelineid;
+		err = -1;
+		goto out;
+	}
+
 	err = 0;
 
 	while (is_running() && !kill) {
@@ -442,10 +439,13 @@ int PTP18::SyncThread(int timelineid, int *timelinesfd, uint16_t timelines_size)
 			break;
 
 		// Check if a new skew statistic data point has been added
-		if(last_clocksync_data_point.data_id < ptp_clocksync_data_point[timelineid].data_id)
+		if(last_clocksync_data_point.data_id < clocksync_data_point->data_id)
 		{
 			// New statistic received -> Replace old value
-			last_clocksync_data_point = ptp_clocksync_data_point[timelineid];
+			last_clocksync_data_point = *clocksync_data_point;
+			sample_metrics.Tick();
+			trace_sync_sample(timelineid, last_clocksync_data_point.offset, last_clocksync_data_point.drift,
+			                  last_clocksync_data_point.data_id, QOT_TRACE_ALG_PTP);
 
 			// Add Synchronization Uncertainty Sample
 			#ifdef QOT_TIMELINE_SERVICE
@@ -453,29 +453,23 @@ int PTP18::SyncThread(int timelineid, int *timelinesfd, uint16_t timelines_size)
 			#else
 			sync_uncertainty.CalculateBounds(last_clocksync_data_point.offset, ((double)last_clocksync_data_point.drift)/1000000000LL, timelinesfd[0], NULL, timeline_uuid);
 			#endif
-			if (LOGGING_FLAG == 1)
-			{
-				ptp_logfile << tl_clk_params->last << "," << tl_clk_params->mult << "," << tl_clk_params->nsec << "," << tl_clk_params->u_nsec << "," << tl_clk_params->u_mult  << "\n";
-				ptp_logfile.flush();
-			}
-
 		}
-		#ifdef NATS_SERVICE
+		#ifdef PUBSUB_SERVICE
 		// Check if this node is the master -> spawn a subscriber to listen to qot of other nodes
-		if (timeline_master_flag[timelineid] == 1 && !qot_subscriber_flag)
+		if (*master_flag == 1 && !qot_subscriber_flag)
 		{
 			qot_subscriber_flag = true;
 			// I am the master, I don't need to publish to myself
 			sync_uncertainty.StopMasterSyncPublish();	
 
 			// Start listening for messages from other nodes on the timeline
-			sync_uncertainty.natsSubscribe(topic, ptp_sync_tuner);
+			sync_uncertainty.pubsubSubscribe(topic, ptp_sync_tuner);
 		}
-		else if (timeline_master_flag[timelineid] == 0 && qot_subscriber_flag)
+		else if (*master_flag == 0 && qot_subscriber_flag)
 		{
 			qot_subscriber_flag = false;
 			// I am no longer the master, stop listening for messages from other nodes on the timeline
-			sync_uncertainty.natsUnSubscribe();
+			sync_uncertainty.pubsubUnSubscribe();
 			// I am no longer the master, start publishing
 			sync_uncertainty.StartMasterSyncPublish(topic);
 		}
@@ -113,6 +113,9 @@ namespace qot
 		 // Timeline Name
     	private: std::string timeline_uuid; 
 
+    	// Timeline index (source of the traced records)
+    	private: int timeline_index;
+
     	// Node name
     	private: std::string node_uuid;
 
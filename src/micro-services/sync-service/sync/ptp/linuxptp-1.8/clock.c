@@ -49,10 +49,14 @@
 
 /* QoT Types Header */
 #include "../../../../../qot_types.h"
+#include "../../../../../qot_slot_table.h"
 
 /* New header for the Quartz Timeline Service */
 #include "../local_timeline.h"
 
+/* Binary sync trace */
+#include "../../../qot_trace.h"
+
 #ifdef PTP_QUARTZ
 /* Added PTP Timeline clock ops */
 #include "../qot_tlclockops.h"
@@ -143,8 +147,11 @@ struct clock {
 	#endif
 };
 
-/* Global Clock Structure */
-struct clock timeline_clocks[MAX_TIMELINES];
+/* Clock of each timeline, indexed by timeline id */
+qot_slot_table_t timeline_clocks = QOT_SLOT_TABLE_INIT(struct clock);
+
+// Global Variable for Sharing Computed Clock Statistic from Sync to Uncertainty Calculation (indexed by timeline id)
+qot_slot_table_t ptp_clocksync_data_point = QOT_SLOT_TABLE_INIT(qot_stat_t);
 
 static void handle_state_decision_event(struct clock *c);
 static int clock_resize_pollfd(struct clock *c, int new_nports);
@@ -870,8 +877,14 @@ static void clock_remove_port(struct clock *c, struct port *p)
 }
 
 #ifdef PTP_QUARTZ
-// Flag indicating if the clock is the master for this timeline
-int timeline_master_flag[MAX_TIMELINES];
+// Flag indicating if the clock is the master for this timeline (int slots indexed by timeline id)
+qot_slot_table_t timeline_master_flag = QOT_SLOT_TABLE_INIT(int);
+
+/* Set the master flag of the clock's timeline (slot reserved by clock_create) */
+static void clock_set_timeline_master(struct clock *c, int flag)
+{
+	*QOT_SLOT(&timeline_master_flag, int, c->timelineid) = flag;
+}
 #endif
 
 struct clock *clock_create(enum clock_type type, struct config *config,
@@ -882,7 +895,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	int fadj = 0, max_adj = 0, sw_ts = timestamping == TS_SOFTWARE ? 1 : 0;
 	enum servo_type servo = config_get_int(config, NULL, "clock_servo");
 	int phc_index, required_modes = 0;
-	struct clock *c = &timeline_clocks[timelineid];//&the_clock;
+	struct clock *c = QOT_SLOT(&timeline_clocks, struct clock, timelineid);//&the_clock;
 	struct port *p;
 	unsigned char oui[OUI_LEN];
 	char phc[32], *tmp;
@@ -893,6 +906,14 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 	clock_gettime(CLOCK_REALTIME, &ts);
 	srandom(ts.tv_sec ^ ts.tv_nsec);
 
+	/* Reserve the per-timeline slots up front so later accesses cannot fail */
+	if (!c || !QOT_SLOT(&ptp_clocksync_data_point, qot_stat_t, timelineid))
+		return NULL;
+	#ifdef PTP_QUARTZ
+	if (!QOT_SLOT(&timeline_master_flag, int, timelineid))
+		return NULL;
+	#endif
+
 	if (c->nports)
 		clock_destroy(c);
 
@@ -909,7 +930,7 @@ struct clock *clock_create(enum clock_type type, struct config *config,
 
 	#ifdef PTP_QUARTZ
 	// Set the timeline node is master flag to 0
-	timeline_master_flag[c->timelineid] = 0;
+	*QOT_SLOT(&timeline_master_flag, int, timelineid) = 0;
 	#endif
 
 	/* Initialize the defaultDS. */
@@ -1659,8 +1680,15 @@ int clock_switch_phc(struct clock *c, int phc_index)
 	return 0;
 }
 
-// Global Variable for Sharing Computed Clock Statistic from Sync to Uncertainty Calculation
-qot_stat_t ptp_clocksync_data_point[MAX_TIMELINES];
+/* Add a statistic for the QoT uncertainty service of the clock's timeline to process */
+static void clock_add_sync_stat(struct clock *c, double adj)
+{
+	qot_stat_t *stat = QOT_SLOT(&ptp_clocksync_data_point, qot_stat_t, c->timelineid);
+
+	stat->offset = tmv_to_nanoseconds(c->master_offset);
+	stat->drift = (int64_t)ceil(adj);
+	stat->data_id++;
+}
 
 #ifdef PTP_QUARTZ
 /* Quartz function to project core time to timeline time */
@@ -1799,6 +1827,8 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 		#ifdef PTP_QUARTZ
 		clock_timeline_set_freq(c->tml_clk_params, -adj);
 		clock_timeline_step(c->tml_clk_params, -tmv_to_nanoseconds(c->master_offset));
+		qot_trace_emit(QOT_TRACE_STEP, 0, c->timelineid, -tmv_to_nanoseconds(c->master_offset),
+			       (int64_t) -adj, QOT_TRACE_ALG_PTP, 0, 0, 0);
 		#else
 		clockadj_set_freq(c->tml_clkid, -adj);
 		clockadj_step(c->tml_clkid, -tmv_to_nanoseconds(c->master_offset));
@@ -1811,9 +1841,7 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 		// }
 		tsproc_reset(c->tsproc, 0);
 		// Add Statistic for the QoT Uncertainty Service to process
-		ptp_clocksync_data_point[c->timelineid].offset = tmv_to_nanoseconds(c->master_offset);
-		ptp_clocksync_data_point[c->timelineid].drift = (int64_t)ceil(adj);
-		ptp_clocksync_data_point[c->timelineid].data_id++;
+		clock_add_sync_stat(c, adj);
 		break;
 	case SERVO_LOCKED:
 		/* Changes for QoT Stack */
@@ -1827,9 +1855,7 @@ enum servo_state clock_synchronize(struct clock *c, tmv_t ingress, tmv_t origin)
 		// if (c->sanity_check)
 		// 	clockcheck_set_freq(c->sanity_check, -adj);
 		// Add Statistic for the QoT Uncertainty Service to process
-		ptp_clocksync_data_point[c->timelineid].offset = tmv_to_nanoseconds(c->master_offset);
-		ptp_clocksync_data_point[c->timelineid].drift = (int64_t)ceil(adj);
-		ptp_clocksync_data_point[c->timelineid].data_id++;
+		clock_add_sync_stat(c, adj);
 		break;
 	}
 	return state;
@@ -1913,13 +1939,13 @@ static void handle_state_decision_event(struct clock *c)
 		switch (ps) {
 		case PS_LISTENING:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 0;
+			clock_set_timeline_master(c, 0);
 			#endif
 			event = EV_NONE;
 			break;
 		case PS_GRAND_MASTER:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 1;
+			clock_set_timeline_master(c, 1);
 			#endif
 			pr_notice("assuming the grand master role");
 			clock_update_grandmaster(c);
@@ -1927,26 +1953,26 @@ static void handle_state_decision_event(struct clock *c)
 			break;
 		case PS_MASTER:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 1;
+			clock_set_timeline_master(c, 1);
 			#endif
 			event = EV_RS_MASTER;
 			break;
 		case PS_PASSIVE:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 0;
+			clock_set_timeline_master(c, 0);
 			#endif
 			event = EV_RS_PASSIVE;
 			break;
 		case PS_SLAVE:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 0;
+			clock_set_timeline_master(c, 0);
 			#endif
 			clock_update_slave(c);
 			event = EV_RS_SLAVE;
 			break;
 		default:
 			#ifdef PTP_QUARTZ
-			timeline_master_flag[c->timelineid] = 0;
+			clock_set_timeline_master(c, 0);
 			#endif
 			event = EV_FAULT_DETECTED;
 			break;
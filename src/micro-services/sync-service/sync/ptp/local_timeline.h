@@ -31,6 +31,7 @@
 #define NTP_GLOB_TLCLOCK_DATA_QOT_H
 
 #include "../../../../qot_types.h"
+#include "../../../../qot_slot_table.h"
 
 /* Flag to protect QoT Stack Code */
 #define PTP_QUARTZ 1
@@ -55,8 +56,8 @@ extern tl_translation_t* local_clk_params;	// Local Timeline translation Params
 // Variable to kill the sync service main thread
 extern int sync_service_running;
 
-// Variable to check if node is the master for this timeline -> defined in linuxptp-1.8/clock.c
-extern int timeline_master_flag[MAX_TIMELINES];
+// Variable to check if node is the master for each timeline (int slots by timeline id) -> defined in linuxptp-1.8/clock.c
+extern qot_slot_table_t timeline_master_flag;
 
 #endif
 
@@ -51,6 +51,9 @@
 // Include local timeline header
 #include "local_timeline.h"
 
+// Include fault injection hooks
+#include "../../qot_fault.h"
+
 /* ID of the PHC (or software clock) which PTP is getting timestamps from */
 clockid_t phc_clkid = CLOCK_REALTIME;          /* "NIC" clock ID (clock providing PTP timestamps) */
 
@@ -64,19 +67,23 @@ int qot_set_phc(clockid_t phc_clockid)
 qot_return_t qot_loc2rem(utimepoint_t *est, int period, tl_translation_t* clk_params)
 {    
     int64_t val;
+    tl_translation_t params;
 
     if (!clk_params)
         return QOT_RETURN_TYPE_ERR;
 
+    // Lock-free consistent snapshot of the shared parameters
+    tl_translation_read(clk_params, &params);
+
     val = TP_TO_nSEC(est->estimate);
 
     // Check if this is correct -> makes the assumption that val is mostly greater than 1s (1 billion ns) (consider using floating point ops)
     if (period)
-        val += (clk_params->mult*val)/1000000000L;
+        val += (params.mult*val)/1000000000L;
     else
     {
-        val -= clk_params->last;
-        val  = clk_params->nsec + val + ((clk_params->mult*val)/1000000000L);
+        val -= params.last;
+        val  = params.nsec + val + ((params.mult*val)/1000000000L);
     }
     TP_FROM_nSEC(est->estimate, val); 
 
@@ -113,10 +120,12 @@ static int qot_timeline_clock_adjfreq(s32 ppb, tl_translation_t* clk_params)
     ns = TP_TO_nSEC(utp.estimate);
 
     // Write the new parameters to shared memory
+    tl_translation_write_begin(clk_params);
     clk_params->nsec += (ns - clk_params->last)
         + (clk_params->mult * (ns - clk_params->last))/1000000000L; // ULL Changed to L -> Anon
     clk_params->last  = ns;
-    clk_params->mult = (s64) ppb; // typecast added to s64
+    clk_params->mult = (s64) ppb + qot_fault_clock_freq(); // typecast added to s64, plus an injected frequency error
+    tl_translation_write_end(clk_params);
     return 0;
 }
 
@@ -131,7 +140,9 @@ static int qot_timeline_clock_adjtime(s64 delta, tl_translation_t* clk_params)
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
+    tl_translation_write_begin(clk_params);
     clk_params->nsec += delta; 
+    tl_translation_write_end(clk_params);
     
     return 0;
 }
@@ -161,8 +172,10 @@ int qot_timeline_settime(const struct timespec *tp, tl_translation_t* clk_params
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
+    tl_translation_write_begin(clk_params);
     clk_params->last = ns;
     clk_params->nsec = tp->tv_sec*1000000000LL + (s64)tp->tv_nsec;
+    tl_translation_write_end(clk_params);
     
     return 0;
 }
@@ -172,6 +185,7 @@ int qot_timeline_gettime(struct timespec *tp, tl_translation_t* clk_params)
     utimepoint_t utp;
     s64 ns;
     s64 now;
+    tl_translation_t params;
    
     // Get the core time
     struct timespec ts;
@@ -179,8 +193,9 @@ int qot_timeline_gettime(struct timespec *tp, tl_translation_t* clk_params)
     timepoint_from_timespec(&utp.estimate, &ts);
 
     ns = TP_TO_nSEC(utp.estimate);
-    now = clk_params->nsec + (ns - clk_params->last)
-          + (clk_params->mult * (ns - clk_params->last))/1000000000L; // Changed from ULL to L
+    tl_translation_read(clk_params, &params);
+    now = params.nsec + (ns - params.last)
+          + (params.mult * (ns - params.last))/1000000000L; // Changed from ULL to L
 
     TP_FROM_nSEC(utp.estimate, now);
     timespec_from_timepoint(tp, &utp.estimate);
@@ -193,6 +208,9 @@ long dialed_frequency = 0;
 int qot_timeline_adjtime(struct timex *tx, tl_translation_t* clk_params)
 {
     int err = -EOPNOTSUPP;
+    s64 step = qot_fault_clock_step();
+    if (step != 0)
+        qot_timeline_clock_adjtime(step, clk_params); // Injected phase step
     if (tx->modes & ADJ_SETOFFSET) {
         struct timespec ts;
         s64 delta;
@@ -31,9 +31,10 @@
 #define PTP_UNCERTAINTY_DATA_QOT_H
 
 #include "../../../../qot_types.h"
+#include "../../../../qot_slot_table.h"
 
-// Clock Statistics Data Point -> variable defined in ptp/clock.c
-extern qot_stat_t ptp_clocksync_data_point[MAX_TIMELINES];
+// Clock Statistics Data Point (qot_stat_t slots by timeline id) -> variable defined in ptp/clock.c
+extern qot_slot_table_t ptp_clocksync_data_point;
 
 #endif
 
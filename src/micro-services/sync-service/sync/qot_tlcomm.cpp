@@ -63,6 +63,16 @@ using namespace qot;
 
 /* Private functions */
 
+// Map a clock segment with read-write access (live parameters and their history)
+static void* map_clk_segment(int clk_fd)
+{
+    struct stat st;
+    size_t size = sizeof(tl_translation_t);
+    if (fstat(clk_fd, &st) == 0 && size_t(st.st_size) > size)
+        size = st.st_size;
+    return mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, clk_fd, 0);
+}
+
 /* Public functions */
 
 // Constructor -> Connect to the socket 
@@ -164,7 +174,7 @@ tl_translation_t* TLCommunicator::request_clk_memory(int timeline_id)
             printf("Received timeline clock shm descriptor = %d\n", clk_fd);
 
         // Map the shared memory region into the memory space
-        clk_shm_base = mmap(0, sizeof(tl_translation_t), PROT_READ | PROT_WRITE, MAP_SHARED, clk_fd, 0);
+        clk_shm_base = map_clk_segment(clk_fd);
         if (clk_shm_base == MAP_FAILED) {
             printf("Shared memory mmap failed: \n");
             clk_shm_base = NULL;
@@ -252,7 +262,7 @@ tl_translation_t* TLCommunicator::request_ov_clk_memory(int timeline_id)
             printf("Received timeline overlay clock shm descriptor = %d\n", clk_fd);
 
         // Map the shared memory region into the memory space
-        clk_shm_base = mmap(0, sizeof(tl_translation_t), PROT_READ | PROT_WRITE, MAP_SHARED, clk_fd, 0);
+        clk_shm_base = map_clk_segment(clk_fd);
         if (clk_shm_base == MAP_FAILED) {
             printf("Shared memory mmap failed: \n");
             clk_shm_base = NULL;
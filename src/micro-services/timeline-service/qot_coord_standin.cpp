@@ -0,0 +1,358 @@
+/*
+ * @file qot_coord_standin.cpp
+ * @brief In-memory stand-in for the Coordination Service REST API (for tests)
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// C++ Rest SDK Headers
+#include <cpprest/http_listener.h>
+#include <cpprest/json.h>
+
+// StdLib Headers
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+extern "C"
+{
+    #include <signal.h>
+    #include <stdlib.h>
+    #include <unistd.h>
+}
+
+using namespace web;
+using namespace web::http;
+using namespace web::http::experimental::listener;
+
+// Default address the stand-in listens on (same as the timeline service default)
+#define STANDIN_URL "http://localhost:8502"
+
+/* In-memory coordination state */
+struct standin_node {
+   unsigned long long accuracy;
+   unsigned long long resolution;
+};
+
+struct standin_server {
+   std::string type;
+   int stratum;
+};
+
+struct standin_timeline {
+   int id;
+   std::string meta_data;
+   std::map<std::string, standin_node> nodes;
+   std::map<std::string, standin_server> servers;
+};
+
+static std::mutex state_mutex;
+static std::map<std::string, standin_timeline> timelines;
+static int next_timeline_id = 1;
+static int response_delay_ms = 0;
+static unsigned long long request_count = 0;
+static volatile sig_atomic_t running = 1;
+
+static void exit_handler(int s)
+{
+   running = 0;
+}
+
+/* JSON views of the state (field names follow the coordination service serializers) */
+static json::value timeline_json(const std::string &name, const standin_timeline &tl)
+{
+   auto value = json::value::object();
+   value["id"] = json::value::number(tl.id);
+   value["name"] = json::value::string(name);
+   value["meta_data"] = json::value::string(tl.meta_data);
+   return value;
+}
+
+static json::value node_json(const std::string &name, const std::string &tl_name, const standin_node &node)
+{
+   auto value = json::value::object();
+   value["name"] = json::value::string(name);
+   value["timeline_name"] = json::value::string(tl_name);
+   value["accuracy"] = json::value::number(uint64_t(node.accuracy));
+   value["resolution"] = json::value::number(uint64_t(node.resolution));
+   value["ip"] = json::value::string("127.0.0.1");
+   return value;
+}
+
+static json::value server_json(const std::string &name, const standin_server &server)
+{
+   auto value = json::value::object();
+   value["name"] = json::value::string(name);
+   value["server_type"] = json::value::string(server.type);
+   value["stratum"] = json::value::number(server.stratum);
+   return value;
+}
+
+/* Serve one request, path is relative to /api/service/timelines */
+static void handle_request(http_request request)
+{
+   std::vector<utility::string_t> path = uri::split_path(uri::decode(request.relative_uri().path()));
+   method mtd = request.method();
+   json::value body = json::value::null();
+   if (mtd == methods::POST || mtd == methods::PUT)
+      body = request.extract_json().get();
+
+   // Emulate a slow coordination service
+   if (response_delay_ms > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(response_delay_ms));
+
+   std::unique_lock<std::mutex> lock(state_mutex);
+   request_count++;
+   std::cout << "qot_coord_standin: " << request_count << " " << mtd << " " << request.relative_uri().path() << std::endl;
+
+   if (path.size() < 3 || path[0] != "api" || path[1] != "service" || path[2] != "timelines")
+   {
+      request.reply(status_codes::NotFound);
+      return;
+   }
+   path.erase(path.begin(), path.begin() + 3);
+
+   // Timeline collection
+   if (path.empty())
+   {
+      if (mtd == methods::GET)
+      {
+         auto answer = json::value::array();
+         int i = 0;
+         for (std::map<std::string, standin_timeline>::iterator it = timelines.begin(); it != timelines.end(); ++it)
+            answer[i++] = timeline_json(it->first, it->second);
+         request.reply(status_codes::OK, answer);
+      }
+      else if (mtd == methods::POST && body.has_field("name"))
+      {
+         std::string name = body.at("name").as_string();
+         if (timelines.find(name) == timelines.end())
+         {
+            timelines[name].id = next_timeline_id++;
+            timelines[name].meta_data = "NULL";
+         }
+         request.reply(status_codes::Created);
+      }
+      else
+      {
+         request.reply(status_codes::BadRequest);
+      }
+      return;
+   }
+
+   std::map<std::string, standin_timeline>::iterator tl = timelines.find(path[0]);
+   if (tl == timelines.end())
+   {
+      request.reply(status_codes::NotFound);
+      return;
+   }
+
+   // Single timeline
+   if (path.size() == 1)
+   {
+      if (mtd == methods::GET)
+      {
+         auto answer = timeline_json(tl->first, tl->second);
+         auto nodes = json::value::array();
+         int i = 0;
+         for (std::map<std::string, standin_node>::iterator it = tl->second.nodes.begin(); it != tl->second.nodes.end(); ++it)
+            nodes[i++] = node_json(it->first, tl->first, it->second);
+         answer["nodes"] = nodes;
+         request.reply(status_codes::OK, answer);
+      }
+      else if (mtd == methods::PUT)
+      {
+         if (body.has_field("meta_data"))
+            tl->second.meta_data = body.at("meta_data").as_string();
+         request.reply(status_codes::NoContent);
+      }
+      else if (mtd == methods::DEL)
+      {
+         timelines.erase(tl);
+         request.reply(status_codes::NoContent);
+      }
+      else
+      {
+         request.reply(status_codes::BadRequest);
+      }
+      return;
+   }
+
+   // Best QoT demanded on the timeline
+   if (path.size() == 2 && path[1] == "qot" && mtd == methods::GET)
+   {
+      unsigned long long accuracy = 0, resolution = 0;
+      for (std::map<std::string, standin_node>::iterator it = tl->second.nodes.begin(); it != tl->second.nodes.end(); ++it)
+      {
+         if (it == tl->second.nodes.begin() || it->second.accuracy < accuracy)
+            accuracy = it->second.accuracy;
+         if (it == tl->second.nodes.begin() || it->second.resolution < resolution)
+            resolution = it->second.resolution;
+      }
+      auto answer = json::value::object();
+      answer["accuracy"] = json::value::number(uint64_t(accuracy));
+      answer["resolution"] = json::value::number(uint64_t(resolution));
+      request.reply(status_codes::OK, answer);
+      return;
+   }
+
+   // Nodes
+   if (path[1] == "nodes")
+   {
+      if (path.size() == 2 && mtd == methods::GET)
+      {
+         auto answer = json::value::object();
+         answer["num_nodes"] = json::value::number(int(tl->second.nodes.size()));
+         request.reply(status_codes::OK, answer);
+      }
+      else if (path.size() == 2 && mtd == methods::POST && body.has_field("name"))
+      {
+         standin_node &node = tl->second.nodes[body.at("name").as_string()];
+         node.accuracy = body.has_field("accuracy") ? body.at("accuracy").as_number().to_uint64() : 0;
+         node.resolution = body.has_field("resolution") ? body.at("resolution").as_number().to_uint64() : 0;
+         request.reply(status_codes::Created);
+      }
+      else if (path.size() == 3)
+      {
+         std::map<std::string, standin_node>::iterator node = tl->second.nodes.find(path[2]);
+         if (node == tl->second.nodes.end())
+         {
+            request.reply(status_codes::NotFound);
+         }
+         else if (mtd == methods::GET)
+         {
+            request.reply(status_codes::OK, node_json(node->first, tl->first, node->second));
+         }
+         else if (mtd == methods::PUT)
+         {
+            if (body.has_field("accuracy"))
+               node->second.accuracy = body.at("accuracy").as_number().to_uint64();
+            if (body.has_field("resolution"))
+               node->second.resolution = body.at("resolution").as_number().to_uint64();
+            request.reply(status_codes::NoContent);
+         }
+         else if (mtd == methods::DEL)
+         {
+            tl->second.nodes.erase(node);
+            request.reply(status_codes::NoContent);
+         }
+         else
+         {
+            request.reply(status_codes::BadRequest);
+         }
+      }
+      else
+      {
+         request.reply(status_codes::BadRequest);
+      }
+      return;
+   }
+
+   // Timeline servers
+   if (path[1] == "servers")
+   {
+      if (path.size() == 2 && mtd == methods::GET)
+      {
+         auto answer = json::value::array();
+         int i = 0;
+         for (std::map<std::string, standin_server>::iterator it = tl->second.servers.begin(); it != tl->second.servers.end(); ++it)
+            answer[i++] = server_json(it->first, it->second);
+         request.reply(status_codes::OK, answer);
+      }
+      else if (path.size() == 2 && mtd == methods::POST && body.has_field("name"))
+      {
+         standin_server &server = tl->second.servers[body.at("name").as_string()];
+         server.type = body.has_field("server_type") ? body.at("server_type").as_string() : std::string("local");
+         server.stratum = body.has_field("stratum") ? body.at("stratum").as_integer() : 3;
+         request.reply(status_codes::Created);
+      }
+      else if (path.size() == 3)
+      {
+         std::map<std::string, standin_server>::iterator server = tl->second.servers.find(path[2]);
+         if (server == tl->second.servers.end())
+         {
+            request.reply(status_codes::NotFound);
+         }
+         else if (mtd == methods::GET)
+         {
+            request.reply(status_codes::OK, server_json(server->first, server->second));
+         }
+         else if (mtd == methods::DEL)
+         {
+            tl->second.servers.erase(server);
+            request.reply(status_codes::NoContent);
+         }
+         else
+         {
+            request.reply(status_codes::BadRequest);
+         }
+      }
+      else
+      {
+         request.reply(status_codes::BadRequest);
+      }
+      return;
+   }
+
+   request.reply(status_codes::NotFound);
+}
+
+/* Stand-in Main Function: qot_coord_standin [url] [response delay ms] */
+int main(int argc, char *argv[])
+{
+   std::string url = STANDIN_URL;
+   if (argc > 1)
+      url = std::string(argv[1]);
+
+   if (argc > 2)
+      response_delay_ms = atoi(argv[2]);
+
+   signal(SIGINT, exit_handler);
+   signal(SIGTERM, exit_handler);
+
+   http_listener listener(url);
+   listener.support(handle_request);
+   try
+   {
+      listener.open().wait();
+   }
+   catch (std::exception const & e)
+   {
+      std::cout << "qot_coord_standin: unable to listen on " << url << ": " << e.what() << std::endl;
+      return -1;
+   }
+   std::cout << "qot_coord_standin: listening on " << url << " (delay " << response_delay_ms << " ms)" << std::endl;
+
+   while (running)
+      sleep(1);
+
+   listener.close().wait();
+   std::cout << "qot_coord_standin: served " << request_count << " requests" << std::endl;
+   return 0;
+}
@@ -51,11 +51,6 @@ TimelineClock* qot_core::LocalClock = NULL;
 void TimelineCore::update_timeline_qot(std::string meta_data)
 {
     timequality_t demand;
-    // Initialize the quality parameters to a high value
-    demand.resolution.sec = 1000000000;
-    demand.resolution.asec = 0;
-    demand.accuracy.below = demand.resolution;
-    demand.accuracy.above = demand.resolution;
 
     // If no bindings exist then set to zero
     if (binding_map.empty())
@@ -67,28 +62,35 @@ void TimelineCore::update_timeline_qot(std::string meta_data)
         tl_clock->set_quality(demand);
         if (tl_overlay_clock)
             tl_overlay_clock->set_quality(demand);
+        demand_valid = false;
         return;
     }
 
-    for (std::map<int,qot_binding_t>::iterator it=binding_map.begin(); it!=binding_map.end(); ++it)
-    {
-        // Update resolution as minimum required resolution
-        if (timelength_cmp(&demand.resolution, &it->second.demand.resolution) == -1)
-            demand.resolution = it->second.demand.resolution;
+    // The tightest requirements of the bindings
+    demand = binding_demands.tightest();
 
-        // Update accuracy lower bound as the minimum required accuracy
-        if (timelength_cmp(&demand.accuracy.below, &it->second.demand.accuracy.below) == -1)
-            demand.accuracy.below = it->second.demand.accuracy.below;
+    // Nothing to propagate if the aggregate did not change (meta data only comes with the first binding)
+    bool has_meta_data = !meta_data.empty() && meta_data.compare("NULL") != 0;
+    if (demand_valid && !has_meta_data
+        && timelength_cmp(&demand.resolution, &current_demand.resolution) == 0
+        && timelength_cmp(&demand.accuracy.below, &current_demand.accuracy.below) == 0
+        && timelength_cmp(&demand.accuracy.above, &current_demand.accuracy.above) == 0)
+        return;
+    current_demand = demand;
+    demand_valid = true;
 
-        // Update accuracy lower bound as the minimum required accuracy
-        if (timelength_cmp(&demand.accuracy.above, &it->second.demand.accuracy.above) == -1)
-            demand.accuracy.above = it->second.demand.accuracy.above;
-    }
     // Set the demand for the timeline clock
     tl_clock->set_quality(demand);
     if (tl_overlay_clock)
-            tl_overlay_clock->set_quality(demand);
+        tl_overlay_clock->set_quality(demand);
 
+    // Propagate to the coordination and sync services
+    qot_updates.schedule(demand, meta_data);
+}
+
+/* Push a QoT demand to the coordination service and the sync service */
+void TimelineCore::send_qot_update(const timequality_t &demand, const std::string &meta_data)
+{
     // Update the qot on the rest interface
     unsigned long long accuracy = TL_TO_nSEC(demand.accuracy.above);
     unsigned long long resolution = TL_TO_nSEC(demand.resolution);
@@ -103,15 +105,24 @@ void TimelineCore::update_timeline_qot(std::string meta_data)
     communicator.send_request(msg);
 
     // If local timeline start or update the peer sync -> If peers empty assume PTP?
-    if (timeline_info.type == QOT_TIMELINE_LOCAL && !peers.empty())
+    if (timeline_info.type == QOT_TIMELINE_LOCAL && !get_peers().empty())
         start_peer_sync();
 }
 
+/* Copy of the peer list, which the coordination service subscriber replaces */
+std::vector<std::string> TimelineCore::get_peers()
+{
+    std::lock_guard<std::mutex> lock(binding_mutex);
+    return peers;
+}
+
 /* Public functions */
 
 /* Constructor: Create a new timeline */
 TimelineCore::TimelineCore(qot_timeline_t& timeline, TimelineRegistry& registry, std::string &node_name, std::string &rest_server, std::string &nats_server)
- : tl_registry(registry), status_flag(0), tl_clock(NULL), tl_overlay_clock(NULL), rest_interface(rest_server), node_uuid(node_name), subscriber(nats_server, std::string(timeline.name), this)
+ : tl_registry(registry), status_flag(0), tl_clock(NULL), tl_overlay_clock(NULL), rest_interface(rest_server), node_uuid(node_name), subscriber(nats_server, std::string(timeline.name), this),
+   closing(false), demand_valid(false),
+   qot_updates([this](const timequality_t &demand, const std::string &meta_data) { send_qot_update(demand, meta_data); })
 {
     qot_return_t retval;
     // Register the timeline into the registry
@@ -175,11 +186,8 @@ TimelineCore::TimelineCore(qot_timeline_t& timeline, TimelineRegistry& registry,
     /* Update the timeline registry with the timeline ID */
     registry.qot_timeline_set_info(timeline_new);
 
-    /* Add the class to the registry */
-    registry.qot_tl_class_register(timeline_new.index, (void*)this);
-
     /* Subscribe to notifications from the Coordination Service */
-    subscriber.natsSubscribe();
+    subscriber.pubsubSubscribe();
 
     /* Register Timeline with Coordination Service */
     rest_interface.post_timeline(std::string(timeline_new.name));
@@ -187,6 +195,9 @@ TimelineCore::TimelineCore(qot_timeline_t& timeline, TimelineRegistry& registry,
     /* Copy the Timeline data structure with the assigned ID back to the user and to the in class data structure*/
     timeline = timeline_new;
     timeline_info = timeline;
+
+    /* Add the class to the registry last, so requests never reach a partially constructed timeline */
+    registry.qot_tl_class_register(timeline_new.index, (void*)this);
     
     std::cout << "qot_timeline: Timeline " << timeline.index << " created name is " << timeline.name << std::endl;
 
@@ -207,6 +218,15 @@ TimelineCore::~TimelineCore()
     // Remove the class from the registry
     tl_registry.qot_tl_class_remove(timeline_info.index,1);
 
+    // Meta data arriving from now on is dropped
+    {
+        std::lock_guard<std::mutex> lock(binding_mutex);
+        closing = true;
+    }
+
+    // Flush any pending QoT update before the timeline goes away
+    qot_updates.stop();
+
     // Send the sync service a message
     // qot_timeline_msg_t msg;
     // msg.msgtype = TIMELINE_DESTROY;
@@ -221,10 +241,10 @@ TimelineCore::~TimelineCore()
     rest_interface.delete_node(std::string(timeline_info.name), node_uuid);
 
     // Remove the subscriber
-    subscriber.natsUnSubscribe();
+    subscriber.pubsubUnSubscribe();
 
     // Stop the Peer Sync if it exists
-    if (timeline_info.type == QOT_TIMELINE_LOCAL && !peers.empty())
+    if (timeline_info.type == QOT_TIMELINE_LOCAL && !get_peers().empty())
     {
         stop_peer_sync();
     }
@@ -251,7 +271,6 @@ qot_timeline_t TimelineCore::get_timeline_info()
 // Create a binding to this timeline
 qot_return_t TimelineCore::create_binding(qot_binding_t &binding)
 {
-    std::string meta_data;
     binding_mutex.lock();
     
     // Check if the binding exists
@@ -282,43 +301,47 @@ qot_return_t TimelineCore::create_binding(qot_binding_t &binding)
 
     // Populate the map with new binding
     binding_map[binding.id] = binding;
+    binding_demands.add(binding.demand);
 
     if (binding.id == 0)
     {
         // First binding post the node 
         rest_interface.post_node(std::string(timeline_info.name), node_uuid, accuracy, resolution);
 
-        // Check if the timeline is local & PTP is being used (peers.empty())
+        // Check if the timeline is local & PTP is being used (peers.empty()) -> the PTP domain is in the
+        // timeline meta data, which is looked up without delaying the bind and applied when it arrives
         if (timeline_info.type == QOT_TIMELINE_LOCAL && peers.empty())
         {
-            meta_data = rest_interface.get_timeline_metadata(std::string(timeline_info.name));
-            std::cout << "qot_timeline: Got Timeline Metadata " << meta_data << "\n";
-            // Check if meta-data is not set
-            if ((meta_data.compare(std::string("NULL"))) == 0) 
-            {
-                // Get the coordination ID
-                int coord_id = rest_interface.get_timeline_coord_id(std::string(timeline_info.name));
-                
-                // Set a PTP domain
-                meta_data = std::to_string(coord_id);
-                rest_interface.put_timeline_metadata(std::string(timeline_info.name), meta_data);
-            }
+            rest_interface.init_timeline_metadata_async(std::string(timeline_info.name),
+                [this](std::string meta_data) { apply_timeline_metadata(meta_data); });
         }
     }
 
-    update_timeline_qot(meta_data);
+    update_timeline_qot(std::string());
     binding_mutex.unlock();
     return QOT_RETURN_TYPE_OK;
 }
 
+// Apply timeline meta data received from the coordination service (runs on the REST worker)
+void TimelineCore::apply_timeline_metadata(const std::string &meta_data)
+{
+    std::lock_guard<std::mutex> lock(binding_mutex);
+    if (closing || meta_data.compare("NULL") == 0)
+        return;
+    std::cout << "qot_timeline: Got Timeline Metadata " << meta_data << "\n";
+    update_timeline_qot(meta_data);
+}
+
 // Delete a binding from this timeline
 qot_return_t TimelineCore::delete_binding(qot_binding_t binding)
 {
     binding_mutex.lock();
     // Check if the binding exists
-    if (binding_map.find(binding.id) != binding_map.end())
+    std::map<int, qot_binding_t>::iterator it = binding_map.find(binding.id);
+    if (it != binding_map.end())
     {
-        binding_map.erase(binding.id);
+        binding_demands.remove(it->second.demand);
+        binding_map.erase(it);
         binding_ids.erase(binding.id);
         update_timeline_qot(std::string("NULL"));
         binding_mutex.unlock();
@@ -336,9 +359,15 @@ qot_return_t TimelineCore::update_binding(qot_binding_t &binding)
 {
     binding_mutex.lock();
     // Check if the binding exists
-    if (binding_map.find(binding.id) != binding_map.end())
+    std::map<int, qot_binding_t>::iterator it = binding_map.find(binding.id);
+    if (it == binding_map.end())
+    {
+        binding_mutex.unlock();
         return QOT_RETURN_TYPE_ERR;
-    binding_map[binding.id] = binding;
+    }
+    binding_demands.remove(it->second.demand);
+    it->second = binding;
+    binding_demands.add(binding.demand);
     update_timeline_qot(std::string("NULL"));
     binding_mutex.unlock();
     return QOT_RETURN_TYPE_OK;
@@ -447,6 +476,7 @@ qot_return_t TimelineCore::update_local_coordination_info(std::vector<qot_node_p
 qot_return_t TimelineCore::update_local_peers(std::vector<std::string> &node_vector)
 {
     std::cout << "TimelineCore: Updating list of peer sync nodes\n";
+    std::lock_guard<std::mutex> lock(binding_mutex);
     peers = node_vector;
     return QOT_RETURN_TYPE_OK;   
 }
@@ -461,7 +491,8 @@ qot_return_t TimelineCore::start_peer_sync()
     std::cout << "TimelineCore: Starting peer sync\n";
 
     // Start the sync client (sync service) for each of the peers
-    for (auto it = peers.begin(); it != peers.end(); ++it)
+    std::vector<std::string> peer_list = get_peers();
+    for (auto it = peer_list.begin(); it != peer_list.end(); ++it)
     {
         msg.msgtype = PEER_START;
         msg.data = *it;
@@ -479,7 +510,8 @@ qot_return_t TimelineCore::stop_peer_sync()
     msg.info = timeline_info;
 
     // Stop the sync client (sync service) for each of the peers
-    for (auto it = peers.begin(); it != peers.end(); ++it)
+    std::vector<std::string> peer_list = get_peers();
+    for (auto it = peer_list.begin(); it != peer_list.end(); ++it)
     {
         msg.msgtype = PEER_STOP;
         msg.data = *it;
@@ -32,6 +32,7 @@
 
 #include <map>
 #include <mutex>
+#include <set>
 #include <vector>
 
 // Timeline Coordination Service REST Interface
@@ -55,6 +56,9 @@ extern "C"
 // Include the timeline subscriber
 #include "qot_timeline_subscriber.hpp"
 
+// Include the binding demand aggregate and the update queue
+#include "qot_timeline_demand.hpp"
+
 namespace qot_core
 {
 	// Must be initialized in the timeline service
@@ -133,6 +137,15 @@ namespace qot_core
 		// Update the timeline QoT requirements
 		private: void update_timeline_qot(std::string meta_data); 
 
+		// Apply timeline meta data received from the coordination service
+		private: void apply_timeline_metadata(const std::string &meta_data);
+
+		// Push a QoT demand to the coordination service and the sync service
+		private: void send_qot_update(const timequality_t &demand, const std::string &meta_data);
+
+		// Copy of the peer list (taken under binding_mutex)
+		private: std::vector<std::string> get_peers();
+
 		// Private Variables
 		private: qot_timeline_t timeline_info;   	// Timeline Info
 		private: int status_flag; 					// Status of the Constructor
@@ -142,6 +155,7 @@ namespace qot_core
 
 		/* Timeline map mutex used to protect the data structure */
 		private: std::mutex binding_mutex;
+		private: bool closing;						// Destructor started (protected by binding_mutex)
 
 		// Set used to give out binding ids
 		private: std::set<int> binding_ids;
@@ -149,6 +163,16 @@ namespace qot_core
 		// Binding Map
 		private: std::map<int, qot_binding_t> binding_map;
 
+		// QoT demands of all bindings, the tightest first
+		private: TimelineDemand binding_demands;
+
+		// Aggregate demand last applied (invalid while there are no bindings)
+		private: timequality_t current_demand;
+		private: bool demand_valid;
+
+		// Coalesced downstream updates, folded over QOT_UPDATE_WINDOW_MS
+		private: TimelineUpdateQueue qot_updates;
+
 		// Communication channel with the synchronization service
 		private: SyncCommunicator communicator;
 
@@ -161,7 +185,7 @@ namespace qot_core
 		// Node Unique ID
 		private: std::string node_uuid; 
 
-		// Vector of Peers (Peer Sync)
+		// Vector of Peers (Peer Sync, protected by binding_mutex)
 		private: std::vector<std::string> peers; 
 
 	};
@@ -42,18 +42,40 @@ extern "C"
 	#include <fcntl.h>		// File operations
 	#include <sys/shm.h>	// Shared Memory
 	#include <sys/mman.h>	// Memory Management
+	#include <sys/stat.h>	// File modes
 	#include <errno.h>		// Error
+
+	// Parameter history behind the live clock parameters
+	#include "../../qot_param_history.h"
 }
 
 // Internal Timeline Class Header
 #include "qot_timeline_clock.hpp"
 
+// Runtime metrics
+#include "../sync-service/qot_metrics.hpp"
+
 // QoT Core Namespace
 using namespace qot_core;
 
 
 /* Private functions */
 
+/* Create the host-wide wait table once, clients open it read-write to register their waits */
+static void create_wait_table()
+{
+	int fd = shm_open(TL_WAIT_TABLE_NAME, O_CREAT | O_RDWR, 0666);
+	if (fd == -1) {
+		std::cout << "qot_timeline_clock: wait table creation failed, waiters fall back to the clock futex: " << strerror(errno) << "\n";
+		return;
+	}
+
+	// The mode passed to shm_open is filtered by the umask
+	if (ftruncate(fd, TL_WAIT_SLOTS*sizeof(tl_wait_slot_t)) == -1 || fchmod(fd, 0666) == -1)
+		std::cout << "qot_timeline_clock: wait table setup failed: " << strerror(errno) << "\n";
+	close(fd);
+}
+
 /* Public functions */
 
 /* Constructor: Create a new timeline clock ß*/
@@ -87,7 +109,11 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
 
 	tl_shm_name = tl_name.str();
 
-	// Create a shared memory location
+	// Main clocks come up first, they also set up the table their waiters register in
+	if (main_clk_flag)
+		create_wait_table();
+
+	// Create a shared memory location (live parameters followed by their history)
 	tl_shm_fd = shm_open(tl_shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
   	if (tl_shm_fd == -1) {
     	std::cout << "qot_timeline_clock: Shared memory creation failed: " << strerror(errno) << "\n";
@@ -96,10 +122,10 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
  	}
 
  	// Configure the size of the shared memory segment 
-  	ftruncate(tl_shm_fd, sizeof(tl_translation_t));
+  	ftruncate(tl_shm_fd, tl_history_segment_size(TL_HISTORY_CAPACITY));
 
   	// Map the shared memory region into the memory space
-  	tl_shm_base = mmap(0, sizeof(tl_translation_t), PROT_READ | PROT_WRITE, MAP_SHARED, tl_shm_fd, 0);
+  	tl_shm_base = mmap(0, tl_history_segment_size(TL_HISTORY_CAPACITY), PROT_READ | PROT_WRITE, MAP_SHARED, tl_shm_fd, 0);
 	if (tl_shm_base == MAP_FAILED) {
 	    std::cout << "qot_timeline_clock: Shared memory mmap failed: " << strerror(errno) << "\n";
 	    
@@ -116,6 +142,10 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
 	clock_params = (tl_translation_t*)tl_shm_base;
 
 	// Initialize the clock parameters to zero
+    clock_params->seq = 0;		// Seqlock sequence number (even -> no update in flight)
+    clock_params->flags = 0;
+    clock_params->wait_slot = (timeline.type == QOT_TIMELINE_GLOBAL) ? TL_WAIT_SLOT_GLOBAL : TL_WAIT_SLOT_LOCAL;
+    clock_params->waiters = 0;
     clock_params->last = 0;		// Last core time instance at which synchronization happened
     clock_params->mult = 0;		// Frequency compensation multiplication factor in ppb
     clock_params->nsec = 0;		// Offset
@@ -123,6 +153,10 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
     clock_params->l_nsec = 0;	// Left hand bound on offset uncertainty
     clock_params->u_mult = 0;	// Right hand bound on ppb uncertainty
     clock_params->l_mult = 0;	// Left hand bound on ppb uncertainty
+    clock_params->slope = 0;	// Overlay drift
+
+    // Empty parameter history, appended by the sync service
+    tl_history_init(clock_params, TL_HISTORY_CAPACITY, TL_HISTORY_WINDOW_NS);
 
 	// Create a shared memory location
 	tl_shm_fd_rdonly = shm_open(tl_shm_name.c_str(), O_RDONLY, 0666);
@@ -130,7 +164,7 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
     	std::cout << "qot_timeline_clock: read-only shared memory open failed: " << strerror(errno) << "\n";
     	
     	// Close and unlink the shared memory region
-    	munmap((void*)clock_params, sizeof(tl_translation_t));
+    	munmap((void*)clock_params, tl_history_segment_size(TL_HISTORY_CAPACITY));
 	    close(tl_shm_fd);
 	    shm_unlink(tl_shm_name.c_str());
 
@@ -142,6 +176,8 @@ TimelineClock::TimelineClock(qot_timeline_t &timeline, bool main_clk_flag)
  	// Unlink the Shared memory file so no other process can create file descriptors
  	shm_unlink(tl_shm_name.c_str());
 
+ 	// Count the parameter updates published by the sync algorithms
+ 	qot::metrics_watch_params(tl_shm_name, clock_params);
 }
 
 /* Destructor: Remove a timeline clock*/
@@ -151,7 +187,8 @@ TimelineClock::~TimelineClock()
         return;
 
     // Destroy the shared memory object and region
-    munmap((void*)clock_params, sizeof(tl_translation_t));
+    qot::metrics_unwatch_params(clock_params);
+    munmap((void*)clock_params, tl_history_segment_size(TL_HISTORY_CAPACITY));
     close(tl_shm_fd);
     close(tl_shm_fd);
     clock_params = NULL;
@@ -173,7 +210,9 @@ timequality_t TimelineClock::get_desired_quality()
 /* Get the translation parameters of the clock */
 tl_translation_t TimelineClock::get_translation_params()
 {
-	return *clock_params;
+	tl_translation_t params;
+	tl_translation_read(clock_params, &params);
+	return params;
 }
 
 /* Get the Shared Memory file descriptor */
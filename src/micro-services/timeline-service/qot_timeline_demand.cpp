@@ -0,0 +1,144 @@
+/*
+ * @file qot_timeline_demand.cpp
+ * @brief Aggregate QoT demand of the bindings of a timeline and its coalesced propagation
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+
+// Timeline demand header
+#include "qot_timeline_demand.hpp"
+
+using namespace qot_core;
+
+/* Meta data other than the "NULL" placeholder carries information */
+static bool has_meta_data(const std::string &meta_data)
+{
+    return !meta_data.empty() && meta_data.compare("NULL") != 0;
+}
+
+/* Add the QoT demand of a binding to the aggregate */
+void TimelineDemand::add(const timequality_t &demand)
+{
+    resolution_demands.insert(demand.resolution);
+    accuracy_below_demands.insert(demand.accuracy.below);
+    accuracy_above_demands.insert(demand.accuracy.above);
+}
+
+/* Remove the QoT demand of a binding from the aggregate */
+void TimelineDemand::remove(const timequality_t &demand)
+{
+    // Equal demands are interchangeable, erase a single instance
+    resolution_demands.erase(resolution_demands.find(demand.resolution));
+    accuracy_below_demands.erase(accuracy_below_demands.find(demand.accuracy.below));
+    accuracy_above_demands.erase(accuracy_above_demands.find(demand.accuracy.above));
+}
+
+bool TimelineDemand::empty() const
+{
+    return resolution_demands.empty();
+}
+
+/* The tightest requirements head the ordered demands (capped at a high value as before) */
+timequality_t TimelineDemand::tightest() const
+{
+    timequality_t demand;
+    timelength_t cap;
+    cap.sec = 1000000000;
+    cap.asec = 0;
+    timelength_less less;
+    demand.resolution = less(*resolution_demands.begin(), cap) ? *resolution_demands.begin() : cap;
+    demand.accuracy.below = less(*accuracy_below_demands.begin(), cap) ? *accuracy_below_demands.begin() : cap;
+    demand.accuracy.above = less(*accuracy_above_demands.begin(), cap) ? *accuracy_above_demands.begin() : cap;
+    return demand;
+}
+
+TimelineUpdateQueue::TimelineUpdateQueue(qot_update_sender_t sender, int window_ms)
+ : sender(sender), window_ms(window_ms), update_pending(false), update_running(false)
+{
+}
+
+TimelineUpdateQueue::~TimelineUpdateQueue()
+{
+    stop();
+}
+
+/* Queue a downstream QoT update */
+void TimelineUpdateQueue::schedule(const timequality_t &demand, const std::string &meta_data)
+{
+    std::lock_guard<std::mutex> lock(update_mutex);
+    pending_demand = demand;
+
+    // Keep meta data carrying information until it has been sent
+    if (has_meta_data(meta_data) || !(update_pending && has_meta_data(pending_meta_data)))
+        pending_meta_data = meta_data;
+    update_pending = true;
+
+    // Start the worker on the first update
+    if (!update_thread.joinable())
+    {
+        update_running = true;
+        update_thread = std::thread(&TimelineUpdateQueue::run, this);
+    }
+    update_cv.notify_one();
+}
+
+/* Flush any pending update, then stop the worker */
+void TimelineUpdateQueue::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        update_running = false;
+        update_cv.notify_one();
+    }
+    if (update_thread.joinable())
+        update_thread.join();
+}
+
+/* Worker sending the coalesced updates */
+void TimelineUpdateQueue::run()
+{
+    std::unique_lock<std::mutex> lock(update_mutex);
+    while (true)
+    {
+        update_cv.wait(lock, [this] { return update_pending || !update_running; });
+        if (!update_pending)
+            break;
+
+        // Let the burst settle, later changes are folded into the pending update
+        if (update_running)
+            update_cv.wait_for(lock, std::chrono::milliseconds(window_ms), [this] { return !update_running; });
+
+        timequality_t demand = pending_demand;
+        std::string meta_data = pending_meta_data;
+        update_pending = false;
+        pending_meta_data.clear();
+
+        lock.unlock();
+        sender(demand, meta_data);
+        lock.lock();
+    }
+}
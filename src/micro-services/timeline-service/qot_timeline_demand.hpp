@@ -0,0 +1,108 @@
+/*
+ * @file qot_timeline_demand.hpp
+ * @brief Aggregate QoT demand of the bindings of a timeline and its coalesced propagation
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_TIMELINE_DEMAND_HPP
+#define QOT_TIMELINE_DEMAND_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+// Include the QoT Data Types
+extern "C"
+{
+	#include "../../qot_types.h"
+}
+
+// Window over which binding QoT changes are coalesced into one downstream update
+#define QOT_UPDATE_WINDOW_MS 20
+
+namespace qot_core
+{
+	// Ordering of time lengths, shortest (tightest requirement) first
+	struct timelength_less {
+		bool operator()(const timelength_t &a, const timelength_t &b) const
+		{
+			return a.sec < b.sec || (a.sec == b.sec && a.asec < b.asec);
+		}
+	};
+
+	// QoT demands of all bindings of a timeline, the tightest first (not thread-safe)
+	class TimelineDemand
+	{
+		// Add/remove the QoT demand of a binding
+		public: void add(const timequality_t &demand);
+		public: void remove(const timequality_t &demand);
+
+		// No binding demands anything
+		public: bool empty() const;
+
+		// Tightest requirement of each kind, capped at 1e9 seconds (not empty)
+		public: timequality_t tightest() const;
+
+		private: std::multiset<timelength_t, timelength_less> resolution_demands;
+		private: std::multiset<timelength_t, timelength_less> accuracy_below_demands;
+		private: std::multiset<timelength_t, timelength_less> accuracy_above_demands;
+	};
+
+	// Sends a QoT demand downstream, with the timeline meta data if it carries any
+	typedef std::function<void(const timequality_t&, const std::string&)> qot_update_sender_t;
+
+	// Worker sending QoT updates downstream, the updates of a burst are folded into one
+	class TimelineUpdateQueue
+	{
+		// Constructor and Destructor (sends any pending update)
+		public: TimelineUpdateQueue(qot_update_sender_t sender, int window_ms = QOT_UPDATE_WINDOW_MS);
+		public: ~TimelineUpdateQueue();
+
+		// Queue an update, the latest demand wins (meta data is kept until it has been sent)
+		public: void schedule(const timequality_t &demand, const std::string &meta_data);
+
+		// Send any pending update and stop the worker
+		public: void stop();
+
+		// Worker loop
+		private: void run();
+
+		private: qot_update_sender_t sender;
+		private: int window_ms;
+		private: std::mutex update_mutex;
+		private: std::condition_variable update_cv;
+		private: std::thread update_thread;
+		private: bool update_pending;
+		private: bool update_running;
+		private: timequality_t pending_demand;
+		private: std::string pending_meta_data;
+	};
+}
+
+#endif
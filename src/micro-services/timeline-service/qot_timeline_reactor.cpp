@@ -0,0 +1,495 @@
+/*
+ * @file qot_timeline_reactor.cpp
+ * @brief Event-driven (epoll) connection handling for the timeline service
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <string>
+#include <functional>
+
+extern "C"
+{
+    #include <stdio.h>
+    #include <string.h>
+    #include <errno.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/epoll.h>
+    #include <sys/un.h>
+}
+
+// Reactor header
+#include "qot_timeline_reactor.hpp"
+
+// Message serialization (JSON and binary)
+#include "qot_tlmsg_serialize.hpp"
+
+using namespace qot_core;
+
+// Timeout for the dispatch loop to check the running flag (milliseconds)
+#define REACTOR_TIMEOUT_MS 5000
+
+// Timeout to drain pending replies before sending a file descriptor (milliseconds)
+#define REACTOR_FLUSH_TIMEOUT_MS 1000
+
+// Largest request we are willing to buffer for a single connection
+#define REACTOR_MAX_REQUEST 65536
+
+// Defined in the timeline service
+extern int send_fd(int sock, int fd);
+
+/* Length of the complete JSON object at the start of buf (0 if incomplete) */
+static size_t json_frame_length(const std::string &buf)
+{
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+
+    for (size_t i = 0; i < buf.size(); i++)
+    {
+        char c = buf[i];
+        if (in_string)
+        {
+            if (escaped)
+                escaped = false;
+            else if (c == '\\')
+                escaped = true;
+            else if (c == '"')
+                in_string = false;
+        }
+        else if (c == '"')
+            in_string = true;
+        else if (c == '{')
+            depth++;
+        else if (c == '}' && --depth == 0)
+            return i + 1;
+    }
+    return 0;
+}
+
+/* TimelineConnection */
+
+TimelineConnection::TimelineConnection(int sd)
+ : fd(sd), busy(false), closed(false), out_armed(false), wire_format(0)
+{
+}
+
+TimelineConnection::~TimelineConnection()
+{
+    // The socket is only closed once no worker references the connection
+    close(fd);
+}
+
+/* TimelineReactor */
+
+/* Constructor: set up epoll on the listening socket and start the workers */
+TimelineReactor::TimelineReactor(int listen_sd, int num_workers, tl_request_handler_t handler)
+ : status_flag(0), listen_fd(listen_sd), epoll_fd(-1), stopping(false), request_handler(handler)
+{
+    struct epoll_event ev;
+
+    // The listening socket is drained until EAGAIN on every wakeup
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        std::cout << "qot_timeline_reactor: epoll_create1 failed: " << strerror(errno) << "\n";
+        status_flag = 1;
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+    {
+        std::cout << "qot_timeline_reactor: epoll_ctl failed: " << strerror(errno) << "\n";
+        status_flag = 2;
+        return;
+    }
+
+    if (num_workers < 1)
+        num_workers = 1;
+
+    for (int i = 0; i < num_workers; i++)
+        workers.push_back(std::thread(&TimelineReactor::worker, this));
+}
+
+/* Destructor: stop the workers and release all connections */
+TimelineReactor::~TimelineReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        stopping = true;
+        pool_cv.notify_all();
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    connections.clear();
+
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+/* Query the status flag to know the construction status */
+int TimelineReactor::query_status_flag()
+{
+    return status_flag;
+}
+
+/* Run the accept/dispatch loop until running is cleared */
+void TimelineReactor::run(volatile int &running)
+{
+    struct epoll_event events[QOT_TLSERVICE_MAX_EVENTS];
+    int n, i;
+
+    while (running)
+    {
+        // Wait for activity, times out to enable program termination
+        n = epoll_wait(epoll_fd, events, QOT_TLSERVICE_MAX_EVENTS, REACTOR_TIMEOUT_MS);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                std::cout << "Received Interrupt\n";
+            else
+                std::cout << "epoll_wait experienced an error: " << strerror(errno) << "\n";
+            continue;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == listen_fd)
+                accept_connections();
+            else
+                handle_event(events[i].data.fd, events[i].events);
+        }
+    }
+}
+
+/* Accept all pending connections */
+void TimelineReactor::accept_connections()
+{
+    struct epoll_event ev;
+    int sd;
+
+    while ((sd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = sd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sd, &ev) < 0)
+        {
+            std::cout << "qot_timeline_reactor: unable to watch socket " << sd << ": " << strerror(errno) << "\n";
+            close(sd);
+            continue;
+        }
+        connections[sd] = std::make_shared<TimelineConnection>(sd);
+        std::cout << "New connection, socket fd is " << sd << "\n";
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        std::cout << "accept failure: " << strerror(errno) << "\n";
+}
+
+/* Handle readiness on a client connection */
+void TimelineReactor::handle_event(int sd, uint32_t events)
+{
+    std::map<int, std::shared_ptr<TimelineConnection> >::iterator it = connections.find(sd);
+    if (it == connections.end())
+        return;
+    std::shared_ptr<TimelineConnection> conn = it->second;
+    bool hangup = (events & (EPOLLHUP | EPOLLERR)) != 0;
+
+    if (events & EPOLLIN)
+    {
+        char buffer[4096];
+        ssize_t bytes;
+        std::lock_guard<std::mutex> lock(conn->conn_mutex);
+        for (;;)
+        {
+            bytes = read(sd, buffer, sizeof(buffer));
+            if (bytes > 0)
+            {
+                conn->rx_buffer.append(buffer, bytes);
+                continue;
+            }
+            if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                hangup = true;
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        if (conn->rx_buffer.size() > REACTOR_MAX_REQUEST)
+        {
+            std::cout << "qot_timeline_reactor: oversized request on socket " << sd << "\n";
+            hangup = true;
+        }
+    }
+
+    if (events & EPOLLOUT)
+    {
+        std::lock_guard<std::mutex> lock(conn->conn_mutex);
+        if (flush_locked(*conn) < 0)
+            hangup = true;
+    }
+
+    if (hangup)
+    {
+        std::cout << "Host disconnected fd is " << sd << "\n";
+        drop_connection(sd);
+        return;
+    }
+
+    dispatch(conn);
+}
+
+/* Remove a connection from the reactor */
+void TimelineReactor::drop_connection(int sd)
+{
+    std::map<int, std::shared_ptr<TimelineConnection> >::iterator it = connections.find(sd);
+    if (it == connections.end())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(it->second->conn_mutex);
+        it->second->closed = true;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sd, NULL);
+
+    // The socket is closed when the last in-flight request releases it
+    connections.erase(it);
+}
+
+/* Extract and queue the next complete request of a connection */
+void TimelineReactor::dispatch(std::shared_ptr<TimelineConnection> &conn)
+{
+    request_job job;
+    size_t frame_len = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(conn->conn_mutex);
+
+        // Requests on a connection are serviced in order, one at a time
+        if (conn->busy || conn->closed || conn->rx_buffer.empty())
+            return;
+
+        if (is_tlmsg_binary(conn->rx_buffer.data(), conn->rx_buffer.size()))
+        {
+            long length = tlmsg_binary_frame_length(conn->rx_buffer.data(), conn->rx_buffer.size());
+            if (length < 0)
+            {
+                // The stream cannot be resynchronized on a bad length prefix
+                std::cout << "Malformed binary frame length received\n";
+                conn->rx_buffer.clear();
+                return;
+            }
+            if (conn->rx_buffer.size() < (size_t)length)
+                return;
+            frame_len = length;
+            if (deserialize_tlmsg_binary(conn->rx_buffer.data(), frame_len, job.msg) < 0)
+            {
+                std::cout << "Malformed binary message received\n";
+                conn->rx_buffer.erase(0, frame_len);
+                return;
+            }
+            job.binary = true;
+        }
+        else if (conn->rx_buffer[0] == '{')
+        {
+            frame_len = json_frame_length(conn->rx_buffer);
+            if (frame_len == 0)
+                return;
+            try
+            {
+                nlohmann::json data = nlohmann::json::parse(conn->rx_buffer.substr(0, frame_len));
+                deserialize_tlmsg(data, job.msg);
+
+                // A client offering the binary wire format switches after this reply
+                if (data.count("wire") && data["wire"].get<int>() >= QOT_TLMSG_BIN_VERSION)
+                    conn->wire_format = QOT_TLMSG_BIN_VERSION;
+            }
+            catch (std::exception &e)
+            {
+                std::cout << "Malformed JSON message received: " << e.what() << "\n";
+                conn->rx_buffer.erase(0, frame_len);
+                return;
+            }
+            job.binary = false;
+        }
+        else if (conn->rx_buffer.size() >= 8)
+        {
+            // Neither framing matches, resynchronize on the next object
+            size_t pos = conn->rx_buffer.find('{');
+            conn->rx_buffer.erase(0, pos);
+            return;
+        }
+        else
+            return;
+
+        conn->rx_buffer.erase(0, frame_len);
+        conn->busy = true;
+    }
+
+    /* Requests for the same timeline (keyed by name, which every message carries,
+       unlike the index assigned on create) run one at a time and in order, which
+       serializes creation/destruction against use of a TimelineCore. Any worker
+       runs the next one, so a slow request only holds up its own timeline */
+    std::string name(job.msg.info.name);
+
+    job.conn = conn;
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    timeline_strand &strand = strands[name];
+    strand.jobs.push_back(job);
+    if (strand.jobs.size() == 1)
+    {
+        ready_strands.push_back(name);
+        pool_cv.notify_one();
+    }
+}
+
+/* Write as much pending reply data as possible (hold conn_mutex) */
+int TimelineReactor::flush_locked(TimelineConnection &conn)
+{
+    struct epoll_event ev;
+    ssize_t bytes;
+
+    while (!conn.tx_buffer.empty())
+    {
+        bytes = send(conn.fd, conn.tx_buffer.data(), conn.tx_buffer.size(), MSG_NOSIGNAL);
+        if (bytes > 0)
+        {
+            conn.tx_buffer.erase(0, bytes);
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return -1;
+    }
+
+    // Only watch for writability while there is something left to write
+    bool want_out = !conn.tx_buffer.empty();
+    if (want_out != conn.out_armed && !conn.closed)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0);
+        ev.data.fd = conn.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.out_armed = want_out;
+    }
+    return 0;
+}
+
+/* Queue a reply on a connection */
+int TimelineReactor::send_reply(std::shared_ptr<TimelineConnection> &conn, const char *data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(conn->conn_mutex);
+    if (conn->closed)
+        return -1;
+    conn->tx_buffer.append(data, len);
+    return flush_locked(*conn);
+}
+
+/* Send a file descriptor over a connection once pending replies are written */
+int TimelineReactor::send_descriptor(std::shared_ptr<TimelineConnection> &conn, int fd)
+{
+    struct pollfd pfd;
+    int retval;
+
+    std::lock_guard<std::mutex> lock(conn->conn_mutex);
+    if (conn->closed)
+        return -1;
+
+    pfd.fd = conn->fd;
+    pfd.events = POLLOUT;
+
+    // The descriptor must not overtake earlier replies on the stream
+    while (!conn->tx_buffer.empty())
+    {
+        if (poll(&pfd, 1, REACTOR_FLUSH_TIMEOUT_MS) <= 0 || flush_locked(*conn) < 0)
+            return -1;
+    }
+
+    while ((retval = send_fd(conn->fd, fd)) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        if (poll(&pfd, 1, REACTOR_FLUSH_TIMEOUT_MS) <= 0)
+            return -1;
+    }
+    return retval;
+}
+
+/* Worker thread body */
+void TimelineReactor::worker()
+{
+    for (;;)
+    {
+        request_job job;
+        std::string name;
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            while (ready_strands.empty() && !stopping)
+                pool_cv.wait(lock);
+            if (ready_strands.empty())
+                return;
+            name = ready_strands.front();
+            ready_strands.pop_front();
+            // The job stays queued while it runs, so the strand is not scheduled again
+            job = strands[name].jobs.front();
+        }
+
+        request_handler(job.conn, job.msg, job.binary);
+
+        // Next request of the timeline, if any, goes to whichever worker is free
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            timeline_strand &strand = strands[name];
+            strand.jobs.pop_front();
+            if (strand.jobs.empty())
+            {
+                strands.erase(name);
+            }
+            else
+            {
+                ready_strands.push_back(name);
+                pool_cv.notify_one();
+            }
+        }
+
+        // The connection may already hold its next request
+        {
+            std::lock_guard<std::mutex> lock(job.conn->conn_mutex);
+            job.conn->busy = false;
+        }
+        dispatch(job.conn);
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ * @file qot_timeline_reactor.hpp
+ * @brief Event-driven (epoll) connection handling for the timeline service
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_TIMELINE_REACTOR_HPP
+#define QOT_TIMELINE_REACTOR_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Timeline service message format
+#include "qot_timeline_service.hpp"
+
+// Default number of request worker threads
+#define QOT_TLSERVICE_WORKERS 4
+
+// Maximum number of epoll events handled per wakeup
+#define QOT_TLSERVICE_MAX_EVENTS 256
+
+namespace qot_core
+{
+	// State of a single client connection
+	class TimelineConnection
+	{
+		// Constructor and Destructor (closes the socket)
+		public: TimelineConnection(int sd);
+		public: ~TimelineConnection();
+
+		public: int fd;                   // Client socket
+		public: std::mutex conn_mutex;    // Protects the fields below
+		public: std::string rx_buffer;    // Bytes received but not yet parsed
+		public: std::string tx_buffer;    // Reply bytes not yet written
+		public: bool busy;                // A request is being serviced by a worker
+		public: bool closed;              // Peer hung up
+		public: bool out_armed;           // EPOLLOUT registered for pending writes
+		public: int wire_format;          // Binary format offered by the client (0 -> JSON only)
+	};
+
+	// Handler invoked on a worker thread for every request, must reply through the reactor
+	typedef std::function<void(std::shared_ptr<TimelineConnection>&, qot_timeline_msg_t&, bool)> tl_request_handler_t;
+
+	// epoll reactor with a pool of request workers
+	class TimelineReactor
+	{
+		// Constructor and Destructor
+		public: TimelineReactor(int listen_sd, int num_workers, tl_request_handler_t handler);
+		public: ~TimelineReactor();
+
+		// Query the status flag to know the construction status
+		public: int query_status_flag();
+
+		// Run the accept/dispatch loop until running is cleared
+		public: void run(volatile int &running);
+
+		// Queue a reply on a connection (partial writes are completed by the reactor)
+		public: int send_reply(std::shared_ptr<TimelineConnection> &conn, const char *data, size_t len);
+
+		// Send a file descriptor over a connection once pending replies are written
+		public: int send_descriptor(std::shared_ptr<TimelineConnection> &conn, int fd);
+
+		// Accept all pending connections
+		private: void accept_connections();
+
+		// Handle readiness on a client connection
+		private: void handle_event(int sd, uint32_t events);
+
+		// Remove a connection from the reactor
+		private: void drop_connection(int sd);
+
+		// Extract and queue the next complete request of a connection
+		private: void dispatch(std::shared_ptr<TimelineConnection> &conn);
+
+		// Write as much pending reply data as possible (hold conn_mutex)
+		private: int flush_locked(TimelineConnection &conn);
+
+		// Worker thread body
+		private: void worker();
+
+		// A request waiting for a worker
+		private: struct request_job {
+			std::shared_ptr<TimelineConnection> conn;
+			qot_timeline_msg_t msg;
+			bool binary;
+		};
+
+		// Requests for one timeline, run in order and one at a time by any worker
+		private: struct timeline_strand {
+			std::deque<request_job> jobs;
+		};
+
+		private: int status_flag;
+		private: int listen_fd;
+		private: int epoll_fd;
+		private: bool stopping;
+		private: tl_request_handler_t request_handler;
+
+		// Connections owned by the dispatch thread
+		private: std::map<int, std::shared_ptr<TimelineConnection> > connections;
+
+		// Worker pool: strands with requests pending, keyed by timeline name. A strand is
+		// listed in ready_strands while it waits for a worker and kept while one runs it
+		private: std::mutex pool_mutex;
+		private: std::condition_variable pool_cv;
+		private: std::map<std::string, timeline_strand> strands;
+		private: std::deque<std::string> ready_strands;
+		private: std::vector<std::thread> workers;
+	};
+}
+
+#endif
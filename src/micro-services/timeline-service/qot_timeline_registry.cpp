@@ -29,8 +29,6 @@
 
 #include <iostream>
 #include <mutex>
-#include <map>
-#include <set>
 
 // Internal Timeline Registry Class Header
 #include "qot_timeline_registry.hpp"
@@ -39,64 +37,72 @@ using namespace qot_core;
 
 /* Private functions */
 
-/* Search for a timeline given by a name -> Should be held within qot_timeline_lock */
-qot_timeline_t* TimelineRegistry::qot_timeline_find(char *name)
+/* Search for a timeline given by a name and copy its entry -> Should be held within qot_timeline_lock */
+bool TimelineRegistry::qot_timeline_find(const char *name, qot_timeline_t &timeline)
 {
     // Check if pointer is not null
     if (!name)
-        return NULL;
-    
-    qot_timeline_lock();
-    // Find the data structure
-    std::map<std::string, qot_timeline_t>::iterator it = qot_timeline_map.find(std::string(name));
-    if (it != qot_timeline_map.end())
-    {
-        qot_timeline_unlock();
-        return &it->second;
-    }
-    
-    qot_timeline_unlock();
-    return NULL;
+        return false;
+
+    // Find the data structure (entries are copied, they may be erased once the lock is dropped)
+    std::unordered_map<std::string, qot_timeline_t>::iterator it = qot_timeline_map.find(std::string(name));
+    if (it == qot_timeline_map.end())
+        return false;
+
+    timeline = it->second;
+    return true;
 }
 
-/* Insert a timeline into our map data structure */
+/* Insert a timeline into our map data structure -> Should be held within qot_timeline_lock */
 qot_return_t TimelineRegistry::qot_timeline_insert(qot_timeline_t &timeline)
 {
     // Add timeline to map data structure
-    qot_timeline_lock();
-    qot_timeline_map[std::string(timeline.name)] = timeline;
+    qot_timeline_t &entry = qot_timeline_map[std::string(timeline.name)];
+    entry = timeline;
 
-    // Set the ID of the timeline
-    if(!timeline_ids.empty())
-        qot_timeline_map[std::string(timeline.name)].index = *timeline_ids.rbegin() + 1;
+    // Set the ID of the timeline -> reuse the smallest released id so ids stay dense
+    if (!free_ids.empty())
+    {
+        entry.index = free_ids.top();
+        free_ids.pop();
+    }
     else
-        qot_timeline_map[std::string(timeline.name)].index = 0;
-
-    // Add the ID to the set
-    timeline_ids.insert(qot_timeline_map[std::string(timeline.name)].index);
+    {
+        entry.index = (int)tl_slots.size();
+        tl_slots.push_back(tl_slot());
+        tl_slots.back().tl_class = NULL;
+    }
+    tl_slots[entry.index].registered = true;
 
     // Copy the data back
-    timeline = qot_timeline_map[std::string(timeline.name)];
+    timeline = entry;
 
-    qot_timeline_unlock();
     return QOT_RETURN_TYPE_OK;
 }
 
-/* Remove a timeline from our data structure */
+/* Remove a timeline from our data structure -> Should be held within qot_timeline_lock */
 qot_return_t TimelineRegistry::qot_timeline_delete(qot_timeline_t timeline)
 {
-    qot_timeline_lock();
-
-    // Remove timeline id from the set
-    timeline_ids.erase(timeline.index);
+    // Release the timeline id (kept until the class pointer is removed too)
+    if (timeline.index >= 0 && timeline.index < (int)tl_slots.size())
+    {
+        tl_slots[timeline.index].registered = false;
+        qot_timeline_release_id(timeline.index);
+    }
 
     // Remove timeline from the map data structure
     qot_timeline_map.erase(std::string(timeline.name));
 
-    qot_timeline_unlock();
     return QOT_RETURN_TYPE_OK;
 }
 
+/* Release an id once neither a timeline nor a class pointer holds it -> Should be held within qot_timeline_lock */
+void TimelineRegistry::qot_timeline_release_id(int id)
+{
+    if (!tl_slots[id].registered && tl_slots[id].tl_class == NULL)
+        free_ids.push(id);
+}
+
 /* Public functions */
 
 /* Hold the global timeline lock */
@@ -114,43 +120,41 @@ void TimelineRegistry::qot_timeline_unlock()
 /* Get information about a timeline */
 qot_return_t TimelineRegistry::qot_timeline_get_info(qot_timeline_t &timeline)
 {
-    qot_timeline_t *timeline_priv = NULL;
-    timeline_priv = qot_timeline_find(timeline.name);
-    if (!timeline_priv)
+    std::lock_guard<std::mutex> lock(qot_timeline_mutex);
+    if (!qot_timeline_find(timeline.name, timeline))
         return QOT_RETURN_TYPE_ERR;
-    timeline = *timeline_priv;
     return QOT_RETURN_TYPE_OK;
 }
 
 /* Update the timeline information  */
 qot_return_t TimelineRegistry::qot_timeline_set_info(qot_timeline_t &timeline)
 {
-    qot_timeline_t *timeline_priv = NULL;
-    timeline_priv = qot_timeline_find(timeline.name);
-    if (!timeline_priv)
+    qot_timeline_t timeline_priv;
+    std::lock_guard<std::mutex> lock(qot_timeline_mutex);
+    if (!qot_timeline_find(timeline.name, timeline_priv))
         return QOT_RETURN_TYPE_ERR;
-    qot_timeline_lock();
     qot_timeline_map[std::string(timeline.name)] = timeline;
-    qot_timeline_unlock();
     return QOT_RETURN_TYPE_OK;
 }
 
 /* Creata a new timeline */
 qot_return_t TimelineRegistry::qot_timeline_register(qot_timeline_t &timeline)
 {
-    qot_timeline_t *timeline_priv = NULL;
-    /* Make sure timeline doesn't already exist */
-    timeline_priv = qot_timeline_find(timeline.name);
-    if (timeline_priv)
+    /* Check and insert under one lock, so concurrent creations of a name cannot both succeed */
     {
-        /* If it exists return the timeline information */
-        std::cout << "qot_timeline_registry: timeline already exists" << std::endl;
-        timeline = *timeline_priv;
-        return QOT_RETURN_TYPE_ERR;
+        std::lock_guard<std::mutex> lock(qot_timeline_mutex);
+
+        /* Make sure timeline doesn't already exist */
+        if (qot_timeline_find(timeline.name, timeline))
+        {
+            /* If it exists return the timeline information */
+            std::cout << "qot_timeline_registry: timeline already exists" << std::endl;
+            return QOT_RETURN_TYPE_ERR;
+        }
+
+        /* Try and insert into the map */
+        qot_timeline_insert(timeline);
     }
-
-    /* Try and insert into the map */
-    qot_timeline_insert(timeline);
     std::cout << "qot_timeline_registry: Timeline " << timeline.index << " registered name is " << timeline.name << std::endl;
 
     return QOT_RETURN_TYPE_OK;
@@ -159,14 +163,14 @@ qot_return_t TimelineRegistry::qot_timeline_register(qot_timeline_t &timeline)
 /* Remove a timeline */
 qot_return_t TimelineRegistry::qot_timeline_remove(qot_timeline_t &timeline, bool admin_flag)
 {
-    qot_timeline_t *timeline_priv = NULL;
- 
+    qot_timeline_t timeline_priv;
+    std::lock_guard<std::mutex> lock(qot_timeline_mutex);
+
     /* Make certain that timeline->index has been set and exists */
-    timeline_priv = qot_timeline_find(timeline.name);
-    if (!timeline_priv)
+    if (!qot_timeline_find(timeline.name, timeline_priv))
         return QOT_RETURN_TYPE_ERR;
 
-    qot_timeline_delete(*timeline_priv);
+    qot_timeline_delete(timeline_priv);
     return QOT_RETURN_TYPE_OK;
 }
 
@@ -174,39 +178,55 @@ qot_return_t TimelineRegistry::qot_timeline_remove(qot_timeline_t &timeline, boo
 qot_return_t TimelineRegistry::qot_tl_class_register(int tl_index, void *tl_ptr)
 {
     qot_timeline_lock();
-    qot_tl_class_map[tl_index] = tl_ptr;
+    if (tl_index < 0 || tl_index >= (int)tl_slots.size() || !tl_slots[tl_index].registered)
+    {
+        qot_timeline_unlock();
+        return QOT_RETURN_TYPE_ERR;
+    }
+    tl_slots[tl_index].tl_class = tl_ptr;
     qot_timeline_unlock();
+    return QOT_RETURN_TYPE_OK;
 }
 
 /* Remove the pointer to the  timeline class */
 qot_return_t TimelineRegistry::qot_tl_class_remove(int tl_index, bool admin_flag)
 {
     qot_timeline_lock();
-    qot_tl_class_map.erase(tl_index);
+    if (tl_index >= 0 && tl_index < (int)tl_slots.size() && tl_slots[tl_index].tl_class != NULL)
+    {
+        tl_slots[tl_index].tl_class = NULL;
+        qot_timeline_release_id(tl_index);
+    }
     qot_timeline_unlock();
+    return QOT_RETURN_TYPE_OK;
 }
 
 /* Get the pointer to a timeline class */
 void* TimelineRegistry::qot_tl_class_get(int tl_index)
 {
+    void *tl_ptr = NULL;
     qot_timeline_lock();
-    // Find the data structure
-    std::map<int, void*>::iterator it = qot_tl_class_map.find(tl_index);
-    if (it != qot_tl_class_map.end())
-    {
-        qot_timeline_unlock();
-        return it->second;
-    }
-    return NULL;
+    // Direct lookup by id
+    if (tl_index >= 0 && tl_index < (int)tl_slots.size())
+        tl_ptr = tl_slots[tl_index].tl_class;
     qot_timeline_unlock();
+    return tl_ptr;
 }
 
 /* Remove all timelines */
 void TimelineRegistry::qot_timeline_remove_all() {
     
     qot_timeline_lock();
-    // Clear all the timelines in the map data structure
+    // Clear all the timelines in the map data structure and release their ids
     qot_timeline_map.clear();
+    for (size_t id = 0; id < tl_slots.size(); id++)
+    {
+        if (tl_slots[id].registered)
+        {
+            tl_slots[id].registered = false;
+            qot_timeline_release_id((int)id);
+        }
+    }
     qot_timeline_unlock();
 }
 
@@ -30,9 +30,12 @@
 #ifndef QOT_TIMELINE_REGISTRY_HPP
 #define QOT_TIMELINE_REGISTRY_HPP
 
-#include <map>
+#include <functional>
 #include <mutex>
-#include <set>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // Include the QoT Data Types
 extern "C"
@@ -49,27 +52,36 @@ namespace qot_core
 		public: TimelineRegistry();
 		public: ~TimelineRegistry();
 
-		// Find if a timeline already exists in the registry
-		private: qot_timeline_t* qot_timeline_find(char *name);
+		// Find if a timeline already exists in the registry and copy its entry (hold the lock)
+		private: bool qot_timeline_find(const char *name, qot_timeline_t &timeline);
 
-		// Insert a timeline into the registry
+		// Insert a timeline into the registry (hold the lock)
 	    private: qot_return_t qot_timeline_insert(qot_timeline_t &timeline);
 
-	    // Delete a timeline from the registryß
+	    // Delete a timeline from the registry (hold the lock)
 	    private: qot_return_t qot_timeline_delete(qot_timeline_t timeline);
 
-		/* Map used to store timelines */
-		private: std::map<std::string, qot_timeline_t> qot_timeline_map;
+		// Release an id once neither a timeline nor a class pointer holds it (hold the lock)
+		private: void qot_timeline_release_id(int id);
 
-		/* Map used to store timeline class pointers */
-		private: std::map<int, void*> qot_tl_class_map;
+		/* Map used to store timelines (by name) */
+		private: std::unordered_map<std::string, qot_timeline_t> qot_timeline_map;
+
+		/* Slot of a timeline id */
+		private: struct tl_slot {
+			void *tl_class;          // Timeline class pointer (NULL if none)
+			bool registered;         // Id held by a registered timeline
+		};
+
+		/* Slots indexed by timeline id (ids are dense, so this stays compact) */
+		private: std::vector<tl_slot> tl_slots;
+
+		/* Released ids, the smallest is handed out first */
+		private: std::priority_queue<int, std::vector<int>, std::greater<int> > free_ids;
 
 		/* Timeline map mutex used to protect the data structure */
 		private: std::mutex qot_timeline_mutex;
 
-		// Set used to give out timeline ids
-		private: std::set<int> timeline_ids;
-
 		// Lock and unlock the data structure while iterating
 		public: void qot_timeline_lock();
 		public: void qot_timeline_unlock();
@@ -100,8 +112,8 @@ namespace qot_core
 
 		/* Iterators for iterating over the Timeline Registry */
 		/* Note: Hold the timeline lock while iterating */
-		public: typedef std::map<std::string, qot_timeline_t>::iterator iterator;
-  		public: typedef std::map<std::string, qot_timeline_t>::const_iterator const_iterator;
+		public: typedef std::unordered_map<std::string, qot_timeline_t>::iterator iterator;
+  		public: typedef std::unordered_map<std::string, qot_timeline_t>::const_iterator const_iterator;
 		public: iterator begin() { return qot_timeline_map.begin(); }
   		public: iterator end() { return qot_timeline_map.end(); }
 
@@ -52,56 +52,209 @@ pplx::task<http_response> make_task_request(http_client & client, method mtd, st
       client.request(mtd, path, jvalue);
 }
  
-json::value make_request(http_client & client, method mtd, std::string path, json::value const & jvalue)
+/* Constructor and Destuctor */
+TimelineRestInterface::TimelineRestInterface(std::string host)
+ : host_url(host), running(true)
+{
+   // A single persistent (keep-alive) client is reused by the worker
+   client_config.set_timeout(std::chrono::milliseconds(QOT_REST_TIMEOUT_MS));
+   client.reset(new http_client(host_url, client_config));
+   dispatch_thread = std::thread(&TimelineRestInterface::dispatch_loop, this);
+}
+
+TimelineRestInterface::~TimelineRestInterface()
 {
-   auto answer = json::value::object();
+   // Queued writes are drained before the worker exits, for a bounded time
+   {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      running = false;
+      drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(QOT_REST_DRAIN_MS);
+   }
+   queue_cv.notify_one();
+   if (dispatch_thread.joinable())
+      dispatch_thread.join();
+}
 
-   make_task_request(client, mtd, path, jvalue)
-      .then([](http_response response)
+/* Private Functions */
+// Queue a write, returns -1 if the queue is full
+int TimelineRestInterface::submit(method mtd, std::string path, json::value body, std::string key, bool coalesce)
+{
+   std::lock_guard<std::mutex> lock(queue_mutex);
+
+   // Last writer wins on a write that has not been sent yet
+   std::unordered_map<std::string, std::shared_ptr<qot_rest_request>>::iterator it = pending_writes.find(key);
+   if (coalesce && it != pending_writes.end() && it->second->mtd == mtd)
+   {
+      it->second->body = body;
+      return 0;
+   }
+
+   if (request_queue.size() >= QOT_REST_QUEUE_LEN)
+   {
+      std::cout << "TimelineRestInterface: request queue full, dropping " << mtd << " " << path << std::endl;
+      return -1;
+   }
+
+   std::shared_ptr<qot_rest_request> request(new qot_rest_request);
+   request->mtd = mtd;
+   request->path = path;
+   request->body = body;
+   request->key = key;
+   request_queue.push_back(request);
+
+   // Later writes to the resource must not be folded into earlier ones
+   if (coalesce)
+      pending_writes[key] = request;
+   else if (it != pending_writes.end())
+      pending_writes.erase(it);
+
+   queue_cv.notify_one();
+   return 0;
+}
+
+// Queue a GET behind the pending writes and wait a bounded time for the answer
+json::value TimelineRestInterface::query(std::string path)
+{
+   std::shared_ptr<qot_rest_request> request(new qot_rest_request);
+   request->mtd = methods::GET;
+   request->path = path;
+   request->body = json::value::null();
+   request->reply = std::make_shared<std::promise<json::value>>();
+   std::future<json::value> answer = request->reply->get_future();
+
+   {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      if (request_queue.size() >= QOT_REST_QUEUE_LEN)
+      {
+         std::cout << "TimelineRestInterface: request queue full, GET " << path << " failed" << std::endl;
+         return json::value();
+      }
+      request_queue.push_back(request);
+   }
+   queue_cv.notify_one();
+
+   if (answer.wait_for(std::chrono::milliseconds(QOT_REST_TIMEOUT_MS)) != std::future_status::ready)
+   {
+      std::cout << "TimelineRestInterface: GET " << path << " timed out" << std::endl;
+      return json::value();
+   }
+   return answer.get();
+}
+
+// Queue a GET behind the pending writes, the worker hands the answer (null on failure) to the handler
+int TimelineRestInterface::query_async(std::string path, std::function<void(const json::value &)> handler)
+{
+   std::shared_ptr<qot_rest_request> request(new qot_rest_request);
+   request->mtd = methods::GET;
+   request->path = path;
+   request->body = json::value::null();
+   request->handler = handler;
+
+   {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      if (request_queue.size() >= QOT_REST_QUEUE_LEN)
       {
+         std::cout << "TimelineRestInterface: request queue full, GET " << path << " failed" << std::endl;
+         return -1;
+      }
+      request_queue.push_back(request);
+   }
+   queue_cv.notify_one();
+   return 0;
+}
+
+// Send a request on the persistent connection (worker thread only)
+json::value TimelineRestInterface::execute(const qot_rest_request &request, bool &reachable)
+{
+   reachable = true;
+   for (int attempt = 0; attempt < 2; attempt++)
+   {
+      try
+      {
+         http_response response = make_task_request(*client, request.mtd, request.path, request.body).get();
          std::cout << "TimelineRestInterface: Received response status code: " << response.status_code() << std::endl;
          if (response.status_code() == status_codes::OK)
          {
-            return response.extract_json();
+            json::value answer = response.extract_json().get();
+            display_json(answer, "R: ");
+            return answer;
          }
-         return pplx::task_from_result(json::value());
-      })
-      .then([&answer](pplx::task<json::value> previousTask)
+         return json::value();
+      }
+      catch (std::exception const & e)
       {
-         try
-         {
-            display_json(previousTask.get(), "R: ");
-            answer = previousTask.get();
-         }
-         catch (http_exception const & e)
-         {
-            std::cout << e.what() << std::endl;
-         }
-      })
-      .wait();
+         std::cout << "TimelineRestInterface: " << e.what() << std::endl;
 
-   return answer;
+         // The server may have closed the kept-alive connection, reconnect and retry once
+         client.reset(new http_client(host_url, client_config));
+      }
+   }
+   reachable = false;
+   return json::value();
 }
 
-/* Constructor and Destuctor */
-TimelineRestInterface::TimelineRestInterface(std::string host)
- : host_url(host), client(host)
+// Hand the answer to whoever waits for it (worker thread only)
+void TimelineRestInterface::complete(qot_rest_request &request, const json::value &answer)
 {
-   // Initializattion can be done in this function
+   if (request.reply)
+      request.reply->set_value(answer);
+   if (request.handler)
+      request.handler(answer);
 }
 
-TimelineRestInterface::~TimelineRestInterface()
+// Worker sending the queued requests in order
+void TimelineRestInterface::dispatch_loop()
 {
-   // De-initialization can be done in this function
+   std::unique_lock<std::mutex> lock(queue_mutex);
+   bool reachable = true;
+   while (true)
+   {
+      queue_cv.wait(lock, [this] { return !request_queue.empty() || !running; });
+      if (request_queue.empty())
+         break;
+
+      // On shutdown the queue is not replayed against a service which is gone or too slow
+      if (!running && (!reachable || std::chrono::steady_clock::now() > drain_deadline))
+      {
+         std::deque<std::shared_ptr<qot_rest_request>> dropped;
+         dropped.swap(request_queue);
+         pending_writes.clear();
+         std::cout << "TimelineRestInterface: dropping " << dropped.size() << " requests on shutdown" << std::endl;
+         lock.unlock();
+         for (size_t i = 0; i < dropped.size(); i++)
+            complete(*dropped[i], json::value());
+         lock.lock();
+         continue;
+      }
+
+      std::shared_ptr<qot_rest_request> request = request_queue.front();
+      request_queue.pop_front();
+      std::unordered_map<std::string, std::shared_ptr<qot_rest_request>>::iterator it = pending_writes.find(request->key);
+      if (it != pending_writes.end() && it->second == request)
+         pending_writes.erase(it);
+
+      lock.unlock();
+      json::value answer = execute(*request, reachable);
+      complete(*request, answer);
+      lock.lock();
+   }
+}
+
+// Drop the cached server list of a timeline
+void TimelineRestInterface::invalidate_servers(std::string timeline_uuid)
+{
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   server_cache.erase(timeline_uuid);
 }
 
 /* Public Functions */
 std::vector<std::string> TimelineRestInterface::get_timelines()
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::vector<std::string> timeline_vector;
    std::cout << "TimelineRestInterface: GET (get all timelines)\n";
-   auto answer = make_request(new_client, methods::GET, std::string("/api/service/timelines/"), json::value::null());
+   auto answer = query(std::string("/api/service/timelines/"));
+   if (!answer.is_array())
+      return timeline_vector;
 
    // Unpack the timelines
    for(auto array_iter = answer.as_array().cbegin(); array_iter != answer.as_array().cend(); ++array_iter)
@@ -128,35 +281,32 @@ std::vector<std::string> TimelineRestInterface::get_timelines()
 int TimelineRestInterface::post_timeline(std::string timeline_uuid)
 {
    // Create a JSON to send to the REST Coordination Service
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    auto timeline = json::value::object();
    timeline["id"] = json::value::number(0);                 // ID Defaults to 0 (Coordination Service will generate an ID)
    timeline["name"] = json::value::string(timeline_uuid);
 
    // Make the POST Request
    std::cout << "TimelineRestInterface: POST (register a new timeline): " << timeline_uuid << std::endl;
-   make_request(new_client, methods::POST, std::string("/api/service/timelines/"), timeline);
-
-   return 0;
+   return submit(methods::POST, std::string("/api/service/timelines/"), timeline, "/api/service/timelines/" + timeline_uuid, false);
 }
 
 int TimelineRestInterface::delete_timeline(std::string timeline_uuid)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid;
    std::cout << "TimelineRestInterface: DELETE (delete a timeline): " << timeline_uuid << std::endl;
-   make_request(new_client, methods::DEL, path, json::value::null());
-   return 0;
+   invalidate_servers(timeline_uuid);
+   return submit(methods::DEL, path, json::value::null(), path, false);
 }
 
 std::vector<qot_node_phy_t> TimelineRestInterface::get_timeline_nodes(std::string timeline_uuid)
 {
    std::vector<qot_node_phy_t> node_vector;
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::vector<std::string> timeline_nodes;
    std::string path = "/api/service/timelines/" + timeline_uuid;
    std::cout << "TimelineRestInterface: GET (get timeline nodes): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return node_vector;
 
    // Unpack the timelines
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
@@ -199,11 +349,12 @@ std::vector<qot_node_phy_t> TimelineRestInterface::get_timeline_nodes(std::strin
 int TimelineRestInterface::get_timeline_coord_id(std::string timeline_uuid)
 {
    int id = -1;
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::vector<std::string> timeline_nodes;
    std::string path = "/api/service/timelines/" + timeline_uuid;
    std::cout << "TimelineRestInterface: GET (get timeline coordination id): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return id;
 
    // Unpack the timelines
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
@@ -226,10 +377,11 @@ int TimelineRestInterface::get_timeline_coord_id(std::string timeline_uuid)
 std::string TimelineRestInterface::get_timeline_metadata(std::string timeline_uuid)
 {
    std::string meta_data = "NULL"; 
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid;
    std::cout << "TimelineRestInterface: GET (get timeline meta data): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return meta_data;
 
    // Unpack the timelines
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
@@ -247,10 +399,40 @@ std::string TimelineRestInterface::get_timeline_metadata(std::string timeline_uu
    return meta_data;
 }
 
+/* Get the timeline meta data without blocking, meta data which was never set ("NULL") is set to the
+   coordination id of the timeline. The handler runs on the worker with the meta data, or "NULL" if it
+   could not be read, in which case nothing is written back */
+int TimelineRestInterface::init_timeline_metadata_async(std::string timeline_uuid, std::function<void(std::string meta_data)> handler)
+{
+   std::string path = "/api/service/timelines/" + timeline_uuid;
+   std::cout << "TimelineRestInterface: GET (get timeline meta data, async): " << timeline_uuid << "\n";
+   return query_async(path, [this, timeline_uuid, handler](const json::value &answer) {
+      if (!answer.is_object() || !answer.has_field("meta_data") || !answer.at("meta_data").is_string())
+      {
+         std::cout << "TimelineRestInterface: meta data of " << timeline_uuid << " unavailable\n";
+         handler(std::string("NULL"));
+         return;
+      }
+
+      std::string meta_data = answer.at("meta_data").as_string();
+      if (meta_data.compare("NULL") == 0)
+      {
+         if (!answer.has_field("id") || !answer.at("id").is_integer() || answer.at("id").as_integer() < 0)
+         {
+            std::cout << "TimelineRestInterface: coordination id of " << timeline_uuid << " unavailable\n";
+            handler(meta_data);
+            return;
+         }
+         meta_data = std::to_string(answer.at("id").as_integer());
+         put_timeline_metadata(timeline_uuid, meta_data);
+      }
+      handler(meta_data);
+   });
+}
+
 // Update the timeline meta data
 int TimelineRestInterface::put_timeline_metadata(std::string timeline_uuid, std::string meta_data)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    auto timeline = json::value::object();
    timeline["id"] = json::value::number(0);                 // ID Defaults to 0 (Coordination Service will generate an ID)
    timeline["name"] = json::value::string(timeline_uuid);
@@ -258,17 +440,17 @@ int TimelineRestInterface::put_timeline_metadata(std::string timeline_uuid, std:
 
    std::string path = "/api/service/timelines/" + timeline_uuid;
    std::cout << "TimelineRestInterface: PUT (update timeline meta data): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::PUT, path, timeline);
-   return 0;
+   return submit(methods::PUT, path, timeline, path, true);
 }
 
 int TimelineRestInterface::get_timeline_num_nodes(std::string timeline_uuid)
 {  
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    int num_nodes = 0;
    std::string path = "/api/service/timelines/" + timeline_uuid + "/nodes";
    std::cout << "TimelineRestInterface: GET (get timeline number of nodes): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return num_nodes;
 
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
    {
@@ -287,7 +469,6 @@ int TimelineRestInterface::get_timeline_num_nodes(std::string timeline_uuid)
 int TimelineRestInterface::post_node(std::string timeline_uuid, std::string node_uuid, unsigned long long accuracy_ns, unsigned long long resolution_ns)
 {
    // Create a JSON to send to the REST Coordination Service
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    auto node = json::value::object();
    node["id"] = json::value::number(0);                 // ID Defaults to 0 (Coordination Service will generate an ID)
    node["name"] = json::value::string(node_uuid);
@@ -301,25 +482,23 @@ int TimelineRestInterface::post_node(std::string timeline_uuid, std::string node
    // Make the POST Request
    std::cout << "TimelineRestInterface: POST (register a new node: " << node_uuid << " on timeline: " << timeline_uuid << ")" << std::endl;
    std::cout << "TimelineRestInterface: accuracy = " << accuracy_ns << ", resolution_ns = " << resolution_ns << std::endl;
-   make_request(new_client, methods::POST, path, node);
-   return 0;
+   return submit(methods::POST, path, node, path + "/" + node_uuid, false);
 }
 
 int TimelineRestInterface::delete_node(std::string timeline_uuid, std::string node_uuid)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/nodes/" + node_uuid;
    std::cout << "TimelineRestInterface: DELETE (delete a node: " << node_uuid << " on timeline: " << timeline_uuid << ")" << std::endl;
-   make_request(new_client, methods::DEL, path, json::value::null());
-   return 0;
+   return submit(methods::DEL, path, json::value::null(), path, false);
 }
 
 int TimelineRestInterface::get_node(std::string timeline_uuid, std::string node_uuid, unsigned long long &accuracy_ns, unsigned long long &resolution_ns)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/nodes/" + node_uuid;
    std::cout << "TimelineRestInterface: GET (get info node: " << node_uuid << " on timeline: " << timeline_uuid << ")" << std::endl;
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return -1;
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
    {
       const utility::string_t &key = iter->first;
@@ -341,10 +520,11 @@ int TimelineRestInterface::get_node(std::string timeline_uuid, std::string node_
 std::string TimelineRestInterface::get_node_ip(std::string timeline_uuid, std::string node_uuid)
 {
    std::string ip_address = "NULL";
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/nodes/" + node_uuid;
    std::cout << "TimelineRestInterface: GET (get IP address for node: " << node_uuid << " on timeline: " << timeline_uuid << ")" << std::endl;
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return ip_address;
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
    {
       const utility::string_t &key = iter->first;
@@ -361,23 +541,22 @@ std::string TimelineRestInterface::get_node_ip(std::string timeline_uuid, std::s
 
 int TimelineRestInterface::put_node(std::string timeline_uuid, std::string node_uuid, unsigned long long accuracy_ns, unsigned long long resolution_ns)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    auto qot = json::value::object();
    qot["accuracy"] = json::value::number(uint64_t(accuracy_ns));
    qot["resolution"] = json::value::number(uint64_t(resolution_ns));
    std::string path = "/api/service/timelines/" + timeline_uuid + "/nodes/" + node_uuid;
    std::cout << "TimelineRestInterface: PUT (update a node: " << node_uuid << " on timeline: " << timeline_uuid << ")" << std::endl;
    std::cout << "TimelineRestInterface: accuracy = " << accuracy_ns << ", resolution_ns = " << resolution_ns << std::endl;
-   make_request(new_client, methods::PUT, path, qot);
-   return 0;
+   return submit(methods::PUT, path, qot, path, true);
 }
 
 int TimelineRestInterface::get_timeline_qot(std::string timeline_uuid, unsigned long long &accuracy_ns, unsigned long long &resolution_ns)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/qot";
    std::cout << "TimelineRestInterface: GET (get timeline qot: " << timeline_uuid << ")" << std::endl;
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return -1;
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
    {
       const utility::string_t &key = iter->first;
@@ -398,11 +577,19 @@ int TimelineRestInterface::get_timeline_qot(std::string timeline_uuid, unsigned
 
 std::vector<qot_server_t> TimelineRestInterface::get_timeline_servers(std::string timeline_uuid)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::vector<qot_server_t> servers;
+
+   // Serve from the cache while the entry is fresh
+   {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      std::map<std::string, qot_server_cache_t>::iterator it = server_cache.find(timeline_uuid);
+      if (it != server_cache.end() && std::chrono::steady_clock::now() < it->second.expiry)
+         return it->second.servers;
+   }
+
    std::string path = "/api/service/timelines/" + timeline_uuid + "/servers";
    std::cout << "TimelineRestInterface: GET (get timeline servers): " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
 
    if (answer.is_array())
    {
@@ -438,6 +625,12 @@ std::vector<qot_server_t> TimelineRestInterface::get_timeline_servers(std::strin
          }
          servers.push_back(server);
       }
+
+      // Only answers from the coordination service are cached
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      qot_server_cache_t &entry = server_cache[timeline_uuid];
+      entry.servers = servers;
+      entry.expiry = std::chrono::steady_clock::now() + std::chrono::milliseconds(QOT_REST_SERVER_TTL_MS);
    }
    return servers;
 } 
@@ -445,7 +638,6 @@ std::vector<qot_server_t> TimelineRestInterface::get_timeline_servers(std::strin
 int TimelineRestInterface::post_timeline_server(std::string timeline_uuid, qot_server_t &server)
 {
    // Create a JSON to send to the REST Coordination Service
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    auto server_json = json::value::object();
    server_json["name"] = json::value::string(server.hostname);                 
    server_json["server_type"] = json::value::string(server.type);
@@ -459,16 +651,17 @@ int TimelineRestInterface::post_timeline_server(std::string timeline_uuid, qot_s
    // Make the POST Request
    std::cout << "TimelineRestInterface: POST (register a new server: " << server.hostname << " on timeline: " << timeline_uuid << ")" << std::endl;
    std::cout << "TimelineRestInterface: Server Info is: stratum " << server_json["stratum"] << ", type " << server_json["server_type"] << std::endl;
-   make_request(new_client, methods::POST, path, server_json);
-   return 0;
+   invalidate_servers(timeline_uuid);
+   return submit(methods::POST, path, server_json, path + "/" + server.hostname, false);
 }
 
 int TimelineRestInterface::get_timeline_server_info(std::string timeline_uuid, qot_server_t &server)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/servers/" + server.hostname;
    std::cout << "TimelineRestInterface: GET (get timeline server " << server.hostname << " ) on : " << timeline_uuid << "\n";
-   auto answer = make_request(new_client, methods::GET, path, json::value::null());
+   auto answer = query(path);
+   if (!answer.is_object())
+      return -1;
 
    // Unpack the server
    for(auto iter = answer.as_object().cbegin(); iter != answer.as_object().cend(); ++iter)
@@ -497,9 +690,8 @@ int TimelineRestInterface::get_timeline_server_info(std::string timeline_uuid, q
 
 int TimelineRestInterface::delete_timeline_server(std::string &timeline_uuid, std::string &server_name)
 {
-   http_client new_client(host_url);                        // Creating a new client to ensure message goes through (Bug in C++ Rest SDK)
    std::string path = "/api/service/timelines/" + timeline_uuid + "/servers/" + server_name;
    std::cout << "TimelineRestInterface: DELETE (delete a server: " << server_name << " on timeline: " << timeline_uuid << ")" << std::endl;
-   make_request(new_client, methods::DEL, path, json::value::null());
-   return 0;
+   invalidate_servers(timeline_uuid);
+   return submit(methods::DEL, path, json::value::null(), path, false);
 }
@@ -32,18 +32,58 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
 
 #include <cpprest/http_client.h>
 
 #include "qot_tl_types.hpp"
- 
+
 using namespace web;
 using namespace web::http;
 using namespace web::http::client;
 
+// Maximum number of requests waiting for the coordination service
+#define QOT_REST_QUEUE_LEN 128
+
+// Timeout of a single request to the coordination service
+#define QOT_REST_TIMEOUT_MS 2000
+
+// Lifetime of cached timeline server lists
+#define QOT_REST_SERVER_TTL_MS 5000
+
+// Time given to the queued requests on shutdown, the rest is dropped
+#define QOT_REST_DRAIN_MS 1000
+
 namespace qot_core
 {
-	// Timeline class
+	/* Request queued for the coordination service */
+	struct qot_rest_request {
+		method mtd;							// HTTP method
+		std::string path;					// Request path
+		json::value body;					// Request body (ignored for GET/HEAD)
+		std::string key;					// Resource key used for coalescing and ordering
+		std::shared_ptr<std::promise<json::value>> reply;	// Set for blocking reads, NULL otherwise
+		std::function<void(const json::value &)> handler;	// Set for asynchronous reads, run by the worker
+	};
+
+	/* Cached timeline server list */
+	struct qot_server_cache_t {
+		std::vector<qot_server_t> servers;
+		std::chrono::steady_clock::time_point expiry;
+	};
+
+	// Timeline class: writes are queued and sent in order by a worker over a
+	// persistent connection, reads wait on the same queue with a bounded timeout
+	// or hand their answer to a callback run by the worker
 	class TimelineRestInterface
 	{
 		// Constructor and Destructor
@@ -56,6 +96,7 @@ namespace qot_core
 		public: int delete_timeline(std::string timeline_uuid);
 		public: std::vector<qot_node_phy_t> get_timeline_nodes(std::string timeline_uuid);
 		public: std::string get_timeline_metadata(std::string timeline_uuid);
+		public: int init_timeline_metadata_async(std::string timeline_uuid, std::function<void(std::string meta_data)> handler);
 		public: int put_timeline_metadata(std::string timeline_uuid, std::string meta_data);
 		public: int get_timeline_num_nodes(std::string timeline_uuid);
 		public: int get_timeline_coord_id(std::string timeline_uuid);
@@ -70,9 +111,32 @@ namespace qot_core
 		public: int get_timeline_server_info(std::string timeline_uuid, qot_server_t &server);
 		public: int delete_timeline_server(std::string &timeline_uuid, std::string &server_name);
 
+		/* Private Functions */
+		private: int submit(method mtd, std::string path, json::value body, std::string key, bool coalesce);
+		private: json::value query(std::string path);
+		private: int query_async(std::string path, std::function<void(const json::value &)> handler);
+		private: json::value execute(const qot_rest_request &request, bool &reachable);
+		private: void complete(qot_rest_request &request, const json::value &answer);
+		private: void dispatch_loop();
+		private: void invalidate_servers(std::string timeline_uuid);
+
 		/* Private Variables */
-		private: http_client client;		// C++ Rest SDK Client Instance
 		private: std::string host_url;	// Host at which to make the request
+		private: http_client_config client_config;		// Client configuration (timeouts)
+		private: std::unique_ptr<http_client> client;	// C++ Rest SDK Client Instance (used by the worker only)
+
+		// Request queue and the pending coalescible write per resource
+		private: std::mutex queue_mutex;
+		private: std::condition_variable queue_cv;
+		private: std::deque<std::shared_ptr<qot_rest_request>> request_queue;
+		private: std::unordered_map<std::string, std::shared_ptr<qot_rest_request>> pending_writes;
+		private: bool running;
+		private: std::chrono::steady_clock::time_point drain_deadline;	// Set when the interface shuts down
+		private: std::thread dispatch_thread;
+
+		// Timeline server lists with a TTL
+		private: std::mutex cache_mutex;
+		private: std::map<std::string, qot_server_cache_t> server_cache;
 
 	};
 }
@@ -44,7 +44,6 @@ extern "C"
     #include <sys/types.h> 
     #include <sys/socket.h> 
     #include <sys/un.h> 
-    #include <sys/time.h> //FD_SET, FD_ISSET, FD_ZERO macros 
     #include <fcntl.h>
     #include <signal.h>   // SIGINT
     #include <poll.h>
@@ -74,17 +73,20 @@ extern "C"
 // Add header to JSON Serializing functions
 #include "qot_tlmsg_serialize.hpp"
 
+// epoll reactor and request worker pool
+#include "qot_timeline_reactor.hpp"
+
+// Per-request logging (debug level)
+#include <boost/log/trivial.hpp>
+
+// Runtime metrics
+#include "../sync-service/qot_metrics.hpp"
+
 // JSON C++ namespace
 using json = nlohmann::json;
 
 using namespace qot_core;
 
-// Maximum Clients
-#define MAX_CLIENTS 30
-
-// Select Timeout (seconds)
-#define TIMEOUT 5
-
 // Default Node Unique name
 #define NODE_UUID "test_node"
 
@@ -98,7 +100,7 @@ using namespace qot_core;
 //#define QOT_DEF_LOCAL_TL 1
 
 // Running Flag
-static int running = 1;
+static volatile int running = 1;
 
 // Exit Handler to terminate the program on Ctrl+C
 static void exit_handler(int s)
@@ -178,19 +180,380 @@ std::vector<std::string> GetPeerClients(nlohmann::json &cluster_config_data, std
     return peer_clients;
 }
 
+/* State shared by the request workers */
+typedef struct qot_tlservice_ctx {
+    TimelineRegistry *tl_registry;          /* Timeline registry                 */
+    std::string node_uuid;                  /* Node unique name                  */
+    std::string rest_server;                /* Coordination service REST server  */
+    std::string pub_server;                 /* Pub-sub server                    */
+    int peer_flag;                          /* Peer sync is being used           */
+    std::vector<std::string> peer_clients;  /* Peers from the cluster config     */
+    TimelineReactor *reactor;               /* Connection reactor                */
+} qot_tlservice_ctx_t;
+
+// Request type labels of the dispatch latency histograms (indexed by tlmsg_type_t)
+static const char *tlmsg_type_names[] = {
+    "TIMELINE_CREATE", "TIMELINE_DESTROY", "TIMELINE_UPDATE", "TIMELINE_BIND", "TIMELINE_UNBIND",
+    "TIMELINE_QUALITY", "TIMELINE_INFO", "TIMELINE_SHM_CLOCK", "TIMELINE_SHM_CLKSYNC", "TIMELINE_OV_SHM_CLOCK",
+    "TIMELINE_OV_SHM_CLKSYNC", "TIMELINE_GET_SERVER", "TIMELINE_SET_SERVER", "TIMELINE_REQ_LATENCY",
+    "TIMELINE_GET_LATENCY", "TIMELINE_UNDEFINED"
+};
+
+/* Dispatch latency histogram of a request type (-1 for unknown types) */
+static int request_metric(int msgtype)
+{
+    static std::vector<int> metric_ids = []() {
+        std::vector<int> ids;
+        for (size_t i = 0; i < sizeof(tlmsg_type_names)/sizeof(tlmsg_type_names[0]); i++)
+            ids.push_back(qot::metrics_register(qot::QOT_METRIC_HISTOGRAM, "qot_timeline_request_seconds",
+                                                std::string("type=\"") + tlmsg_type_names[i] + "\"",
+                                                "Time to service a timeline request, including the reply"));
+        return ids;
+    }();
+    if (msgtype < 0 || msgtype >= (int) metric_ids.size())
+        return -1;
+    return metric_ids[msgtype];
+}
+
+/* Service a single request on a worker thread and reply to the client */
+static void process_request(qot_tlservice_ctx_t &ctx, std::shared_ptr<TimelineConnection> &conn, qot_timeline_msg_t &tl_msg, bool binary_flag)
+{
+    // Pointer to a timeline
+    TimelineCore *tl_ptr;
+
+    // Consructor status flag
+    int status_flag = 0;
+
+    // Shared Memory File Descriptor Message Variables
+    int clk_fd;
+    int n_bytes;
+
+    // Dispatch latency of this request type
+    qot::MetricsTimer request_timer(request_metric(tl_msg.msgtype));
+
+    // Parse the message and send data to kernel module/ application
+    tl_msg.retval = QOT_RETURN_TYPE_OK;
+    BOOST_LOG_TRIVIAL(debug) << "Request type " << tl_msg.msgtype << " for timeline " << tl_msg.info.index << " (" << tl_msg.info.name << ")";
+
+    // Take action based on the message type
+    switch(tl_msg.msgtype)
+    {
+        case TIMELINE_CREATE:
+            tl_ptr = new TimelineCore(tl_msg.info, *ctx.tl_registry, ctx.node_uuid, ctx.rest_server, ctx.pub_server);
+            status_flag = tl_ptr->query_status_flag();
+            // If an error is detected during the class creation, call the destructor
+            if (status_flag > 0)
+            {
+                delete tl_ptr;
+                if (status_flag > 1) 
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+                else // Timeline exists
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+            {
+                // Check if timeline is local and set the peers (this may need to be fetched from the coord service)
+                if (tl_msg.info.type == QOT_TIMELINE_LOCAL && ctx.peer_flag == 1)
+                    tl_ptr->update_local_peers(ctx.peer_clients);
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+
+            break;
+        case TIMELINE_DESTROY:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                // Check if the timeline has no bindings before destroying
+                BOOST_LOG_TRIVIAL(debug) << "TimelineDestroy: timeline binding count is " << tl_ptr->get_binding_count();
+                if (tl_ptr->get_binding_count() == 0)
+                    delete tl_ptr;
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+        case TIMELINE_UPDATE:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                tl_ptr->update_binding(tl_msg.binding);
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+            
+            break;
+        case TIMELINE_BIND:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                tl_ptr->create_binding(tl_msg.binding);
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                BOOST_LOG_TRIVIAL(debug) << "TimelineBind: timeline binding count is " << tl_ptr->get_binding_count();
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+        case TIMELINE_UNBIND:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                tl_ptr->delete_binding(tl_msg.binding);
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                BOOST_LOG_TRIVIAL(debug) << "TimelineUnBind: timeline binding count is " << tl_ptr->get_binding_count();
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+        case TIMELINE_QUALITY:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                tl_msg.demand = tl_ptr->get_desired_qot();
+                tl_msg.binding.demand = tl_msg.demand;
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+        case TIMELINE_INFO:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                tl_msg.info = tl_ptr->get_timeline_info();
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+        case TIMELINE_SHM_CLOCK:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                // Get the readonly file descriptor
+                clk_fd = tl_ptr->get_rdonly_shm_fd();
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                n_bytes = ctx.reactor->send_descriptor(conn, clk_fd);
+                if (n_bytes < 0)
+                {
+                    perror("sendmsg() sending clock shm fd failed");
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+                }
+                else
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Sent rd-only shm fd to client process";
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                }
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_SHM_CLKSYNC:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                // Get the read-write file descriptor
+                clk_fd = tl_ptr->get_shm_fd();
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                if (ctx.reactor->send_descriptor(conn, clk_fd) < 0)
+                {
+                    perror("sendmsg() sending clock shm fd failed");
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+                }
+                else
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Sent shm fd to clock-sync process";
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                }
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_OV_SHM_CLOCK:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                // Get the readonly file descriptor
+                clk_fd = tl_ptr->get_overlay_rdonly_shm_fd();
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                n_bytes = ctx.reactor->send_descriptor(conn, clk_fd);
+                if (n_bytes < 0)
+                {
+                    perror("sendmsg() sending overlay clock shm fd failed");
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+                }
+                else
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Sent rd-only overlay shm fd to client process";
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                }
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_OV_SHM_CLKSYNC:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                // Get the read-write file descriptor
+                clk_fd = tl_ptr->get_overlay_shm_fd();
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+                if (ctx.reactor->send_descriptor(conn, clk_fd) < 0)
+                {
+                    perror("sendmsg() sending overlay clock shm fd failed");
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+                }
+                else
+                {
+                    BOOST_LOG_TRIVIAL(debug) << "Sent overlay shm fd to clock-sync process";
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                }
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_GET_SERVER:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                qot_server_t server;
+                if (tl_ptr->get_server(server) == 0)
+                {
+                    // Send the data as space separated values [hostname type stratum]
+                    tl_msg.aux_data = server.hostname + " " + server.type + " "  + std::to_string(server.stratum);
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                }
+                else
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_SET_SERVER:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned
+            if (tl_ptr)
+            {
+                qot_server_t server;
+                // Parse the data as space separated values [hostname type stratum]
+                std::istringstream iss(tl_msg.aux_data);
+                std::string word;
+                int ctr = 0;
+                while(iss >> word) {
+                    /* unroll the string */
+                    if (ctr == 0)
+                        server.hostname = word;
+                    else if (ctr == 1)
+                        server.type = word;
+                    else if (ctr == 2)
+                        server.stratum = std::stoi(word);
+
+                    ctr++;
+                }
+                BOOST_LOG_TRIVIAL(debug) << "TIMELINE_SET_SERVER: hostname " << server.hostname << " type " << server.type << " stratum " << server.stratum;
+                if (tl_ptr->set_server(server) == 0)
+                    tl_msg.retval = QOT_RETURN_TYPE_OK;
+                else
+                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
+            }
+            else
+                tl_msg.retval = QOT_RETURN_TYPE_ERR;
+
+            break;
+
+        case TIMELINE_REQ_LATENCY:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned -> Function TBD
+            if (tl_ptr)
+            {
+               tl_msg.retval = QOT_RETURN_TYPE_OK; 
+            }
+            else
+               tl_msg.retval = QOT_RETURN_TYPE_ERR; 
+
+            break;
+
+        case TIMELINE_GET_LATENCY:
+            tl_ptr = (TimelineCore*)ctx.tl_registry->qot_tl_class_get(tl_msg.info.index);
+            // If a valid pointer is returned -> Function TBD
+            if (tl_ptr)
+            {
+                tl_msg.retval = QOT_RETURN_TYPE_OK;
+            }
+            else
+               tl_msg.retval = QOT_RETURN_TYPE_ERR; 
+            
+            break;
+
+        default:
+            tl_msg.retval = QOT_RETURN_TYPE_ERR;
+            break;
+    }
+
+    // A shm file descriptor that was sent is the reply
+    bool fd_sent = (tl_msg.msgtype == TIMELINE_SHM_CLOCK || tl_msg.msgtype == TIMELINE_OV_SHM_CLOCK ||
+                    tl_msg.msgtype == TIMELINE_SHM_CLKSYNC || tl_msg.msgtype == TIMELINE_OV_SHM_CLKSYNC);
+    if (!fd_sent || tl_msg.retval == QOT_RETURN_TYPE_ERR)
+    {
+        // Send Populated message struct back to the user
+        BOOST_LOG_TRIVIAL(debug) << "Reply type " << tl_msg.msgtype << " for timeline " << tl_msg.info.index << " (" << tl_msg.info.name << "): " << tl_msg.retval;
+
+        /* Serialize Message (binary requests are answered in binary if the reply fits a frame) */
+        char bin_frame[QOT_TLMSG_BIN_SIZE];
+        if (binary_flag && serialize_tlmsg_binary(tl_msg, bin_frame, sizeof(bin_frame)) > 0)
+        {
+            ctx.reactor->send_reply(conn, bin_frame, QOT_TLMSG_BIN_SIZE);
+        }
+        else
+        {
+            nlohmann::json data = serialize_tlmsg(tl_msg);
+            // Accept the binary format offered by the client (set by the reactor before dispatch)
+            if (conn->wire_format > 0)
+                data["wire"] = conn->wire_format;
+            std::string msg_string = data.dump();
+            ctx.reactor->send_reply(conn, msg_string.c_str(), msg_string.length());
+        }
+    }
+}
+
 /* Timeline Service Main Function */
 int main(int argc , char *argv[])  
 {  
     int opt = 1; // TRUE 
-    int master_socket, addrlen, new_socket, client_socket[MAX_CLIENTS], max_clients = MAX_CLIENTS , activity, i , valread , sd;  
-    int max_sd;  
+    int master_socket;  
 
     // Get the node uuid
     std::string node_uuid = NODE_UUID;
     if (argc > 1)
         node_uuid = std::string(argv[1]);
 
-    // Get the NATS Server 
+    // Get the pub-sub server (NATS host:port, or a nats://, inproc:// or local:// URL)
     std::string pub_server = NATS_SERVER;
     if (argc > 2)
         pub_server = std::string(argv[2]);
@@ -203,12 +566,17 @@ int main(int argc , char *argv[])
     // Get the Config file for the Peer2Peer Sync
     std::string peer_file = "NULL";
     int peer_flag = 0; // Flag indicating peer sync is being used
-    if (argc > 4)
+    if (argc > 4 && std::string(argv[4]).compare("NULL") != 0)
     {
         peer_file = std::string(argv[4]);
         peer_flag = 1;
     }
 
+    // Get the number of request worker threads
+    int num_workers = QOT_TLSERVICE_WORKERS;
+    if (argc > 5)
+        num_workers = atoi(argv[5]);
+
     // Pointer to a timeline
     TimelineCore *tl_ptr;
 
@@ -217,19 +585,6 @@ int main(int argc , char *argv[])
 
     // Socket Address
     struct sockaddr_un address;
-        
-    // Set of socket descriptors 
-    fd_set readfds; 
-
-    // Timeval for select timeout
-    struct timeval timeout = {TIMEOUT,0};
-
-    // Shared Memory File Descriptor Message Variables
-    int clk_fd;
-    int n_bytes;
-
-    // QoT Virtualization Message
-    qot_timeline_msg_t tl_msg; 
 
     // Read the cluster configuration file
     int cluster_config_valid = 0;
@@ -276,12 +631,6 @@ int main(int argc , char *argv[])
     // Close the socket to the sync service
     close(sync_sock);
 
-    // Initialise all client_socket[] to 0 so not checked 
-    for (i = 0; i < max_clients; i++)  
-    {  
-        client_socket[i] = 0;  
-    } 
-        
     // Create a master socket 
     if((master_socket = socket(AF_UNIX, SOCK_STREAM, 0)) == 0)  
     {  
@@ -315,15 +664,13 @@ int main(int argc , char *argv[])
     // Listen for Connections
     std::cout << "Listening for connections ..." << "\n";  
         
-    // Try to specify maximum of 3 pending connections for the master socket 
-    if (listen(master_socket, 3) < 0)  
+    // Allow a large backlog, bursts of containers connect at once
+    if (listen(master_socket, SOMAXCONN) < 0)  
     {  
         std::cout << "listen failed" << "\n";  
         exit(EXIT_FAILURE);  
     }  
         
-    // Accept the incoming connection 
-    addrlen = sizeof(address);  
     std::cout << "Waiting for connections ..." << "\n";  
 
     // Install SIGINT Signal Handler for exit
@@ -432,441 +779,36 @@ int main(int argc , char *argv[])
     }
     #endif
 
+    // Reactor accepting connections and dispatching requests to a worker pool
+    qot_tlservice_ctx_t service_ctx;
+    service_ctx.tl_registry = &tl_registry;
+    service_ctx.node_uuid = node_uuid;
+    service_ctx.rest_server = rest_server;
+    service_ctx.pub_server = pub_server;
+    service_ctx.peer_flag = peer_flag;
+    service_ctx.peer_clients = peer_clients;
+
+    using namespace std::placeholders;
+    service_ctx.reactor = new TimelineReactor(master_socket, num_workers, std::bind(process_request, std::ref(service_ctx), _1, _2, _3));
+    if (service_ctx.reactor->query_status_flag() > 0)
+    {
+        delete service_ctx.reactor;
+        delete GlobalClock;
+        // Unlink the socket and exit 
+        unlink(TL_SOCKET_PATH);
+        exit(EXIT_FAILURE);
+    }
+
+    // Runtime metrics (shm snapshot and Prometheus socket)
+    qot::MetricsExporter metrics_exporter("timeline");
+    if (metrics_exporter.Start() < 0)
+        std::cout << "Timeline service: metrics are not exported\n";
 
-    
     // Main Loop listening for commands
-    while(running)  
-    {  
-        // Clear the socket set 
-        FD_ZERO(&readfds);  
-    
-        // Add master socket to set 
-        FD_SET(master_socket, &readfds);  
-        max_sd = master_socket;  
-            
-        // Add child sockets to set 
-        for (i = 0; i < max_clients; i++)  
-        {  
-            // Socket descriptor 
-            sd = client_socket[i];  
-                
-            // If valid socket descriptor then add to read list 
-            if(sd > 0)  
-                FD_SET(sd, &readfds);
-                
-            // Highest file descriptor number, need it for the select function 
-            if(sd > max_sd)  
-                max_sd = sd;
-        }  
-
-        // Reset Timeout
-        timeout.tv_sec = TIMEOUT;
-        timeout.tv_usec = 0;
-    
-        // Wait for an activity on one of the sockets, timeout is set to 5s (to enable program termination), 
-        activity = select(max_sd + 1, &readfds, NULL, NULL, &timeout);  
-
-        if ((activity < 0) && (errno!=EINTR))  
-        {  
-            std::cout << "select experienced an error" << "\n";  
-        }  
-        else if ((activity < 0) && (errno==EINTR))
-        {
-            std::cout << "Received Interrupt\n";
-            continue;
-        }
-        else
-        { 
-            // If something happened on the master socket, then its an incoming connection 
-            if (FD_ISSET(master_socket, &readfds))  
-            {  
-                if ((new_socket = accept(master_socket, (struct sockaddr *)&address, (socklen_t*)&addrlen))<0)  
-                {  
-                    std::cout << "accept failure\n";  
-
-                    // Delete the global timeline clock
-                    delete GlobalClock;
-                    // Unlink the socket    
-                    unlink(TL_SOCKET_PATH);
-                    exit(EXIT_FAILURE);  
-                }  
-                
-                // Inform user of socket number - used in send and receive commands 
-                std::cout << "New connection, socket fd is " << new_socket << "\n";   
-                    
-                // Add new socket to array of sockets 
-                for (i = 0; i < max_clients; i++)  
-                {  
-                    // If position is empty 
-                    if(client_socket[i] == 0)  
-                    {  
-                        client_socket[i] = new_socket;  
-                        printf("Adding to list of sockets as %d\n" , i);        
-                        break;  
-                    }  
-                }  
-            }  
-                
-            // Else it is some IO operation on some other socket
-            for (i = 0; i < max_clients; i++)  
-            {  
-                sd = client_socket[i];  
-                    
-                if (FD_ISSET(sd, &readfds))  
-                {  
-                    // Check if it was for closing, and also read the incoming message 
-                    const unsigned int MAX_BUF_LENGTH = 4096;
-                    std::vector<char> buffer(MAX_BUF_LENGTH);
-                    std::string rcv;   
-                    int bytesReceived = 0;
-                    int recv_flag = 0;
-                    do {
-                        bytesReceived = read(sd, &buffer[0], buffer.size());
-                        // Append string from buffer.
-                        if (bytesReceived == -1 && recv_flag == 0) 
-                        { 
-                            // error 0 -> handle it ! (TBD)
-                        } 
-                        else if (bytesReceived == 0)
-                        {
-                            // Somebody disconnected, get details and print 
-                            getpeername(sd, (struct sockaddr*)&address, (socklen_t*)&addrlen);  
-                            std::cout << "Host disconnected fd is " << sd << "\n"; 
-                                
-                            // Close the socket and mark as 0 in list for reuse 
-                            close(sd);  
-                            client_socket[i] = 0;  
-                            break;
-                        }
-                        else 
-                        {
-                            rcv.append(buffer.cbegin(), buffer.cend());
-                            recv_flag = 1;
-                        }
-                    } while ( bytesReceived == MAX_BUF_LENGTH );  
-
-                    if (recv_flag == 0) // No message received
-                        continue;
-
-                    /* De-serialize data */
-                    nlohmann::json data = nlohmann::json::parse(rcv);
-                    deserialize_tlmsg(data, tl_msg);
-
-                    // Parse the message and send data to kernel module/ application
-                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                    std::cout << "Message Received \n";
-                    std::cout << "Type           : " << tl_msg.msgtype << "\n";
-                    std::cout << "Guest TL ID    : " << tl_msg.info.index << "\n";
-                    std::cout << "Guest TL Name  : " << tl_msg.info.name << "\n";
-                
-                    // Take action based on the message type
-                    switch(tl_msg.msgtype)
-                    {
-                        case TIMELINE_CREATE:
-                            tl_ptr = new TimelineCore(tl_msg.info, tl_registry, node_uuid, rest_server, pub_server);
-                            status_flag = tl_ptr->query_status_flag();
-                            // If an error is detected during the class creation, call the destructor
-                            if (status_flag > 0)
-                            {
-                                delete tl_ptr;
-                                if (status_flag > 1) 
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                                else // Timeline exists
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                            {
-                                // Check if timeline is local and set the peers (this may need to be fetched from the coord service)
-                                if (tl_msg.info.type == QOT_TIMELINE_LOCAL && peer_flag == 1)
-                                    tl_ptr->update_local_peers(peer_clients);
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-
-                            break;
-                        case TIMELINE_DESTROY:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                // Check if the timeline has no bindings before destroying
-                                std::cout << "TimelineDestroy:Timeline binding count is " << tl_ptr->get_binding_count() << "\n";
-                                if (tl_ptr->get_binding_count() == 0)
-                                    delete tl_ptr;
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-                        case TIMELINE_UPDATE:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                tl_ptr->update_binding(tl_msg.binding);
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                            
-                            break;
-                        case TIMELINE_BIND:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                tl_ptr->create_binding(tl_msg.binding);
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                std::cout << "TimelineBind:Timeline binding count is " << tl_ptr->get_binding_count() << "\n";
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-                        case TIMELINE_UNBIND:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                tl_ptr->delete_binding(tl_msg.binding);
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                std::cout << "TimelineUnBind:Timeline binding count is " << tl_ptr->get_binding_count() << "\n";
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-                        case TIMELINE_QUALITY:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                tl_msg.demand = tl_ptr->get_desired_qot();
-                                tl_msg.binding.demand = tl_msg.demand;
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-                        case TIMELINE_INFO:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                tl_msg.info = tl_ptr->get_timeline_info();
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-                        case TIMELINE_SHM_CLOCK:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                // Get the readonly file descriptor
-                                clk_fd = tl_ptr->get_rdonly_shm_fd();
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                n_bytes = send_fd(sd, clk_fd);
-                                if (n_bytes < 0)
-                                {
-                                    perror("sendmsg() sending clock shm fd failed");
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                                }
-                                else
-                                {
-                                    std::cout << "Sent rd-only shm fd to client process\n";
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                }
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_SHM_CLKSYNC:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                // Get the read-write file descriptor
-                                clk_fd = tl_ptr->get_shm_fd();
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                if (send_fd(sd, clk_fd) < 0)
-                                {
-                                    perror("sendmsg() sending clock shm fd failed");
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                                }
-                                else
-                                {
-                                    std::cout << "Sent shm fd to clock-sync process\n";
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                }
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_OV_SHM_CLOCK:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                // Get the readonly file descriptor
-                                clk_fd = tl_ptr->get_overlay_rdonly_shm_fd();
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                n_bytes = send_fd(sd, clk_fd);
-                                if (n_bytes < 0)
-                                {
-                                    perror("sendmsg() sending overlay clock shm fd failed");
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                                }
-                                else
-                                {
-                                    std::cout << "Sent rd-only overlay shm fd to client process\n";
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                }
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_OV_SHM_CLKSYNC:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                // Get the read-write file descriptor
-                                clk_fd = tl_ptr->get_overlay_shm_fd();
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                if (send_fd(sd, clk_fd) < 0)
-                                {
-                                    perror("sendmsg() sending overlay clock shm fd failed");
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                                }
-                                else
-                                {
-                                    std::cout << "Sent overlay shm fd to clock-sync process\n";
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                }
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_GET_SERVER:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                qot_server_t server;
-                                if (tl_ptr->get_server(server) == 0)
-                                {
-                                    // Send the data as space separated values [hostname type stratum]
-                                    tl_msg.aux_data = server.hostname + " " + server.type + " "  + std::to_string(server.stratum);
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                }
-                                else
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_SET_SERVER:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned
-                            if (tl_ptr)
-                            {
-                                qot_server_t server;
-                                // Parse the data as space separated values [hostname type stratum]
-                                std::istringstream iss(tl_msg.aux_data);
-                                std::string word;
-                                int ctr = 0;
-                                while(iss >> word) {
-                                    /* unroll the string */
-                                    if (ctr == 0)
-                                        server.hostname = word;
-                                    else if (ctr == 1)
-                                        server.type = word;
-                                    else if (ctr == 2)
-                                        server.stratum = std::stoi(word);
-
-                                    ctr++;
-                                }
-                                std::cout << "qot_timeline_service: TIMELINE_SET_SERVER: hostname " << server.hostname << " type " << server.type << " stratum " << server.stratum << "\n";
-                                if (tl_ptr->set_server(server) == 0)
-                                    tl_msg.retval = QOT_RETURN_TYPE_OK;
-                                else
-                                    tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                            }
-                            else
-                                tl_msg.retval = QOT_RETURN_TYPE_ERR;
-
-                            break;
-
-                        case TIMELINE_REQ_LATENCY:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned -> Function TBD
-                            if (tl_ptr)
-                            {
-                               tl_msg.retval = QOT_RETURN_TYPE_OK; 
-                            }
-                            else
-                               tl_msg.retval = QOT_RETURN_TYPE_ERR; 
-
-                            break;
-
-                        case TIMELINE_GET_LATENCY:
-                            tl_ptr = (TimelineCore*)tl_registry.qot_tl_class_get(tl_msg.info.index);
-                            // If a valid pointer is returned -> Function TBD
-                            if (tl_ptr)
-                            {
-                                tl_msg.retval = QOT_RETURN_TYPE_OK;
-                            }
-                            else
-                               tl_msg.retval = QOT_RETURN_TYPE_ERR; 
-                            
-                            break;
-
-                        default:
-                            tl_msg.retval = QOT_RETURN_TYPE_ERR;
-                            break;
-                    }
-
-                    // Check if the request was for a shm file descriptor
-                    if ((tl_msg.msgtype == TIMELINE_SHM_CLOCK || tl_msg.msgtype == TIMELINE_OV_SHM_CLOCK)  && tl_msg.retval != QOT_RETURN_TYPE_ERR)
-                    {
-                        std::cout << "Succesfully sent read-only shm file descriptor\n";
-                    }
-                    else if ((tl_msg.msgtype == TIMELINE_SHM_CLKSYNC || tl_msg.msgtype == TIMELINE_OV_SHM_CLKSYNC) && tl_msg.retval != QOT_RETURN_TYPE_ERR)
-                    {
-                        std::cout << "Succesfully sent shm file descriptor\n";
-                    }
-                    else
-                    {
-                        // Send Populated message struct back to the user
-                        std::cout << "Generated Reply\n";
-                        std::cout << "Type          : " << tl_msg.msgtype << "\n";
-                        std::cout << "Host TL ID    : " << tl_msg.info.index << "\n";
-                        std::cout << "Host TL Name  : " << tl_msg.info.name << "\n";
-                        std::cout << "Retval        : " << tl_msg.retval << "\n";
-                
-                        /* Serialize Message */
-                        data = serialize_tlmsg(tl_msg);
-                        std::string msg_string = data.dump();
-                        int bytes = send(sd, msg_string.c_str() , msg_string.length(), 0); 
-                    }
-                }  
-            }
-        }  
-    }  
+    service_ctx.reactor->run(running);
+
+    // Stop the workers and close all the client connections
+    delete service_ctx.reactor;
 
     std::cout << "Timeline service stopping ...\n";
 
@@ -27,6 +27,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <functional>
 #include <iostream>
 
 #include "qot_timeline_subscriber.hpp"
@@ -40,11 +41,11 @@
 
 using namespace qot_core;
 
-/* NATS Subscription handler for global node changes */
-void global_node_change_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+/* Subscription handler for global node changes */
+static void global_node_change_handler(const std::string &subject, const std::string &msg, void *closure)
 {
     /* De-serialize data */
-    json::value answer = json::value::parse(std::string(natsMsg_GetData(msg)));
+    json::value answer = json::value::parse(msg);
 
     // Get the TimelineCore pointer
     TimelineCore *tl_core = (TimelineCore*)closure;
@@ -82,16 +83,13 @@ void global_node_change_handler(natsConnection *nc, natsSubscription *sub, natsM
 
     if (closure != NULL)
     	tl_core->update_global_coordination_info(node_vector);
-
-    // Need to destroy the message!
-    natsMsg_Destroy(msg);
 }
 
-/* NATS Subscription handler for local node changes */
-void local_node_change_handler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+/* Subscription handler for local node changes */
+static void local_node_change_handler(const std::string &subject, const std::string &msg, void *closure)
 {
     /* De-serialize data */
-    json::value answer = json::value::parse(std::string(natsMsg_GetData(msg)));
+    json::value answer = json::value::parse(msg);
 
     // Get the TimelineCore pointer
     TimelineCore *tl_core = (TimelineCore*)closure;
@@ -129,14 +127,11 @@ void local_node_change_handler(natsConnection *nc, natsSubscription *sub, natsMs
 
     if (closure != NULL)
         tl_core->update_local_coordination_info(node_vector);
-
-    // Need to destroy the message!
-    natsMsg_Destroy(msg);
 }
 
 // Constructor and Destructor
-TimelineSubscriber::TimelineSubscriber(std::string nats_host, std::string timeline_uuid, void *parent)
- : timeline_uuid(timeline_uuid), nats_host(nats_host), parent_class(parent)
+TimelineSubscriber::TimelineSubscriber(std::string pubsub_host, std::string timeline_uuid, void *parent)
+ : transport(NULL), global_sub(-1), local_sub(-1), pubsub_host(pubsub_host), timeline_uuid(timeline_uuid), parent_class(parent)
 {
 	// Can be used to initialize the class
 	std::cout << "TimelineSubscriber: Initialized for timeline " << timeline_uuid << "\n";
@@ -144,62 +139,60 @@ TimelineSubscriber::TimelineSubscriber(std::string nats_host, std::string timeli
 
 TimelineSubscriber::~TimelineSubscriber()
 {
-	// Can be used to terminate the class
+	pubsubUnSubscribe();
 }
 
-/* Subscribe to a NATS topic (subject) */
-int TimelineSubscriber::natsSubscribe()
+/* Subscribe to the coordination topics (subjects) */
+int TimelineSubscriber::pubsubSubscribe()
 {
+    using namespace std::placeholders;
+
     std::string global_topic = "coordination.timelines." + timeline_uuid + ".global";
     std::string local_topic = "coordination.timelines." + timeline_uuid + ".local";
 
-    std::string host = "nats://" + nats_host;
+    // A plain host:port is a NATS server
+    std::string host = pubsub_host;
+    if (host.find("://") == std::string::npos)
+        host = "nats://" + host;
 
-    // Creates a connection to the default NATS URL
-    s = natsConnection_ConnectTo(&conn, host.c_str());
-    if (s == NATS_OK)
+    // Creates a connection to the pub-sub server
+    transport = qot::pubsub_connect(host);
+    if (transport == NULL)
     {
-        std::cout << "TimelineSubscriber: Connected to NATS server\n";
-
-        // Creates an asynchronous subscription on the specified topic.
-        s = natsConnection_Subscribe(&sub, conn, global_topic.c_str(), global_node_change_handler, parent_class);
+        std::cout << "TimelineSubscriber: Failed to connect to pub-sub server " << host << "\n";
+        return -1;
     }
+    std::cout << "TimelineSubscriber: Connected to pub-sub server\n";
 
-    if (s == NATS_OK)
-    {
-        std::cout << "TimelineSubscriber: Succesfully subscribed to global timeline node topic\n";
-
-        // Creates an asynchronous subscription on the specified topic.
-        s = natsConnection_Subscribe(&sub, conn, local_topic.c_str(), local_node_change_handler, parent_class);
-    }
+    // Creates asynchronous subscriptions on the specified topics
+    global_sub = transport->Subscribe(global_topic, std::bind(global_node_change_handler, _1, _2, parent_class));
+    if (global_sub < 0)
+        return -1;
+    std::cout << "TimelineSubscriber: Succesfully subscribed to global timeline node topic\n";
 
-    // If there was an error, print a stack trace and exit
-    if (s != NATS_OK)
-    {
-        nats_PrintLastErrorStack(stderr);
-        return (int)s;
-    }
-    else
-    {
-        std::cout << "TimelineSubscriber: Succesfully subscribed to local timeline node topic\n";
-    }
+    local_sub = transport->Subscribe(local_topic, std::bind(local_node_change_handler, _1, _2, parent_class));
+    if (local_sub < 0)
+        return -1;
+    std::cout << "TimelineSubscriber: Succesfully subscribed to local timeline node topic\n";
 
-    return NATS_OK;
+    return 0;
 }
 
-/* Un-subscribe from a NATS topic (subject) */
-int TimelineSubscriber::natsUnSubscribe()
+/* Un-subscribe from the coordination topics (subjects) */
+int TimelineSubscriber::pubsubUnSubscribe()
 {
     // Anything that is created need to be destroyed
-    if (s == NATS_OK)
+    if (transport != NULL)
     {
-        natsSubscription_Destroy(sub);
-        natsConnection_Destroy(conn);
+        if (global_sub >= 0)
+            transport->Unsubscribe(global_sub);
+        if (local_sub >= 0)
+            transport->Unsubscribe(local_sub);
+        delete transport;
     }
-    
-    conn = NULL;
-    sub  = NULL;
-    done  = false;
+    transport = NULL;
+    global_sub = -1;
+    local_sub = -1;
     return 0;
 }
 
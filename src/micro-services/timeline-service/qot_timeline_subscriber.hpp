@@ -30,8 +30,10 @@
 #ifndef QOT_TIMELINE_SUBSCRIBER_HPP
 #define QOT_TIMELINE_SUBSCRIBER_HPP
 
-// NATS client header
-#include <nats/nats.h>
+#include <string>
+
+// Publish/subscribe transport
+#include "../sync-service/qot_pubsub.hpp"
 
 namespace qot_core
 {
@@ -39,21 +41,20 @@ namespace qot_core
 	class TimelineSubscriber
 	{
 		// Constructor and Destructor
-		public: TimelineSubscriber(std::string nats_host, std::string timeline_uuid, void *parent);
+		public: TimelineSubscriber(std::string pubsub_host, std::string timeline_uuid, void *parent);
 		public: ~TimelineSubscriber();
 
-		/* Subscribe to a NATS topic (subject) */
-		public: int natsSubscribe();
+		/* Subscribe to the coordination topics (subjects) */
+		public: int pubsubSubscribe();
 
-		/* Un-subscribe from a NATS topic (subject) */
-		public: int natsUnSubscribe();
+		/* Un-subscribe from the coordination topics (subjects) */
+		public: int pubsubUnSubscribe();
 
-		/* Private NATS Connection Variables*/
-		private: natsConnection      *conn;
-	    private: natsSubscription    *sub;
-	    private: natsStatus          s;
-	    private: volatile bool       done;
-		private: std::string nats_host;
+		/* Private Pub-Sub Connection Variables*/
+		private: qot::PubSubTransport *transport;
+	    private: int                 global_sub;
+	    private: int                 local_sub;
+		private: std::string pubsub_host;   // URL, or host:port of a NATS server
 
 	    /* Private State Variables */
 		private: std::string timeline_uuid; 
@@ -109,5 +109,156 @@ void deserialize_tlmsg(nlohmann::json &data, qot_timeline_msg_t &msg)
 	return;
 }
 
+/* Little-endian field helpers for the binary wire format */
+static inline void put_le16(char *p, uint16_t v)
+{
+	p[0] = (char)(v & 0xff);
+	p[1] = (char)((v >> 8) & 0xff);
+}
+
+static inline void put_le32(char *p, uint32_t v)
+{
+	put_le16(p, (uint16_t)(v & 0xffff));
+	put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline void put_le64(char *p, uint64_t v)
+{
+	put_le32(p, (uint32_t)(v & 0xffffffffULL));
+	put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint16_t get_le16(const char *p)
+{
+	return (uint16_t)((unsigned char)p[0] | ((unsigned char)p[1] << 8));
+}
+
+static inline uint32_t get_le32(const char *p)
+{
+	return (uint32_t)get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static inline uint64_t get_le64(const char *p)
+{
+	return (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+/* Binary frame layout (version 1), byte offsets from the start of the frame */
+#define TLBIN_OFF_LENGTH    0    /* u32 bytes following the length prefix */
+#define TLBIN_OFF_MAGIC     4    /* u32 QOT_TLMSG_BIN_MAGIC               */
+#define TLBIN_OFF_VERSION   8    /* u16 format version                    */
+#define TLBIN_OFF_MSGTYPE   10   /* u16 tlmsg_type_t                      */
+#define TLBIN_OFF_RETVAL    12   /* s32 qot_return_t                      */
+#define TLBIN_OFF_TLINDEX   16   /* s32 timeline index                    */
+#define TLBIN_OFF_TLTYPE    20   /* s32 timeline type                     */
+#define TLBIN_OFF_BINDID    24   /* s32 binding id                        */
+#define TLBIN_OFF_AUXLEN    28   /* u16 aux_data length (u16 reserved)    */
+#define TLBIN_OFF_TLNAME    32   /* char[QOT_MAX_NAMELEN] timeline name   */
+#define TLBIN_OFF_BINDNAME  96   /* char[QOT_MAX_NAMELEN] binding name    */
+#define TLBIN_OFF_DEMAND    160  /* 6 x u64 resolution/accuracy           */
+#define TLBIN_OFF_AUX       208  /* char[QOT_TLMSG_AUX_MAXLEN] aux_data   */
 
+// Check whether a received buffer starts with a binary frame
+bool is_tlmsg_binary(const char *buf, size_t len)
+{
+	if (len < TLBIN_OFF_VERSION)
+		return false;
+	return get_le32(buf + TLBIN_OFF_MAGIC) == QOT_TLMSG_BIN_MAGIC;
+}
+
+// Total length of the binary frame at the start of a buffer
+long tlmsg_binary_frame_length(const char *buf, size_t len)
+{
+	uint32_t length;
+
+	if (len < TLBIN_OFF_MAGIC)
+		return 0;
+	length = get_le32(buf + TLBIN_OFF_LENGTH);
+	if ((uint64_t)length + 4 < QOT_TLMSG_BIN_SIZE || (uint64_t)length + 4 > QOT_TLMSG_BIN_MAXSIZE)
+		return -1;
+	return (long)length + 4;
+}
 
+// Serialize Timeline Service Messages to a binary frame
+int serialize_tlmsg_binary(qot_timeline_msg_t &msg, char *buf, size_t len)
+{
+	if (len < QOT_TLMSG_BIN_SIZE || msg.aux_data.length() > QOT_TLMSG_AUX_MAXLEN)
+		return -1;
+
+	memset(buf, 0, QOT_TLMSG_BIN_SIZE);
+
+	/* Header */
+	put_le32(buf + TLBIN_OFF_LENGTH, QOT_TLMSG_BIN_SIZE - 4);
+	put_le32(buf + TLBIN_OFF_MAGIC, QOT_TLMSG_BIN_MAGIC);
+	put_le16(buf + TLBIN_OFF_VERSION, QOT_TLMSG_BIN_VERSION);
+	put_le16(buf + TLBIN_OFF_MSGTYPE, (uint16_t)msg.msgtype);
+	put_le32(buf + TLBIN_OFF_RETVAL, (uint32_t)msg.retval);
+
+	/* Timeline Info and Binding Information */
+	put_le32(buf + TLBIN_OFF_TLINDEX, (uint32_t)msg.info.index);
+	put_le32(buf + TLBIN_OFF_TLTYPE, (uint32_t)msg.info.type);
+	put_le32(buf + TLBIN_OFF_BINDID, (uint32_t)msg.binding.id);
+	strncpy(buf + TLBIN_OFF_TLNAME, msg.info.name, QOT_MAX_NAMELEN - 1);
+	strncpy(buf + TLBIN_OFF_BINDNAME, msg.binding.name, QOT_MAX_NAMELEN - 1);
+
+	/* Requested QoT */
+	put_le64(buf + TLBIN_OFF_DEMAND,      msg.demand.resolution.sec);
+	put_le64(buf + TLBIN_OFF_DEMAND + 8,  msg.demand.resolution.asec);
+	put_le64(buf + TLBIN_OFF_DEMAND + 16, msg.demand.accuracy.above.sec);
+	put_le64(buf + TLBIN_OFF_DEMAND + 24, msg.demand.accuracy.above.asec);
+	put_le64(buf + TLBIN_OFF_DEMAND + 32, msg.demand.accuracy.below.sec);
+	put_le64(buf + TLBIN_OFF_DEMAND + 40, msg.demand.accuracy.below.asec);
+
+	/* Auxilliary Data */
+	put_le16(buf + TLBIN_OFF_AUXLEN, (uint16_t)msg.aux_data.length());
+	memcpy(buf + TLBIN_OFF_AUX, msg.aux_data.data(), msg.aux_data.length());
+
+	return QOT_TLMSG_BIN_SIZE;
+}
+
+// Deserialize Timeline Service Messages from a binary frame
+int deserialize_tlmsg_binary(const char *buf, size_t len, qot_timeline_msg_t &msg)
+{
+	uint16_t aux_len;
+
+	/* Later versions may only append fields, readers consume the whole
+	   frame announced by the length prefix and pass it in here */
+	if (len < QOT_TLMSG_BIN_SIZE || !is_tlmsg_binary(buf, len))
+		return -1;
+	if (get_le32(buf + TLBIN_OFF_LENGTH) + 4 > len)
+		return -1;
+	if (get_le16(buf + TLBIN_OFF_VERSION) < QOT_TLMSG_BIN_VERSION)
+		return -1;
+
+	// Get the timeline info
+	memcpy(msg.info.name, buf + TLBIN_OFF_TLNAME, QOT_MAX_NAMELEN);
+	msg.info.name[QOT_MAX_NAMELEN - 1] = '\0';
+	msg.info.index = (int32_t)get_le32(buf + TLBIN_OFF_TLINDEX);
+	msg.info.type = (qot_timeline_type_t)(int32_t)get_le32(buf + TLBIN_OFF_TLTYPE);
+
+	// Get the binding info
+	memcpy(msg.binding.name, buf + TLBIN_OFF_BINDNAME, QOT_MAX_NAMELEN);
+	msg.binding.name[QOT_MAX_NAMELEN - 1] = '\0';
+	msg.binding.id = (int32_t)get_le32(buf + TLBIN_OFF_BINDID);
+
+	// Get the QoT demand information
+	msg.demand.resolution.sec = get_le64(buf + TLBIN_OFF_DEMAND);
+	msg.demand.resolution.asec = get_le64(buf + TLBIN_OFF_DEMAND + 8);
+	msg.demand.accuracy.above.sec = get_le64(buf + TLBIN_OFF_DEMAND + 16);
+	msg.demand.accuracy.above.asec = get_le64(buf + TLBIN_OFF_DEMAND + 24);
+	msg.demand.accuracy.below.sec = get_le64(buf + TLBIN_OFF_DEMAND + 32);
+	msg.demand.accuracy.below.asec = get_le64(buf + TLBIN_OFF_DEMAND + 40);
+	msg.binding.demand = msg.demand;
+
+	// Message type and return code
+	msg.msgtype = (tlmsg_type_t)get_le16(buf + TLBIN_OFF_MSGTYPE);
+	msg.retval = (qot_return_t)(int32_t)get_le32(buf + TLBIN_OFF_RETVAL);
+
+	// Get the auxilliary data
+	aux_len = get_le16(buf + TLBIN_OFF_AUXLEN);
+	if (aux_len > QOT_TLMSG_AUX_MAXLEN)
+		return -1;
+	msg.aux_data.assign(buf + TLBIN_OFF_AUX, aux_len);
+
+	return 0;
+}
@@ -44,5 +44,29 @@ nlohmann::json serialize_tlmsg(qot_timeline_msg_t &msg);
 // Deserialize Timeline Service Messages
 void deserialize_tlmsg(nlohmann::json &data, qot_timeline_msg_t &msg);
 
+/* Binary wire format for timeline service messages. Every frame is a
+   little-endian encoding prefixed with its length (excluding the prefix) and
+   tagged with a magic number and a version. Clients offer it with a "wire" key
+   on their first JSON request and switch once the reply echoes it, JSON
+   remains the default. Readers consume as many bytes as the prefix announces,
+   so later versions can append fields. */
+#define QOT_TLMSG_BIN_MAGIC     0x4d4c5451U   /* "QTLM" on the wire           */
+#define QOT_TLMSG_BIN_VERSION   1             /* Current binary format version */
+#define QOT_TLMSG_AUX_MAXLEN    256           /* Maximum aux_data length       */
+#define QOT_TLMSG_BIN_SIZE      (208 + QOT_TLMSG_AUX_MAXLEN) /* Frame size incl. length prefix */
+#define QOT_TLMSG_BIN_MAXSIZE   4096          /* Largest frame a reader accepts */
+
+// Check whether a received buffer starts with a binary frame
+bool is_tlmsg_binary(const char *buf, size_t len);
+
+// Total length of the binary frame at the start of a buffer (0 if the prefix is incomplete, -1 if invalid)
+long tlmsg_binary_frame_length(const char *buf, size_t len);
+
+// Serialize Timeline Service Messages to a binary frame (returns bytes written, -1 on error)
+int serialize_tlmsg_binary(qot_timeline_msg_t &msg, char *buf, size_t len);
+
+// Deserialize Timeline Service Messages from a binary frame (returns 0, -1 on error)
+int deserialize_tlmsg_binary(const char *buf, size_t len, qot_timeline_msg_t &msg);
+
 #endif
 
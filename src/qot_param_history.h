@@ -0,0 +1,252 @@
+/*
+ * @file qot_param_history.h
+ * @brief Time-sized history of the timeline clock parameters in shared memory
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_SRC_QOT_PARAM_HISTORY_H
+#define QOT_STACK_SRC_QOT_PARAM_HISTORY_H
+
+#include "qot_types.h"
+
+/**
+ * @brief History of the clock parameters of a timeline, in the same shared
+ * memory segment as the live parameters. The timeline service creates the
+ * segment, tl_translation_write_end appends every parameter set published on it
+ * (sync algorithms, uncertainty bounds and the timeline clock operations alike)
+ * and the bindings map it read-only. Entries carry monotonic sequence numbers and
+ * are ordered by their "last" core time, so readers find the parameters valid at
+ * a past core time by a lock-free binary search. The capacity counts entries: the
+ * ring holds TL_HISTORY_WINDOW_NS of history as long as all writers together
+ * publish at most every TL_HISTORY_MIN_PERIOD_NS.
+ */
+#define TL_HISTORY_MAGIC         0x48544c51  /* "QLTH" */
+#define TL_HISTORY_WINDOW_NS     (600LL * 1000000000LL)
+#define TL_HISTORY_MIN_PERIOD_NS 10000000LL
+#define TL_HISTORY_CAPACITY      ((u32) (TL_HISTORY_WINDOW_NS / TL_HISTORY_MIN_PERIOD_NS))
+
+/* Segment flag of the live parameters: a history ring follows them */
+#define TL_SEGMENT_HISTORY       0x1
+
+/* Offset of the history header in the segment (cache-line aligned) */
+#define TL_HISTORY_OFFSET        ((sizeof(tl_translation_t) + 63) & ~((size_t) 63))
+
+/* Lookups retry this often when the writer overtakes them */
+#define TL_HISTORY_RETRIES       4
+
+typedef struct tl_history {
+    u32 magic;
+    u32 capacity;                            /* Entries in the ring                      */
+    int64_t window_ns;                       /* History the ring was sized for           */
+    u64 head;                                /* Entries appended (sequence of the newest) */
+    u64 rejected;                            /* Entries dropped as out of order          */
+    u32 lock;                                /* Serializes appends                       */
+    u32 pad;
+    u32 reserved[6];
+} tl_history_t;
+
+typedef struct tl_history_entry {
+    u64 seq;                                 /* 2*sequence when valid, odd while written */
+    tl_translation_t params;
+} tl_history_entry_t;
+
+#ifndef __KERNEL__
+/* Size of a clock segment with a history ring of the given capacity */
+static inline size_t tl_history_segment_size(u32 capacity)
+{
+    return TL_HISTORY_OFFSET + sizeof(tl_history_t) + (size_t) capacity * sizeof(tl_history_entry_t);
+}
+
+/* History ring of a clock segment, NULL if the segment has none */
+static inline tl_history_t *tl_history_get(const tl_translation_t *segment)
+{
+    tl_history_t *history;
+    if (!segment || !(segment->flags & TL_SEGMENT_HISTORY))
+        return NULL;
+    history = (tl_history_t *) ((char *) segment + TL_HISTORY_OFFSET);
+    return history->magic == TL_HISTORY_MAGIC ? history : NULL;
+}
+
+static inline tl_history_entry_t *tl_history_entries(tl_history_t *history)
+{
+    return (tl_history_entry_t *) (history + 1);
+}
+
+/* Size of a mapped clock segment (to unmap it) */
+static inline size_t tl_clock_segment_size(const tl_translation_t *segment)
+{
+    tl_history_t *history = tl_history_get(segment);
+    return history ? tl_history_segment_size(history->capacity) : sizeof(tl_translation_t);
+}
+
+/* Set up an empty history behind freshly created (zeroed) live parameters */
+static inline void tl_history_init(tl_translation_t *segment, u32 capacity, int64_t window_ns)
+{
+    tl_history_t *history = (tl_history_t *) ((char *) segment + TL_HISTORY_OFFSET);
+    memset(history, 0, sizeof(*history));
+    history->capacity = capacity;
+    history->window_ns = window_ns;
+    history->magic = TL_HISTORY_MAGIC;
+    __atomic_store_n(&segment->flags, segment->flags | TL_SEGMENT_HISTORY, __ATOMIC_RELEASE);
+}
+
+/* Append a parameter set, returns its sequence number, or 0 if the segment has
+   no history or the set is older than the newest entry */
+static inline u64 tl_history_append(tl_translation_t *segment, const tl_translation_t *params)
+{
+    tl_history_t *history = tl_history_get(segment);
+    tl_history_entry_t *entries, *entry;
+    u32 unlocked;
+    u64 head;
+
+    if (!history || history->capacity == 0)
+        return 0;
+    entries = tl_history_entries(history);
+
+    for (;;) {
+        unlocked = 0;
+        if (__atomic_compare_exchange_n(&history->lock, &unlocked, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    /* Entries stay sorted by core time for the binary search */
+    head = history->head;
+    if (head > 0 && params->last < entries[(head - 1) % history->capacity].params.last) {
+        history->rejected++;
+        __atomic_store_n(&history->lock, 0, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    entry = &entries[head % history->capacity];
+    __atomic_store_n(&entry->seq, 2 * head + 1, __ATOMIC_RELAXED);
+    /* Field updates must not become visible before the odd sequence number */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->params.seq    = 0;
+    entry->params.flags  = 0;
+    entry->params.last   = params->last;
+    entry->params.mult   = params->mult;
+    entry->params.nsec   = params->nsec;
+    entry->params.u_nsec = params->u_nsec;
+    entry->params.l_nsec = params->l_nsec;
+    entry->params.u_mult = params->u_mult;
+    entry->params.l_mult = params->l_mult;
+    entry->params.slope  = params->slope;
+    __atomic_store_n(&entry->seq, 2 * (head + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&history->head, head + 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&history->lock, 0, __ATOMIC_RELEASE);
+    return head + 1;
+}
+
+/* Copy the entry with sequence number index + 1, fails if it was overwritten */
+static inline int tl_history_load(tl_history_t *history, u64 index, tl_translation_t *params)
+{
+    tl_history_entry_t *entry = &tl_history_entries(history)[index % history->capacity];
+    u64 seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+    if (seq != 2 * (index + 1))
+        return -1;
+    params->last   = __atomic_load_n(&entry->params.last, __ATOMIC_RELAXED);
+    params->mult   = __atomic_load_n(&entry->params.mult, __ATOMIC_RELAXED);
+    params->nsec   = __atomic_load_n(&entry->params.nsec, __ATOMIC_RELAXED);
+    params->u_nsec = __atomic_load_n(&entry->params.u_nsec, __ATOMIC_RELAXED);
+    params->l_nsec = __atomic_load_n(&entry->params.l_nsec, __ATOMIC_RELAXED);
+    params->u_mult = __atomic_load_n(&entry->params.u_mult, __ATOMIC_RELAXED);
+    params->l_mult = __atomic_load_n(&entry->params.l_mult, __ATOMIC_RELAXED);
+    __atomic_load(&entry->params.slope, &params->slope, __ATOMIC_RELAXED);
+    /* Field loads must complete before the sequence number is re-checked */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq)
+        return -1;
+    params->seq = (u32) (index + 1);
+    params->flags = 0;
+    params->wait_slot = TL_WAIT_SLOT_NONE;
+    return 0;
+}
+
+/* Find the newest parameters computed before a core time (params->seq holds the
+   low bits of their sequence number). They stay the newest for the core times up
+   to *until (INT64_MAX for the newest entry, until may be NULL). Returns -1 if the
+   time is older than the history or no parameters were published yet */
+static inline int tl_history_find_until(const tl_translation_t *segment, int64_t core_ns, tl_translation_t *params, int64_t *until)
+{
+    tl_history_t *history = tl_history_get(segment);
+    u64 head, low, high, mid;
+    int64_t high_last;
+    int attempt;
+
+    if (!history || history->capacity == 0)
+        return -1;
+
+    for (attempt = 0; attempt < TL_HISTORY_RETRIES; attempt++) {
+        head = __atomic_load_n(&history->head, __ATOMIC_ACQUIRE);
+        if (head == 0)
+            return -1;
+        low = head > history->capacity ? head - history->capacity : 0;
+
+        /* Most lookups are for recent times */
+        if (tl_history_load(history, head - 1, params) < 0)
+            continue;
+        if (core_ns > params->last) {
+            if (until)
+                *until = INT64_MAX;
+            return 0;
+        }
+
+        /* First entry in [low, head - 1) computed at or after the core time */
+        high = head - 1;
+        high_last = params->last;
+        while (low < high) {
+            mid = low + (high - low) / 2;
+            if (tl_history_load(history, mid, params) < 0)
+                break;
+            if (core_ns > params->last) {
+                low = mid + 1;
+            } else {
+                high = mid;
+                high_last = params->last;
+            }
+        }
+        if (low < high)
+            continue;       /* The writer overtook the search */
+
+        if (low == (head > history->capacity ? head - history->capacity : 0))
+            return -1;      /* Older than the history */
+        if (tl_history_load(history, low - 1, params) == 0) {
+            if (until)
+                *until = high_last;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline int tl_history_find(const tl_translation_t *segment, int64_t core_ns, tl_translation_t *params)
+{
+    return tl_history_find_until(segment, core_ns, params, NULL);
+}
+#endif
+
+#endif
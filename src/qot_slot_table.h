@@ -0,0 +1,82 @@
+/*
+ * @file qot_slot_table.h
+ * @brief Per-timeline state indexed by timeline id, grown on demand
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_SRC_QOT_SLOT_TABLE_H
+#define QOT_STACK_SRC_QOT_SLOT_TABLE_H
+
+#include <stdlib.h>
+
+/**
+ * @brief Table mapping a timeline id to a slot of per-timeline state.
+ * Slots live in zeroed chunks of QOT_SLOT_CHUNK contiguous entries, which
+ * are allocated the first time an id inside them is used and never move,
+ * so slot pointers stay valid and lookups are lock-free and O(1). Timeline
+ * ids are handed out densely by the timeline service (freed ids are reused),
+ * so memory follows the number of live timelines.
+ */
+#define QOT_SLOT_CHUNK_SHIFT 6
+#define QOT_SLOT_CHUNK       (1 << QOT_SLOT_CHUNK_SHIFT)
+#define QOT_SLOT_DIR_SIZE    1024
+#define QOT_SLOT_MAX_IDS     (QOT_SLOT_CHUNK * QOT_SLOT_DIR_SIZE)
+
+typedef struct qot_slot_table {
+    size_t elem_size;                        /* Size of one slot                   */
+    void *chunks[QOT_SLOT_DIR_SIZE];         /* Slot chunks, allocated on first use */
+} qot_slot_table_t;
+
+/* Static initializer for a table of slots of the given type */
+#define QOT_SLOT_TABLE_INIT(type) { sizeof(type), { 0 } }
+
+/* Slot of an id (zeroed on first use), NULL if the id is out of range or memory is exhausted */
+static inline void *qot_slot_get(qot_slot_table_t *table, int id)
+{
+    void **entry, *chunk, *fresh;
+
+    if (id < 0 || id >= QOT_SLOT_MAX_IDS)
+        return NULL;
+
+    entry = &table->chunks[id >> QOT_SLOT_CHUNK_SHIFT];
+    chunk = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+    if (!chunk) {
+        /* Racing first users both allocate, the loser frees its chunk */
+        fresh = calloc(QOT_SLOT_CHUNK, table->elem_size);
+        if (!fresh)
+            return NULL;
+        if (__atomic_compare_exchange_n(entry, &chunk, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            chunk = fresh;
+        else
+            free(fresh);
+    }
+    return (char *)chunk + (size_t)(id & (QOT_SLOT_CHUNK - 1)) * table->elem_size;
+}
+
+/* Typed access to a slot */
+#define QOT_SLOT(table, type, id) ((type *)qot_slot_get((table), (id)))
+
+#endif
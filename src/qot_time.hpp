@@ -0,0 +1,179 @@
+/*
+ * @file qot_time.hpp
+ * @brief constexpr C++ wrappers over the 128-bit attosecond time arithmetic
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_TIME_HPP
+#define QOT_STACK_TIME_HPP
+
+/* Include basic types, time math and the 128-bit time core */
+extern "C"
+{
+	#include "qot_types.h"
+	#include "qot_time128.h"
+}
+
+#ifdef QOT_HAVE_INT128
+
+namespace qot
+{
+	namespace detail
+	{
+		// Saturating arithmetic usable in constant expressions
+		constexpr qot_atime_t sat_add(qot_atime_t a, qot_atime_t b)
+		{
+			return (b > 0 && a > QOT_ATIME_MAX - b) ? QOT_ATIME_MAX :
+			       (b < 0 && a < QOT_ATIME_MIN - b) ? QOT_ATIME_MIN : a + b;
+		}
+
+		constexpr qot_atime_t sat_sub(qot_atime_t a, qot_atime_t b)
+		{
+			return (b < 0 && a > QOT_ATIME_MAX + b) ? QOT_ATIME_MAX :
+			       (b > 0 && a < QOT_ATIME_MIN + b) ? QOT_ATIME_MIN : a - b;
+		}
+
+		// Compares with the limit divided by k, negating QOT_ATIME_MIN or INT64_MIN is undefined
+		constexpr qot_atime_t sat_mul(qot_atime_t a, int64_t k)
+		{
+			return (k == 0 || a == 0) ? 0 :
+			       (a > 0 && k > 0) ? (a > QOT_ATIME_MAX / k ? QOT_ATIME_MAX : a*k) :
+			       (a < 0 && k < 0) ? (a < QOT_ATIME_MAX / k ? QOT_ATIME_MAX : a*k) :
+			       (a > 0)          ? (k != -1 && a > QOT_ATIME_MIN / k ? QOT_ATIME_MIN : a*k) :
+			                          (a < QOT_ATIME_MIN / k ? QOT_ATIME_MIN : a*k);
+		}
+
+		constexpr qot_atime_t floor_div(qot_atime_t a, qot_atime_t d)
+		{
+			return a / d - ((a % d) < 0 ? 1 : 0);
+		}
+	}
+
+	// Frequency offset in 0.64 fixed point, applied with multiplications only
+	class Rate
+	{
+		public: constexpr Rate() : frac(0) {}
+
+		// Parts per billion (limited to +/- 50%)
+		public: static constexpr Rate ppb(int64_t v)
+		{
+			return Rate((int64_t)((((qot_atime_t)(v > 499999999LL ? 499999999LL : (v < -499999999LL ? -499999999LL : v))) << 64)
+			            / (qot_atime_t)nSEC_PER_SEC));
+		}
+
+		public: constexpr int64_t fraction() const { return frac; }
+
+		private: constexpr explicit Rate(int64_t f) : frac(f) {}
+		private: int64_t frac;
+	};
+
+	// A signed length of time with attosecond resolution
+	class Duration
+	{
+		public: constexpr Duration() : as(0) {}
+		public: constexpr explicit Duration(qot_atime_t attoseconds) : as(attoseconds) {}
+		public: constexpr Duration(const timelength_t &tl) : as((qot_atime_t)tl.sec * aSEC_PER_SEC + tl.asec) {}
+
+		// Construction from common units
+		public: static constexpr Duration seconds(int64_t v) { return Duration((qot_atime_t)v * aSEC_PER_SEC); }
+		public: static constexpr Duration milliseconds(int64_t v) { return Duration((qot_atime_t)v * fSEC_PER_SEC); }
+		public: static constexpr Duration microseconds(int64_t v) { return Duration((qot_atime_t)v * pSEC_PER_SEC); }
+		public: static constexpr Duration nanoseconds(int64_t v) { return Duration((qot_atime_t)v * nSEC_PER_SEC); }
+
+		// Accessors (nanoseconds are floored)
+		public: constexpr qot_atime_t attoseconds() const { return as; }
+		public: constexpr qot_atime_t nanoseconds() const { return detail::floor_div(as, nSEC_PER_SEC); }
+
+		// Saturating arithmetic
+		public: constexpr Duration operator+(const Duration &o) const { return Duration(detail::sat_add(as, o.as)); }
+		public: constexpr Duration operator-(const Duration &o) const { return Duration(detail::sat_sub(as, o.as)); }
+		public: constexpr Duration operator-() const { return Duration(detail::sat_sub(0, as)); }
+		public: constexpr Duration operator*(int64_t k) const { return Duration(detail::sat_mul(as, k)); }
+
+		// Drift accumulated over this duration at a given rate (floor, multiplications only)
+		public: constexpr Duration scale(const Rate &r) const
+		{
+			return Duration((qot_atime_t)(int64_t)(as >> 64) * r.fraction() + (((qot_atime_t)(uint64_t)as * r.fraction()) >> 64));
+		}
+
+		public: constexpr bool operator==(const Duration &o) const { return as == o.as; }
+		public: constexpr bool operator!=(const Duration &o) const { return as != o.as; }
+		public: constexpr bool operator<(const Duration &o) const { return as < o.as; }
+		public: constexpr bool operator>(const Duration &o) const { return as > o.as; }
+		public: constexpr bool operator<=(const Duration &o) const { return as <= o.as; }
+		public: constexpr bool operator>=(const Duration &o) const { return as >= o.as; }
+
+		// Back to the C struct (negative lengths saturate to zero)
+		public: timelength_t to_timelength() const
+		{
+			timelength_t tl;
+			qot_atime_to_timelength(&tl, as);
+			return tl;
+		}
+
+		private: qot_atime_t as;
+	};
+
+	// A point on a timeline with attosecond resolution
+	class TimePoint
+	{
+		public: constexpr TimePoint() : as(0) {}
+		public: constexpr explicit TimePoint(qot_atime_t attoseconds) : as(attoseconds) {}
+		public: constexpr TimePoint(const timepoint_t &tp) : as((qot_atime_t)tp.sec * aSEC_PER_SEC + tp.asec) {}
+
+		public: static constexpr TimePoint nanoseconds(int64_t v) { return TimePoint((qot_atime_t)v * nSEC_PER_SEC); }
+
+		// Accessors (nanoseconds are floored)
+		public: constexpr qot_atime_t attoseconds() const { return as; }
+		public: constexpr qot_atime_t nanoseconds() const { return detail::floor_div(as, nSEC_PER_SEC); }
+
+		// Saturating arithmetic
+		public: constexpr TimePoint operator+(const Duration &d) const { return TimePoint(detail::sat_add(as, d.attoseconds())); }
+		public: constexpr TimePoint operator-(const Duration &d) const { return TimePoint(detail::sat_sub(as, d.attoseconds())); }
+		public: constexpr Duration operator-(const TimePoint &o) const { return Duration(detail::sat_sub(as, o.as)); }
+
+		public: constexpr bool operator==(const TimePoint &o) const { return as == o.as; }
+		public: constexpr bool operator!=(const TimePoint &o) const { return as != o.as; }
+		public: constexpr bool operator<(const TimePoint &o) const { return as < o.as; }
+		public: constexpr bool operator>(const TimePoint &o) const { return as > o.as; }
+		public: constexpr bool operator<=(const TimePoint &o) const { return as <= o.as; }
+		public: constexpr bool operator>=(const TimePoint &o) const { return as >= o.as; }
+
+		// Back to the C struct (normalized, saturating at the struct range)
+		public: timepoint_t to_timepoint() const
+		{
+			timepoint_t tp;
+			qot_atime_to_timepoint(&tp, as);
+			return tp;
+		}
+
+		private: qot_atime_t as;
+	};
+}
+
+#endif
+
+#endif
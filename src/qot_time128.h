@@ -0,0 +1,325 @@
+/*
+ * @file qot_time128.h
+ * @brief Exact 128-bit attosecond time arithmetic for userspace
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_STACK_TIME128_H
+#define QOT_STACK_TIME128_H
+
+#include "qot_types.h"
+
+/* 128-bit integers are available on 64-bit userspace targets only */
+#if !defined(__KERNEL__) && defined(__SIZEOF_INT128__)
+#define QOT_HAVE_INT128 1
+#else
+#include <math.h>
+#endif
+
+/* floor(a*m/d) for d > 0, exact if 128-bit integers exist (else computed in double as before) */
+static inline s64 qot_muldiv_floor(s64 a, s64 m, s64 d)
+{
+#ifdef QOT_HAVE_INT128
+	__int128 p = (__int128)a * m;
+	__int128 q = p / d;
+	if ((p % d) && p < 0)
+		q--;
+	return (s64)q;
+#else
+	return (s64)floor(((double)a/(double)d)*m);
+#endif
+}
+
+/* A frequency offset as a signed 0.64 fixed-point fraction (ppb / 1e9), the fraction itself without 128-bit integers */
+typedef struct qot_rate {
+#ifdef QOT_HAVE_INT128
+	s64 frac;
+#else
+	double frac;
+#endif
+} qot_rate_t;
+
+/* Fixed-point reciprocal of 1e9, floor(2^93 / 1e9) */
+#define QOT_RATE_NSEC_RECIP 9903520314283042199ULL
+
+/* Build a rate from parts per billion by multiplying with the reciprocal of 1e9
+   (limited to +/- 50%, at most 2^-64 below the exact fraction) */
+static inline qot_rate_t qot_rate_of_ppb(s64 ppb)
+{
+	qot_rate_t r;
+	if (ppb > 499999999LL)
+		ppb = 499999999LL;
+	if (ppb < -499999999LL)
+		ppb = -499999999LL;
+#ifdef QOT_HAVE_INT128
+	r.frac = (s64)(((__int128)ppb * (__int128)QOT_RATE_NSEC_RECIP) >> 29);
+#else
+	r.frac = (double)ppb * 1e-9;
+#endif
+	return r;
+}
+
+/* Rate s with (1 + r)(1 + s) = 1 by Newton iteration, multiplications only (|r| <= 1/4) */
+static inline qot_rate_t qot_rate_inverse(qot_rate_t r)
+{
+	qot_rate_t s;
+#ifdef QOT_HAVE_INT128
+	__int128 x = -(__int128)r.frac, e;
+	int i;
+	for (i = 0; i < 8; i++) {
+		/* Residual (1 + r)(1 + x) - 1, halves its exponent on every step */
+		e = (__int128)r.frac + x + (((__int128)r.frac * x) >> 64);
+		if (e == 0)
+			break;
+		x -= e + ((e * x) >> 64);
+	}
+	s.frac = (s64)x;
+#else
+	s.frac = -r.frac/(1.0 + r.frac);
+#endif
+	return s;
+}
+
+/* floor(ns * r) with one multiplication, within 1ns of the exact floor(ns * ppb / 1e9) */
+static inline s64 qot_ns_scale(s64 ns, qot_rate_t r)
+{
+#ifdef QOT_HAVE_INT128
+	return (s64)(((__int128)ns * r.frac) >> 64);
+#else
+	return (s64)floor((double)ns * r.frac);
+#endif
+}
+
+/* Maximum frequency correction of a projection (ppb), keeps the inverse rate in range */
+#define TL_PROJECTION_MAX_PPB 250000000LL
+
+/**
+ * @brief Clock parameters prepared for projections. The ppb multipliers of a
+ * parameter snapshot become fixed-point rates once, after which projections
+ * and uncertainty bounds take multiplications only. The inverse projection
+ * is the latest core time projected at or before a timeline time, so
+ * projecting its result back never passes the timeline time.
+ */
+typedef struct tl_projection {
+	s64 last;                                /* Core time of the last update               */
+	s64 nsec;                                /* Timeline time of the last update           */
+	s64 u_nsec;                              /* Upper bound on accuracy at the last update */
+	s64 l_nsec;                              /* Lower bound on accuracy at the last update */
+	qot_rate_t rate;                         /* Frequency correction                       */
+	qot_rate_t inv_rate;                     /* Frequency correction of the inverse        */
+	qot_rate_t u_rate;                       /* Upper bound on the frequency correction    */
+	qot_rate_t l_rate;                       /* Lower bound on the frequency correction    */
+} tl_projection_t;
+
+static inline void tl_projection_prepare(tl_projection_t *proj, const tl_translation_t *params)
+{
+	s64 mult = params->mult;
+	if (mult > TL_PROJECTION_MAX_PPB)
+		mult = TL_PROJECTION_MAX_PPB;
+	if (mult < -TL_PROJECTION_MAX_PPB)
+		mult = -TL_PROJECTION_MAX_PPB;
+	proj->last     = params->last;
+	proj->nsec     = params->nsec;
+	proj->u_nsec   = params->u_nsec;
+	proj->l_nsec   = params->l_nsec;
+	proj->rate     = qot_rate_of_ppb(mult);
+	proj->inv_rate = qot_rate_inverse(proj->rate);
+	proj->u_rate   = qot_rate_of_ppb(params->u_mult);
+	proj->l_rate   = qot_rate_of_ppb(params->l_mult);
+}
+
+/* Timeline time of a core time (ns) */
+static inline s64 tl_project(const tl_projection_t *proj, s64 core)
+{
+	s64 d = core - proj->last;
+	return proj->nsec + d + qot_ns_scale(d, proj->rate);
+}
+
+/* Timeline length of a core length (ns) */
+static inline s64 tl_project_length(const tl_projection_t *proj, s64 len)
+{
+	return len + qot_ns_scale(len, proj->rate);
+}
+
+/* Core time of a timeline time: estimate with the inverse rate, then settle on the
+   forward projection (non-decreasing, the estimate is within a few ns) */
+static inline s64 tl_unproject(const tl_projection_t *proj, s64 tl)
+{
+	s64 d = tl - proj->nsec;
+	s64 core = proj->last + d + qot_ns_scale(d, proj->inv_rate);
+	while (tl_project(proj, core) > tl)
+		core--;
+	while (tl_project(proj, core + 1) <= tl)
+		core++;
+	return core;
+}
+
+/* Core length of a timeline length */
+static inline s64 tl_unproject_length(const tl_projection_t *proj, s64 len)
+{
+	s64 core = len + qot_ns_scale(len, proj->inv_rate);
+	while (tl_project_length(proj, core) > len)
+		core--;
+	while (tl_project_length(proj, core + 1) <= len)
+		core++;
+	return core;
+}
+
+/* Uncertainty bounds of the timeline time at a core time (ns) */
+static inline void tl_project_bounds(const tl_projection_t *proj, s64 core, s64 *u_bound, s64 *l_bound)
+{
+	*u_bound = qot_ns_scale(core - proj->last, proj->u_rate) + proj->u_nsec;
+	*l_bound = qot_ns_scale(core - proj->last, proj->l_rate) + proj->l_nsec;
+}
+
+#ifdef QOT_HAVE_INT128
+
+/* A signed time in attoseconds (+/- 5.4e12 years) */
+typedef __int128 qot_atime_t;
+
+#define QOT_ATIME_MAX ((qot_atime_t)(((unsigned __int128)1 << 127) - 1))
+#define QOT_ATIME_MIN (-QOT_ATIME_MAX - 1)
+
+/* Saturating addition */
+static inline qot_atime_t qot_atime_add(qot_atime_t a, qot_atime_t b)
+{
+	qot_atime_t r;
+	if (__builtin_add_overflow(a, b, &r))
+		return (b > 0) ? QOT_ATIME_MAX : QOT_ATIME_MIN;
+	return r;
+}
+
+/* Saturating subtraction */
+static inline qot_atime_t qot_atime_sub(qot_atime_t a, qot_atime_t b)
+{
+	qot_atime_t r;
+	if (__builtin_sub_overflow(a, b, &r))
+		return (b < 0) ? QOT_ATIME_MAX : QOT_ATIME_MIN;
+	return r;
+}
+
+/* Saturating multiplication by an integer */
+static inline qot_atime_t qot_atime_mul(qot_atime_t a, s64 k)
+{
+	qot_atime_t r;
+	if (__builtin_mul_overflow(a, (qot_atime_t)k, &r))
+		return ((a < 0) != (k < 0)) ? QOT_ATIME_MIN : QOT_ATIME_MAX;
+	return r;
+}
+
+/* Conversions from the C structs and scalars (exact, multiplication only) */
+static inline qot_atime_t qot_atime_from_timelength(const timelength_t *tl)
+{
+	return (qot_atime_t)tl->sec * aSEC_PER_SEC + tl->asec;
+}
+
+static inline qot_atime_t qot_atime_from_timepoint(const timepoint_t *tp)
+{
+	return (qot_atime_t)tp->sec * aSEC_PER_SEC + tp->asec;
+}
+
+static inline qot_atime_t qot_atime_from_ns(s64 ns)
+{
+	return (qot_atime_t)ns * nSEC_PER_SEC;
+}
+
+/* Conversion to a normalized timepoint {sec, 0 <= asec < 1s}, saturating at the struct range */
+static inline void qot_atime_to_timepoint(timepoint_t *tp, qot_atime_t a)
+{
+	qot_atime_t sec, rem;
+	if (a >= (qot_atime_t)INT64_MAX * aSEC_PER_SEC + (aSEC_PER_SEC - 1)) {
+		tp->sec  = INT64_MAX;
+		tp->asec = aSEC_PER_SEC - 1;
+		return;
+	}
+	if (a < (qot_atime_t)INT64_MIN * aSEC_PER_SEC) {
+		tp->sec  = INT64_MIN;
+		tp->asec = 0;
+		return;
+	}
+	sec = a / (qot_atime_t)aSEC_PER_SEC;
+	rem = a % (qot_atime_t)aSEC_PER_SEC;
+	if (rem < 0) {
+		rem += aSEC_PER_SEC;
+		sec--;
+	}
+	tp->sec  = (s64)sec;
+	tp->asec = (u64)rem;
+}
+
+/* Conversion to a timelength, negative values saturate to zero */
+static inline void qot_atime_to_timelength(timelength_t *tl, qot_atime_t a)
+{
+	if (a <= 0) {
+		tl->sec  = 0;
+		tl->asec = 0;
+		return;
+	}
+	if (a >= (qot_atime_t)UINT64_MAX * aSEC_PER_SEC + (aSEC_PER_SEC - 1)) {
+		tl->sec  = UINT64_MAX;
+		tl->asec = aSEC_PER_SEC - 1;
+		return;
+	}
+	tl->sec  = (u64)(a / (qot_atime_t)aSEC_PER_SEC);
+	tl->asec = (u64)(a % (qot_atime_t)aSEC_PER_SEC);
+}
+
+/* Nanoseconds (floor), saturating at the s64 range */
+static inline s64 qot_atime_to_ns(qot_atime_t a)
+{
+	qot_atime_t ns = a / (qot_atime_t)nSEC_PER_SEC;
+	if ((a % (qot_atime_t)nSEC_PER_SEC) < 0)
+		ns--;
+	if (ns > INT64_MAX)
+		return INT64_MAX;
+	if (ns < INT64_MIN)
+		return INT64_MIN;
+	return (s64)ns;
+}
+
+/* Build a rate from parts per billion (one division, limited to +/- 50%) */
+static inline qot_rate_t qot_rate_from_ppb(s64 ppb)
+{
+	qot_rate_t r;
+	if (ppb > 499999999LL)
+		ppb = 499999999LL;
+	if (ppb < -499999999LL)
+		ppb = -499999999LL;
+	r.frac = (s64)(((__int128)ppb << 64) / (__int128)nSEC_PER_SEC);
+	return r;
+}
+
+/* floor(a * ppb / 1e9) with multiplications only, off by at most 1as + |a|/2^64 */
+static inline qot_atime_t qot_atime_scale(qot_atime_t a, qot_rate_t r)
+{
+	s64 hi = (s64)(a >> 64);
+	u64 lo = (u64)a;
+	return (qot_atime_t)hi * r.frac + (((qot_atime_t)lo * r.frac) >> 64);
+}
+
+#endif
+
+#endif
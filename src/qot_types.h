@@ -34,9 +34,6 @@
 /* Define keyword prefix for defining a global timeline */
 #define GLOBAL_TL_STRING "gl_"
 
-/* Default Maximum Number of Timelines Supported */
-#define MAX_TIMELINES 5
-
 /* So that we might expose a meaningful name through PTP interface */
 #define QOT_MAX_NAMELEN 	64
 #define QOT_MAX_NUMCLKS 	8
@@ -63,6 +60,12 @@
  	#include <string.h>
 	#include <sys/ioctl.h>
     #include <stdlib.h>
+    #include <unistd.h>
+    #include <limits.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <linux/futex.h>
     #define div64_u64(X,Y) (uint64_t)X/(uint64_t)Y;
  	#define u64 uint64_t
  	#define s64  int64_t
@@ -488,6 +491,10 @@ typedef struct qot_event {
  * @brief Timeline Clockparams Data Structure (may need to be modified)
  */
 typedef struct timeline_translation {
+    u32 seq;                                 /* Seqlock: odd while an update is in flight */
+    u32 flags;                               /* Segment: TL_SEGMENT_* flags (set at creation) */
+    u32 wait_slot;                           /* Segment: TL_WAIT_SLOT_* of its waiters      */
+    u32 waiters;                             /* Segment: tasks blocked on seq (no wait slot) */
 	int64_t last;                   	     /* Discipline: last cycle count of     */
     int64_t mult;                            /* Discipline: ppb multiplier          */
     int64_t nsec;                            /* Discipline: global time offset      */
@@ -498,6 +505,203 @@ typedef struct timeline_translation {
     double slope;							 /* Overlay: drift*/
 } tl_translation_t;
 
+/**
+ * @brief Host-wide table of wait slots. Clients map the clock segments
+ * read-only, so tasks blocking until the next parameter update register in
+ * this small shared table instead, on the slot named by the segment. Writers
+ * bump the slot's futex word on every update, but only issue the wake when a
+ * task is registered. Overlay segments share the slot of the local clock, so
+ * a single word covers both parameter sets of a local timeline.
+ */
+#define TL_WAIT_TABLE_NAME   "/qot_tl_wait"   /* Created by the timeline service       */
+#define TL_WAIT_SLOT_NONE    0                /* No slot, writers always wake seq      */
+#define TL_WAIT_SLOT_GLOBAL  1                /* Global clock                          */
+#define TL_WAIT_SLOT_LOCAL   2                /* Local clock and the timeline overlays */
+#define TL_WAIT_SLOTS        4
+#define TL_WAIT_RETRY_NS     1000000000LL     /* Period of the retries to map the table */
+
+typedef struct tl_wait_slot {
+    u32 waiters;                             /* Tasks registered on the slot            */
+    u32 seq;                                 /* Futex word, bumped by every update      */
+} tl_wait_slot_t;
+
+#ifndef __KERNEL__
+/* Map the wait table once per translation unit (NULL until the timeline service created it,
+   failed opens are retried at most every TL_WAIT_RETRY_NS) */
+static inline tl_wait_slot_t *tl_wait_table(void)
+{
+    static tl_wait_slot_t *table = NULL;
+    static int64_t next_retry = 0;
+    tl_wait_slot_t *base, *expected;
+    struct timespec ts;
+    int64_t now;
+    int fd;
+
+    base = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+    if (base)
+        return base;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    now = (int64_t) ts.tv_sec*1000000000LL + ts.tv_nsec;
+    if (now < __atomic_load_n(&next_retry, __ATOMIC_RELAXED))
+        return NULL;
+    __atomic_store_n(&next_retry, now + TL_WAIT_RETRY_NS, __ATOMIC_RELAXED);
+
+    fd = shm_open(TL_WAIT_TABLE_NAME, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+    base = (tl_wait_slot_t *) mmap(0, TL_WAIT_SLOTS*sizeof(tl_wait_slot_t),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == (tl_wait_slot_t *) MAP_FAILED)
+        return NULL;
+
+    /* Racing first users both map the table, the loser drops its mapping */
+    expected = NULL;
+    if (!__atomic_compare_exchange_n(&table, &expected, base, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        munmap((void *) base, TL_WAIT_SLOTS*sizeof(tl_wait_slot_t));
+        base = expected;
+    }
+    return base;
+}
+
+/* Wait slot of a segment (NULL without one, waiters then block on seq) */
+static inline tl_wait_slot_t *tl_wait_slot(const tl_translation_t *params)
+{
+    tl_wait_slot_t *table;
+    if (params->wait_slot == TL_WAIT_SLOT_NONE || params->wait_slot >= TL_WAIT_SLOTS)
+        return NULL;
+    table = tl_wait_table();
+    return table ? &table[params->wait_slot] : NULL;
+}
+
+/**
+ * @brief Seqlock protocol for the shared timeline clock parameters.
+ * Writers bracket their field updates with tl_translation_write_begin/end,
+ * which also serializes concurrent writers. Readers copy the parameters with
+ * tl_translation_read, which never blocks and retries until it observes the
+ * same even sequence number before and after the copy. Tasks that want to
+ * block until the next update FUTEX_WAIT on tl_translation_wait_word between
+ * tl_translation_wait_enter/exit, writers wake them. Without a wait slot tasks
+ * register on the segment itself, which takes a writable mapping: read-only
+ * clients of such a segment sleep instead of blocking on the sequence number.
+ */
+static inline void tl_translation_write_begin(tl_translation_t *params)
+{
+    u32 seq;
+    for (;;) {
+        seq = __atomic_load_n(&params->seq, __ATOMIC_RELAXED);
+        if (!(seq & 1) && __atomic_compare_exchange_n(&params->seq, &seq, seq + 1,
+                                0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    /* Field updates must not become visible before the odd sequence number */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Defined in qot_param_history.h (included at the end of this file) */
+static inline u64 tl_history_append(tl_translation_t *segment, const tl_translation_t *params);
+
+static inline void tl_translation_write_end(tl_translation_t *params)
+{
+    tl_wait_slot_t *slot = tl_wait_slot(params);
+
+    /* Every published parameter set enters the history (if the segment has one)
+       before readers can observe it, whichever writer published it */
+    tl_history_append(params, params);
+
+    __atomic_store_n(&params->seq, params->seq + 1, __ATOMIC_RELEASE);
+    if (!slot) {
+        /* No wait table, wake the waiters registered on the segment (shared mapping, not private).
+           As below, the bump is ordered before the waiter check */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&params->waiters, __ATOMIC_SEQ_CST))
+            syscall(SYS_futex, &params->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+        return;
+    }
+
+    /* The bump is ordered before the waiter check: a task registering after
+       the check sees the new word in FUTEX_WAIT and does not sleep */
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&slot->waiters, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &slot->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Futex word to block on for updates of a segment (load it before checking the parameters) */
+static inline u32 *tl_translation_wait_word(const tl_translation_t *params)
+{
+    tl_wait_slot_t *slot = tl_wait_slot(params);
+    return slot ? &slot->seq : (u32 *) &params->seq;
+}
+
+/* Register a task about to block on the wait word of a segment (on the segment itself
+   without a wait slot, the caller then needs a writable mapping) */
+static inline void tl_translation_wait_enter(const tl_translation_t *params)
+{
+    tl_wait_slot_t *slot = tl_wait_slot(params);
+    if (slot)
+        __atomic_add_fetch(&slot->waiters, 1, __ATOMIC_SEQ_CST);
+    else
+        __atomic_add_fetch((u32 *) &params->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void tl_translation_wait_exit(const tl_translation_t *params)
+{
+    tl_wait_slot_t *slot = tl_wait_slot(params);
+    if (slot)
+        __atomic_sub_fetch(&slot->waiters, 1, __ATOMIC_RELEASE);
+    else
+        __atomic_sub_fetch((u32 *) &params->waiters, 1, __ATOMIC_RELEASE);
+}
+
+/* Publish a complete set of parameters (the sequence number of src is ignored) */
+static inline void tl_translation_publish(tl_translation_t *params, const tl_translation_t *src)
+{
+    tl_translation_write_begin(params);
+    params->last   = src->last;
+    params->mult   = src->mult;
+    params->nsec   = src->nsec;
+    params->u_nsec = src->u_nsec;
+    params->l_nsec = src->l_nsec;
+    params->u_mult = src->u_mult;
+    params->l_mult = src->l_mult;
+    params->slope  = src->slope;
+    tl_translation_write_end(params);
+}
+
+/* Take a consistent snapshot of the parameters without locking */
+static inline void tl_translation_read(const tl_translation_t *params, tl_translation_t *snap)
+{
+    u32 seq;
+    do {
+        /* Writer in flight, wait for it to finish */
+        while ((seq = __atomic_load_n(&params->seq, __ATOMIC_ACQUIRE)) & 1)
+            ;
+        snap->last   = __atomic_load_n(&params->last, __ATOMIC_RELAXED);
+        snap->mult   = __atomic_load_n(&params->mult, __ATOMIC_RELAXED);
+        snap->nsec   = __atomic_load_n(&params->nsec, __ATOMIC_RELAXED);
+        snap->u_nsec = __atomic_load_n(&params->u_nsec, __ATOMIC_RELAXED);
+        snap->l_nsec = __atomic_load_n(&params->l_nsec, __ATOMIC_RELAXED);
+        snap->u_mult = __atomic_load_n(&params->u_mult, __ATOMIC_RELAXED);
+        snap->l_mult = __atomic_load_n(&params->l_mult, __ATOMIC_RELAXED);
+        __atomic_load(&params->slope, &snap->slope, __ATOMIC_RELAXED);
+        /* Field loads must complete before the sequence number is re-checked */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&params->seq, __ATOMIC_RELAXED) != seq);
+    snap->seq = seq;
+    snap->flags = 0;
+    snap->wait_slot = TL_WAIT_SLOT_NONE;
+    snap->waiters = 0;
+}
+
+/* Check whether the parameters were republished since a snapshot was taken */
+static inline int tl_translation_changed(const tl_translation_t *params, const tl_translation_t *snap)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&params->seq, __ATOMIC_RELAXED) != snap->seq;
+}
+#endif
+
 /**
  * @brief Ioctl messages supported by /dev/qotusr
  */
@@ -612,4 +816,8 @@ typedef void (*qot_node_callback_t)(qot_node_t *node);
 #define TIMELINE_DESTROY_TIMER    		_IOWR(TIMELINE_MAGIC_CODE, 12, qot_timer_t*)
 #define TIMELINE_GET_PARAMETERS    		_IOR(TIMELINE_MAGIC_CODE, 13, tl_translation_t*)
 
+#ifndef __KERNEL__
+	#include "qot_param_history.h"
+#endif
+
 #endif
@@ -0,0 +1,123 @@
+/*
+ * @file qot_bench.cpp
+ * @brief Latency percentiles and recorded data for the QoT benchmarks
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_bench.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace qot_bench;
+
+/* Cost of reading the clock twice, measured once per process */
+static int64_t timer_overhead_ns()
+{
+	static int64_t overhead = -1;
+	if (overhead < 0)
+	{
+		std::vector<int64_t> reads(1000);
+		for (size_t i = 0; i < reads.size(); i++)
+		{
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			reads[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+		}
+		std::sort(reads.begin(), reads.end());
+		overhead = reads[reads.size()/2];
+	}
+	return overhead;
+}
+
+LatencyRecorder::LatencyRecorder(int batch)
+ : batch(batch > 0 ? batch : 1), seen(0), rng(0x9e3779b97f4a7c15ULL)
+{
+	timer_overhead_ns();
+	samples.reserve(QOT_BENCH_MAX_SAMPLES);
+}
+
+void LatencyRecorder::Record(int64_t batch_ns)
+{
+	seen++;
+	if (samples.size() < QOT_BENCH_MAX_SAMPLES)
+	{
+		samples.push_back(batch_ns);
+		return;
+	}
+
+	// Reservoir sampling keeps the distribution of long runs (xorshift64)
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	uint64_t slot = rng % seen;
+	if (slot < QOT_BENCH_MAX_SAMPLES)
+		samples[slot] = batch_ns;
+}
+
+void LatencyRecorder::Report(benchmark::State &state)
+{
+	if (samples.empty())
+		return;
+
+	std::sort(samples.begin(), samples.end());
+	int64_t overhead = timer_overhead_ns();
+	const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+	const char *names[] = {"p50_ns", "p90_ns", "p99_ns", "p999_ns"};
+	for (int i = 0; i < 4; i++)
+	{
+		size_t index = std::min(samples.size() - 1, size_t(quantiles[i]*samples.size()));
+		state.counters[names[i]] = double(std::max(samples[index] - overhead, int64_t(0)))/batch;
+	}
+	state.counters["max_ns"] = double(std::max(samples.back() - overhead, int64_t(0)))/batch;
+	samples.clear();
+	seen = 0;
+}
+
+int qot_bench::load_probe_trace(const std::string &path, std::vector<int64_t> &bounds, std::vector<int64_t> &instant)
+{
+	std::ifstream trace(path.c_str());
+	if (!trace.is_open())
+		return -1;
+
+	std::string line;
+	bounds.clear();
+	instant.clear();
+	while (std::getline(trace, line))
+	{
+		long long upper, lower, at;
+		if (line.empty() || line[0] == '#')
+			continue;
+		if (sscanf(line.c_str(), "%lld,%lld,%lld", &upper, &lower, &at) != 3)
+			return -1;
+		bounds.push_back(upper);
+		bounds.push_back(lower);
+		instant.push_back(at);
+	}
+	return instant.empty() ? -1 : 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * @file qot_bench.hpp
+ * @brief Latency recording and timeline back-ends for the QoT benchmarks
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_BENCH_HPP
+#define QOT_BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+extern "C"
+{
+	#include "../../qot_types.h"
+}
+
+// Samples kept per benchmark run (reservoir sampled beyond this)
+#define QOT_BENCH_MAX_SAMPLES 1000000
+
+namespace qot_bench
+{
+	/* Per-call latency percentiles of a benchmark. Calls are timed in batches, the
+	   cost of reading the clock is calibrated once and subtracted */
+	class LatencyRecorder
+	{
+		public: LatencyRecorder(int batch = 1);
+
+		// Bracket one batch of calls
+		public: inline void Start()
+		{
+			begin = std::chrono::steady_clock::now();
+		}
+		public: inline void Stop()
+		{
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+		}
+
+		// Write p50/p90/p99/p999/max (ns per call) as counters of the run
+		public: void Report(benchmark::State &state);
+
+		private: void Record(int64_t batch_ns);
+
+		private: int batch;
+		private: std::chrono::steady_clock::time_point begin;
+		private: std::vector<int64_t> samples;
+		private: uint64_t seen;
+		private: uint64_t rng;
+	};
+
+	/* In-process stand-in for the timeline service: answers the socket protocol of the
+	   core API (wire format negotiation, create, bind, unbind, destroy) and hands out
+	   shared memory for the clock parameters, which the benchmarks write directly */
+	class TimelineServiceStandin
+	{
+		public: TimelineServiceStandin();
+		public: ~TimelineServiceStandin();
+
+		// Listen on the timeline service socket, fails if a service is already running
+		public: int Start();
+		public: void Stop();
+
+		// Publish parameters to the main and overlay clocks of all timelines
+		public: void SetParams(const tl_translation_t &params, const tl_translation_t &ov_params);
+
+		private: void serve_loop();
+		private: void serve_client(int client);
+
+		private: int listen_sock;
+		private: bool running;
+		private: std::thread server_thread;
+		private: std::mutex params_mutex;
+		private: int clk_fd[2];						// Read-only descriptors handed to clients (main, overlay)
+		private: tl_translation_t *clk_params[2];	// Writable mappings
+		private: std::string shm_name[2];
+		private: int next_binding;
+	};
+
+	// Parameters returned by the kernel stub (kernel-mode builds)
+	void kernel_stub_set_params(const tl_translation_t &params);
+
+	// Load recorded Huygens probes (upper and lower bounds alternating, and their instants)
+	int load_probe_trace(const std::string &path, std::vector<int64_t> &bounds, std::vector<int64_t> &instant);
+}
+
+#endif
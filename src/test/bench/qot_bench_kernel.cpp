@@ -0,0 +1,233 @@
+/*
+ * @file qot_bench_kernel.cpp
+ * @brief Kernel stub for the kernel-mode QoT benchmarks
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The core API built without the timeline service talks to /dev/qotusr and
+   /dev/timelineX through ioctl. This stub answers those calls in user space.
+   Every intercepted ioctl is first issued on a /dev/null descriptor, so the
+   benchmarks still pay for the system call boundary, but not for the module */
+
+#include "qot_bench.hpp"
+
+#include <cstdarg>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace qot_bench;
+
+/* State of the emulated module */
+static std::mutex stub_mutex;
+static std::set<int> stub_fds;						// Descriptors of the emulated devices
+static std::map<std::string, int> stub_timelines;	// Timeline name -> index
+static int stub_bindings = 0;
+static tl_translation_t stub_params;
+
+void qot_bench::kernel_stub_set_params(const tl_translation_t &params)
+{
+	std::lock_guard<std::mutex> lock(stub_mutex);
+	tl_translation_publish(&stub_params, &params);
+}
+
+static bool is_stub_path(const char *path)
+{
+	return strcmp(path, "/dev/qotusr") == 0 || strncmp(path, "/dev/timeline", strlen("/dev/timeline")) == 0;
+}
+
+static bool is_stub_fd(int fd)
+{
+	std::lock_guard<std::mutex> lock(stub_mutex);
+	return stub_fds.count(fd) > 0;
+}
+
+static int64_t core_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+/* Same projection and bounds as the timeline service parameters */
+static void stub_core2rem(utimepoint_t &utp)
+{
+	tl_translation_t params;
+	tl_translation_read(&stub_params, &params);
+	int64_t core = TP_TO_nSEC(utp.estimate);
+	int64_t u_bound = (params.u_mult*(core - params.last))/1000000000L + params.u_nsec;
+	int64_t l_bound = (params.l_mult*(core - params.last))/1000000000L + params.l_nsec;
+	int64_t elapsed = core - params.last;
+	TP_FROM_nSEC(utp.estimate, params.nsec + elapsed + (params.mult*elapsed)/1000000000L);
+	TL_FROM_nSEC(utp.interval.above, (unsigned long long)u_bound);
+	TL_FROM_nSEC(utp.interval.below, (unsigned long long)l_bound);
+}
+
+static void stub_rem2core(timepoint_t &tp)
+{
+	tl_translation_t params;
+	tl_translation_read(&stub_params, &params);
+	int64_t tl_ns = TP_TO_nSEC(tp);
+	int64_t diff = tl_ns - params.nsec;
+	TP_FROM_nSEC(tp, params.last + (diff*1000000000L)/(1000000000L + params.mult));
+}
+
+static int stub_ioctl(unsigned long request, void *arg)
+{
+	std::lock_guard<std::mutex> lock(stub_mutex);
+	switch (request)
+	{
+		case QOTUSR_CREATE_TIMELINE:
+		{
+			qot_timeline_t *info = (qot_timeline_t*) arg;
+			std::map<std::string, int>::iterator it = stub_timelines.find(info->name);
+			if (it != stub_timelines.end())
+			{
+				errno = EEXIST;
+				return -1;
+			}
+			info->index = stub_timelines.size();
+			stub_timelines[info->name] = info->index;
+			return 0;
+		}
+		case QOTUSR_GET_TIMELINE_INFO:
+		{
+			qot_timeline_t *info = (qot_timeline_t*) arg;
+			std::map<std::string, int>::iterator it = stub_timelines.find(info->name);
+			if (it == stub_timelines.end())
+			{
+				errno = ENOENT;
+				return -1;
+			}
+			info->index = it->second;
+			return 0;
+		}
+		case QOTUSR_DESTROY_TIMELINE:
+		{
+			qot_timeline_t *info = (qot_timeline_t*) arg;
+			if (stub_bindings > 0)
+			{
+				errno = EBUSY;
+				return -1;
+			}
+			stub_timelines.erase(info->name);
+			return 0;
+		}
+		case TIMELINE_BIND_JOIN:
+			((qot_binding_t*) arg)->id = stub_bindings++;
+			return 0;
+		case TIMELINE_BIND_LEAVE:
+			if (stub_bindings > 0)
+				stub_bindings--;
+			return 0;
+		case TIMELINE_BIND_UPDATE:
+			return 0;
+		case TIMELINE_GET_CORE_TIME_NOW:
+		{
+			utimepoint_t *utp = (utimepoint_t*) arg;
+			memset(utp, 0, sizeof(*utp));
+			TP_FROM_nSEC(utp->estimate, core_now_ns());
+			return 0;
+		}
+		case TIMELINE_GET_TIME_NOW:
+		{
+			utimepoint_t *utp = (utimepoint_t*) arg;
+			TP_FROM_nSEC(utp->estimate, core_now_ns());
+			stub_core2rem(*utp);
+			return 0;
+		}
+		case TIMELINE_CORE_TO_REMOTE:
+		{
+			utimepoint_t utp;
+			utp.estimate = *(timepoint_t*) arg;
+			stub_core2rem(utp);
+			*(timepoint_t*) arg = utp.estimate;
+			return 0;
+		}
+		case TIMELINE_REMOTE_TO_CORE:
+			stub_rem2core(*(timepoint_t*) arg);
+			return 0;
+		default:
+			errno = ENOTTY;
+			return -1;
+	}
+}
+
+/* Interposed libc entry points, other descriptors go straight to the kernel */
+extern "C" int open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	if (flags & (O_CREAT | O_TMPFILE))
+	{
+		va_list args;
+		va_start(args, flags);
+		mode = va_arg(args, int);
+		va_end(args);
+	}
+
+	if (!is_stub_path(path))
+		return syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+
+	int fd = syscall(SYS_openat, AT_FDCWD, "/dev/null", O_RDWR, 0);
+	if (fd >= 0)
+	{
+		std::lock_guard<std::mutex> lock(stub_mutex);
+		stub_fds.insert(fd);
+	}
+	return fd;
+}
+
+extern "C" int close(int fd)
+{
+	{
+		std::lock_guard<std::mutex> lock(stub_mutex);
+		stub_fds.erase(fd);
+	}
+	return syscall(SYS_close, fd);
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...)
+{
+	va_list args;
+	va_start(args, request);
+	void *arg = va_arg(args, void*);
+	va_end(args);
+
+	if (!is_stub_fd(fd))
+		return syscall(SYS_ioctl, fd, request, arg);
+
+	// Cross into the kernel once, as the module call would
+	syscall(SYS_ioctl, fd, request, arg);
+	return stub_ioctl(request, arg);
+}
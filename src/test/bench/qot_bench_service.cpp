@@ -0,0 +1,295 @@
+/*
+ * @file qot_bench_service.cpp
+ * @brief In-process timeline service for the service-mode QoT benchmarks
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_bench.hpp"
+
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../../micro-services/timeline-service/qot_timeline_service.hpp"
+#include "../../micro-services/timeline-service/qot_tlmsg_serialize.hpp"
+
+extern "C"
+{
+	#include "../../qot_param_history.h"
+}
+
+using namespace qot_bench;
+
+// Receive buffer of one request (binary frames and JSON replies fit)
+#define QOT_BENCH_MSG_LEN 4096
+
+// Poll period of the server loop, bounds the time Stop() waits
+#define QOT_BENCH_POLL_MS 50
+
+/* Pass a descriptor over the socket (as send_fd in the timeline service) */
+static int send_fd(int sock, int fd)
+{
+	struct msghdr msg;
+	struct iovec iov[1];
+	char ctrl_buf[CMSG_SPACE(sizeof(int))];
+	char data[1] = {' '};
+
+	memset(&msg, 0, sizeof(msg));
+	memset(ctrl_buf, 0, sizeof(ctrl_buf));
+	iov[0].iov_base = data;
+	iov[0].iov_len = sizeof(data);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl_buf;
+	msg.msg_controllen = sizeof(ctrl_buf);
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	return sendmsg(sock, &msg, 0);
+}
+
+TimelineServiceStandin::TimelineServiceStandin()
+ : listen_sock(-1), running(false), next_binding(0)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		clk_fd[i] = -1;
+		clk_params[i] = NULL;
+	}
+}
+
+TimelineServiceStandin::~TimelineServiceStandin()
+{
+	Stop();
+}
+
+int TimelineServiceStandin::Start()
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, TL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+
+	// Never take the socket over from a running timeline service
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe < 0)
+		return -1;
+	if (connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0)
+	{
+		close(probe);
+		return -1;
+	}
+	close(probe);
+
+	// Clock parameter memory (main and overlay), with a parameter history as the timeline service creates it
+	for (int i = 0; i < 2; i++)
+	{
+		std::ostringstream name;
+		name << "/qot_bench_" << getpid() << "_" << i;
+		shm_name[i] = name.str();
+		int fd = shm_open(shm_name[i].c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+		if (fd < 0)
+			return -1;
+		if (ftruncate(fd, tl_history_segment_size(TL_HISTORY_CAPACITY)) < 0)
+		{
+			close(fd);
+			return -1;
+		}
+		void *base = mmap(0, tl_history_segment_size(TL_HISTORY_CAPACITY), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+			return -1;
+		clk_params[i] = (tl_translation_t*) base;
+		memset(clk_params[i], 0, sizeof(tl_translation_t));
+		tl_history_init(clk_params[i], TL_HISTORY_CAPACITY, TL_HISTORY_WINDOW_NS);
+		clk_fd[i] = shm_open(shm_name[i].c_str(), O_RDONLY, 0600);
+		if (clk_fd[i] < 0)
+			return -1;
+	}
+
+	unlink(TL_SOCKET_PATH);
+	listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_sock < 0)
+		return -1;
+	if (bind(listen_sock, (struct sockaddr *) &address, sizeof(address)) < 0 || listen(listen_sock, 8) < 0)
+	{
+		close(listen_sock);
+		listen_sock = -1;
+		return -1;
+	}
+
+	running = true;
+	server_thread = std::thread(&TimelineServiceStandin::serve_loop, this);
+	return 0;
+}
+
+void TimelineServiceStandin::Stop()
+{
+	if (running)
+	{
+		running = false;
+		server_thread.join();
+	}
+	if (listen_sock >= 0)
+	{
+		close(listen_sock);
+		listen_sock = -1;
+		unlink(TL_SOCKET_PATH);
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (clk_fd[i] >= 0)
+			close(clk_fd[i]);
+		if (clk_params[i])
+			munmap((void*)clk_params[i], tl_history_segment_size(TL_HISTORY_CAPACITY));
+		if (!shm_name[i].empty())
+			shm_unlink(shm_name[i].c_str());
+		clk_fd[i] = -1;
+		clk_params[i] = NULL;
+		shm_name[i].clear();
+	}
+}
+
+void TimelineServiceStandin::SetParams(const tl_translation_t &params, const tl_translation_t &ov_params)
+{
+	std::lock_guard<std::mutex> lock(params_mutex);
+	if (clk_params[0])
+		tl_translation_publish(clk_params[0], &params);
+	if (clk_params[1])
+		tl_translation_publish(clk_params[1], &ov_params);
+}
+
+/* Clients are served one at a time, the benchmarks hold a single binding */
+void TimelineServiceStandin::serve_loop()
+{
+	while (running)
+	{
+		struct pollfd pfd;
+		pfd.fd = listen_sock;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, QOT_BENCH_POLL_MS) <= 0)
+			continue;
+		int client = accept(listen_sock, NULL, NULL);
+		if (client < 0)
+			continue;
+		serve_client(client);
+		close(client);
+	}
+}
+
+void TimelineServiceStandin::serve_client(int client)
+{
+	char buffer[QOT_BENCH_MSG_LEN];
+	std::string rx;
+	bool wire_offered = false;
+	while (running)
+	{
+		struct pollfd pfd;
+		pfd.fd = client;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, QOT_BENCH_POLL_MS) <= 0)
+			continue;
+
+		int bytes = recv(client, buffer, sizeof(buffer), 0);
+		if (bytes <= 0)
+			return;
+		rx.append(buffer, bytes);
+
+		// Clients wait for each reply, so the buffer holds at most one request
+		qot_timeline_msg_t msg;
+		bool binary_flag = is_tlmsg_binary(rx.data(), rx.size());
+		if (binary_flag)
+		{
+			long frame_len = tlmsg_binary_frame_length(rx.data(), rx.size());
+			if (frame_len < 0)
+				return;
+			if (rx.size() < (size_t)frame_len)
+				continue;
+			if (deserialize_tlmsg_binary(rx.data(), frame_len, msg) < 0)
+				return;
+		}
+		else
+		{
+			if (!nlohmann::json::accept(rx))
+				continue;
+			nlohmann::json data = nlohmann::json::parse(rx);
+			deserialize_tlmsg(data, msg);
+			if (data.count("wire"))
+				wire_offered = true;
+		}
+		rx.clear();
+
+		msg.retval = QOT_RETURN_TYPE_OK;
+		switch (msg.msgtype)
+		{
+			case TIMELINE_CREATE:
+				msg.info.index = 0;
+				break;
+			case TIMELINE_BIND:
+				msg.binding.id = next_binding++;
+				break;
+			case TIMELINE_SHM_CLOCK:
+				send_fd(client, clk_fd[0]);
+				continue;
+			case TIMELINE_OV_SHM_CLOCK:
+				send_fd(client, clk_fd[1]);
+				continue;
+			case TIMELINE_UNBIND:
+			case TIMELINE_DESTROY:
+			case TIMELINE_UPDATE:
+				break;
+			default:
+				msg.retval = QOT_RETURN_TYPE_ERR;
+				break;
+		}
+
+		char frame[QOT_TLMSG_BIN_SIZE];
+		if (binary_flag && serialize_tlmsg_binary(msg, frame, sizeof(frame)) > 0)
+		{
+			send(client, frame, QOT_TLMSG_BIN_SIZE, 0);
+		}
+		else
+		{
+			// Accept the binary format the client offered
+			nlohmann::json reply = serialize_tlmsg(msg);
+			if (wire_offered)
+				reply["wire"] = QOT_TLMSG_BIN_VERSION;
+			std::string reply_string = reply.dump();
+			send(client, reply_string.c_str(), reply_string.length(), 0);
+		}
+	}
+}
@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <signal.h>
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+    #include "../qot_types.h"
+    #include "../qot_param_history.h"
+}
+
+#include "../api/cpp/qot_coreapi.hpp"
+#include "bench/qot_bench.hpp"
+
+#ifdef QOT_TIMELINE_SERVICE
+#include "../api/cpp/qot_coreapi_async.hpp"
+#include "../micro-services/sync-service/sync/SyncUncertainty.hpp"
+#include "../micro-services/sync-service/sync/huygens/SVMprocessor.hpp"
+#endif
+
+// Recorded probe data, overridable with QOT_BENCH_DATA_DIR in the environment
+#ifndef QOT_BENCH_DATA_DIR
+#define QOT_BENCH_DATA_DIR "bench"
+#endif
+
+using namespace qot_bench;
+
+// Calls per timed batch for operations well below the cost of reading the clock
+#define QOT_BENCH_BATCH 64
+
+/* Parameters of a disciplined timeline (10 ppm, 1 ms offset, growing bounds) */
+static tl_translation_t bench_params()
+{
+    struct timespec ts;
+    tl_translation_t params;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memset(&params, 0, sizeof(params));
+    params.last = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+    params.mult = 10000;
+    params.nsec = params.last + 1000000;
+    params.u_nsec = 500;
+    params.l_nsec = 500;
+    params.u_mult = 20;
+    params.l_mult = 20;
+    return params;
+}
+
+/* A binding to the benchmark timeline, served by the in-process service or the kernel stub */
+class BoundTimeline
+{
+    public: BoundTimeline() : binding(NULL), bound(false)
+    {
+        tl_translation_t params = bench_params();
+        #ifdef QOT_TIMELINE_SERVICE
+        tl_translation_t ov_params;
+        memset(&ov_params, 0, sizeof(ov_params));
+        if (service.Start() < 0)
+            return;
+        service.SetParams(params, ov_params);
+        #else
+        kernel_stub_set_params(params);
+        #endif
+        binding = new qot_coreapi::TimelineBinding(1);
+    }
+    public: ~BoundTimeline()
+    {
+        if (binding && bound)
+            binding->timeline_unbind();
+        delete binding;
+        #ifdef QOT_TIMELINE_SERVICE
+        service.Stop();
+        #endif
+    }
+    public: bool Bind()
+    {
+        timelength_t res;
+        timeinterval_t acc;
+        TL_FROM_nSEC(res, 1);
+        TL_FROM_uSEC(acc.above, 10);
+        TL_FROM_uSEC(acc.below, 10);
+        if (!binding)
+            return false;
+        bound = (binding->timeline_bind("bench_timeline", "bench_app", res, acc) == QOT_RETURN_TYPE_OK);
+        return bound;
+    }
+    public: bool Unbind()
+    {
+        bound = false;
+        return binding->timeline_unbind() == QOT_RETURN_TYPE_OK;
+    }
+    public: qot_coreapi::TimelineBinding *binding;
+    private: bool bound;
+    #ifdef QOT_TIMELINE_SERVICE
+    private: TimelineServiceStandin service;
+    #endif
+};
+
+static void BM_TimelineGetTime(benchmark::State& state)
+{
+    BoundTimeline timeline;
+    if (!timeline.Bind()) {
+        state.SkipWithError("Cannot bind to the benchmark timeline");
+        return;
+    }
+    LatencyRecorder latency;
+    utimepoint_t est;
+    for (auto _ : state) {
+        latency.Start();
+        timeline.binding->timeline_gettime(est);
+        latency.Stop();
+        benchmark::DoNotOptimize(est);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelineGetTime);
+
+static void BM_TimelineGetCoreTime(benchmark::State& state)
+{
+    BoundTimeline timeline;
+    if (!timeline.Bind()) {
+        state.SkipWithError("Cannot bind to the benchmark timeline");
+        return;
+    }
+    LatencyRecorder latency;
+    utimepoint_t core_now;
+    for (auto _ : state) {
+        latency.Start();
+        timeline.binding->timeline_getcoretime(core_now);
+        latency.Stop();
+        benchmark::DoNotOptimize(core_now);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelineGetCoreTime);
+
+static void BM_TimelineCore2Rem(benchmark::State& state)
+{
+    BoundTimeline timeline;
+    if (!timeline.Bind()) {
+        state.SkipWithError("Cannot bind to the benchmark timeline");
+        return;
+    }
+    LatencyRecorder latency;
+    utimepoint_t core_now;
+    timeline.binding->timeline_getcoretime(core_now);
+    for (auto _ : state) {
+        timepoint_t est = core_now.estimate;
+        latency.Start();
+        timeline.binding->timeline_core2rem(est);
+        latency.Stop();
+        benchmark::DoNotOptimize(est);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelineCore2Rem);
+
+static void BM_TimelineRem2Core(benchmark::State& state)
+{
+    BoundTimeline timeline;
+    if (!timeline.Bind()) {
+        state.SkipWithError("Cannot bind to the benchmark timeline");
+        return;
+    }
+    LatencyRecorder latency;
+    utimepoint_t now;
+    timeline.binding->timeline_gettime(now);
+    for (auto _ : state) {
+        timepoint_t est = now.estimate;
+        latency.Start();
+        timeline.binding->timeline_rem2core(est);
+        latency.Stop();
+        benchmark::DoNotOptimize(est);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelineRem2Core);
+
+static void BM_TimelineBindUnbind(benchmark::State& state)
+{
+    BoundTimeline timeline;
+    LatencyRecorder latency;
+    for (auto _ : state) {
+        latency.Start();
+        bool ok = timeline.Bind() && timeline.Unbind();
+        latency.Stop();
+        if (!ok) {
+            state.SkipWithError("Bind/unbind round trip failed");
+            break;
+        }
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelineBindUnbind);
+
+#ifdef QOT_TIMELINE_SERVICE
+/* Many pending waits on one asynchronous binding: queueing cost per wait and wakeup lateness */
+static void BM_AsyncWaits(benchmark::State& state)
+{
+    TimelineServiceStandin service;
+    tl_translation_t params = bench_params();
+    tl_translation_t ov_params;
+    memset(&ov_params, 0, sizeof(ov_params));
+    if (service.Start() < 0) {
+        state.SkipWithError("Cannot start the timeline service stand-in");
+        return;
+    }
+    service.SetParams(params, ov_params);
+
+    qot_coreapi::TimelineAsyncBinding timeline(1);
+    timelength_t res;
+    timeinterval_t acc;
+    TL_FROM_nSEC(res, 1);
+    TL_FROM_uSEC(acc.above, 10);
+    TL_FROM_uSEC(acc.below, 10);
+    if (timeline.timeline_bind("bench_timeline", "bench_app", res, acc).get() != QOT_RETURN_TYPE_OK) {
+        state.SkipWithError("Cannot bind to the benchmark timeline");
+        return;
+    }
+
+    // Deadlines spread over 100 ms, starting 20 ms out
+    int waits = state.range(0);
+    LatencyRecorder latency(waits);
+    std::vector<int64_t> lateness;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    for (auto _ : state) {
+        std::atomic<int> pending(waits);
+        utimepoint_t now;
+        timeline.binding()->timeline_gettime(now);
+        int64_t first = TP_TO_nSEC(now.estimate);
+        first += 20000000;
+
+        latency.Start();
+        for (int i = 0; i < waits; i++) {
+            utimepoint_t utp = now;
+            int64_t target = first + (100000000LL*i)/waits;
+            TP_FROM_nSEC(utp.estimate, target);
+            timeline.timeline_waituntil(utp, [&, target](qot_return_t retval, utimepoint_t reached) {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (retval == QOT_RETURN_TYPE_OK) {
+                    int64_t reached_ns = TP_TO_nSEC(reached.estimate);
+                    lateness.push_back(reached_ns - target);
+                }
+                if (--pending == 0)
+                    done_cv.notify_one();
+            });
+        }
+        latency.Stop();
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&]() { return pending == 0; });
+    }
+    latency.Report(state);
+    timeline.timeline_unbind().get();
+    service.Stop();
+
+    // Wakeup lateness on the timeline
+    if (!lateness.empty()) {
+        std::sort(lateness.begin(), lateness.end());
+        state.counters["late_p50"] = double(lateness[lateness.size()/2]);
+        state.counters["late_p99"] = double(lateness[(lateness.size()*99)/100]);
+    }
+}
+BENCHMARK(BM_AsyncWaits)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+#endif
+
+/* qot_types.h conversions on the path of every timestamp */
+static void BM_TimelengthFromTo(benchmark::State& state)
+{
+    LatencyRecorder latency(QOT_BENCH_BATCH);
+    timelength_t tl;
+    u64 ns = 1234567890123ULL;
+    for (auto _ : state) {
+        latency.Start();
+        for (int i = 0; i < QOT_BENCH_BATCH; i++) {
+            TL_FROM_nSEC(tl, ns + i);
+            u64 back = TL_TO_nSEC(tl);
+            benchmark::DoNotOptimize(back);
+        }
+        latency.Stop();
+    }
+    state.SetItemsProcessed(state.iterations()*QOT_BENCH_BATCH);
+    latency.Report(state);
+}
+BENCHMARK(BM_TimelengthFromTo);
+
+static void BM_TimepointFromTo(benchmark::State& state)
+{
+    LatencyRecorder latency(QOT_BENCH_BATCH);
+    timepoint_t tp;
+    s64 ns = 1534567890123456789LL;
+    for (auto _ : state) {
+        latency.Start();
+        for (int i = 0; i < QOT_BENCH_BATCH; i++) {
+            TP_FROM_nSEC(tp, ns + i);
+            s64 back = TP_TO_nSEC(tp);
+            benchmark::DoNotOptimize(back);
+        }
+        latency.Stop();
+    }
+    state.SetItemsProcessed(state.iterations()*QOT_BENCH_BATCH);
+    latency.Report(state);
+}
+BENCHMARK(BM_TimepointFromTo);
+
+static void BM_TimepointArithmetic(benchmark::State& state)
+{
+    LatencyRecorder latency(QOT_BENCH_BATCH);
+    timepoint_t t1, t2;
+    timelength_t step, diff;
+    TP_FROM_nSEC(t1, 1534567890123456789LL);
+    TP_FROM_nSEC(t2, 1534567890123456789LL);
+    TL_FROM_nSEC(step, 1001);
+    for (auto _ : state) {
+        latency.Start();
+        for (int i = 0; i < QOT_BENCH_BATCH; i++) {
+            timepoint_add(&t1, &step);
+            timepoint_diff(&diff, &t1, &t2);
+            int cmp = timepoint_cmp(&t1, &t2);
+            benchmark::DoNotOptimize(cmp);
+        }
+        latency.Stop();
+        benchmark::DoNotOptimize(diff);
+    }
+    state.SetItemsProcessed(state.iterations()*QOT_BENCH_BATCH);
+    latency.Report(state);
+}
+BENCHMARK(BM_TimepointArithmetic);
+
+static void BM_TimepointTimespec(benchmark::State& state)
+{
+    LatencyRecorder latency(QOT_BENCH_BATCH);
+    struct timespec ts;
+    timepoint_t tp;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    for (auto _ : state) {
+        latency.Start();
+        for (int i = 0; i < QOT_BENCH_BATCH; i++) {
+            timepoint_from_timespec(&tp, &ts);
+            timespec_from_timepoint(&ts, &tp);
+        }
+        latency.Stop();
+        benchmark::DoNotOptimize(ts);
+    }
+    state.SetItemsProcessed(state.iterations()*QOT_BENCH_BATCH);
+    latency.Report(state);
+}
+BENCHMARK(BM_TimepointTimespec);
+
+#ifdef QOT_TIMELINE_SERVICE
+/* Uncertainty update of a sync data point (sliding windows and quantiles) */
+static void BM_CalculateBounds(benchmark::State& state)
+{
+    qot::SyncUncertainty uncertainty;
+    tl_translation_t params = bench_params();
+    std::string uuid("bench_timeline");
+    unsigned int seed = 1;
+    LatencyRecorder latency;
+    for (auto _ : state) {
+        int64_t offset = int64_t(rand_r(&seed) % 2000) - 1000;
+        double drift = (double(rand_r(&seed) % 200) - 100)/1000000000LL;
+        latency.Start();
+        bool ready = uncertainty.CalculateBounds(offset, drift, -1, &params, uuid);
+        latency.Stop();
+        benchmark::DoNotOptimize(ready);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_CalculateBounds);
+
+/* Parameter lookup for a past timestamp in a full history, argument is how many updates back it lies */
+static void BM_ParamHistoryFind(benchmark::State& state)
+{
+    std::vector<char> segment(tl_history_segment_size(TL_HISTORY_CAPACITY));
+    tl_translation_t *clk_params = (tl_translation_t*) &segment[0];
+    tl_history_init(clk_params, TL_HISTORY_CAPACITY, TL_HISTORY_WINDOW_NS);
+    tl_translation_t params = bench_params();
+    int64_t last = params.last;
+    for (uint32_t i = 0; i < TL_HISTORY_CAPACITY; i++) {
+        params.last = last + i*TL_HISTORY_MIN_PERIOD_NS;
+        tl_history_append(clk_params, &params);
+    }
+    int64_t core_ns = last + (TL_HISTORY_CAPACITY - 1 - state.range(0))*TL_HISTORY_MIN_PERIOD_NS + 1;
+    LatencyRecorder latency;
+    for (auto _ : state) {
+        latency.Start();
+        int retval = tl_history_find(clk_params, core_ns, &params);
+        latency.Stop();
+        benchmark::DoNotOptimize(retval);
+    }
+    latency.Report(state);
+}
+BENCHMARK(BM_ParamHistoryFind)->Arg(0)->Arg(TL_HISTORY_CAPACITY/2)->Arg(TL_HISTORY_CAPACITY - 1);
+
+/* Huygens SVM over a recorded window of coded probes (cold and warm started) */
+static void BM_SVMBatch(benchmark::State& state)
+{
+    std::vector<int64_t> bounds, instant;
+    const char *dir = getenv("QOT_BENCH_DATA_DIR");
+    std::string path = std::string(dir ? dir : QOT_BENCH_DATA_DIR) + "/huygens_probes.csv";
+    if (load_probe_trace(path, bounds, instant) < 0) {
+        state.SkipWithError("Cannot load the recorded probes");
+        return;
+    }
+    int vec_len = instant.size();
+    bool warm = state.range(0);
+    qot::SVMprocessor svm(vec_len);
+    double offset, drift;
+    LatencyRecorder latency;
+    for (auto _ : state) {
+        if (!warm)
+            svm.Reset();
+        latency.Start();
+        int retval = -1;
+        if (svm.FormulateProblem(bounds, instant, vec_len) == 0)
+            retval = svm.Run(offset, drift);
+        latency.Stop();
+        if (retval < 0) {
+            state.SkipWithError("SVM did not yield a hyperplane");
+            break;
+        }
+    }
+    state.counters["probes"] = vec_len;
+    latency.Report(state);
+}
+BENCHMARK(BM_SVMBatch)->ArgName("warm")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+#endif
+
+BENCHMARK_MAIN();
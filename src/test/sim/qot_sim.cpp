@@ -0,0 +1,463 @@
+/*
+ * @file qot_sim.cpp
+ * @brief Discrete-event simulation of clocks and networks for the sync algorithms
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+#include "../../micro-services/sync-service/qot_fault.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+using namespace qot;
+
+/* Simulator routing the clock calls of the process (NULL -> real clocks) */
+static Simulator *active_simulator = NULL;
+
+/* Random Source (splitmix64) */
+SimRandom::SimRandom(uint64_t seed)
+{
+	Seed(seed);
+}
+
+void SimRandom::Seed(uint64_t seed)
+{
+	state = seed;
+	have_spare = false;
+	spare = 0;
+}
+
+uint64_t SimRandom::Next()
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+double SimRandom::Uniform()
+{
+	return (Next() >> 11) * (1.0/9007199254740992.0);
+}
+
+double SimRandom::Gaussian()
+{
+	// Box-Muller, the second value is kept for the next call
+	if (have_spare)
+	{
+		have_spare = false;
+		return spare;
+	}
+	double u1 = 1.0 - Uniform();
+	double u2 = Uniform();
+	double r = sqrt(-2.0*log(u1));
+	spare = r*sin(2*M_PI*u2);
+	have_spare = true;
+	return r*cos(2*M_PI*u2);
+}
+
+double SimRandom::Exponential(double mean)
+{
+	return -mean*log(1.0 - Uniform());
+}
+
+/* Oscillator */
+SimOscillator::SimOscillator(const sim_oscillator_params &osc_params, uint64_t seed)
+ : params(osc_params), rng(seed), last_ns(0), phase_ns(osc_params.offset_ns), wander_ppb(0), step_ppb(0), adj_ppb(0), next_step(0)
+{
+	std::sort(params.steps.begin(), params.steps.end(),
+		[](const sim_freq_step &a, const sim_freq_step &b) { return a.time_ns < b.time_ns; });
+}
+
+double SimOscillator::Rate() const
+{
+	return params.drift_ppb + wander_ppb + step_ppb + adj_ppb;
+}
+
+// The random walk is updated on a fixed grid, so the path does not depend on when the clock is read
+void SimOscillator::Advance(int64_t true_ns)
+{
+	while (last_ns < true_ns)
+	{
+		int64_t grid = (last_ns/SIM_OSC_STEP_NS + 1)*SIM_OSC_STEP_NS;
+		int64_t end = std::min(true_ns, grid);
+		if (next_step < params.steps.size() && params.steps[next_step].time_ns > last_ns && params.steps[next_step].time_ns < end)
+			end = params.steps[next_step].time_ns;
+
+		phase_ns += double(end - last_ns)*Rate()*1e-9;
+		last_ns = end;
+
+		while (next_step < params.steps.size() && params.steps[next_step].time_ns <= last_ns)
+			step_ppb += params.steps[next_step++].drift_ppb;
+		if (last_ns == grid && params.wander_ppb > 0)
+			wander_ppb += params.wander_ppb*sqrt(SIM_OSC_STEP_NS*1e-9)*rng.Gaussian();
+	}
+}
+
+int64_t SimOscillator::Read(int64_t true_ns)
+{
+	if (true_ns >= last_ns)
+	{
+		Advance(true_ns);
+		return true_ns + llround(phase_ns);
+	}
+
+	// Reads in the past are extrapolated with the current rate
+	return true_ns + llround(phase_ns - double(last_ns - true_ns)*Rate()*1e-9);
+}
+
+void SimOscillator::SetFrequency(int64_t true_ns, double ppb)
+{
+	Advance(true_ns);
+	adj_ppb = ppb;
+}
+
+double SimOscillator::GetFrequency() const
+{
+	return adj_ppb;
+}
+
+void SimOscillator::Step(int64_t true_ns, int64_t delta_ns)
+{
+	Advance(true_ns);
+	phase_ns += delta_ns;
+}
+
+/* Network */
+SimNetwork::SimNetwork(const sim_network_params &net_params, uint64_t seed)
+ : params(net_params), rng(seed)
+{
+}
+
+bool SimNetwork::Delay(bool forward, int64_t &delay_ns)
+{
+	if (params.loss > 0 && rng.Uniform() < params.loss)
+		return false;
+
+	double delay = params.base_ns + (forward ? params.asymmetry_ns/2 : -params.asymmetry_ns/2);
+	switch (params.dist)
+	{
+		case SIM_DELAY_UNIFORM:
+			delay += params.jitter_ns*rng.Uniform();
+			break;
+		case SIM_DELAY_EXPONENTIAL:
+			delay += rng.Exponential(params.jitter_ns);
+			break;
+		case SIM_DELAY_LOGNORMAL:
+			delay += params.jitter_ns*exp(rng.Gaussian());
+			break;
+		default:
+			break;
+	}
+	// Injected faults, the forward path takes the delay spikes and the asymmetry
+	int64_t shift = 0;
+	if (qot_fault_packet(forward, &shift))
+		return false;
+	delay += shift;
+
+	delay_ns = (delay > 0) ? llround(delay) : 0;
+	return true;
+}
+
+/* Simulator */
+Simulator::Simulator(uint64_t seed)
+ : now_ns(0), seq(0), rng(seed)
+{
+}
+
+Simulator::~Simulator()
+{
+	Deactivate();
+}
+
+int64_t Simulator::Now() const
+{
+	return now_ns;
+}
+
+void Simulator::Schedule(int64_t at_ns, std::function<void()> event)
+{
+	sim_event entry;
+	entry.time_ns = std::max(at_ns, now_ns);
+	entry.seq = seq++;
+	entry.event = event;
+	events.push(entry);
+}
+
+void Simulator::RunUntil(int64_t end_ns)
+{
+	while (!events.empty() && events.top().time_ns <= end_ns)
+	{
+		sim_event entry = events.top();
+		events.pop();
+		now_ns = entry.time_ns;
+		entry.event();
+	}
+	if (end_ns > now_ns)
+		now_ns = end_ns;
+}
+
+void Simulator::Attach(clockid_t clkid, SimOscillator *oscillator)
+{
+	clocks[clkid] = oscillator;
+}
+
+SimOscillator* Simulator::Lookup(clockid_t clkid)
+{
+	std::map<clockid_t, SimOscillator*>::iterator it = clocks.find(clkid);
+	return (it == clocks.end()) ? NULL : it->second;
+}
+
+void Simulator::Activate()
+{
+	active_simulator = this;
+}
+
+void Simulator::Deactivate()
+{
+	if (active_simulator == this)
+		active_simulator = NULL;
+}
+
+Simulator* Simulator::Active()
+{
+	return active_simulator;
+}
+
+SimRandom& Simulator::Random()
+{
+	return rng;
+}
+
+/* Metrics */
+sim_metrics qot::sim_summarize(const std::vector<sim_sample> &samples, double threshold_ns, int64_t fault_ns)
+{
+	sim_metrics metrics;
+	metrics.convergence_s = -1;
+	metrics.rms_error_ns = 0;
+	metrics.max_error_ns = 0;
+	metrics.coverage = -1;
+	metrics.checks = samples.size();
+	metrics.recovery_s = -1;
+	metrics.fault_coverage = -1;
+	if (samples.empty())
+		return metrics;
+
+	// Converged after the last check above the threshold
+	size_t start = 0;
+	for (size_t i = samples.size(); i > 0; i--)
+	{
+		if (fabs(samples[i-1].error_ns) > threshold_ns)
+		{
+			start = i;
+			break;
+		}
+	}
+	if (start < samples.size())
+		metrics.convergence_s = samples[start].time_ns*1e-9;
+	else
+		start = samples.size()/2;
+
+	double sum_sq = 0;
+	int covered = 0, bounded = 0;
+	for (size_t i = start; i < samples.size(); i++)
+	{
+		sum_sq += samples[i].error_ns*samples[i].error_ns;
+		metrics.max_error_ns = std::max(metrics.max_error_ns, fabs(samples[i].error_ns));
+		if (samples[i].covered >= 0)
+		{
+			bounded++;
+			covered += samples[i].covered;
+		}
+	}
+	metrics.rms_error_ns = sqrt(sum_sq/(samples.size() - start));
+	if (bounded > 0)
+		metrics.coverage = double(covered)/bounded;
+	if (fault_ns < 0)
+		return metrics;
+
+	// Recovered after the last check above the threshold past the fault
+	size_t first = 0;
+	while (first < samples.size() && samples[first].time_ns < fault_ns)
+		first++;
+	size_t recovered = first;
+	covered = bounded = 0;
+	for (size_t i = first; i < samples.size(); i++)
+	{
+		if (fabs(samples[i].error_ns) > threshold_ns)
+			recovered = i + 1;
+		if (samples[i].covered >= 0)
+		{
+			bounded++;
+			covered += samples[i].covered;
+		}
+	}
+	if (recovered < samples.size())
+		metrics.recovery_s = std::max(0.0, (samples[recovered].time_ns - fault_ns)*1e-9);
+	if (bounded > 0)
+		metrics.fault_coverage = double(covered)/bounded;
+	return metrics;
+}
+
+/* Scenarios */
+static void random_oscillator(SimRandom &rng, sim_oscillator_params &osc, double duration_s, double max_offset_ns)
+{
+	osc.offset_ns = max_offset_ns*(2*rng.Uniform() - 1);
+	osc.drift_ppb = 20000*(2*rng.Uniform() - 1);		// +-20 ppm
+	osc.wander_ppb = 2*rng.Uniform();
+	osc.steps.clear();
+	int num_steps = rng.Next() % 3;						// Up to two temperature steps
+	for (int i = 0; i < num_steps; i++)
+	{
+		sim_freq_step step;
+		step.time_ns = int64_t(duration_s*rng.Uniform()*1e9);
+		step.drift_ppb = 200*(2*rng.Uniform() - 1);
+		osc.steps.push_back(step);
+	}
+}
+
+sim_scenario qot::sim_random_scenario(sim_algorithm algorithm, uint64_t seed, double duration_s)
+{
+	SimRandom rng(seed);
+	sim_scenario scenario;
+	scenario.algorithm = algorithm;
+	scenario.seed = seed;
+	scenario.discipline_phc = false;
+
+	// Per-algorithm operating point (PTP and Huygens with hardware timestamps, NTP with software timestamps)
+	double base_lo, base_hi, jitter_lo, jitter_hi, asymmetry;
+	switch (algorithm)
+	{
+		case SIM_NTP_CHRONY:
+			scenario.duration_s = 7200;
+			scenario.sync_interval_s = 16;		// minpoll 4
+			scenario.eval_interval_s = 4;
+			scenario.threshold_ns = 100000;
+			base_lo = 100000; base_hi = 5000000;
+			jitter_lo = 10000; jitter_hi = 500000;
+			asymmetry = 50000;
+			break;
+		case SIM_HUYGENS:
+			scenario.duration_s = 120;
+			scenario.sync_interval_s = 0.05;
+			scenario.eval_interval_s = 0.5;
+			scenario.threshold_ns = 1000;
+			base_lo = 5000; base_hi = 100000;
+			jitter_lo = 100; jitter_hi = 2000;
+			asymmetry = 200;
+			break;
+		default:
+			scenario.duration_s = 600;
+			scenario.sync_interval_s = 1;
+			scenario.eval_interval_s = 0.25;
+			scenario.threshold_ns = 1000;
+			base_lo = 1000; base_hi = 50000;
+			jitter_lo = 10; jitter_hi = 200;
+			asymmetry = 100;
+			break;
+	}
+	if (duration_s > 0)
+		scenario.duration_s = duration_s;
+
+	// The disciplined node starts up to a millisecond off, the reference is ideal except for peers
+	random_oscillator(rng, scenario.local, scenario.duration_s, 1000000);
+	if (algorithm == SIM_HUYGENS)
+	{
+		random_oscillator(rng, scenario.remote, scenario.duration_s, 1000000);
+	}
+	else
+	{
+		scenario.remote.offset_ns = 0;
+		scenario.remote.drift_ppb = 0;
+		scenario.remote.wander_ppb = 0;
+		scenario.remote.steps.clear();
+	}
+
+	scenario.network.base_ns = int64_t(base_lo + (base_hi - base_lo)*rng.Uniform());
+	scenario.network.dist = sim_delay_dist(rng.Next() % 4);
+	scenario.network.jitter_ns = jitter_lo + (jitter_hi - jitter_lo)*rng.Uniform();
+	scenario.network.asymmetry_ns = asymmetry*(2*rng.Uniform() - 1);
+	scenario.network.loss = 0.02*rng.Uniform();
+	return scenario;
+}
+
+int qot::sim_run(const sim_scenario &scenario, sim_metrics &metrics)
+{
+	std::vector<sim_sample> samples;
+	int retval;
+
+	// Faults are timed from the start of the run
+	int64_t fault_ns = -1;
+	if (!scenario.faults.empty())
+	{
+		uint64_t seed;
+		std::vector<qot_fault_t> faults;
+		std::string error;
+		if (fault_parse(scenario.faults, seed, faults, error) < 0 || fault_arm(scenario.faults, error, 0) < 0)
+		{
+			fprintf(stderr, "sim: fault script not armed: %s\n", error.c_str());
+			return -1;
+		}
+		for (size_t i = 0; i < faults.size(); i++)
+		{
+			if (fault_ns < 0 || faults[i].start_ns < fault_ns)
+				fault_ns = faults[i].start_ns;
+		}
+	}
+
+	switch (scenario.algorithm)
+	{
+		case SIM_PTP_PI:
+		case SIM_PTP_LINREG:
+			retval = sim_run_ptp(scenario, samples);
+			break;
+		case SIM_NTP_CHRONY:
+			retval = sim_run_chrony(scenario, samples);
+			break;
+		case SIM_HUYGENS:
+			retval = sim_run_huygens(scenario, samples);
+			break;
+		default:
+			retval = -1;
+			break;
+	}
+	fault_disarm();
+	if (retval < 0)
+		return retval;
+
+	metrics = sim_summarize(samples, scenario.threshold_ns, fault_ns);
+	return 0;
+}
+
+const char* qot::sim_algorithm_name(sim_algorithm algorithm)
+{
+	static const char *names[SIM_NUM_ALGORITHMS] = {"ptp-pi", "ptp-linreg", "ntp-chrony", "huygens"};
+	if (algorithm < 0 || algorithm >= SIM_NUM_ALGORITHMS)
+		return NULL;
+	return names[algorithm];
+}
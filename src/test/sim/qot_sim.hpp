@@ -0,0 +1,254 @@
+/*
+ * @file qot_sim.hpp
+ * @brief Discrete-event simulation of clocks and networks for the sync algorithms
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QOT_SIM_HPP
+#define QOT_SIM_HPP
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <map>
+#include <string>
+#include <functional>
+
+extern "C"
+{
+	#include <time.h>
+}
+
+// Largest true-time step over which the oscillator frequency is held constant
+#define SIM_OSC_STEP_NS 100000000LL
+
+namespace qot
+{
+	/* Deterministic random source: the same seed gives the same scenario on every
+	   platform (the std distributions are implementation defined) */
+	class SimRandom
+	{
+		public: SimRandom(uint64_t seed = 1);
+		public: void Seed(uint64_t seed);
+
+		// Raw 64-bit output
+		public: uint64_t Next();
+
+		// Uniform in [0,1)
+		public: double Uniform();
+
+		// Standard normal
+		public: double Gaussian();
+
+		// Exponential with the given mean
+		public: double Exponential(double mean);
+
+		private: uint64_t state;
+		private: bool have_spare;
+		private: double spare;
+	};
+
+	/* Step change of the oscillator frequency (e.g. a temperature change) */
+	struct sim_freq_step {
+		int64_t time_ns;		// True time of the step
+		double drift_ppb;		// Frequency change in ppb
+	};
+
+	/* Oscillator Parameters */
+	struct sim_oscillator_params {
+		double offset_ns;					// Initial offset from true time
+		double drift_ppb;					// Constant frequency error
+		double wander_ppb;					// Random walk of the frequency error (ppb per sqrt(s))
+		std::vector<sim_freq_step> steps;	// Frequency steps
+	};
+
+	/* Free-running oscillator with a frequency correction and phase steps (a PHC) */
+	class SimOscillator
+	{
+		public: SimOscillator(const sim_oscillator_params &params, uint64_t seed);
+
+		// Local time at a true time
+		public: int64_t Read(int64_t true_ns);
+
+		// Set the frequency correction in ppb from a true time on (ADJ_FREQUENCY)
+		public: void SetFrequency(int64_t true_ns, double ppb);
+		public: double GetFrequency() const;
+
+		// Step the local time at a true time (ADJ_SETOFFSET)
+		public: void Step(int64_t true_ns, int64_t delta_ns);
+
+		// Frequency of the local time against true time in ppb, correction included
+		public: double Rate() const;
+
+		// Integrate the phase up to a true time
+		private: void Advance(int64_t true_ns);
+
+		private: sim_oscillator_params params;
+		private: SimRandom rng;
+		private: int64_t last_ns;		// True time the phase refers to
+		private: double phase_ns;		// Local minus true time at last_ns
+		private: double wander_ppb;		// Current random-walk component
+		private: double step_ppb;		// Sum of the frequency steps applied so far
+		private: double adj_ppb;		// Frequency correction
+		private: size_t next_step;		// Next frequency step to apply
+	};
+
+	/* Delay distributions */
+	enum sim_delay_dist {
+		SIM_DELAY_CONSTANT = 0,		// base only
+		SIM_DELAY_UNIFORM,			// base + U(0, jitter)
+		SIM_DELAY_EXPONENTIAL,		// base + Exp(jitter)
+		SIM_DELAY_LOGNORMAL,		// base + LogNormal(median jitter, sigma 1)
+	};
+
+	/* Network Parameters */
+	struct sim_network_params {
+		int64_t base_ns;			// Minimum one-way delay
+		sim_delay_dist dist;		// Queueing delay distribution
+		double jitter_ns;			// Scale of the queueing delay
+		double asymmetry_ns;		// Forward minus reverse minimum delay
+		double loss;				// Probability that a packet is lost
+	};
+
+	/* Path between two nodes */
+	class SimNetwork
+	{
+		public: SimNetwork(const sim_network_params &params, uint64_t seed);
+
+		// Draw the delay of a packet, returns false if it is lost
+		public: bool Delay(bool forward, int64_t &delay_ns);
+
+		private: sim_network_params params;
+		private: SimRandom rng;
+	};
+
+	/* Discrete-event simulator in virtual (true) time. While a simulator is active the
+	   clock_gettime, clock_nanosleep and clock_adjtime calls of the process run on it */
+	class Simulator
+	{
+		public: Simulator(uint64_t seed);
+		public: ~Simulator();
+
+		// Current true time
+		public: int64_t Now() const;
+
+		// Queue an event, events at the same time run in the order they were queued
+		public: void Schedule(int64_t at_ns, std::function<void()> event);
+
+		// Run the events up to (and including) a true time
+		public: void RunUntil(int64_t end_ns);
+
+		// Serve a clock id from an oscillator (unattached clocks read true time)
+		public: void Attach(clockid_t clkid, SimOscillator *oscillator);
+		public: SimOscillator* Lookup(clockid_t clkid);
+
+		// Route the clock calls of the process to this simulator
+		public: void Activate();
+		public: void Deactivate();
+		public: static Simulator* Active();
+
+		public: SimRandom& Random();
+
+		private: struct sim_event {
+			int64_t time_ns;
+			uint64_t seq;
+			std::function<void()> event;
+		};
+		private: struct sim_event_later {
+			bool operator()(const sim_event &a, const sim_event &b) const
+			{
+				return a.time_ns > b.time_ns || (a.time_ns == b.time_ns && a.seq > b.seq);
+			}
+		};
+
+		private: std::priority_queue<sim_event, std::vector<sim_event>, sim_event_later> events;
+		private: std::map<clockid_t, SimOscillator*> clocks;
+		private: int64_t now_ns;
+		private: uint64_t seq;
+		private: SimRandom rng;
+	};
+
+	/* Algorithms driven by the harness */
+	enum sim_algorithm {
+		SIM_PTP_PI = 0,			// linuxptp PI servo
+		SIM_PTP_LINREG,			// linuxptp linear regression servo
+		SIM_NTP_CHRONY,			// chrony source statistics (regression over the samples)
+		SIM_HUYGENS,			// Huygens coded probes and the SVM processor
+		SIM_NUM_ALGORITHMS
+	};
+
+	/* Scenario */
+	struct sim_scenario {
+		sim_algorithm algorithm;
+		uint64_t seed;
+		double duration_s;			// Simulated time
+		double sync_interval_s;		// PTP sync / NTP poll / Huygens probe period
+		double eval_interval_s;		// Period of the error and bound checks
+		double threshold_ns;		// Error below which the clock counts as converged
+		bool discipline_phc;		// PTP: the servo steers the PHC through clock_adjtime instead of the timeline parameters
+		sim_oscillator_params local;	// Disciplined node
+		sim_oscillator_params remote;	// Reference node (master, server or peer)
+		sim_network_params network;
+		std::string faults;			// Fault script armed at true time 0 (empty for none, needs QOT_FAULT_INJECTION)
+	};
+
+	/* Results of a scenario */
+	struct sim_metrics {
+		double convergence_s;		// Time after which the error stays below the threshold (-1 if never)
+		double rms_error_ns;		// RMS error after convergence (second half of the run if not converged)
+		double max_error_ns;		// Maximum absolute error over the same span
+		double coverage;			// Fraction of checks where true time is inside the published bounds (-1 without bounds)
+		int checks;					// Number of error checks
+		double recovery_s;			// Time from the first fault until the error stays below the threshold (-1 if never or no faults)
+		double fault_coverage;		// Coverage from the first fault on (-1 without faults or bounds)
+	};
+
+	/* Error check of a run */
+	struct sim_sample {
+		int64_t time_ns;
+		double error_ns;
+		int covered;				// 1 inside the bounds, 0 outside, -1 no bounds yet
+	};
+
+	/* Metrics from the error checks of a run, with the recovery from a fault starting at fault_ns */
+	sim_metrics sim_summarize(const std::vector<sim_sample> &samples, double threshold_ns, int64_t fault_ns = -1);
+
+	/* Random scenario for an algorithm (oscillators, temperature steps and network drawn from the seed) */
+	sim_scenario sim_random_scenario(sim_algorithm algorithm, uint64_t seed, double duration_s);
+
+	/* Run a scenario, returns 0 on success */
+	int sim_run(const sim_scenario &scenario, sim_metrics &metrics);
+
+	/* Algorithm drivers */
+	int sim_run_ptp(const sim_scenario &scenario, std::vector<sim_sample> &samples);
+	int sim_run_chrony(const sim_scenario &scenario, std::vector<sim_sample> &samples);
+	int sim_run_huygens(const sim_scenario &scenario, std::vector<sim_sample> &samples);
+
+	/* Name of an algorithm (NULL if out of range) */
+	const char* sim_algorithm_name(sim_algorithm algorithm);
+}
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * @file qot_sim_chrony.cpp
+ * @brief Simulation driver for the chrony source statistics on a QoT timeline
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+
+#include <cmath>
+#include <cstring>
+
+extern "C"
+{
+	#include "../../qot_types.h"
+	#include "../../micro-services/sync-service/sync/ptp/qot_tlclockops.h"
+	#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/sourcestats.h"
+	#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/logging.h"
+	#include <sys/timex.h>
+}
+
+#include "../../micro-services/sync-service/sync/SyncUncertainty.hpp"
+
+using namespace qot;
+
+// Server processing time between receive and transmit
+#define SIM_NTP_PROCESSING_NS 20000
+
+// Register size of the source statistics (chrony defaults)
+#define SIM_NTP_MIN_SAMPLES 6
+#define SIM_NTP_MAX_SAMPLES 64
+
+// Dispersion of a sample (server precision and reading error)
+#define SIM_NTP_DISPERSION 1.0e-6
+
+/* State of the simulated client */
+struct sim_ntp_client {
+	Simulator *sim;
+	SimOscillator *server;
+	SimNetwork *network;
+	SST_Stats stats;
+	tl_translation_t params;		// Timeline parameters disciplined by the client
+	double dialed_ppb;				// Frequency correction of the timeline
+	SyncUncertainty uncertainty;
+	bool bounds_ready;
+	std::vector<sim_sample> *samples;
+};
+
+static int64_t client_time(sim_ntp_client &client)
+{
+	struct timespec ts;
+	qot_timeline_gettime(&ts, &client.params);
+	return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static struct timespec to_timespec(int64_t ns)
+{
+	struct timespec ts;
+	ts.tv_sec = ns/1000000000LL;
+	ts.tv_nsec = ns%1000000000LL;
+	return ts;
+}
+
+/* Apply the estimate of the source statistics: the frequency error is removed from the
+   timeline rate and the predicted offset stepped out (what reference.c asks of local.c,
+   without the gradual slew) */
+static void client_correct(sim_ntp_client &client, int64_t now)
+{
+	struct timespec ref_time, now_ts = to_timespec(now);
+	double offset, offset_sd, frequency, skew, root_delay, root_dispersion;
+
+	SST_GetTrackingData(client.stats, &ref_time, &offset, &offset_sd, &frequency, &skew, &root_delay, &root_dispersion);
+	double elapsed = (now - (int64_t(ref_time.tv_sec)*1000000000LL + ref_time.tv_nsec))*1e-9;
+	double offset_now = offset + frequency*elapsed;
+
+	// Positive frequency and offset -> local clock gaining and fast
+	struct timex tx;
+	client.dialed_ppb -= frequency*1e9;
+	memset(&tx, 0, sizeof(tx));
+	tx.modes = ADJ_FREQUENCY;
+	tx.freq = (long) (client.dialed_ppb * 65.536);
+	qot_timeline_adjtime(&tx, &client.params);
+
+	int64_t step = -llround(offset_now*1e9);
+	memset(&tx, 0, sizeof(tx));
+	tx.modes = ADJ_SETOFFSET | ADJ_NANO;
+	tx.time.tv_sec = step/1000000000LL;
+	tx.time.tv_usec = step%1000000000LL;
+	if (tx.time.tv_usec < 0)
+	{
+		tx.time.tv_sec -= 1;
+		tx.time.tv_usec += 1000000000;
+	}
+	qot_timeline_adjtime(&tx, &client.params);
+
+	// The stored samples are moved to the new clock regime (doffset > 0 -> clock moved back)
+	SST_SlewSamples(client.stats, &now_ts, frequency, offset_now);
+
+	// Statistic for the uncertainty service (as local.c publishes it for NTP18)
+	if (client.uncertainty.CalculateBounds(int64_t(ceil(offset_now*1e9)), ceil(frequency*1e9)/1000000000LL, -1, &client.params, std::string("sim")))
+		client.bounds_ready = true;
+}
+
+/* Client/server exchange */
+static void ntp_poll(sim_ntp_client &client, int64_t period_ns)
+{
+	Simulator *sim = client.sim;
+	int64_t t1 = client_time(client);
+	int64_t delay;
+
+	if (client.network->Delay(true, delay))
+	{
+		sim->Schedule(sim->Now() + delay, [&client, t1]() {
+			Simulator *sim = client.sim;
+			int64_t t2 = client.server->Read(sim->Now());
+			int64_t t3 = t2 + SIM_NTP_PROCESSING_NS;
+			int64_t delay;
+			if (!client.network->Delay(false, delay))
+				return;
+			sim->Schedule(sim->Now() + SIM_NTP_PROCESSING_NS + delay, [&client, t1, t2, t3]() {
+				int64_t t4 = client_time(client);
+				double round_trip = ((t4 - t1) - (t3 - t2))*1e-9;
+				double offset = -(((t2 - t1) + (t3 - t4))/2)*1e-9;		// chrony sign: positive -> local fast
+				struct timespec sample_time = to_timespec(t1 + (t4 - t1)/2);
+
+				SST_AccumulateSample(client.stats, &sample_time, offset, round_trip, SIM_NTP_DISPERSION, 0.0, 0.0, 1);
+				SST_DoNewRegression(client.stats);
+				if (SST_Samples(client.stats) >= 3)
+					client_correct(client, t4);
+			});
+		});
+	}
+	sim->Schedule(sim->Now() + period_ns, [&client, period_ns]() { ntp_poll(client, period_ns); });
+}
+
+/* Error and bound check against the server */
+static void ntp_check(sim_ntp_client &client, int64_t period_ns)
+{
+	Simulator *sim = client.sim;
+	sim_sample sample;
+	sample.time_ns = sim->Now();
+	sample.error_ns = double(client_time(client) - client.server->Read(sim->Now()));
+	sample.covered = -1;
+	if (client.bounds_ready)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		int64_t core = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+		tl_translation_t params;
+		tl_translation_read(&client.params, &params);
+		int64_t u_bound = (params.u_mult*(core - params.last))/1000000000L + params.u_nsec;
+		int64_t l_bound = (params.l_mult*(core - params.last))/1000000000L + params.l_nsec;
+		sample.covered = (sample.error_ns >= -u_bound && sample.error_ns <= l_bound) ? 1 : 0;
+	}
+	client.samples->push_back(sample);
+	sim->Schedule(sim->Now() + period_ns, [&client, period_ns]() { ntp_check(client, period_ns); });
+}
+
+int qot::sim_run_chrony(const sim_scenario &scenario, std::vector<sim_sample> &samples)
+{
+	Simulator sim(scenario.seed);
+	SimOscillator local(scenario.local, scenario.seed ^ 0x1);
+	SimOscillator server(scenario.remote, scenario.seed ^ 0x2);
+	SimNetwork network(scenario.network, scenario.seed ^ 0x3);
+
+	// The client's free-running clock backs the timeline
+	sim.Attach(CLOCK_REALTIME, &local);
+	sim.Activate();
+	qot_set_phc(CLOCK_REALTIME);
+
+	static bool sst_initialised = false;
+	if (!sst_initialised)
+	{
+		LOG_Initialise();
+		SST_Initialise();
+		sst_initialised = true;
+	}
+
+	sim_ntp_client client;
+	client.sim = &sim;
+	client.server = &server;
+	client.network = &network;
+	client.stats = SST_CreateInstance(0x7f000001, NULL, SIM_NTP_MIN_SAMPLES, SIM_NTP_MAX_SAMPLES, 0.0, 1.0);
+	memset(&client.params, 0, sizeof(client.params));
+	client.dialed_ppb = 0;
+	client.bounds_ready = false;
+	client.samples = &samples;
+
+	int64_t poll_ns = int64_t(scenario.sync_interval_s*1e9);
+	int64_t eval_ns = int64_t(scenario.eval_interval_s*1e9);
+	sim.Schedule(0, [&client, poll_ns]() { ntp_poll(client, poll_ns); });
+	sim.Schedule(eval_ns/2, [&client, eval_ns]() { ntp_check(client, eval_ns); });
+	sim.RunUntil(int64_t(scenario.duration_s*1e9));
+
+	sim.Deactivate();
+	SST_DeleteInstance(client.stats);
+	return 0;
+}
@@ -1,6 +1,6 @@
 /*
- * @file clkparams_circbuffer.hpp
- * @brief Circular Buffer Header for clock parameters
+ * @file qot_sim_chrony_stubs.c
+ * @brief Configuration and local clock hooks needed by the chrony source statistics
  * @author Anon D'Anon
  *
  * Copyright (c) Anon, 2018.
@@ -27,42 +27,30 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef QOT_STACK_CIRC_BUFF_QOT_H
-#define QOT_STACK_CIRC_BUFF_QOT_H
+/* The harness links sourcestats.c and regress.c on their own, these replace the
+   few conf.c and local.c functions they reach (no logging, nanosecond precision) */
 
-#include <mutex>
-#include <vector>
+#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/config.h"
+#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/sysincl.h"
+#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/conf.h"
+#include "../../micro-services/sync-service/sync/ntp/chrony-3.2/local.h"
 
-/* Include basic types, time math and ioctl interface */
-extern "C"
+int CNF_GetLogBanner(void)
 {
-	#include "../../qot_types.h"
+  return 0;
 }
 
-#define CIRBUFF_DEFSIZE 10
-
-namespace qot_coreapi
+char *CNF_GetLogDir(void)
 {
-	class CircularBuffer 
-	{
-		// Constructor & Destructor
-		public: CircularBuffer(int size);
-		public: ~CircularBuffer();
-
-		/* Add element to the circular buffer */
-		public:	int AddElement(tl_translation_t params);
-
-		/* Find the appropriate clock parameters */
-		public: int FindParams(timepoint_t coretime, tl_translation_t &params);
-
-		/* Circular buffer */
-		private: std::vector<tl_translation_t> buffer;
-		private: int insert_point;
-		private: int current_size;
-		private: int buf_size;
-		private: std::mutex buffer_lock;
-	};
+  return NULL;
 }
 
-#endif
+int CNF_GetLogStatistics(void)
+{
+  return 0;
+}
 
+double LCL_GetSysPrecisionAsQuantum(void)
+{
+  return 1.0e-9;
+}
@@ -0,0 +1,125 @@
+/*
+ * @file qot_sim_clock.cpp
+ * @brief Virtual-time replacements for the POSIX clock calls used by the sync code
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+
+#include <cmath>
+
+extern "C"
+{
+	#include <errno.h>
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <sys/timex.h>
+}
+
+using namespace qot;
+
+/* These definitions take precedence over the C library in any binary the harness is
+   linked into. Without an active simulator the calls go straight to the kernel */
+
+static void timespec_from_ns(struct timespec *tp, int64_t ns)
+{
+	tp->tv_sec = ns/1000000000LL;
+	tp->tv_nsec = ns%1000000000LL;
+	if (tp->tv_nsec < 0)
+	{
+		tp->tv_sec -= 1;
+		tp->tv_nsec += 1000000000LL;
+	}
+}
+
+static int64_t timespec_to_ns(const struct timespec *tp)
+{
+	return int64_t(tp->tv_sec)*1000000000LL + tp->tv_nsec;
+}
+
+extern "C" int clock_gettime(clockid_t clkid, struct timespec *tp)
+{
+	Simulator *sim = Simulator::Active();
+	if (!sim)
+		return syscall(SYS_clock_gettime, clkid, tp);
+
+	int64_t now = sim->Now();
+	SimOscillator *oscillator = sim->Lookup(clkid);
+	timespec_from_ns(tp, oscillator ? oscillator->Read(now) : now);
+	return 0;
+}
+
+extern "C" int clock_nanosleep(clockid_t clkid, int flags, const struct timespec *request, struct timespec *remain)
+{
+	Simulator *sim = Simulator::Active();
+	if (!sim)
+	{
+		if (syscall(SYS_clock_nanosleep, clkid, flags, request, remain) < 0)
+			return errno;
+		return 0;
+	}
+
+	// Sleeping runs the simulation up to the wakeup (the oscillator rate is close enough to one to map the deadline)
+	int64_t now = sim->Now();
+	int64_t wakeup = now + timespec_to_ns(request);
+	if (flags & TIMER_ABSTIME)
+	{
+		SimOscillator *oscillator = sim->Lookup(clkid);
+		wakeup = now + timespec_to_ns(request) - (oscillator ? oscillator->Read(now) : now);
+	}
+	sim->RunUntil(wakeup);
+	if (remain)
+		timespec_from_ns(remain, 0);
+	return 0;
+}
+
+extern "C" int clock_adjtime(clockid_t clkid, struct timex *tx)
+{
+	Simulator *sim = Simulator::Active();
+	if (!sim)
+		return syscall(SYS_clock_adjtime, clkid, tx);
+
+	// Only oscillator backed clocks (PHCs) can be disciplined
+	SimOscillator *oscillator = sim->Lookup(clkid);
+	if (!oscillator)
+	{
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	int64_t now = sim->Now();
+	if (tx->modes & ADJ_SETOFFSET)
+	{
+		int64_t delta = int64_t(tx->time.tv_sec)*1000000000LL;
+		delta += (tx->modes & ADJ_NANO) ? tx->time.tv_usec : int64_t(tx->time.tv_usec)*1000;
+		oscillator->Step(now, delta);
+	}
+	if (tx->modes & ADJ_FREQUENCY)
+		oscillator->SetFrequency(now, tx->freq/65.536);
+
+	tx->freq = llround(oscillator->GetFrequency()*65.536);
+	return TIME_OK;
+}
@@ -0,0 +1,237 @@
+/*
+ * @file qot_sim_huygens.cpp
+ * @brief Simulation driver for the Huygens coded-probe and SVM estimator
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+extern "C"
+{
+	#include "../../qot_types.h"
+}
+
+#include "../../micro-services/sync-service/sync/SyncUncertainty.hpp"
+#include "../../micro-services/sync-service/sync/huygens/SVMprocessor.hpp"
+
+using namespace qot;
+
+// Coded probe purity threshold (as in PeerTSclient)
+#define SIM_HUYGENS_EPSILON 50000
+
+// Spacing of the two probes of a pair and the server turnaround
+#define SIM_HUYGENS_PROBE_GAP_NS 10000
+#define SIM_HUYGENS_PROCESSING_NS 10000
+
+// Length of the estimation window
+#define SIM_HUYGENS_WINDOW_S 2.0
+
+/* Timestamps of one coded probe pair */
+struct sim_probe {
+	int64_t tx[2];			// Local transmit
+	int64_t rx_remote[2];	// Remote receive
+	int64_t tx_remote[2];	// Remote transmit of the reply
+	int64_t rx[2];			// Local receive of the reply
+	int received;			// Timestamps of the replies received
+};
+
+/* State of the simulated Huygens client */
+struct sim_huygens_client {
+	Simulator *sim;
+	SimOscillator *local;
+	SimOscillator *remote;
+	SimNetwork *network;
+	std::vector<sim_probe> probes;
+	size_t window_len;			// Probes per estimation window
+	SVMprocessor svm;
+	bool have_estimate;
+	double offset;				// Remote - local at start_time (ns)
+	double drift;				// Rate of the remote - local offset
+	int64_t start_time;			// Local reference of the estimate
+	tl_translation_t params;	// Bounds of the estimate
+	SyncUncertainty uncertainty;
+	bool bounds_ready;
+	std::vector<sim_sample> *samples;
+};
+
+/* Estimated remote - local offset at a local time */
+static double predict(const sim_huygens_client &client, int64_t local_ns)
+{
+	return client.offset + client.drift*double(local_ns - client.start_time);
+}
+
+/* One probe of a pair: remote receive, reply and local receive */
+static void send_probe(sim_huygens_client &client, size_t index, int k)
+{
+	Simulator *sim = client.sim;
+	int64_t delay;
+	client.probes[index].tx[k] = client.local->Read(sim->Now());
+	if (!client.network->Delay(true, delay))
+		return;
+	sim->Schedule(sim->Now() + delay, [&client, index, k]() {
+		Simulator *sim = client.sim;
+		int64_t delay;
+		client.probes[index].rx_remote[k] = client.remote->Read(sim->Now());
+		if (!client.network->Delay(false, delay))
+			return;
+		int64_t reply = sim->Now() + SIM_HUYGENS_PROCESSING_NS;
+		client.probes[index].tx_remote[k] = client.remote->Read(reply);
+		sim->Schedule(reply + delay, [&client, index, k]() {
+			client.probes[index].rx[k] = client.local->Read(client.sim->Now());
+			client.probes[index].received++;
+		});
+	});
+}
+
+/* Estimate over the last window, as the PeerTSclient processing loop does */
+static void huygens_estimate(sim_huygens_client &client)
+{
+	size_t last = client.probes.size();
+	if (last < client.window_len)
+		return;
+
+	std::vector<int64_t> bounds, instant;
+	int64_t start_time = 0;
+	int vec_len = 0;
+	for (size_t i = last - client.window_len; i < last; i++)
+	{
+		const sim_probe &probe = client.probes[i];
+		if (probe.received != 2)
+			continue;
+		if (vec_len == 0)
+			start_time = probe.rx[0];
+		uint64_t delta = (uint64_t) llabs((probe.rx_remote[1] - probe.rx_remote[0]) - (probe.tx[1] - probe.tx[0]));
+		if (delta >= SIM_HUYGENS_EPSILON)
+			continue;
+		bounds.push_back(probe.rx_remote[0] - probe.tx[0]);	// Upper bound
+		bounds.push_back(probe.tx_remote[0] - probe.rx[0]);	// Lower bound
+		instant.push_back(probe.rx[0] - start_time);
+		vec_len++;
+	}
+	if (vec_len == 0 || client.svm.FormulateProblem(bounds, instant, vec_len) < 0)
+		return;
+
+	double offset, drift;
+	if (client.svm.Run(offset, drift) < 0)
+		return;
+
+	// Innovation of the previous estimate feeds the uncertainty model
+	int64_t now = client.local->Read(client.sim->Now());
+	if (client.have_estimate)
+	{
+		double innovation = predict(client, now) - (offset + drift*double(now - start_time));
+		tl_translation_write_begin(&client.params);
+		client.params.last = now;
+		tl_translation_write_end(&client.params);
+		if (client.uncertainty.CalculateBounds(int64_t(ceil(innovation)), drift, -1, &client.params, std::string("sim")))
+			client.bounds_ready = true;
+	}
+	client.offset = offset;
+	client.drift = drift;
+	client.start_time = start_time;
+	client.have_estimate = true;
+}
+
+/* One coded probe pair, and the estimate at the end of each window */
+static void huygens_probe(sim_huygens_client &client, int64_t period_ns)
+{
+	Simulator *sim = client.sim;
+	size_t index = client.probes.size();
+	sim_probe probe;
+	memset(&probe, 0, sizeof(probe));
+	client.probes.push_back(probe);
+
+	send_probe(client, index, 0);
+	sim->Schedule(sim->Now() + SIM_HUYGENS_PROBE_GAP_NS, [&client, index]() { send_probe(client, index, 1); });
+
+	// Replies of the window's last probe arrive within the next period
+	if ((index + 1) % client.window_len == 0)
+		sim->Schedule(sim->Now() + period_ns - 1, [&client]() { huygens_estimate(client); });
+	sim->Schedule(sim->Now() + period_ns, [&client, period_ns]() { huygens_probe(client, period_ns); });
+}
+
+/* Error and bound check of the estimated remote time */
+static void huygens_check(sim_huygens_client &client, int64_t period_ns)
+{
+	Simulator *sim = client.sim;
+	if (client.have_estimate)
+	{
+		int64_t core = client.local->Read(sim->Now());
+		sim_sample sample;
+		sample.time_ns = sim->Now();
+		sample.error_ns = double(core) + predict(client, core) - double(client.remote->Read(sim->Now()));
+		sample.covered = -1;
+		if (client.bounds_ready)
+		{
+			tl_translation_t params;
+			tl_translation_read(&client.params, &params);
+			int64_t u_bound = (params.u_mult*(core - params.last))/1000000000L + params.u_nsec;
+			int64_t l_bound = (params.l_mult*(core - params.last))/1000000000L + params.l_nsec;
+			sample.covered = (sample.error_ns >= -u_bound && sample.error_ns <= l_bound) ? 1 : 0;
+		}
+		client.samples->push_back(sample);
+	}
+	sim->Schedule(sim->Now() + period_ns, [&client, period_ns]() { huygens_check(client, period_ns); });
+}
+
+int qot::sim_run_huygens(const sim_scenario &scenario, std::vector<sim_sample> &samples)
+{
+	Simulator sim(scenario.seed);
+	SimOscillator local(scenario.local, scenario.seed ^ 0x1);
+	SimOscillator remote(scenario.remote, scenario.seed ^ 0x2);
+	SimNetwork network(scenario.network, scenario.seed ^ 0x3);
+
+	sim_huygens_client client;
+	client.sim = &sim;
+	client.local = &local;
+	client.remote = &remote;
+	client.network = &network;
+	client.window_len = size_t(ceil(SIM_HUYGENS_WINDOW_S/scenario.sync_interval_s));
+	if (client.window_len < 2)
+		client.window_len = 2;
+	client.probes.reserve(size_t(scenario.duration_s/scenario.sync_interval_s) + 1);
+	client.have_estimate = false;
+	client.offset = 0;
+	client.drift = 0;
+	client.start_time = 0;
+	memset(&client.params, 0, sizeof(client.params));
+	client.bounds_ready = false;
+	client.samples = &samples;
+
+	// The estimator does not discipline a clock, no time calls are interposed
+	sim.Activate();
+	int64_t probe_ns = int64_t(scenario.sync_interval_s*1e9);
+	int64_t eval_ns = int64_t(scenario.eval_interval_s*1e9);
+	sim.Schedule(0, [&client, probe_ns]() { huygens_probe(client, probe_ns); });
+	sim.Schedule(eval_ns/2, [&client, eval_ns]() { huygens_check(client, eval_ns); });
+	sim.RunUntil(int64_t(scenario.duration_s*1e9));
+	sim.Deactivate();
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * @file qot_sim_main.cpp
+ * @brief Runner for the sync algorithm simulation scenarios
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace qot;
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [algorithm|all] [scenarios] [first seed] [duration_s] [phc] [fault script]\n", name);
+	printf("Algorithms:");
+	for (int i = 0; i < SIM_NUM_ALGORITHMS; i++)
+		printf(" %s", sim_algorithm_name(sim_algorithm(i)));
+	printf("\n");
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return -1;
+	std::sort(values.begin(), values.end());
+	size_t index = size_t(ceil(p*values.size()));
+	if (index > 0)
+		index--;
+	return values[std::min(index, values.size() - 1)];
+}
+
+/* Run the scenarios of one algorithm, one CSV line each and a summary line */
+static int run_algorithm(sim_algorithm algorithm, int scenarios, uint64_t first_seed, double duration_s, bool phc, const std::string &faults)
+{
+	std::vector<double> convergence, rms, coverage, recovery, fault_coverage;
+	int unrecovered = 0;
+	int unconverged = 0;
+	for (int i = 0; i < scenarios; i++)
+	{
+		sim_scenario scenario = sim_random_scenario(algorithm, first_seed + i, duration_s);
+		scenario.discipline_phc = phc && (algorithm == SIM_PTP_PI || algorithm == SIM_PTP_LINREG);
+		scenario.faults = faults;
+		sim_metrics metrics;
+		if (sim_run(scenario, metrics) < 0)
+		{
+			printf("%s,%llu,failed\n", sim_algorithm_name(algorithm), (unsigned long long) scenario.seed);
+			continue;
+		}
+		printf("%s,%llu,%.3f,%.1f,%.1f,%.4f,%d", sim_algorithm_name(algorithm), (unsigned long long) scenario.seed,
+			metrics.convergence_s, metrics.rms_error_ns, metrics.max_error_ns, metrics.coverage, metrics.checks);
+		if (!faults.empty())
+		{
+			printf(",%.3f,%.4f", metrics.recovery_s, metrics.fault_coverage);
+			if (metrics.recovery_s < 0)
+				unrecovered++;
+			else
+				recovery.push_back(metrics.recovery_s);
+			if (metrics.fault_coverage >= 0)
+				fault_coverage.push_back(metrics.fault_coverage);
+		}
+		printf("\n");
+		if (metrics.convergence_s < 0)
+			unconverged++;
+		else
+			convergence.push_back(metrics.convergence_s);
+		rms.push_back(metrics.rms_error_ns);
+		if (metrics.coverage >= 0)
+			coverage.push_back(metrics.coverage);
+	}
+
+	double mean_coverage = -1;
+	if (!coverage.empty())
+	{
+		mean_coverage = 0;
+		for (size_t i = 0; i < coverage.size(); i++)
+			mean_coverage += coverage[i];
+		mean_coverage /= coverage.size();
+	}
+	printf("# %s: %d scenarios, %d not converged, convergence median %.3f s p95 %.3f s, rms median %.1f ns p95 %.1f ns, coverage mean %.4f min %.4f\n",
+		sim_algorithm_name(algorithm), scenarios, unconverged, percentile(convergence, 0.5), percentile(convergence, 0.95),
+		percentile(rms, 0.5), percentile(rms, 0.95), mean_coverage, percentile(coverage, 0.0));
+	if (!faults.empty())
+		printf("# %s under faults: %d not recovered, recovery median %.3f s p95 %.3f s, coverage min %.4f\n",
+			sim_algorithm_name(algorithm), unrecovered, percentile(recovery, 0.5), percentile(recovery, 0.95),
+			percentile(fault_coverage, 0.0));
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int first = 0, last = SIM_NUM_ALGORITHMS - 1;
+	int scenarios = 10;
+	uint64_t first_seed = 1;
+	double duration_s = 0;
+	bool phc = false;
+
+	if (argc > 1 && strcmp(argv[1], "all") != 0)
+	{
+		first = -1;
+		for (int i = 0; i < SIM_NUM_ALGORITHMS; i++)
+		{
+			if (strcmp(argv[1], sim_algorithm_name(sim_algorithm(i))) == 0)
+				first = last = i;
+		}
+		if (first < 0)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (argc > 2)
+		scenarios = atoi(argv[2]);
+	if (argc > 3)
+		first_seed = strtoull(argv[3], NULL, 10);
+	if (argc > 4)
+		duration_s = atof(argv[4]);
+	if (argc > 5)
+		phc = (strcmp(argv[5], "phc") == 0);
+	std::string faults;
+	if (argc > 6)
+	{
+		std::ifstream file(argv[6]);
+		std::stringstream script;
+		script << file.rdbuf();
+		faults = script.str();
+		if (!file || faults.empty())
+		{
+			printf("Cannot read the fault script %s\n", argv[6]);
+			return 1;
+		}
+	}
+	if (scenarios <= 0 || duration_s < 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("algorithm,seed,convergence_s,rms_ns,max_ns,coverage,checks%s\n", faults.empty() ? "" : ",recovery_s,fault_coverage");
+	for (int i = first; i <= last; i++)
+		run_algorithm(sim_algorithm(i), scenarios, first_seed, duration_s, phc, faults);
+	return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * @file qot_sim_ptp.cpp
+ * @brief Simulation driver for the linuxptp servos on a QoT timeline
+ * @author Anon D'Anon
+ *
+ * Copyright (c) Anon, 2018.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qot_sim.hpp"
+
+#include <cmath>
+#include <cstring>
+
+extern "C"
+{
+	#include "../../qot_types.h"
+	#include "../../micro-services/sync-service/sync/ptp/qot_tlclockops.h"
+	#include "../../micro-services/sync-service/sync/ptp/linuxptp-1.8/config.h"
+	#include "../../micro-services/sync-service/sync/ptp/linuxptp-1.8/servo.h"
+	#include "../../micro-services/sync-service/sync/ptp/linuxptp-1.8/tsproc.h"
+	#include "../../micro-services/sync-service/sync/ptp/linuxptp-1.8/clockadj.h"
+	#include "../../micro-services/sync-service/sync/ptp/linuxptp-1.8/print.h"
+	#include <sys/timex.h>
+}
+
+#include "../../micro-services/sync-service/sync/SyncUncertainty.hpp"
+
+using namespace qot;
+
+// Clock id of the simulated PHC (as returned for /dev/ptp3), the negative fd is scaled by 8 rather than shifted
+#define SIM_PHC_CLKID ((~(clockid_t) 3) * 8 | 3)
+
+// Largest frequency correction of the servo (ppb)
+#define SIM_PTP_MAX_PPB 512000
+
+// Length of the path delay filter (ptp4l default)
+#define SIM_PTP_DELAY_FILTER_LEN 10
+
+/* State of the simulated slave */
+struct sim_ptp_slave {
+	Simulator *sim;
+	SimOscillator *master;
+	SimNetwork *network;
+	const sim_scenario *scenario;
+	struct servo *servo;
+	struct tsproc *tsp;
+	tl_translation_t params;		// Timeline parameters disciplined by the servo (timeline mode)
+	SyncUncertainty uncertainty;
+	bool bounds_ready;
+	std::vector<sim_sample> *samples;
+};
+
+/* Disciplined time of the slave: the timeline in timeline mode, the PHC otherwise */
+static int64_t slave_time(sim_ptp_slave &slave)
+{
+	struct timespec ts;
+	if (slave.scenario->discipline_phc)
+		clock_gettime(SIM_PHC_CLKID, &ts);
+	else
+		qot_timeline_gettime(&ts, &slave.params);
+	return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+/* Same conversions as clock_timeline_set_freq and clock_timeline_step in clock.c */
+static void slave_set_freq(sim_ptp_slave &slave, double freq)
+{
+	if (slave.scenario->discipline_phc)
+	{
+		clockadj_set_freq(SIM_PHC_CLKID, freq);
+		return;
+	}
+	struct timex tx;
+	memset(&tx, 0, sizeof(tx));
+	tx.modes |= ADJ_FREQUENCY;
+	tx.freq = (long) (freq * 65.536);
+	qot_timeline_adjtime(&tx, &slave.params);
+}
+
+static void slave_step(sim_ptp_slave &slave, int64_t step)
+{
+	if (slave.scenario->discipline_phc)
+	{
+		clockadj_step(SIM_PHC_CLKID, step);
+		return;
+	}
+	struct timex tx;
+	int sign = 1;
+	if (step < 0)
+	{
+		sign = -1;
+		step *= -1;
+	}
+	memset(&tx, 0, sizeof(tx));
+	tx.modes = ADJ_SETOFFSET | ADJ_NANO;
+	tx.time.tv_sec  = sign * (step / 1000000000LL);
+	tx.time.tv_usec = sign * (step % 1000000000LL);
+	if (tx.time.tv_usec < 0)
+	{
+		tx.time.tv_sec  -= 1;
+		tx.time.tv_usec += 1000000000;
+	}
+	qot_timeline_adjtime(&tx, &slave.params);
+}
+
+/* Sync message received: same sequence as clock_synchronize in clock.c */
+static void slave_synchronize(sim_ptp_slave &slave, int64_t origin, int64_t ingress)
+{
+	tmv_t offset;
+	double weight;
+	enum servo_state state;
+
+	tsproc_down_ts(slave.tsp, origin, ingress);
+	if (tsproc_update_offset(slave.tsp, &offset, &weight))
+		return;
+
+	double adj = servo_sample(slave.servo, offset, ingress, weight, &state);
+	switch (state)
+	{
+		case SERVO_UNLOCKED:
+			return;
+		case SERVO_JUMP:
+			slave_set_freq(slave, -adj);
+			slave_step(slave, -offset);
+			tsproc_reset(slave.tsp, 0);
+			break;
+		case SERVO_LOCKED:
+			slave_set_freq(slave, -adj);
+			break;
+	}
+
+	// Bounds are relative to the last correction, as in timeline mode
+	if (slave.scenario->discipline_phc)
+	{
+		struct timespec ts;
+		clock_gettime(SIM_PHC_CLKID, &ts);
+		tl_translation_write_begin(&slave.params);
+		slave.params.last = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+		tl_translation_write_end(&slave.params);
+	}
+
+	// Statistic for the uncertainty service (as PTP18 does with the clock sync data point)
+	if (slave.uncertainty.CalculateBounds(offset, ceil(adj)/1000000000LL, -1, &slave.params, std::string("sim")))
+		slave.bounds_ready = true;
+}
+
+/* One sync interval: Sync from the master, then a Delay_Req from the slave */
+static void ptp_exchange(sim_ptp_slave &slave, int64_t period_ns)
+{
+	Simulator *sim = slave.sim;
+	int64_t t1 = slave.master->Read(sim->Now());
+	int64_t delay;
+
+	if (slave.network->Delay(true, delay))
+	{
+		sim->Schedule(sim->Now() + delay, [&slave, t1, period_ns]() {
+			slave_synchronize(slave, t1, slave_time(slave));
+
+			// Delay request at a random point of the interval
+			Simulator *sim = slave.sim;
+			int64_t turnaround = int64_t(period_ns*0.5*sim->Random().Uniform());
+			sim->Schedule(sim->Now() + turnaround, [&slave]() {
+				Simulator *sim = slave.sim;
+				int64_t t3 = slave_time(slave);
+				int64_t delay;
+				if (!slave.network->Delay(false, delay))
+					return;
+				sim->Schedule(sim->Now() + delay, [&slave, t3]() {
+					tmv_t path_delay;
+					tsproc_up_ts(slave.tsp, t3, slave.master->Read(slave.sim->Now()));
+					tsproc_update_delay(slave.tsp, &path_delay);
+				});
+			});
+		});
+	}
+	sim->Schedule(sim->Now() + period_ns, [&slave, period_ns]() { ptp_exchange(slave, period_ns); });
+}
+
+/* Error and bound check against the master */
+static void ptp_check(sim_ptp_slave &slave, int64_t period_ns)
+{
+	Simulator *sim = slave.sim;
+	sim_sample sample;
+	sample.time_ns = sim->Now();
+	int64_t now = slave_time(slave);
+	sample.error_ns = double(now - slave.master->Read(sim->Now()));
+	sample.covered = -1;
+	if (slave.bounds_ready)
+	{
+		struct timespec ts;
+		clock_gettime(slave.scenario->discipline_phc ? SIM_PHC_CLKID : CLOCK_REALTIME, &ts);
+		int64_t core = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+		tl_translation_t params;
+		tl_translation_read(&slave.params, &params);
+		int64_t u_bound = (params.u_mult*(core - params.last))/1000000000L + params.u_nsec;
+		int64_t l_bound = (params.l_mult*(core - params.last))/1000000000L + params.l_nsec;
+		sample.covered = (sample.error_ns >= -u_bound && sample.error_ns <= l_bound) ? 1 : 0;
+	}
+	slave.samples->push_back(sample);
+	sim->Schedule(sim->Now() + period_ns, [&slave, period_ns]() { ptp_check(slave, period_ns); });
+}
+
+int qot::sim_run_ptp(const sim_scenario &scenario, std::vector<sim_sample> &samples)
+{
+	Simulator sim(scenario.seed);
+	SimOscillator local(scenario.local, scenario.seed ^ 0x1);
+	SimOscillator master(scenario.remote, scenario.seed ^ 0x2);
+	SimNetwork network(scenario.network, scenario.seed ^ 0x3);
+
+	// The slave's free-running clock backs the timeline (CLOCK_REALTIME) or is the PHC itself
+	sim.Attach(scenario.discipline_phc ? SIM_PHC_CLKID : CLOCK_REALTIME, &local);
+	sim.Activate();
+	qot_set_phc(CLOCK_REALTIME);
+
+	print_set_verbose(0);
+	print_set_syslog(0);
+	struct config *cfg = config_create();
+	if (!cfg)
+		return -1;
+
+	sim_ptp_slave slave;
+	slave.sim = &sim;
+	slave.master = &master;
+	slave.network = &network;
+	slave.scenario = &scenario;
+	slave.servo = servo_create(cfg, scenario.algorithm == SIM_PTP_LINREG ? CLOCK_SERVO_LINREG : CLOCK_SERVO_PI, 0, SIM_PTP_MAX_PPB, 0);
+	slave.tsp = tsproc_create(TSPROC_FILTER, FILTER_MOVING_MEDIAN, SIM_PTP_DELAY_FILTER_LEN);
+	memset(&slave.params, 0, sizeof(slave.params));
+	slave.bounds_ready = false;
+	slave.samples = &samples;
+	if (!slave.servo || !slave.tsp)
+	{
+		if (slave.servo)
+			servo_destroy(slave.servo);
+		if (slave.tsp)
+			tsproc_destroy(slave.tsp);
+		config_destroy(cfg);
+		return -1;
+	}
+	servo_sync_interval(slave.servo, scenario.sync_interval_s);
+
+	int64_t sync_ns = int64_t(scenario.sync_interval_s*1e9);
+	int64_t eval_ns = int64_t(scenario.eval_interval_s*1e9);
+	sim.Schedule(0, [&slave, sync_ns]() { ptp_exchange(slave, sync_ns); });
+	sim.Schedule(eval_ns/2, [&slave, eval_ns]() { ptp_check(slave, eval_ns); });
+	sim.RunUntil(int64_t(scenario.duration_s*1e9));
+
+	sim.Deactivate();
+	tsproc_destroy(slave.tsp);
+	servo_destroy(slave.servo);
+	config_destroy(cfg);
+	return 0;
+}
@@ -0,0 +1,199 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <time.h>
+}
+
+#include "../api/cpp/qot_coreapi_async.hpp"
+#include "bench/qot_bench.hpp"
+
+using namespace qot_coreapi;
+
+// Built twice: as C++11 for the futures and the handlers, as C++20 for the awaitables as well
+class AsyncBinding : public ::testing::Test {
+    protected: void SetUp() {
+        if (service.Start() < 0)
+            GTEST_SKIP() << "a timeline service is already running";
+        Publish();
+        TL_FROM_nSEC(res, 1);
+        TL_FROM_uSEC(acc.above, 10);
+        TL_FROM_uSEC(acc.below, 10);
+    }
+    protected: void TearDown() {
+        service.Stop();
+    }
+
+    // Timeline running 10 ppm fast, 1 ms ahead of the core clock
+    protected: void Publish() {
+        struct timespec ts;
+        tl_translation_t params, ov_params;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        memset(&params, 0, sizeof(params));
+        memset(&ov_params, 0, sizeof(ov_params));
+        params.last = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+        params.mult = 10000;
+        params.nsec = params.last + 1000000;
+        params.u_nsec = 500;
+        params.l_nsec = 500;
+        service.SetParams(params, ov_params);
+    }
+
+    // Timeline time a given number of nanoseconds from now
+    protected: utimepoint_t From(TimelineAsyncBinding &timeline, int64_t ns) {
+        utimepoint_t utp;
+        timeline.binding()->timeline_gettime(utp);
+        // The conversion macros end in a semicolon, so they only stand in statements
+        int64_t now_ns = TP_TO_nSEC(utp.estimate);
+        TP_FROM_nSEC(utp.estimate, now_ns + ns);
+        return utp;
+    }
+
+    protected: qot_bench::TimelineServiceStandin service;
+    protected: timelength_t res;
+    protected: timeinterval_t acc;
+};
+
+TEST_F(AsyncBinding, ControlFutures) {
+    TimelineAsyncBinding timeline(1);
+    std::future<qot_return_t> bound = timeline.timeline_bind("async_test", "app", res, acc);
+    TL_FROM_uSEC(acc.above, 20);
+    std::future<qot_return_t> accuracy = timeline.timeline_set_accuracy(acc);
+    std::future<qot_return_t> resolution = timeline.timeline_set_resolution(res);
+    std::future<qot_return_t> unbound = timeline.timeline_unbind();
+
+    // Requests run in the order they were made
+    EXPECT_EQ(bound.get(), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(accuracy.get(), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(resolution.get(), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(unbound.get(), QOT_RETURN_TYPE_OK);
+}
+
+TEST_F(AsyncBinding, WaitsCompleteInDeadlineOrder) {
+    TimelineAsyncBinding timeline(1);
+    ASSERT_EQ(timeline.timeline_bind("async_test", "app", res, acc).get(), QOT_RETURN_TYPE_OK);
+
+    std::mutex order_lock;
+    std::vector<int> order;
+    std::vector<std::promise<void> > done(3);
+    int64_t offsets[3] = {30000000, 10000000, 20000000};
+    for (int i = 0; i < 3; i++) {
+        utimepoint_t target = From(timeline, offsets[i]);
+        int64_t target_ns = TP_TO_nSEC(target.estimate);
+        ASSERT_EQ(timeline.timeline_waituntil(target, [&, i, target_ns](qot_return_t retval, utimepoint_t reached) {
+            int64_t reached_ns = TP_TO_nSEC(reached.estimate);
+            EXPECT_EQ(retval, QOT_RETURN_TYPE_OK);
+            EXPECT_GE(reached_ns, target_ns);
+            std::lock_guard<std::mutex> lock(order_lock);
+            order.push_back(i);
+            done[i].set_value();
+        }), QOT_RETURN_TYPE_OK);
+    }
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQ(done[i].get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(order, std::vector<int>({1, 2, 0}));
+
+    EXPECT_EQ(timeline.timeline_unbind().get(), QOT_RETURN_TYPE_OK);
+}
+
+TEST_F(AsyncBinding, UnbindFailsPendingWaits) {
+    TimelineAsyncBinding timeline(1);
+    ASSERT_EQ(timeline.timeline_bind("async_test", "app", res, acc).get(), QOT_RETURN_TYPE_OK);
+
+    std::atomic<int> failed(0);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(timeline.timeline_waituntil(From(timeline, 60*1000000000LL), [&](qot_return_t retval, utimepoint_t) {
+            if (retval != QOT_RETURN_TYPE_OK)
+                failed++;
+        }), QOT_RETURN_TYPE_OK);
+    }
+
+    // The waits are failed before the unbind completes, later waits are refused
+    EXPECT_EQ(timeline.timeline_unbind().get(), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(failed.load(), 4);
+    utimelength_t utl;
+    memset(&utl, 0, sizeof(utl));
+    TL_FROM_mSEC(utl.estimate, 1);
+    EXPECT_EQ(timeline.timeline_sleep(utl, [](qot_return_t, utimepoint_t) {}), QOT_RETURN_TYPE_ERR);
+}
+
+TEST_F(AsyncBinding, ConnectsOffTheLoop) {
+    // A binding still waiting for the timeline service does not hold up the loop
+    service.Stop();
+    std::shared_ptr<TimelineAsyncLoop> loop = std::make_shared<TimelineAsyncLoop>();
+    TimelineAsyncBinding timeline(loop, 1);
+    std::future<qot_return_t> bound = timeline.timeline_bind("async_test", "app", res, acc);
+
+    std::promise<void> ran;
+    loop->post([&ran]() { ran.set_value(); });
+    EXPECT_EQ(ran.get_future().wait_for(std::chrono::milliseconds(500)), std::future_status::ready);
+    EXPECT_EQ(bound.wait_for(std::chrono::milliseconds(0)), std::future_status::timeout);
+
+    // The bind held back until the connection is up then runs
+    ASSERT_EQ(service.Start(), 0);
+    Publish();
+    EXPECT_EQ(bound.get(), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(timeline.timeline_unbind().get(), QOT_RETURN_TYPE_OK);
+}
+
+#ifdef QOT_ASYNC_COROUTINES
+// Coroutine reporting its result through a future
+struct AsyncTask {
+    struct promise_type {
+        std::promise<qot_wait_result_t> result;
+        AsyncTask get_return_object() { return AsyncTask{result.get_future()}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_value(qot_wait_result_t value) { result.set_value(value); }
+        void unhandled_exception() { result.set_exception(std::current_exception()); }
+    };
+    std::future<qot_wait_result_t> result;
+};
+
+static AsyncTask sleep_then_wait(TimelineAsyncBinding &timeline, utimelength_t utl, utimepoint_t target)
+{
+    qot_wait_result_t slept = co_await timeline.timeline_sleep(utl);
+    if (slept.retval != QOT_RETURN_TYPE_OK)
+        co_return slept;
+    co_return co_await timeline.timeline_waituntil(target);
+}
+
+static AsyncTask wait_until(TimelineAsyncBinding &timeline, utimepoint_t target)
+{
+    co_return co_await timeline.timeline_waituntil(target);
+}
+
+TEST_F(AsyncBinding, Awaitables) {
+    TimelineAsyncBinding timeline(1);
+    ASSERT_EQ(timeline.timeline_bind("async_test", "app", res, acc).get(), QOT_RETURN_TYPE_OK);
+
+    utimelength_t utl;
+    memset(&utl, 0, sizeof(utl));
+    TL_FROM_mSEC(utl.estimate, 10);
+    utimepoint_t target = From(timeline, 30000000);
+    AsyncTask task = sleep_then_wait(timeline, utl, target);
+    ASSERT_EQ(task.result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    qot_wait_result_t result = task.result.get();
+    int64_t reached_ns = TP_TO_nSEC(result.utp.estimate);
+    int64_t target_ns = TP_TO_nSEC(target.estimate);
+    EXPECT_EQ(result.retval, QOT_RETURN_TYPE_OK);
+    EXPECT_GE(reached_ns, target_ns);
+
+    // A wait far out resumes with the error of the unbind
+    AsyncTask pending = wait_until(timeline, From(timeline, 60*1000000000LL));
+    EXPECT_EQ(timeline.timeline_unbind().get(), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(pending.result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(pending.result.get().retval, QOT_RETURN_TYPE_ERR);
+
+    // A refused wait resumes right away without suspending
+    AsyncTask refused = wait_until(timeline, target);
+    ASSERT_EQ(refused.result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(refused.result.get().retval, QOT_RETURN_TYPE_ERR);
+}
+#endif
@@ -0,0 +1,193 @@
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/sync-service/qot_clkparams_serialize.hpp"
+
+static clkparams_msg ClkParams() {
+    clkparams_msg msg;
+    memset(&msg.params, 0, sizeof(msg.params));
+    msg.params.last = 1530000000123456789LL;
+    msg.params.mult = -1234;
+    msg.params.nsec = 1530000000123000000LL;
+    msg.params.u_nsec = 1500;
+    msg.params.l_nsec = 1400;
+    msg.params.u_mult = 25;
+    msg.params.l_mult = -25;
+    msg.seq = 42;
+    msg.desired_accuracy = 1000000;
+    msg.timeline_uuid = "gl_test";
+    msg.node_uuid = "node1";
+    return msg;
+}
+
+static peer_params_msg PeerParams() {
+    peer_params_msg msg;
+    msg.client = "node1";
+    msg.server = "node2";
+    msg.offset = -1234.5;
+    msg.drift = 2.5e-6;
+    msg.start_time = 1530000000.25;
+    return msg;
+}
+
+static std::vector<peer_offset_msg> PeerOffsets() {
+    std::vector<peer_offset_msg> offsets(2);
+    offsets[0].node = "node1";
+    offsets[0].offset = 0;
+    offsets[0].final_time = 1530000001.5;
+    offsets[1].node = "node2";
+    offsets[1].offset = -0.000125;
+    offsets[1].final_time = 1530000001.499875;
+    return offsets;
+}
+
+static void ExpectClkParamsEq(const clkparams_msg &a, const clkparams_msg &b) {
+    EXPECT_EQ(a.params.last, b.params.last);
+    EXPECT_EQ(a.params.mult, b.params.mult);
+    EXPECT_EQ(a.params.nsec, b.params.nsec);
+    EXPECT_EQ(a.params.u_nsec, b.params.u_nsec);
+    EXPECT_EQ(a.params.l_nsec, b.params.l_nsec);
+    EXPECT_EQ(a.params.u_mult, b.params.u_mult);
+    EXPECT_EQ(a.params.l_mult, b.params.l_mult);
+    EXPECT_EQ(a.seq, b.seq);
+    EXPECT_EQ(a.desired_accuracy, b.desired_accuracy);
+    EXPECT_EQ(a.timeline_uuid, b.timeline_uuid);
+    EXPECT_EQ(a.node_uuid, b.node_uuid);
+}
+
+class ClkParamsCodec : public ::testing::TestWithParam<qot_params_encoding_t> {};
+
+TEST_P(ClkParamsCodec, ClkParamsRoundTrip) {
+    clkparams_msg in = ClkParams(), out;
+    std::string data = encode_clkparams_msg(in, GetParam());
+    EXPECT_EQ(data[0] == '{', GetParam() == QOT_PARAMS_ENC_JSON);
+    ASSERT_EQ(decode_clkparams_msg(data, out), 0);
+    ExpectClkParamsEq(in, out);
+}
+
+TEST_P(ClkParamsCodec, PeerParamsRoundTrip) {
+    peer_params_msg in = PeerParams(), out;
+    std::string data = encode_peer_params(in, GetParam());
+    ASSERT_EQ(decode_peer_params(data, out), 0);
+    EXPECT_EQ(in.client, out.client);
+    EXPECT_EQ(in.server, out.server);
+    EXPECT_DOUBLE_EQ(in.offset, out.offset);
+    EXPECT_DOUBLE_EQ(in.drift, out.drift);
+    EXPECT_DOUBLE_EQ(in.start_time, out.start_time);
+}
+
+TEST_P(ClkParamsCodec, PeerOffsetsRoundTrip) {
+    std::vector<peer_offset_msg> in = PeerOffsets(), out;
+    std::string data = encode_peer_offsets(in, GetParam());
+    ASSERT_EQ(decode_peer_offsets(data, out), 0);
+    ASSERT_EQ(out.size(), in.size());
+    // JSON objects come back ordered by node name, as the input is
+    for (size_t i = 0; i < in.size(); i++) {
+        EXPECT_EQ(in[i].node, out[i].node);
+        EXPECT_DOUBLE_EQ(in[i].offset, out[i].offset);
+        EXPECT_DOUBLE_EQ(in[i].final_time, out[i].final_time);
+    }
+
+    std::vector<peer_offset_msg> none;
+    ASSERT_EQ(decode_peer_offsets(encode_peer_offsets(none, GetParam()), out), 0);
+    EXPECT_TRUE(out.empty());
+}
+
+INSTANTIATE_TEST_CASE_P(Encodings, ClkParamsCodec,
+    ::testing::Values(QOT_PARAMS_ENC_JSON, QOT_PARAMS_ENC_BINARY));
+
+TEST(ClkParamsBinary, LongNamesFallBackToJson) {
+    clkparams_msg in = ClkParams(), out;
+    in.node_uuid = std::string(QOT_MAX_NAMELEN, 'n');
+    std::string data = encode_clkparams_msg(in, QOT_PARAMS_ENC_BINARY);
+    EXPECT_EQ(data[0], '{');
+    ASSERT_EQ(decode_clkparams_msg(data, out), 0);
+    ExpectClkParamsEq(in, out);
+}
+
+TEST(ClkParamsBinary, RejectsVersion) {
+    clkparams_msg msg;
+    peer_params_msg peer;
+    std::vector<peer_offset_msg> offsets;
+
+    std::string data = encode_clkparams_msg(ClkParams(), QOT_PARAMS_ENC_BINARY);
+    data[0] = (char)(QOT_PARAMS_WIRE_VERSION + 1);
+    EXPECT_EQ(decode_clkparams_msg(data, msg), -1);
+
+    data = encode_peer_params(PeerParams(), QOT_PARAMS_ENC_BINARY);
+    data[0] = (char)(QOT_PARAMS_WIRE_VERSION + 1);
+    EXPECT_EQ(decode_peer_params(data, peer), -1);
+
+    data = encode_peer_offsets(PeerOffsets(), QOT_PARAMS_ENC_BINARY);
+    data[0] = (char)(QOT_PARAMS_WIRE_VERSION + 1);
+    EXPECT_EQ(decode_peer_offsets(data, offsets), -1);
+}
+
+TEST(ClkParamsBinary, RejectsType) {
+    clkparams_msg msg;
+    peer_params_msg peer;
+    std::vector<peer_offset_msg> offsets;
+
+    // Each decoder refuses the records of the other message types
+    std::string clk = encode_clkparams_msg(ClkParams(), QOT_PARAMS_ENC_BINARY);
+    std::string prm = encode_peer_params(PeerParams(), QOT_PARAMS_ENC_BINARY);
+    std::string off = encode_peer_offsets(PeerOffsets(), QOT_PARAMS_ENC_BINARY);
+    EXPECT_EQ(decode_clkparams_msg(prm, msg), -1);
+    EXPECT_EQ(decode_clkparams_msg(off, msg), -1);
+    EXPECT_EQ(decode_peer_params(clk, peer), -1);
+    EXPECT_EQ(decode_peer_params(off, peer), -1);
+    EXPECT_EQ(decode_peer_offsets(clk, offsets), -1);
+    EXPECT_EQ(decode_peer_offsets(prm, offsets), -1);
+
+    clk[1] = 0x7f;
+    EXPECT_EQ(decode_clkparams_msg(clk, msg), -1);
+}
+
+TEST(ClkParamsBinary, RejectsTruncated) {
+    clkparams_msg msg;
+    peer_params_msg peer;
+    std::vector<peer_offset_msg> offsets;
+
+    std::string clk = encode_clkparams_msg(ClkParams(), QOT_PARAMS_ENC_BINARY);
+    std::string prm = encode_peer_params(PeerParams(), QOT_PARAMS_ENC_BINARY);
+    std::string off = encode_peer_offsets(PeerOffsets(), QOT_PARAMS_ENC_BINARY);
+    for (size_t len = 0; len < clk.size(); len++)
+        EXPECT_EQ(decode_clkparams_msg(clk.substr(0, len), msg), -1) << "length " << len;
+    for (size_t len = 0; len < prm.size(); len++)
+        EXPECT_EQ(decode_peer_params(prm.substr(0, len), peer), -1) << "length " << len;
+    for (size_t len = 0; len < off.size(); len++)
+        EXPECT_EQ(decode_peer_offsets(off.substr(0, len), offsets), -1) << "length " << len;
+
+    // A count beyond the records present
+    off[4] = 3;
+    EXPECT_EQ(decode_peer_offsets(off, offsets), -1);
+    EXPECT_TRUE(offsets.empty());
+}
+
+TEST(ClkParamsJson, RejectsMalformed) {
+    clkparams_msg msg;
+    peer_params_msg peer;
+    std::vector<peer_offset_msg> offsets;
+    EXPECT_EQ(decode_clkparams_msg("", msg), -1);
+    EXPECT_EQ(decode_clkparams_msg("{\"last\":1", msg), -1);
+    EXPECT_EQ(decode_peer_params("{\"client\":\"node1\"}", peer), -1);
+    EXPECT_EQ(decode_peer_offsets("{\"node1\":{\"offset\":\"x\"}}", offsets), -1);
+    EXPECT_TRUE(offsets.empty());
+}
+
+TEST(ClkParamsEncoding, Selection) {
+    unsetenv(QOT_PARAMS_ENCODING_ENV);
+    EXPECT_EQ(get_params_encoding("qot.peer.params"), QOT_PARAMS_ENC_JSON);
+    setenv(QOT_PARAMS_ENCODING_ENV, "binary", 1);
+    EXPECT_EQ(get_params_encoding("qot.peer.params"), QOT_PARAMS_ENC_BINARY);
+    unsetenv(QOT_PARAMS_ENCODING_ENV);
+
+    // Later selections take precedence
+    set_params_encoding("qot.peer.>", QOT_PARAMS_ENC_BINARY);
+    set_params_encoding("qot.peer.offsets", QOT_PARAMS_ENC_JSON);
+    EXPECT_EQ(get_params_encoding("qot.peer.params"), QOT_PARAMS_ENC_BINARY);
+    EXPECT_EQ(get_params_encoding("qot.peer.offsets"), QOT_PARAMS_ENC_JSON);
+    EXPECT_EQ(get_params_encoding("qot.timeline.gl_test.params"), QOT_PARAMS_ENC_JSON);
+}
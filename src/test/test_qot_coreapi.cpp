@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <time.h>
+}
+
+#include "../api/cpp/qot_coreapi.hpp"
+#include "bench/qot_bench.hpp"
+
+using namespace qot_coreapi;
+
+static int64_t core_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// Binding to the timeline service stand-in of the benchmarks
+class CoreApi : public ::testing::Test {
+    protected: void SetUp() {
+        if (service.Start() < 0)
+            GTEST_SKIP() << "a timeline service is already running";
+        Publish(0);
+        TL_FROM_nSEC(res, 1);
+        TL_FROM_uSEC(acc.above, 10);
+        TL_FROM_uSEC(acc.below, 10);
+    }
+    protected: void TearDown() {
+        if (binding) {
+            binding->timeline_unbind();
+            delete binding;
+        }
+        service.Stop();
+    }
+
+    // Bind to a timeline ("gl_" names are global, others local with an overlay)
+    protected: void Bind(const char *name) {
+        binding = new TimelineBinding(1);
+        ASSERT_EQ(binding->timeline_bind(name, "app", res, acc), QOT_RETURN_TYPE_OK);
+    }
+
+    // Timeline running at the core clock rate, a given offset ahead of it
+    protected: void Publish(int64_t offset_ns) {
+        tl_translation_t params, ov_params;
+        memset(&params, 0, sizeof(params));
+        memset(&ov_params, 0, sizeof(ov_params));
+        params.last = core_now();
+        params.nsec = params.last + offset_ns;
+        params.u_nsec = 500;
+        params.l_nsec = 500;
+        SetParams(params, ov_params);
+    }
+
+    // Publish to both segments, all sets are kept as the parameter histories keep them
+    protected: void SetParams(const tl_translation_t &params, const tl_translation_t &ov_params) {
+        service.SetParams(params, ov_params);
+        published.push_back(std::make_pair(params, ov_params));
+    }
+
+    protected: qot_bench::TimelineServiceStandin service;
+    protected: std::vector<std::pair<tl_translation_t, tl_translation_t> > published;
+    protected: TimelineBinding *binding = NULL;
+    protected: timelength_t res;
+    protected: timeinterval_t acc;
+};
+
+TEST_F(CoreApi, WaitFollowsNewParams) {
+    Bind("coreapi_test");
+    // Wait 200 ms of timeline time, the timeline jumps 100 ms ahead after 50 ms
+    utimepoint_t utp;
+    ASSERT_EQ(binding->timeline_gettime(utp), QOT_RETURN_TYPE_OK);
+    // The conversion macros end in a semicolon, so they only stand in statements
+    int64_t target_ns = TP_TO_nSEC(utp.estimate);
+    target_ns += 200000000LL;
+    TP_FROM_nSEC(utp.estimate, target_ns);
+
+    int64_t start = core_now();
+    std::thread publisher([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Publish(100000000LL);
+    });
+    ASSERT_EQ(binding->timeline_waituntil(utp), QOT_RETURN_TYPE_OK);
+    int64_t woke = core_now() - start;
+    publisher.join();
+
+    // Woken at the re-projected deadline, not the one of the parameters in place when the wait began
+    int64_t reached_ns = TP_TO_nSEC(utp.estimate);
+    EXPECT_GE(reached_ns, target_ns);
+    EXPECT_LT(reached_ns - target_ns, 5000000LL);
+    EXPECT_GE(woke, 95000000LL);
+    EXPECT_LT(woke, 150000000LL);
+}
+
+TEST_F(CoreApi, FailedWaitKeepsTarget) {
+    Bind("coreapi_test");
+    // Waits on an unbound timeline fail and report the error, not a reached time
+    utimepoint_t utp;
+    ASSERT_EQ(binding->timeline_gettime(utp), QOT_RETURN_TYPE_OK);
+    utimepoint_t target = utp;
+    ASSERT_EQ(binding->timeline_unbind(), QOT_RETURN_TYPE_OK);
+    delete binding;
+    binding = NULL;
+
+    TimelineBinding unbound(1);
+    EXPECT_EQ(unbound.timeline_waituntil(utp), QOT_RETURN_TYPE_ERR);
+    EXPECT_EQ(memcmp(&utp, &target, sizeof(utp)), 0);
+}
+
+// Random clock parameters, last at a given core time
+static tl_translation_t RandomParams(std::mt19937_64 &rng, int64_t last) {
+    tl_translation_t params;
+    memset(&params, 0, sizeof(params));
+    params.last = last;
+    params.mult = std::uniform_int_distribution<int64_t>(-200000, 200000)(rng);
+    params.nsec = last + std::uniform_int_distribution<int64_t>(-1000000000LL, 1000000000LL)(rng);
+    params.u_nsec = std::uniform_int_distribution<int64_t>(0, 100000)(rng);
+    params.l_nsec = std::uniform_int_distribution<int64_t>(0, 100000)(rng);
+    params.u_mult = std::uniform_int_distribution<int64_t>(0, 2000)(rng);
+    params.l_mult = std::uniform_int_distribution<int64_t>(0, 2000)(rng);
+    return params;
+}
+
+// Scalar uncertainty bounds at a core time, overlay included (the formula of the core API)
+static void ReferenceBounds(int64_t core, const tl_translation_t &params, const tl_translation_t *ov_params,
+                            int64_t &u_bound, int64_t &l_bound) {
+    tl_projection_t proj, ov_proj;
+    tl_projection_prepare(&proj, &params);
+    tl_project_bounds(&proj, core, &u_bound, &l_bound);
+    if (ov_params) {
+        tl_projection_prepare(&ov_proj, ov_params);
+        u_bound = u_bound + qot_ns_scale(core + u_bound - ov_proj.last, ov_proj.u_rate) + ov_proj.u_nsec;
+        l_bound = l_bound + qot_ns_scale(core - l_bound - ov_proj.last, ov_proj.l_rate) + ov_proj.l_nsec;
+    }
+}
+
+// Parameter sets published in order, the newest one computed before a core time applies to it
+class CoreApiParity : public CoreApi {
+    protected: void PublishRandom(int64_t last) {
+        tl_translation_t params = RandomParams(rng, last);
+        tl_translation_t ov_params = RandomParams(rng, last);
+        SetParams(params, ov_params);
+    }
+    protected: size_t ValidAt(int64_t core) {
+        size_t k = published.size() - 1;
+        while (k > 0 && published[k].first.last >= core)
+            k--;
+        return k;
+    }
+
+    // Batch conversions against the scalar ones, element by element
+    protected: void ExpectParity(const std::vector<int64_t> &core, bool overlay) {
+        size_t n = core.size();
+        std::vector<int64_t> tl(n), u_bound(n), l_bound(n);
+        ASSERT_EQ(binding->timeline_core2rem_batch(core.data(), tl.data(), u_bound.data(), l_bound.data(), n), QOT_RETURN_TYPE_OK);
+        for (size_t i = 0; i < n; i++) {
+            timepoint_t tp;
+            TP_FROM_nSEC(tp, core[i]);
+            ASSERT_EQ(binding->timeline_core2rem(tp), QOT_RETURN_TYPE_OK);
+            int64_t scalar = TP_TO_nSEC(tp);
+            ASSERT_EQ(tl[i], scalar) << "core time " << core[i];
+
+            int64_t u_ref, l_ref;
+            size_t k = ValidAt(core[i]);
+            ReferenceBounds(core[i], published[k].first, overlay ? &published[k].second : NULL, u_ref, l_ref);
+            ASSERT_EQ(u_bound[i], u_ref) << "core time " << core[i];
+            ASSERT_EQ(l_bound[i], l_ref) << "core time " << core[i];
+        }
+
+        // Back to core time with the newest parameters, bounds at the converted core times
+        std::vector<int64_t> back(n);
+        ASSERT_EQ(binding->timeline_rem2core_batch(tl.data(), back.data(), u_bound.data(), l_bound.data(), n), QOT_RETURN_TYPE_OK);
+        for (size_t i = 0; i < n; i++) {
+            timepoint_t tp;
+            TP_FROM_nSEC(tp, tl[i]);
+            ASSERT_EQ(binding->timeline_rem2core(tp), QOT_RETURN_TYPE_OK);
+            int64_t scalar = TP_TO_nSEC(tp);
+            ASSERT_EQ(back[i], scalar) << "timeline time " << tl[i];
+
+            int64_t u_ref, l_ref;
+            ReferenceBounds(back[i], published.back().first, overlay ? &published.back().second : NULL, u_ref, l_ref);
+            ASSERT_EQ(u_bound[i], u_ref) << "timeline time " << tl[i];
+            ASSERT_EQ(l_bound[i], l_ref) << "timeline time " << tl[i];
+        }
+    }
+
+    // Publishes a second apart, core times across them unsorted and sorted, then older than the histories
+    protected: void ExpectHistoryParity(bool overlay) {
+        int64_t first = core_now();
+        for (int k = 0; k < 6; k++)
+            PublishRandom(first + k*1000000000LL);
+        std::vector<int64_t> core = RandomTimes(first, 7000000000LL, 1021);
+        ExpectParity(core, overlay);
+        std::sort(core.begin(), core.end());
+        ExpectParity(core, overlay);
+
+        int64_t old_ns = published.front().first.last - 1000, tl_ns;
+        timepoint_t tp;
+        TP_FROM_nSEC(tp, old_ns);
+        EXPECT_EQ(binding->timeline_core2rem_batch(&old_ns, &tl_ns, NULL, NULL, 1), QOT_RETURN_TYPE_ERR);
+        EXPECT_EQ(binding->timeline_core2rem(tp), QOT_RETURN_TYPE_ERR);
+    }
+
+    // Random core times in (from, from + span]
+    protected: std::vector<int64_t> RandomTimes(int64_t from, int64_t span, size_t n) {
+        std::vector<int64_t> core(n);
+        for (size_t i = 0; i < n; i++)
+            core[i] = from + std::uniform_int_distribution<int64_t>(1, span)(rng);
+        return core;
+    }
+
+    protected: std::mt19937_64 rng{20180601};
+};
+
+TEST_F(CoreApiParity, GlobalTimeline) {
+    Bind("gl_parity");
+    int64_t last = core_now();
+    for (int round = 0; round < 8; round++) {
+        PublishRandom(last + round);
+        ExpectParity(RandomTimes(last + round, 20000000000LL, 1021), false);
+    }
+}
+
+TEST_F(CoreApiParity, LocalTimelineWithOverlay) {
+    Bind("parity");
+    int64_t last = core_now();
+    for (int round = 0; round < 8; round++) {
+        PublishRandom(last + round);
+        ExpectParity(RandomTimes(last + round, 20000000000LL, 1021), true);
+    }
+}
+
+TEST_F(CoreApiParity, HistoryRunsGlobal) {
+    // Core times spanning several publishes are converted run by run with the parameters valid at them
+    Bind("gl_parity");
+    ExpectHistoryParity(false);
+}
+
+TEST_F(CoreApiParity, HistoryRunsWithOverlay) {
+    Bind("parity");
+    ExpectHistoryParity(true);
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "sim/qot_sim.hpp"
+#include "../micro-services/sync-service/qot_fault.hpp"
+
+using namespace qot;
+
+TEST(Fault, Parse) {
+    uint64_t seed;
+    std::vector<qot_fault_t> faults;
+    std::string error;
+    ASSERT_EQ(fault_parse("seed 7\n10 step 250000\n20 freq 20000 30 # comment\n\n80 delay 2000000 0.05 10\n100 loss 0.3 10\n",
+                          seed, faults, error), 0);
+    EXPECT_EQ(seed, 7U);
+    ASSERT_EQ(faults.size(), 4U);
+    EXPECT_EQ(faults[0].type, QOT_FAULT_STEP);
+    EXPECT_EQ(faults[0].start_ns, 10000000000LL);
+    EXPECT_EQ(faults[0].value, 250000);
+    EXPECT_EQ(faults[1].duration_ns, 30000000000LL);
+    EXPECT_EQ(faults[2].value, 2000000);
+    EXPECT_DOUBLE_EQ(faults[2].probability, 0.05);
+    EXPECT_DOUBLE_EQ(faults[3].probability, 0.3);
+
+    // Unknown class, missing arguments, out of range probability
+    EXPECT_EQ(fault_parse("10 jump 5\n", seed, faults, error), -1);
+    EXPECT_EQ(fault_parse("10 step 5\n10 noise 500\n", seed, faults, error), -1);
+    EXPECT_EQ(error.find("line 2"), 0U);
+    EXPECT_EQ(fault_parse("10 loss 1.5 10\n", seed, faults, error), -1);
+}
+
+TEST(Fault, Reproducible) {
+    // The same script gives the same draws from the same origin
+    std::string error;
+    std::vector<int64_t> draws[2];
+    for (int run = 0; run < 2; run++) {
+        ASSERT_EQ(fault_arm("seed 3\n0 noise 100 0\n0 loss 0.25 0\n", error, 0), 0);
+        for (int i = 0; i < 1000; i++) {
+            int64_t shift = 0;
+            draws[run].push_back(qot_fault_packet(0, &shift) ? -1 : shift);
+        }
+        uint64_t counts[QOT_FAULT_NUM_TYPES];
+        fault_counts(counts);
+        EXPECT_EQ(counts[QOT_FAULT_NOISE], 1000U);
+        EXPECT_GT(counts[QOT_FAULT_LOSS], 150U);
+        EXPECT_LT(counts[QOT_FAULT_LOSS], 350U);
+        fault_disarm();
+    }
+    EXPECT_EQ(draws[0], draws[1]);
+
+    // Steps are taken once
+    ASSERT_EQ(fault_arm("0 step 1000\n", error, 0), 0);
+    EXPECT_EQ(qot_fault_clock_step(), 1000);
+    EXPECT_EQ(qot_fault_clock_step(), 0);
+    fault_disarm();
+    int64_t shift = 0;
+    EXPECT_EQ(qot_fault_packet(1, &shift), 0);
+    EXPECT_EQ(shift, 0);
+}
+
+TEST(Fault, PtpRecovers) {
+    // A phase step half way through, the servo pulls the clock back and the bounds cover the error
+    sim_scenario scenario = sim_random_scenario(SIM_PTP_PI, 3, 240);
+    scenario.faults = "seed 1\n120 step 50000\n";
+    sim_metrics metrics;
+    ASSERT_EQ(sim_run(scenario, metrics), 0);
+    std::cout << "Recovery " << metrics.recovery_s << " s, coverage " << metrics.fault_coverage << "\n";
+    EXPECT_GT(metrics.recovery_s, 0);
+    EXPECT_LT(metrics.recovery_s, 60);
+    EXPECT_FALSE(fault_armed());
+}
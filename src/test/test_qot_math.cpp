@@ -5,6 +5,8 @@ extern "C" {
     #include "../qot_types.h"
 }
 
+#include "../qot_time.hpp"
+
 TEST(TimelineMath, TL_FROM) {
 	timelength_t t;
     TL_FROM_SEC(t,1ULL);
@@ -83,7 +85,6 @@ TEST(TimelineMath, timelength_cmp) {
 }
 
 TEST(TimelineMath, timelength_min) {
-	int v;
 	timelength_t l, l1, l2;
 	TL_FROM_SEC(l1,1ULL);
 	TL_FROM_SEC(l2,2ULL);
@@ -100,7 +101,6 @@ TEST(TimelineMath, timelength_min) {
 }
 
 TEST(TimelineMath, timelength_max) {
-	int v;
 	timelength_t l, l1, l2;
 	TL_FROM_SEC(l1,1ULL);
 	TL_FROM_SEC(l2,2ULL);
@@ -251,7 +251,6 @@ TEST(TimelineMath, timepoint_from_timespec) {
 }
 
 TEST(TimelineMath, utimepoint_add) {
-	int v;
 	utimepoint_t ut;
 	utimelength_t ul;
 	TP_FROM_SEC(ut.estimate, -2LL);
@@ -267,7 +266,6 @@ TEST(TimelineMath, utimepoint_add) {
 }
 
 TEST(TimelineMath, utimepoint_sub) {
-	int v;
 	utimepoint_t ut;
 	utimelength_t ul;
 	TP_FROM_SEC(ut.estimate, -2LL);
@@ -281,3 +279,123 @@ TEST(TimelineMath, utimepoint_sub) {
 	EXPECT_EQ(400ULL,ut.interval.below.asec);
 	EXPECT_EQ(400ULL,ut.interval.below.asec);
 }
+
+#ifdef QOT_HAVE_INT128
+TEST(TimelineMath, atime_timepoint) {
+    timepoint_t t, r;
+    t.sec = -3;
+    t.asec = 400ULL;
+    qot_atime_to_timepoint(&r, qot_atime_from_timepoint(&t));
+    EXPECT_EQ(-3, r.sec);
+    EXPECT_EQ(400ULL, r.asec);
+    qot_atime_to_timepoint(&r, qot_atime_from_ns(-1));
+    EXPECT_EQ(-1, r.sec);
+    EXPECT_EQ(999999999000000000ULL, r.asec);
+    EXPECT_EQ(-1, qot_atime_to_ns(qot_atime_from_timepoint(&r)));
+}
+
+TEST(TimelineMath, atime_saturate) {
+    EXPECT_TRUE(qot_atime_add(QOT_ATIME_MAX, 1) == QOT_ATIME_MAX);
+    EXPECT_TRUE(qot_atime_sub(QOT_ATIME_MIN, 1) == QOT_ATIME_MIN);
+    EXPECT_TRUE(qot_atime_mul(QOT_ATIME_MAX/2, -3) == QOT_ATIME_MIN);
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MAX) + qot::Duration::seconds(1)).attoseconds() == QOT_ATIME_MAX);
+    // Products at the limits saturate without negating them
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MIN) * -1).attoseconds() == QOT_ATIME_MAX);
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MIN) * 1).attoseconds() == QOT_ATIME_MIN);
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MAX) * -1).attoseconds() == -QOT_ATIME_MAX);
+    EXPECT_TRUE((qot::Duration(2) * INT64_MIN).attoseconds() == (qot_atime_t)INT64_MIN * 2);
+    EXPECT_TRUE((qot::Duration(-1) * INT64_MIN).attoseconds() == -(qot_atime_t)INT64_MIN);
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MIN/2) * 2).attoseconds() == QOT_ATIME_MIN);
+    EXPECT_TRUE((qot::Duration(QOT_ATIME_MIN/2 - 1) * 2).attoseconds() == QOT_ATIME_MIN);
+    static_assert(qot::detail::sat_mul(QOT_ATIME_MIN, -1) == QOT_ATIME_MAX, "saturates in constant expressions");
+    timelength_t l = (qot::Duration::seconds(1) - qot::Duration::seconds(2)).to_timelength();
+    EXPECT_EQ(0ULL, l.sec);
+    EXPECT_EQ(0ULL, l.asec);
+}
+
+TEST(TimelineMath, atime_scale) {
+    // 200 days at 12345 ppb, within 1as per 2^64as of input
+    qot::Duration d = qot::Duration::seconds(86400LL*200) + qot::Duration(12345);
+    qot_atime_t exact = (d.attoseconds()*12345)/1000000000LL;
+    qot_atime_t err = d.scale(qot::Rate::ppb(12345)).attoseconds() - exact;
+    EXPECT_LE((long long)(err < 0 ? -err : err), (long long)(d.attoseconds() >> 64) + 1);
+    EXPECT_TRUE(qot_atime_scale(qot_atime_from_ns(1000000000LL), qot_rate_from_ppb(-2500)) == -(qot_atime_t)2500000000000LL);
+}
+
+TEST(TimelineMath, muldiv_floor) {
+    EXPECT_EQ(-4, qot_muldiv_floor(-7, 1, 2));
+    EXPECT_EQ(2333333333LL, qot_muldiv_floor(7, 1000000000LL, 3));
+    // 200 days in ns no longer loses precision in the core time projection
+    EXPECT_EQ(17280000000000001LL, qot_muldiv_floor(17280000000000001LL, 1000000000LL, 1000000000LL));
+    // The ppb correction of the binding projection, mult*val overflows 64 bits here
+    EXPECT_EQ(1728000000000LL, qot_muldiv_floor(17280000000000000LL, 100000LL, 1000000000LL));
+    EXPECT_EQ(-1728000000001LL, qot_muldiv_floor(-17280000000000001LL, 100000LL, 1000000000LL));
+}
+
+// Reference projection with the exact 128-bit muldiv
+static int64_t exact_loc2rem(int64_t core, const tl_translation_t &p) {
+    return p.nsec + (core - p.last) + qot_muldiv_floor(core - p.last, p.mult, 1000000000LL);
+}
+
+TEST(TimelineMath, rate_of_ppb) {
+    // Multiplication by the reciprocal stays within 2^-64 of the division
+    for (int64_t ppb = -499999999LL; ppb <= 499999999LL; ppb += 7777777LL) {
+        int64_t diff = qot_rate_from_ppb(ppb).frac - qot_rate_of_ppb(ppb).frac;
+        EXPECT_GE(diff, 0) << ppb;
+        EXPECT_LE(diff, 1) << ppb;
+    }
+    // (1 + r)(1 + s) = 1 for the inverse rate
+    int64_t ppbs[] = {0, 1, -1, 12345, -98765, 250000000LL, -250000000LL};
+    for (int64_t ppb : ppbs) {
+        qot_rate_t r = qot_rate_of_ppb(ppb), s = qot_rate_inverse(r);
+        __int128 e = (__int128)r.frac + s.frac + (((__int128)r.frac * s.frac) >> 64);
+        EXPECT_LE((long long)(e < 0 ? -e : e), 2LL) << ppb;
+    }
+}
+
+TEST(TimelineMath, projection) {
+    uint64_t seed = 88172645463325252ULL;
+    for (int i = 0; i < 20000; i++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        tl_translation_t p;
+        memset(&p, 0, sizeof(p));
+        p.last = 1530000000000000000LL + (int64_t)(seed % 1000000000000ULL);
+        p.nsec = p.last + (int64_t)(seed % 2000001ULL) - 1000000;
+        p.mult = (int64_t)((seed >> 20) % 2000001ULL) - 1000000;
+        p.u_mult = (int64_t)((seed >> 30) % 100000ULL);
+        p.l_mult = (int64_t)((seed >> 40) % 100000ULL);
+        p.u_nsec = 1000;
+        p.l_nsec = 900;
+        tl_projection_t proj;
+        tl_projection_prepare(&proj, &p);
+
+        // Up to 200 days either side of the last update
+        int64_t core = p.last + (int64_t)((seed >> 3) % 34560000000000000ULL) - 17280000000000000LL;
+        int64_t tl = tl_project(&proj, core);
+        int64_t exact = exact_loc2rem(core, p);
+        EXPECT_LE(tl - exact, 1) << i;
+        EXPECT_GE(tl - exact, -1) << i;
+
+        // The inverse is the latest core time projected at or before the timeline time
+        // (slow clocks project two adjacent core times to the same timeline time)
+        int64_t back = tl_unproject(&proj, tl);
+        EXPECT_EQ(tl_project(&proj, back), tl) << i;
+        EXPECT_GE(back, core) << i;
+        EXPECT_LE(back, core + 1) << i;
+        back = tl_unproject(&proj, tl + 17);
+        EXPECT_LE(tl_project(&proj, back), tl + 17) << i;
+        EXPECT_GT(tl_project(&proj, back + 1), tl + 17) << i;
+        int64_t len = tl_project_length(&proj, core - p.last);
+        EXPECT_EQ(tl_project_length(&proj, tl_unproject_length(&proj, len)), len) << i;
+
+        int64_t u_bound, l_bound;
+        tl_project_bounds(&proj, core, &u_bound, &l_bound);
+        int64_t u_exact = qot_muldiv_floor(core - p.last, p.u_mult, 1000000000LL) + p.u_nsec;
+        int64_t l_exact = qot_muldiv_floor(core - p.last, p.l_mult, 1000000000LL) + p.l_nsec;
+        EXPECT_LE(u_bound - u_exact, 1) << i;
+        EXPECT_GE(u_bound - u_exact, -1) << i;
+        EXPECT_LE(l_bound - l_exact, 1) << i;
+        EXPECT_GE(l_bound - l_exact, -1) << i;
+    }
+}
+#endif
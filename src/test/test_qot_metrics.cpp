@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+}
+
+#include "../micro-services/sync-service/qot_metrics.hpp"
+
+using namespace qot;
+
+static const qot_metric_snapshot_t *find_metric(const std::vector<qot_metric_snapshot_t> &snapshot, int id)
+{
+    return (id >= 0 && id < (int) snapshot.size()) ? &snapshot[id] : NULL;
+}
+
+TEST(Metrics, BucketLimits) {
+    // Every value falls in a bucket whose limit is at least the value and below the next bucket
+    for (uint64_t value = 0; value < 100000; value += 7) {
+        int bucket = metrics_bucket(value);
+        EXPECT_LE(value, metrics_bucket_limit(bucket));
+        if (bucket > 0) {
+            EXPECT_GT(value, metrics_bucket_limit(bucket - 1));
+        }
+    }
+    // Relative width stays below 2^-SUB_BITS
+    int bucket = metrics_bucket(1000000);
+    double width = double(metrics_bucket_limit(bucket) - metrics_bucket_limit(bucket - 1));
+    EXPECT_LT(width/1000000.0, 1.0/(1 << QOT_METRICS_SUB_BITS));
+    EXPECT_EQ(metrics_bucket(UINT64_MAX), QOT_METRICS_BUCKETS - 1);
+}
+
+TEST(Metrics, ThreadsAggregate) {
+    int counter = metrics_register(QOT_METRIC_COUNTER, "qot_test_events_total", "", "Test events");
+    int histogram = metrics_register(QOT_METRIC_HISTOGRAM, "qot_test_latency_seconds", "stage=\"a\"", "Test latency");
+    ASSERT_GE(counter, 0);
+    ASSERT_GE(histogram, 0);
+    EXPECT_EQ(metrics_register(QOT_METRIC_COUNTER, "qot_test_events_total", "", "Test events"), counter);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([counter, histogram]() {
+            for (int i = 0; i < 1000; i++) {
+                metrics_add(counter);
+                metrics_record(histogram, 1000);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    std::vector<qot_metric_snapshot_t> snapshot;
+    metrics_collect(snapshot);
+    const qot_metric_snapshot_t *events = find_metric(snapshot, counter);
+    const qot_metric_snapshot_t *latency = find_metric(snapshot, histogram);
+    ASSERT_TRUE(events && latency);
+    EXPECT_EQ(events->count, 4000ULL);
+    EXPECT_EQ(latency->count, 4000ULL);
+    EXPECT_EQ(latency->sum, 4000000ULL);
+    EXPECT_EQ(latency->buckets[metrics_bucket(1000)], 4000ULL);
+}
+
+TEST(Metrics, WatchParams) {
+    tl_translation_t params;
+    memset(&params, 0, sizeof(params));
+    metrics_watch_params("test", &params);
+    tl_translation_t update = params;
+    for (int i = 0; i < 3; i++)
+        tl_translation_publish(&params, &update);
+
+    std::vector<qot_metric_snapshot_t> snapshot;
+    metrics_collect(snapshot);
+    metrics_unwatch_params(&params);
+    int id = metrics_register(QOT_METRIC_COUNTER, "qot_shm_publish_total", "clock=\"test\"", "");
+    ASSERT_TRUE(find_metric(snapshot, id) != NULL);
+    EXPECT_EQ(snapshot[id].count, 3ULL);
+}
+
+TEST(Metrics, Export) {
+    int histogram = metrics_register(QOT_METRIC_HISTOGRAM, "qot_test_export_seconds", "", "Exported latency");
+    metrics_record(histogram, 2000);
+
+    MetricsExporter exporter("test_" + std::to_string(getpid()));
+    ASSERT_EQ(exporter.Start(10), 0);
+
+    // Snapshot segment
+    std::vector<qot_metric_snapshot_t> snapshot;
+    ASSERT_EQ(metrics_read_shm("test_" + std::to_string(getpid()), snapshot), 0);
+    ASSERT_TRUE(find_metric(snapshot, histogram) != NULL);
+    EXPECT_EQ(snapshot[histogram].count, 1ULL);
+
+    // Prometheus text
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", exporter.GetSocketPath().c_str());
+    ASSERT_EQ(connect(fd, (struct sockaddr*) &address, sizeof(address)), 0);
+    shutdown(fd, SHUT_WR);
+    std::string text;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        text.append(buf, n);
+    close(fd);
+    EXPECT_NE(text.find("# TYPE qot_test_export_seconds histogram"), std::string::npos);
+    EXPECT_NE(text.find("qot_test_export_seconds_bucket{le=\"+Inf\"} 1"), std::string::npos);
+    EXPECT_NE(text.find("qot_test_export_seconds_sum 2e-06"), std::string::npos);
+
+    exporter.Stop();
+    EXPECT_NE(metrics_read_shm("test_" + std::to_string(getpid()), snapshot), 0);
+}
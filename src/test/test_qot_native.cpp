@@ -0,0 +1,124 @@
+// Python C API (must come first)
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <time.h>
+}
+
+#include "bench/qot_bench.hpp"
+
+// Module init of the native binding, compiled into this test
+PyMODINIT_FUNC PyInit_qot_native(void);
+
+// Timeline service stand-in and an interpreter with the native module built in
+class NativeModule : public ::testing::Test {
+    protected: static void SetUpTestCase() {
+        PyImport_AppendInittab("qot_native", PyInit_qot_native);
+        Py_Initialize();
+    }
+    protected: static void TearDownTestCase() {
+        Py_Finalize();
+    }
+    protected: void SetUp() {
+        if (service.Start() < 0)
+            GTEST_SKIP() << "a timeline service is already running";
+
+        struct timespec ts;
+        tl_translation_t params, ov_params;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        memset(&params, 0, sizeof(params));
+        memset(&ov_params, 0, sizeof(ov_params));
+        params.last = int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+        params.mult = 10000;
+        params.nsec = params.last + 1000000;
+        params.u_nsec = 500;
+        params.l_nsec = 500;
+        params.u_mult = 20;
+        params.l_mult = 20;
+        service.SetParams(params, ov_params);
+    }
+    protected: void TearDown() {
+        service.Stop();
+    }
+
+    // Run a script, a failed assertion shows up as a traceback on stderr
+    protected: int Run(const std::string &script) {
+        return PyRun_SimpleString(("import qot_native, threading, array, time\n"
+                                   "OK = qot_native.QOT_RETURN_TYPE_OK\n" + script).c_str());
+    }
+
+    protected: qot_bench::TimelineServiceStandin service;
+};
+
+TEST_F(NativeModule, BindReadUnbind) {
+    EXPECT_EQ(Run(
+        "b = qot_native.TimelineBinding()\n"
+        "assert b.timeline_bind('native_smoke', 'app', 1, 1000, 1) == OK\n"
+        "est, above, below = b.timeline_gettime()\n"
+        "assert est > 0 and above >= 0 and below >= 0\n"
+        "core = b.timeline_getcoretime()\n"
+        "assert abs(b.timeline_rem2core(b.timeline_core2rem(core)[0]) - core) <= 1\n"
+        "times = array.array('q', [core, core + 1000000])\n"
+        "out = array.array('q', [0, 0])\n"
+        "assert b.timeline_core2rem_batch(times, out) == OK\n"
+        "assert out[1] - out[0] >= 1000000\n"
+        "status, reached = b.timeline_sleep(1000000)\n"
+        "assert status == OK and reached[0] >= est + 1000000\n"
+        "assert b.timeline_unbind() == OK\n"
+        "try:\n"
+        "    b.timeline_gettime()\n"
+        "    assert False\n"
+        "except RuntimeError:\n"
+        "    pass\n"), 0);
+}
+
+TEST_F(NativeModule, ConcurrentBind) {
+    // Only one of the racing binds creates and binds the binding, the others are refused
+    EXPECT_EQ(Run(
+        "b = qot_native.TimelineBinding()\n"
+        "results = []\n"
+        "def bind():\n"
+        "    try:\n"
+        "        results.append(b.timeline_bind('native_smoke', 'app', 1, 1000, 1))\n"
+        "    except RuntimeError:\n"
+        "        results.append(None)\n"
+        "threads = [threading.Thread(target=bind) for i in range(4)]\n"
+        "for t in threads: t.start()\n"
+        "for t in threads: t.join()\n"
+        "assert results.count(OK) == 1 and results.count(None) == 3, results\n"
+        "assert b.timeline_unbind() == OK\n"), 0);
+}
+
+TEST_F(NativeModule, ReadsRacingUnbind) {
+    // Reads either complete on the mapped parameters or are refused, never read unmapped memory.
+    // Unbind is refused while a conversion runs, so the readers yield between their calls
+    EXPECT_EQ(Run(
+        "b = qot_native.TimelineBinding()\n"
+        "for i in range(20):\n"
+        "    assert b.timeline_bind('native_smoke', 'app', 1, 1000, 1) == OK\n"
+        "    stop = []\n"
+        "    def read():\n"
+        "        while not stop:\n"
+        "            try:\n"
+        "                assert b.timeline_gettime()[0] > 0\n"
+        "                b.timeline_core2rem_batch(array.array('q', [1]*64), array.array('q', [0]*64))\n"
+        "            except RuntimeError:\n"
+        "                pass\n"
+        "            time.sleep(0)\n"
+        "    readers = [threading.Thread(target=read) for j in range(2)]\n"
+        "    for t in readers: t.start()\n"
+        "    while True:\n"
+        "        try:\n"
+        "            assert b.timeline_unbind() == OK\n"
+        "            break\n"
+        "        except RuntimeError:\n"
+        "            time.sleep(0.001)\n"
+        "    stop.append(True)\n"
+        "    for t in readers: t.join()\n"), 0);
+}
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include "../qot_param_history.h"
+}
+
+// Clock segment with a small history ring
+class ParamHistory : public ::testing::Test {
+    protected: void SetUp() {
+        segment.assign(tl_history_segment_size(8), 0);
+        clk_params = (tl_translation_t*) &segment[0];
+        tl_history_init(clk_params, 8, 8*1000000000LL);
+    }
+    protected: tl_translation_t Params(int64_t last, int64_t nsec) {
+        tl_translation_t params;
+        memset(&params, 0, sizeof(params));
+        params.last = last;
+        params.nsec = nsec;
+        return params;
+    }
+    protected: std::vector<char> segment;
+    protected: tl_translation_t *clk_params;
+};
+
+TEST_F(ParamHistory, NoHistory) {
+    tl_translation_t plain, found;
+    memset(&plain, 0, sizeof(plain));
+    EXPECT_TRUE(tl_history_get(&plain) == NULL);
+    EXPECT_EQ(tl_history_append(&plain, &plain), 0U);
+    EXPECT_EQ(tl_history_find(&plain, 100, &found), -1);
+    EXPECT_EQ(tl_clock_segment_size(&plain), sizeof(tl_translation_t));
+    EXPECT_EQ(tl_clock_segment_size(clk_params), tl_history_segment_size(8));
+    // Empty history
+    EXPECT_EQ(tl_history_find(clk_params, 100, &found), -1);
+}
+
+TEST_F(ParamHistory, FindsNewestBefore) {
+    for (int i = 1; i <= 5; i++) {
+        tl_translation_t params = Params(i*1000, i);
+        EXPECT_EQ(tl_history_append(clk_params, &params), uint64_t(i));
+    }
+    // A bounds-only update keeps the core time of the last correction, the newest one wins
+    tl_translation_t params = Params(5000, 6);
+    EXPECT_EQ(tl_history_append(clk_params, &params), 6U);
+
+    tl_translation_t found;
+    ASSERT_EQ(tl_history_find(clk_params, 3500, &found), 0);
+    EXPECT_EQ(found.nsec, 3);
+    EXPECT_EQ(found.seq, 3U);
+    ASSERT_EQ(tl_history_find(clk_params, 3000, &found), 0);
+    EXPECT_EQ(found.nsec, 2);
+    ASSERT_EQ(tl_history_find(clk_params, 1000000, &found), 0);
+    EXPECT_EQ(found.nsec, 6);
+    EXPECT_EQ(tl_history_find(clk_params, 1000, &found), -1);
+
+    // Out of order parameters are dropped
+    params = Params(2000, 7);
+    EXPECT_EQ(tl_history_append(clk_params, &params), 0U);
+    EXPECT_EQ(tl_history_get(clk_params)->rejected, 1U);
+}
+
+TEST_F(ParamHistory, EveryPublishAppends) {
+    // Complete parameter sets and partial updates (bounds, clock operations) all enter the history
+    tl_translation_t params = Params(1000, 1);
+    tl_translation_publish(clk_params, &params);
+    tl_translation_write_begin(clk_params);
+    clk_params->u_nsec = 50;
+    tl_translation_write_end(clk_params);
+    params = Params(2000, 2);
+    tl_translation_publish(clk_params, &params);
+    EXPECT_EQ(tl_history_get(clk_params)->head, 3U);
+
+    tl_translation_t found;
+    int64_t until;
+    ASSERT_EQ(tl_history_find_until(clk_params, 1500, &found, &until), 0);
+    EXPECT_EQ(found.nsec, 1);
+    EXPECT_EQ(found.u_nsec, 50);
+    EXPECT_EQ(until, 2000);
+    ASSERT_EQ(tl_history_find_until(clk_params, 2001, &found, &until), 0);
+    EXPECT_EQ(found.nsec, 2);
+    EXPECT_EQ(until, INT64_MAX);
+}
+
+TEST_F(ParamHistory, Wraps) {
+    for (int i = 1; i <= 20; i++) {
+        tl_translation_t params = Params(i*1000, i);
+        tl_history_append(clk_params, &params);
+    }
+    // Entries 13..20 are left
+    tl_translation_t found;
+    EXPECT_EQ(tl_history_find(clk_params, 13000, &found), -1);
+    for (int i = 13; i < 20; i++) {
+        ASSERT_EQ(tl_history_find(clk_params, i*1000 + 1, &found), 0);
+        EXPECT_EQ(found.nsec, i);
+    }
+}
+
+TEST_F(ParamHistory, ConcurrentReader) {
+    // The reader always sees a consistent entry computed before the lookup time
+    std::thread writer([this]() {
+        for (int i = 1; i <= 200000; i++) {
+            tl_translation_t params = Params(i*1000, i);
+            params.mult = i;
+            tl_history_append(clk_params, &params);
+        }
+    });
+    uint64_t found_count = 0;
+    for (int i = 0; i < 200000; i++) {
+        tl_translation_t found;
+        int64_t core_ns = int64_t(200000 - (i % 200000))*1000 + 1;
+        if (tl_history_find(clk_params, core_ns, &found) == 0) {
+            EXPECT_LT(found.last, core_ns);
+            EXPECT_EQ(found.mult, found.nsec);
+            found_count++;
+        }
+    }
+    writer.join();
+    tl_translation_t found;
+    ASSERT_EQ(tl_history_find(clk_params, 200000*1000LL + 1, &found), 0);
+    EXPECT_EQ(found.nsec, 200000);
+    std::cout << "Concurrent lookups that found parameters: " << found_count << "\n";
+}
+
+TEST_F(ParamHistory, WaitersOnSegment) {
+    // Without a wait slot tasks register on the segment and a publish wakes them
+    ASSERT_EQ(clk_params->wait_slot, (u32) TL_WAIT_SLOT_NONE);
+    u32 *wait_word = tl_translation_wait_word(clk_params);
+    ASSERT_EQ(wait_word, &clk_params->seq);
+    u32 wait_seq = __atomic_load_n(wait_word, __ATOMIC_ACQUIRE);
+
+    std::atomic<bool> registered(false);
+    std::thread waiter([&]() {
+        struct timespec timeout = {5, 0};
+        tl_translation_wait_enter(clk_params);
+        registered = true;
+        while (__atomic_load_n(wait_word, __ATOMIC_ACQUIRE) == wait_seq)
+            syscall(SYS_futex, wait_word, FUTEX_WAIT, wait_seq, &timeout, NULL, 0);
+        tl_translation_wait_exit(clk_params);
+    });
+    while (!registered)
+        std::this_thread::yield();
+    EXPECT_EQ(__atomic_load_n(&clk_params->waiters, __ATOMIC_ACQUIRE), 1U);
+
+    auto start = std::chrono::steady_clock::now();
+    tl_translation_t params = Params(1000, 1);
+    tl_translation_publish(clk_params, &params);
+    waiter.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_EQ(clk_params->waiters, 0U);
+}
@@ -0,0 +1,114 @@
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/sync-service/sync/huygens/PeerCompute.hpp"
+
+// Five nodes, three independent loops. The loop matrix is the one the former
+// Python compute server built with networkx.cycle_basis(graph, 0):
+//   b->c->d->m - b->m, a->c->d->m - a->m and a->b->m - a->m
+static const int loop_rows[3][4][2] = {
+    {{6, 1}, {10, 1}, {12, 1}, {4, -1}},
+    {{9, 1}, {10, 1}, {12, 1}, {1, -1}},
+    {{2, 1}, {4, 1},  {1, -1}, {-1, 0}},
+};
+
+class PeerComputeLoops : public ::testing::Test {
+    protected: PeerComputeLoops() : peer("m", PEER_COMPUTE_DEF_PERIOD_NS, "") {}
+    protected: void SetUp() {
+        peer.AddEdge("m", "a");
+        peer.AddEdge("a", "b");
+        peer.AddEdge("b", "m");
+        peer.AddEdge("b", "c");
+        peer.AddEdge("c", "a");
+        peer.AddEdge("c", "d");
+        peer.AddEdge("d", "m");
+    }
+
+    // Dense least-squares projection x - L^T (L L^T)^-1 L x
+    protected: std::vector<double> DenseProjection(const std::vector<double> &x) {
+        const int loops = 3;
+        double L[loops][14] = {{0}};
+        for (int r = 0; r < loops; r++)
+            for (int j = 0; j < 4 && loop_rows[r][j][0] >= 0; j++)
+                L[r][loop_rows[r][j][0]] = loop_rows[r][j][1];
+
+        double A[loops][loops + 1];
+        for (int r = 0; r < loops; r++) {
+            for (int c = 0; c < loops; c++) {
+                A[r][c] = 0;
+                for (int k = 0; k < 14; k++)
+                    A[r][c] += L[r][k]*L[c][k];
+            }
+            A[r][loops] = 0;
+            for (int k = 0; k < 14; k++)
+                A[r][loops] += L[r][k]*x[k];
+        }
+
+        // Gaussian elimination with partial pivoting
+        for (int c = 0; c < loops; c++) {
+            int pivot = c;
+            for (int r = c + 1; r < loops; r++)
+                if (std::fabs(A[r][c]) > std::fabs(A[pivot][c]))
+                    pivot = r;
+            for (int k = 0; k <= loops; k++)
+                std::swap(A[c][k], A[pivot][k]);
+            for (int r = 0; r < loops; r++) {
+                if (r == c)
+                    continue;
+                double f = A[r][c]/A[c][c];
+                for (int k = c; k <= loops; k++)
+                    A[r][k] -= f*A[c][k];
+            }
+        }
+
+        std::vector<double> out(x);
+        for (int r = 0; r < loops; r++)
+            for (int k = 0; k < 14; k++)
+                out[k] -= L[r][k]*A[r][loops]/A[r][r];
+        return out;
+    }
+
+    protected: qot::PeerCompute peer;
+};
+
+TEST_F(PeerComputeLoops, MatchesDenseProjection) {
+    // Offsets (ns) with loop closure errors of a few microseconds
+    double raw[14] = {1000, -1003, 2500, -2498, -3490, 3493, 700, -702, 1810, -1805, -150, 151, 3640, -3644};
+    std::vector<double> x(raw, raw + 14);
+    std::vector<double> ref = DenseProjection(x);
+
+    ASSERT_EQ(peer.ProjectOffsets(x), 3);
+    for (int k = 0; k < 14; k++)
+        EXPECT_NEAR(x[k], ref[k], 1e-6) << "column " << k;
+
+    // The projected offsets close every loop
+    for (int r = 0; r < 3; r++) {
+        double sum = 0;
+        for (int j = 0; j < 4 && loop_rows[r][j][0] >= 0; j++)
+            sum += loop_rows[r][j][1]*x[loop_rows[r][j][0]];
+        EXPECT_NEAR(sum, 0.0, 1e-6) << "loop " << r;
+    }
+}
+
+TEST_F(PeerComputeLoops, WarmStartMatchesDenseProjection) {
+    // Successive periods reuse the previous loop solution as the starting point
+    for (int period = 0; period < 4; period++) {
+        std::vector<double> x(14);
+        for (int k = 0; k < 14; k++)
+            x[k] = (k & 1 ? -1.0 : 1.0)*(1000.0*(k + 1)) + 3.0*std::sin(period + 0.7*k);
+        std::vector<double> ref = DenseProjection(x);
+        ASSERT_EQ(peer.ProjectOffsets(x), 3);
+        for (int k = 0; k < 14; k++)
+            EXPECT_NEAR(x[k], ref[k], 1e-6) << "period " << period << " column " << k;
+    }
+}
+
+TEST_F(PeerComputeLoops, TopologyChange) {
+    // Without d<->m the d branch is a tree, two loops remain
+    EXPECT_EQ(peer.RemoveEdge("d", "m"), 0);
+    std::vector<double> x(12, 1.0);
+    EXPECT_EQ(peer.ProjectOffsets(x), 2);
+    std::vector<double> wrong(14, 1.0);
+    EXPECT_EQ(peer.ProjectOffsets(wrong), -1);
+}
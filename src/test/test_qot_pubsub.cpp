@@ -0,0 +1,138 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <stdlib.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+}
+
+#include "../micro-services/sync-service/qot_pubsub.hpp"
+
+// Messages received by a subscription
+class Inbox {
+    public: void Deliver(const std::string &subject, const std::string &data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.push_back(subject + " " + data);
+        cv.notify_all();
+    }
+    // Wait for a number of messages, returns the ones received
+    public: std::vector<std::string> Wait(size_t count, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return messages.size() >= count; });
+        return messages;
+    }
+    public: qot::pubsub_handler_t Handler() {
+        return [this](const std::string &subject, const std::string &data) { Deliver(subject, data); };
+    }
+    private: std::mutex mutex;
+    private: std::condition_variable cv;
+    private: std::vector<std::string> messages;
+};
+
+TEST(PubSub, SubjectMatch) {
+    EXPECT_TRUE(qot::pubsub_subject_match("qot.peer.params", "qot.peer.params"));
+    EXPECT_TRUE(qot::pubsub_subject_match("qot.*.params", "qot.peer.params"));
+    EXPECT_TRUE(qot::pubsub_subject_match("qot.>", "qot.peer.params"));
+    EXPECT_FALSE(qot::pubsub_subject_match("qot.>", "qot"));
+    EXPECT_FALSE(qot::pubsub_subject_match("qot.*", "qot.peer.params"));
+    EXPECT_FALSE(qot::pubsub_subject_match("qot.peer.params", "qot.peer"));
+}
+
+TEST(PubSub, InProc) {
+    qot::PubSubTransport *publisher = qot::pubsub_connect("inproc://test");
+    qot::PubSubTransport *subscriber = qot::pubsub_connect("inproc://test");
+    qot::PubSubTransport *other_bus = qot::pubsub_connect("inproc://other");
+    ASSERT_TRUE(publisher != NULL && subscriber != NULL && other_bus != NULL);
+
+    Inbox inbox, other_inbox;
+    int sub = subscriber->Subscribe("qot.peer.*", inbox.Handler());
+    ASSERT_GE(sub, 0);
+    ASSERT_GE(other_bus->Subscribe(">", other_inbox.Handler()), 0);
+
+    // Delivery is synchronous on the in-process bus
+    EXPECT_EQ(publisher->Publish("qot.peer.params", "1"), 0);
+    EXPECT_EQ(publisher->Publish("qot.timeline.params", "2"), 0);
+    std::vector<std::string> received = inbox.Wait(1, 0);
+    ASSERT_EQ(received.size(), 1U);
+    EXPECT_EQ(received[0], "qot.peer.params 1");
+    EXPECT_TRUE(other_inbox.Wait(1, 0).empty());
+
+    // No delivery once unsubscribed, only the subscribing transport can unsubscribe
+    EXPECT_EQ(publisher->Unsubscribe(sub), -1);
+    EXPECT_EQ(subscriber->Unsubscribe(sub), 0);
+    EXPECT_EQ(publisher->Publish("qot.peer.params", "3"), 0);
+    EXPECT_EQ(inbox.Wait(2, 0).size(), 1U);
+
+    delete publisher;
+    delete subscriber;
+    delete other_bus;
+}
+
+// Host-local bus in a private directory
+class LocalBus : public ::testing::Test {
+    protected: void SetUp() {
+        char path[] = "/tmp/qot-pubsub-test.XXXXXX";
+        ASSERT_TRUE(mkdtemp(path) != NULL);
+        parent = path;
+        dir = parent + "/bus";
+    }
+    protected: void TearDown() {
+        rmdir(dir.c_str());
+        rmdir(parent.c_str());
+    }
+    protected: std::string parent;
+    protected: std::string dir;
+};
+
+TEST_F(LocalBus, PublishSubscribe) {
+    qot::PubSubTransport *subscriber = qot::pubsub_connect("local://" + dir);
+    ASSERT_TRUE(subscriber != NULL);
+
+    // The bus directory is private to the user
+    struct stat st;
+    ASSERT_EQ(lstat(dir.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0700U);
+    EXPECT_EQ(st.st_uid, geteuid());
+
+    qot::PubSubTransport *publisher = qot::pubsub_connect("local://" + dir);
+    ASSERT_TRUE(publisher != NULL);
+
+    Inbox inbox;
+    int sub = subscriber->Subscribe("qot.peer.>", inbox.Handler());
+    ASSERT_GE(sub, 0);
+    EXPECT_EQ(publisher->Publish("qot.peer.params", "{\"offset\":1}"), 0);
+    EXPECT_EQ(publisher->Publish("qot.timeline.params", "ignored"), 0);
+    EXPECT_EQ(publisher->Publish("qot.peer.offsets", "{\"offset\":2}"), 0);
+    std::vector<std::string> received = inbox.Wait(2, 2000);
+    ASSERT_EQ(received.size(), 2U);
+    EXPECT_EQ(received[0], "qot.peer.params {\"offset\":1}");
+    EXPECT_EQ(received[1], "qot.peer.offsets {\"offset\":2}");
+
+    EXPECT_EQ(subscriber->Unsubscribe(sub), 0);
+    delete publisher;
+    delete subscriber;
+}
+
+TEST_F(LocalBus, RejectsSharedDirectory) {
+    // A world-writable directory (the former /tmp-like default) is refused
+    ASSERT_EQ(mkdir(dir.c_str(), 0700), 0);
+    ASSERT_EQ(chmod(dir.c_str(), 01777), 0);
+    EXPECT_TRUE(qot::pubsub_connect("local://" + dir) == NULL);
+
+    // So is a symbolic link to a private directory
+    ASSERT_EQ(chmod(dir.c_str(), 0700), 0);
+    std::string link = parent + "/link";
+    ASSERT_EQ(symlink(dir.c_str(), link.c_str()), 0);
+    EXPECT_TRUE(qot::pubsub_connect("local://" + link) == NULL);
+    unlink(link.c_str());
+
+    qot::PubSubTransport *transport = qot::pubsub_connect("local://" + dir);
+    EXPECT_TRUE(transport != NULL);
+    delete transport;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <cmath>
+#include <gtest/gtest.h>
+
+#include "sim/qot_sim.hpp"
+
+using namespace qot;
+
+static sim_oscillator_params ideal_oscillator()
+{
+    sim_oscillator_params params;
+    params.offset_ns = 0;
+    params.drift_ppb = 0;
+    params.wander_ppb = 0;
+    return params;
+}
+
+TEST(Simulation, OscillatorDrift) {
+    sim_oscillator_params params = ideal_oscillator();
+    params.offset_ns = 500;
+    params.drift_ppb = 1000;
+    SimOscillator osc(params, 1);
+    EXPECT_EQ(osc.Read(1000000000LL), 1000001500LL);
+    osc.SetFrequency(1000000000LL, -1000);
+    EXPECT_EQ(osc.Read(2000000000LL), 2000001500LL);
+    osc.Step(2000000000LL, -1500);
+    EXPECT_EQ(osc.Read(3000000000LL), 3000000000LL);
+}
+
+TEST(Simulation, NetworkAsymmetry) {
+    sim_network_params params;
+    params.base_ns = 10000;
+    params.dist = SIM_DELAY_CONSTANT;
+    params.jitter_ns = 0;
+    params.asymmetry_ns = 200;
+    params.loss = 0;
+    SimNetwork network(params, 1);
+    int64_t forward, reverse;
+    EXPECT_TRUE(network.Delay(true, forward));
+    EXPECT_TRUE(network.Delay(false, reverse));
+    EXPECT_EQ(forward - reverse, 200LL);
+    EXPECT_EQ(forward + reverse, 20000LL);
+}
+
+TEST(Simulation, Deterministic) {
+    for (int i = 0; i < SIM_NUM_ALGORITHMS; i++) {
+        sim_scenario scenario = sim_random_scenario(sim_algorithm(i), 7, 0);
+        scenario.duration_s /= 10;
+        sim_metrics first, second;
+        int retval = sim_run(scenario, first);
+        if (retval < 0 && i == SIM_NTP_CHRONY)
+            continue;   // Built without chrony
+        ASSERT_EQ(retval, 0);
+        ASSERT_EQ(sim_run(scenario, second), 0);
+        EXPECT_EQ(first.checks, second.checks);
+        EXPECT_EQ(first.rms_error_ns, second.rms_error_ns);
+        EXPECT_EQ(first.coverage, second.coverage);
+    }
+}
+
+TEST(Simulation, PtpConverges) {
+    sim_scenario scenario = sim_random_scenario(SIM_PTP_PI, 3, 120);
+    scenario.network.dist = SIM_DELAY_UNIFORM;
+    scenario.network.loss = 0;
+    sim_metrics metrics;
+    ASSERT_EQ(sim_run(scenario, metrics), 0);
+    EXPECT_GE(metrics.convergence_s, 0);
+    EXPECT_LT(metrics.convergence_s, 60);
+    EXPECT_LT(metrics.rms_error_ns, scenario.threshold_ns);
+}
+
+TEST(Simulation, HuygensTracksPeer) {
+    sim_scenario scenario = sim_random_scenario(SIM_HUYGENS, 4, 60);
+    sim_metrics metrics;
+    ASSERT_EQ(sim_run(scenario, metrics), 0);
+    EXPECT_GT(metrics.checks, 0);
+    EXPECT_LT(metrics.rms_error_ns, scenario.threshold_ns);
+}
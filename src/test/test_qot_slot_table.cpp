@@ -0,0 +1,165 @@
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include "../qot_slot_table.h"
+}
+
+#include "../micro-services/timeline-service/qot_timeline_registry.hpp"
+
+using namespace qot_core;
+
+struct test_slot {
+    int64_t value;
+    char pad[40];
+};
+
+class SlotTable : public ::testing::Test {
+    protected: void TearDown() {
+        for (int i = 0; i < QOT_SLOT_DIR_SIZE; i++)
+            free(table.chunks[i]);
+    }
+    protected: qot_slot_table_t table = QOT_SLOT_TABLE_INIT(struct test_slot);
+};
+
+TEST_F(SlotTable, ChunksOnFirstUse) {
+    // Nothing is allocated up front, an id allocates its chunk only
+    for (int i = 0; i < QOT_SLOT_DIR_SIZE; i++)
+        ASSERT_TRUE(table.chunks[i] == NULL);
+    struct test_slot *slot = QOT_SLOT(&table, struct test_slot, 5);
+    ASSERT_TRUE(slot != NULL);
+    EXPECT_TRUE(table.chunks[0] != NULL);
+    EXPECT_TRUE(table.chunks[1] == NULL);
+
+    // Slots are zeroed and contiguous within a chunk, the same id gives the same slot
+    EXPECT_EQ(slot->value, 0);
+    slot->value = 42;
+    EXPECT_EQ(QOT_SLOT(&table, struct test_slot, 5), slot);
+    EXPECT_EQ(QOT_SLOT(&table, struct test_slot, 5)->value, 42);
+    EXPECT_EQ(QOT_SLOT(&table, struct test_slot, 6), slot + 1);
+    EXPECT_EQ(QOT_SLOT(&table, struct test_slot, 0), slot - 5);
+}
+
+TEST_F(SlotTable, IdsPastOneChunk) {
+    // Ids past the first QOT_SLOT_CHUNK land in their own chunks, slots never move
+    std::vector<struct test_slot *> slots;
+    for (int id = 0; id < 4*QOT_SLOT_CHUNK + 3; id++) {
+        struct test_slot *slot = QOT_SLOT(&table, struct test_slot, id);
+        ASSERT_TRUE(slot != NULL);
+        slot->value = id;
+        slots.push_back(slot);
+    }
+    EXPECT_TRUE(table.chunks[4] != NULL);
+    EXPECT_TRUE(table.chunks[5] == NULL);
+    for (int id = 0; id < (int)slots.size(); id++) {
+        EXPECT_EQ(QOT_SLOT(&table, struct test_slot, id), slots[id]);
+        EXPECT_EQ(slots[id]->value, id);
+    }
+    EXPECT_EQ(QOT_SLOT(&table, struct test_slot, QOT_SLOT_CHUNK), (struct test_slot *)table.chunks[1]);
+
+    // A sparse id allocates its chunk alone, the last id in range is served
+    struct test_slot *last = QOT_SLOT(&table, struct test_slot, QOT_SLOT_MAX_IDS - 1);
+    ASSERT_TRUE(last != NULL);
+    EXPECT_TRUE(table.chunks[QOT_SLOT_DIR_SIZE - 2] == NULL);
+    EXPECT_EQ(last, (struct test_slot *)table.chunks[QOT_SLOT_DIR_SIZE - 1] + QOT_SLOT_CHUNK - 1);
+}
+
+TEST_F(SlotTable, OutOfRange) {
+    EXPECT_TRUE(QOT_SLOT(&table, struct test_slot, -1) == NULL);
+    EXPECT_TRUE(QOT_SLOT(&table, struct test_slot, QOT_SLOT_MAX_IDS) == NULL);
+    for (int i = 0; i < QOT_SLOT_DIR_SIZE; i++)
+        EXPECT_TRUE(table.chunks[i] == NULL);
+}
+
+TEST_F(SlotTable, RacingFirstUse) {
+    // Threads racing for a fresh chunk all get the slots of the chunk that won
+    const int threads = 8;
+    std::vector<std::thread> workers;
+    std::vector<struct test_slot *> seen(threads);
+    std::atomic<bool> go(false);
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            while (!go.load())
+                ;
+            seen[t] = QOT_SLOT(&table, struct test_slot, 3*QOT_SLOT_CHUNK + t);
+        }));
+    }
+    go = true;
+    for (int t = 0; t < threads; t++)
+        workers[t].join();
+    for (int t = 0; t < threads; t++)
+        EXPECT_EQ(seen[t], (struct test_slot *)table.chunks[3] + t);
+}
+
+static qot_timeline_t Timeline(const char *name) {
+    qot_timeline_t timeline;
+    memset(&timeline, 0, sizeof(timeline));
+    strcpy(timeline.name, name);
+    return timeline;
+}
+
+TEST(TimelineRegistry, DenseIds) {
+    TimelineRegistry registry;
+    for (int i = 0; i < 70; i++) {
+        qot_timeline_t timeline = Timeline(("tl" + std::to_string(i)).c_str());
+        ASSERT_EQ(registry.qot_timeline_register(timeline), QOT_RETURN_TYPE_OK);
+        EXPECT_EQ(timeline.index, i);
+    }
+
+    // A name is registered once, lookups by name return its id
+    qot_timeline_t timeline = Timeline("tl65");
+    EXPECT_EQ(registry.qot_timeline_register(timeline), QOT_RETURN_TYPE_ERR);
+    timeline = Timeline("tl65");
+    ASSERT_EQ(registry.qot_timeline_get_info(timeline), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(timeline.index, 65);
+}
+
+TEST(TimelineRegistry, SmallestIdReusedFirst) {
+    TimelineRegistry registry;
+    for (int i = 0; i < 8; i++) {
+        qot_timeline_t timeline = Timeline(("tl" + std::to_string(i)).c_str());
+        ASSERT_EQ(registry.qot_timeline_register(timeline), QOT_RETURN_TYPE_OK);
+    }
+    const char *removed[3] = {"tl6", "tl2", "tl4"};
+    for (int i = 0; i < 3; i++) {
+        qot_timeline_t timeline = Timeline(removed[i]);
+        ASSERT_EQ(registry.qot_timeline_remove(timeline, false), QOT_RETURN_TYPE_OK);
+    }
+
+    // Released ids come back smallest first, then fresh ones follow
+    int expected[4] = {2, 4, 6, 8};
+    for (int i = 0; i < 4; i++) {
+        qot_timeline_t timeline = Timeline(("new" + std::to_string(i)).c_str());
+        ASSERT_EQ(registry.qot_timeline_register(timeline), QOT_RETURN_TYPE_OK);
+        EXPECT_EQ(timeline.index, expected[i]);
+    }
+}
+
+TEST(TimelineRegistry, IdHeldByClassPointer) {
+    TimelineRegistry registry;
+    int tl_class;
+    qot_timeline_t first = Timeline("first");
+    qot_timeline_t second = Timeline("second");
+    ASSERT_EQ(registry.qot_timeline_register(first), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(registry.qot_timeline_register(second), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(registry.qot_tl_class_register(first.index, &tl_class), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(registry.qot_tl_class_get(first.index), &tl_class);
+
+    // A class pointer is only registered for a registered id
+    EXPECT_EQ(registry.qot_tl_class_register(5, &tl_class), QOT_RETURN_TYPE_ERR);
+    EXPECT_EQ(registry.qot_tl_class_get(5), (void *)NULL);
+
+    // The id of a removed timeline stays taken until its class pointer is removed too
+    ASSERT_EQ(registry.qot_timeline_remove(first, false), QOT_RETURN_TYPE_OK);
+    qot_timeline_t third = Timeline("third");
+    ASSERT_EQ(registry.qot_timeline_register(third), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(third.index, 2);
+    ASSERT_EQ(registry.qot_tl_class_remove(first.index, false), QOT_RETURN_TYPE_OK);
+    qot_timeline_t fourth = Timeline("fourth");
+    ASSERT_EQ(registry.qot_timeline_register(fourth), QOT_RETURN_TYPE_OK);
+    EXPECT_EQ(fourth.index, first.index);
+}
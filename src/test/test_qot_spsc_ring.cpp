@@ -0,0 +1,109 @@
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/sync-service/sync/huygens/SPSCRing.hpp"
+
+using namespace qot;
+
+TEST(SPSCRing, CapacityRoundedUp) {
+    SPSCRing<int> ring(5);
+    EXPECT_EQ(ring.GetCapacity(), 8U);
+    SPSCRing<int> exact(16);
+    EXPECT_EQ(exact.GetCapacity(), 16U);
+}
+
+TEST(SPSCRing, Wraparound) {
+    // Records pushed and popped across the end of the slots come out in order
+    SPSCRing<int> ring(4);
+    int out[4];
+    int next_in = 0, next_out = 0;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 3; i++)
+            ASSERT_TRUE(ring.Push(next_in++));
+        EXPECT_EQ(ring.Size(), 3U);
+        size_t count = ring.PopBatch(out, 4);
+        ASSERT_EQ(count, 3U);
+        for (size_t i = 0; i < count; i++)
+            EXPECT_EQ(out[i], next_out++);
+        EXPECT_EQ(ring.Size(), 0U);
+    }
+    EXPECT_EQ(ring.GetOverflows(), 0U);
+    EXPECT_EQ(ring.PopBatch(out, 4), 0U);
+}
+
+TEST(SPSCRing, PartialBatches) {
+    SPSCRing<int> ring(8);
+    for (int i = 0; i < 7; i++)
+        ASSERT_TRUE(ring.Push(i));
+    int out[8];
+    ASSERT_EQ(ring.PopBatch(out, 2), 2U);
+    EXPECT_EQ(out[0], 0);
+    EXPECT_EQ(out[1], 1);
+    ASSERT_EQ(ring.PopBatch(out, 8), 5U);
+    for (int i = 0; i < 5; i++)
+        EXPECT_EQ(out[i], i + 2);
+}
+
+TEST(SPSCRing, OverflowCounted) {
+    // A full ring drops and counts each record, the ones already in are kept
+    SPSCRing<int> ring(4);
+    for (int i = 0; i < 4; i++)
+        ASSERT_TRUE(ring.Push(i));
+    EXPECT_FALSE(ring.Push(4));
+    EXPECT_FALSE(ring.Push(5));
+    EXPECT_EQ(ring.GetOverflows(), 2U);
+    EXPECT_EQ(ring.Size(), 4U);
+
+    int out[4];
+    ASSERT_EQ(ring.PopBatch(out, 1), 1U);
+    EXPECT_EQ(out[0], 0);
+    EXPECT_TRUE(ring.Push(6));
+    EXPECT_EQ(ring.GetOverflows(), 2U);
+    ASSERT_EQ(ring.PopBatch(out, 4), 4U);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[3], 6);
+}
+
+TEST(SPSCRing, HeapAligned) {
+    SPSCRing<int> *ring = new SPSCRing<int>(16);
+    EXPECT_EQ((uintptr_t)ring % QOT_CACHELINE_SIZE, 0U);
+    delete ring;
+}
+
+TEST(SPSCRing, TwoThreadFifo) {
+    // One producer retrying full pushes, one consumer: every record arrives once, in order, and each refused push is counted
+    const uint64_t records = 200000;
+    SPSCRing<uint64_t> *ring = new SPSCRing<uint64_t>(256);
+    std::vector<uint64_t> received;
+    received.reserve(records);
+    uint64_t refused = 0;
+
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < records; i++) {
+            while (!ring->Push(i)) {
+                refused++;
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread consumer([&]() {
+        uint64_t batch[64];
+        while (received.size() < records) {
+            size_t count = ring->PopBatch(batch, 64);
+            for (size_t i = 0; i < count; i++)
+                received.push_back(batch[i]);
+            if (count == 0)
+                std::this_thread::yield();
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    ASSERT_EQ(received.size(), records);
+    for (uint64_t i = 0; i < records; i++)
+        ASSERT_EQ(received[i], i);
+    EXPECT_EQ(ring->GetOverflows(), refused);
+    EXPECT_EQ(ring->Size(), 0U);
+    delete ring;
+}
@@ -0,0 +1,137 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/sync-service/sync/huygens/SVMprocessor.hpp"
+
+// Separable batch: bounds around a 5 us offset drifting by 20 ppm, probes every ms
+static void SeparableBatch(std::vector<int64_t> &bounds, std::vector<int64_t> &instant, int vec_len) {
+    uint32_t seed = 12345;
+    bounds.clear();
+    instant.clear();
+    for (int i = 0; i < vec_len; i++) {
+        int64_t t = 1000000000LL + i*1000000LL;
+        int64_t offset = 5000 + (20*(t - 1000000000LL))/1000000;
+        seed = seed*1103515245 + 12345;
+        int64_t up_noise = (seed >> 8) % 300;
+        seed = seed*1103515245 + 12345;
+        int64_t low_noise = (seed >> 8) % 300;
+        instant.push_back(t);
+        bounds.push_back(offset + 200 + up_noise);
+        bounds.push_back(offset - 200 - low_noise);
+    }
+}
+
+/* Reference solve of the same scaled problem: dual soft-margin SVM with the
+   plain maximal violating pair and a tight tolerance */
+static void ReferenceSolve(const std::vector<int64_t> &bounds, const std::vector<int64_t> &instant,
+                           int vec_len, double &offset, double &drift) {
+    const double C = SVM_PENALTY_C;
+    int n = 2*vec_len;
+
+    // Scaling as in SVMprocessor::FormulateProblem
+    int64_t b_sum = 0, i_sum = 0;
+    for (int k = 0; k < n; k++) b_sum += bounds[k];
+    for (int k = 0; k < vec_len; k++) i_sum += instant[k];
+    int64_t b_mean = b_sum/n, i_mean = i_sum/vec_len;
+    double b_sd = 0, i_sd = 0;
+    for (int k = 0; k < n; k++) b_sd += std::pow((double)(bounds[k] - b_mean), 2);
+    for (int k = 0; k < vec_len; k++) i_sd += std::pow((double)(instant[k] - i_mean), 2);
+    b_sd = std::sqrt(b_sd/n);
+    i_sd = std::sqrt(i_sd/vec_len);
+
+    std::vector<double> x0(n), x1(n), y(n), alpha(n, 0.0), G(n, -1.0);
+    for (int k = 0; k < n; k++) {
+        x0[k] = double(instant[k/2] - i_mean)/(2*i_sd);
+        x1[k] = double(bounds[k] - b_mean)/(2*b_sd);
+        y[k] = (k & 1) ? -1.0 : 1.0;
+    }
+
+    for (int iter = 0; iter < 10000000; iter++) {
+        // G is the gradient of the dual, -y*G is maximal over the points that can move up
+        int i = -1, j = -1;
+        double m = -INFINITY, M = INFINITY;
+        for (int t = 0; t < n; t++) {
+            bool up = (y[t] > 0) ? alpha[t] < C : alpha[t] > 0;
+            bool low = (y[t] > 0) ? alpha[t] > 0 : alpha[t] < C;
+            if (up && -y[t]*G[t] > m) { m = -y[t]*G[t]; i = t; }
+            if (low && -y[t]*G[t] < M) { M = -y[t]*G[t]; j = t; }
+        }
+        if (i < 0 || j < 0 || m - M < 1e-12)
+            break;
+
+        // Step along y_i*e_i - y_j*e_j, clipped to the box
+        double d0 = x0[i] - x0[j], d1 = x1[i] - x1[j];
+        double step = (m - M)/(d0*d0 + d1*d1);
+        step = std::min(step, (y[i] > 0) ? C - alpha[i] : alpha[i]);
+        step = std::min(step, (y[j] > 0) ? alpha[j] : C - alpha[j]);
+        alpha[i] += y[i]*step;
+        alpha[j] -= y[j]*step;
+        for (int t = 0; t < n; t++) {
+            double K_it = x0[i]*x0[t] + x1[i]*x1[t];
+            double K_jt = x0[j]*x0[t] + x1[j]*x1[t];
+            G[t] += y[t]*step*(K_it - K_jt);
+        }
+    }
+
+    double w0 = 0, w1 = 0;
+    for (int k = 0; k < n; k++) {
+        w0 += alpha[k]*y[k]*x0[k];
+        w1 += alpha[k]*y[k]*x1[k];
+    }
+    double sum_free = 0, ub = INFINITY, lb = -INFINITY;
+    int nr_free = 0;
+    for (int k = 0; k < n; k++) {
+        double yG = y[k]*G[k];
+        if (alpha[k] > 0 && alpha[k] < C) { sum_free += yG; nr_free++; }
+        else if ((alpha[k] >= C) == (y[k] < 0)) ub = std::min(ub, yG);
+        else lb = std::max(lb, yG);
+    }
+    double b = -((nr_free > 0) ? sum_free/nr_free : (ub + lb)/2);
+
+    drift = -(w0*b_sd)/(w1*i_sd);
+    offset = b_mean + (b_sd*(i_mean*w0 + 2*i_sd*b))/(i_sd*w1);
+}
+
+TEST(SVMprocessor, MatchesReferenceSolve) {
+    std::vector<int64_t> bounds, instant;
+    SeparableBatch(bounds, instant, 40);
+    double ref_offset, ref_drift;
+    ReferenceSolve(bounds, instant, 40, ref_offset, ref_drift);
+
+    qot::SVMprocessor svm(40);
+    double offset, drift;
+    ASSERT_EQ(svm.FormulateProblem(bounds, instant, 40), 0);
+    ASSERT_EQ(svm.Run(offset, drift), 0);
+    EXPECT_NEAR(drift, ref_drift, 1e-3*std::fabs(ref_drift));
+    // Offset line evaluated over the batch
+    for (int i = 0; i < 40; i += 13)
+        EXPECT_NEAR(offset + drift*instant[i], ref_offset + ref_drift*instant[i], 2.0);
+
+    // The true offset line lies between the bounds, so the separator is close to it
+    EXPECT_NEAR(drift, 20e-6, 5e-6);
+}
+
+TEST(SVMprocessor, WarmStartMatchesReferenceSolve) {
+    std::vector<int64_t> bounds, instant;
+    qot::SVMprocessor svm(40);
+    double offset, drift, ref_offset, ref_drift;
+
+    SeparableBatch(bounds, instant, 40);
+    ASSERT_EQ(svm.FormulateProblem(bounds, instant, 40), 0);
+    ASSERT_EQ(svm.Run(offset, drift), 0);
+
+    // Next batch, 40 ms later, starts from the previous hyperplane
+    for (int i = 0; i < 40; i++) {
+        instant[i] += 40000000LL;
+        bounds[2*i] += 800;
+        bounds[2*i+1] += 800;
+    }
+    ReferenceSolve(bounds, instant, 40, ref_offset, ref_drift);
+    ASSERT_EQ(svm.FormulateProblem(bounds, instant, 40), 0);
+    ASSERT_EQ(svm.Run(offset, drift), 0);
+    EXPECT_NEAR(drift, ref_drift, 1e-3*std::fabs(ref_drift));
+    for (int i = 0; i < 40; i += 13)
+        EXPECT_NEAR(offset + drift*instant[i], ref_offset + ref_drift*instant[i], 2.0);
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/timeline-service/qot_timeline_demand.hpp"
+
+using namespace qot_core;
+
+// Demand of a binding, in microseconds
+static timequality_t Demand(int64_t res_us, int64_t below_us, int64_t above_us) {
+    timequality_t demand;
+    TL_FROM_uSEC(demand.resolution, res_us);
+    TL_FROM_uSEC(demand.accuracy.below, below_us);
+    TL_FROM_uSEC(demand.accuracy.above, above_us);
+    return demand;
+}
+
+static void ExpectDemand(const timequality_t &demand, int64_t res_us, int64_t below_us, int64_t above_us) {
+    // The conversion macros end in a semicolon, so they only stand in statements
+    int64_t res = TL_TO_uSEC(demand.resolution);
+    int64_t below = TL_TO_uSEC(demand.accuracy.below);
+    int64_t above = TL_TO_uSEC(demand.accuracy.above);
+    EXPECT_EQ(res, res_us);
+    EXPECT_EQ(below, below_us);
+    EXPECT_EQ(above, above_us);
+}
+
+TEST(TimelineDemand, TightestOfEachKind) {
+    // Each requirement is aggregated on its own, the tightest of every kind wins
+    TimelineDemand demands;
+    EXPECT_TRUE(demands.empty());
+    demands.add(Demand(10, 500, 300));
+    demands.add(Demand(50, 100, 900));
+    demands.add(Demand(20, 700, 200));
+    EXPECT_FALSE(demands.empty());
+    ExpectDemand(demands.tightest(), 10, 100, 200);
+
+    // Removing a binding relaxes the aggregate to the next tightest demands
+    demands.remove(Demand(50, 100, 900));
+    ExpectDemand(demands.tightest(), 10, 500, 200);
+    demands.remove(Demand(10, 500, 300));
+    ExpectDemand(demands.tightest(), 20, 700, 200);
+    demands.remove(Demand(20, 700, 200));
+    EXPECT_TRUE(demands.empty());
+}
+
+TEST(TimelineDemand, EqualDemandsCounted) {
+    // Bindings with equal demands are counted, removing one leaves the others in place
+    TimelineDemand demands;
+    demands.add(Demand(10, 100, 100));
+    demands.add(Demand(10, 100, 100));
+    demands.add(Demand(30, 300, 300));
+    demands.remove(Demand(10, 100, 100));
+    ExpectDemand(demands.tightest(), 10, 100, 100);
+    demands.remove(Demand(10, 100, 100));
+    ExpectDemand(demands.tightest(), 30, 300, 300);
+}
+
+TEST(TimelineDemand, Capped) {
+    // Demands looser than 1e9 seconds are capped
+    TimelineDemand demands;
+    timequality_t loose;
+    loose.resolution.sec = 2000000000;
+    loose.resolution.asec = 0;
+    loose.accuracy.below = loose.resolution;
+    loose.accuracy.above.sec = 1;
+    loose.accuracy.above.asec = 0;
+    demands.add(loose);
+    timequality_t demand = demands.tightest();
+    EXPECT_EQ(demand.resolution.sec, 1000000000);
+    EXPECT_EQ(demand.resolution.asec, 0U);
+    EXPECT_EQ(demand.accuracy.below.sec, 1000000000);
+    EXPECT_EQ(demand.accuracy.above.sec, 1);
+}
+
+// Records the updates sent downstream
+class UpdateQueue : public ::testing::Test {
+    protected: qot_update_sender_t Sender() {
+        return [this](const timequality_t &demand, const std::string &meta_data) {
+            std::lock_guard<std::mutex> lock(sent_lock);
+            sent.push_back(std::make_pair(demand, meta_data));
+            sent_cv.notify_all();
+        };
+    }
+    protected: bool WaitSent(size_t count, int64_t timeout_ms) {
+        std::unique_lock<std::mutex> lock(sent_lock);
+        return sent_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, count] { return sent.size() >= count; });
+    }
+    protected: size_t Sent() {
+        std::lock_guard<std::mutex> lock(sent_lock);
+        return sent.size();
+    }
+
+    protected: std::mutex sent_lock;
+    protected: std::condition_variable sent_cv;
+    protected: std::vector<std::pair<timequality_t, std::string> > sent;
+};
+
+TEST_F(UpdateQueue, BurstCoalesced) {
+    // Updates within the window are folded into one carrying the latest demand
+    TimelineUpdateQueue queue(Sender(), 50);
+    for (int i = 1; i <= 10; i++)
+        queue.schedule(Demand(i, i, i), "NULL");
+    ASSERT_TRUE(WaitSent(1, 1000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(Sent(), 1U);
+    ExpectDemand(sent[0].first, 10, 10, 10);
+
+    // A later update goes out on its own
+    queue.schedule(Demand(20, 20, 20), "NULL");
+    ASSERT_TRUE(WaitSent(2, 1000));
+    ExpectDemand(sent[1].first, 20, 20, 20);
+}
+
+TEST_F(UpdateQueue, MetaDataKept) {
+    // Meta data is not overwritten by the placeholder of later updates in the same burst
+    TimelineUpdateQueue queue(Sender(), 50);
+    queue.schedule(Demand(1, 1, 1), "");
+    queue.schedule(Demand(2, 2, 2), "ptp domain 3");
+    queue.schedule(Demand(3, 3, 3), "NULL");
+    ASSERT_TRUE(WaitSent(1, 1000));
+    EXPECT_EQ(sent[0].second, "ptp domain 3");
+    ExpectDemand(sent[0].first, 3, 3, 3);
+
+    // Once sent it does not come with the next update
+    queue.schedule(Demand(4, 4, 4), "NULL");
+    ASSERT_TRUE(WaitSent(2, 1000));
+    EXPECT_EQ(sent[1].second, "NULL");
+}
+
+TEST_F(UpdateQueue, StopFlushes) {
+    // Stopping sends the pending update right away instead of waiting out the window
+    TimelineUpdateQueue queue(Sender(), 10000);
+    queue.schedule(Demand(5, 5, 5), "NULL");
+    auto start = std::chrono::steady_clock::now();
+    queue.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ASSERT_EQ(Sent(), 1U);
+    ExpectDemand(sent[0].first, 5, 5, 5);
+
+    // Nothing pending, nothing sent
+    TimelineUpdateQueue idle(Sender(), 50);
+    idle.stop();
+    EXPECT_EQ(Sent(), 1U);
+}
@@ -0,0 +1,138 @@
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <signal.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+}
+
+#include "../micro-services/timeline-service/qot_timeline_rest.hpp"
+
+// Port of the coordination service stand-in, nothing listens on the next one
+#define STANDIN_PORT 8599
+#define STANDIN_URL  "http://127.0.0.1:8599"
+#define DEAD_URL     "http://127.0.0.1:8600"
+
+using namespace qot_core;
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Coordination service stand-in running in a child process
+class CoordStandin : public ::testing::Test {
+    protected: CoordStandin() : pid(-1) {}
+    protected: void TearDown() {
+        Stop();
+    }
+    protected: void Start(int delay_ms) {
+        pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            std::string delay = std::to_string(delay_ms);
+            execl(QOT_COORD_STANDIN, "qot_coord_standin", STANDIN_URL, delay.c_str(), (char*) NULL);
+            _exit(127);
+        }
+        // Wait until it accepts connections
+        for (int i = 0; i < 500; i++) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(STANDIN_PORT);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            int retval = connect(fd, (struct sockaddr*) &addr, sizeof(addr));
+            close(fd);
+            if (retval == 0)
+                return;
+            usleep(10000);
+        }
+        FAIL() << "the stand-in did not start";
+    }
+    protected: void Stop() {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+            pid = -1;
+        }
+    }
+
+    // Meta data handed to the handler of an asynchronous lookup
+    protected: std::string LookupMetadata(TimelineRestInterface &rest, const std::string &timeline, int timeout_ms) {
+        std::shared_ptr<std::promise<std::string> > result = std::make_shared<std::promise<std::string> >();
+        std::future<std::string> meta_data = result->get_future();
+        if (rest.init_timeline_metadata_async(timeline, [result](std::string value) { result->set_value(value); }) < 0)
+            return std::string("queue full");
+        if (meta_data.wait_for(std::chrono::milliseconds(timeout_ms)) != std::future_status::ready)
+            return std::string("timeout");
+        return meta_data.get();
+    }
+
+    protected: pid_t pid;
+};
+
+TEST_F(CoordStandin, MetadataSetFromCoordinationId) {
+    Start(0);
+    TimelineRestInterface rest(STANDIN_URL);
+    rest.post_timeline("gl_rest_test");
+
+    // Unset meta data is set to the coordination id (the first timeline is 1) and kept afterwards
+    EXPECT_EQ(LookupMetadata(rest, "gl_rest_test", 2*QOT_REST_TIMEOUT_MS), "1");
+    EXPECT_EQ(rest.get_timeline_metadata("gl_rest_test"), "1");
+    EXPECT_EQ(LookupMetadata(rest, "gl_rest_test", 2*QOT_REST_TIMEOUT_MS), "1");
+}
+
+TEST_F(CoordStandin, LookupDoesNotBlock) {
+    Start(300);
+    TimelineRestInterface rest(STANDIN_URL);
+    rest.post_timeline("gl_rest_test");
+
+    std::shared_ptr<std::promise<std::string> > result = std::make_shared<std::promise<std::string> >();
+    std::future<std::string> meta_data = result->get_future();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ASSERT_EQ(rest.init_timeline_metadata_async("gl_rest_test", [result](std::string value) { result->set_value(value); }), 0);
+    EXPECT_LT(elapsed_ms(start), 100);
+
+    // The answer comes after the POST and the GET, the PUT follows
+    ASSERT_EQ(meta_data.wait_for(std::chrono::milliseconds(2*QOT_REST_TIMEOUT_MS)), std::future_status::ready);
+    EXPECT_EQ(meta_data.get(), "1");
+    EXPECT_GE(elapsed_ms(start), 500);
+    EXPECT_EQ(rest.get_timeline_metadata("gl_rest_test"), "1");
+}
+
+TEST_F(CoordStandin, FailedLookupWritesNothing) {
+    Start(0);
+    TimelineRestInterface rest(STANDIN_URL);
+
+    // The timeline is unknown to the service, nothing is written back
+    EXPECT_EQ(LookupMetadata(rest, "gl_rest_unknown", 2*QOT_REST_TIMEOUT_MS), "NULL");
+    rest.post_timeline("gl_rest_unknown");
+    EXPECT_EQ(rest.get_timeline_metadata("gl_rest_unknown"), "NULL");
+
+    // Nor when the service is unreachable
+    TimelineRestInterface dead(DEAD_URL);
+    EXPECT_EQ(LookupMetadata(dead, "gl_rest_unknown", 4*QOT_REST_TIMEOUT_MS), "NULL");
+}
+
+TEST_F(CoordStandin, BoundedShutdown) {
+    // Every request takes a second, a full replay of the queue would take 20
+    Start(1000);
+    std::chrono::steady_clock::time_point start;
+    {
+        TimelineRestInterface rest(STANDIN_URL);
+        rest.post_timeline("gl_rest_test");
+        for (int i = 0; i < 20; i++)
+            rest.post_node("gl_rest_test", "node" + std::to_string(i), 1000, 1000);
+        start = std::chrono::steady_clock::now();
+    }
+    EXPECT_LT(elapsed_ms(start), QOT_REST_DRAIN_MS + 2*QOT_REST_TIMEOUT_MS);
+}
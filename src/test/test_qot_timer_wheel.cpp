@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+}
+
+#include "../api/cpp/qot_timer_wheel.hpp"
+
+using namespace qot_coreapi;
+
+static int64_t core_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// Timeline running at the core clock rate, offset_ns ahead of it
+class TimerWheel : public ::testing::Test {
+    protected: void SetUp() {
+        offset_ns = 0;
+        version = 0;
+        version_reads = 0;
+    }
+    protected: TimelineTimerWheel *Wheel(const tl_translation_t *params) {
+        return new TimelineTimerWheel(
+            [this](int64_t tl_ns, int64_t &core_ns) { core_ns = tl_ns - offset_ns.load(); return QOT_RETURN_TYPE_OK; },
+            [this]() { version_reads++; return version.load(); }, params);
+    }
+    // Record the core time at which a timer fires
+    protected: qot_timer_handler_t Record(int id) {
+        return [this, id]() {
+            std::lock_guard<std::mutex> lock(fired_lock);
+            fired.push_back(std::make_pair(id, core_now()));
+        };
+    }
+    protected: size_t Fired() {
+        std::lock_guard<std::mutex> lock(fired_lock);
+        return fired.size();
+    }
+    protected: bool WaitFired(size_t count, int64_t timeout_ms) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (Fired() < count && std::chrono::steady_clock::now() < end)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return Fired() >= count;
+    }
+
+    protected: std::atomic<int64_t> offset_ns;
+    protected: std::atomic<uint64_t> version;
+    protected: std::atomic<int> version_reads;
+    protected: std::mutex fired_lock;
+    protected: std::vector<std::pair<int, int64_t> > fired;
+    protected: int keys[8];
+};
+
+TEST_F(TimerWheel, ExpiryOrder) {
+    // Timers added out of order fire in deadline order, none early
+    TimelineTimerWheel *wheel = Wheel(NULL);
+    ASSERT_EQ(wheel->query_status_flag(), 0);
+    int64_t start = core_now();
+    int64_t offsets[6] = {40, 10, 50, 20, 60, 30};
+    int64_t deadlines[6];
+    for (int i = 0; i < 6; i++) {
+        deadlines[i] = start + offsets[i]*1000000LL;
+        ASSERT_EQ(wheel->add_timer(&keys[i], deadlines[i], 0, 1, Record(i)), QOT_RETURN_TYPE_OK);
+    }
+    ASSERT_TRUE(WaitFired(6, 2000));
+    std::vector<int> order;
+    for (size_t i = 0; i < fired.size(); i++) {
+        order.push_back(fired[i].first);
+        EXPECT_GE(fired[i].second, deadlines[fired[i].first]);
+    }
+    EXPECT_EQ(order, std::vector<int>({1, 3, 5, 0, 2, 4}));
+    delete wheel;
+}
+
+TEST_F(TimerWheel, Cascade) {
+    // Deadlines on the first four levels (ticks of 1 us, 64 slots per level) cascade down and fire on time
+    TimelineTimerWheel *wheel = Wheel(NULL);
+    int64_t start = core_now();
+    int64_t offsets[4] = {30000LL, 2000000LL, 100000000LL, 400000000LL};
+    for (int i = 0; i < 4; i++)
+        ASSERT_EQ(wheel->add_timer(&keys[i], start + offsets[i], 0, 1, Record(i)), QOT_RETURN_TYPE_OK);
+    ASSERT_TRUE(WaitFired(4, 2000));
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(fired[i].first, i);
+        EXPECT_GE(fired[i].second - start, offsets[i]);
+        EXPECT_LT(fired[i].second - start, offsets[i] + 20000000LL);
+    }
+    delete wheel;
+}
+
+TEST_F(TimerWheel, Cancel) {
+    TimelineTimerWheel *wheel = Wheel(NULL);
+    int64_t start = core_now();
+    ASSERT_EQ(wheel->add_timer(&keys[0], start + 20000000LL, 0, 1, Record(0)), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(wheel->add_timer(&keys[1], start + 30000000LL, 0, 1, Record(1)), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(wheel->add_timer(&keys[2], start + 10000000LL, 20000000LL, 0, Record(2)), QOT_RETURN_TYPE_OK);
+
+    // Keys are unique, unknown keys cannot be cancelled
+    EXPECT_EQ(wheel->add_timer(&keys[0], start, 0, 1, Record(0)), QOT_RETURN_TYPE_ERR);
+    EXPECT_EQ(wheel->cancel_timer(&keys[3]), QOT_RETURN_TYPE_ERR);
+
+    // A cancelled one-shot never fires, a cancelled periodic timer stops
+    EXPECT_EQ(wheel->cancel_timer(&keys[0]), QOT_RETURN_TYPE_OK);
+    ASSERT_TRUE(WaitFired(2, 1000));
+    EXPECT_EQ(wheel->cancel_timer(&keys[2]), QOT_RETURN_TYPE_OK);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    std::lock_guard<std::mutex> lock(fired_lock);
+    int periodic = 0;
+    for (size_t i = 0; i < fired.size(); i++) {
+        EXPECT_NE(fired[i].first, 0);
+        periodic += (fired[i].first == 2);
+    }
+    EXPECT_LE(periodic, 2);
+    EXPECT_EQ(wheel->cancel_timer(&keys[1]), QOT_RETURN_TYPE_ERR);
+    delete wheel;
+}
+
+TEST_F(TimerWheel, PeriodicCount) {
+    // A periodic timer with a count fires that many times, one period apart
+    TimelineTimerWheel *wheel = Wheel(NULL);
+    int64_t start = core_now() + 5000000LL;
+    ASSERT_EQ(wheel->add_timer(&keys[0], start, 10000000LL, 3, Record(0)), QOT_RETURN_TYPE_OK);
+    ASSERT_TRUE(WaitFired(3, 1000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    ASSERT_EQ(Fired(), 3U);
+    for (int i = 0; i < 3; i++)
+        EXPECT_GE(fired[i].second, start + i*10000000LL);
+    delete wheel;
+}
+
+TEST_F(TimerWheel, SharedDispatcher) {
+    // Wheels share the dispatch thread, detaching one leaves the other running
+    TimelineTimerWheel *first = Wheel(NULL);
+    TimelineTimerWheel *second = Wheel(NULL);
+    int64_t start = core_now();
+    ASSERT_EQ(first->add_timer(&keys[0], start + 20000000LL, 0, 1, Record(0)), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(second->add_timer(&keys[0], start + 10000000LL, 0, 1, Record(1)), QOT_RETURN_TYPE_OK);
+    ASSERT_EQ(second->add_timer(&keys[1], start + 30000000LL, 0, 1, Record(2)), QOT_RETURN_TYPE_OK);
+    ASSERT_TRUE(WaitFired(1, 1000));
+    delete second;
+    ASSERT_TRUE(WaitFired(2, 1000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    std::lock_guard<std::mutex> lock(fired_lock);
+    ASSERT_EQ(fired.size(), 2U);
+    EXPECT_EQ(fired[0].first, 1);
+    EXPECT_EQ(fired[1].first, 0);
+    delete first;
+}
+
+TEST_F(TimerWheel, UpdateWakesDispatcher) {
+    // The dispatch thread blocks on the wait slot, a parameter update moves the expiry right away
+    int fd = shm_open(TL_WAIT_TABLE_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        GTEST_SKIP() << "a timeline service owns the wait table";
+    ASSERT_EQ(ftruncate(fd, TL_WAIT_SLOTS*sizeof(tl_wait_slot_t)), 0);
+    close(fd);
+#ifdef SYS_futex_waitv
+    bool blocks = !(syscall(SYS_futex_waitv, NULL, 0, 0, NULL, CLOCK_REALTIME) < 0 && errno == ENOSYS);
+#else
+    bool blocks = false;
+#endif
+
+    tl_translation_t params;
+    memset(&params, 0, sizeof(params));
+    params.wait_slot = TL_WAIT_SLOT_LOCAL;
+    TimelineTimerWheel *wheel = Wheel(&params);
+    ASSERT_TRUE(wheel->update_slot() != NULL);
+
+    // 300 ms out, the timeline then jumps 200 ms ahead
+    int64_t start = core_now();
+    ASSERT_EQ(wheel->add_timer(&keys[0], start + 300000000LL, 0, 1, Record(0)), QOT_RETURN_TYPE_OK);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Without the wait slot the dispatch thread would re-check the parameters every QOT_TIMER_REPROJECT_NS
+    if (blocks)
+        EXPECT_LT(version_reads.load(), 4);
+    offset_ns = 200000000LL;
+    version++;
+    tl_translation_t updated = params;
+    tl_translation_publish(&params, &updated);
+
+    ASSERT_TRUE(WaitFired(1, 1000));
+    EXPECT_GE(fired[0].second - start, 100000000LL);
+    EXPECT_LT(fired[0].second - start, 150000000LL);
+    delete wheel;
+    shm_unlink(TL_WAIT_TABLE_NAME);
+}
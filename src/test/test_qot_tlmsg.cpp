@@ -0,0 +1,128 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../micro-services/timeline-service/qot_tlmsg_serialize.hpp"
+
+static qot_timeline_msg_t TimelineMsg() {
+    qot_timeline_msg_t msg;
+    memset(&msg.info, 0, sizeof(msg.info));
+    memset(&msg.binding, 0, sizeof(msg.binding));
+    strcpy(msg.info.name, "gl_test");
+    msg.info.index = 3;
+    msg.info.type = QOT_TIMELINE_GLOBAL;
+    strcpy(msg.binding.name, "app");
+    msg.binding.id = -1;
+    msg.demand.resolution.sec = 0;
+    msg.demand.resolution.asec = 1000000000ULL;
+    msg.demand.accuracy.above.sec = 1;
+    msg.demand.accuracy.above.asec = 20000000000000ULL;
+    msg.demand.accuracy.below.sec = 2;
+    msg.demand.accuracy.below.asec = 30000000000000ULL;
+    msg.binding.demand = msg.demand;
+    msg.msgtype = TIMELINE_SET_SERVER;
+    msg.retval = QOT_RETURN_TYPE_ERR;
+    msg.aux_data = "node1 ptp 2";
+    return msg;
+}
+
+static void ExpectSameMsg(const qot_timeline_msg_t &a, const qot_timeline_msg_t &b) {
+    EXPECT_STREQ(a.info.name, b.info.name);
+    EXPECT_EQ(a.info.index, b.info.index);
+    EXPECT_EQ(a.info.type, b.info.type);
+    EXPECT_STREQ(a.binding.name, b.binding.name);
+    EXPECT_EQ(a.binding.id, b.binding.id);
+    EXPECT_EQ(a.demand.resolution.sec, b.demand.resolution.sec);
+    EXPECT_EQ(a.demand.resolution.asec, b.demand.resolution.asec);
+    EXPECT_EQ(a.demand.accuracy.above.sec, b.demand.accuracy.above.sec);
+    EXPECT_EQ(a.demand.accuracy.above.asec, b.demand.accuracy.above.asec);
+    EXPECT_EQ(a.demand.accuracy.below.sec, b.demand.accuracy.below.sec);
+    EXPECT_EQ(a.demand.accuracy.below.asec, b.demand.accuracy.below.asec);
+    EXPECT_EQ(a.binding.demand.accuracy.above.asec, b.binding.demand.accuracy.above.asec);
+    EXPECT_EQ(a.msgtype, b.msgtype);
+    EXPECT_EQ(a.retval, b.retval);
+    EXPECT_EQ(a.aux_data, b.aux_data);
+}
+
+TEST(TlMsg, JsonRoundTrip) {
+    qot_timeline_msg_t msg = TimelineMsg();
+    nlohmann::json data = nlohmann::json::parse(serialize_tlmsg(msg).dump());
+    qot_timeline_msg_t out;
+    deserialize_tlmsg(data, out);
+    ExpectSameMsg(msg, out);
+}
+
+TEST(TlMsg, BinaryRoundTrip) {
+    qot_timeline_msg_t msg = TimelineMsg();
+    char frame[QOT_TLMSG_BIN_SIZE];
+    ASSERT_EQ(serialize_tlmsg_binary(msg, frame, sizeof(frame)), QOT_TLMSG_BIN_SIZE);
+    EXPECT_TRUE(is_tlmsg_binary(frame, sizeof(frame)));
+    EXPECT_EQ(tlmsg_binary_frame_length(frame, sizeof(frame)), QOT_TLMSG_BIN_SIZE);
+    qot_timeline_msg_t out;
+    ASSERT_EQ(deserialize_tlmsg_binary(frame, sizeof(frame), out), 0);
+    ExpectSameMsg(msg, out);
+
+    // Requests carry no auxiliary data
+    msg.aux_data.clear();
+    ASSERT_EQ(serialize_tlmsg_binary(msg, frame, sizeof(frame)), QOT_TLMSG_BIN_SIZE);
+    ASSERT_EQ(deserialize_tlmsg_binary(frame, sizeof(frame), out), 0);
+    EXPECT_TRUE(out.aux_data.empty());
+
+    // Aux data which does not fit a frame is refused, as is a short buffer
+    msg.aux_data = std::string(QOT_TLMSG_AUX_MAXLEN + 1, 'x');
+    EXPECT_EQ(serialize_tlmsg_binary(msg, frame, sizeof(frame)), -1);
+    msg.aux_data.clear();
+    EXPECT_EQ(serialize_tlmsg_binary(msg, frame, sizeof(frame) - 1), -1);
+}
+
+TEST(TlMsg, PartialFrames) {
+    qot_timeline_msg_t msg = TimelineMsg();
+    char frame[QOT_TLMSG_BIN_SIZE];
+    ASSERT_EQ(serialize_tlmsg_binary(msg, frame, sizeof(frame)), QOT_TLMSG_BIN_SIZE);
+
+    // Until the length prefix is in the frame length is unknown, until the magic is in it is not yet binary
+    for (size_t len = 0; len < 4; len++)
+        EXPECT_EQ(tlmsg_binary_frame_length(frame, len), 0);
+    for (size_t len = 0; len < 8; len++)
+        EXPECT_FALSE(is_tlmsg_binary(frame, len));
+
+    // Every prefix of the frame announces the full length and does not decode
+    qot_timeline_msg_t out;
+    for (size_t len = 8; len < sizeof(frame); len++) {
+        EXPECT_TRUE(is_tlmsg_binary(frame, len));
+        EXPECT_EQ(tlmsg_binary_frame_length(frame, len), QOT_TLMSG_BIN_SIZE);
+        EXPECT_EQ(deserialize_tlmsg_binary(frame, len, out), -1);
+    }
+
+    // JSON is never taken for a binary frame
+    std::string json = serialize_tlmsg(msg).dump();
+    EXPECT_FALSE(is_tlmsg_binary(json.data(), json.size()));
+}
+
+TEST(TlMsg, LongerFrames) {
+    qot_timeline_msg_t msg = TimelineMsg();
+    std::vector<char> frame(QOT_TLMSG_BIN_SIZE + 16, 0x5a);
+    ASSERT_EQ(serialize_tlmsg_binary(msg, frame.data(), frame.size()), QOT_TLMSG_BIN_SIZE);
+
+    // A later version appending fields is read up to its announced length
+    uint32_t length = QOT_TLMSG_BIN_SIZE + 16 - 4;
+    for (int i = 0; i < 4; i++)
+        frame[i] = (char)((length >> (8*i)) & 0xff);
+    frame[8] = 2;
+    EXPECT_EQ(tlmsg_binary_frame_length(frame.data(), frame.size()), (long)frame.size());
+    qot_timeline_msg_t out;
+    ASSERT_EQ(deserialize_tlmsg_binary(frame.data(), frame.size(), out), 0);
+    ExpectSameMsg(msg, out);
+    EXPECT_EQ(deserialize_tlmsg_binary(frame.data(), frame.size() - 1, out), -1);
+
+    // Lengths outside the accepted range are invalid
+    length = QOT_TLMSG_BIN_MAXSIZE;
+    for (int i = 0; i < 4; i++)
+        frame[i] = (char)((length >> (8*i)) & 0xff);
+    EXPECT_EQ(tlmsg_binary_frame_length(frame.data(), frame.size()), -1);
+    length = 16;
+    for (int i = 0; i < 4; i++)
+        frame[i] = (char)((length >> (8*i)) & 0xff);
+    EXPECT_EQ(tlmsg_binary_frame_length(frame.data(), frame.size()), -1);
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+extern "C"
+{
+    #include <dirent.h>
+    #include <stdlib.h>
+    #include <unistd.h>
+}
+
+#include "../micro-services/sync-service/qot_trace.hpp"
+
+using namespace qot;
+
+// Ring files written to a directory
+static std::vector<std::string> ring_files(const std::string &dir)
+{
+    std::vector<std::string> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return files;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        std::string name = entry->d_name;
+        if (name.find(QOT_TRACE_SUFFIX) != std::string::npos)
+            files.push_back(dir + "/" + name);
+    }
+    closedir(d);
+    return files;
+}
+
+static std::string make_dir()
+{
+    char tmpl[] = "/tmp/qot_trace_testXXXXXX";
+    char *dir = mkdtemp(tmpl);
+    return dir ? std::string(dir) : std::string();
+}
+
+TEST(Trace, RoundTrip) {
+    std::string dir = make_dir();
+    ASSERT_FALSE(dir.empty());
+    ASSERT_EQ(trace_open("test", dir), 0);
+
+    // Each thread gets its own ring
+    std::thread writer([]() {
+        trace_sync_sample(3, -1200, 45, 7, QOT_TRACE_ALG_PTP);
+        trace_probe_pair(0, true, 1, 2, 3, 4, 5, 6);
+        trace_bound_update(3, 100, 200, 10, 20, -1200, 45);
+    });
+    writer.join();
+    trace_close();
+
+    std::vector<std::string> files = ring_files(dir);
+    ASSERT_EQ(files.size(), 1U);
+    qot_trace_header_t header;
+    std::vector<qot_trace_record_t> records;
+    ASSERT_EQ(trace_read(files[0], header, records), 0);
+    EXPECT_EQ(header.magic, (uint32_t) QOT_TRACE_MAGIC);
+    EXPECT_STREQ(header.service, "test");
+    ASSERT_EQ(records.size(), 3U);
+    EXPECT_EQ(records[0].type, QOT_TRACE_SYNC_SAMPLE);
+    EXPECT_EQ(records[0].source, 3);
+    EXPECT_EQ(records[0].value[0], -1200);
+    EXPECT_EQ(records[0].value[1], 45);
+    EXPECT_EQ(records[1].type, QOT_TRACE_PROBE_PAIR);
+    EXPECT_EQ(records[1].flags, QOT_TRACE_FLAG_VALID);
+    EXPECT_EQ(records[1].value[5], 6);
+    EXPECT_EQ(records[2].type, QOT_TRACE_BOUND_UPDATE);
+    EXPECT_LE(records[0].timestamp, records[2].timestamp);
+
+    unlink(files[0].c_str());
+    rmdir(dir.c_str());
+}
+
+TEST(Trace, RingWraps) {
+    std::string dir = make_dir();
+    ASSERT_FALSE(dir.empty());
+    // Room for 16 records after the header
+    size_t ring_bytes = sizeof(qot_trace_header_t) + 16*sizeof(qot_trace_record_t);
+    ASSERT_EQ(trace_open("wrap", dir, ring_bytes), 0);
+
+    std::thread writer([]() {
+        for (int i = 0; i < 100; i++)
+            trace_step(1, i, 0, QOT_TRACE_ALG_HUYGENS);
+    });
+    writer.join();
+    trace_close();
+
+    std::vector<std::string> files = ring_files(dir);
+    ASSERT_EQ(files.size(), 1U);
+    qot_trace_header_t header;
+    std::vector<qot_trace_record_t> records;
+    ASSERT_EQ(trace_read(files[0], header, records), 0);
+    EXPECT_EQ(header.head, 100U);
+    // Only the newest records survive, oldest first
+    ASSERT_EQ(records.size(), 16U);
+    for (size_t i = 0; i < records.size(); i++)
+        EXPECT_EQ(records[i].value[0], int64_t(84 + i));
+
+    unlink(files[0].c_str());
+    rmdir(dir.c_str());
+}